@@ -0,0 +1,669 @@
+/*
+ * Multi-buffer SHA-256 algorithm, ARM NEON glue code
+ *
+ * Based on the x86_64 multi-buffer SHA1 glue code:
+ *   Copyright (c) 2014 Intel Corporation.
+ *
+ * Requests are queued per CPU by mcryptd and fed into the four lanes of
+ * the NEON job manager; a partially filled manager is flushed once the
+ * oldest request has waited for FLUSH_INTERVAL.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#define pr_fmt(fmt)	KBUILD_MODNAME ": " fmt
+
+#include <crypto/internal/hash.h>
+#include <crypto/mcryptd.h>
+#include <crypto/sha.h>
+#include <linux/hardirq.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <asm/neon.h>
+#include "sha256_mb_mgr.h"
+
+#define FLUSH_INTERVAL 1000 /* in usec */
+
+static struct mcryptd_alg_state sha256_mb_alg_state;
+
+struct sha256_mb_ctx {
+	struct mcryptd_ahash *mcryptd_tfm;
+};
+
+static inline struct mcryptd_hash_request_ctx *
+cast_hash_to_mcryptd_ctx(struct sha256_hash_ctx *hash_ctx)
+{
+	struct shash_desc *desc;
+
+	desc = container_of((void *)hash_ctx, struct shash_desc, __ctx);
+	return container_of(desc, struct mcryptd_hash_request_ctx, desc);
+}
+
+static inline struct ahash_request *
+cast_mcryptd_ctx_to_req(struct mcryptd_hash_request_ctx *ctx)
+{
+	return container_of((void *)ctx, struct ahash_request, __ctx);
+}
+
+static void sha256_init_digest(u32 *digest)
+{
+	static const u32 initial_digest[SHA256_DIGEST_WORDS] = {
+		SHA256_H0, SHA256_H1, SHA256_H2, SHA256_H3,
+		SHA256_H4, SHA256_H5, SHA256_H6, SHA256_H7
+	};
+
+	memcpy(digest, initial_digest, sizeof(initial_digest));
+}
+
+/* pad the tail in @padblock, return the number of blocks to hash */
+static u32 sha256_pad(u8 padblock[SHA256_BLOCK_SIZE * 2], u64 total_len)
+{
+	u32 i = total_len & (SHA256_BLOCK_SIZE - 1);
+
+	memset(&padblock[i], 0, SHA256_BLOCK_SIZE);
+	padblock[i] = 0x80;
+
+	i += ((SHA256_BLOCK_SIZE - 1) & (0 - (total_len + 8 + 1))) + 1 + 8;
+	*(__be64 *)&padblock[i - 8] = cpu_to_be64(total_len << 3);
+
+	return i / SHA256_BLOCK_SIZE;
+}
+
+static struct sha256_hash_ctx *
+sha256_ctx_mgr_resubmit(struct sha256_ctx_mgr *mgr, struct sha256_hash_ctx *ctx)
+{
+	while (ctx) {
+		if (ctx->status & HASH_CTX_STS_COMPLETE) {
+			/* clear the PROCESSING bit */
+			ctx->status = HASH_CTX_STS_COMPLETE;
+			return ctx;
+		}
+
+		/*
+		 * If the partial block buffer is empty, hash the whole blocks
+		 * left in the user's buffer and keep the remainder.
+		 */
+		if (ctx->partial_block_buffer_length == 0 &&
+		    ctx->incoming_buffer_length) {
+			const u8 *buffer = ctx->incoming_buffer;
+			u32 len = ctx->incoming_buffer_length;
+			u32 copy_len = len & (SHA256_BLOCK_SIZE - 1);
+
+			if (copy_len) {
+				len -= copy_len;
+				memcpy(ctx->partial_block_buffer, buffer + len,
+				       copy_len);
+				ctx->partial_block_buffer_length = copy_len;
+			}
+			ctx->incoming_buffer_length = 0;
+
+			if (len) {
+				ctx->job.buffer = buffer;
+				ctx->job.len = len / SHA256_BLOCK_SIZE;
+				ctx = (struct sha256_hash_ctx *)
+					sha256_mb_mgr_submit(&mgr->mgr,
+							     &ctx->job);
+				continue;
+			}
+		}
+
+		/*
+		 * Otherwise this is either the last block(s) or we have to
+		 * wait for more user data.
+		 */
+		if (ctx->status & HASH_CTX_STS_LAST) {
+			u8 *buf = ctx->partial_block_buffer;
+
+			ctx->status = HASH_CTX_STS_PROCESSING |
+				      HASH_CTX_STS_COMPLETE;
+			ctx->job.buffer = buf;
+			ctx->job.len = sha256_pad(buf, ctx->total_length);
+			ctx = (struct sha256_hash_ctx *)
+				sha256_mb_mgr_submit(&mgr->mgr, &ctx->job);
+			continue;
+		}
+
+		ctx->status = HASH_CTX_STS_IDLE;
+		return ctx;
+	}
+
+	return NULL;
+}
+
+static struct sha256_hash_ctx *
+sha256_ctx_mgr_get_comp_ctx(struct sha256_ctx_mgr *mgr)
+{
+	struct sha256_hash_ctx *ctx;
+
+	ctx = (struct sha256_hash_ctx *)sha256_mb_mgr_get_comp_job(&mgr->mgr);
+	return sha256_ctx_mgr_resubmit(mgr, ctx);
+}
+
+static struct sha256_hash_ctx *
+sha256_ctx_mgr_submit(struct sha256_ctx_mgr *mgr, struct sha256_hash_ctx *ctx,
+		      const u8 *buffer, u32 len, int flags)
+{
+	if (flags & ~HASH_ENTIRE) {
+		ctx->error = HASH_CTX_ERROR_INVALID_FLAGS;
+		return ctx;
+	}
+
+	if (ctx->status & HASH_CTX_STS_PROCESSING) {
+		ctx->error = HASH_CTX_ERROR_ALREADY_PROCESSING;
+		return ctx;
+	}
+
+	if ((ctx->status & HASH_CTX_STS_COMPLETE) && !(flags & HASH_FIRST)) {
+		ctx->error = HASH_CTX_ERROR_ALREADY_COMPLETED;
+		return ctx;
+	}
+
+	if (flags & HASH_FIRST) {
+		sha256_init_digest(ctx->job.result_digest);
+		ctx->total_length = 0;
+		ctx->partial_block_buffer_length = 0;
+	}
+
+	ctx->error = HASH_CTX_ERROR_NONE;
+	ctx->incoming_buffer = buffer;
+	ctx->incoming_buffer_length = len;
+	ctx->status = (flags & HASH_LAST) ?
+		      (HASH_CTX_STS_PROCESSING | HASH_CTX_STS_LAST) :
+		      HASH_CTX_STS_PROCESSING;
+	ctx->total_length += len;
+
+	/*
+	 * Top up a partial block first, or buffer the user's data if it
+	 * does not fill a block.
+	 */
+	if (ctx->partial_block_buffer_length || len < SHA256_BLOCK_SIZE) {
+		u32 copy_len = min(len, SHA256_BLOCK_SIZE -
+					ctx->partial_block_buffer_length);
+
+		if (copy_len) {
+			memcpy(&ctx->partial_block_buffer
+					[ctx->partial_block_buffer_length],
+			       buffer, copy_len);
+			ctx->partial_block_buffer_length += copy_len;
+			ctx->incoming_buffer = buffer + copy_len;
+			ctx->incoming_buffer_length = len - copy_len;
+		}
+
+		if (ctx->partial_block_buffer_length == SHA256_BLOCK_SIZE) {
+			ctx->partial_block_buffer_length = 0;
+			ctx->job.buffer = ctx->partial_block_buffer;
+			ctx->job.len = 1;
+			ctx = (struct sha256_hash_ctx *)
+				sha256_mb_mgr_submit(&mgr->mgr, &ctx->job);
+		}
+	}
+
+	return sha256_ctx_mgr_resubmit(mgr, ctx);
+}
+
+static struct sha256_hash_ctx *sha256_ctx_mgr_flush(struct sha256_ctx_mgr *mgr)
+{
+	struct sha256_hash_ctx *ctx;
+
+	for (;;) {
+		ctx = (struct sha256_hash_ctx *)sha256_mb_mgr_flush(&mgr->mgr);
+		/* nothing is in flight any more */
+		if (!ctx)
+			return NULL;
+
+		ctx = sha256_ctx_mgr_resubmit(mgr, ctx);
+		if (ctx)
+			return ctx;
+	}
+}
+
+static int sha256_mb_init(struct shash_desc *desc)
+{
+	struct sha256_hash_ctx *sctx = shash_desc_ctx(desc);
+
+	sha256_init_digest(sctx->job.result_digest);
+	sctx->error = HASH_CTX_ERROR_NONE;
+	sctx->total_length = 0;
+	sctx->partial_block_buffer_length = 0;
+	sctx->status = HASH_CTX_STS_IDLE;
+
+	return 0;
+}
+
+static void sha256_mb_set_results(struct mcryptd_hash_request_ctx *rctx)
+{
+	struct sha256_hash_ctx *sctx = shash_desc_ctx(&rctx->desc);
+	__be32 *dst = (__be32 *)rctx->out;
+	int i;
+
+	for (i = 0; i < SHA256_DIGEST_WORDS; i++)
+		dst[i] = cpu_to_be32(sctx->job.result_digest[i]);
+}
+
+static int sha_finish_walk(struct mcryptd_hash_request_ctx **ret_rctx,
+			   struct mcryptd_alg_cstate *cstate, bool flush)
+{
+	struct mcryptd_hash_request_ctx *rctx = *ret_rctx;
+	struct sha256_hash_ctx *sha_ctx;
+	int flag = HASH_UPDATE;
+	int nbytes, err = 0;
+
+	while (!(rctx->flag & HASH_DONE)) {
+		nbytes = crypto_ahash_walk_done(&rctx->walk, 0);
+		if (nbytes < 0) {
+			err = nbytes;
+			goto out;
+		}
+		if (crypto_ahash_walk_last(&rctx->walk)) {
+			rctx->flag |= HASH_DONE;
+			if (rctx->flag & HASH_FINAL)
+				flag |= HASH_LAST;
+		}
+
+		sha_ctx = shash_desc_ctx(&rctx->desc);
+		kernel_neon_begin();
+		sha_ctx = sha256_ctx_mgr_submit(cstate->mgr, sha_ctx,
+						rctx->walk.data, nbytes, flag);
+		if (!sha_ctx && flush)
+			sha_ctx = sha256_ctx_mgr_flush(cstate->mgr);
+		kernel_neon_end();
+
+		if (!sha_ctx) {
+			rctx = NULL;
+			goto out;
+		}
+		rctx = cast_hash_to_mcryptd_ctx(sha_ctx);
+	}
+
+	if (rctx->flag & HASH_FINAL)
+		sha256_mb_set_results(rctx);
+
+out:
+	*ret_rctx = rctx;
+	return err;
+}
+
+static void sha_complete_req(struct mcryptd_hash_request_ctx *rctx,
+			     struct mcryptd_alg_cstate *cstate, int err)
+{
+	struct ahash_request *req = cast_mcryptd_ctx_to_req(rctx);
+
+	spin_lock(&cstate->work_lock);
+	list_del(&rctx->waiter);
+	spin_unlock(&cstate->work_lock);
+
+	if (irqs_disabled()) {
+		rctx->complete(&req->base, err);
+	} else {
+		local_bh_disable();
+		rctx->complete(&req->base, err);
+		local_bh_enable();
+	}
+}
+
+static void sha_complete_job(struct mcryptd_hash_request_ctx *rctx,
+			     struct mcryptd_alg_cstate *cstate, int err)
+{
+	struct sha256_hash_ctx *sha_ctx;
+	int ret;
+
+	sha_complete_req(rctx, cstate, err);
+
+	/* complete the other jobs that finished along with this one */
+	while ((sha_ctx = sha256_ctx_mgr_get_comp_ctx(cstate->mgr))) {
+		rctx = cast_hash_to_mcryptd_ctx(sha_ctx);
+		ret = sha_finish_walk(&rctx, cstate, false);
+		if (rctx)
+			sha_complete_req(rctx, cstate, ret);
+	}
+}
+
+static void sha256_mb_add_list(struct mcryptd_hash_request_ctx *rctx,
+			       struct mcryptd_alg_cstate *cstate)
+{
+	unsigned long delay = usecs_to_jiffies(FLUSH_INTERVAL);
+
+	rctx->tag.arrival = jiffies;
+	rctx->tag.seq_num = cstate->next_seq_num++;
+	rctx->tag.expire = rctx->tag.arrival + delay;
+
+	spin_lock(&cstate->work_lock);
+	list_add_tail(&rctx->waiter, &cstate->work_list);
+	spin_unlock(&cstate->work_lock);
+
+	mcryptd_arm_flusher(cstate, delay);
+}
+
+/*
+ * Common part of update, finup and final: queue the request and feed the
+ * first chunk of data to the context manager. The request completes from
+ * sha_complete_job(), either right here or when a later submission or the
+ * flusher gets its lane done.
+ */
+static int sha256_mb_submit(struct shash_desc *desc, u8 *out, bool final,
+			    bool nodata)
+{
+	struct mcryptd_hash_request_ctx *rctx =
+		container_of(desc, struct mcryptd_hash_request_ctx, desc);
+	struct mcryptd_alg_cstate *cstate =
+		this_cpu_ptr(sha256_mb_alg_state.alg_cstate);
+	struct ahash_request *req = cast_mcryptd_ctx_to_req(rctx);
+	struct sha256_hash_ctx *sha_ctx = shash_desc_ctx(desc);
+	int flag = HASH_UPDATE, ret = 0, nbytes = 0;
+	const u8 *data = NULL;
+	u8 dummy;
+
+	if (rctx->tag.cpu != smp_processor_id()) {
+		pr_err("mcryptd error: cpu clash\n");
+		goto done;
+	}
+
+	rctx->flag = HASH_UPDATE;
+	if (nodata) {
+		rctx->flag |= HASH_DONE;
+		data = &dummy;
+	} else {
+		nbytes = crypto_ahash_walk_first(req, &rctx->walk);
+		if (nbytes < 0) {
+			ret = nbytes;
+			goto done;
+		}
+		if (crypto_ahash_walk_last(&rctx->walk))
+			rctx->flag |= HASH_DONE;
+		data = rctx->walk.data;
+	}
+
+	if (final) {
+		rctx->out = out;
+		rctx->flag |= HASH_FINAL;
+		if (rctx->flag & HASH_DONE)
+			flag = HASH_LAST;
+	}
+
+	sha256_mb_add_list(rctx, cstate);
+
+	kernel_neon_begin();
+	sha_ctx = sha256_ctx_mgr_submit(cstate->mgr, sha_ctx, data, nbytes,
+					flag);
+	kernel_neon_end();
+
+	/* still in flight */
+	if (!sha_ctx)
+		return -EINPROGRESS;
+
+	rctx = cast_hash_to_mcryptd_ctx(sha_ctx);
+	if (sha_ctx->error) {
+		ret = sha_ctx->error;
+		goto done;
+	}
+
+	ret = sha_finish_walk(&rctx, cstate, false);
+	if (!rctx)
+		return -EINPROGRESS;
+done:
+	sha_complete_job(rctx, cstate, ret);
+	return ret;
+}
+
+static int sha256_mb_update(struct shash_desc *desc, const u8 *data,
+			    unsigned int len)
+{
+	return sha256_mb_submit(desc, NULL, false, false);
+}
+
+static int sha256_mb_finup(struct shash_desc *desc, const u8 *data,
+			   unsigned int len, u8 *out)
+{
+	return sha256_mb_submit(desc, out, true, false);
+}
+
+static int sha256_mb_final(struct shash_desc *desc, u8 *out)
+{
+	return sha256_mb_submit(desc, out, true, true);
+}
+
+static int sha256_mb_export(struct shash_desc *desc, void *out)
+{
+	struct sha256_hash_ctx *sctx = shash_desc_ctx(desc);
+
+	memcpy(out, sctx, sizeof(*sctx));
+	return 0;
+}
+
+static int sha256_mb_import(struct shash_desc *desc, const void *in)
+{
+	struct sha256_hash_ctx *sctx = shash_desc_ctx(desc);
+
+	memcpy(sctx, in, sizeof(*sctx));
+	return 0;
+}
+
+static struct shash_alg sha256_mb_shash_alg = {
+	.digestsize	= SHA256_DIGEST_SIZE,
+	.init		= sha256_mb_init,
+	.update		= sha256_mb_update,
+	.final		= sha256_mb_final,
+	.finup		= sha256_mb_finup,
+	.export		= sha256_mb_export,
+	.import		= sha256_mb_import,
+	.descsize	= sizeof(struct sha256_hash_ctx),
+	.statesize	= sizeof(struct sha256_hash_ctx),
+	.base		= {
+		.cra_name		= "__sha256-mb",
+		.cra_driver_name	= "__sha256-mb-neon",
+		.cra_priority		= 100,
+		/*
+		 * ASYNC, as some buffers may still be in flight in the lanes
+		 * when the hashing thread goes to sleep
+		 */
+		.cra_flags		= CRYPTO_ALG_TYPE_SHASH |
+					  CRYPTO_ALG_ASYNC |
+					  CRYPTO_ALG_INTERNAL,
+		.cra_blocksize		= SHA256_BLOCK_SIZE,
+		.cra_module		= THIS_MODULE,
+	}
+};
+
+static struct ahash_request *sha256_mb_async_req(struct ahash_request *req)
+{
+	struct sha256_mb_ctx *ctx = crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	struct ahash_request *mcryptd_req = ahash_request_ctx(req);
+
+	memcpy(mcryptd_req, req, sizeof(*req));
+	ahash_request_set_tfm(mcryptd_req, &ctx->mcryptd_tfm->base);
+	return mcryptd_req;
+}
+
+static int sha256_mb_async_init(struct ahash_request *req)
+{
+	return crypto_ahash_init(sha256_mb_async_req(req));
+}
+
+static int sha256_mb_async_update(struct ahash_request *req)
+{
+	return crypto_ahash_update(sha256_mb_async_req(req));
+}
+
+static int sha256_mb_async_finup(struct ahash_request *req)
+{
+	return crypto_ahash_finup(sha256_mb_async_req(req));
+}
+
+static int sha256_mb_async_final(struct ahash_request *req)
+{
+	return crypto_ahash_final(sha256_mb_async_req(req));
+}
+
+static int sha256_mb_async_digest(struct ahash_request *req)
+{
+	return crypto_ahash_digest(sha256_mb_async_req(req));
+}
+
+static int sha256_mb_async_init_tfm(struct crypto_tfm *tfm)
+{
+	struct sha256_mb_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct mcryptd_ahash *mcryptd_tfm;
+	struct mcryptd_hash_ctx *mctx;
+
+	mcryptd_tfm = mcryptd_alloc_ahash("__sha256-mb-neon",
+					  CRYPTO_ALG_INTERNAL,
+					  CRYPTO_ALG_INTERNAL);
+	if (IS_ERR(mcryptd_tfm))
+		return PTR_ERR(mcryptd_tfm);
+
+	mctx = crypto_ahash_ctx(&mcryptd_tfm->base);
+	mctx->alg_state = &sha256_mb_alg_state;
+	ctx->mcryptd_tfm = mcryptd_tfm;
+	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
+				 sizeof(struct ahash_request) +
+				 crypto_ahash_reqsize(&mcryptd_tfm->base));
+
+	return 0;
+}
+
+static void sha256_mb_async_exit_tfm(struct crypto_tfm *tfm)
+{
+	struct sha256_mb_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	mcryptd_free_ahash(ctx->mcryptd_tfm);
+}
+
+static struct ahash_alg sha256_mb_async_alg = {
+	.init		= sha256_mb_async_init,
+	.update		= sha256_mb_async_update,
+	.final		= sha256_mb_async_final,
+	.finup		= sha256_mb_async_finup,
+	.digest		= sha256_mb_async_digest,
+	.halg		= {
+		.digestsize	= SHA256_DIGEST_SIZE,
+		.base		= {
+			.cra_name		= "sha256",
+			.cra_driver_name	= "sha256_mb_neon",
+			.cra_priority		= 200,
+			.cra_flags		= CRYPTO_ALG_TYPE_AHASH |
+						  CRYPTO_ALG_ASYNC,
+			.cra_blocksize		= SHA256_BLOCK_SIZE,
+			.cra_type		= &crypto_ahash_type,
+			.cra_module		= THIS_MODULE,
+			.cra_init		= sha256_mb_async_init_tfm,
+			.cra_exit		= sha256_mb_async_exit_tfm,
+			.cra_ctxsize		= sizeof(struct sha256_mb_ctx),
+		},
+	},
+};
+
+/* called by mcryptd_flusher(): push out the requests that have expired */
+static unsigned long sha256_mb_flusher(struct mcryptd_alg_cstate *cstate)
+{
+	struct mcryptd_hash_request_ctx *rctx;
+	struct sha256_hash_ctx *sha_ctx;
+	unsigned long next_flush = 0;
+	unsigned long cur_time = jiffies;
+
+	while (!list_empty(&cstate->work_list)) {
+		rctx = list_entry(cstate->work_list.next,
+				  struct mcryptd_hash_request_ctx, waiter);
+		if (time_before(cur_time, rctx->tag.expire))
+			break;
+
+		kernel_neon_begin();
+		sha_ctx = sha256_ctx_mgr_flush(cstate->mgr);
+		kernel_neon_end();
+		if (!sha_ctx) {
+			pr_err("nothing got flushed for non-empty list\n");
+			break;
+		}
+
+		rctx = cast_hash_to_mcryptd_ctx(sha_ctx);
+		sha_finish_walk(&rctx, cstate, true);
+		sha_complete_job(rctx, cstate, 0);
+	}
+
+	if (!list_empty(&cstate->work_list)) {
+		rctx = list_entry(cstate->work_list.next,
+				  struct mcryptd_hash_request_ctx, waiter);
+		next_flush = rctx->tag.expire;
+		mcryptd_arm_flusher(cstate, get_delay(next_flush));
+	}
+
+	return next_flush;
+}
+
+static void sha256_mb_free_state(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		kfree(per_cpu_ptr(sha256_mb_alg_state.alg_cstate, cpu)->mgr);
+	free_percpu(sha256_mb_alg_state.alg_cstate);
+}
+
+static int __init sha256_mb_mod_init(void)
+{
+	struct mcryptd_alg_cstate *cpu_state;
+	int cpu, err;
+
+	if (!cpu_has_neon())
+		return -ENODEV;
+
+	sha256_mb_alg_state.alg_cstate =
+		alloc_percpu(struct mcryptd_alg_cstate);
+	if (!sha256_mb_alg_state.alg_cstate)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		cpu_state = per_cpu_ptr(sha256_mb_alg_state.alg_cstate, cpu);
+		cpu_state->next_flush = 0;
+		cpu_state->next_seq_num = 0;
+		cpu_state->flusher_engaged = false;
+		INIT_DELAYED_WORK(&cpu_state->flush, mcryptd_flusher);
+		cpu_state->cpu = cpu;
+		cpu_state->alg_state = &sha256_mb_alg_state;
+		cpu_state->mgr = kzalloc(sizeof(struct sha256_ctx_mgr),
+					 GFP_KERNEL);
+		if (!cpu_state->mgr) {
+			err = -ENOMEM;
+			goto err_free;
+		}
+		sha256_mb_mgr_init(cpu_state->mgr);
+		INIT_LIST_HEAD(&cpu_state->work_list);
+		spin_lock_init(&cpu_state->work_lock);
+	}
+	sha256_mb_alg_state.flusher = &sha256_mb_flusher;
+
+	err = crypto_register_shash(&sha256_mb_shash_alg);
+	if (err)
+		goto err_free;
+	err = crypto_register_ahash(&sha256_mb_async_alg);
+	if (err)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	crypto_unregister_shash(&sha256_mb_shash_alg);
+err_free:
+	sha256_mb_free_state();
+	return err;
+}
+
+static void __exit sha256_mb_mod_fini(void)
+{
+	crypto_unregister_ahash(&sha256_mb_async_alg);
+	crypto_unregister_shash(&sha256_mb_shash_alg);
+	sha256_mb_free_state();
+}
+
+module_init(sha256_mb_mod_init);
+module_exit(sha256_mb_mod_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("SHA-256 Secure Hash Algorithm, NEON multi-buffer");
+MODULE_ALIAS_CRYPTO("sha256");
+MODULE_ALIAS_CRYPTO("sha256_mb_neon");
@@ -0,0 +1,114 @@
+/*
+ * Multi-buffer SHA-256 algorithm, NEON lane manager
+ *
+ * Jobs are parked in free lanes until all four are busy; only then is
+ * sha256_x4_neon() run, for as many blocks as the shortest job has left,
+ * so that at least one job completes per call. A flush hashes whatever is
+ * there, with the idle lanes tagging along on the data of a busy one.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <linux/kernel.h>
+#include <linux/linkage.h>
+#include "sha256_mb_mgr.h"
+
+void sha256_mb_mgr_init(struct sha256_mb_mgr *state)
+{
+	int i;
+
+	state->unused_lanes = 0xf3210;
+	for (i = 0; i < SHA256_MB_LANES; i++) {
+		state->lens[i] = 0;
+		state->job_in_lane[i] = NULL;
+	}
+}
+
+static struct job_sha256 *sha256_mb_mgr_complete(struct sha256_mb_mgr *state,
+						 int lane)
+{
+	struct job_sha256 *job = state->job_in_lane[lane];
+	int j;
+
+	for (j = 0; j < SHA256_DIGEST_WORDS; j++)
+		job->result_digest[j] = state->args.digest[j][lane];
+	job->status = STS_COMPLETED;
+
+	state->job_in_lane[lane] = NULL;
+	state->unused_lanes = (state->unused_lanes << 4) | lane;
+
+	return job;
+}
+
+/*
+ * Return the busy lane with the fewest blocks left, running the NEON code
+ * until it has none left if @hash is set, or -1 if all lanes are idle, or
+ * if that lane is not done yet and @hash is clear.
+ */
+static int sha256_mb_mgr_min_lane(struct sha256_mb_mgr *state, bool hash)
+{
+	u32 min_len = U32_MAX;
+	int i, lane = -1;
+
+	for (i = 0; i < SHA256_MB_LANES; i++) {
+		if (state->job_in_lane[i] && state->lens[i] < min_len) {
+			min_len = state->lens[i];
+			lane = i;
+		}
+	}
+
+	if (lane < 0 || !min_len)
+		return lane;
+	if (!hash)
+		return -1;
+
+	for (i = 0; i < SHA256_MB_LANES; i++) {
+		if (state->job_in_lane[i])
+			state->lens[i] -= min_len;
+		else
+			state->args.data_ptr[i] = state->args.data_ptr[lane];
+	}
+	sha256_x4_neon(&state->args, min_len);
+
+	return lane;
+}
+
+struct job_sha256 *sha256_mb_mgr_submit(struct sha256_mb_mgr *state,
+					struct job_sha256 *job)
+{
+	int lane = state->unused_lanes & 0xf;
+	int j;
+
+	state->unused_lanes >>= 4;
+
+	job->status = STS_BEING_PROCESSED;
+	state->job_in_lane[lane] = job;
+	state->lens[lane] = job->len;
+	state->args.data_ptr[lane] = job->buffer;
+	for (j = 0; j < SHA256_DIGEST_WORDS; j++)
+		state->args.digest[j][lane] = job->result_digest[j];
+
+	/* wait for more jobs while a lane is free */
+	if (state->unused_lanes != 0xf)
+		return NULL;
+
+	return sha256_mb_mgr_complete(state,
+				      sha256_mb_mgr_min_lane(state, true));
+}
+
+struct job_sha256 *sha256_mb_mgr_flush(struct sha256_mb_mgr *state)
+{
+	int lane = sha256_mb_mgr_min_lane(state, true);
+
+	return lane < 0 ? NULL : sha256_mb_mgr_complete(state, lane);
+}
+
+struct job_sha256 *sha256_mb_mgr_get_comp_job(struct sha256_mb_mgr *state)
+{
+	int lane = sha256_mb_mgr_min_lane(state, false);
+
+	return lane < 0 ? NULL : sha256_mb_mgr_complete(state, lane);
+}
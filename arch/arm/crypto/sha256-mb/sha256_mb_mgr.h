@@ -0,0 +1,101 @@
+/*
+ * Multi-buffer SHA-256 algorithm, lane manager and hash context definitions
+ *
+ * The structure follows the x86_64 multi-buffer SHA1 implementation: the
+ * job manager owns the four NEON lanes and hashes whole blocks of up to
+ * four jobs at a time, and the context manager on top of it splits the
+ * user's data into blocks and handles the padding.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __SHA256_MB_MGR_H
+#define __SHA256_MB_MGR_H
+
+#include <linux/types.h>
+#include <crypto/sha.h>
+
+#define SHA256_MB_LANES		4
+#define SHA256_DIGEST_WORDS	8
+
+enum job_sts {
+	STS_UNKNOWN = 0,
+	STS_BEING_PROCESSED = 1,
+	STS_COMPLETED = 2,
+};
+
+struct job_sha256 {
+	const u8	*buffer;
+	/* number of 64 byte blocks at buffer */
+	u32		len;
+	u32		result_digest[SHA256_DIGEST_WORDS];
+	enum job_sts	status;
+};
+
+/* layout shared with sha256_x4_neon.S */
+struct sha256_args_x4 {
+	/* digest word j of lane l is at digest[j][l] */
+	u32		digest[SHA256_DIGEST_WORDS][SHA256_MB_LANES];
+	const u8	*data_ptr[SHA256_MB_LANES];
+};
+
+struct sha256_mb_mgr {
+	struct sha256_args_x4 args;
+	/* blocks left to hash in each lane */
+	u32 lens[SHA256_MB_LANES];
+	/* stack of free lane indices, one nibble each, 0xf terminated */
+	u32 unused_lanes;
+	struct job_sha256 *job_in_lane[SHA256_MB_LANES];
+};
+
+void sha256_mb_mgr_init(struct sha256_mb_mgr *state);
+struct job_sha256 *sha256_mb_mgr_submit(struct sha256_mb_mgr *state,
+					struct job_sha256 *job);
+struct job_sha256 *sha256_mb_mgr_flush(struct sha256_mb_mgr *state);
+struct job_sha256 *sha256_mb_mgr_get_comp_job(struct sha256_mb_mgr *state);
+
+asmlinkage void sha256_x4_neon(struct sha256_args_x4 *args,
+			       unsigned int blocks);
+
+/* flags passed to sha256_ctx_mgr_submit() */
+#define HASH_UPDATE		0x00
+#define HASH_FIRST		0x01
+#define HASH_LAST		0x02
+#define HASH_ENTIRE		0x03
+/* flags kept in mcryptd_hash_request_ctx.flag */
+#define HASH_DONE		0x04
+#define HASH_FINAL		0x08
+
+#define HASH_CTX_STS_IDLE	0x00
+#define HASH_CTX_STS_PROCESSING	0x01
+#define HASH_CTX_STS_LAST	0x02
+#define HASH_CTX_STS_COMPLETE	0x04
+
+enum hash_ctx_error {
+	HASH_CTX_ERROR_NONE = 0,
+	HASH_CTX_ERROR_INVALID_FLAGS = -1,
+	HASH_CTX_ERROR_ALREADY_PROCESSING = -2,
+	HASH_CTX_ERROR_ALREADY_COMPLETED = -3,
+};
+
+struct sha256_ctx_mgr {
+	struct sha256_mb_mgr mgr;
+};
+
+struct sha256_hash_ctx {
+	/* must be at offset 0, the job manager hands back the job */
+	struct job_sha256 job;
+	int		status;
+	int		error;
+
+	u64		total_length;
+	const u8	*incoming_buffer;
+	u32		incoming_buffer_length;
+	u8		partial_block_buffer[SHA256_BLOCK_SIZE * 2];
+	u32		partial_block_buffer_length;
+};
+
+#endif
@@ -34,3 +34,4 @@
 void kernel_neon_begin(void);
 #endif
 void kernel_neon_end(void);
+bool kernel_neon_usable(void);
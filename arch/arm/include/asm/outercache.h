@@ -30,6 +30,11 @@ struct outer_cache_fns {
 	void (*clean_range)(unsigned long, unsigned long);
 	void (*flush_range)(unsigned long, unsigned long);
 	void (*flush_all)(void);
+	/*
+	 * Size above which DMA may replace range maintenance by flush_all(),
+	 * zero if flush_all() is not safe to use with other CPUs running.
+	 */
+	unsigned long flush_all_size;
 	void (*disable)(void);
 #ifdef CONFIG_OUTER_CACHE_SYNC
 	void (*sync)(void);
@@ -94,6 +99,19 @@ static inline void outer_flush_all(void)
 		outer_cache.flush_all();
 }
 
+/**
+ * outer_flush_all_size - size from which outer_flush_all() beats ranges
+ *
+ * Returns zero if outer_flush_all() may not be used for DMA maintenance,
+ * in which case range operations must be used whatever the size.  When
+ * non-zero, outer_flush_all() is safe against other CPUs, but must still
+ * be called with interrupts disabled.
+ */
+static inline unsigned long outer_flush_all_size(void)
+{
+	return outer_cache.flush_all ? outer_cache.flush_all_size : 0;
+}
+
 /**
  * outer_disable - clean, invalidate and disable the outer cache
  *
@@ -124,6 +142,7 @@ static inline void outer_clean_range(phys_addr_t start, phys_addr_t end)
 static inline void outer_flush_range(phys_addr_t start, phys_addr_t end)
 { }
 static inline void outer_flush_all(void) { }
+static inline unsigned long outer_flush_all_size(void) { return 0; }
 static inline void outer_disable(void) { }
 static inline void outer_resume(void) { }
 
@@ -492,6 +492,8 @@ do {									\
 #ifdef CONFIG_MMU
 extern unsigned long __must_check
 arm_copy_from_user(void *to, const void __user *from, unsigned long n);
+extern unsigned long __must_check
+__copy_from_user_std(void *to, const void __user *from, unsigned long n);
 
 static inline unsigned long __must_check
 __copy_from_user(void *to, const void __user *from, unsigned long n)
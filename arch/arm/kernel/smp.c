@@ -27,6 +27,7 @@
 #include <linux/completion.h>
 #include <linux/cpufreq.h>
 #include <linux/irq_work.h>
+#include <linux/tick.h>
 
 #include <linux/atomic.h>
 #include <asm/smp.h>
@@ -597,6 +598,8 @@ void handle_IPI(int ipinr, struct pt_regs *regs)
 		__inc_irq_stat(cpu, ipi_irqs[ipinr]);
 	}
 
+	tick_nohz_full_interrupt("ipi", ipinr);
+
 	switch (ipinr) {
 	case IPI_WAKEUP:
 		break;
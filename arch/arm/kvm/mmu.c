@@ -50,6 +50,9 @@ static phys_addr_t hyp_idmap_vector;
 #define KVM_S2PTE_FLAG_IS_IOMAP		(1UL << 0)
 #define KVM_S2_FLAG_LOGGING_ACTIVE	(1UL << 1)
 
+/* Aligned block of pages around a PTE fault that is prefaulted as well */
+#define KVM_S2_FAULT_AROUND_PAGES	16
+
 static bool memslot_is_logging(struct kvm_memory_slot *memslot)
 {
 	return memslot->dirty_bitmap && !(memslot->flags & KVM_MEM_READONLY);
@@ -1208,6 +1211,88 @@ static void coherent_cache_guest_page(struct kvm_vcpu *vcpu, pfn_t pfn,
 	__coherent_cache_guest_page(vcpu, pfn, size, uncached);
 }
 
+/*
+ * A stage-2 block mapping of the PMD containing @hva is only correct if the
+ * whole block lies within the memslot, and the memslot has the same offset
+ * within a PMD in the userspace and in the IPA space. Otherwise the block
+ * would map memory that isn't part of the memslot, or more than a single
+ * THP, and we'd lose atomicity for unmapping, updates, and splits of the
+ * THP or other pages in the stage-2 block range.
+ */
+static bool fault_supports_stage2_pmd(struct kvm_memory_slot *memslot,
+				      unsigned long hva)
+{
+	gpa_t gpa_start = memslot->base_gfn << PAGE_SHIFT;
+	unsigned long uaddr_start = memslot->userspace_addr;
+	unsigned long uaddr_end = uaddr_start +
+				  (memslot->npages << PAGE_SHIFT);
+
+	if ((gpa_start & ~PMD_MASK) != (uaddr_start & ~PMD_MASK))
+		return false;
+
+	return (hva & PMD_MASK) >= uaddr_start &&
+	       (hva & PMD_MASK) + PMD_SIZE <= uaddr_end;
+}
+
+/*
+ * Map the pages around a PTE fault that are already resident in the host,
+ * so that a guest touching memory sequentially (zeroing at boot, reading a
+ * file) takes a stage-2 fault per block rather than per page. Only empty
+ * entries of the PTE table of the fault are filled; pages that would need
+ * a host fault are left to fault on their own. Called with mmu_lock held
+ * after mmu_notifier_retry() succeeded, which keeps the pages we find from
+ * being unmapped behind our back.
+ */
+static void stage2_fault_around(struct kvm_vcpu *vcpu,
+				struct kvm_memory_slot *memslot,
+				phys_addr_t fault_ipa, bool writable,
+				bool uncached)
+{
+	struct kvm *kvm = vcpu->kvm;
+	gfn_t fault_gfn = fault_ipa >> PAGE_SHIFT;
+	gfn_t gfn = fault_gfn & ~(gfn_t)(KVM_S2_FAULT_AROUND_PAGES - 1);
+	gfn_t end = gfn + KVM_S2_FAULT_AROUND_PAGES;
+	pmd_t *pmd;
+
+	pmd = stage2_get_pmd(kvm, NULL, fault_ipa);
+	if (!pmd || pmd_none(*pmd) || kvm_pmd_huge(*pmd))
+		return;
+
+	gfn = max(gfn, memslot->base_gfn);
+	end = min(end, memslot->base_gfn + memslot->npages);
+
+	for (; gfn < end; gfn++) {
+		pte_t *pte = pte_offset_kernel(pmd, gfn << PAGE_SHIFT);
+		pte_t new_pte;
+		pfn_t pfn;
+
+		if (gfn == fault_gfn || !pte_none(*pte))
+			continue;
+
+		/* only finds pages with a writable host mapping */
+		pfn = gfn_to_pfn_memslot_atomic(memslot, gfn);
+		if (is_error_noslot_pfn(pfn))
+			continue;
+		if (kvm_is_device_pfn(pfn)) {
+			kvm_release_pfn_clean(pfn);
+			continue;
+		}
+
+		new_pte = pfn_pte(pfn, PAGE_S2);
+		if (writable) {
+			kvm_set_s2pte_writable(&new_pte);
+			kvm_set_pfn_dirty(pfn);
+			mark_page_dirty(kvm, gfn);
+		}
+		coherent_cache_guest_page(vcpu, pfn, PAGE_SIZE, uncached);
+		kvm_set_pte(pte, new_pte);
+		get_page(virt_to_page(pte));
+
+		kvm_set_pfn_accessed(pfn);
+		kvm_release_pfn_clean(pfn);
+	}
+}
+
 static int user_mem_abort(struct kvm_vcpu *vcpu, phys_addr_t fault_ipa,
 			  struct kvm_memory_slot *memslot, unsigned long hva,
 			  unsigned long fault_status)
@@ -1240,22 +1325,11 @@ static int user_mem_abort(struct kvm_vcpu *vcpu, phys_addr_t fault_ipa,
 		return -EFAULT;
 	}
 
-	if (is_vm_hugetlb_page(vma) && !logging_active) {
+	if (!fault_supports_stage2_pmd(memslot, hva)) {
+		force_pte = true;
+	} else if (is_vm_hugetlb_page(vma) && !logging_active) {
 		hugetlb = true;
 		gfn = (fault_ipa & PMD_MASK) >> PAGE_SHIFT;
-	} else {
-		/*
-		 * Pages belonging to memslots that don't have the same
-		 * alignment for userspace and IPA cannot be mapped using
-		 * block descriptors even if the pages belong to a THP for
-		 * the process, because the stage-2 block descriptor will
-		 * cover more than a single THP and we loose atomicity for
-		 * unmapping, updates, and splits of the THP or other pages
-		 * in the stage-2 block range.
-		 */
-		if ((memslot->userspace_addr & ~PMD_MASK) !=
-		    ((memslot->base_gfn << PAGE_SHIFT) & ~PMD_MASK))
-			force_pte = true;
 	}
 	up_read(&current->mm->mmap_sem);
 
@@ -1329,6 +1403,10 @@ static int user_mem_abort(struct kvm_vcpu *vcpu, phys_addr_t fault_ipa,
 		}
 		coherent_cache_guest_page(vcpu, pfn, PAGE_SIZE, fault_ipa_uncached);
 		ret = stage2_set_pte(kvm, memcache, fault_ipa, &new_pte, flags);
+
+		if (!ret && !flags)
+			stage2_fault_around(vcpu, memslot, fault_ipa, writable,
+					    fault_ipa_uncached);
 	}
 
 out_unlock:
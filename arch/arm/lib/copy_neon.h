@@ -0,0 +1,22 @@
+/*
+ *  linux/arch/arm/lib/copy_neon.h
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+/*
+ * Copies of at least this size are done with NEON.  Entering kernel mode
+ * NEON costs saving the user's VFP register file when it is live, about
+ * as much as copying a few hundred bytes, so below a couple of KB the
+ * LDM/STM loop stays faster.  The value must be an ARM immediate.
+ */
+#define NEON_COPY_THRESHOLD	2048
+
+/* bytes moved per iteration of __copy_neon() */
+#define NEON_COPY_BLOCK		128
+
+#ifndef __ASSEMBLY__
+unsigned long __copy_neon(void *to, const void *from, unsigned long n);
+#endif
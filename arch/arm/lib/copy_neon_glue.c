@@ -0,0 +1,94 @@
+/*
+ *  linux/arch/arm/lib/copy_neon_glue.c
+ *
+ *  Large memcpy(), copy_from_user() and copy_to_user() using NEON
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/sizes.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <asm/neon.h>
+
+#include "copy_neon.h"
+
+/*
+ * kernel_neon_begin() disables preemption, so give the scheduler a
+ * chance between chunks of a very large copy.
+ */
+#define NEON_COPY_CHUNK		SZ_32K
+
+void *__memcpy_std(void *to, const void *from, size_t n);
+void *memcpy_neon_large(void *to, const void *from, size_t n);
+
+/* Returns the number of bytes copied, a multiple of NEON_COPY_BLOCK. */
+static unsigned long copy_neon(void *to, const void *from, unsigned long n)
+{
+	unsigned long done = 0;
+
+	if (!cpu_has_neon() || !kernel_neon_usable())
+		return 0;
+
+	while (n - done >= NEON_COPY_THRESHOLD) {
+		unsigned long chunk = min_t(unsigned long, n - done,
+					    NEON_COPY_CHUNK);
+		unsigned long left;
+
+		kernel_neon_begin();
+		left = __copy_neon(to + done, from + done, chunk);
+		kernel_neon_end();
+
+		done += chunk - left;
+		/* only a fault leaves a whole block behind */
+		if (left >= NEON_COPY_BLOCK)
+			break;
+	}
+
+	return done;
+}
+
+/* memcpy() branches here for copies of NEON_COPY_THRESHOLD or more */
+void *memcpy_neon_large(void *to, const void *from, size_t n)
+{
+	size_t done = copy_neon(to, from, n);
+
+	__memcpy_std(to + done, from + done, n - done);
+	return to;
+}
+
+/*
+ * The user copies run with page faults disabled so that a fault while
+ * NEON owns the CPU is only fixed up; the remainder then goes through
+ * the regular routines, which handle the fault properly.
+ */
+unsigned long
+arm_copy_from_user(void *to, const void __user *from, unsigned long n)
+{
+	unsigned long done = 0;
+
+	if (n >= NEON_COPY_THRESHOLD) {
+		pagefault_disable();
+		done = copy_neon(to, (const void __force *)from, n);
+		pagefault_enable();
+	}
+
+	return __copy_from_user_std(to + done, from + done, n - done);
+}
+
+unsigned long
+arm_copy_to_user(void __user *to, const void *from, unsigned long n)
+{
+	unsigned long done = 0;
+
+	if (n >= NEON_COPY_THRESHOLD) {
+		pagefault_disable();
+		done = copy_neon((void __force *)to, from, n);
+		pagefault_enable();
+	}
+
+	return __copy_to_user_std(to + done, from + done, n - done);
+}
@@ -17,3 +17,8 @@ extern char rockchip_secondary_trampoline;
 extern char rockchip_secondary_trampoline_end;
 
 extern unsigned long rockchip_boot_fn;
+
+#ifdef CONFIG_ARM_ROCKCHIP_CPUIDLE
+extern struct cpuidle_rockchip_data rockchip_cpuidle_data;
+int __init rockchip_cpuidle_init(void);
+#endif
@@ -24,10 +24,12 @@
 
 #include <linux/reset.h>
 #include <linux/cpu.h>
+#include <linux/platform_data/cpuidle-rockchip.h>
 #include <asm/cacheflush.h>
 #include <asm/cp15.h>
 #include <asm/smp_scu.h>
 #include <asm/smp_plat.h>
+#include <asm/suspend.h>
 #include <asm/mach/map.h>
 
 #include "core.h"
@@ -340,6 +342,156 @@ static void rockchip_cpu_die(unsigned int cpu)
 }
 #endif
 
+#ifdef CONFIG_ARM_ROCKCHIP_CPUIDLE
+/*
+ * Core power down from idle. A core cannot switch off its own power
+ * domain, so the secondary cores only flush their caches and park in
+ * wfi, while cpu0 does the actual power sequencing through the pmu.
+ * The power domains and resets are toggled directly here, as
+ * pmu_set_power_domain() looks up the reset controls and may sleep.
+ *
+ * rockchip_idle_parked is the mask of the cores that are parked. If they
+ * don't all show up in time, cpu0 sets ROCKCHIP_IDLE_ABORT, which sends
+ * the late ones back out of cpu_suspend(), and restarts the parked ones.
+ */
+#define ROCKCHIP_IDLE_TIMEOUT_US	1000
+#define ROCKCHIP_IDLE_ABORT		BIT(30)
+
+static struct reset_control *rockchip_idle_rstc[NR_CPUS];
+static atomic_t rockchip_idle_parked;
+
+static int rockchip_idle_set_core(int cpu, bool on)
+{
+	int timeout = ROCKCHIP_IDLE_TIMEOUT_US;
+	u32 val;
+
+	if (!on)
+		reset_control_assert(rockchip_idle_rstc[cpu]);
+
+	regmap_update_bits(pmu, PMU_PWRDN_CON, BIT(cpu), on ? 0 : BIT(cpu));
+	for (;;) {
+		regmap_read(pmu, PMU_PWRDN_ST, &val);
+		if (!!(val & BIT(cpu)) != on)
+			break;
+		if (!timeout--) {
+			pr_err("%s: core %d did not power %s\n", __func__, cpu,
+			       on ? "up" : "down");
+			return -ETIMEDOUT;
+		}
+		udelay(1);
+	}
+
+	if (on)
+		reset_control_deassert(rockchip_idle_rstc[cpu]);
+
+	return 0;
+}
+
+static int rockchip_idle_park_finisher(unsigned long cpu)
+{
+	int old;
+
+	do {
+		old = atomic_read(&rockchip_idle_parked);
+		/* cpu0 gave up on us */
+		if (old & ROCKCHIP_IDLE_ABORT)
+			return 1;
+	} while (atomic_cmpxchg(&rockchip_idle_parked, old,
+				old | BIT(cpu)) != old);
+
+	v7_exit_coherency_flush(louis);
+	while (1)
+		cpu_do_idle();
+
+	return 1;
+}
+
+static int rockchip_cpuidle_cpu_powerdown(void)
+{
+	/* returns 0 when cpu0 restarts the core through cpu_resume */
+	return cpu_suspend(smp_processor_id(), rockchip_idle_park_finisher);
+}
+
+static int rockchip_cpuidle_cpu0_enter_idle(void)
+{
+	int timeout = ROCKCHIP_IDLE_TIMEOUT_US;
+	int all = 0, parked, cpu, ret = 0;
+
+	for_each_online_cpu(cpu)
+		if (cpu)
+			all |= BIT(cpu);
+
+	while ((parked = atomic_read(&rockchip_idle_parked)) != all) {
+		if (!timeout--) {
+			parked = atomic_add_return(ROCKCHIP_IDLE_ABORT,
+						   &rockchip_idle_parked);
+			parked &= ~ROCKCHIP_IDLE_ABORT;
+			ret = -ETIMEDOUT;
+			break;
+		}
+		udelay(1);
+	}
+
+	if (!parked)
+		return ret;
+
+	/* let the parked cores finish exiting coherency, see cpu_kill */
+	udelay(10);
+
+	for_each_online_cpu(cpu)
+		if ((parked & BIT(cpu)) && rockchip_idle_set_core(cpu, false))
+			ret = -ETIMEDOUT;
+
+	if (!ret)
+		cpu_do_idle();
+
+	for_each_online_cpu(cpu)
+		if ((parked & BIT(cpu)) && rockchip_idle_set_core(cpu, true))
+			ret = -ETIMEDOUT;
+
+	/* same bootrom handshake as rockchip_boot_secondary */
+	mdelay(1);
+	writel(virt_to_phys(cpu_resume), sram_base_addr + 8);
+	writel(0xDEADBEAF, sram_base_addr + 4);
+	dsb_sev();
+
+	return ret;
+}
+
+static void rockchip_cpuidle_cpu0_exit_idle(void)
+{
+	atomic_set(&rockchip_idle_parked, 0);
+}
+
+struct cpuidle_rockchip_data rockchip_cpuidle_data = {
+	.cpu0_enter_idle	= rockchip_cpuidle_cpu0_enter_idle,
+	.cpu0_exit_idle		= rockchip_cpuidle_cpu0_exit_idle,
+	.cpu_powerdown		= rockchip_cpuidle_cpu_powerdown,
+};
+
+int __init rockchip_cpuidle_init(void)
+{
+	int cpu;
+
+	if (!pmu || !sram_base_addr ||
+	    read_cpuid_part() == ARM_CPU_PART_CORTEX_A9)
+		return -ENODEV;
+
+	for (cpu = 1; cpu < ncores; cpu++) {
+		rockchip_idle_rstc[cpu] = rockchip_get_core_reset(cpu);
+		if (IS_ERR(rockchip_idle_rstc[cpu])) {
+			pr_err("%s: could not get reset control for core %d\n",
+			       __func__, cpu);
+			while (--cpu > 0)
+				reset_control_put(rockchip_idle_rstc[cpu]);
+			return -ENODEV;
+		}
+	}
+
+	return 0;
+}
+#endif
+
 static struct smp_operations rockchip_smp_ops __initdata = {
 	.smp_prepare_cpus	= rockchip_smp_prepare_cpus,
 	.smp_boot_secondary	= rockchip_boot_secondary,
@@ -23,6 +23,7 @@
 #include <linux/clocksource.h>
 #include <linux/mfd/syscon.h>
 #include <linux/regmap.h>
+#include <linux/platform_data/cpuidle-rockchip.h>
 #include <asm/mach/arch.h>
 #include <asm/mach/map.h>
 #include <asm/hardware/cache-l2x0.h>
@@ -75,6 +76,14 @@ static void __init rockchip_dt_init(void)
 	rockchip_suspend_init();
 	of_platform_populate(NULL, of_default_bus_match_table, NULL, NULL);
 	platform_device_register_simple("cpufreq-dt", 0, NULL, 0);
+
+#ifdef CONFIG_ARM_ROCKCHIP_CPUIDLE
+	if (of_machine_is_compatible("rockchip,rk3288") &&
+	    !rockchip_cpuidle_init())
+		platform_device_register_data(NULL, "rockchip_cpuidle", -1,
+					      &rockchip_cpuidle_data,
+					      sizeof(rockchip_cpuidle_data));
+#endif
 }
 
 static const char * const rockchip_board_dt_compat[] = {
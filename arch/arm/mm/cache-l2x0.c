@@ -43,6 +43,8 @@ struct l2c_init_data {
 	void (*save)(void __iomem *);
 	void (*configure)(void __iomem *);
 	void (*unlock)(void __iomem *, unsigned);
+	/* way operations are serialised by l2x0_lock, so safe on SMP */
+	bool locked_way_ops;
 	struct outer_cache_fns outer_cache;
 };
 
@@ -414,6 +416,7 @@ static const struct l2c_init_data l2c220_data = {
 	.save = l2c_save,
 	.configure = l2c_configure,
 	.unlock = l2c220_unlock,
+	.locked_way_ops = true,
 	.outer_cache = {
 		.inv_range = l2c220_inv_range,
 		.clean_range = l2c220_clean_range,
@@ -867,6 +870,9 @@ static int __init __l2c_init(const struct l2c_init_data *data,
 	if (data->fixup)
 		data->fixup(l2x0_base, cache_id, &fns);
 
+	if (data->locked_way_ops || !IS_ENABLED(CONFIG_SMP))
+		fns.flush_all_size = l2x0_size;
+
 	/*
 	 * Check if l2x0 controller is already enabled.  If we are booting
 	 * in non-secure mode accessing the below registers will fault.
@@ -1106,6 +1112,7 @@ static const struct l2c_init_data of_l2c220_data __initconst = {
 	.save = l2c_save,
 	.configure = l2c_configure,
 	.unlock = l2c220_unlock,
+	.locked_way_ops = true,
 	.outer_cache = {
 		.inv_range   = l2c220_inv_range,
 		.clean_range = l2c220_clean_range,
@@ -1467,6 +1474,7 @@ static const struct l2c_init_data of_aurora_with_outer_data __initconst = {
 	.save  = aurora_save,
 	.configure = l2c_configure,
 	.unlock = l2c_unlock,
+	.locked_way_ops = true,
 	.outer_cache = {
 		.inv_range   = aurora_inv_range,
 		.clean_range = aurora_clean_range,
@@ -58,6 +58,8 @@ static void __dma_page_cpu_to_dev(struct page *, unsigned long,
 		size_t, enum dma_data_direction);
 static void __dma_page_dev_to_cpu(struct page *, unsigned long,
 		size_t, enum dma_data_direction);
+static void __dma_page_inner_dev_to_cpu(struct page *, unsigned long,
+		size_t, enum dma_data_direction);
 
 /**
  * arm_dma_map_page - map a portion of a page for streaming DMA
@@ -865,11 +867,17 @@ static void __dma_page_dev_to_cpu(struct page *page, unsigned long off,
 
 	/* FIXME: non-speculating: not required */
 	/* in any case, don't bother invalidating if DMA to device */
-	if (dir != DMA_TO_DEVICE) {
+	if (dir != DMA_TO_DEVICE)
 		outer_inv_range(paddr, paddr + size);
 
+	__dma_page_inner_dev_to_cpu(page, off, size, dir);
+}
+
+static void __dma_page_inner_dev_to_cpu(struct page *page, unsigned long off,
+	size_t size, enum dma_data_direction dir)
+{
+	if (dir != DMA_TO_DEVICE)
 		dma_cache_maint_page(page, off, size, dir, dmac_unmap_area);
-	}
 
 	/*
 	 * Mark the D-cache clean for these pages to avoid extra flushing.
@@ -892,6 +900,84 @@ static void __dma_page_dev_to_cpu(struct page *page, unsigned long off,
 	}
 }
 
+/*
+ * Cache maintenance for a whole scatterlist.  The inner cache is still
+ * handled entry by entry, but outer cache operations on physically
+ * adjacent entries are merged, and once the list covers at least as much
+ * as the outer cache holds they are replaced by a single flush_all(),
+ * where the outer cache implementation allows that.
+ */
+static void __dma_outer_sg(struct scatterlist *sg, int nents,
+	void (*op)(phys_addr_t, phys_addr_t))
+{
+	unsigned long limit = outer_flush_all_size();
+	phys_addr_t start = 0, end = 0;
+	struct scatterlist *s;
+	int i;
+
+	if (!IS_ENABLED(CONFIG_OUTER_CACHE))
+		return;
+
+	if (limit) {
+		size_t total = 0;
+
+		for_each_sg(sg, s, nents, i)
+			total += s->length;
+
+		if (total >= limit) {
+			unsigned long flags;
+
+			local_irq_save(flags);
+			outer_flush_all();
+			local_irq_restore(flags);
+			return;
+		}
+	}
+
+	for_each_sg(sg, s, nents, i) {
+		phys_addr_t paddr = sg_phys(s);
+
+		if (paddr != end) {
+			if (end != start)
+				op(start, end);
+			start = paddr;
+		}
+		end = paddr + s->length;
+	}
+	if (end != start)
+		op(start, end);
+}
+
+static void __dma_sg_cpu_to_dev(struct scatterlist *sg, int nents,
+	enum dma_data_direction dir)
+{
+	struct scatterlist *s;
+	int i;
+
+	for_each_sg(sg, s, nents, i)
+		dma_cache_maint_page(sg_page(s), s->offset, s->length, dir,
+				     dmac_map_area);
+
+	__dma_outer_sg(sg, nents, dir == DMA_FROM_DEVICE ?
+		       outer_inv_range : outer_clean_range);
+}
+
+static void __dma_sg_dev_to_cpu(struct scatterlist *sg, int nents,
+	enum dma_data_direction dir)
+{
+	struct scatterlist *s;
+	int i;
+
+	if (dir == DMA_TO_DEVICE)
+		return;
+
+	__dma_outer_sg(sg, nents, outer_inv_range);
+
+	for_each_sg(sg, s, nents, i)
+		__dma_page_inner_dev_to_cpu(sg_page(s), s->offset, s->length,
+					    dir);
+}
+
 /**
  * arm_dma_map_sg - map a set of SG buffers for streaming mode DMA
  * @dev: valid struct device pointer, or NULL for ISA and EISA-like devices
@@ -912,9 +998,20 @@ int arm_dma_map_sg(struct device *dev, struct scatterlist *sg, int nents,
 		enum dma_data_direction dir, struct dma_attrs *attrs)
 {
 	struct dma_map_ops *ops = get_dma_ops(dev);
+	DEFINE_DMA_ATTRS(batched_attrs);
 	struct scatterlist *s;
 	int i, j;
 
+	if (ops->map_page == arm_dma_map_page &&
+	    !dma_get_attr(DMA_ATTR_SKIP_CPU_SYNC, attrs)) {
+		__dma_sg_cpu_to_dev(sg, nents, dir);
+		/* keep the caller's other attributes */
+		if (attrs)
+			batched_attrs = *attrs;
+		dma_set_attr(DMA_ATTR_SKIP_CPU_SYNC, &batched_attrs);
+		attrs = &batched_attrs;
+	}
+
 	for_each_sg(sg, s, nents, i) {
 #ifdef CONFIG_NEED_SG_DMA_LENGTH
 		s->dma_length = s->length;
@@ -950,6 +1047,12 @@ void arm_dma_unmap_sg(struct device *dev, struct scatterlist *sg, int nents,
 
 	int i;
 
+	if (ops->unmap_page == arm_dma_unmap_page) {
+		if (!dma_get_attr(DMA_ATTR_SKIP_CPU_SYNC, attrs))
+			__dma_sg_dev_to_cpu(sg, nents, dir);
+		return;
+	}
+
 	for_each_sg(sg, s, nents, i)
 		ops->unmap_page(dev, sg_dma_address(s), sg_dma_len(s), dir, attrs);
 }
@@ -968,6 +1071,11 @@ void arm_dma_sync_sg_for_cpu(struct device *dev, struct scatterlist *sg,
 	struct scatterlist *s;
 	int i;
 
+	if (ops->sync_single_for_cpu == arm_dma_sync_single_for_cpu) {
+		__dma_sg_dev_to_cpu(sg, nents, dir);
+		return;
+	}
+
 	for_each_sg(sg, s, nents, i)
 		ops->sync_single_for_cpu(dev, sg_dma_address(s), s->length,
 					 dir);
@@ -987,6 +1095,11 @@ void arm_dma_sync_sg_for_device(struct device *dev, struct scatterlist *sg,
 	struct scatterlist *s;
 	int i;
 
+	if (ops->sync_single_for_device == arm_dma_sync_single_for_device) {
+		__dma_sg_cpu_to_dev(sg, nents, dir);
+		return;
+	}
+
 	for_each_sg(sg, s, nents, i)
 		ops->sync_single_for_device(dev, sg_dma_address(s), s->length,
 					    dir);
@@ -1502,10 +1615,17 @@ static int __map_sg_chunk(struct device *dev, struct scatterlist *sg,
 	struct dma_iommu_mapping *mapping = to_dma_iommu_mapping(dev);
 	dma_addr_t iova, iova_base;
 	int ret = 0;
-	unsigned int count;
+	unsigned int count, nents;
 	struct scatterlist *s;
+	bool whole_pages;
 	int prot;
 
+	/*
+	 * A chunk of whole pages can be handed to the IOMMU driver in one
+	 * go, which lets it batch its page table and TLB maintenance.
+	 */
+	whole_pages = !sg->offset && PAGE_ALIGNED(size);
+
 	size = PAGE_ALIGN(size);
 	*handle = DMA_ERROR_CODE;
 
@@ -1513,7 +1633,10 @@ static int __map_sg_chunk(struct device *dev, struct scatterlist *sg,
 	if (iova == DMA_ERROR_CODE)
 		return -ENOMEM;
 
-	for (count = 0, s = sg; count < (size >> PAGE_SHIFT); s = sg_next(s)) {
+	prot = __dma_direction_to_prot(dir);
+
+	for (count = 0, nents = 0, s = sg; count < (size >> PAGE_SHIFT);
+	     s = sg_next(s), nents++) {
 		phys_addr_t phys = sg_phys(s) & PAGE_MASK;
 		unsigned int len = PAGE_ALIGN(s->offset + s->length);
 
@@ -1521,13 +1644,20 @@ static int __map_sg_chunk(struct device *dev, struct scatterlist *sg,
 			!dma_get_attr(DMA_ATTR_SKIP_CPU_SYNC, attrs))
 			__dma_page_cpu_to_dev(sg_page(s), s->offset, s->length, dir);
 
-		prot = __dma_direction_to_prot(dir);
-
-		ret = iommu_map(mapping->domain, iova, phys, len, prot);
-		if (ret < 0)
-			goto fail;
+		if (!whole_pages) {
+			ret = iommu_map(mapping->domain, iova, phys, len, prot);
+			if (ret < 0)
+				goto fail;
+			iova += len;
+		}
 		count += len >> PAGE_SHIFT;
-		iova += len;
+	}
+
+	if (whole_pages &&
+	    iommu_map_sg(mapping->domain, iova_base, sg, nents, prot) < size) {
+		/* iommu_map_sg() has already undone any partial mapping */
+		__free_iova(mapping, iova_base, size);
+		return -ENOMEM;
 	}
 	*handle = iova_base;
 
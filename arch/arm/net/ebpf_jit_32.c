@@ -0,0 +1,1502 @@
+/*
+ * Just-In-Time compiler for eBPF filters on 32bit ARM (ARMv7)
+ *
+ * Based on the ARM64 eBPF JIT and on the classic BPF JIT for 32bit ARM.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; version 2 of the License.
+ */
+
+#define pr_fmt(fmt) "bpf_jit: " fmt
+
+#include <linux/bitops.h>
+#include <linux/bpf.h>
+#include <linux/compiler.h>
+#include <linux/errno.h>
+#include <linux/filter.h>
+#include <linux/math64.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include <asm/cacheflush.h>
+#include <asm/hwcap.h>
+#include <asm/opcodes.h>
+#include <asm/unaligned.h>
+
+#include "bpf_jit_32.h"
+
+/*
+ * eBPF registers are 64 bits wide, so each of them is mapped onto a pair
+ * of ARM core registers, {hi, lo}.  There are not enough core registers
+ * for all of them: the ones that do not fit live in a scratch area of the
+ * JIT stack frame and are loaded into the temporary pairs on use.
+ *
+ * ABI:
+ *
+ * r0-r1	BPF R0, return value of helpers and of the program
+ * r2-r3	BPF R1, context pointer on entry
+ * r4-r5	BPF R6
+ * r6-r7	BPF R7
+ * r8-r9	temporary pair TMP_REG_1
+ * r10, ip	temporary pair TMP_REG_2
+ * lr		scratch register
+ *
+ * Stack layout, from sp upwards:
+ *
+ *	outgoing arguments 3-5 of helper calls	(OUTARGS_SIZE)
+ *	eBPF program stack			(MAX_BPF_STACK)
+ *	scratch area for the stacked registers	(SCRATCH_SIZE)
+ *	padding and callee saved registers
+ *
+ * The eBPF frame pointer points at the top of the eBPF program stack.
+ */
+
+#define TMP_REG_1	(MAX_BPF_REG + 0)	/* TEMP Register 1 */
+#define TMP_REG_2	(MAX_BPF_REG + 1)	/* TEMP Register 2 */
+
+/* slots of the scratch area, two per stacked eBPF register */
+enum {
+	BPF_R2_HI,
+	BPF_R2_LO,
+	BPF_R3_HI,
+	BPF_R3_LO,
+	BPF_R4_HI,
+	BPF_R4_LO,
+	BPF_R5_HI,
+	BPF_R5_LO,
+	BPF_R8_HI,
+	BPF_R8_LO,
+	BPF_R9_HI,
+	BPF_R9_LO,
+	BPF_FP_HI,
+	BPF_FP_LO,
+	BPF_TC,		/* tail call count */
+	BPF_JIT_SCRATCH_REGS,
+};
+
+/* negative register numbers denote slots of the scratch area */
+#define STACK_SLOT(k)		(-1 - (k))
+
+#define OUTARGS_SIZE		(3 * 8)
+#define SCRATCH_SIZE		(BPF_JIT_SCRATCH_REGS * 4)
+#define SCRATCH_OFF(k)		(OUTARGS_SIZE + MAX_BPF_STACK + 4 * (k))
+
+#define CALLEE_MASK		(1 << ARM_R4 | 1 << ARM_R5 | 1 << ARM_R6 | \
+				 1 << ARM_R7 | 1 << ARM_R8 | 1 << ARM_R9 | \
+				 1 << ARM_R10)
+#ifdef CONFIG_FRAME_POINTER
+#define CALLEE_PUSH_MASK	(CALLEE_MASK | 1 << ARM_FP | 1 << ARM_IP | \
+				 1 << ARM_LR | 1 << ARM_PC)
+/* the first instruction of the prologue is: mov ip, sp */
+#define CALLEE_POP_MASK		(CALLEE_MASK | 1 << ARM_FP | 1 << ARM_SP | \
+				 1 << ARM_PC)
+#else
+#define CALLEE_PUSH_MASK	(CALLEE_MASK | 1 << ARM_LR)
+#define CALLEE_POP_MASK		(CALLEE_MASK | 1 << ARM_PC)
+#endif
+
+#define CALLEE_PUSH_SIZE	(4 * hweight16(CALLEE_PUSH_MASK))
+
+/* keep sp 8 byte aligned for the helpers, as required by the AAPCS */
+#define STACK_SIZE		(ALIGN(CALLEE_PUSH_SIZE + SCRATCH_OFF(	\
+				 BPF_JIT_SCRATCH_REGS), 8) - CALLEE_PUSH_SIZE)
+
+static const s8 bpf2a32[][2] = {
+	/* return value from in-kernel function, and exit value from eBPF */
+	[BPF_REG_0] = {ARM_R1, ARM_R0},
+	/* arguments from eBPF program to in-kernel function */
+	[BPF_REG_1] = {ARM_R3, ARM_R2},
+	[BPF_REG_2] = {STACK_SLOT(BPF_R2_HI), STACK_SLOT(BPF_R2_LO)},
+	[BPF_REG_3] = {STACK_SLOT(BPF_R3_HI), STACK_SLOT(BPF_R3_LO)},
+	[BPF_REG_4] = {STACK_SLOT(BPF_R4_HI), STACK_SLOT(BPF_R4_LO)},
+	[BPF_REG_5] = {STACK_SLOT(BPF_R5_HI), STACK_SLOT(BPF_R5_LO)},
+	/* callee saved registers that in-kernel function will preserve */
+	[BPF_REG_6] = {ARM_R5, ARM_R4},
+	[BPF_REG_7] = {ARM_R7, ARM_R6},
+	[BPF_REG_8] = {STACK_SLOT(BPF_R8_HI), STACK_SLOT(BPF_R8_LO)},
+	[BPF_REG_9] = {STACK_SLOT(BPF_R9_HI), STACK_SLOT(BPF_R9_LO)},
+	/* read-only frame pointer to access stack */
+	[BPF_REG_FP] = {STACK_SLOT(BPF_FP_HI), STACK_SLOT(BPF_FP_LO)},
+	/* temporary registers for internal BPF JIT */
+	[TMP_REG_1] = {ARM_R9, ARM_R8},
+	[TMP_REG_2] = {ARM_R10, ARM_IP},
+};
+
+struct jit_ctx {
+	const struct bpf_prog *prog;
+	unsigned int idx;
+	unsigned int prologue_bytes;
+	unsigned int epilogue_offset;
+	u32 *offsets;
+	u32 *target;
+};
+
+/*
+ * Wrappers for the operations the CPU cannot do by itself. They also
+ * take care of OABI/EABI and Thumb2 interworking.
+ */
+static u32 jit_udiv32(u32 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+
+static u32 jit_mod32(u32 dividend, u32 divisor)
+{
+	return dividend % divisor;
+}
+
+static u64 jit_udiv64(u64 dividend, u64 divisor)
+{
+	return div64_u64(dividend, divisor);
+}
+
+static u64 jit_mod64(u64 dividend, u64 divisor)
+{
+	u64 rem;
+
+	div64_u64_rem(dividend, divisor, &rem);
+	return rem;
+}
+
+/*
+ * Slow path of BPF_LD | BPF_ABS and BPF_LD | BPF_IND. The upper word of
+ * the result is non zero when the load failed.
+ */
+static u64 jit_load_skb(const struct sk_buff *skb, int k, unsigned int size)
+{
+	void *ptr;
+	u32 buf;
+
+	ptr = bpf_load_pointer(skb, k, size, &buf);
+	if (unlikely(!ptr))
+		return (u64)1 << 32;
+
+	switch (size) {
+	case 1:
+		return *(u8 *)ptr;
+	case 2:
+		return get_unaligned_be16(ptr);
+	default:
+		return get_unaligned_be32(ptr);
+	}
+}
+
+static inline void _emit(int cond, u32 inst, struct jit_ctx *ctx)
+{
+	inst |= (cond << 28);
+	inst = __opcode_to_mem_arm(inst);
+
+	if (ctx->target != NULL)
+		ctx->target[ctx->idx] = inst;
+
+	ctx->idx++;
+}
+
+/*
+ * Emit an instruction that will be executed unconditionally.
+ */
+static inline void emit(u32 inst, struct jit_ctx *ctx)
+{
+	_emit(ARM_COND_AL, inst, ctx);
+}
+
+static int16_t imm8m(u32 x)
+{
+	u32 rot;
+
+	for (rot = 0; rot < 16; rot++)
+		if ((x & ~ror32(0xff, 2 * rot)) == 0)
+			return rol32(x, 2 * rot) | (rot << 8);
+
+	return -1;
+}
+
+static void jit_fill_hole(void *area, unsigned int size)
+{
+	u32 *ptr;
+	/* We are guaranteed to have aligned memory. */
+	for (ptr = area; size >= sizeof(u32); size -= sizeof(u32))
+		*ptr++ = __opcode_to_mem_arm(ARM_INST_UDF);
+}
+
+/* PC in ARM mode == address of the instruction + 8 */
+static inline s32 bpf2a32_offset(int bpf_to, const struct jit_ctx *ctx)
+{
+	if (ctx->target == NULL)
+		return 0;
+
+	return ctx->offsets[bpf_to] - (ctx->idx + 2);
+}
+
+static inline s32 epilogue_offset(const struct jit_ctx *ctx)
+{
+	if (ctx->target == NULL)
+		return 0;
+
+	return ctx->epilogue_offset - (ctx->idx + 2);
+}
+
+/*
+ * Forward branches inside the code of a single eBPF instruction are
+ * emitted with a zero offset and patched once the target is reached.
+ */
+static void resolve_branch(unsigned int from, struct jit_ctx *ctx)
+{
+	u32 inst;
+
+	if (ctx->target == NULL)
+		return;
+
+	inst = __mem_to_opcode_arm(ctx->target[from]) & ~0xffffff;
+	inst |= (ctx->idx - (from + 2)) & 0xffffff;
+	ctx->target[from] = __opcode_to_mem_arm(inst);
+}
+
+static inline void emit_mov_i(int rd, u32 val, struct jit_ctx *ctx)
+{
+	int imm12 = imm8m(val);
+
+	if (imm12 >= 0) {
+		emit(ARM_MOV_I(rd, imm12), ctx);
+		return;
+	}
+
+	imm12 = imm8m(~val);
+	if (imm12 >= 0) {
+		emit(ARM_MVN_I(rd, imm12), ctx);
+		return;
+	}
+
+	emit(ARM_MOVW(rd, val & 0xffff), ctx);
+	if (val > 0xffff)
+		emit(ARM_MOVT(rd, val >> 16), ctx);
+}
+
+/* rd = rn + val, lr is used for values that are not an imm8m */
+static void emit_add_i(int rd, int rn, s32 val, struct jit_ctx *ctx)
+{
+	int imm12;
+
+	imm12 = imm8m(val);
+	if (imm12 >= 0) {
+		emit(ARM_ADD_I(rd, rn, imm12), ctx);
+		return;
+	}
+
+	imm12 = imm8m(-val);
+	if (imm12 >= 0) {
+		emit(ARM_SUB_I(rd, rn, imm12), ctx);
+		return;
+	}
+
+	emit_mov_i(ARM_LR, val, ctx);
+	emit(ARM_ADD_R(rd, rn, ARM_LR), ctx);
+}
+
+static inline bool is_stacked(s8 reg)
+{
+	return reg < 0;
+}
+
+static inline int stack_off(s8 reg)
+{
+	return SCRATCH_OFF(-1 - reg);
+}
+
+/*
+ * Return the core register holding one half of an eBPF register, loading
+ * it into tmp first when it lives on the stack.
+ */
+static s8 arm_bpf_get_reg32(s8 reg, s8 tmp, struct jit_ctx *ctx)
+{
+	if (is_stacked(reg)) {
+		emit(ARM_LDR_I(tmp, ARM_SP, stack_off(reg)), ctx);
+		reg = tmp;
+	}
+	return reg;
+}
+
+static void arm_bpf_put_reg32(s8 reg, s8 src, struct jit_ctx *ctx)
+{
+	if (is_stacked(reg))
+		emit(ARM_STR_I(src, ARM_SP, stack_off(reg)), ctx);
+	else if (reg != src)
+		emit(ARM_MOV_R(reg, src), ctx);
+}
+
+static const s8 *arm_bpf_get_reg64(const s8 *reg, const s8 *tmp,
+				   struct jit_ctx *ctx)
+{
+	if (is_stacked(reg[1])) {
+		emit(ARM_LDR_I(tmp[1], ARM_SP, stack_off(reg[1])), ctx);
+		emit(ARM_LDR_I(tmp[0], ARM_SP, stack_off(reg[0])), ctx);
+		reg = tmp;
+	}
+	return reg;
+}
+
+static void arm_bpf_put_reg64(const s8 *reg, const s8 *src,
+			      struct jit_ctx *ctx)
+{
+	if (is_stacked(reg[1])) {
+		emit(ARM_STR_I(src[1], ARM_SP, stack_off(reg[1])), ctx);
+		emit(ARM_STR_I(src[0], ARM_SP, stack_off(reg[0])), ctx);
+	} else {
+		if (reg[1] != src[1])
+			emit(ARM_MOV_R(reg[1], src[1]), ctx);
+		if (reg[0] != src[0])
+			emit(ARM_MOV_R(reg[0], src[0]), ctx);
+	}
+}
+
+static void emit_a32_mov_i(s8 dst, u32 val, struct jit_ctx *ctx)
+{
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+
+	if (is_stacked(dst)) {
+		emit_mov_i(tmp[1], val, ctx);
+		arm_bpf_put_reg32(dst, tmp[1], ctx);
+	} else {
+		emit_mov_i(dst, val, ctx);
+	}
+}
+
+static void emit_a32_mov_i64(const s8 *dst, u64 val, struct jit_ctx *ctx)
+{
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+	const s8 *rd = is_stacked(dst[1]) ? tmp : dst;
+
+	emit_mov_i(rd[1], (u32)val, ctx);
+	emit_mov_i(rd[0], val >> 32, ctx);
+
+	arm_bpf_put_reg64(dst, rd, ctx);
+}
+
+/* dst = imm, sign extended to 64 bits for ALU64 */
+static void emit_a32_mov_se_i64(bool is64, const s8 *dst, s32 imm,
+				struct jit_ctx *ctx)
+{
+	u64 val = (u32)imm;
+
+	if (is64 && imm < 0)
+		val |= 0xffffffff00000000ULL;
+
+	emit_a32_mov_i64(dst, val, ctx);
+}
+
+/* Materialize an immediate operand into TMP_REG_2 */
+static const s8 *emit_a32_imm_operand(bool is64, s32 imm,
+				      struct jit_ctx *ctx)
+{
+	const s8 *tmp2 = bpf2a32[TMP_REG_2];
+
+	if (is64)
+		emit_a32_mov_se_i64(true, tmp2, imm, ctx);
+	else
+		emit_mov_i(tmp2[1], imm, ctx);
+
+	return tmp2;
+}
+
+static void emit_a32_mov_r64(bool is64, const s8 *dst, const s8 *src,
+			     struct jit_ctx *ctx)
+{
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+
+	if (!is64) {
+		arm_bpf_put_reg32(dst[1],
+				  arm_bpf_get_reg32(src[1], tmp[0], ctx), ctx);
+		emit_a32_mov_i(dst[0], 0, ctx);
+		return;
+	}
+
+	arm_bpf_put_reg64(dst, arm_bpf_get_reg64(src, tmp, ctx), ctx);
+}
+
+/* rd = rd OP rn, hi selects the upper half of a 64-bit operation */
+static void emit_alu_r(s8 rd, s8 rn, bool is64, bool hi, u8 op,
+		       struct jit_ctx *ctx)
+{
+	switch (op) {
+	case BPF_ADD:
+		if (!is64)
+			emit(ARM_ADD_R(rd, rd, rn), ctx);
+		else if (hi)
+			emit(ARM_ADC_R(rd, rd, rn), ctx);
+		else
+			emit(ARM_ADDS_R(rd, rd, rn), ctx);
+		break;
+	case BPF_SUB:
+		if (!is64)
+			emit(ARM_SUB_R(rd, rd, rn), ctx);
+		else if (hi)
+			emit(ARM_SBC_R(rd, rd, rn), ctx);
+		else
+			emit(ARM_SUBS_R(rd, rd, rn), ctx);
+		break;
+	case BPF_OR:
+		emit(ARM_ORR_R(rd, rd, rn), ctx);
+		break;
+	case BPF_AND:
+		emit(ARM_AND_R(rd, rd, rn), ctx);
+		break;
+	case BPF_XOR:
+		emit(ARM_EOR_R(rd, rd, rn), ctx);
+		break;
+	/* the ones below are only used for 32-bit operations */
+	case BPF_MUL:
+		emit(ARM_MUL(rd, rd, rn), ctx);
+		break;
+	case BPF_LSH:
+		emit(ARM_LSL_R(rd, rd, rn), ctx);
+		break;
+	case BPF_RSH:
+		emit(ARM_LSR_R(rd, rd, rn), ctx);
+		break;
+	case BPF_ARSH:
+		emit(ARM_ASR_R(rd, rd, rn), ctx);
+		break;
+	}
+}
+
+/* dst = dst OP src */
+static void emit_a32_alu_r64(bool is64, const s8 *dst, const s8 *src,
+			     u8 op, struct jit_ctx *ctx)
+{
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+	const s8 *tmp2 = bpf2a32[TMP_REG_2];
+	const s8 *rs, *rd;
+	s8 rn, rt;
+
+	if (!is64) {
+		rn = arm_bpf_get_reg32(src[1], tmp2[1], ctx);
+		rt = arm_bpf_get_reg32(dst[1], tmp[1], ctx);
+		emit_alu_r(rt, rn, false, false, op, ctx);
+		arm_bpf_put_reg32(dst[1], rt, ctx);
+		emit_a32_mov_i(dst[0], 0, ctx);
+		return;
+	}
+
+	rs = arm_bpf_get_reg64(src, tmp2, ctx);
+	rd = arm_bpf_get_reg64(dst, tmp, ctx);
+	emit_alu_r(rd[1], rs[1], true, false, op, ctx);
+	emit_alu_r(rd[0], rs[0], true, true, op, ctx);
+	arm_bpf_put_reg64(dst, rd, ctx);
+}
+
+/* dst = dst * src, low 64 bits of the product */
+static void emit_a32_mul_r64(const s8 *dst, const s8 *src,
+			     struct jit_ctx *ctx)
+{
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+	const s8 *tmp2 = bpf2a32[TMP_REG_2];
+	const s8 *rs, *rd;
+
+	rs = arm_bpf_get_reg64(src, tmp2, ctx);
+	rd = arm_bpf_get_reg64(dst, tmp, ctx);
+
+	/* hi = lo * src_hi + hi * src_lo + (lo * src_lo) >> 32 */
+	emit(ARM_MUL(ARM_LR, rd[0], rs[1]), ctx);
+	emit(ARM_MUL(rd[0], rd[1], rs[0]), ctx);
+	emit(ARM_ADD_R(rd[0], rd[0], ARM_LR), ctx);
+	emit(ARM_UMULL(rd[1], ARM_LR, rd[1], rs[1]), ctx);
+	emit(ARM_ADD_R(rd[0], rd[0], ARM_LR), ctx);
+
+	arm_bpf_put_reg64(dst, rd, ctx);
+}
+
+/* dst = dst OP imm, 32-bit shifts by an immediate */
+static void emit_a32_shift_i(s8 dst, u32 imm, u8 op, struct jit_ctx *ctx)
+{
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+	s8 rd;
+
+	/* LSR #0 and ASR #0 actually encode a shift by 32 */
+	if (!imm)
+		return;
+
+	rd = arm_bpf_get_reg32(dst, tmp[1], ctx);
+	switch (op) {
+	case BPF_LSH:
+		emit(ARM_LSL_I(rd, rd, imm), ctx);
+		break;
+	case BPF_RSH:
+		emit(ARM_LSR_I(rd, rd, imm), ctx);
+		break;
+	case BPF_ARSH:
+		emit(ARM_ASR_I(rd, rd, imm), ctx);
+		break;
+	}
+	arm_bpf_put_reg32(dst, rd, ctx);
+}
+
+/* dst = dst OP imm, 64-bit shifts by an immediate in [1, 63] */
+static void emit_a32_shift_i64(const s8 *dst, u32 imm, u8 op,
+			       struct jit_ctx *ctx)
+{
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+	const s8 *rd;
+
+	if (!imm)
+		return;
+
+	rd = arm_bpf_get_reg64(dst, tmp, ctx);
+	switch (op) {
+	case BPF_LSH:
+		if (imm < 32) {
+			emit(ARM_LSL_I(rd[0], rd[0], imm), ctx);
+			emit(ARM_ORR_S(rd[0], rd[0], rd[1], SRTYPE_LSR,
+				       32 - imm), ctx);
+			emit(ARM_LSL_I(rd[1], rd[1], imm), ctx);
+		} else {
+			emit(ARM_LSL_I(rd[0], rd[1], imm - 32), ctx);
+			emit(ARM_MOV_I(rd[1], 0), ctx);
+		}
+		break;
+	case BPF_RSH:
+		if (imm < 32) {
+			emit(ARM_LSR_I(rd[1], rd[1], imm), ctx);
+			emit(ARM_ORR_S(rd[1], rd[1], rd[0], SRTYPE_LSL,
+				       32 - imm), ctx);
+			emit(ARM_LSR_I(rd[0], rd[0], imm), ctx);
+		} else {
+			if (imm == 32)
+				emit(ARM_MOV_R(rd[1], rd[0]), ctx);
+			else
+				emit(ARM_LSR_I(rd[1], rd[0], imm - 32), ctx);
+			emit(ARM_MOV_I(rd[0], 0), ctx);
+		}
+		break;
+	case BPF_ARSH:
+		if (imm < 32) {
+			emit(ARM_LSR_I(rd[1], rd[1], imm), ctx);
+			emit(ARM_ORR_S(rd[1], rd[1], rd[0], SRTYPE_LSL,
+				       32 - imm), ctx);
+			emit(ARM_ASR_I(rd[0], rd[0], imm), ctx);
+		} else {
+			if (imm == 32)
+				emit(ARM_MOV_R(rd[1], rd[0]), ctx);
+			else
+				emit(ARM_ASR_I(rd[1], rd[0], imm - 32), ctx);
+			emit(ARM_ASR_I(rd[0], rd[0], 31), ctx);
+		}
+		break;
+	}
+	arm_bpf_put_reg64(dst, rd, ctx);
+}
+
+/*
+ * dst = dst OP src, 64-bit shifts by a register. Register specified
+ * shifts by 32 or more yield 0 (or the sign for ASR), which takes care of
+ * the words crossing over.
+ */
+static void emit_a32_shift_r64(const s8 *dst, const s8 *src, u8 op,
+			       struct jit_ctx *ctx)
+{
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+	const s8 *tmp2 = bpf2a32[TMP_REG_2];
+	const s8 *rd;
+	s8 rt;
+
+	rt = arm_bpf_get_reg32(src[1], tmp2[1], ctx);
+	rd = arm_bpf_get_reg64(dst, tmp, ctx);
+
+	/* the shift amount must survive the update of the low word */
+	if (rt == rd[1]) {
+		emit(ARM_MOV_R(tmp2[1], rt), ctx);
+		rt = tmp2[1];
+	}
+
+	/* lr = n - 32, tmp2[0] = 32 - n */
+	emit(ARM_SUBS_I(ARM_LR, rt, 32), ctx);
+	emit(ARM_RSB_I(tmp2[0], rt, 32), ctx);
+
+	switch (op) {
+	case BPF_LSH:
+		emit(ARM_LSL_R(rd[0], rd[0], rt), ctx);
+		emit(ARM_ORR_SR(rd[0], rd[0], rd[1], SRTYPE_LSL, ARM_LR), ctx);
+		emit(ARM_ORR_SR(rd[0], rd[0], rd[1], SRTYPE_LSR, tmp2[0]),
+		     ctx);
+		emit(ARM_LSL_R(rd[1], rd[1], rt), ctx);
+		break;
+	case BPF_RSH:
+		emit(ARM_LSR_R(rd[1], rd[1], rt), ctx);
+		emit(ARM_ORR_SR(rd[1], rd[1], rd[0], SRTYPE_LSL, tmp2[0]),
+		     ctx);
+		emit(ARM_ORR_SR(rd[1], rd[1], rd[0], SRTYPE_LSR, ARM_LR), ctx);
+		emit(ARM_LSR_R(rd[0], rd[0], rt), ctx);
+		break;
+	case BPF_ARSH:
+		emit(ARM_LSR_R(rd[1], rd[1], rt), ctx);
+		emit(ARM_ORR_SR(rd[1], rd[1], rd[0], SRTYPE_LSL, tmp2[0]),
+		     ctx);
+		/* only when n >= 32, a negative lr would fill in the sign */
+		_emit(ARM_COND_PL,
+		      ARM_ORR_SR(rd[1], rd[1], rd[0], SRTYPE_ASR, ARM_LR), ctx);
+		emit(ARM_ASR_R(rd[0], rd[0], rt), ctx);
+		break;
+	}
+	arm_bpf_put_reg64(dst, rd, ctx);
+}
+
+/* The program returns 0 on a division by zero, like the interpreter. */
+static void emit_a32_ret0_if_eq(struct jit_ctx *ctx)
+{
+	const s8 *r0 = bpf2a32[BPF_REG_0];
+
+	_emit(ARM_COND_EQ, ARM_MOV_I(r0[1], 0), ctx);
+	_emit(ARM_COND_EQ, ARM_MOV_I(r0[0], 0), ctx);
+	_emit(ARM_COND_EQ, ARM_B(epilogue_offset(ctx)), ctx);
+}
+
+/*
+ * Call one of the division helpers. r0-r3 hold BPF R0 and R1 and are
+ * saved around the call; the operands go through the stack so that any
+ * of them may live in r0-r3 too.
+ */
+static void emit_a32_divmod_call(const s8 *rd, const s8 *rm, const s8 *rn,
+				 bool is64, u32 func, struct jit_ctx *ctx)
+{
+	emit(ARM_PUSH(1 << ARM_R0 | 1 << ARM_R1 | 1 << ARM_R2 | 1 << ARM_R3),
+	     ctx);
+	if (is64) {
+		emit(ARM_SUB_I(ARM_SP, ARM_SP, 16), ctx);
+		emit(ARM_STR_I(rm[1], ARM_SP, 0), ctx);
+		emit(ARM_STR_I(rm[0], ARM_SP, 4), ctx);
+		emit(ARM_STR_I(rn[1], ARM_SP, 8), ctx);
+		emit(ARM_STR_I(rn[0], ARM_SP, 12), ctx);
+		emit(ARM_POP(1 << ARM_R0 | 1 << ARM_R1 | 1 << ARM_R2 |
+			     1 << ARM_R3), ctx);
+	} else {
+		emit(ARM_SUB_I(ARM_SP, ARM_SP, 8), ctx);
+		emit(ARM_STR_I(rm[1], ARM_SP, 0), ctx);
+		emit(ARM_STR_I(rn[1], ARM_SP, 4), ctx);
+		emit(ARM_POP(1 << ARM_R0 | 1 << ARM_R1), ctx);
+	}
+
+	emit_mov_i(ARM_IP, func, ctx);
+	emit(ARM_BLX_R(ARM_IP), ctx);
+
+	emit(ARM_MOV_R(ARM_LR, ARM_R0), ctx);
+	if (is64)
+		emit(ARM_MOV_R(ARM_IP, ARM_R1), ctx);
+	emit(ARM_POP(1 << ARM_R0 | 1 << ARM_R1 | 1 << ARM_R2 | 1 << ARM_R3),
+	     ctx);
+	emit(ARM_MOV_R(rd[1], ARM_LR), ctx);
+	if (is64)
+		emit(ARM_MOV_R(rd[0], ARM_IP), ctx);
+}
+
+/* dst = dst OP src, for BPF_DIV and BPF_MOD */
+static void emit_a32_udivmod(bool is64, const s8 *dst, const s8 *src,
+			     bool check_zero, u8 op, struct jit_ctx *ctx)
+{
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+	const s8 *tmp2 = bpf2a32[TMP_REG_2];
+	const s8 *rs, *rd;
+	s8 rn, rt;
+	u32 func;
+
+	if (is64) {
+		rs = arm_bpf_get_reg64(src, tmp2, ctx);
+		if (check_zero) {
+			emit(ARM_ORRS_R(ARM_LR, rs[1], rs[0]), ctx);
+			emit_a32_ret0_if_eq(ctx);
+		}
+		rd = arm_bpf_get_reg64(dst, tmp, ctx);
+
+		func = op == BPF_DIV ? (u32)jit_udiv64 : (u32)jit_mod64;
+		emit_a32_divmod_call(rd, rd, rs, true, func, ctx);
+		arm_bpf_put_reg64(dst, rd, ctx);
+		return;
+	}
+
+	rn = arm_bpf_get_reg32(src[1], tmp2[1], ctx);
+	if (check_zero) {
+		emit(ARM_CMP_I(rn, 0), ctx);
+		emit_a32_ret0_if_eq(ctx);
+	}
+	rt = arm_bpf_get_reg32(dst[1], tmp[1], ctx);
+
+	if (elf_hwcap & HWCAP_IDIVA) {
+		if (op == BPF_DIV) {
+			emit(ARM_UDIV(rt, rt, rn), ctx);
+		} else {
+			emit(ARM_UDIV(ARM_LR, rt, rn), ctx);
+			emit(ARM_MUL(ARM_LR, ARM_LR, rn), ctx);
+			emit(ARM_SUB_R(rt, rt, ARM_LR), ctx);
+		}
+	} else {
+		const s8 rm32[2] = { 0, rt };
+		const s8 rn32[2] = { 0, rn };
+
+		func = op == BPF_DIV ? (u32)jit_udiv32 : (u32)jit_mod32;
+		emit_a32_divmod_call(rm32, rm32, rn32, false, func, ctx);
+	}
+
+	arm_bpf_put_reg32(dst[1], rt, ctx);
+	emit_a32_mov_i(dst[0], 0, ctx);
+}
+
+/* Fold an offset that does not fit the addressing mode into lr */
+static s8 emit_ldst_base(s8 rn, s32 *off, s32 range, struct jit_ctx *ctx)
+{
+	if (*off > -range && *off < range)
+		return rn;
+
+	emit_add_i(ARM_LR, rn, *off, ctx);
+	*off = 0;
+	return ARM_LR;
+}
+
+/* LDR, STR, LDRB and STRB: 12 bit offset */
+static inline u32 ldst_off12(u32 inst, s32 off)
+{
+	if (off < 0)
+		return (inst & ~ARM_INST_LDST__U) | -off;
+	return inst | off;
+}
+
+/* LDRH and STRH: 8 bit offset, split in two nibbles */
+static inline u32 ldst_off8(u32 inst, s32 off)
+{
+	if (off < 0) {
+		off = -off;
+		inst &= ~ARM_INST_LDST__U;
+	}
+	return inst | (off & 0xf0) << 4 | (off & 0xf);
+}
+
+/* dst = *(size *)(src + off) */
+static void emit_ldx_r(const s8 *dst, const s8 *src, s32 off, u8 sz,
+		       struct jit_ctx *ctx)
+{
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+	const s8 *tmp2 = bpf2a32[TMP_REG_2];
+	const s8 *rd = is_stacked(dst[1]) ? tmp : dst;
+	s8 rn;
+
+	rn = arm_bpf_get_reg32(src[1], tmp2[1], ctx);
+
+	switch (sz) {
+	case BPF_B:
+		rn = emit_ldst_base(rn, &off, 4096, ctx);
+		emit(ldst_off12(ARM_LDRB_I(rd[1], rn, 0), off), ctx);
+		break;
+	case BPF_H:
+		rn = emit_ldst_base(rn, &off, 256, ctx);
+		emit(ldst_off8(ARM_LDRH_I(rd[1], rn, 0), off), ctx);
+		break;
+	case BPF_W:
+		rn = emit_ldst_base(rn, &off, 4096, ctx);
+		emit(ldst_off12(ARM_LDR_I(rd[1], rn, 0), off), ctx);
+		break;
+	case BPF_DW:
+		/* the base may be the low word of dst, so load it last */
+		rn = emit_ldst_base(rn, &off, 4092, ctx);
+		emit(ldst_off12(ARM_LDR_I(rd[0], rn, 0), off + 4), ctx);
+		emit(ldst_off12(ARM_LDR_I(rd[1], rn, 0), off), ctx);
+		break;
+	}
+
+	if (sz != BPF_DW)
+		emit(ARM_MOV_I(rd[0], 0), ctx);
+	arm_bpf_put_reg64(dst, rd, ctx);
+}
+
+/* *(size *)(dst + off) = src */
+static void emit_str_r(const s8 *dst, const s8 *src, s32 off, u8 sz,
+		       struct jit_ctx *ctx)
+{
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+	const s8 *tmp2 = bpf2a32[TMP_REG_2];
+	const s8 *rs;
+	s8 rs32[2];
+	s8 rn;
+
+	rn = arm_bpf_get_reg32(dst[1], tmp[1], ctx);
+	if (sz == BPF_DW) {
+		rs = arm_bpf_get_reg64(src, tmp2, ctx);
+	} else {
+		rs32[1] = arm_bpf_get_reg32(src[1], tmp2[1], ctx);
+		rs = rs32;
+	}
+
+	switch (sz) {
+	case BPF_B:
+		rn = emit_ldst_base(rn, &off, 4096, ctx);
+		emit(ldst_off12(ARM_STRB_I(rs[1], rn, 0), off), ctx);
+		break;
+	case BPF_H:
+		rn = emit_ldst_base(rn, &off, 256, ctx);
+		emit(ldst_off8(ARM_STRH_I(rs[1], rn, 0), off), ctx);
+		break;
+	case BPF_W:
+		rn = emit_ldst_base(rn, &off, 4096, ctx);
+		emit(ldst_off12(ARM_STR_I(rs[1], rn, 0), off), ctx);
+		break;
+	case BPF_DW:
+		rn = emit_ldst_base(rn, &off, 4092, ctx);
+		emit(ldst_off12(ARM_STR_I(rs[1], rn, 0), off), ctx);
+		emit(ldst_off12(ARM_STR_I(rs[0], rn, 0), off + 4), ctx);
+		break;
+	}
+}
+
+/* lock *(size *)(dst + off) += src */
+static void emit_xadd_r(const s8 *dst, const s8 *src, s32 off, u8 sz,
+			struct jit_ctx *ctx)
+{
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+	const s8 *tmp2 = bpf2a32[TMP_REG_2];
+	const s8 *rs;
+	unsigned int loop;
+	s8 rn, status;
+
+	rn = arm_bpf_get_reg32(dst[1], tmp[1], ctx);
+	emit_add_i(ARM_LR, rn, off, ctx);
+
+	if (sz == BPF_W) {
+		rn = arm_bpf_get_reg32(src[1], tmp2[1], ctx);
+
+		loop = ctx->idx;
+		emit(ARM_LDREX(tmp[0], ARM_LR), ctx);
+		emit(ARM_ADD_R(tmp[0], tmp[0], rn), ctx);
+		emit(ARM_STREX(tmp2[0], tmp[0], ARM_LR), ctx);
+		emit(ARM_CMP_I(tmp2[0], 0), ctx);
+		_emit(ARM_COND_NE, ARM_B(loop - (ctx->idx + 2)), ctx);
+		return;
+	}
+
+	/*
+	 * LDREXD and STREXD need the even/odd pair of TMP_REG_1. When src
+	 * lives on the stack it occupies TMP_REG_2 as well, so borrow r0 for
+	 * the status of the store and preserve it around the loop.
+	 */
+	rs = arm_bpf_get_reg64(src, tmp2, ctx);
+	status = rs == tmp2 ? ARM_R0 : tmp2[0];
+
+	if (status == ARM_R0)
+		emit(ARM_PUSH(1 << ARM_R0), ctx);
+	loop = ctx->idx;
+	emit(ARM_LDREXD(tmp[1], ARM_LR), ctx);
+	emit(ARM_ADDS_R(tmp[1], tmp[1], rs[1]), ctx);
+	emit(ARM_ADC_R(tmp[0], tmp[0], rs[0]), ctx);
+	emit(ARM_STREXD(status, tmp[1], ARM_LR), ctx);
+	emit(ARM_CMP_I(status, 0), ctx);
+	_emit(ARM_COND_NE, ARM_B(loop - (ctx->idx + 2)), ctx);
+	if (status == ARM_R0)
+		emit(ARM_POP(1 << ARM_R0), ctx);
+}
+
+/* if (dst COND src) goto insn at index 'to' */
+static void emit_a32_cond_jmp(const s8 *dst, const s8 *src, u8 op, int to,
+			      struct jit_ctx *ctx)
+{
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+	const s8 *tmp2 = bpf2a32[TMP_REG_2];
+	const s8 *rs, *rd;
+	int cond;
+
+	rs = arm_bpf_get_reg64(src, tmp2, ctx);
+	rd = arm_bpf_get_reg64(dst, tmp, ctx);
+
+	switch (op) {
+	case BPF_JEQ:
+	case BPF_JNE:
+	case BPF_JGT:
+	case BPF_JGE:
+		/* the low words only matter when the high ones are equal */
+		emit(ARM_CMP_R(rd[0], rs[0]), ctx);
+		_emit(ARM_COND_EQ, ARM_CMP_R(rd[1], rs[1]), ctx);
+		break;
+	case BPF_JSET:
+		emit(ARM_TST_R(rd[0], rs[0]), ctx);
+		_emit(ARM_COND_EQ, ARM_TST_R(rd[1], rs[1]), ctx);
+		break;
+	case BPF_JSGT:
+		/* src - dst < 0 */
+		emit(ARM_CMP_R(rs[1], rd[1]), ctx);
+		emit(ARM_SBCS_R(ARM_LR, rs[0], rd[0]), ctx);
+		break;
+	case BPF_JSGE:
+		/* dst - src >= 0 */
+		emit(ARM_CMP_R(rd[1], rs[1]), ctx);
+		emit(ARM_SBCS_R(ARM_LR, rd[0], rs[0]), ctx);
+		break;
+	}
+
+	switch (op) {
+	case BPF_JEQ:
+		cond = ARM_COND_EQ;
+		break;
+	case BPF_JNE:
+	case BPF_JSET:
+		cond = ARM_COND_NE;
+		break;
+	case BPF_JGT:
+		cond = ARM_COND_HI;
+		break;
+	case BPF_JGE:
+		cond = ARM_COND_CS;
+		break;
+	case BPF_JSGT:
+		cond = ARM_COND_LT;
+		break;
+	default: /* BPF_JSGE */
+		cond = ARM_COND_GE;
+		break;
+	}
+
+	_emit(cond, ARM_B(bpf2a32_offset(to, ctx)), ctx);
+}
+
+/*
+ * bpf_tail_call(void *ctx, struct bpf_array *array, u64 index)
+ *   if (index >= array->map.max_entries)
+ *     goto out;
+ *   if (tail_call_cnt++ > MAX_TAIL_CALL_CNT)
+ *     goto out;
+ *   prog = array->ptrs[index];
+ *   if (prog == NULL)
+ *     goto out;
+ *   goto *(prog->bpf_func + prologue_size);
+ * out:
+ */
+static void emit_bpf_tail_call(struct jit_ctx *ctx)
+{
+	const s8 *r2 = bpf2a32[BPF_REG_2];
+	const s8 *r3 = bpf2a32[BPF_REG_3];
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+	const s8 *tmp2 = bpf2a32[TMP_REG_2];
+	const s8 tcc = STACK_SLOT(BPF_TC);
+	unsigned int out[3];
+	s8 array, index, index_hi;
+	int off;
+
+	BUILD_BUG_ON(offsetof(struct bpf_array, map.max_entries) > 4095);
+	BUILD_BUG_ON(offsetof(struct bpf_array, ptrs) > 4095);
+	BUILD_BUG_ON(offsetof(struct bpf_prog, bpf_func) > 4095);
+
+	/* if (index >= array->map.max_entries) goto out; */
+	array = arm_bpf_get_reg32(r2[1], tmp[1], ctx);
+	index = arm_bpf_get_reg32(r3[1], tmp2[1], ctx);
+	off = offsetof(struct bpf_array, map.max_entries);
+	emit(ARM_LDR_I(ARM_LR, array, off), ctx);
+	index_hi = arm_bpf_get_reg32(r3[0], tmp2[0], ctx);
+	emit(ARM_CMP_I(index_hi, 0), ctx);
+	_emit(ARM_COND_EQ, ARM_CMP_R(index, ARM_LR), ctx);
+	out[0] = ctx->idx;
+	_emit(ARM_COND_CS, ARM_B(0), ctx);
+
+	/* if (tail_call_cnt > MAX_TAIL_CALL_CNT) goto out; */
+	emit(ARM_LDR_I(ARM_LR, ARM_SP, stack_off(tcc)), ctx);
+	emit(ARM_CMP_I(ARM_LR, MAX_TAIL_CALL_CNT), ctx);
+	out[1] = ctx->idx;
+	_emit(ARM_COND_HI, ARM_B(0), ctx);
+	emit(ARM_ADD_I(ARM_LR, ARM_LR, 1), ctx);
+	emit(ARM_STR_I(ARM_LR, ARM_SP, stack_off(tcc)), ctx);
+
+	/* prog = array->ptrs[index]; if (prog == NULL) goto out; */
+	off = offsetof(struct bpf_array, ptrs);
+	emit(ARM_LSL_I(ARM_LR, index, 2), ctx);
+	emit(ARM_ADD_R(ARM_LR, array, ARM_LR), ctx);
+	emit(ARM_LDR_I(ARM_LR, ARM_LR, off), ctx);
+	emit(ARM_CMP_I(ARM_LR, 0), ctx);
+	out[2] = ctx->idx;
+	_emit(ARM_COND_EQ, ARM_B(0), ctx);
+
+	/*
+	 * goto *(prog->bpf_func + prologue_size); the prologue has the same
+	 * size in every program, and the target keeps the current frame.
+	 */
+	off = offsetof(struct bpf_prog, bpf_func);
+	emit(ARM_LDR_I(ARM_LR, ARM_LR, off), ctx);
+	/* well below 256 bytes, i.e. a plain imm8 */
+	emit(ARM_ADD_I(ARM_LR, ARM_LR, ctx->prologue_bytes), ctx);
+	emit(ARM_BX(ARM_LR), ctx);
+
+	/* out: */
+	resolve_branch(out[0], ctx);
+	resolve_branch(out[1], ctx);
+	resolve_branch(out[2], ctx);
+}
+
+static void build_prologue(struct jit_ctx *ctx)
+{
+	const s8 r0 = bpf2a32[BPF_REG_0][1];
+	const s8 *r1 = bpf2a32[BPF_REG_1];
+	const s8 *fp = bpf2a32[BPF_REG_FP];
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+	const s8 tcc = STACK_SLOT(BPF_TC);
+	int imm12;
+
+#ifdef CONFIG_FRAME_POINTER
+	emit(ARM_MOV_R(ARM_IP, ARM_SP), ctx);
+	emit(ARM_PUSH(CALLEE_PUSH_MASK), ctx);
+	emit(ARM_SUB_I(ARM_FP, ARM_IP, 4), ctx);
+#else
+	emit(ARM_PUSH(CALLEE_PUSH_MASK), ctx);
+#endif
+
+	imm12 = imm8m(STACK_SIZE);
+	if (imm12 >= 0) {
+		emit(ARM_SUB_I(ARM_SP, ARM_SP, imm12), ctx);
+	} else {
+		emit_mov_i(ARM_IP, STACK_SIZE, ctx);
+		emit(ARM_SUB_R(ARM_SP, ARM_SP, ARM_IP), ctx);
+	}
+
+	/* set up the read-only eBPF frame pointer */
+	emit_add_i(tmp[1], ARM_SP, SCRATCH_OFF(0), ctx);
+	emit(ARM_MOV_I(tmp[0], 0), ctx);
+	arm_bpf_put_reg64(fp, tmp, ctx);
+
+	/* initialize the tail call count */
+	emit(ARM_STR_I(tmp[0], ARM_SP, stack_off(tcc)), ctx);
+
+	/* move the context pointer to BPF R1 */
+	emit(ARM_MOV_R(r1[1], r0), ctx);
+	emit(ARM_MOV_I(r1[0], 0), ctx);
+
+	/* tail calls enter the program here */
+	ctx->prologue_bytes = ctx->idx * 4;
+}
+
+static void build_epilogue(struct jit_ctx *ctx)
+{
+	int imm12;
+
+	/* the return value is already in r0 */
+	imm12 = imm8m(STACK_SIZE);
+	if (imm12 >= 0) {
+		emit(ARM_ADD_I(ARM_SP, ARM_SP, imm12), ctx);
+	} else {
+		emit_mov_i(ARM_IP, STACK_SIZE, ctx);
+		emit(ARM_ADD_R(ARM_SP, ARM_SP, ARM_IP), ctx);
+	}
+
+#ifdef CONFIG_FRAME_POINTER
+	emit(ARM_LDM(ARM_SP, CALLEE_POP_MASK), ctx);
+#else
+	emit(ARM_POP(CALLEE_POP_MASK), ctx);
+#endif
+}
+
+/*
+ * JITs an eBPF instruction.
+ * Returns:
+ * 0  - successfully JITed an 8-byte eBPF instruction.
+ * >0 - successfully JITed a 16-byte eBPF instruction.
+ * <0 - failed to JIT.
+ */
+static int build_insn(const struct bpf_insn *insn, struct jit_ctx *ctx)
+{
+	const u8 code = insn->code;
+	const s8 *dst = bpf2a32[insn->dst_reg];
+	const s8 *src = bpf2a32[insn->src_reg];
+	const s8 *tmp = bpf2a32[TMP_REG_1];
+	const s8 *tmp2 = bpf2a32[TMP_REG_2];
+	const s16 off = insn->off;
+	const s32 imm = insn->imm;
+	const int i = insn - ctx->prog->insnsi;
+	const bool is64 = BPF_CLASS(code) == BPF_ALU64;
+	const s8 *rs;
+	s8 rt;
+
+	switch (code) {
+	/* dst = src */
+	case BPF_ALU | BPF_MOV | BPF_X:
+	case BPF_ALU64 | BPF_MOV | BPF_X:
+		emit_a32_mov_r64(is64, dst, src, ctx);
+		break;
+	/* dst = imm */
+	case BPF_ALU | BPF_MOV | BPF_K:
+	case BPF_ALU64 | BPF_MOV | BPF_K:
+		emit_a32_mov_se_i64(is64, dst, imm, ctx);
+		break;
+	/* dst = dst OP src */
+	case BPF_ALU | BPF_ADD | BPF_X:
+	case BPF_ALU | BPF_SUB | BPF_X:
+	case BPF_ALU | BPF_OR | BPF_X:
+	case BPF_ALU | BPF_AND | BPF_X:
+	case BPF_ALU | BPF_XOR | BPF_X:
+	case BPF_ALU | BPF_MUL | BPF_X:
+	case BPF_ALU | BPF_LSH | BPF_X:
+	case BPF_ALU | BPF_RSH | BPF_X:
+	case BPF_ALU | BPF_ARSH | BPF_X:
+	case BPF_ALU64 | BPF_ADD | BPF_X:
+	case BPF_ALU64 | BPF_SUB | BPF_X:
+	case BPF_ALU64 | BPF_OR | BPF_X:
+	case BPF_ALU64 | BPF_AND | BPF_X:
+	case BPF_ALU64 | BPF_XOR | BPF_X:
+		emit_a32_alu_r64(is64, dst, src, BPF_OP(code), ctx);
+		break;
+	/* dst = dst OP imm */
+	case BPF_ALU | BPF_ADD | BPF_K:
+	case BPF_ALU | BPF_SUB | BPF_K:
+	case BPF_ALU | BPF_OR | BPF_K:
+	case BPF_ALU | BPF_AND | BPF_K:
+	case BPF_ALU | BPF_XOR | BPF_K:
+	case BPF_ALU | BPF_MUL | BPF_K:
+	case BPF_ALU64 | BPF_ADD | BPF_K:
+	case BPF_ALU64 | BPF_SUB | BPF_K:
+	case BPF_ALU64 | BPF_OR | BPF_K:
+	case BPF_ALU64 | BPF_AND | BPF_K:
+	case BPF_ALU64 | BPF_XOR | BPF_K:
+		rs = emit_a32_imm_operand(is64, imm, ctx);
+		emit_a32_alu_r64(is64, dst, rs, BPF_OP(code), ctx);
+		break;
+	case BPF_ALU64 | BPF_MUL | BPF_X:
+		emit_a32_mul_r64(dst, src, ctx);
+		break;
+	case BPF_ALU64 | BPF_MUL | BPF_K:
+		rs = emit_a32_imm_operand(true, imm, ctx);
+		emit_a32_mul_r64(dst, rs, ctx);
+		break;
+	/* dst = dst / src, dst = dst % src */
+	case BPF_ALU | BPF_DIV | BPF_X:
+	case BPF_ALU | BPF_MOD | BPF_X:
+	case BPF_ALU64 | BPF_DIV | BPF_X:
+	case BPF_ALU64 | BPF_MOD | BPF_X:
+		emit_a32_udivmod(is64, dst, src, true, BPF_OP(code), ctx);
+		break;
+	case BPF_ALU | BPF_DIV | BPF_K:
+	case BPF_ALU | BPF_MOD | BPF_K:
+	case BPF_ALU64 | BPF_DIV | BPF_K:
+	case BPF_ALU64 | BPF_MOD | BPF_K:
+		rs = emit_a32_imm_operand(is64, imm, ctx);
+		emit_a32_udivmod(is64, dst, rs, false, BPF_OP(code), ctx);
+		break;
+	/* dst = dst << imm, dst = dst >> imm */
+	case BPF_ALU | BPF_LSH | BPF_K:
+	case BPF_ALU | BPF_RSH | BPF_K:
+	case BPF_ALU | BPF_ARSH | BPF_K:
+		if (unlikely(imm < 0 || imm > 31))
+			return -EINVAL;
+		emit_a32_shift_i(dst[1], imm, BPF_OP(code), ctx);
+		emit_a32_mov_i(dst[0], 0, ctx);
+		break;
+	case BPF_ALU64 | BPF_LSH | BPF_K:
+	case BPF_ALU64 | BPF_RSH | BPF_K:
+	case BPF_ALU64 | BPF_ARSH | BPF_K:
+		if (unlikely(imm < 0 || imm > 63))
+			return -EINVAL;
+		emit_a32_shift_i64(dst, imm, BPF_OP(code), ctx);
+		break;
+	/* dst = dst << src, dst = dst >> src */
+	case BPF_ALU64 | BPF_LSH | BPF_X:
+	case BPF_ALU64 | BPF_RSH | BPF_X:
+	case BPF_ALU64 | BPF_ARSH | BPF_X:
+		emit_a32_shift_r64(dst, src, BPF_OP(code), ctx);
+		break;
+	/* dst = -dst */
+	case BPF_ALU | BPF_NEG:
+		rt = arm_bpf_get_reg32(dst[1], tmp[1], ctx);
+		emit(ARM_RSB_I(rt, rt, 0), ctx);
+		arm_bpf_put_reg32(dst[1], rt, ctx);
+		emit_a32_mov_i(dst[0], 0, ctx);
+		break;
+	case BPF_ALU64 | BPF_NEG:
+		rs = arm_bpf_get_reg64(dst, tmp, ctx);
+		emit(ARM_RSBS_I(rs[1], rs[1], 0), ctx);
+		emit(ARM_RSC_I(rs[0], rs[0], 0), ctx);
+		arm_bpf_put_reg64(dst, rs, ctx);
+		break;
+	/* dst = BSWAP##imm(dst) */
+	case BPF_ALU | BPF_END | BPF_FROM_LE:
+	case BPF_ALU | BPF_END | BPF_FROM_BE:
+		rs = arm_bpf_get_reg64(dst, tmp, ctx);
+		if (BPF_SRC(code) == BPF_FROM_BE) {
+			switch (imm) {
+			case 16:
+				emit(ARM_REV16(rs[1], rs[1]), ctx);
+				break;
+			case 32:
+				emit(ARM_REV(rs[1], rs[1]), ctx);
+				break;
+			case 64:
+				emit(ARM_REV(ARM_LR, rs[1]), ctx);
+				emit(ARM_REV(rs[1], rs[0]), ctx);
+				emit(ARM_MOV_R(rs[0], ARM_LR), ctx);
+				break;
+			}
+		}
+		switch (imm) {
+		case 16:
+			/* zero-extend 16 bits into 64 bits */
+			emit(ARM_LSL_I(rs[1], rs[1], 16), ctx);
+			emit(ARM_LSR_I(rs[1], rs[1], 16), ctx);
+			/* fall through */
+		case 32:
+			emit(ARM_MOV_I(rs[0], 0), ctx);
+			break;
+		}
+		arm_bpf_put_reg64(dst, rs, ctx);
+		break;
+	/* dst = imm64 */
+	case BPF_LD | BPF_IMM | BPF_DW:
+	{
+		const struct bpf_insn insn1 = insn[1];
+		u64 imm64;
+
+		if (insn1.code != 0 || insn1.src_reg != 0 ||
+		    insn1.dst_reg != 0 || insn1.off != 0) {
+			/* Note: verifier in BPF core must catch invalid
+			 * instructions.
+			 */
+			pr_err_once("Invalid BPF_LD_IMM64 instruction\n");
+			return -EINVAL;
+		}
+
+		imm64 = (u64)insn1.imm << 32 | (u32)imm;
+		emit_a32_mov_i64(dst, imm64, ctx);
+
+		return 1;
+	}
+	/* LDX: dst = *(size *)(src + off) */
+	case BPF_LDX | BPF_MEM | BPF_W:
+	case BPF_LDX | BPF_MEM | BPF_H:
+	case BPF_LDX | BPF_MEM | BPF_B:
+	case BPF_LDX | BPF_MEM | BPF_DW:
+		emit_ldx_r(dst, src, off, BPF_SIZE(code), ctx);
+		break;
+	/* ST: *(size *)(dst + off) = imm */
+	case BPF_ST | BPF_MEM | BPF_W:
+	case BPF_ST | BPF_MEM | BPF_H:
+	case BPF_ST | BPF_MEM | BPF_B:
+	case BPF_ST | BPF_MEM | BPF_DW:
+		rs = emit_a32_imm_operand(BPF_SIZE(code) == BPF_DW, imm, ctx);
+		emit_str_r(dst, rs, off, BPF_SIZE(code), ctx);
+		break;
+	/* STX: *(size *)(dst + off) = src */
+	case BPF_STX | BPF_MEM | BPF_W:
+	case BPF_STX | BPF_MEM | BPF_H:
+	case BPF_STX | BPF_MEM | BPF_B:
+	case BPF_STX | BPF_MEM | BPF_DW:
+		emit_str_r(dst, src, off, BPF_SIZE(code), ctx);
+		break;
+	/* STX XADD: lock *(u32 *)(dst + off) += src */
+	case BPF_STX | BPF_XADD | BPF_W:
+	/* STX XADD: lock *(u64 *)(dst + off) += src */
+	case BPF_STX | BPF_XADD | BPF_DW:
+		emit_xadd_r(dst, src, off, BPF_SIZE(code), ctx);
+		break;
+	/* R0 = ntohx(*(size *)(((struct sk_buff *)R6)->data + imm)) */
+	case BPF_LD | BPF_ABS | BPF_W:
+	case BPF_LD | BPF_ABS | BPF_H:
+	case BPF_LD | BPF_ABS | BPF_B:
+	/* R0 = ntohx(*(size *)(((struct sk_buff *)R6)->data + src + imm)) */
+	case BPF_LD | BPF_IND | BPF_W:
+	case BPF_LD | BPF_IND | BPF_H:
+	case BPF_LD | BPF_IND | BPF_B:
+	{
+		const s8 *r0 = bpf2a32[BPF_REG_0];
+		const s8 *r6 = bpf2a32[BPF_REG_6];
+		int size;
+
+		switch (BPF_SIZE(code)) {
+		case BPF_W:
+			size = 4;
+			break;
+		case BPF_H:
+			size = 2;
+			break;
+		default:
+			size = 1;
+			break;
+		}
+
+		/*
+		 * Arguments go in r0-r2: skb, k and size. The verifier
+		 * treats R1-R5 as clobbered afterwards, like for a call.
+		 */
+		emit_mov_i(ARM_LR, imm, ctx);
+		if (BPF_MODE(code) == BPF_IND) {
+			rt = arm_bpf_get_reg32(src[1], tmp2[1], ctx);
+			emit(ARM_ADD_R(ARM_R1, rt, ARM_LR), ctx);
+		} else {
+			emit(ARM_MOV_R(ARM_R1, ARM_LR), ctx);
+		}
+		emit(ARM_MOV_R(ARM_R0, r6[1]), ctx);
+		emit(ARM_MOV_I(ARM_R2, size), ctx);
+		emit_mov_i(ARM_IP, (u32)jit_load_skb, ctx);
+		emit(ARM_BLX_R(ARM_IP), ctx);
+
+		/* the program returns 0 when the load failed */
+		emit(ARM_CMP_I(r0[0], 0), ctx);
+		_emit(ARM_COND_NE, ARM_MOV_I(r0[1], 0), ctx);
+		_emit(ARM_COND_NE, ARM_MOV_I(r0[0], 0), ctx);
+		_emit(ARM_COND_NE, ARM_B(epilogue_offset(ctx)), ctx);
+		break;
+	}
+	/* JUMP off */
+	case BPF_JMP | BPF_JA:
+		emit(ARM_B(bpf2a32_offset(i + off + 1, ctx)), ctx);
+		break;
+	/* IF (dst COND src) JUMP off */
+	case BPF_JMP | BPF_JEQ | BPF_X:
+	case BPF_JMP | BPF_JGT | BPF_X:
+	case BPF_JMP | BPF_JGE | BPF_X:
+	case BPF_JMP | BPF_JNE | BPF_X:
+	case BPF_JMP | BPF_JSGT | BPF_X:
+	case BPF_JMP | BPF_JSGE | BPF_X:
+	case BPF_JMP | BPF_JSET | BPF_X:
+		emit_a32_cond_jmp(dst, src, BPF_OP(code), i + off + 1, ctx);
+		break;
+	/* IF (dst COND imm) JUMP off */
+	case BPF_JMP | BPF_JEQ | BPF_K:
+	case BPF_JMP | BPF_JGT | BPF_K:
+	case BPF_JMP | BPF_JGE | BPF_K:
+	case BPF_JMP | BPF_JNE | BPF_K:
+	case BPF_JMP | BPF_JSGT | BPF_K:
+	case BPF_JMP | BPF_JSGE | BPF_K:
+	case BPF_JMP | BPF_JSET | BPF_K:
+		rs = emit_a32_imm_operand(true, imm, ctx);
+		emit_a32_cond_jmp(dst, rs, BPF_OP(code), i + off + 1, ctx);
+		break;
+	/* tail call */
+	case BPF_JMP | BPF_CALL | BPF_X:
+		emit_bpf_tail_call(ctx);
+		break;
+	/* function call */
+	case BPF_JMP | BPF_CALL:
+	{
+		/* the 64-bit arguments 1 and 2 go in r0-r1 and r2-r3 */
+		static const s8 arg_regs[][2] = {
+			{ARM_R1, ARM_R0}, {ARM_R3, ARM_R2},
+		};
+		const u32 func = (u32)__bpf_call_base + (u32)imm;
+		int arg;
+
+		arm_bpf_put_reg64(arg_regs[0], bpf2a32[BPF_REG_1], ctx);
+		arm_bpf_put_reg64(arg_regs[1],
+				  arm_bpf_get_reg64(bpf2a32[BPF_REG_2],
+						    arg_regs[1], ctx), ctx);
+
+		/* and arguments 3 to 5 on the stack */
+		for (arg = BPF_REG_3; arg <= BPF_REG_5; arg++) {
+			int slot = (arg - BPF_REG_3) * 8;
+
+			rs = arm_bpf_get_reg64(bpf2a32[arg], tmp, ctx);
+			emit(ARM_STR_I(rs[1], ARM_SP, slot), ctx);
+			emit(ARM_STR_I(rs[0], ARM_SP, slot + 4), ctx);
+		}
+
+		/* the return value ends up in r0-r1, i.e. BPF R0 */
+		emit_mov_i(tmp[1], func, ctx);
+		emit(ARM_BLX_R(tmp[1]), ctx);
+		break;
+	}
+	/* function return */
+	case BPF_JMP | BPF_EXIT:
+		/* Optimization: when last instruction is EXIT,
+		 * simply fallthrough to epilogue.
+		 */
+		if (i == ctx->prog->len - 1)
+			break;
+		emit(ARM_B(epilogue_offset(ctx)), ctx);
+		break;
+
+	default:
+		pr_err_once("unknown opcode %02x\n", code);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int build_body(struct jit_ctx *ctx)
+{
+	const struct bpf_prog *prog = ctx->prog;
+	int i;
+
+	for (i = 0; i < prog->len; i++) {
+		const struct bpf_insn *insn = &prog->insnsi[i];
+		int ret;
+
+		/* compute offsets only during the first pass */
+		if (ctx->target == NULL)
+			ctx->offsets[i] = ctx->idx;
+
+		ret = build_insn(insn, ctx);
+
+		if (ret > 0) {
+			i++;
+			if (ctx->target == NULL)
+				ctx->offsets[i] = ctx->idx;
+			continue;
+		}
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+void bpf_int_jit_compile(struct bpf_prog *prog)
+{
+	struct bpf_binary_header *header;
+	struct jit_ctx ctx;
+	unsigned int image_size;
+	u8 *image_ptr;
+
+	if (!bpf_jit_enable)
+		return;
+
+	/*
+	 * The code generator relies on MOVW/MOVT, LDREXD/STREXD and REV,
+	 * and on the little endian layout of 64-bit values; use the
+	 * interpreter everywhere else.
+	 */
+	if (__LINUX_ARM_ARCH__ < 7 || IS_ENABLED(CONFIG_CPU_BIG_ENDIAN))
+		return;
+
+	if (!prog || !prog->len)
+		return;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.prog = prog;
+
+	ctx.offsets = kcalloc(prog->len, sizeof(u32), GFP_KERNEL);
+	if (ctx.offsets == NULL)
+		return;
+
+	/* fake pass to fill in ctx.offsets and compute the image size */
+	build_prologue(&ctx);
+	if (build_body(&ctx))
+		goto out;
+	ctx.epilogue_offset = ctx.idx;
+	build_epilogue(&ctx);
+
+	image_size = 4 * ctx.idx;
+	header = bpf_jit_binary_alloc(image_size, &image_ptr,
+				      4, jit_fill_hole);
+	if (header == NULL)
+		goto out;
+
+	ctx.target = (u32 *)image_ptr;
+	ctx.idx = 0;
+
+	build_prologue(&ctx);
+	if (build_body(&ctx)) {
+		bpf_jit_binary_free(header);
+		goto out;
+	}
+	build_epilogue(&ctx);
+
+	flush_icache_range((u32)ctx.target, (u32)(ctx.target + ctx.idx));
+
+	if (bpf_jit_enable > 1)
+		/* there are 2 passes here */
+		bpf_jit_dump(prog->len, image_size, 2, ctx.target);
+
+	set_memory_ro((unsigned long)header, header->pages);
+	prog->bpf_func = (void *)ctx.target;
+	prog->jited = true;
+out:
+	kfree(ctx.offsets);
+}
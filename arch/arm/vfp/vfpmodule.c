@@ -726,6 +726,28 @@ void kernel_neon_end(void)
 }
 EXPORT_SYMBOL(kernel_neon_end);
 
+/*
+ * Callers that may run inside another kernel_neon_begin() section, such
+ * as memcpy(), must not start one of their own: their kernel_neon_end()
+ * would turn the unit off under the outer user.  Such a section is the
+ * only time the unit is enabled without a hardware state owner.
+ */
+bool kernel_neon_usable(void)
+{
+	bool busy;
+
+	if (in_interrupt())
+		return false;
+
+	preempt_disable();
+	busy = (fmrx(FPEXC) & FPEXC_EN) &&
+	       !vfp_current_hw_state[smp_processor_id()];
+	preempt_enable();
+
+	return !busy;
+}
+EXPORT_SYMBOL(kernel_neon_usable);
+
 #endif /* CONFIG_KERNEL_MODE_NEON */
 
 /*
@@ -0,0 +1,150 @@
+/*
+ * Poly1305 authenticator algorithm, RFC7539, arm64 NEON glue code
+ *
+ * Based on the x86_64 SIMD glue code:
+ *   Copyright (C) 2015 Martin Willi
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <crypto/algapi.h>
+#include <crypto/internal/hash.h>
+#include <crypto/poly1305.h>
+#include <linux/crypto.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+struct poly1305_neon_desc_ctx {
+	struct poly1305_desc_ctx base;
+	/* derived key u set? */
+	bool uset;
+	/* derived Poly1305 key r^2 */
+	u32 u[5];
+};
+
+asmlinkage void poly1305_2block_neon(u32 *h, const u8 *src, const u32 *r,
+				     unsigned int blocks, const u32 *u);
+
+static int poly1305_neon_init(struct shash_desc *desc)
+{
+	struct poly1305_neon_desc_ctx *nctx = shash_desc_ctx(desc);
+
+	nctx->uset = false;
+
+	return crypto_poly1305_init(desc);
+}
+
+static inline u64 mlt(u64 a, u64 b)
+{
+	return a * b;
+}
+
+/* a = a * b mod 2^130 - 5, both in the 26-bit limbs of the accumulator */
+static void poly1305_neon_mult(u32 *a, const u32 *b)
+{
+	u32 s1 = b[1] * 5, s2 = b[2] * 5, s3 = b[3] * 5, s4 = b[4] * 5;
+	u64 d0, d1, d2, d3, d4;
+
+	d0 = mlt(a[0], b[0]) + mlt(a[1], s4) + mlt(a[2], s3) +
+	     mlt(a[3], s2) + mlt(a[4], s1);
+	d1 = mlt(a[0], b[1]) + mlt(a[1], b[0]) + mlt(a[2], s4) +
+	     mlt(a[3], s3) + mlt(a[4], s2);
+	d2 = mlt(a[0], b[2]) + mlt(a[1], b[1]) + mlt(a[2], b[0]) +
+	     mlt(a[3], s4) + mlt(a[4], s3);
+	d3 = mlt(a[0], b[3]) + mlt(a[1], b[2]) + mlt(a[2], b[1]) +
+	     mlt(a[3], b[0]) + mlt(a[4], s4);
+	d4 = mlt(a[0], b[4]) + mlt(a[1], b[3]) + mlt(a[2], b[2]) +
+	     mlt(a[3], b[1]) + mlt(a[4], b[0]);
+
+	d1 += d0 >> 26;			a[0] = d0 & 0x3ffffff;
+	d2 += d1 >> 26;			a[1] = d1 & 0x3ffffff;
+	d3 += d2 >> 26;			a[2] = d2 & 0x3ffffff;
+	d4 += d3 >> 26;			a[3] = d3 & 0x3ffffff;
+	a[0] += (u32)(d4 >> 26) * 5;	a[4] = d4 & 0x3ffffff;
+	a[1] += a[0] >> 26;		a[0] &= 0x3ffffff;
+}
+
+static int poly1305_neon_update(struct shash_desc *desc,
+				const u8 *src, unsigned int srclen)
+{
+	struct poly1305_neon_desc_ctx *nctx = shash_desc_ctx(desc);
+	struct poly1305_desc_ctx *dctx = &nctx->base;
+	unsigned int bytes, blocks;
+
+	BUILD_BUG_ON(offsetof(struct poly1305_neon_desc_ctx, base));
+
+	/* kernel_neon_begin/end is costly, use fallback for small updates */
+	if (srclen <= 288 || !may_use_simd())
+		return crypto_poly1305_update(desc, src, srclen);
+
+	/*
+	 * Leave a partial block and a key taken from the data to the
+	 * generic code; it stops at block boundaries for us.
+	 */
+	while (srclen && (dctx->buflen || !dctx->sset)) {
+		bytes = min(srclen, POLY1305_BLOCK_SIZE - dctx->buflen);
+		crypto_poly1305_update(desc, src, bytes);
+		src += bytes;
+		srclen -= bytes;
+	}
+
+	if (likely(srclen >= POLY1305_BLOCK_SIZE * 2)) {
+		if (unlikely(!nctx->uset)) {
+			memcpy(nctx->u, dctx->r, sizeof(nctx->u));
+			poly1305_neon_mult(nctx->u, dctx->r);
+			nctx->uset = true;
+		}
+		blocks = srclen / (POLY1305_BLOCK_SIZE * 2);
+
+		kernel_neon_begin();
+		poly1305_2block_neon(dctx->h, src, dctx->r, blocks, nctx->u);
+		kernel_neon_end();
+
+		src += POLY1305_BLOCK_SIZE * 2 * blocks;
+		srclen -= POLY1305_BLOCK_SIZE * 2 * blocks;
+	}
+
+	/* at most one block and a partial one are left */
+	return crypto_poly1305_update(desc, src, srclen);
+}
+
+static struct shash_alg alg = {
+	.digestsize	= POLY1305_DIGEST_SIZE,
+	.init		= poly1305_neon_init,
+	.update		= poly1305_neon_update,
+	.final		= crypto_poly1305_final,
+	.setkey		= crypto_poly1305_setkey,
+	.descsize	= sizeof(struct poly1305_neon_desc_ctx),
+	.base		= {
+		.cra_name		= "poly1305",
+		.cra_driver_name	= "poly1305-neon",
+		.cra_priority		= 300,
+		.cra_flags		= CRYPTO_ALG_TYPE_SHASH,
+		.cra_alignmask		= sizeof(u32) - 1,
+		.cra_blocksize		= POLY1305_BLOCK_SIZE,
+		.cra_module		= THIS_MODULE,
+	},
+};
+
+static int __init poly1305_neon_mod_init(void)
+{
+	return crypto_register_shash(&alg);
+}
+
+static void __exit poly1305_neon_mod_exit(void)
+{
+	crypto_unregister_shash(&alg);
+}
+
+module_init(poly1305_neon_mod_init);
+module_exit(poly1305_neon_mod_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Poly1305 authenticator, NEON accelerated");
+MODULE_ALIAS_CRYPTO("poly1305");
+MODULE_ALIAS_CRYPTO("poly1305-neon");
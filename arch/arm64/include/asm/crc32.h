@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2014 Linaro Ltd <yazen.ghannam@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_CRC32_H
+#define __ASM_CRC32_H
+
+#include <linux/compiler.h>
+#include <linux/types.h>
+
+#include <asm/hwcap.h>
+
+/*
+ * Hooks for lib/crc32.c: the little-endian CRC32 and CRC32C are computed
+ * with the ARMv8 CRC32 instructions when the CPU has them.
+ */
+u32 __pure crc32_le_arm64(u32 crc, unsigned char const *p, size_t len);
+u32 __pure __crc32c_le_arm64(u32 crc, unsigned char const *p, size_t len);
+
+static inline bool arch_has_fast_crc32(void)
+{
+	return elf_hwcap & HWCAP_CRC32;
+}
+
+#define arch_crc32_le		crc32_le_arm64
+#define arch_crc32c_le		__crc32c_le_arm64
+
+#endif /* __ASM_CRC32_H */
@@ -19,10 +19,95 @@
 #include <linux/nodemask.h>
 #include <linux/of.h>
 #include <linux/sched.h>
+#include <linux/slab.h>
 
 #include <asm/cputype.h>
 #include <asm/topology.h>
 
+/*
+ * cpu capacity scale management
+ *
+ * Relative compute capacity of each CPU, used by the scheduler to place
+ * tasks on heterogeneous systems. CPUs default to SCHED_CAPACITY_SCALE.
+ */
+static DEFINE_PER_CPU(unsigned long, cpu_scale) = SCHED_CAPACITY_SCALE;
+
+unsigned long arch_scale_cpu_capacity(struct sched_domain *sd, int cpu)
+{
+	return per_cpu(cpu_scale, cpu);
+}
+
+struct cpu_efficiency {
+	const char *compatible;
+	unsigned long efficiency;
+};
+
+/*
+ * Relative efficiency of each processor, roughly DMIPS/MHz * 1000.
+ * Processors that are not in the table keep the default capacity.
+ */
+static const struct cpu_efficiency table_efficiency[] __initconst = {
+	{"arm,cortex-a72", 4710},
+	{"arm,cortex-a57", 4300},
+	{"arm,cortex-a53", 2300},
+	{NULL, },
+};
+
+/*
+ * Derive the capacity of each CPU from its efficiency and the
+ * clock-frequency of its DT node, the biggest CPU being given
+ * SCHED_CAPACITY_SCALE. Clusters of the same core running at different
+ * maximum frequencies thus get different capacities as well. If any CPU
+ * can't be described, all CPUs keep the default capacity.
+ */
+static void __init parse_dt_cpu_capacity(void)
+{
+	const struct cpu_efficiency *cpu_eff;
+	unsigned long *capacity, max_capacity = 0;
+	struct device_node *cn;
+	u32 rate;
+	int cpu;
+
+	capacity = kcalloc(nr_cpu_ids, sizeof(*capacity), GFP_NOWAIT);
+	if (!capacity)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		cn = of_get_cpu_node(cpu, NULL);
+		if (!cn) {
+			pr_err("missing device node for CPU %d\n", cpu);
+			goto out;
+		}
+
+		for (cpu_eff = table_efficiency; cpu_eff->compatible; cpu_eff++)
+			if (of_device_is_compatible(cn, cpu_eff->compatible))
+				break;
+
+		if (!cpu_eff->compatible ||
+		    of_property_read_u32(cn, "clock-frequency", &rate)) {
+			of_node_put(cn);
+			goto out;
+		}
+		of_node_put(cn);
+
+		capacity[cpu] = (rate >> 20) * cpu_eff->efficiency;
+		if (capacity[cpu] > max_capacity)
+			max_capacity = capacity[cpu];
+	}
+
+	if (!max_capacity)
+		goto out;
+
+	for_each_possible_cpu(cpu) {
+		per_cpu(cpu_scale, cpu) = max(1UL, (capacity[cpu] <<
+				SCHED_CAPACITY_SHIFT) / max_capacity);
+		pr_info("CPU%d: cpu_capacity %lu\n", cpu,
+			per_cpu(cpu_scale, cpu));
+	}
+out:
+	kfree(capacity);
+}
+
 static int __init get_cpu_for_node(struct device_node *node)
 {
 	struct device_node *cpu_node;
@@ -302,4 +387,7 @@ void __init init_cpu_topology(void)
 	 */
 	if (of_have_populated_dt() && parse_dt_topology())
 		reset_cpu_topology();
+
+	if (of_have_populated_dt())
+		parse_dt_cpu_capacity();
 }
@@ -0,0 +1,213 @@
+/*
+ * Scheduler framework for blk-mq
+ *
+ * Schedulers register a blk_mq_sched_type and are selected per queue
+ * through the usual queue/scheduler sysfs file. "none" keeps the plain
+ * software queue dispatch.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/elevator.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
+
+#include "blk.h"
+#include "blk-mq.h"
+#include "blk-mq-sched.h"
+
+static DEFINE_SPINLOCK(mq_sched_list_lock);
+static LIST_HEAD(mq_sched_list);
+
+static struct blk_mq_sched_type *blk_mq_sched_find(const char *name)
+{
+	struct blk_mq_sched_type *s;
+
+	list_for_each_entry(s, &mq_sched_list, list) {
+		if (!strcmp(s->name, name))
+			return s;
+	}
+
+	return NULL;
+}
+
+static struct blk_mq_sched_type *blk_mq_sched_get(const char *name)
+{
+	struct blk_mq_sched_type *s;
+
+	spin_lock(&mq_sched_list_lock);
+	s = blk_mq_sched_find(name);
+	if (s && !try_module_get(s->owner))
+		s = NULL;
+	spin_unlock(&mq_sched_list_lock);
+
+	if (!s && !request_module("%s", name)) {
+		spin_lock(&mq_sched_list_lock);
+		s = blk_mq_sched_find(name);
+		if (s && !try_module_get(s->owner))
+			s = NULL;
+		spin_unlock(&mq_sched_list_lock);
+	}
+
+	return s;
+}
+
+static void blk_mq_sched_exit_hctxs(struct request_queue *q,
+				    struct blk_mq_sched_type *s,
+				    unsigned int nr)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (i == nr)
+			break;
+		s->ops.exit_hctx(hctx);
+		hctx->sched_data = NULL;
+	}
+}
+
+/*
+ * Quiesce the queue so that neither the insert nor the dispatch side
+ * can be looking at the scheduler while it is being replaced. Freezing
+ * drains all requests, what is left are queue runs without any request
+ * to issue.
+ */
+static void blk_mq_sched_quiesce(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	blk_mq_freeze_queue(q);
+	blk_mq_stop_hw_queues(q);
+	queue_for_each_hw_ctx(q, hctx, i) {
+		cancel_delayed_work_sync(&hctx->run_work);
+		cancel_delayed_work_sync(&hctx->delay_work);
+	}
+	/* direct queue runs happen with preemption disabled */
+	synchronize_sched();
+}
+
+static void blk_mq_sched_resume(struct request_queue *q)
+{
+	blk_mq_start_stopped_hw_queues(q, true);
+	blk_mq_unfreeze_queue(q);
+}
+
+static int blk_mq_sched_switch(struct request_queue *q,
+			       struct blk_mq_sched_type *new)
+{
+	struct blk_mq_sched_type *old = q->mq_sched;
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+	int ret = 0;
+
+	blk_mq_sched_quiesce(q);
+
+	if (old) {
+		blk_mq_sched_exit_hctxs(q, old, q->nr_hw_queues);
+		q->mq_sched = NULL;
+		module_put(old->owner);
+	}
+
+	if (new) {
+		queue_for_each_hw_ctx(q, hctx, i) {
+			ret = new->ops.init_hctx(hctx);
+			if (ret) {
+				blk_mq_sched_exit_hctxs(q, new, i);
+				module_put(new->owner);
+				break;
+			}
+		}
+		if (!ret)
+			q->mq_sched = new;
+	}
+
+	blk_mq_sched_resume(q);
+	return ret;
+}
+
+int blk_mq_sched_change(struct request_queue *q, const char *name)
+{
+	char sched_name[ELV_NAME_MAX];
+	struct blk_mq_sched_type *s = NULL;
+
+	strlcpy(sched_name, name, sizeof(sched_name));
+	strstrip(sched_name);
+
+	if (strcmp(sched_name, "none")) {
+		s = blk_mq_sched_get(sched_name);
+		if (!s)
+			return -EINVAL;
+	}
+
+	if (s == q->mq_sched) {
+		if (s)
+			module_put(s->owner);
+		return 0;
+	}
+
+	return blk_mq_sched_switch(q, s);
+}
+
+ssize_t blk_mq_sched_show(struct request_queue *q, char *page)
+{
+	struct blk_mq_sched_type *s;
+	int len;
+
+	if (!q->mq_sched)
+		len = sprintf(page, "[none] ");
+	else
+		len = sprintf(page, "none ");
+
+	spin_lock(&mq_sched_list_lock);
+	list_for_each_entry(s, &mq_sched_list, list) {
+		if (s == q->mq_sched)
+			len += sprintf(page + len, "[%s] ", s->name);
+		else
+			len += sprintf(page + len, "%s ", s->name);
+	}
+	spin_unlock(&mq_sched_list_lock);
+
+	len += sprintf(page + len, "\n");
+	return len;
+}
+
+/*
+ * Called on queue teardown, once all requests are gone.
+ */
+void blk_mq_sched_exit(struct request_queue *q)
+{
+	struct blk_mq_sched_type *s = q->mq_sched;
+
+	if (!s)
+		return;
+
+	blk_mq_sched_exit_hctxs(q, s, q->nr_hw_queues);
+	q->mq_sched = NULL;
+	module_put(s->owner);
+}
+
+int blk_mq_sched_register(struct blk_mq_sched_type *s)
+{
+	spin_lock(&mq_sched_list_lock);
+	if (blk_mq_sched_find(s->name)) {
+		spin_unlock(&mq_sched_list_lock);
+		return -EBUSY;
+	}
+	list_add_tail(&s->list, &mq_sched_list);
+	spin_unlock(&mq_sched_list_lock);
+
+	printk(KERN_INFO "io scheduler %s registered (blk-mq)\n", s->name);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(blk_mq_sched_register);
+
+void blk_mq_sched_unregister(struct blk_mq_sched_type *s)
+{
+	spin_lock(&mq_sched_list_lock);
+	list_del_init(&s->list);
+	spin_unlock(&mq_sched_list_lock);
+}
+EXPORT_SYMBOL_GPL(blk_mq_sched_unregister);
@@ -0,0 +1,42 @@
+#ifndef INT_BLK_MQ_SCHED_H
+#define INT_BLK_MQ_SCHED_H
+
+#include <linux/blk-mq.h>
+
+/*
+ * A blk-mq scheduler keeps its own queue per hardware context. Requests
+ * are handed to it instead of being put on the software queues, and it
+ * picks the next one to issue every time the hardware queue is run.
+ * All hooks are called without any blk-mq lock held except for
+ * ->insert_request, which may be called under the software queue lock.
+ */
+struct blk_mq_sched_ops {
+	int (*init_hctx)(struct blk_mq_hw_ctx *);
+	void (*exit_hctx)(struct blk_mq_hw_ctx *);
+	void (*insert_request)(struct blk_mq_hw_ctx *, struct request *, bool);
+	struct request *(*dispatch_request)(struct blk_mq_hw_ctx *);
+	bool (*has_work)(struct blk_mq_hw_ctx *);
+};
+
+struct blk_mq_sched_type {
+	struct blk_mq_sched_ops ops;
+	const char *name;
+	struct module *owner;
+	struct list_head list;
+};
+
+int blk_mq_sched_register(struct blk_mq_sched_type *);
+void blk_mq_sched_unregister(struct blk_mq_sched_type *);
+
+ssize_t blk_mq_sched_show(struct request_queue *q, char *page);
+int blk_mq_sched_change(struct request_queue *q, const char *name);
+void blk_mq_sched_exit(struct request_queue *q);
+
+static inline bool blk_mq_sched_has_work(struct blk_mq_hw_ctx *hctx)
+{
+	struct blk_mq_sched_type *s = hctx->queue->mq_sched;
+
+	return s && s->ops.has_work(hctx);
+}
+
+#endif
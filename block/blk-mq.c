@@ -21,6 +21,7 @@
 #include <linux/sched/sysctl.h>
 #include <linux/delay.h>
 #include <linux/crash_dump.h>
+#include <linux/hrtimer.h>
 
 #include <trace/events/block.h>
 
@@ -28,6 +29,8 @@
 #include "blk.h"
 #include "blk-mq.h"
 #include "blk-mq-tag.h"
+#include "blk-mq-sched.h"
+#include "blk-wbt.h"
 
 static DEFINE_MUTEX(all_q_mutex);
 static LIST_HEAD(all_q_list);
@@ -193,6 +196,7 @@ static void blk_mq_rq_ctx_init(struct request_queue *q, struct blk_mq_ctx *ctx,
 	rq->rq_disk = NULL;
 	rq->part = NULL;
 	rq->start_time = jiffies;
+	rq->issue_time_ns = 0;
 #ifdef CONFIG_BLK_CGROUP
 	rq->rl = NULL;
 	set_start_time_ns(rq);
@@ -291,6 +295,8 @@ static void __blk_mq_free_request(struct blk_mq_hw_ctx *hctx,
 	const int tag = rq->tag;
 	struct request_queue *q = rq->q;
 
+	wbt_done(q->rq_wb, rq);
+
 	if (rq->cmd_flags & REQ_MQ_INFLIGHT)
 		atomic_dec(&hctx->nr_active);
 	rq->cmd_flags = 0;
@@ -375,10 +381,37 @@ static void blk_mq_ipi_complete_request(struct request *rq)
 	put_cpu();
 }
 
+/*
+ * Keep a running mean of the issue to completion time on polled queues,
+ * the hybrid poller sleeps for half of it before it starts spinning.
+ * Updates from different CPUs may race, the result only has to be
+ * roughly right.
+ */
+static void blk_mq_poll_stat_add(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	struct blk_mq_hw_ctx *hctx = q->mq_ops->map_queue(q, rq->mq_ctx->cpu);
+	u64 *mean = &hctx->poll_mean_ns[rq_data_dir(rq)];
+	s64 delta = ktime_get_ns() - rq->issue_time_ns;
+	u64 cur = READ_ONCE(*mean);
+
+	if (delta <= 0)
+		return;
+
+	if (!cur)
+		WRITE_ONCE(*mean, delta);
+	else
+		WRITE_ONCE(*mean, cur - (cur >> 3) + (delta >> 3));
+}
+
 void __blk_mq_complete_request(struct request *rq)
 {
 	struct request_queue *q = rq->q;
 
+	if (rq->issue_time_ns && rq->cmd_type == REQ_TYPE_FS &&
+	    test_bit(QUEUE_FLAG_POLL, &q->queue_flags))
+		blk_mq_poll_stat_add(rq);
+
 	if (!q->softirq_done_fn)
 		blk_mq_end_request(rq, rq->errors);
 	else
@@ -441,6 +474,13 @@ void blk_mq_start_request(struct request *rq)
 	if (test_bit(REQ_ATOM_COMPLETE, &rq->atomic_flags))
 		clear_bit(REQ_ATOM_COMPLETE, &rq->atomic_flags);
 
+	if (test_bit(QUEUE_FLAG_POLL, &q->queue_flags) || q->rq_wb) {
+		rq->issue_time_ns = ktime_get_ns();
+		clear_bit(REQ_ATOM_POLL_SLEPT, &rq->atomic_flags);
+	} else {
+		rq->issue_time_ns = 0;
+	}
+
 	if (q->dma_drain_size && blk_rq_bytes(rq)) {
 		/*
 		 * Make sure space for the drain appears.  We know we can do
@@ -741,6 +781,7 @@ static void flush_busy_ctxs(struct blk_mq_hw_ctx *hctx, struct list_head *list)
 static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
 {
 	struct request_queue *q = hctx->queue;
+	struct blk_mq_sched_type *sched = q->mq_sched;
 	struct request *rq;
 	LIST_HEAD(rq_list);
 	LIST_HEAD(driver_list);
@@ -780,16 +821,30 @@ static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
 	 * Now process all the entries, sending them to the driver.
 	 */
 	queued = 0;
-	while (!list_empty(&rq_list)) {
+	while (1) {
 		struct blk_mq_queue_data bd;
 		int ret;
 
+		/*
+		 * With a scheduler attached, pull requests one at a time so
+		 * that it gets to pick again after every issue.
+		 */
+		if (list_empty(&rq_list)) {
+			if (!sched)
+				break;
+			rq = sched->ops.dispatch_request(hctx);
+			if (!rq)
+				break;
+			list_add(&rq->queuelist, &rq_list);
+		}
+
 		rq = list_first_entry(&rq_list, struct request, queuelist);
 		list_del_init(&rq->queuelist);
 
 		bd.rq = rq;
 		bd.list = dptr;
-		bd.last = list_empty(&rq_list);
+		bd.last = list_empty(&rq_list) &&
+			  (!sched || !sched->ops.has_work(hctx));
 
 		ret = q->mq_ops->queue_rq(hctx, &bd);
 		switch (ret) {
@@ -900,6 +955,7 @@ void blk_mq_run_hw_queues(struct request_queue *q, bool async)
 
 	queue_for_each_hw_ctx(q, hctx, i) {
 		if ((!blk_mq_hctx_has_pending(hctx) &&
+		    !blk_mq_sched_has_work(hctx) &&
 		    list_empty_careful(&hctx->dispatch)) ||
 		    test_bit(BLK_MQ_S_STOPPED, &hctx->state))
 			continue;
@@ -993,9 +1049,15 @@ static void __blk_mq_insert_request(struct blk_mq_hw_ctx *hctx,
 				    struct request *rq, bool at_head)
 {
 	struct blk_mq_ctx *ctx = rq->mq_ctx;
+	struct blk_mq_sched_type *sched = hctx->queue->mq_sched;
 
 	trace_block_rq_insert(hctx->queue, rq);
 
+	if (sched) {
+		sched->ops.insert_request(hctx, rq, at_head);
+		return;
+	}
+
 	if (at_head)
 		list_add(&rq->queuelist, &ctx->rq_list);
 	else
@@ -1248,7 +1310,7 @@ static int blk_mq_direct_issue_request(struct request *rq)
  * but will attempt to bypass the hctx queueing if we can go straight to
  * hardware for SYNC IO.
  */
-static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
+static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 {
 	const int is_sync = rw_is_sync(bio->bi_rw);
 	const int is_flush_fua = bio->bi_rw & (REQ_FLUSH | REQ_FUA);
@@ -1257,23 +1319,34 @@ static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
 	unsigned int request_count = 0;
 	struct blk_plug *plug;
 	struct request *same_queue_rq = NULL;
+	blk_qc_t cookie;
+	bool wb_acct;
 
 	blk_queue_bounce(q, &bio);
 
 	if (bio_integrity_enabled(bio) && bio_integrity_prep(bio)) {
 		bio_io_error(bio);
-		return;
+		return BLK_QC_T_NONE;
 	}
 
 	blk_queue_split(q, &bio, q->bio_split);
 
 	if (!is_flush_fua && !blk_queue_nomerges(q) &&
 	    blk_attempt_plug_merge(q, bio, &request_count, &same_queue_rq))
-		return;
+		return BLK_QC_T_NONE;
+
+	wb_acct = wbt_wait(q->rq_wb, bio, NULL);
 
 	rq = blk_mq_map_request(q, bio, &data);
-	if (unlikely(!rq))
-		return;
+	if (unlikely(!rq)) {
+		if (wb_acct)
+			__wbt_done(q->rq_wb);
+		return BLK_QC_T_NONE;
+	}
+
+	wbt_track(rq, wb_acct);
+
+	cookie = blk_tag_to_qc_t(rq->tag, data.hctx->queue_num);
 
 	if (unlikely(is_flush_fua)) {
 		blk_mq_bio_to_request(rq, bio);
@@ -1285,10 +1358,11 @@ static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
 	/*
 	 * If the driver supports defer issued based on 'last', then
 	 * queue it up like normal since we can potentially save some
-	 * CPU this way.
+	 * CPU this way. Likewise if a scheduler is attached, it has to
+	 * see every request to order them.
 	 */
 	if (((plug && !blk_queue_nomerges(q)) || is_sync) &&
-	    !(data.hctx->flags & BLK_MQ_F_DEFER_ISSUE)) {
+	    !(data.hctx->flags & BLK_MQ_F_DEFER_ISSUE) && !q->mq_sched) {
 		struct request *old_rq = NULL;
 
 		blk_mq_bio_to_request(rq, bio);
@@ -1312,11 +1386,11 @@ static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
 			old_rq = rq;
 		blk_mq_put_ctx(data.ctx);
 		if (!old_rq)
-			return;
+			goto done;
 		if (!blk_mq_direct_issue_request(old_rq))
-			return;
+			goto done;
 		blk_mq_insert_request(old_rq, false, true, true);
-		return;
+		goto done;
 	}
 
 	if (!blk_mq_merge_queue_io(data.hctx, data.ctx, rq, bio)) {
@@ -1328,15 +1402,19 @@ static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
 		 */
 run_queue:
 		blk_mq_run_hw_queue(data.hctx, !is_sync || is_flush_fua);
+	} else {
+		cookie = BLK_QC_T_NONE;
 	}
 	blk_mq_put_ctx(data.ctx);
+done:
+	return cookie;
 }
 
 /*
  * Single hardware queue variant. This will attempt to use any per-process
  * plug for merging and IO deferral.
  */
-static void blk_sq_make_request(struct request_queue *q, struct bio *bio)
+static blk_qc_t blk_sq_make_request(struct request_queue *q, struct bio *bio)
 {
 	const int is_sync = rw_is_sync(bio->bi_rw);
 	const int is_flush_fua = bio->bi_rw & (REQ_FLUSH | REQ_FUA);
@@ -1344,23 +1422,34 @@ static void blk_sq_make_request(struct request_queue *q, struct bio *bio)
 	unsigned int request_count = 0;
 	struct blk_map_ctx data;
 	struct request *rq;
+	blk_qc_t cookie;
+	bool wb_acct;
 
 	blk_queue_bounce(q, &bio);
 
 	if (bio_integrity_enabled(bio) && bio_integrity_prep(bio)) {
 		bio_io_error(bio);
-		return;
+		return BLK_QC_T_NONE;
 	}
 
 	blk_queue_split(q, &bio, q->bio_split);
 
 	if (!is_flush_fua && !blk_queue_nomerges(q) &&
 	    blk_attempt_plug_merge(q, bio, &request_count, NULL))
-		return;
+		return BLK_QC_T_NONE;
+
+	wb_acct = wbt_wait(q->rq_wb, bio, NULL);
 
 	rq = blk_mq_map_request(q, bio, &data);
-	if (unlikely(!rq))
-		return;
+	if (unlikely(!rq)) {
+		if (wb_acct)
+			__wbt_done(q->rq_wb);
+		return BLK_QC_T_NONE;
+	}
+
+	wbt_track(rq, wb_acct);
+
+	cookie = blk_tag_to_qc_t(rq->tag, data.hctx->queue_num);
 
 	if (unlikely(is_flush_fua)) {
 		blk_mq_bio_to_request(rq, bio);
@@ -1384,7 +1473,7 @@ static void blk_sq_make_request(struct request_queue *q, struct bio *bio)
 		}
 		list_add_tail(&rq->queuelist, &plug->mq_list);
 		blk_mq_put_ctx(data.ctx);
-		return;
+		return cookie;
 	}
 
 	if (!blk_mq_merge_queue_io(data.hctx, data.ctx, rq, bio)) {
@@ -1396,10 +1485,123 @@ static void blk_sq_make_request(struct request_queue *q, struct bio *bio)
 		 */
 run_queue:
 		blk_mq_run_hw_queue(data.hctx, !is_sync || is_flush_fua);
+	} else {
+		cookie = BLK_QC_T_NONE;
 	}
 
 	blk_mq_put_ctx(data.ctx);
+	return cookie;
+}
+
+/*
+ * Sleep for a while before spinning on @rq, once per request. Unless a
+ * fixed delay has been configured, this is half of the mean completion
+ * time, so that we usually wake up before the request is done.
+ */
+static bool blk_mq_poll_hybrid_sleep(struct request_queue *q,
+				     struct blk_mq_hw_ctx *hctx,
+				     struct request *rq)
+{
+	struct hrtimer_sleeper hs;
+	enum hrtimer_mode mode;
+	u64 nsecs;
+
+	if (q->poll_nsec == -1)
+		return false;
+
+	if (test_and_set_bit(REQ_ATOM_POLL_SLEPT, &rq->atomic_flags))
+		return false;
+
+	if (q->poll_nsec > 0)
+		nsecs = q->poll_nsec;
+	else
+		nsecs = READ_ONCE(hctx->poll_mean_ns[rq_data_dir(rq)]) / 2;
+	if (!nsecs)
+		return false;
+
+	hrtimer_init_on_stack(&hs.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	hrtimer_set_expires(&hs.timer, ns_to_ktime(nsecs));
+	hrtimer_init_sleeper(&hs, current);
+
+	mode = HRTIMER_MODE_REL;
+	do {
+		if (test_bit(REQ_ATOM_COMPLETE, &rq->atomic_flags))
+			break;
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		hrtimer_start_expires(&hs.timer, mode);
+		if (hs.task)
+			io_schedule();
+		hrtimer_cancel(&hs.timer);
+		mode = HRTIMER_MODE_ABS;
+	} while (hs.task && !signal_pending(current));
+
+	__set_current_state(TASK_RUNNING);
+	destroy_hrtimer_on_stack(&hs.timer);
+	return true;
+}
+
+/**
+ * blk_poll - poll for completion of the I/O identified by @cookie
+ * @q:		the queue the I/O was submitted to
+ * @cookie:	as returned by submit_bio()
+ *
+ * Description:
+ *	Called by a task waiting for its own I/O, with the task state already
+ *	set for sleeping. Returns true if the caller should recheck its
+ *	completion condition rather than go to sleep, which is the case
+ *	once the request completed or the task was woken up.
+ */
+bool blk_poll(struct request_queue *q, blk_qc_t cookie)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_plug *plug;
+	struct request *rq;
+	unsigned int tag;
+	long state;
+
+	if (!q->mq_ops || !q->mq_ops->poll || !blk_qc_t_valid(cookie) ||
+	    !test_bit(QUEUE_FLAG_POLL, &q->queue_flags))
+		return false;
+
+	plug = current->plug;
+	if (plug)
+		blk_flush_plug_list(plug, false);
+
+	hctx = q->queue_hw_ctx[blk_qc_t_to_queue_num(cookie)];
+	tag = blk_qc_t_to_tag(cookie);
+	rq = blk_mq_tag_to_rq(hctx->tags, tag);
+
+	hctx->poll_considered++;
+
+	if (blk_mq_poll_hybrid_sleep(q, hctx, rq))
+		return true;
+
+	state = current->state;
+	while (!need_resched()) {
+		int ret;
+
+		hctx->poll_invoked++;
+
+		ret = q->mq_ops->poll(hctx, tag);
+		if (ret > 0) {
+			hctx->poll_success++;
+			set_current_state(TASK_RUNNING);
+			return true;
+		}
+
+		if (signal_pending_state(state, current))
+			set_current_state(TASK_RUNNING);
+
+		if (current->state == TASK_RUNNING)
+			return true;
+		if (ret < 0)
+			break;
+		cpu_relax();
+	}
+
+	return false;
 }
+EXPORT_SYMBOL_GPL(blk_poll);
 
 /*
  * Default mapping to a software queue, since we use one per CPU.
@@ -2075,6 +2277,7 @@ void blk_mq_free_queue(struct request_queue *q)
 
 	blk_mq_del_queue_tag_set(q);
 
+	blk_mq_sched_exit(q);
 	blk_mq_exit_hw_queues(q, set, set->nr_hw_queues);
 	blk_mq_free_hw_queues(q, set);
 
@@ -21,6 +21,14 @@ static int throtl_quantum = 32;
 /* Throttling is performed over 100ms slice and after that slice is renewed */
 static unsigned long throtl_slice = HZ/10;	/* 100 ms */
 
+/*
+ * Latency targets are evaluated once per window.  While a target is being
+ * missed, groups without one are capped to an IOPS budget that is halved
+ * every missed window and doubled every met one, never below this floor.
+ */
+static unsigned long throtl_lat_window = HZ/10;	/* 100 ms */
+#define THROTL_LAT_MIN_IOPS	16
+
 static struct blkcg_policy blkcg_policy_throtl;
 
 /* A workqueue to queue throttle related work */
@@ -125,6 +133,16 @@ struct throtl_grp {
 	/* IOPS limits */
 	unsigned int iops[2];
 
+	/* completion latency target in usecs, -1 if none */
+	unsigned int latency_target;
+
+	/* does this group or any of its parents have a latency target? */
+	bool lat_protected;
+
+	/* completion latencies sampled in the current latency window */
+	atomic64_t lat_sum;
+	atomic_t lat_nr;
+
 	/* Number of bytes disptached in current slice */
 	uint64_t bytes_disp[2];
 	/* Number of bio's dispatched in current slice */
@@ -152,6 +170,19 @@ struct throtl_data
 
 	/* Work for dispatching throttled bios */
 	struct work_struct dispatch_work;
+
+	/* number of groups with a latency target */
+	unsigned int nr_lat_grps;
+
+	/* are unprotected groups currently capped to lat_iops? */
+	bool lat_throttling;
+	unsigned int lat_iops;
+	/* unprotected dispatch rate when capping began */
+	unsigned int lat_iops_base;
+
+	/* bios dispatched by unprotected groups in the current window */
+	unsigned int lat_io_disp;
+	unsigned long lat_window_start;
 };
 
 static void throtl_pending_timer_fn(unsigned long arg);
@@ -344,6 +375,7 @@ static struct blkg_policy_data *throtl_pd_alloc(gfp_t gfp, int node)
 	tg->bps[WRITE] = -1;
 	tg->iops[READ] = -1;
 	tg->iops[WRITE] = -1;
+	tg->latency_target = -1;
 
 	return &tg->pd;
 }
@@ -387,6 +419,9 @@ static void tg_update_has_rules(struct throtl_grp *tg)
 	for (rw = READ; rw <= WRITE; rw++)
 		tg->has_rules[rw] = (parent_tg && parent_tg->has_rules[rw]) ||
 				    (tg->bps[rw] != -1 || tg->iops[rw] != -1);
+
+	tg->lat_protected = (parent_tg && parent_tg->lat_protected) ||
+			    tg->latency_target != -1;
 }
 
 static void throtl_pd_online(struct blkg_policy_data *pd)
@@ -398,6 +433,16 @@ static void throtl_pd_online(struct blkg_policy_data *pd)
 	tg_update_has_rules(pd_to_tg(pd));
 }
 
+static void throtl_pd_offline(struct blkg_policy_data *pd)
+{
+	struct throtl_grp *tg = pd_to_tg(pd);
+
+	if (tg->latency_target != -1) {
+		tg->latency_target = -1;
+		tg->td->nr_lat_grps--;
+	}
+}
+
 static void throtl_pd_free(struct blkg_policy_data *pd)
 {
 	struct throtl_grp *tg = pd_to_tg(pd);
@@ -606,6 +651,29 @@ static bool throtl_slice_used(struct throtl_grp *tg, bool rw)
 	return 1;
 }
 
+/*
+ * Groups which can be capped while a latency target is being missed: the
+ * top-level groups below the root which don't have a target themselves.
+ * On the default hierarchy, descendants are covered through their
+ * top-level ancestor.  IOs issued directly from the root are never capped.
+ */
+static bool tg_lat_cappable(struct throtl_grp *tg)
+{
+	struct blkcg_gq *blkg = tg_to_blkg(tg);
+
+	return !tg->lat_protected && blkg->parent && !blkg->parent->parent;
+}
+
+/* the IOPS limit in effect for @tg, including the latency cap */
+static unsigned int tg_iops_limit(struct throtl_grp *tg, bool rw)
+{
+	struct throtl_data *td = tg->td;
+
+	if (td->lat_throttling && tg_lat_cappable(tg))
+		return min(tg->iops[rw], td->lat_iops);
+	return tg->iops[rw];
+}
+
 /* Trim the used slices and adjust slice start accordingly */
 static inline void throtl_trim_slice(struct throtl_grp *tg, bool rw)
 {
@@ -642,7 +710,7 @@ static inline void throtl_trim_slice(struct throtl_grp *tg, bool rw)
 	do_div(tmp, HZ);
 	bytes_trim = tmp;
 
-	io_trim = (tg->iops[rw] * throtl_slice * nr_slices)/HZ;
+	io_trim = (tg_iops_limit(tg, rw) * throtl_slice * nr_slices)/HZ;
 
 	if (!bytes_trim && !io_trim)
 		return;
@@ -669,6 +737,7 @@ static bool tg_with_in_iops_limit(struct throtl_grp *tg, struct bio *bio,
 				  unsigned long *wait)
 {
 	bool rw = bio_data_dir(bio);
+	unsigned int iops = tg_iops_limit(tg, rw);
 	unsigned int io_allowed;
 	unsigned long jiffy_elapsed, jiffy_wait, jiffy_elapsed_rnd;
 	u64 tmp;
@@ -688,7 +757,7 @@ static bool tg_with_in_iops_limit(struct throtl_grp *tg, struct bio *bio,
 	 * have been trimmed.
 	 */
 
-	tmp = (u64)tg->iops[rw] * jiffy_elapsed_rnd;
+	tmp = (u64)iops * jiffy_elapsed_rnd;
 	do_div(tmp, HZ);
 
 	if (tmp > UINT_MAX)
@@ -703,7 +772,7 @@ static bool tg_with_in_iops_limit(struct throtl_grp *tg, struct bio *bio,
 	}
 
 	/* Calc approx time to dispatch */
-	jiffy_wait = ((tg->io_disp[rw] + 1) * HZ)/tg->iops[rw] + 1;
+	jiffy_wait = ((tg->io_disp[rw] + 1) * HZ)/iops + 1;
 
 	if (jiffy_wait > jiffy_elapsed)
 		jiffy_wait = jiffy_wait - jiffy_elapsed;
@@ -777,7 +846,7 @@ static bool tg_may_dispatch(struct throtl_grp *tg, struct bio *bio,
 	       bio != throtl_peek_queued(&tg->service_queue.queued[rw]));
 
 	/* If tg->bps = -1, then BW is unlimited */
-	if (tg->bps[rw] == -1 && tg->iops[rw] == -1) {
+	if (tg->bps[rw] == -1 && tg_iops_limit(tg, rw) == -1) {
 		if (wait)
 			*wait = 0;
 		return true;
@@ -821,6 +890,9 @@ static void throtl_charge_bio(struct throtl_grp *tg, struct bio *bio)
 	tg->bytes_disp[rw] += bio->bi_iter.bi_size;
 	tg->io_disp[rw]++;
 
+	if (tg->td->nr_lat_grps && tg_lat_cappable(tg))
+		tg->td->lat_io_disp++;
+
 	/*
 	 * REQ_THROTTLED is used to prevent the same bio to be throttled
 	 * more than once as a throttled bio will go through blk-throtl the
@@ -1227,6 +1299,46 @@ static ssize_t tg_set_conf_uint(struct kernfs_open_file *of,
 	return tg_set_conf(of, buf, nbytes, off, false);
 }
 
+static ssize_t tg_set_latency(struct kernfs_open_file *of,
+			      char *buf, size_t nbytes, loff_t off)
+{
+	struct blkcg *blkcg = css_to_blkcg(of_css(of));
+	struct blkg_conf_ctx ctx;
+	struct throtl_grp *tg;
+	unsigned int v;
+	int ret;
+
+	ret = blkg_conf_prep(blkcg, &blkcg_policy_throtl, buf, &ctx);
+	if (ret)
+		return ret;
+
+	ret = -EINVAL;
+	if (!strcmp(strim(ctx.body), "max"))
+		v = 0;
+	else if (sscanf(ctx.body, "%u", &v) != 1)
+		goto out_finish;
+	if (!v)
+		v = -1;
+
+	tg = blkg_to_tg(ctx.blkg);
+
+	if (tg->latency_target == -1 && v != -1)
+		tg->td->nr_lat_grps++;
+	else if (tg->latency_target != -1 && v == -1)
+		tg->td->nr_lat_grps--;
+	tg->latency_target = v;
+
+	/* drop the cap right away once no group wants protection */
+	if (!tg->td->nr_lat_grps)
+		tg->td->lat_throttling = false;
+
+	tg_conf_updated(tg);
+	ret = 0;
+out_finish:
+	blkg_conf_finish(&ctx);
+	return ret ?: nbytes;
+}
+
 static struct cftype throtl_legacy_files[] = {
 	{
 		.name = "throttle.read_bps_device",
@@ -1252,6 +1364,12 @@ static struct cftype throtl_legacy_files[] = {
 		.seq_show = tg_print_conf_uint,
 		.write = tg_set_conf_uint,
 	},
+	{
+		.name = "throttle.latency_target_device",
+		.private = offsetof(struct throtl_grp, latency_target),
+		.seq_show = tg_print_conf_uint,
+		.write = tg_set_latency,
+	},
 	{
 		.name = "throttle.io_service_bytes",
 		.private = (unsigned long)&blkcg_policy_throtl,
@@ -1373,6 +1491,13 @@ static struct cftype throtl_files[] = {
 		.seq_show = tg_print_max,
 		.write = tg_set_max,
 	},
+	{
+		.name = "latency",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.private = offsetof(struct throtl_grp, latency_target),
+		.seq_show = tg_print_conf_uint,
+		.write = tg_set_latency,
+	},
 	{ }	/* terminate */
 };
 
@@ -1390,9 +1515,60 @@ static struct blkcg_policy blkcg_policy_throtl = {
 	.pd_alloc_fn		= throtl_pd_alloc,
 	.pd_init_fn		= throtl_pd_init,
 	.pd_online_fn		= throtl_pd_online,
+	.pd_offline_fn		= throtl_pd_offline,
 	.pd_free_fn		= throtl_pd_free,
 };
 
+/*
+ * Called with queue_lock held once a latency window has elapsed.  Compare
+ * the mean completion latency of every group with a target against it and
+ * tighten or relax the cap on unprotected groups accordingly.
+ */
+static void throtl_lat_window_end(struct throtl_data *td)
+{
+	unsigned long elapsed = jiffies - td->lat_window_start;
+	struct blkcg_gq *blkg;
+	bool missed = false;
+
+	list_for_each_entry(blkg, &td->queue->blkg_list, q_node) {
+		struct throtl_grp *tg = blkg_to_tg(blkg);
+		unsigned int nr;
+		u64 sum;
+
+		if (!tg || tg->latency_target == -1)
+			continue;
+
+		nr = atomic_xchg(&tg->lat_nr, 0);
+		sum = atomic64_xchg(&tg->lat_sum, 0);
+		if (nr && div_u64(sum, nr) > (u64)tg->latency_target * 1000)
+			missed = true;
+	}
+
+	if (missed) {
+		if (!td->lat_throttling) {
+			u64 rate = div_u64((u64)td->lat_io_disp * HZ,
+					   max(elapsed, 1UL));
+
+			td->lat_iops_base = max_t(u64, rate,
+						  THROTL_LAT_MIN_IOPS);
+			td->lat_iops = td->lat_iops_base;
+			td->lat_throttling = true;
+		}
+		td->lat_iops = max_t(unsigned int, td->lat_iops / 2,
+				     THROTL_LAT_MIN_IOPS);
+	} else if (td->lat_throttling) {
+		td->lat_iops *= 2;
+		if (td->lat_iops >= td->lat_iops_base)
+			td->lat_throttling = false;
+	}
+
+	throtl_log(&td->service_queue, "latency window %s throttling=%d iops=%u",
+		   missed ? "missed" : "met", td->lat_throttling, td->lat_iops);
+
+	td->lat_io_disp = 0;
+	td->lat_window_start = jiffies;
+}
+
 bool blk_throtl_bio(struct request_queue *q, struct blkcg_gq *blkg,
 		    struct bio *bio)
 {
@@ -1405,7 +1581,8 @@ bool blk_throtl_bio(struct request_queue *q, struct blkcg_gq *blkg,
 	WARN_ON_ONCE(!rcu_read_lock_held());
 
 	/* see throtl_charge_bio() */
-	if ((bio->bi_rw & REQ_THROTTLED) || !tg->has_rules[rw])
+	if ((bio->bi_rw & REQ_THROTTLED) ||
+	    (!tg->has_rules[rw] && !tg->td->nr_lat_grps))
 		goto out;
 
 	spin_lock_irq(q->queue_lock);
@@ -1413,6 +1590,29 @@ bool blk_throtl_bio(struct request_queue *q, struct blkcg_gq *blkg,
 	if (unlikely(blk_queue_bypass(q)))
 		goto out_unlock;
 
+	if (tg->td->nr_lat_grps) {
+		struct throtl_data *td = tg->td;
+
+		if (time_after_eq(jiffies,
+				  td->lat_window_start + throtl_lat_window))
+			throtl_lat_window_end(td);
+
+		/*
+		 * Sample the completion latency of protected groups against
+		 * the nearest ancestor which has the target configured.
+		 */
+		if (tg->lat_protected && !bio->bi_cg_private) {
+			struct throtl_grp *ltg = tg;
+
+			while (ltg->latency_target == -1)
+				ltg = blkg_to_tg(tg_to_blkg(ltg)->parent);
+
+			blkg_get(tg_to_blkg(ltg));
+			bio->bi_cg_private = ltg;
+			bio->bi_throtl_start = ktime_get_ns();
+		}
+	}
+
 	sq = &tg->service_queue;
 
 	while (true) {
@@ -1488,6 +1688,26 @@ out:
 	return throttled;
 }
 
+/**
+ * blk_throtl_bio_endio - account the completion latency of a bio
+ * @bio: the completing bio
+ *
+ * Called from bio_endio().  If @bio was stamped by blk_throtl_bio(), add
+ * its latency to its group's current window and drop the blkg reference.
+ */
+void blk_throtl_bio_endio(struct bio *bio)
+{
+	struct throtl_grp *tg = bio->bi_cg_private;
+
+	if (!tg)
+		return;
+	bio->bi_cg_private = NULL;
+
+	atomic64_add(ktime_get_ns() - bio->bi_throtl_start, &tg->lat_sum);
+	atomic_inc(&tg->lat_nr);
+	blkg_put(tg_to_blkg(tg));
+}
+
 /*
  * Dispatch all bios from all children tg's queued on @parent_sq.  On
  * return, @parent_sq is guaranteed to not have any active children tg's
@@ -1566,6 +1786,7 @@ int blk_throtl_init(struct request_queue *q)
 
 	q->td = td;
 	td->queue = q;
+	td->lat_window_start = jiffies;
 
 	/* activate policy */
 	ret = blkcg_activate_policy(q, &blkcg_policy_throtl);
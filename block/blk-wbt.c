@@ -0,0 +1,272 @@
+/*
+ * Buffered writeback throttling
+ *
+ * Background writeback is allowed to keep only a limited number of
+ * writes in flight on a device. The limit starts at a fraction of the
+ * queue depth and is scaled based on the completion latency of all the
+ * other, unthrottled, I/O: like CoDel, we look at the minimum latency
+ * seen in a monitoring window. If even the fastest completion missed
+ * the target, the device queue is too deep and the write limit is
+ * halved, with the window shrinking as we keep scaling down. Once the
+ * target is met again, or nothing but writeback is running, the limit
+ * is raised step by step.
+ */
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/slab.h>
+#include <linux/swap.h>
+#include <linux/jiffies.h>
+
+#include "blk-wbt.h"
+
+#define RWB_WINDOW_NSEC		(100 * NSEC_PER_MSEC)
+#define RWB_NONROT_LAT_NSEC	(2 * NSEC_PER_MSEC)
+#define RWB_ROT_LAT_NSEC	(75 * NSEC_PER_MSEC)
+
+/* if unthrottled I/O completed this recently, leave room for it */
+#define RWB_RECENT_IO		(HZ / 10)
+
+static void calc_wb_limits(struct rq_wb *rwb)
+{
+	unsigned int depth = max(rwb->queue_depth, 1U);
+
+	if (rwb->scale_step > 0)
+		depth = 1 + ((depth - 1) >> min(31, rwb->scale_step));
+
+	rwb->wb_max = depth;
+	rwb->wb_normal = (depth + 1) / 2;
+	rwb->wb_background = (depth + 3) / 4;
+}
+
+static void rwb_arm_timer(struct rq_wb *rwb)
+{
+	if (!timer_pending(&rwb->window_timer))
+		mod_timer(&rwb->window_timer,
+			  jiffies + nsecs_to_jiffies(rwb->cur_win_nsec));
+}
+
+static void scale_up(struct rq_wb *rwb)
+{
+	if (!rwb->scale_step)
+		return;
+
+	rwb->scale_step--;
+	rwb->cur_win_nsec = rwb->win_nsec / int_sqrt(rwb->scale_step + 1);
+	calc_wb_limits(rwb);
+	wake_up_all(&rwb->wait);
+}
+
+static void scale_down(struct rq_wb *rwb)
+{
+	/* can't get any lower than a single write */
+	if (rwb->wb_max == 1)
+		return;
+
+	rwb->scale_step++;
+	rwb->cur_win_nsec = rwb->win_nsec / int_sqrt(rwb->scale_step + 1);
+	calc_wb_limits(rwb);
+}
+
+static void wbt_timer_fn(unsigned long data)
+{
+	struct rq_wb *rwb = (struct rq_wb *) data;
+	unsigned int samples;
+	unsigned long flags;
+	u64 min_lat;
+
+	spin_lock_irqsave(&rwb->lock, flags);
+	samples = rwb->win_samples;
+	min_lat = rwb->win_min_lat;
+	rwb->win_samples = 0;
+	rwb->win_min_lat = 0;
+	spin_unlock_irqrestore(&rwb->lock, flags);
+
+	if (!rwb->min_lat_nsec)
+		return;
+
+	if (samples && min_lat > rwb->min_lat_nsec)
+		scale_down(rwb);
+	else
+		scale_up(rwb);
+
+	/* keep watching as long as we are throttling anything */
+	if (atomic_read(&rwb->inflight) || rwb->scale_step)
+		rwb_arm_timer(rwb);
+}
+
+static void wbt_add_sample(struct rq_wb *rwb, struct request *rq)
+{
+	s64 lat = ktime_get_ns() - rq->issue_time_ns;
+	unsigned long flags;
+
+	if (lat <= 0)
+		return;
+
+	spin_lock_irqsave(&rwb->lock, flags);
+	if (!rwb->win_samples || lat < rwb->win_min_lat)
+		rwb->win_min_lat = lat;
+	rwb->win_samples++;
+	rwb->last_comp = jiffies;
+	spin_unlock_irqrestore(&rwb->lock, flags);
+}
+
+void __wbt_done(struct rq_wb *rwb)
+{
+	int inflight = atomic_dec_return(&rwb->inflight);
+
+	if (inflight < (int) rwb->wb_normal && waitqueue_active(&rwb->wait))
+		wake_up(&rwb->wait);
+}
+
+/*
+ * Called when a request is freed. Throttled writes give back their
+ * slot, the completion time of everything else feeds the latency
+ * monitoring.
+ */
+void wbt_done(struct rq_wb *rwb, struct request *rq)
+{
+	if (!rwb)
+		return;
+
+	if (rq->cmd_flags & REQ_WBT) {
+		rq->cmd_flags &= ~REQ_WBT;
+		__wbt_done(rwb);
+		return;
+	}
+
+	if (rq->issue_time_ns && rq->cmd_type == REQ_TYPE_FS)
+		wbt_add_sample(rwb, rq);
+}
+
+static unsigned int get_limit(struct rq_wb *rwb)
+{
+	/* reclaim has to make progress */
+	if (current_is_kswapd())
+		return rwb->wb_max;
+
+	if (time_before(jiffies, rwb->last_comp + RWB_RECENT_IO))
+		return rwb->wb_background;
+
+	return rwb->wb_normal;
+}
+
+static bool atomic_inc_below(atomic_t *v, int below)
+{
+	int cur = atomic_read(v);
+
+	for (;;) {
+		int old;
+
+		if (cur >= below)
+			return false;
+		old = atomic_cmpxchg(v, cur, cur + 1);
+		if (old == cur)
+			break;
+		cur = old;
+	}
+
+	return true;
+}
+
+/*
+ * Only buffered background writes are throttled. O_DIRECT and data
+ * integrity writeback are marked sync, reads are never held back.
+ */
+static bool wbt_should_throttle(struct bio *bio)
+{
+	if (bio_data_dir(bio) != WRITE)
+		return false;
+
+	return !(bio->bi_rw & (REQ_SYNC | REQ_FLUSH | REQ_FUA | REQ_DISCARD));
+}
+
+/*
+ * Block the submitter until there is room for another background write.
+ * If @lock is passed, it is held on entry and dropped while sleeping.
+ * Returns true if the bio is accounted, the request made from it must
+ * then be marked with wbt_track().
+ */
+bool wbt_wait(struct rq_wb *rwb, struct bio *bio, spinlock_t *lock)
+{
+	DEFINE_WAIT(wait);
+
+	if (!rwb || !rwb->min_lat_nsec || !wbt_should_throttle(bio))
+		return false;
+
+	if (atomic_inc_below(&rwb->inflight, get_limit(rwb)))
+		goto out;
+
+	for (;;) {
+		prepare_to_wait_exclusive(&rwb->wait, &wait,
+					  TASK_UNINTERRUPTIBLE);
+		if (atomic_inc_below(&rwb->inflight, get_limit(rwb)))
+			break;
+
+		if (lock)
+			spin_unlock_irq(lock);
+		io_schedule();
+		if (lock)
+			spin_lock_irq(lock);
+	}
+	finish_wait(&rwb->wait, &wait);
+out:
+	rwb_arm_timer(rwb);
+	return true;
+}
+
+void wbt_set_queue_depth(struct rq_wb *rwb, unsigned int depth)
+{
+	if (!rwb)
+		return;
+
+	rwb->queue_depth = depth;
+	calc_wb_limits(rwb);
+	wake_up_all(&rwb->wait);
+}
+
+void wbt_set_min_lat(struct rq_wb *rwb, u64 nsec)
+{
+	rwb->min_lat_nsec = nsec;
+	rwb->scale_step = 0;
+	rwb->cur_win_nsec = rwb->win_nsec;
+	calc_wb_limits(rwb);
+	wake_up_all(&rwb->wait);
+}
+
+int wbt_init(struct request_queue *q)
+{
+	struct rq_wb *rwb;
+
+	rwb = kzalloc_node(sizeof(*rwb), GFP_KERNEL, q->node);
+	if (!rwb)
+		return -ENOMEM;
+
+	atomic_set(&rwb->inflight, 0);
+	init_waitqueue_head(&rwb->wait);
+	spin_lock_init(&rwb->lock);
+	setup_timer(&rwb->window_timer, wbt_timer_fn, (unsigned long) rwb);
+	rwb->win_nsec = rwb->cur_win_nsec = RWB_WINDOW_NSEC;
+	rwb->queue_depth = q->nr_requests;
+	rwb->q = q;
+
+	if (blk_queue_nonrot(q))
+		rwb->min_lat_nsec = RWB_NONROT_LAT_NSEC;
+	else
+		rwb->min_lat_nsec = RWB_ROT_LAT_NSEC;
+	calc_wb_limits(rwb);
+
+	q->rq_wb = rwb;
+	return 0;
+}
+
+void wbt_exit(struct request_queue *q)
+{
+	struct rq_wb *rwb = q->rq_wb;
+
+	if (!rwb)
+		return;
+
+	q->rq_wb = NULL;
+	del_timer_sync(&rwb->window_timer);
+	kfree(rwb);
+}
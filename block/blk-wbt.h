@@ -0,0 +1,89 @@
+#ifndef BLK_WBT_H
+#define BLK_WBT_H
+
+#include <linux/kernel.h>
+#include <linux/atomic.h>
+#include <linux/wait.h>
+#include <linux/timer.h>
+#include <linux/spinlock.h>
+#include <linux/blkdev.h>
+
+/*
+ * Writeback throttling state, one per request queue.
+ */
+struct rq_wb {
+	/*
+	 * Settings that govern how many background writes may be in
+	 * flight, derived from queue_depth and scale_step.
+	 */
+	unsigned int wb_background;	/* other I/O is active */
+	unsigned int wb_normal;		/* writeback only */
+	unsigned int wb_max;		/* reclaim */
+	unsigned int queue_depth;
+	int scale_step;
+
+	u64 min_lat_nsec;		/* latency target, 0 = disabled */
+	u64 win_nsec;			/* base monitoring window */
+	u64 cur_win_nsec;		/* shrunk while scaled down */
+	struct timer_list window_timer;
+
+	/* completions of unthrottled I/O in the current window */
+	spinlock_t lock;
+	u64 win_min_lat;
+	unsigned int win_samples;
+	unsigned long last_comp;	/* jiffies */
+
+	atomic_t inflight;		/* throttled writes in flight */
+	wait_queue_head_t wait;
+	struct request_queue *q;
+};
+
+#ifdef CONFIG_BLK_WBT
+
+int wbt_init(struct request_queue *);
+void wbt_exit(struct request_queue *);
+bool wbt_wait(struct rq_wb *, struct bio *, spinlock_t *);
+void __wbt_done(struct rq_wb *);
+void wbt_done(struct rq_wb *, struct request *);
+void wbt_set_queue_depth(struct rq_wb *, unsigned int);
+void wbt_set_min_lat(struct rq_wb *, u64);
+
+static inline void wbt_track(struct request *rq, bool acct)
+{
+	if (acct)
+		rq->cmd_flags |= REQ_WBT;
+}
+
+#else
+
+static inline int wbt_init(struct request_queue *q)
+{
+	return 0;
+}
+static inline void wbt_exit(struct request_queue *q)
+{
+}
+static inline bool wbt_wait(struct rq_wb *rwb, struct bio *bio,
+			    spinlock_t *lock)
+{
+	return false;
+}
+static inline void __wbt_done(struct rq_wb *rwb)
+{
+}
+static inline void wbt_done(struct rq_wb *rwb, struct request *rq)
+{
+}
+static inline void wbt_set_queue_depth(struct rq_wb *rwb, unsigned int depth)
+{
+}
+static inline void wbt_set_min_lat(struct rq_wb *rwb, u64 nsec)
+{
+}
+static inline void wbt_track(struct request *rq, bool acct)
+{
+}
+
+#endif /* CONFIG_BLK_WBT */
+
+#endif
@@ -0,0 +1,284 @@
+/*
+ *  Deadline i/o scheduler for blk-mq.
+ *
+ *  Same policy as deadline-iosched.c: requests are sorted by sector and
+ *  dispatched in batches, with a per direction FIFO bounding how long a
+ *  request may wait. The state is kept per hardware queue, so queues
+ *  never contend with each other.
+ */
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/elevator.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/rbtree.h>
+
+#include "blk-mq-sched.h"
+
+/*
+ * See Documentation/block/deadline-iosched.txt, the knobs are the same
+ * but global, as module parameters.
+ */
+static unsigned int read_expire = 500;	/* msecs before a read is submitted */
+module_param(read_expire, uint, 0644);
+MODULE_PARM_DESC(read_expire, "Read deadline in msecs (default 500)");
+
+static unsigned int write_expire = 5000; /* ditto for writes, SOFT limits */
+module_param(write_expire, uint, 0644);
+MODULE_PARM_DESC(write_expire, "Write deadline in msecs (default 5000)");
+
+static unsigned int writes_starved = 2;	/* max times reads can starve a write */
+module_param(writes_starved, uint, 0644);
+MODULE_PARM_DESC(writes_starved,
+		 "Read batches before a write batch (default 2)");
+
+static unsigned int fifo_batch = 16;	/* # of sequential requests per batch */
+module_param(fifo_batch, uint, 0644);
+MODULE_PARM_DESC(fifo_batch, "Requests dispatched per batch (default 16)");
+
+struct mq_deadline_data {
+	spinlock_t lock;
+
+	/*
+	 * requests are present on both sort_list and fifo_list, except
+	 * for those inserted at the head, which bypass sorting.
+	 */
+	struct rb_root sort_list[2];
+	struct list_head fifo_list[2];
+	struct list_head dispatch;
+
+	/*
+	 * next in sort order. read, write or both are NULL
+	 */
+	struct request *next_rq[2];
+	unsigned int batching;		/* number of sequential requests made */
+	unsigned int starved;		/* times reads have starved writes */
+};
+
+static inline struct request *dd_latter_request(struct request *rq)
+{
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	if (node)
+		return rb_entry_rq(node);
+
+	return NULL;
+}
+
+static void dd_remove_request(struct mq_deadline_data *dd, struct request *rq)
+{
+	const int data_dir = rq_data_dir(rq);
+
+	if (dd->next_rq[data_dir] == rq)
+		dd->next_rq[data_dir] = dd_latter_request(rq);
+
+	list_del_init(&rq->queuelist);
+	elv_rb_del(&dd->sort_list[data_dir], rq);
+}
+
+static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
+			      bool at_head)
+{
+	struct mq_deadline_data *dd = hctx->sched_data;
+	const int data_dir = rq_data_dir(rq);
+	unsigned long expire;
+
+	spin_lock(&dd->lock);
+
+	/*
+	 * Requeues, flush sequences and passthrough commands are not
+	 * subject to sorting, they go out first.
+	 */
+	if (at_head || rq->cmd_type != REQ_TYPE_FS ||
+	    (rq->cmd_flags & REQ_FLUSH_SEQ)) {
+		if (at_head)
+			list_add(&rq->queuelist, &dd->dispatch);
+		else
+			list_add_tail(&rq->queuelist, &dd->dispatch);
+		goto out;
+	}
+
+	expire = data_dir == READ ? read_expire : write_expire;
+
+	elv_rb_add(&dd->sort_list[data_dir], rq);
+	rq->fifo_time = jiffies + msecs_to_jiffies(expire);
+	list_add_tail(&rq->queuelist, &dd->fifo_list[data_dir]);
+out:
+	spin_unlock(&dd->lock);
+}
+
+/*
+ * dd_check_fifo returns true if the oldest request of that direction has
+ * expired. Requires !list_empty(&dd->fifo_list[data_dir])
+ */
+static inline bool dd_check_fifo(struct mq_deadline_data *dd, int ddir)
+{
+	struct request *rq = rq_entry_fifo(dd->fifo_list[ddir].next);
+
+	return time_after_eq(jiffies, rq->fifo_time);
+}
+
+/*
+ * pick the best request according to read/write expire, fifo_batch, etc.
+ * Called with dd->lock held.
+ */
+static struct request *__dd_dispatch_request(struct mq_deadline_data *dd)
+{
+	const bool reads = !list_empty(&dd->fifo_list[READ]);
+	const bool writes = !list_empty(&dd->fifo_list[WRITE]);
+	struct request *rq;
+	int data_dir;
+
+	if (!list_empty(&dd->dispatch)) {
+		rq = list_first_entry(&dd->dispatch, struct request, queuelist);
+		list_del_init(&rq->queuelist);
+		return rq;
+	}
+
+	/*
+	 * batches are currently reads XOR writes
+	 */
+	if (dd->next_rq[WRITE])
+		rq = dd->next_rq[WRITE];
+	else
+		rq = dd->next_rq[READ];
+
+	if (rq && dd->batching < fifo_batch)
+		/* we have a next request and are still entitled to batch */
+		goto dispatch_request;
+
+	/*
+	 * at this point we are not running a batch. select the appropriate
+	 * data direction (read / write)
+	 */
+	if (reads) {
+		if (writes && (dd->starved++ >= writes_starved))
+			goto dispatch_writes;
+
+		data_dir = READ;
+		goto dispatch_find_request;
+	}
+
+	/*
+	 * there are either no reads or writes have been starved
+	 */
+	if (writes) {
+dispatch_writes:
+		dd->starved = 0;
+		data_dir = WRITE;
+		goto dispatch_find_request;
+	}
+
+	return NULL;
+
+dispatch_find_request:
+	/*
+	 * we are not running a batch, find best request for selected data_dir
+	 */
+	if (dd_check_fifo(dd, data_dir) || !dd->next_rq[data_dir]) {
+		/*
+		 * A deadline has expired, the last request was in the other
+		 * direction, or we have run out of higher-sectored requests.
+		 * Start again from the request with the earliest expiry time.
+		 */
+		rq = rq_entry_fifo(dd->fifo_list[data_dir].next);
+	} else {
+		/*
+		 * The last req was the same dir and we have a next request in
+		 * sort order. No expired requests so continue on from here.
+		 */
+		rq = dd->next_rq[data_dir];
+	}
+
+	dd->batching = 0;
+
+dispatch_request:
+	dd->batching++;
+
+	data_dir = rq_data_dir(rq);
+	dd->next_rq[READ] = NULL;
+	dd->next_rq[WRITE] = NULL;
+	dd->next_rq[data_dir] = dd_latter_request(rq);
+
+	dd_remove_request(dd, rq);
+	return rq;
+}
+
+static struct request *dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
+{
+	struct mq_deadline_data *dd = hctx->sched_data;
+	struct request *rq;
+
+	spin_lock(&dd->lock);
+	rq = __dd_dispatch_request(dd);
+	spin_unlock(&dd->lock);
+
+	return rq;
+}
+
+static bool dd_has_work(struct blk_mq_hw_ctx *hctx)
+{
+	struct mq_deadline_data *dd = hctx->sched_data;
+
+	return !list_empty_careful(&dd->dispatch) ||
+		!list_empty_careful(&dd->fifo_list[READ]) ||
+		!list_empty_careful(&dd->fifo_list[WRITE]);
+}
+
+static int dd_init_hctx(struct blk_mq_hw_ctx *hctx)
+{
+	struct mq_deadline_data *dd;
+
+	dd = kzalloc_node(sizeof(*dd), GFP_KERNEL, hctx->numa_node);
+	if (!dd)
+		return -ENOMEM;
+
+	spin_lock_init(&dd->lock);
+	INIT_LIST_HEAD(&dd->fifo_list[READ]);
+	INIT_LIST_HEAD(&dd->fifo_list[WRITE]);
+	INIT_LIST_HEAD(&dd->dispatch);
+	dd->sort_list[READ] = RB_ROOT;
+	dd->sort_list[WRITE] = RB_ROOT;
+
+	hctx->sched_data = dd;
+	return 0;
+}
+
+static void dd_exit_hctx(struct blk_mq_hw_ctx *hctx)
+{
+	struct mq_deadline_data *dd = hctx->sched_data;
+
+	BUG_ON(dd_has_work(hctx));
+
+	kfree(dd);
+}
+
+static struct blk_mq_sched_type mq_deadline = {
+	.ops = {
+		.init_hctx		= dd_init_hctx,
+		.exit_hctx		= dd_exit_hctx,
+		.insert_request		= dd_insert_request,
+		.dispatch_request	= dd_dispatch_request,
+		.has_work		= dd_has_work,
+	},
+	.name	= "mq-deadline",
+	.owner	= THIS_MODULE,
+};
+
+static int __init mq_deadline_init(void)
+{
+	return blk_mq_sched_register(&mq_deadline);
+}
+
+static void __exit mq_deadline_exit(void)
+{
+	blk_mq_sched_unregister(&mq_deadline);
+}
+
+module_init(mq_deadline_init);
+module_exit(mq_deadline_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("deadline IO scheduler for blk-mq");
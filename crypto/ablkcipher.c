@@ -359,6 +359,27 @@ int skcipher_null_givdecrypt(struct skcipher_givcrypt_request *req)
 	return crypto_ablkcipher_decrypt(&req->creq);
 }
 
+static int skcipher_issue_encrypt(struct crypto_async_request *req)
+{
+	return crypto_ablkcipher_encrypt(ablkcipher_request_cast(req));
+}
+
+static int skcipher_issue_decrypt(struct crypto_async_request *req)
+{
+	return crypto_ablkcipher_decrypt(ablkcipher_request_cast(req));
+}
+
+/* batch operations for ciphers that take one request at a time */
+int skcipher_encrypt_batch(struct crypto_batch *batch)
+{
+	return crypto_batch_submit(batch, skcipher_issue_encrypt);
+}
+
+int skcipher_decrypt_batch(struct crypto_batch *batch)
+{
+	return crypto_batch_submit(batch, skcipher_issue_decrypt);
+}
+
 static int crypto_init_ablkcipher_ops(struct crypto_tfm *tfm, u32 type,
 				      u32 mask)
 {
@@ -371,6 +392,8 @@ static int crypto_init_ablkcipher_ops(struct crypto_tfm *tfm, u32 type,
 	crt->setkey = setkey;
 	crt->encrypt = alg->encrypt;
 	crt->decrypt = alg->decrypt;
+	crt->encrypt_batch = alg->encrypt_batch ?: skcipher_encrypt_batch;
+	crt->decrypt_batch = alg->decrypt_batch ?: skcipher_decrypt_batch;
 	if (!alg->ivsize) {
 		crt->givencrypt = skcipher_null_givencrypt;
 		crt->givdecrypt = skcipher_null_givdecrypt;
@@ -454,6 +477,8 @@ static int crypto_init_givcipher_ops(struct crypto_tfm *tfm, u32 type,
 		      alg->setkey : setkey;
 	crt->encrypt = alg->encrypt;
 	crt->decrypt = alg->decrypt;
+	crt->encrypt_batch = alg->encrypt_batch ?: skcipher_encrypt_batch;
+	crt->decrypt_batch = alg->decrypt_batch ?: skcipher_decrypt_batch;
 	crt->givencrypt = alg->givencrypt ?: no_givdecrypt;
 	crt->givdecrypt = alg->givdecrypt ?: no_givdecrypt;
 	crt->base = __crypto_ablkcipher_cast(tfm);
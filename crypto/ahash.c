@@ -376,6 +376,17 @@ int crypto_ahash_digest(struct ahash_request *req)
 }
 EXPORT_SYMBOL_GPL(crypto_ahash_digest);
 
+static int ahash_issue_digest(struct crypto_async_request *req)
+{
+	return crypto_ahash_digest(ahash_request_cast(req));
+}
+
+int crypto_ahash_digest_batch(struct crypto_batch *batch)
+{
+	return crypto_batch_submit(batch, ahash_issue_digest);
+}
+EXPORT_SYMBOL_GPL(crypto_ahash_digest_batch);
+
 static void ahash_def_finup_finish2(struct ahash_request *req, int err)
 {
 	struct ahash_request_priv *priv = req->priv;
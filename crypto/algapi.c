@@ -934,6 +934,67 @@ int crypto_tfm_in_queue(struct crypto_queue *queue, struct crypto_tfm *tfm)
 }
 EXPORT_SYMBOL_GPL(crypto_tfm_in_queue);
 
+static void crypto_batch_done(struct crypto_async_request *req, int err)
+{
+	struct crypto_batch *batch = req->data;
+
+	/* a backlogged request made it into the queue */
+	if (err == -EINPROGRESS)
+		return;
+
+	if (err)
+		cmpxchg(&batch->err, 0, err);
+	if (atomic_dec_and_test(&batch->pending))
+		batch->complete(batch, batch->err);
+}
+
+/**
+ * crypto_batch_submit() - issue all requests of a batch
+ * @batch: the requests and the callback for the whole batch
+ * @issue: submits one request, such as the encrypt function of the cipher
+ *
+ * Points the callbacks of all requests in @batch at the batch and passes
+ * them to @issue. Drivers implementing a batch operation can use this with
+ * an @issue function that only queues the request, and start the hardware
+ * once when it returns.
+ *
+ * Return: -EINPROGRESS if @batch->complete will be called; otherwise all
+ *	   requests have completed, and the first error or 0 is returned.
+ */
+int crypto_batch_submit(struct crypto_batch *batch,
+			int (*issue)(struct crypto_async_request *req))
+{
+	unsigned int i;
+	int err;
+
+	batch->err = 0;
+	/* keep the batch from completing before all requests are issued */
+	atomic_set(&batch->pending, 1);
+
+	for (i = 0; i < batch->nreqs; i++) {
+		struct crypto_async_request *req = batch->reqs[i];
+
+		req->complete = crypto_batch_done;
+		req->data = batch;
+
+		atomic_inc(&batch->pending);
+		err = issue(req);
+		if (err == -EINPROGRESS ||
+		    (err == -EBUSY && (req->flags & CRYPTO_TFM_REQ_MAY_BACKLOG)))
+			continue;
+
+		if (err)
+			cmpxchg(&batch->err, 0, err);
+		atomic_dec(&batch->pending);
+	}
+
+	if (atomic_dec_and_test(&batch->pending))
+		return batch->err;
+
+	return -EINPROGRESS;
+}
+EXPORT_SYMBOL_GPL(crypto_batch_submit);
+
 static inline void crypto_inc_byte(u8 *a, unsigned int size)
 {
 	u8 *b = (a + size);
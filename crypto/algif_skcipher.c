@@ -103,6 +103,10 @@ static void skcipher_async_cb(struct crypto_async_request *req, int err)
 	struct skcipher_async_req *sreq = GET_SREQ(req, ctx);
 	struct kiocb *iocb = sreq->iocb;
 
+	/* a backlogged request is only being started */
+	if (err == -EINPROGRESS)
+		return;
+
 	atomic_dec(&ctx->inflight);
 	skcipher_free_async_sgls(sreq);
 	kfree(req);
@@ -612,7 +616,7 @@ static int skcipher_recvmsg_async(struct socket *sock, struct msghdr *msg,
 				     len, sreq->iv);
 	err = ctx->enc ? crypto_ablkcipher_encrypt(req) :
 			 crypto_ablkcipher_decrypt(req);
-	if (err == -EINPROGRESS) {
+	if (err == -EINPROGRESS || err == -EBUSY) {
 		atomic_inc(&ctx->inflight);
 		err = -EIOCBQUEUED;
 		goto unlock;
@@ -28,6 +28,7 @@
 #include <linux/notifier.h>
 #include <linux/kobject.h>
 #include <linux/cpu.h>
+#include <linux/sched.h>
 #include <crypto/pcrypt.h>
 
 struct padata_pcrypt {
@@ -387,6 +388,25 @@ static int pcrypt_cpumask_change_notify(struct notifier_block *self,
 	return 0;
 }
 
+/*
+ * Drop all but the fastest CPUs from @mask, so that on systems with CPUs of
+ * different capacity, such as big.LITTLE, the parallel work and the
+ * callbacks run on the big cores. Symmetric systems keep every CPU.
+ */
+static void pcrypt_fast_cpumask(struct cpumask *mask)
+{
+	unsigned long max_cap = 0;
+	int cpu;
+
+	for_each_cpu(cpu, mask)
+		max_cap = max(max_cap, sched_cpu_capacity(cpu));
+
+	for_each_cpu(cpu, mask) {
+		if (sched_cpu_capacity(cpu) < max_cap)
+			cpumask_clear_cpu(cpu, mask);
+	}
+}
+
 static int pcrypt_sysfs_add(struct padata_instance *pinst, const char *name)
 {
 	int ret;
@@ -404,6 +424,10 @@ static int pcrypt_init_padata(struct padata_pcrypt *pcrypt,
 {
 	int ret = -ENOMEM;
 	struct pcrypt_cpumask *mask;
+	cpumask_var_t fast_mask;
+
+	if (!alloc_cpumask_var(&fast_mask, GFP_KERNEL))
+		return -ENOMEM;
 
 	get_online_cpus();
 
@@ -416,6 +440,17 @@ static int pcrypt_init_padata(struct padata_pcrypt *pcrypt,
 	if (!pcrypt->pinst)
 		goto err_destroy_workqueue;
 
+	/* default to the fastest CPUs, the sysfs cpumasks still override */
+	cpumask_copy(fast_mask, cpu_possible_mask);
+	pcrypt_fast_cpumask(fast_mask);
+	if (!cpumask_equal(fast_mask, cpu_possible_mask) &&
+	    cpumask_intersects(fast_mask, cpu_online_mask)) {
+		ret = padata_set_cpumasks(pcrypt->pinst, fast_mask, fast_mask);
+		if (ret)
+			goto err_free_padata;
+		ret = -ENOMEM;
+	}
+
 	mask = kmalloc(sizeof(*mask), GFP_KERNEL);
 	if (!mask)
 		goto err_free_padata;
@@ -424,7 +459,9 @@ static int pcrypt_init_padata(struct padata_pcrypt *pcrypt,
 		goto err_free_padata;
 	}
 
-	cpumask_and(mask->mask, cpu_possible_mask, cpu_online_mask);
+	cpumask_and(mask->mask, fast_mask, cpu_online_mask);
+	if (cpumask_empty(mask->mask))
+		cpumask_copy(mask->mask, cpu_online_mask);
 	rcu_assign_pointer(pcrypt->cb_cpumask, mask);
 
 	pcrypt->nblock.notifier_call = pcrypt_cpumask_change_notify;
@@ -437,6 +474,7 @@ static int pcrypt_init_padata(struct padata_pcrypt *pcrypt,
 		goto err_unregister_notifier;
 
 	put_online_cpus();
+	free_cpumask_var(fast_mask);
 
 	return ret;
 
@@ -451,6 +489,7 @@ err_destroy_workqueue:
 	destroy_workqueue(pcrypt->wq);
 err:
 	put_online_cpus();
+	free_cpumask_var(fast_mask);
 
 	return ret;
 }
@@ -35,6 +35,10 @@
 #include <linux/jiffies.h>
 #include <linux/timex.h>
 #include <linux/interrupt.h>
+#include <linux/kthread.h>
+#include <linux/random.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
 #include "tcrypt.h"
 
 /*
@@ -62,6 +66,9 @@ static char *alg = NULL;
 static u32 type;
 static u32 mask;
 static int mode;
+static unsigned int mt_threads;
+static unsigned int mt_qdepth;
+static unsigned int mt_klen;
 static char *tvmem[TVMEMSIZE];
 
 static char *check[] = {
@@ -1225,6 +1232,485 @@ out:
 	crypto_free_ablkcipher(tfm);
 }
 
+/*
+ * Multi-threaded speed test: mt_threads kernel threads, each bound to an
+ * online CPU in turn, keep mt_qdepth requests in flight on one shared tfm
+ * and resubmit every request as soon as it completes, so that async
+ * drivers see a steady queue. Throughput is reported for all threads
+ * together, latency (submission to completion) as percentiles over a
+ * random sample of the requests. Each block size runs for sec seconds, or
+ * one second if sec is not set.
+ */
+#define TCRYPT_MT_SAMPLES	4096
+#define TCRYPT_MT_AAD		16
+#define TCRYPT_MT_PAD		(TCRYPT_MT_AAD + 64)
+
+struct tcrypt_mt_test;
+struct tcrypt_mt_thread;
+
+struct tcrypt_mt_req {
+	struct tcrypt_mt_thread *thread;
+	void *req;
+	char *buf;
+	struct scatterlist sg;
+	char iv[MAX_IVLEN];
+	u8 result[64];
+	struct completion done;
+	bool busy;
+	int err;
+	u64 start;
+	u64 lat;
+};
+
+struct tcrypt_mt_thread {
+	struct tcrypt_mt_test *test;
+	struct tcrypt_mt_req *reqs;
+	u32 *lat;
+	u64 ops;
+	u64 max_lat;
+	u64 ns;
+	int err;
+};
+
+struct tcrypt_mt_test {
+	u32 type;
+	int enc;
+	union {
+		struct crypto_ablkcipher *cipher;
+		struct crypto_ahash *hash;
+		struct crypto_aead *aead;
+	} tfm;
+	unsigned int blen;
+	unsigned long end;
+	atomic_t running;
+	struct completion done;
+	struct tcrypt_mt_thread *threads;
+};
+
+static void tcrypt_mt_complete(struct crypto_async_request *req, int err)
+{
+	struct tcrypt_mt_req *r = req->data;
+
+	if (err == -EINPROGRESS)
+		return;
+
+	r->lat = ktime_get_ns() - r->start;
+	r->err = err;
+	complete(&r->done);
+}
+
+static int tcrypt_mt_do_op(struct tcrypt_mt_req *r)
+{
+	struct tcrypt_mt_test *test = r->thread->test;
+
+	switch (test->type) {
+	case CRYPTO_ALG_TYPE_ABLKCIPHER:
+		return test->enc ? crypto_ablkcipher_encrypt(r->req) :
+				   crypto_ablkcipher_decrypt(r->req);
+	case CRYPTO_ALG_TYPE_AHASH:
+		return crypto_ahash_digest(r->req);
+	default:
+		return test->enc ? crypto_aead_encrypt(r->req) :
+				   crypto_aead_decrypt(r->req);
+	}
+}
+
+static void tcrypt_mt_submit(struct tcrypt_mt_req *r)
+{
+	int ret;
+
+	reinit_completion(&r->done);
+	r->busy = true;
+	r->start = ktime_get_ns();
+
+	ret = tcrypt_mt_do_op(r);
+	if (ret == -EINPROGRESS || ret == -EBUSY)
+		return;
+
+	r->lat = ktime_get_ns() - r->start;
+	r->err = ret;
+	complete(&r->done);
+}
+
+static int tcrypt_mt_wait(struct tcrypt_mt_req *r)
+{
+	struct tcrypt_mt_thread *t = r->thread;
+	struct tcrypt_mt_test *test = t->test;
+	int err;
+
+	wait_for_completion(&r->done);
+	r->busy = false;
+
+	err = r->err;
+	/* the buffer carries no valid tag, but all the work has been done */
+	if (err == -EBADMSG && test->type == CRYPTO_ALG_TYPE_AEAD)
+		err = 0;
+	if (err)
+		return err;
+
+	/* reservoir sampling keeps the sample uniform over the whole run */
+	if (t->ops < TCRYPT_MT_SAMPLES) {
+		t->lat[t->ops] = min_t(u64, r->lat, U32_MAX);
+	} else {
+		u32 i = prandom_u32_max(min_t(u64, t->ops + 1, U32_MAX));
+
+		if (i < TCRYPT_MT_SAMPLES)
+			t->lat[i] = min_t(u64, r->lat, U32_MAX);
+	}
+	t->max_lat = max(t->max_lat, r->lat);
+	t->ops++;
+
+	return 0;
+}
+
+static int tcrypt_mt_thread_fn(void *data)
+{
+	struct tcrypt_mt_thread *t = data;
+	struct tcrypt_mt_test *test = t->test;
+	u64 start = ktime_get_ns();
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < mt_qdepth; i++)
+		tcrypt_mt_submit(&t->reqs[i]);
+
+	for (i = 0; time_before(jiffies, test->end); i = (i + 1) % mt_qdepth) {
+		ret = tcrypt_mt_wait(&t->reqs[i]);
+		if (ret)
+			break;
+		tcrypt_mt_submit(&t->reqs[i]);
+	}
+
+	for (i = 0; i < mt_qdepth; i++) {
+		if (t->reqs[i].busy) {
+			int err = tcrypt_mt_wait(&t->reqs[i]);
+
+			ret = ret ?: err;
+		}
+	}
+
+	t->ns = ktime_get_ns() - start;
+	t->err = ret;
+
+	if (atomic_dec_and_test(&test->running))
+		complete(&test->done);
+
+	return 0;
+}
+
+static int tcrypt_mt_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* packs the per-thread samples at the start of lat, which threads[0] owns */
+static void tcrypt_mt_report(struct tcrypt_mt_test *test)
+{
+	u64 ops = 0, ns = 0, max_lat = 0, rate;
+	u32 *lat = test->threads[0].lat;
+	unsigned int i, n = 0;
+
+	for (i = 0; i < mt_threads; i++) {
+		struct tcrypt_mt_thread *t = &test->threads[i];
+		unsigned int nlat = min_t(u64, t->ops, TCRYPT_MT_SAMPLES);
+
+		memmove(lat + n, t->lat, nlat * sizeof(*lat));
+		n += nlat;
+		ops += t->ops;
+		ns = max(ns, t->ns);
+		max_lat = max(max_lat, t->max_lat);
+	}
+
+	if (!n || !ns) {
+		pr_cont("no operations completed\n");
+		return;
+	}
+
+	sort(lat, n, sizeof(*lat), tcrypt_mt_cmp, NULL);
+	rate = div64_u64(ops * NSEC_PER_SEC, ns);
+
+	pr_cont("%llu opers/sec, %llu bytes/sec, latency ns: p50 %u p90 %u p99 %u max %llu\n",
+		rate, rate * test->blen, lat[n / 2], lat[n * 9 / 10],
+		lat[n * 99 / 100], max_lat);
+}
+
+static int tcrypt_mt_run(struct tcrypt_mt_test *test, unsigned int secs)
+{
+	struct task_struct **tasks;
+	unsigned int i;
+	int cpu = -1;
+	int ret = 0;
+
+	tasks = kcalloc(mt_threads, sizeof(*tasks), GFP_KERNEL);
+	if (!tasks)
+		return -ENOMEM;
+
+	for (i = 0; i < mt_threads; i++) {
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+
+		test->threads[i].ops = 0;
+		test->threads[i].max_lat = 0;
+		tasks[i] = kthread_create(tcrypt_mt_thread_fn,
+					  &test->threads[i], "tcrypt/%u", i);
+		if (IS_ERR(tasks[i])) {
+			ret = PTR_ERR(tasks[i]);
+			break;
+		}
+		kthread_bind(tasks[i], cpu);
+	}
+
+	if (ret) {
+		while (i--)
+			kthread_stop(tasks[i]);
+		goto out;
+	}
+
+	atomic_set(&test->running, mt_threads);
+	reinit_completion(&test->done);
+	test->end = jiffies + secs * HZ;
+	for (i = 0; i < mt_threads; i++)
+		wake_up_process(tasks[i]);
+
+	wait_for_completion(&test->done);
+
+	for (i = 0; i < mt_threads; i++)
+		ret = ret ?: test->threads[i].err;
+
+out:
+	kfree(tasks);
+	return ret;
+}
+
+static void *tcrypt_mt_alloc_req(struct tcrypt_mt_test *test,
+				 struct tcrypt_mt_req *r)
+{
+	switch (test->type) {
+	case CRYPTO_ALG_TYPE_ABLKCIPHER:
+		r->req = ablkcipher_request_alloc(test->tfm.cipher, GFP_KERNEL);
+		if (r->req)
+			ablkcipher_request_set_callback(r->req,
+					CRYPTO_TFM_REQ_MAY_BACKLOG,
+					tcrypt_mt_complete, r);
+		break;
+	case CRYPTO_ALG_TYPE_AHASH:
+		r->req = ahash_request_alloc(test->tfm.hash, GFP_KERNEL);
+		if (r->req)
+			ahash_request_set_callback(r->req,
+					CRYPTO_TFM_REQ_MAY_BACKLOG,
+					tcrypt_mt_complete, r);
+		break;
+	default:
+		r->req = aead_request_alloc(test->tfm.aead, GFP_KERNEL);
+		if (r->req)
+			aead_request_set_callback(r->req,
+					CRYPTO_TFM_REQ_MAY_BACKLOG,
+					tcrypt_mt_complete, r);
+		break;
+	}
+
+	return r->req;
+}
+
+static void tcrypt_mt_free_req(struct tcrypt_mt_test *test,
+			       struct tcrypt_mt_req *r)
+{
+	switch (test->type) {
+	case CRYPTO_ALG_TYPE_ABLKCIPHER:
+		ablkcipher_request_free(r->req);
+		break;
+	case CRYPTO_ALG_TYPE_AHASH:
+		ahash_request_free(r->req);
+		break;
+	default:
+		aead_request_free(r->req);
+		break;
+	}
+}
+
+static void tcrypt_mt_set_req(struct tcrypt_mt_test *test,
+			      struct tcrypt_mt_req *r)
+{
+	unsigned int authsize, len;
+
+	memset(r->iv, 0xff, MAX_IVLEN);
+
+	switch (test->type) {
+	case CRYPTO_ALG_TYPE_ABLKCIPHER:
+		sg_init_one(&r->sg, r->buf, test->blen);
+		ablkcipher_request_set_crypt(r->req, &r->sg, &r->sg,
+					     test->blen, r->iv);
+		break;
+	case CRYPTO_ALG_TYPE_AHASH:
+		sg_init_one(&r->sg, r->buf, test->blen);
+		ahash_request_set_crypt(r->req, &r->sg, r->result,
+					test->blen);
+		break;
+	default:
+		authsize = crypto_aead_authsize(test->tfm.aead);
+		len = test->blen + (test->enc ? 0 : authsize);
+		sg_init_one(&r->sg, r->buf, TCRYPT_MT_AAD + len +
+			    (test->enc ? authsize : 0));
+		aead_request_set_crypt(r->req, &r->sg, &r->sg, len, r->iv);
+		aead_request_set_ad(r->req, TCRYPT_MT_AAD);
+		break;
+	}
+}
+
+static void test_mt_speed(const char *algo, u32 type, int enc,
+			  unsigned int secs, u32 *b_size)
+{
+	struct tcrypt_mt_test test = { .type = type, .enc = enc };
+	unsigned int i, j, k, bufsize = 0, key_len;
+	const char *driver, *e;
+	char key[64];
+	u32 *lat;
+	int ret;
+
+	if (!secs)
+		secs = 1;
+	if (!mt_threads)
+		mt_threads = num_online_cpus();
+	if (!mt_qdepth)
+		mt_qdepth = 1;
+
+	for (i = 0; b_size[i]; i++)
+		bufsize = max(bufsize, b_size[i] + TCRYPT_MT_PAD);
+
+	switch (type) {
+	case CRYPTO_ALG_TYPE_ABLKCIPHER:
+		test.tfm.cipher = crypto_alloc_ablkcipher(algo, 0, 0);
+		ret = PTR_ERR_OR_ZERO(test.tfm.cipher);
+		break;
+	case CRYPTO_ALG_TYPE_AHASH:
+		test.tfm.hash = crypto_alloc_ahash(algo, 0, 0);
+		ret = PTR_ERR_OR_ZERO(test.tfm.hash);
+		break;
+	default:
+		test.tfm.aead = crypto_alloc_aead(algo, 0, 0);
+		ret = PTR_ERR_OR_ZERO(test.tfm.aead);
+		break;
+	}
+	if (ret) {
+		pr_err("failed to load transform for %s: %d\n", algo, ret);
+		return;
+	}
+
+	memset(key, 0xff, sizeof(key));
+	key_len = min_t(unsigned int, mt_klen ?: 16, sizeof(key));
+	switch (type) {
+	case CRYPTO_ALG_TYPE_ABLKCIPHER:
+		driver = get_driver_name(crypto_ablkcipher, test.tfm.cipher);
+		ret = crypto_ablkcipher_setkey(test.tfm.cipher, key, key_len);
+		break;
+	case CRYPTO_ALG_TYPE_AHASH:
+		driver = get_driver_name(crypto_ahash, test.tfm.hash);
+		if (crypto_ahash_digestsize(test.tfm.hash) > 64)
+			ret = -EINVAL;
+		else if (mt_klen)
+			ret = crypto_ahash_setkey(test.tfm.hash, key, key_len);
+		break;
+	default:
+		driver = get_driver_name(crypto_aead, test.tfm.aead);
+		ret = crypto_aead_setkey(test.tfm.aead, key, key_len);
+		break;
+	}
+
+	if (type == CRYPTO_ALG_TYPE_AHASH)
+		e = "digest";
+	else if (enc == ENCRYPT)
+		e = "encryption";
+	else
+		e = "decryption";
+
+	pr_info("\ntesting speed of multi-threaded %s (%s) %s\n", algo,
+		driver, e);
+
+	if (ret) {
+		pr_err("setkey() failed: %d\n", ret);
+		goto out_free_tfm;
+	}
+
+	ret = -ENOMEM;
+	init_completion(&test.done);
+	lat = vmalloc(mt_threads * TCRYPT_MT_SAMPLES * sizeof(*lat));
+	if (!lat)
+		goto out_free_tfm;
+
+	test.threads = kcalloc(mt_threads, sizeof(*test.threads), GFP_KERNEL);
+	if (!test.threads)
+		goto out_free_lat;
+
+	for (i = 0; i < mt_threads; i++) {
+		struct tcrypt_mt_thread *t = &test.threads[i];
+
+		t->test = &test;
+		t->lat = lat + i * TCRYPT_MT_SAMPLES;
+		t->reqs = kcalloc(mt_qdepth, sizeof(*t->reqs), GFP_KERNEL);
+		if (!t->reqs)
+			goto out_free_threads;
+
+		for (j = 0; j < mt_qdepth; j++) {
+			struct tcrypt_mt_req *r = &t->reqs[j];
+
+			r->thread = t;
+			init_completion(&r->done);
+			r->buf = kmalloc(bufsize, GFP_KERNEL);
+			if (!r->buf || !tcrypt_mt_alloc_req(&test, r))
+				goto out_free_threads;
+			memset(r->buf, 0xff, bufsize);
+		}
+	}
+
+	for (i = 0; b_size[i]; i++) {
+		test.blen = b_size[i];
+		for (j = 0; j < mt_threads; j++)
+			for (k = 0; k < mt_qdepth; k++)
+				tcrypt_mt_set_req(&test,
+						  &test.threads[j].reqs[k]);
+
+		pr_info("test %u (%u byte blocks, %u threads, queue depth %u): ",
+			i, b_size[i], mt_threads, mt_qdepth);
+
+		ret = tcrypt_mt_run(&test, secs);
+		if (ret) {
+			pr_err("%s() failed: %d\n", e, ret);
+			break;
+		}
+		tcrypt_mt_report(&test);
+	}
+
+out_free_threads:
+	for (i = 0; i < mt_threads; i++) {
+		struct tcrypt_mt_thread *t = &test.threads[i];
+
+		for (j = 0; t->reqs && j < mt_qdepth; j++) {
+			if (t->reqs[j].req)
+				tcrypt_mt_free_req(&test, &t->reqs[j]);
+			kfree(t->reqs[j].buf);
+		}
+		kfree(t->reqs);
+	}
+	kfree(test.threads);
+out_free_lat:
+	vfree(lat);
+out_free_tfm:
+	switch (type) {
+	case CRYPTO_ALG_TYPE_ABLKCIPHER:
+		crypto_free_ablkcipher(test.tfm.cipher);
+		break;
+	case CRYPTO_ALG_TYPE_AHASH:
+		crypto_free_ahash(test.tfm.hash);
+		break;
+	default:
+		crypto_free_aead(test.tfm.aead);
+		break;
+	}
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -2181,6 +2667,25 @@ static int do_test(const char *alg, u32 type, u32 mask, int m)
 				   speed_template_8_32);
 		break;
 
+	case 600:
+		test_mt_speed(alg ?: "cbc(aes)", CRYPTO_ALG_TYPE_ABLKCIPHER,
+			      ENCRYPT, sec, block_sizes);
+		test_mt_speed(alg ?: "cbc(aes)", CRYPTO_ALG_TYPE_ABLKCIPHER,
+			      DECRYPT, sec, block_sizes);
+		break;
+
+	case 601:
+		test_mt_speed(alg ?: "sha256", CRYPTO_ALG_TYPE_AHASH,
+			      ENCRYPT, sec, block_sizes);
+		break;
+
+	case 602:
+		test_mt_speed(alg ?: "gcm(aes)", CRYPTO_ALG_TYPE_AEAD,
+			      ENCRYPT, sec, aead_sizes);
+		test_mt_speed(alg ?: "gcm(aes)", CRYPTO_ALG_TYPE_AEAD,
+			      DECRYPT, sec, aead_sizes);
+		break;
+
 	case 1000:
 		test_available();
 		break;
@@ -2240,6 +2745,15 @@ module_param(mode, int, 0);
 module_param(sec, uint, 0);
 MODULE_PARM_DESC(sec, "Length in seconds of speed tests "
 		      "(defaults to zero which uses CPU cycles instead)");
+module_param(mt_threads, uint, 0);
+MODULE_PARM_DESC(mt_threads, "Number of threads of the multi-threaded speed "
+			     "tests (defaults to the number of online CPUs)");
+module_param(mt_qdepth, uint, 0);
+MODULE_PARM_DESC(mt_qdepth, "Requests kept in flight by each thread of the "
+			    "multi-threaded speed tests (defaults to 1)");
+module_param(mt_klen, uint, 0);
+MODULE_PARM_DESC(mt_klen, "Key length in bytes for the multi-threaded speed "
+			  "tests (defaults to 16, unkeyed for hashes)");
 
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Quick & dirty crypto testing module");
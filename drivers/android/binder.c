@@ -60,6 +60,7 @@ static struct binder_node *binder_context_mgr_node;
 static kuid_t binder_context_mgr_uid = INVALID_UID;
 static int binder_last_id;
 static struct workqueue_struct *binder_deferred_workqueue;
+static DECLARE_WAIT_QUEUE_HEAD(binder_proc_unpin_wait);
 
 #define BINDER_DEBUG_ENTRY(name) \
 static int binder_##name##_open(struct inode *inode, struct file *file) \
@@ -159,7 +160,7 @@ enum binder_stat_types {
 
 struct binder_stats {
 	int br[_IOC_NR(BR_FAILED_REPLY) + 1];
-	int bc[_IOC_NR(BC_DEAD_BINDER_DONE) + 1];
+	int bc[_IOC_NR(BC_REPLY_SG) + 1];
 	int obj_created[BINDER_STAT_COUNT];
 	int obj_deleted[BINDER_STAT_COUNT];
 };
@@ -283,6 +284,7 @@ struct binder_buffer {
 	struct binder_node *target_node;
 	size_t data_size;
 	size_t offsets_size;
+	size_t extra_buffers_size;
 	uint8_t data[0];
 };
 
@@ -326,6 +328,8 @@ struct binder_proc {
 	int ready_threads;
 	long default_priority;
 	struct dentry *debugfs_entry;
+	/* transactions copying into our buffers without binder_main_lock */
+	int tmp_ref;
 };
 
 enum {
@@ -649,7 +653,9 @@ err_no_vma:
 
 static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 					      size_t data_size,
-					      size_t offsets_size, int is_async)
+					      size_t offsets_size,
+					      size_t extra_buffers_size,
+					      int is_async)
 {
 	struct rb_node *n = proc->free_buffers.rb_node;
 	struct binder_buffer *buffer;
@@ -673,6 +679,12 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 				proc->pid, data_size, offsets_size);
 		return NULL;
 	}
+	size += ALIGN(extra_buffers_size, sizeof(void *));
+	if (size < extra_buffers_size) {
+		binder_user_error("%d: got transaction with invalid extra_buffers_size %zd\n",
+				  proc->pid, extra_buffers_size);
+		return NULL;
+	}
 
 	if (is_async &&
 	    proc->free_async_space < size + sizeof(struct binder_buffer)) {
@@ -742,6 +754,7 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		      proc->pid, size, buffer);
 	buffer->data_size = data_size;
 	buffer->offsets_size = offsets_size;
+	buffer->extra_buffers_size = extra_buffers_size;
 	buffer->async_transaction = is_async;
 	if (is_async) {
 		proc->free_async_space -= size + sizeof(struct binder_buffer);
@@ -816,7 +829,8 @@ static void binder_free_buf(struct binder_proc *proc,
 	buffer_size = binder_buffer_size(proc, buffer);
 
 	size = ALIGN(buffer->data_size, sizeof(void *)) +
-		ALIGN(buffer->offsets_size, sizeof(void *));
+		ALIGN(buffer->offsets_size, sizeof(void *)) +
+		ALIGN(buffer->extra_buffers_size, sizeof(void *));
 
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "%d: binder_free_buf %p size %zd buffer_size %zd\n",
@@ -1237,6 +1251,32 @@ static void binder_send_failed_reply(struct binder_transaction *t,
 	}
 }
 
+/*
+ * Returns the size of the object at @offset in the data of @buffer, or 0 if
+ * it does not fit. Unknown types are sized as a flat_binder_object, so that
+ * callers can still report them as such.
+ */
+static size_t binder_validate_object(struct binder_buffer *buffer, u64 offset)
+{
+	struct flat_binder_object *fp;
+	size_t object_size = sizeof(*fp);
+
+	/* all objects start with their type */
+	if (buffer->data_size < sizeof(u32) ||
+	    offset > buffer->data_size - sizeof(u32) ||
+	    !IS_ALIGNED(offset, sizeof(u32)))
+		return 0;
+
+	fp = (struct flat_binder_object *)(buffer->data + offset);
+	if (fp->type == BINDER_TYPE_PTR)
+		object_size = sizeof(struct binder_buffer_object);
+
+	if (buffer->data_size < object_size ||
+	    offset > buffer->data_size - object_size)
+		return 0;
+	return object_size;
+}
+
 static void binder_transaction_buffer_release(struct binder_proc *proc,
 					      struct binder_buffer *buffer,
 					      binder_size_t *failed_at)
@@ -1261,9 +1301,7 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 	for (; offp < off_end; offp++) {
 		struct flat_binder_object *fp;
 
-		if (*offp > buffer->data_size - sizeof(*fp) ||
-		    buffer->data_size < sizeof(*fp) ||
-		    !IS_ALIGNED(*offp, sizeof(u32))) {
+		if (!binder_validate_object(buffer, *offp)) {
 			pr_err("transaction release %d bad offset %lld, size %zd\n",
 			       debug_id, (u64)*offp, buffer->data_size);
 			continue;
@@ -1306,6 +1344,10 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 				task_close_fd(proc, fp->handle);
 			break;
 
+		case BINDER_TYPE_PTR:
+			/* the data lives in the buffer itself */
+			break;
+
 		default:
 			pr_err("transaction release %d bad object type %x\n",
 				debug_id, fp->type);
@@ -1314,9 +1356,149 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 	}
 }
 
+/*
+ * A pinned proc is not torn down by binder_deferred_release(), so a sender
+ * may drop binder_main_lock while it fills a buffer of that proc. Both are
+ * called with binder_main_lock held.
+ */
+static void binder_proc_pin(struct binder_proc *proc)
+{
+	proc->tmp_ref++;
+}
+
+static void binder_proc_unpin(struct binder_proc *proc)
+{
+	if (!--proc->tmp_ref)
+		wake_up_all(&binder_proc_unpin_wait);
+}
+
+static int binder_fixup_parent(struct binder_proc *target_proc,
+			       struct binder_buffer *buffer,
+			       binder_size_t *off_start,
+			       binder_size_t *offp,
+			       struct binder_buffer_object *bp,
+			       u8 *sg_start, u8 *sg_bufp)
+{
+	struct binder_buffer_object *parent;
+	u8 *parent_buf;
+
+	/* parents come first, so they have been copied and validated */
+	if (bp->parent >= (binder_size_t)(offp - off_start))
+		return -EINVAL;
+	parent = (struct binder_buffer_object *)
+		(buffer->data + off_start[bp->parent]);
+	if (parent->type != BINDER_TYPE_PTR)
+		return -EINVAL;
+
+	parent_buf = (u8 *)(uintptr_t)
+		(parent->buffer - target_proc->user_buffer_offset);
+	if (parent_buf < sg_start || parent_buf > sg_bufp ||
+	    bp->parent_offset > parent->length ||
+	    parent->length - bp->parent_offset < sizeof(binder_uintptr_t) ||
+	    bp->parent_offset + sizeof(binder_uintptr_t) >
+				(size_t)(sg_bufp - parent_buf) ||
+	    !IS_ALIGNED(bp->parent_offset, sizeof(u32)))
+		return -EINVAL;
+
+	*(binder_uintptr_t *)(parent_buf + bp->parent_offset) = bp->buffer;
+	return 0;
+}
+
+/*
+ * Copies the data and offsets of @tr, and the buffers of the
+ * BINDER_TYPE_PTR objects in it, into the not yet visible buffer of @t.
+ * This is the bulk of the work of a transaction and only touches memory
+ * of the sender and of that buffer, so it runs without binder_main_lock,
+ * with the target proc pinned.
+ */
+static int binder_transaction_copy(struct binder_proc *proc,
+				   struct binder_thread *thread,
+				   struct binder_proc *target_proc,
+				   struct binder_transaction *t,
+				   struct binder_transaction_data *tr,
+				   binder_size_t extra_buffers_size)
+{
+	struct binder_buffer *buffer = t->buffer;
+	binder_size_t *offp, *off_start, *off_end;
+	u8 *sg_start, *sg_bufp, *sg_buf_end;
+
+	off_start = (binder_size_t *)(buffer->data +
+				      ALIGN(tr->data_size, sizeof(void *)));
+
+	if (copy_from_user(buffer->data, (const void __user *)(uintptr_t)
+			   tr->data.ptr.buffer, tr->data_size)) {
+		binder_user_error("%d:%d got transaction with invalid data ptr\n",
+				proc->pid, thread->pid);
+		return -EFAULT;
+	}
+	if (copy_from_user(off_start, (const void __user *)(uintptr_t)
+			   tr->data.ptr.offsets, tr->offsets_size)) {
+		binder_user_error("%d:%d got transaction with invalid offsets ptr\n",
+				proc->pid, thread->pid);
+		return -EFAULT;
+	}
+	if (!IS_ALIGNED(tr->offsets_size, sizeof(binder_size_t))) {
+		binder_user_error("%d:%d got transaction with invalid offsets size, %lld\n",
+				proc->pid, thread->pid, (u64)tr->offsets_size);
+		return -EINVAL;
+	}
+	if (!IS_ALIGNED(extra_buffers_size, sizeof(u64))) {
+		binder_user_error("%d:%d got transaction with unaligned buffers size, %lld\n",
+				  proc->pid, thread->pid,
+				  (u64)extra_buffers_size);
+		return -EINVAL;
+	}
+
+	off_end = (void *)off_start + tr->offsets_size;
+	sg_start = (u8 *)off_start + ALIGN(tr->offsets_size, sizeof(void *));
+	sg_bufp = sg_start;
+	sg_buf_end = sg_bufp + extra_buffers_size;
+
+	for (offp = off_start; offp < off_end; offp++) {
+		struct binder_buffer_object *bp;
+
+		if (!binder_validate_object(buffer, *offp)) {
+			binder_user_error("%d:%d got transaction with invalid offset, %lld\n",
+					  proc->pid, thread->pid, (u64)*offp);
+			return -EINVAL;
+		}
+		bp = (struct binder_buffer_object *)(buffer->data + *offp);
+		if (bp->type != BINDER_TYPE_PTR)
+			continue;
+
+		/* what is left is a multiple of 8, and so is ALIGN(length) */
+		if (bp->length > sg_buf_end - sg_bufp) {
+			binder_user_error("%d:%d got transaction with too large buffer\n",
+					  proc->pid, thread->pid);
+			return -EINVAL;
+		}
+		if (copy_from_user(sg_bufp, (const void __user *)(uintptr_t)
+				   bp->buffer, bp->length)) {
+			binder_user_error("%d:%d got transaction with invalid buffer ptr\n",
+					  proc->pid, thread->pid);
+			return -EFAULT;
+		}
+		bp->buffer = (uintptr_t)sg_bufp +
+			     target_proc->user_buffer_offset;
+
+		if ((bp->flags & BINDER_BUFFER_FLAG_HAS_PARENT) &&
+		    binder_fixup_parent(target_proc, buffer, off_start, offp,
+					bp, sg_start, sg_bufp)) {
+			binder_user_error("%d:%d got transaction with invalid parent %lld offset %lld\n",
+					  proc->pid, thread->pid,
+					  (u64)bp->parent,
+					  (u64)bp->parent_offset);
+			return -EINVAL;
+		}
+		sg_bufp += ALIGN(bp->length, sizeof(u64));
+	}
+	return 0;
+}
+
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
-			       struct binder_transaction_data *tr, int reply)
+			       struct binder_transaction_data *tr, int reply,
+			       binder_size_t extra_buffers_size)
 {
 	struct binder_transaction *t;
 	struct binder_work *tcomplete;
@@ -1329,6 +1511,7 @@ static void binder_transaction(struct binder_proc *proc,
 	struct binder_transaction *in_reply_to = NULL;
 	struct binder_transaction_log_entry *e;
 	uint32_t return_error;
+	int ret;
 
 	e = binder_transaction_log_add(&binder_transaction_log);
 	e->call_type = reply ? 2 : !!(tr->flags & TF_ONE_WAY);
@@ -1426,14 +1609,6 @@ static void binder_transaction(struct binder_proc *proc,
 			}
 		}
 	}
-	if (target_thread) {
-		e->to_thread = target_thread->pid;
-		target_list = &target_thread->todo;
-		target_wait = &target_thread->wait;
-	} else {
-		target_list = &target_proc->todo;
-		target_wait = &target_proc->wait;
-	}
 	e->to_proc = target_proc->pid;
 
 	/* TODO: reuse incoming transaction for reply */
@@ -1477,15 +1652,24 @@ static void binder_transaction(struct binder_proc *proc,
 		t->from = NULL;
 	t->sender_euid = task_euid(proc->tsk);
 	t->to_proc = target_proc;
-	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
 	t->priority = task_nice(current);
 
 	trace_binder_transaction(reply, t, target_node);
 
+	/* binder_alloc_buf() sizes the buffer in size_t */
+	if (extra_buffers_size > SIZE_MAX) {
+		binder_user_error("%d:%d got transaction with invalid extra_buffers_size %lld\n",
+				  proc->pid, thread->pid,
+				  (u64)extra_buffers_size);
+		return_error = BR_FAILED_REPLY;
+		goto err_binder_alloc_buf_failed;
+	}
+
 	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
-		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
+		tr->offsets_size, extra_buffers_size,
+		!reply && (t->flags & TF_ONE_WAY));
 	if (t->buffer == NULL) {
 		return_error = BR_FAILED_REPLY;
 		goto err_binder_alloc_buf_failed;
@@ -1501,33 +1685,51 @@ static void binder_transaction(struct binder_proc *proc,
 	offp = (binder_size_t *)(t->buffer->data +
 				 ALIGN(tr->data_size, sizeof(void *)));
 
-	if (copy_from_user(t->buffer->data, (const void __user *)(uintptr_t)
-			   tr->data.ptr.buffer, tr->data_size)) {
-		binder_user_error("%d:%d got transaction with invalid data ptr\n",
-				proc->pid, thread->pid);
+	/*
+	 * Nothing but this thread knows about the buffer yet, so copy into
+	 * it without holding up every other binder user in the system.
+	 */
+	binder_proc_pin(target_proc);
+	binder_unlock(__func__);
+	ret = binder_transaction_copy(proc, thread, target_proc, t, tr,
+				      extra_buffers_size);
+	binder_lock(__func__);
+	binder_proc_unpin(target_proc);
+	if (ret) {
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
-	if (copy_from_user(offp, (const void __user *)(uintptr_t)
-			   tr->data.ptr.offsets, tr->offsets_size)) {
-		binder_user_error("%d:%d got transaction with invalid offsets ptr\n",
-				proc->pid, thread->pid);
-		return_error = BR_FAILED_REPLY;
-		goto err_copy_data_failed;
+
+	/* the threads we picked may have exited in the meantime */
+	if (reply) {
+		if (in_reply_to->from != target_thread) {
+			return_error = BR_DEAD_REPLY;
+			goto err_copy_data_failed;
+		}
+	} else if (target_thread) {
+		struct binder_transaction *tmp;
+
+		target_thread = NULL;
+		for (tmp = thread->transaction_stack; tmp;
+		     tmp = tmp->from_parent)
+			if (tmp->from && tmp->from->proc == target_proc)
+				target_thread = tmp->from;
 	}
-	if (!IS_ALIGNED(tr->offsets_size, sizeof(binder_size_t))) {
-		binder_user_error("%d:%d got transaction with invalid offsets size, %lld\n",
-				proc->pid, thread->pid, (u64)tr->offsets_size);
-		return_error = BR_FAILED_REPLY;
-		goto err_bad_offset;
+	t->to_thread = target_thread;
+	if (target_thread) {
+		e->to_thread = target_thread->pid;
+		target_list = &target_thread->todo;
+		target_wait = &target_thread->wait;
+	} else {
+		target_list = &target_proc->todo;
+		target_wait = &target_proc->wait;
 	}
+
 	off_end = (void *)offp + tr->offsets_size;
 	for (; offp < off_end; offp++) {
 		struct flat_binder_object *fp;
 
-		if (*offp > t->buffer->data_size - sizeof(*fp) ||
-		    t->buffer->data_size < sizeof(*fp) ||
-		    !IS_ALIGNED(*offp, sizeof(u32))) {
+		if (!binder_validate_object(t->buffer, *offp)) {
 			binder_user_error("%d:%d got transaction with invalid offset, %lld\n",
 					  proc->pid, thread->pid, (u64)*offp);
 			return_error = BR_FAILED_REPLY;
@@ -1675,6 +1877,10 @@ static void binder_transaction(struct binder_proc *proc,
 			fp->handle = target_fd;
 		} break;
 
+		case BINDER_TYPE_PTR:
+			/* copied and fixed up by binder_transaction_copy() */
+			break;
+
 		default:
 			binder_user_error("%d:%d got transaction with invalid object type, %x\n",
 				proc->pid, thread->pid, fp->type);
@@ -1937,7 +2143,20 @@ static int binder_thread_write(struct binder_proc *proc,
 			if (copy_from_user(&tr, ptr, sizeof(tr)))
 				return -EFAULT;
 			ptr += sizeof(tr);
-			binder_transaction(proc, thread, &tr, cmd == BC_REPLY);
+			binder_transaction(proc, thread, &tr,
+					   cmd == BC_REPLY, 0);
+			break;
+		}
+
+		case BC_TRANSACTION_SG:
+		case BC_REPLY_SG: {
+			struct binder_transaction_data_sg tr;
+
+			if (copy_from_user(&tr, ptr, sizeof(tr)))
+				return -EFAULT;
+			ptr += sizeof(tr);
+			binder_transaction(proc, thread, &tr.transaction_data,
+					   cmd == BC_REPLY_SG, tr.buffers_size);
 			break;
 		}
 
@@ -3070,6 +3289,16 @@ static void binder_deferred_release(struct binder_proc *proc)
 	BUG_ON(proc->vma);
 	BUG_ON(proc->files);
 
+	/*
+	 * Without a vma no new transactions can pin us, so this only waits
+	 * for the copies that are already running.
+	 */
+	while (proc->tmp_ref) {
+		binder_unlock(__func__);
+		wait_event(binder_proc_unpin_wait, !READ_ONCE(proc->tmp_ref));
+		binder_lock(__func__);
+	}
+
 	hlist_del(&proc->proc_node);
 
 	if (binder_context_mgr_node && binder_context_mgr_node->proc == proc) {
@@ -3432,7 +3661,9 @@ static const char * const binder_command_strings[] = {
 	"BC_EXIT_LOOPER",
 	"BC_REQUEST_DEATH_NOTIFICATION",
 	"BC_CLEAR_DEATH_NOTIFICATION",
-	"BC_DEAD_BINDER_DONE"
+	"BC_DEAD_BINDER_DONE",
+	"BC_TRANSACTION_SG",
+	"BC_REPLY_SG",
 };
 
 static const char * const binder_objstat_strings[] = {
@@ -25,6 +25,7 @@
 #include <linux/async.h>
 #include <linux/pm_runtime.h>
 #include <linux/pinctrl/devinfo.h>
+#include <linux/of.h>
 
 #include "base.h"
 #include "power/power.h"
@@ -41,9 +42,12 @@
  *
  * Deferred probe maintains two lists of devices, a pending list and an active
  * list.  A driver returning -EPROBE_DEFER causes the device to be added to the
- * pending list.  A successful driver probe will trigger moving all devices
- * from the pending to the active list so that the workqueue will eventually
- * retry them.
+ * pending list.  A successful driver probe will trigger moving the devices
+ * that may depend on the newly bound one from the pending to the active list
+ * so that the workqueue will eventually retry them.  Devices for which no
+ * dependency is apparent are only retried once binding has been quiet for
+ * DEFERRED_PROBE_FULL_DELAY, so that a boot binding dozens of devices does
+ * not retry all of the pending list dozens of times.
  *
  * The deferred_probe_mutex must be held any time the deferred_probe_*_list
  * of the (struct device*)->p->deferred_probe pointers are manipulated
@@ -54,6 +58,8 @@ static LIST_HEAD(deferred_probe_active_list);
 static struct workqueue_struct *deferred_wq;
 static atomic_t deferred_trigger_count = ATOMIC_INIT(0);
 
+#define DEFERRED_PROBE_FULL_DELAY	(HZ / 2)
+
 /*
  * deferred_probe_work_func() - Retry probing devices in the active list.
  */
@@ -129,13 +135,80 @@ void driver_deferred_probe_del(struct device *dev)
 	mutex_unlock(&deferred_probe_mutex);
 }
 
+static bool of_subtree_has_phandle(struct device_node *np, phandle ph)
+{
+	struct device_node *child;
+
+	if (np->phandle == ph)
+		return true;
+
+	for_each_child_of_node(np, child) {
+		if (of_subtree_has_phandle(child, ph)) {
+			of_node_put(child);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Could @dev have been waiting for @supplier?  Without a device tree node on
+ * either side there is no telling, so yes.  Otherwise @dev depends on it if
+ * @supplier is one of its ancestors or if any property of @dev's node holds
+ * the phandle of @supplier's node or of one of its children (as pinctrl-N
+ * does).  Properties aren't typed, so every cell is treated as a potential
+ * phandle: a false match only costs a needless retry.
+ */
+static bool driver_deferred_probe_depends(struct device *dev,
+					  struct device *supplier)
+{
+	struct device_node *np = dev->of_node;
+	struct device_node *snp = supplier->of_node;
+	struct property *pp;
+	struct device *parent;
+
+	for (parent = dev->parent; parent; parent = parent->parent)
+		if (parent == supplier)
+			return true;
+
+	if (!IS_ENABLED(CONFIG_OF) || !np || !snp)
+		return true;
+
+	for_each_property_of_node(np, pp) {
+		const __be32 *cell = pp->value;
+		int i;
+
+		if (pp->length % sizeof(*cell))
+			continue;
+
+		for (i = 0; i < pp->length / sizeof(*cell); i++) {
+			phandle ph = be32_to_cpup(cell + i);
+
+			if (ph && of_subtree_has_phandle(snp, ph))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+static void deferred_probe_full_work_func(struct work_struct *work);
+static DECLARE_DELAYED_WORK(deferred_probe_full_work,
+			    deferred_probe_full_work_func);
+
 static bool driver_deferred_probe_enable = false;
+/* Only retry the likely dependents once the initcalls are over */
+static bool driver_deferred_probe_targeted = false;
 /**
  * driver_deferred_probe_trigger() - Kick off re-probing deferred devices
+ * @supplier: device that was just bound, or NULL to retry all devices
  *
- * This functions moves all devices from the pending list to the active
- * list and schedules the deferred probe workqueue to process them.  It
- * should be called anytime a driver is successfully bound to a device.
+ * This functions moves the devices that may depend on @supplier from the
+ * pending list to the active list and schedules the deferred probe
+ * workqueue to process them; the other pending devices are retried when
+ * binding has been quiet for a while.  It should be called anytime a
+ * driver is successfully bound to a device.
  *
  * Note, there is a race condition in multi-threaded probe. In the case where
  * more than one device is probing at the same time, it is possible for one
@@ -148,22 +221,42 @@ static bool driver_deferred_probe_enable = false;
  * changes in the midst of a probe, then deferred processing should be triggered
  * again.
  */
-static void driver_deferred_probe_trigger(void)
+static void driver_deferred_probe_trigger(struct device *supplier)
 {
+	struct device_private *private, *next;
+	bool left = false;
+
 	if (!driver_deferred_probe_enable)
 		return;
 
 	/*
-	 * A successful probe means that all the devices in the pending list
-	 * should be triggered to be reprobed.  Move all the deferred devices
+	 * A successful probe means that the devices in the pending list that
+	 * were waiting for it should be triggered to be reprobed.  Move them
 	 * into the active list so they can be retried by the workqueue
 	 */
 	mutex_lock(&deferred_probe_mutex);
 	atomic_inc(&deferred_trigger_count);
-	list_splice_tail_init(&deferred_probe_pending_list,
-			      &deferred_probe_active_list);
+	if (!supplier || !driver_deferred_probe_targeted) {
+		list_splice_tail_init(&deferred_probe_pending_list,
+				      &deferred_probe_active_list);
+	} else {
+		list_for_each_entry_safe(private, next,
+					 &deferred_probe_pending_list,
+					 deferred_probe) {
+			if (driver_deferred_probe_depends(private->device,
+							  supplier))
+				list_move_tail(&private->deferred_probe,
+					       &deferred_probe_active_list);
+			else
+				left = true;
+		}
+	}
 	mutex_unlock(&deferred_probe_mutex);
 
+	if (left)
+		mod_delayed_work(deferred_wq, &deferred_probe_full_work,
+				 DEFERRED_PROBE_FULL_DELAY);
+
 	/*
 	 * Kick the re-probe thread.  It may already be scheduled, but it is
 	 * safe to kick it again.
@@ -171,6 +264,15 @@ static void driver_deferred_probe_trigger(void)
 	queue_work(deferred_wq, &deferred_probe_work);
 }
 
+/*
+ * Catch the dependencies driver_deferred_probe_depends() cannot see, such
+ * as lookups by name, once the burst of binding that preceded it is over.
+ */
+static void deferred_probe_full_work_func(struct work_struct *work)
+{
+	driver_deferred_probe_trigger(NULL);
+}
+
 /**
  * deferred_probe_initcall() - Enable probing of deferred devices
  *
@@ -185,9 +287,15 @@ static int deferred_probe_initcall(void)
 		return -ENOMEM;
 
 	driver_deferred_probe_enable = true;
-	driver_deferred_probe_trigger();
-	/* Sort as many dependencies as possible before exiting initcalls */
+	driver_deferred_probe_trigger(NULL);
+	/*
+	 * Sort as many dependencies as possible before exiting initcalls,
+	 * retrying every pending device after each bind as before, so that
+	 * the root device is there when init runs.
+	 */
+	flush_delayed_work(&deferred_probe_full_work);
 	flush_workqueue(deferred_wq);
+	driver_deferred_probe_targeted = true;
 	return 0;
 }
 late_initcall(deferred_probe_initcall);
@@ -210,7 +318,7 @@ static void driver_bound(struct device *dev)
 	 * kick off retrying all pending devices
 	 */
 	driver_deferred_probe_del(dev);
-	driver_deferred_probe_trigger();
+	driver_deferred_probe_trigger(dev);
 
 	if (dev->bus)
 		blocking_notifier_call_chain(&dev->bus->p->bus_notifier,
@@ -346,7 +454,7 @@ probe_failed:
 		driver_deferred_probe_add(dev);
 		/* Did a trigger occur while probing? Need to re-trigger if yes */
 		if (local_trigger_count != atomic_read(&deferred_trigger_count))
-			driver_deferred_probe_trigger();
+			driver_deferred_probe_trigger(NULL);
 		break;
 	case -ENODEV:
 	case -ENXIO:
@@ -29,6 +29,9 @@
 #include <linux/syscore_ops.h>
 #include <linux/reboot.h>
 #include <linux/security.h>
+#include <linux/bsearch.h>
+#include <linux/kmod.h>
+#include <linux/initrd.h>
 
 #include <generated/utsrelease.h>
 
@@ -329,6 +332,8 @@ static int fw_get_filesystem_firmware(struct device *device,
 	int rc = -ENOENT;
 	char *path;
 
+	wait_for_initramfs();
+
 	path = __getname();
 	if (!path)
 		return -ENOMEM;
@@ -372,6 +377,184 @@ static int fw_get_filesystem_firmware(struct device *device,
 	return rc;
 }
 
+/*
+ * Firmware bundle support
+ *
+ * 'firmware_class.bundle=$FILE' names a file, or a block device, holding
+ * many firmware images behind an index.  It is read once, on the first
+ * request that comes after it shows up, and then kept: requests for the
+ * images it holds are served straight from it, without a copy, before the
+ * search path is tried.  The layout, all integers little endian:
+ *
+ *	struct fw_bundle_header
+ *	struct fw_bundle_entry[count], sorted by name
+ *	NUL terminated names and image data, anywhere after the index
+ */
+#define FW_BUNDLE_MAGIC		0x4c425746	/* "FWBL" */
+
+struct fw_bundle_header {
+	__le32 magic;
+	__le32 count;
+};
+
+struct fw_bundle_entry {
+	__le32 name_off;
+	__le32 data_off;
+	__le32 data_size;
+};
+
+static char fw_bundle_para[256];
+module_param_string(bundle, fw_bundle_para, sizeof(fw_bundle_para), 0644);
+MODULE_PARM_DESC(bundle, "file or block device holding a firmware bundle, used before the search path");
+
+static DEFINE_MUTEX(fw_bundle_mutex);
+static const u8 *fw_bundle;
+static size_t fw_bundle_size;
+static bool fw_bundle_bad;
+
+static const char *fw_bundle_name(const u8 *bundle, size_t size,
+				  const struct fw_bundle_entry *e)
+{
+	u32 off = le32_to_cpu(e->name_off);
+
+	if (off >= size || !memchr(bundle + off, 0, size - off))
+		return NULL;
+	return bundle + off;
+}
+
+static int fw_bundle_check(const u8 *bundle, size_t size)
+{
+	const struct fw_bundle_header *hdr = (const void *)bundle;
+	const struct fw_bundle_entry *e = (const void *)(hdr + 1);
+	const char *name, *prev = NULL;
+	u32 i, count;
+
+	if (size < sizeof(*hdr) || le32_to_cpu(hdr->magic) != FW_BUNDLE_MAGIC)
+		return -EINVAL;
+
+	count = le32_to_cpu(hdr->count);
+	if (count > (size - sizeof(*hdr)) / sizeof(*e))
+		return -EINVAL;
+
+	for (i = 0; i < count; i++, e++) {
+		u64 end = (u64)le32_to_cpu(e->data_off) +
+			  le32_to_cpu(e->data_size);
+
+		name = fw_bundle_name(bundle, size, e);
+		if (!name || end > size)
+			return -EINVAL;
+		if (prev && strcmp(prev, name) >= 0)
+			return -EINVAL;
+		prev = name;
+	}
+
+	return 0;
+}
+
+static void fw_bundle_load(void)
+{
+	struct file *file;
+	loff_t size;
+	u8 *buf;
+	int rc;
+
+	mutex_lock(&fw_bundle_mutex);
+	if (fw_bundle || fw_bundle_bad)
+		goto out;
+
+	/* not there yet, perhaps the root filesystem isn't mounted */
+	wait_for_initramfs();
+	file = filp_open(fw_bundle_para, O_RDONLY, 0);
+	if (IS_ERR(file))
+		goto out;
+
+	rc = -EINVAL;
+	buf = NULL;
+	size = i_size_read(file->f_mapping->host);
+	if (size <= sizeof(struct fw_bundle_header) || size > INT_MAX)
+		goto fail;
+
+	rc = -ENOMEM;
+	buf = vmalloc(size);
+	if (!buf)
+		goto fail;
+
+	rc = kernel_read(file, 0, buf, size);
+	if (rc != size) {
+		if (rc >= 0)
+			rc = -EIO;
+		goto fail;
+	}
+
+	rc = security_kernel_fw_from_file(file, buf, size);
+	if (!rc)
+		rc = fw_bundle_check(buf, size);
+	if (rc)
+		goto fail;
+
+	fput(file);
+	fw_bundle_size = size;
+	/* lookups don't take the mutex */
+	smp_store_release(&fw_bundle, buf);
+	pr_info("firmware: using bundle %s\n", fw_bundle_para);
+	goto out;
+
+fail:
+	fput(file);
+	vfree(buf);
+	fw_bundle_bad = true;
+	pr_warn("firmware: bundle %s not used, error %d\n", fw_bundle_para, rc);
+out:
+	mutex_unlock(&fw_bundle_mutex);
+}
+
+static int fw_bundle_cmp(const void *key, const void *elt)
+{
+	const char *name = fw_bundle_name(fw_bundle, fw_bundle_size, elt);
+
+	return strcmp(key, name);
+}
+
+static bool fw_get_bundle_firmware(struct firmware *fw, const char *name)
+{
+	const struct fw_bundle_header *hdr;
+	const struct fw_bundle_entry *e;
+	const u8 *bundle;
+
+	if (!fw_bundle_para[0])
+		return false;
+
+	bundle = smp_load_acquire(&fw_bundle);
+	if (!bundle && !fw_bundle_bad) {
+		/* don't touch the filesystem while it may be frozen */
+		if (usermodehelper_read_trylock())
+			return false;
+		fw_bundle_load();
+		usermodehelper_read_unlock();
+		bundle = smp_load_acquire(&fw_bundle);
+	}
+	if (!bundle)
+		return false;
+
+	hdr = (const void *)bundle;
+	e = bsearch(name, hdr + 1, le32_to_cpu(hdr->count), sizeof(*e),
+		    fw_bundle_cmp);
+	if (!e)
+		return false;
+
+	fw->size = le32_to_cpu(e->data_size);
+	fw->data = bundle + le32_to_cpu(e->data_off);
+	return true;
+}
+
+static bool fw_is_bundle_firmware(const struct firmware *fw)
+{
+	const u8 *bundle = smp_load_acquire(&fw_bundle);
+
+	return bundle && fw->data >= bundle &&
+	       fw->data <= bundle + fw_bundle_size && !fw->priv;
+}
+
 /* firmware holds the ownership of pages */
 static void firmware_free_data(const struct firmware *fw)
 {
@@ -1055,6 +1238,11 @@ _request_firmware_prepare(struct firmware **firmware_p, const char *name,
 		return 0; /* assigned */
 	}
 
+	if (fw_get_bundle_firmware(firmware, name)) {
+		dev_dbg(device, "firmware: using bundled firmware %s\n", name);
+		return 0; /* assigned */
+	}
+
 	ret = fw_lookup_and_allocate_buf(name, &fw_cache, &buf);
 
 	/*
@@ -1245,7 +1433,7 @@ EXPORT_SYMBOL_GPL(request_firmware_direct);
 void release_firmware(const struct firmware *fw)
 {
 	if (fw) {
-		if (!fw_is_builtin_firmware(fw))
+		if (!fw_is_builtin_firmware(fw) && !fw_is_bundle_firmware(fw))
 			firmware_free_data(fw);
 		kfree(fw);
 	}
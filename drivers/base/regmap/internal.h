@@ -175,6 +175,9 @@ bool regmap_precious(struct regmap *map, unsigned int reg);
 
 int _regmap_write(struct regmap *map, unsigned int reg,
 		  unsigned int val);
+int _regmap_multi_reg_write(struct regmap *map,
+			    const struct reg_sequence *regs,
+			    size_t num_regs);
 
 struct regmap_range_node {
 	struct rb_node node;
@@ -654,11 +654,81 @@ static int regcache_sync_block_single(struct regmap *map, void *block,
 	return 0;
 }
 
+/* registers synced with one multi register write */
+#define REGCACHE_SYNC_MULTI_REGS	16
+
+static int regcache_sync_block_multi_flush(struct regmap *map,
+					   struct reg_sequence *regs,
+					   unsigned int *count)
+{
+	int ret;
+
+	if (!*count)
+		return 0;
+
+	dev_dbg(map->dev, "Writing %u registers from 0x%x-0x%x\n",
+		*count, regs[0].reg, regs[*count - 1].reg);
+
+	map->cache_bypass = 1;
+
+	ret = _regmap_multi_reg_write(map, regs, *count);
+	if (ret)
+		dev_err(map->dev, "Unable to sync registers %#x-%#x. %d\n",
+			regs[0].reg, regs[*count - 1].reg, ret);
+
+	map->cache_bypass = 0;
+
+	*count = 0;
+
+	return ret;
+}
+
+/*
+ * For devices without auto-increment that accept several register/value
+ * pairs in one transfer, sync the dirty registers of a block a batch at
+ * a time rather than one transfer each.
+ */
+static int regcache_sync_block_multi(struct regmap *map, void *block,
+				     unsigned long *cache_present,
+				     unsigned int block_base,
+				     unsigned int start, unsigned int end)
+{
+	struct reg_sequence regs[REGCACHE_SYNC_MULTI_REGS];
+	unsigned int i, regtmp, val, count = 0;
+	int ret;
+
+	for (i = start; i < end; i++) {
+		regtmp = block_base + (i * map->reg_stride);
+
+		if (!regcache_reg_present(cache_present, i) ||
+		    !regmap_writeable(map, regtmp))
+			continue;
+
+		val = regcache_get_val(map, block, i);
+		if (!regcache_reg_needs_sync(map, regtmp, val))
+			continue;
+
+		regs[count].reg = regtmp;
+		regs[count].def = val;
+		regs[count].delay_us = 0;
+		if (++count < ARRAY_SIZE(regs))
+			continue;
+
+		ret = regcache_sync_block_multi_flush(map, regs, &count);
+		if (ret != 0)
+			return ret;
+	}
+
+	return regcache_sync_block_multi_flush(map, regs, &count);
+}
+
 static int regcache_sync_block_raw_flush(struct regmap *map, const void **data,
 					 unsigned int base, unsigned int cur)
 {
 	size_t val_bytes = map->format.val_bytes;
-	int ret, count;
+	unsigned int reg = base;
+	const void *val = *data;
+	int ret = 0, count, chunk;
 
 	if (*data == NULL)
 		return 0;
@@ -670,10 +740,25 @@ static int regcache_sync_block_raw_flush(struct regmap *map, const void **data,
 
 	map->cache_bypass = 1;
 
-	ret = _regmap_raw_write(map, base, *data, count * val_bytes);
-	if (ret)
-		dev_err(map->dev, "Unable to sync registers %#x-%#x. %d\n",
-			base, cur - map->reg_stride, ret);
+	/* split the run where the bus limits the size of a raw write */
+	while (count) {
+		chunk = count;
+		if (map->max_raw_write)
+			chunk = min_t(int, chunk,
+				      map->max_raw_write / val_bytes);
+
+		ret = _regmap_raw_write(map, reg, val, chunk * val_bytes);
+		if (ret) {
+			dev_err(map->dev,
+				"Unable to sync registers %#x-%#x. %d\n",
+				base, cur - map->reg_stride, ret);
+			break;
+		}
+
+		reg += chunk * map->reg_stride;
+		val += chunk * val_bytes;
+		count -= chunk;
+	}
 
 	map->cache_bypass = 0;
 
@@ -690,16 +775,27 @@ static int regcache_sync_block_raw(struct regmap *map, void *block,
 	unsigned int i, val;
 	unsigned int regtmp = 0;
 	unsigned int base = 0;
+	unsigned int last = 0;
+	unsigned int skipped = 0;
+	unsigned int max_skip;
 	const void *data = NULL;
 	int ret;
 
+	/*
+	 * Rewriting a few registers that still hold their default is
+	 * cheaper than starting a new transfer, which has to send the
+	 * register address again.
+	 */
+	max_skip = DIV_ROUND_UP(map->format.reg_bytes + map->format.pad_bytes,
+				map->format.val_bytes);
+
 	for (i = start; i < end; i++) {
 		regtmp = block_base + (i * map->reg_stride);
 
 		if (!regcache_reg_present(cache_present, i) ||
 		    !regmap_writeable(map, regtmp)) {
 			ret = regcache_sync_block_raw_flush(map, &data,
-							    base, regtmp);
+							    base, last);
 			if (ret != 0)
 				return ret;
 			continue;
@@ -707,8 +803,11 @@ static int regcache_sync_block_raw(struct regmap *map, void *block,
 
 		val = regcache_get_val(map, block, i);
 		if (!regcache_reg_needs_sync(map, regtmp, val)) {
+			if (data && ++skipped <= max_skip)
+				continue;
+
 			ret = regcache_sync_block_raw_flush(map, &data,
-							    base, regtmp);
+							    base, last);
 			if (ret != 0)
 				return ret;
 			continue;
@@ -718,10 +817,11 @@ static int regcache_sync_block_raw(struct regmap *map, void *block,
 			data = regcache_get_val_addr(map, block, i);
 			base = regtmp;
 		}
+		skipped = 0;
+		last = regtmp + map->reg_stride;
 	}
 
-	return regcache_sync_block_raw_flush(map, &data, base, regtmp +
-			map->reg_stride);
+	return regcache_sync_block_raw_flush(map, &data, base, last);
 }
 
 int regcache_sync_block(struct regmap *map, void *block,
@@ -732,6 +832,9 @@ int regcache_sync_block(struct regmap *map, void *block,
 	if (regmap_can_raw_write(map) && !map->use_single_write)
 		return regcache_sync_block_raw(map, block, cache_present,
 					       block_base, start, end);
+	else if (map->can_multi_write && map->format.parse_inplace)
+		return regcache_sync_block_multi(map, block, cache_present,
+						 block_base, start, end);
 	else
 		return regcache_sync_block_single(map, block, cache_present,
 						  block_base, start, end);
@@ -13,6 +13,8 @@
 #include <linux/regmap.h>
 #include <linux/i2c.h>
 #include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #include "internal.h"
 
@@ -124,10 +126,29 @@ static struct regmap_bus regmap_smbus_word_swapped = {
 	.reg_read = regmap_smbus_word_read_swapped,
 };
 
-static int regmap_i2c_write(void *context, const void *data, size_t count)
+/*
+ * Per client state of the plain I2C bus. Async writes are queued here and
+ * sent in order from a work item, any other I/O waits for that first.
+ */
+struct regmap_i2c_context {
+	struct i2c_client *i2c;
+	spinlock_t lock;
+	struct list_head pending;
+	struct work_struct work;
+};
+
+struct regmap_async_i2c {
+	struct regmap_async core;
+	struct list_head node;
+	const void *reg;
+	size_t reg_len;
+	const void *val;
+	size_t val_len;
+};
+
+static int regmap_i2c_send(struct i2c_client *i2c, const void *data,
+			   size_t count)
 {
-	struct device *dev = context;
-	struct i2c_client *i2c = to_i2c_client(dev);
 	int ret;
 
 	ret = i2c_master_send(i2c, data, count);
@@ -139,12 +160,10 @@ static int regmap_i2c_write(void *context, const void *data, size_t count)
 		return -EIO;
 }
 
-static int regmap_i2c_gather_write(void *context,
-				   const void *reg, size_t reg_size,
-				   const void *val, size_t val_size)
+static int regmap_i2c_send_gather(struct i2c_client *i2c,
+				  const void *reg, size_t reg_size,
+				  const void *val, size_t val_size)
 {
-	struct device *dev = context;
-	struct i2c_client *i2c = to_i2c_client(dev);
 	struct i2c_msg xfer[2];
 	int ret;
 
@@ -173,15 +192,161 @@ static int regmap_i2c_gather_write(void *context,
 		return -EIO;
 }
 
+static int regmap_i2c_async_send(struct i2c_client *i2c,
+				 struct regmap_async_i2c *async)
+{
+	void *buf;
+	int ret;
+
+	if (!async->val)
+		return regmap_i2c_send(i2c, async->reg, async->reg_len);
+
+	ret = regmap_i2c_send_gather(i2c, async->reg, async->reg_len,
+				     async->val, async->val_len);
+	if (ret != -ENOTSUPP)
+		return ret;
+
+	buf = kmalloc(async->reg_len + async->val_len, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	memcpy(buf, async->reg, async->reg_len);
+	memcpy(buf + async->reg_len, async->val, async->val_len);
+	ret = regmap_i2c_send(i2c, buf, async->reg_len + async->val_len);
+	kfree(buf);
+
+	return ret;
+}
+
+static void regmap_i2c_async_work(struct work_struct *work)
+{
+	struct regmap_i2c_context *ctx = container_of(work,
+						struct regmap_i2c_context,
+						work);
+	struct regmap_async_i2c *async;
+	int ret;
+
+	for (;;) {
+		spin_lock_irq(&ctx->lock);
+		async = list_first_entry_or_null(&ctx->pending,
+						 struct regmap_async_i2c, node);
+		if (async)
+			list_del(&async->node);
+		spin_unlock_irq(&ctx->lock);
+
+		if (!async)
+			break;
+
+		ret = regmap_i2c_async_send(ctx->i2c, async);
+		regmap_async_complete_cb(&async->core, ret);
+	}
+}
+
+/* Let the queued async writes go out before any other transfer */
+static void regmap_i2c_sync(struct regmap_i2c_context *ctx)
+{
+	flush_work(&ctx->work);
+}
+
+static int regmap_i2c_write(void *context, const void *data, size_t count)
+{
+	struct regmap_i2c_context *ctx = context;
+
+	regmap_i2c_sync(ctx);
+
+	return regmap_i2c_send(ctx->i2c, data, count);
+}
+
+static int regmap_i2c_multi_write(void *context, const void *data,
+				  size_t pair_size, size_t count)
+{
+	struct regmap_i2c_context *ctx = context;
+	struct i2c_client *i2c = ctx->i2c;
+	struct i2c_msg *xfer;
+	size_t i;
+	int ret;
+
+	regmap_i2c_sync(ctx);
+
+	xfer = kcalloc(count, sizeof(*xfer), GFP_KERNEL);
+	if (!xfer)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		xfer[i].addr = i2c->addr;
+		xfer[i].flags = 0;
+		xfer[i].len = pair_size;
+		xfer[i].buf = (void *)data + i * pair_size;
+	}
+
+	ret = i2c_transfer(i2c->adapter, xfer, count);
+	kfree(xfer);
+	if (ret == count)
+		return 0;
+	else if (ret < 0)
+		return ret;
+	else
+		return -EIO;
+}
+
+static int regmap_i2c_gather_write(void *context,
+				   const void *reg, size_t reg_size,
+				   const void *val, size_t val_size)
+{
+	struct regmap_i2c_context *ctx = context;
+
+	regmap_i2c_sync(ctx);
+
+	return regmap_i2c_send_gather(ctx->i2c, reg, reg_size, val, val_size);
+}
+
+static int regmap_i2c_async_write(void *context,
+				  const void *reg, size_t reg_len,
+				  const void *val, size_t val_len,
+				  struct regmap_async *a)
+{
+	struct regmap_async_i2c *async = container_of(a,
+						      struct regmap_async_i2c,
+						      core);
+	struct regmap_i2c_context *ctx = context;
+	unsigned long flags;
+
+	async->reg = reg;
+	async->reg_len = reg_len;
+	async->val = val;
+	async->val_len = val_len;
+
+	spin_lock_irqsave(&ctx->lock, flags);
+	list_add_tail(&async->node, &ctx->pending);
+	spin_unlock_irqrestore(&ctx->lock, flags);
+
+	queue_work(system_unbound_wq, &ctx->work);
+
+	return 0;
+}
+
+static struct regmap_async *regmap_i2c_async_alloc(void)
+{
+	struct regmap_async_i2c *async_i2c;
+
+	async_i2c = kzalloc(sizeof(*async_i2c), GFP_KERNEL);
+	if (!async_i2c)
+		return NULL;
+
+	return &async_i2c->core;
+}
+
 static int regmap_i2c_read(void *context,
 			   const void *reg, size_t reg_size,
 			   void *val, size_t val_size)
 {
-	struct device *dev = context;
-	struct i2c_client *i2c = to_i2c_client(dev);
+	struct regmap_i2c_context *ctx = context;
+	struct i2c_client *i2c = ctx->i2c;
 	struct i2c_msg xfer[2];
 	int ret;
 
+	regmap_i2c_sync(ctx);
+
 	xfer[0].addr = i2c->addr;
 	xfer[0].flags = 0;
 	xfer[0].len = reg_size;
@@ -201,10 +366,22 @@ static int regmap_i2c_read(void *context,
 		return -EIO;
 }
 
+static void regmap_i2c_free_context(void *context)
+{
+	struct regmap_i2c_context *ctx = context;
+
+	flush_work(&ctx->work);
+	kfree(ctx);
+}
+
 static struct regmap_bus regmap_i2c = {
 	.write = regmap_i2c_write,
+	.multi_write = regmap_i2c_multi_write,
 	.gather_write = regmap_i2c_gather_write,
+	.async_write = regmap_i2c_async_write,
+	.async_alloc = regmap_i2c_async_alloc,
 	.read = regmap_i2c_read,
+	.free_context = regmap_i2c_free_context,
 	.reg_format_endian_default = REGMAP_ENDIAN_BIG,
 	.val_format_endian_default = REGMAP_ENDIAN_BIG,
 };
@@ -282,18 +459,54 @@ static const struct regmap_bus *regmap_get_i2c_bus(struct i2c_client *i2c,
 	return ERR_PTR(-ENOTSUPP);
 }
 
+static void *regmap_get_i2c_context(struct i2c_client *i2c,
+				    const struct regmap_bus *bus)
+{
+	struct regmap_i2c_context *ctx;
+
+	if (bus != &regmap_i2c)
+		return &i2c->dev;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return ERR_PTR(-ENOMEM);
+
+	ctx->i2c = i2c;
+	spin_lock_init(&ctx->lock);
+	INIT_LIST_HEAD(&ctx->pending);
+	INIT_WORK(&ctx->work, regmap_i2c_async_work);
+
+	return ctx;
+}
+
+static void regmap_put_i2c_context(void *context,
+				   const struct regmap_bus *bus)
+{
+	if (bus == &regmap_i2c)
+		kfree(context);
+}
+
 struct regmap *__regmap_init_i2c(struct i2c_client *i2c,
 				 const struct regmap_config *config,
 				 struct lock_class_key *lock_key,
 				 const char *lock_name)
 {
 	const struct regmap_bus *bus = regmap_get_i2c_bus(i2c, config);
+	struct regmap *map;
+	void *ctx;
 
 	if (IS_ERR(bus))
 		return ERR_CAST(bus);
 
-	return __regmap_init(&i2c->dev, bus, &i2c->dev, config,
-			     lock_key, lock_name);
+	ctx = regmap_get_i2c_context(i2c, bus);
+	if (IS_ERR(ctx))
+		return ERR_CAST(ctx);
+
+	map = __regmap_init(&i2c->dev, bus, ctx, config, lock_key, lock_name);
+	if (IS_ERR(map))
+		regmap_put_i2c_context(ctx, bus);
+
+	return map;
 }
 EXPORT_SYMBOL_GPL(__regmap_init_i2c);
 
@@ -303,12 +516,22 @@ struct regmap *__devm_regmap_init_i2c(struct i2c_client *i2c,
 				      const char *lock_name)
 {
 	const struct regmap_bus *bus = regmap_get_i2c_bus(i2c, config);
+	struct regmap *map;
+	void *ctx;
 
 	if (IS_ERR(bus))
 		return ERR_CAST(bus);
 
-	return __devm_regmap_init(&i2c->dev, bus, &i2c->dev, config,
-				  lock_key, lock_name);
+	ctx = regmap_get_i2c_context(i2c, bus);
+	if (IS_ERR(ctx))
+		return ERR_CAST(ctx);
+
+	map = __devm_regmap_init(&i2c->dev, bus, ctx, config,
+				 lock_key, lock_name);
+	if (IS_ERR(map))
+		regmap_put_i2c_context(ctx, bus);
+
+	return map;
 }
 EXPORT_SYMBOL_GPL(__devm_regmap_init_i2c);
 
@@ -1846,9 +1846,17 @@ static int _regmap_raw_multi_reg_write(struct regmap *map,
 		u8 += val_bytes;
 	}
 	u8 = buf;
-	*u8 |= map->write_flag_mask;
+	if (map->bus->multi_write) {
+		for (i = 0; i < num_regs; i++)
+			u8[i * pair_size] |= map->write_flag_mask;
 
-	ret = map->bus->write(map->bus_context, buf, len);
+		ret = map->bus->multi_write(map->bus_context, buf, pair_size,
+					    num_regs);
+	} else {
+		*u8 |= map->write_flag_mask;
+
+		ret = map->bus->write(map->bus_context, buf, len);
+	}
 
 	kfree(buf);
 
@@ -1945,9 +1953,9 @@ static int _regmap_range_multi_paged_reg_write(struct regmap *map,
 	return 0;
 }
 
-static int _regmap_multi_reg_write(struct regmap *map,
-				   const struct reg_sequence *regs,
-				   size_t num_regs)
+int _regmap_multi_reg_write(struct regmap *map,
+			    const struct reg_sequence *regs,
+			    size_t num_regs)
 {
 	int i;
 	int ret;
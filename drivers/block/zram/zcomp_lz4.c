@@ -8,11 +8,17 @@
  */
 
 #include <linux/kernel.h>
+#include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/lz4.h>
 
 #include "zcomp_lz4.h"
 
+static int lz4_acceleration = LZ4_ACCELERATION_DEFAULT;
+module_param(lz4_acceleration, int, 0644);
+MODULE_PARM_DESC(lz4_acceleration,
+		 "lz4 speed/ratio trade off, 1 for the best ratio");
+
 static void *zcomp_lz4_create(void)
 {
 	return kzalloc(LZ4_MEM_COMPRESS, GFP_KERNEL);
@@ -27,7 +33,8 @@ static int zcomp_lz4_compress(const unsigned char *src, unsigned char *dst,
 		size_t *dst_len, void *private)
 {
 	/* return  : Success if return 0 */
-	return lz4_compress(src, PAGE_SIZE, dst, dst_len, private);
+	return lz4_compress_fast(src, PAGE_SIZE, dst, dst_len, private,
+				 READ_ONCE(lz4_acceleration));
 }
 
 static int zcomp_lz4_decompress(const unsigned char *src, size_t src_len,
@@ -30,6 +30,7 @@
 #include <linux/err.h>
 #include <linux/idr.h>
 #include <linux/sysfs.h>
+#include <linux/fs.h>
 
 #include "zram_drv.h"
 
@@ -157,31 +158,51 @@ static inline void update_used_max(struct zram *zram,
 	} while (old_max != cur_max);
 }
 
-static int page_zero_filled(void *ptr)
+/*
+ * check whether the page is filled with a single repeated machine word,
+ * zero filled pages being the most common case, and return that word
+ */
+static bool page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
+	unsigned long val;
 
 	page = (unsigned long *)ptr;
+	val = page[0];
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
-			return 0;
+	for (pos = 1; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (page[pos] != val)
+			return false;
 	}
 
-	return 1;
+	*element = val;
+	return true;
+}
+
+static void zram_fill_page(void *ptr, unsigned long len,
+			   unsigned long value)
+{
+	unsigned long *page = ptr;
+	unsigned int pos;
+
+	if (!value) {
+		memset(ptr, 0, len);
+		return;
+	}
+
+	for (pos = 0; pos != len / sizeof(*page); pos++)
+		page[pos] = value;
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
 	void *user_mem;
 
 	user_mem = kmap_atomic(page);
-	if (is_partial_io(bvec))
-		memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
-	else
-		clear_page(user_mem);
+	/* bv_offset and bv_len are sector aligned, hence word aligned */
+	zram_fill_page(user_mem + bvec->bv_offset, bvec->bv_len, element);
 	kunmap_atomic(user_mem);
 
 	flush_dcache_page(page);
@@ -307,21 +328,14 @@ static ssize_t mem_used_max_store(struct device *dev,
 static ssize_t max_comp_streams_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
-	int val;
-	struct zram *zram = dev_to_zram(dev);
-
-	down_read(&zram->init_lock);
-	val = zram->max_comp_streams;
-	up_read(&zram->init_lock);
-
-	return scnprintf(buf, PAGE_SIZE, "%d\n", val);
+	/* there is one compression stream per CPU */
+	return scnprintf(buf, PAGE_SIZE, "%d\n", num_online_cpus());
 }
 
 static ssize_t max_comp_streams_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	int num;
-	struct zram *zram = dev_to_zram(dev);
 	int ret;
 
 	ret = kstrtoint(buf, 0, &num);
@@ -330,20 +344,31 @@ static ssize_t max_comp_streams_store(struct device *dev,
 	if (num < 1)
 		return -EINVAL;
 
-	down_write(&zram->init_lock);
-	if (init_done(zram)) {
-		if (!zcomp_set_max_streams(zram->comp, num)) {
-			pr_info("Cannot change max compression streams\n");
-			ret = -EINVAL;
-			goto out;
-		}
-	}
+	/* streams are per CPU now, the value is accepted but has no effect */
+	return len;
+}
 
-	zram->max_comp_streams = num;
-	ret = len;
-out:
-	up_write(&zram->init_lock);
-	return ret;
+static ssize_t async_write_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", zram->async_write);
+}
+
+static ssize_t async_write_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+	int ret;
+
+	ret = strtobool(buf, &val);
+	if (ret < 0)
+		return ret;
+
+	WRITE_ONCE(zram->async_write, val);
+	return len;
 }
 
 static ssize_t comp_algorithm_show(struct device *dev,
@@ -467,6 +492,287 @@ ZRAM_ATTR_RO(notify_free);
 ZRAM_ATTR_RO(zero_pages);
 ZRAM_ATTR_RO(compr_data_size);
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+static bool zram_wb_enabled(struct zram *zram)
+{
+	return zram->backing_dev;
+}
+
+static void reset_bdev(struct zram *zram)
+{
+	struct block_device *bdev;
+
+	if (!zram_wb_enabled(zram))
+		return;
+
+	bdev = zram->bdev;
+	/* hope filp_close flush all of IO */
+	set_blocksize(bdev, zram->old_block_size);
+	blkdev_put(bdev, FMODE_READ|FMODE_WRITE|FMODE_EXCL);
+	filp_close(zram->backing_dev, NULL);
+	zram->backing_dev = NULL;
+	zram->old_block_size = 0;
+	zram->bdev = NULL;
+
+	vfree(zram->bitmap);
+	zram->bitmap = NULL;
+	zram->nr_pages = 0;
+}
+
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct file *file;
+	char *p;
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	file = zram->backing_dev;
+	if (!file) {
+		memcpy(buf, "none\n", 5);
+		up_read(&zram->init_lock);
+		return 5;
+	}
+
+	p = file_path(file, buf, PAGE_SIZE - 1);
+	if (IS_ERR(p)) {
+		ret = PTR_ERR(p);
+		goto out;
+	}
+
+	ret = strlen(p);
+	memmove(buf, p, ret);
+	buf[ret++] = '\n';
+out:
+	up_read(&zram->init_lock);
+	return ret;
+}
+
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	char *file_name;
+	size_t sz;
+	struct file *backing_dev = NULL;
+	struct inode *inode;
+	struct address_space *mapping;
+	unsigned int bitmap_sz, old_block_size = 0;
+	unsigned long nr_pages, *bitmap = NULL;
+	struct block_device *bdev = NULL;
+	int err;
+	struct zram *zram = dev_to_zram(dev);
+
+	file_name = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!file_name)
+		return -ENOMEM;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		pr_info("Can't setup backing device for initialized device\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	strlcpy(file_name, buf, PATH_MAX);
+	/* ignore trailing newline */
+	sz = strlen(file_name);
+	if (sz > 0 && file_name[sz - 1] == '\n')
+		file_name[sz - 1] = 0x00;
+
+	backing_dev = filp_open(file_name, O_RDWR|O_LARGEFILE, 0);
+	if (IS_ERR(backing_dev)) {
+		err = PTR_ERR(backing_dev);
+		backing_dev = NULL;
+		goto out;
+	}
+
+	mapping = backing_dev->f_mapping;
+	inode = mapping->host;
+
+	/* Support only block device in this moment */
+	if (!S_ISBLK(inode->i_mode)) {
+		err = -ENOTBLK;
+		goto out;
+	}
+
+	bdev = bdgrab(I_BDEV(inode));
+	err = blkdev_get(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL, zram);
+	if (err < 0) {
+		bdev = NULL;
+		goto out;
+	}
+
+	nr_pages = i_size_read(inode) >> PAGE_SHIFT;
+	bitmap_sz = BITS_TO_LONGS(nr_pages) * sizeof(long);
+	bitmap = vzalloc(bitmap_sz);
+	if (!bitmap) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	old_block_size = block_size(bdev);
+	err = set_blocksize(bdev, PAGE_SIZE);
+	if (err)
+		goto out;
+
+	reset_bdev(zram);
+
+	zram->old_block_size = old_block_size;
+	zram->bdev = bdev;
+	zram->backing_dev = backing_dev;
+	zram->bitmap = bitmap;
+	zram->nr_pages = nr_pages;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s\n", file_name);
+	kfree(file_name);
+
+	return len;
+out:
+	vfree(bitmap);
+
+	if (bdev)
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+
+	if (backing_dev)
+		filp_close(backing_dev, NULL);
+
+	up_write(&zram->init_lock);
+
+	kfree(file_name);
+
+	return err;
+}
+
+/* return a free block of the backing device, 0 if there is none */
+static unsigned long alloc_block_bdev(struct zram *zram)
+{
+	unsigned long blk_idx = 1;
+retry:
+	/* skip 0 bit to confuse zram.handle = 0 */
+	blk_idx = find_next_zero_bit(zram->bitmap, zram->nr_pages, blk_idx);
+	if (blk_idx == zram->nr_pages)
+		return 0;
+
+	if (test_and_set_bit(blk_idx, zram->bitmap))
+		goto retry;
+
+	atomic64_inc(&zram->stats.bd_count);
+	return blk_idx;
+}
+
+static void free_block_bdev(struct zram *zram, unsigned long blk_idx)
+{
+	int was_set;
+
+	was_set = test_and_clear_bit(blk_idx, zram->bitmap);
+	WARN_ON_ONCE(!was_set);
+	atomic64_dec(&zram->stats.bd_count);
+}
+
+/*
+ * Synchronously transfer one page from/to the backing device.  Not for
+ * the bio path, see zram_bdev_read().
+ */
+static int zram_bdev_rw(struct zram *zram, struct page *page,
+			unsigned long blk_idx, int rw)
+{
+	struct bio *bio;
+	int ret;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> SECTOR_SHIFT);
+	bio->bi_bdev = zram->bdev;
+	if (!bio_add_page(bio, page, PAGE_SIZE, 0)) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	ret = submit_bio_wait(rw, bio);
+	bio_put(bio);
+
+	if (rw == READ)
+		atomic64_inc(&zram->stats.bd_reads);
+	else
+		atomic64_inc(&zram->stats.bd_writes);
+	return ret;
+}
+
+struct zram_work {
+	struct work_struct work;
+	struct zram *zram;
+	struct page *page;
+	unsigned long blk_idx;
+	int ret;
+};
+
+static void zram_sync_read(struct work_struct *work)
+{
+	struct zram_work *zw = container_of(work, struct zram_work, work);
+
+	zw->ret = zram_bdev_rw(zw->zram, zw->page, zw->blk_idx, READ);
+}
+
+/*
+ * Reads are issued from zram_make_request(), where a bio submitted to the
+ * backing device is only queued on current->bio_list until we return.
+ * Waiting for it there would never finish, so wait from a worker instead.
+ */
+static int zram_bdev_read(struct zram *zram, struct page *page,
+			  unsigned long blk_idx)
+{
+	struct zram_work work;
+
+	work.zram = zram;
+	work.page = page;
+	work.blk_idx = blk_idx;
+
+	INIT_WORK_ONSTACK(&work.work, zram_sync_read);
+	queue_work(system_unbound_wq, &work.work);
+	flush_work(&work.work);
+	destroy_work_on_stack(&work.work);
+
+	return work.ret;
+}
+
+static ssize_t bd_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+			"%8llu %8llu %8llu\n",
+			(u64)atomic64_read(&zram->stats.bd_count),
+			(u64)atomic64_read(&zram->stats.bd_reads),
+			(u64)atomic64_read(&zram->stats.bd_writes));
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+static DEVICE_ATTR_RO(bd_stat);
+#else
+static inline bool zram_wb_enabled(struct zram *zram) { return false; }
+static inline void reset_bdev(struct zram *zram) {}
+static inline void free_block_bdev(struct zram *zram,
+				   unsigned long blk_idx) {}
+static inline int zram_bdev_rw(struct zram *zram, struct page *page,
+			       unsigned long blk_idx, int rw)
+{
+	return -EIO;
+}
+static inline int zram_bdev_read(struct zram *zram, struct page *page,
+				 unsigned long blk_idx)
+{
+	return -EIO;
+}
+#endif
+
 static inline bool zram_meta_get(struct zram *zram)
 {
 	if (atomic_inc_not_zero(&zram->refcount))
@@ -476,7 +782,8 @@ static inline bool zram_meta_get(struct zram *zram)
 
 static inline void zram_meta_put(struct zram *zram)
 {
-	atomic_dec(&zram->refcount);
+	if (atomic_dec_and_test(&zram->refcount))
+		wake_up(&zram->io_done);
 }
 
 static void zram_meta_free(struct zram_meta *meta, u64 disksize)
@@ -487,8 +794,13 @@ static void zram_meta_free(struct zram_meta *meta, u64 disksize)
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < num_pages; index++) {
 		unsigned long handle = meta->table[index].handle;
-
-		if (!handle)
+		/*
+		 * No memory is allocated for same element filled or
+		 * written back pages, ->handle holds the element or the
+		 * backing device block there.
+		 */
+		if (!handle || zram_test_flag(meta, index, ZRAM_SAME) ||
+		    zram_test_flag(meta, index, ZRAM_WB))
 			continue;
 
 		zs_free(meta->mem_pool, handle);
@@ -536,20 +848,35 @@ out_error:
 static void zram_free_page(struct zram *zram, size_t index)
 {
 	struct zram_meta *meta = zram->meta;
-	unsigned long handle = meta->table[index].handle;
+	unsigned long handle;
 
-	if (unlikely(!handle)) {
-		/*
-		 * No memory is allocated for zero filled pages.
-		 * Simply clear zero page flag.
-		 */
-		if (zram_test_flag(meta, index, ZRAM_ZERO)) {
-			zram_clear_flag(meta, index, ZRAM_ZERO);
-			atomic64_dec(&zram->stats.zero_pages);
-		}
+	/* any write or discard invalidates a writeback in flight */
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+	zram_clear_flag(meta, index, ZRAM_HUGE);
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_clear_flag(meta, index, ZRAM_WB);
+		free_block_bdev(zram, meta->table[index].handle);
+		meta->table[index].handle = 0;
+		return;
+	}
+
+	/*
+	 * No memory is allocated for same element filled pages.
+	 * Simply clear same page flag.
+	 */
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		zram_clear_flag(meta, index, ZRAM_SAME);
+		meta->table[index].element = 0;
+		atomic64_dec(&zram->stats.zero_pages);
 		return;
 	}
 
+	handle = meta->table[index].handle;
+	if (!handle)
+		return;
+
 	zs_free(meta->mem_pool, handle);
 
 	atomic64_sub(zram_get_obj_size(meta, index),
@@ -560,6 +887,55 @@ static void zram_free_page(struct zram *zram, size_t index)
 	zram_set_obj_size(meta, index, 0);
 }
 
+/* read a written back page into the buffer @mem in PAGE_SIZE */
+static int zram_read_from_bdev(struct zram *zram, char *mem,
+			       unsigned long blk_idx)
+{
+	struct page *page;
+	int ret;
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = zram_bdev_read(zram, page, blk_idx);
+	if (!ret)
+		copy_page(mem, page_address(page));
+	__free_page(page);
+	return ret;
+}
+
+static int zram_bvec_read_from_bdev(struct zram *zram, struct bio_vec *bvec,
+				    unsigned long blk_idx, int offset)
+{
+	struct page *page;
+	void *src, *dst;
+	int ret;
+
+	if (!is_partial_io(bvec)) {
+		ret = zram_bdev_read(zram, bvec->bv_page, blk_idx);
+		goto out;
+	}
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = zram_bdev_read(zram, page, blk_idx);
+	if (!ret) {
+		src = kmap_atomic(page);
+		dst = kmap_atomic(bvec->bv_page);
+		memcpy(dst + bvec->bv_offset, src + offset, bvec->bv_len);
+		kunmap_atomic(dst);
+		kunmap_atomic(src);
+	}
+	__free_page(page);
+out:
+	if (!ret)
+		flush_dcache_page(bvec->bv_page);
+	return ret;
+}
+
 static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 {
 	int ret = 0;
@@ -572,12 +948,20 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	handle = meta->table[index].handle;
 	size = zram_get_obj_size(meta, index);
 
-	if (!handle || zram_test_flag(meta, index, ZRAM_ZERO)) {
+	if (!handle || zram_test_flag(meta, index, ZRAM_SAME)) {
+		/* ->element is 0 for never written pages */
+		unsigned long element = meta->table[index].element;
+
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
-		clear_page(mem);
+		zram_fill_page(mem, PAGE_SIZE, element);
 		return 0;
 	}
 
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return zram_read_from_bdev(zram, mem, handle);
+	}
+
 	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_RO);
 	if (size == PAGE_SIZE)
 		copy_page(mem, cmem);
@@ -605,10 +989,21 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	page = bvec->bv_page;
 
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		unsigned long blk_idx = meta->table[index].handle;
+
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return zram_bvec_read_from_bdev(zram, bvec, blk_idx, offset);
+	}
+
 	if (unlikely(!meta->table[index].handle) ||
-			zram_test_flag(meta, index, ZRAM_ZERO)) {
+			zram_test_flag(meta, index, ZRAM_SAME)) {
+		/* ->element is 0 for never written pages */
+		unsigned long element = meta->table[index].element;
+
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
-		handle_zero_page(bvec);
+		handle_same_page(bvec, element);
 		return 0;
 	}
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
@@ -656,6 +1051,7 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	struct zram_meta *meta = zram->meta;
 	struct zcomp_strm *zstrm = NULL;
 	unsigned long alloced_pages;
+	unsigned long element;
 
 	page = bvec->bv_page;
 	if (is_partial_io(bvec)) {
@@ -685,13 +1081,14 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		uncmem = user_mem;
 	}
 
-	if (page_zero_filled(uncmem)) {
+	if (page_same_filled(uncmem, &element)) {
 		if (user_mem)
 			kunmap_atomic(user_mem);
 		/* Free memory associated with this sector now. */
 		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
 		zram_free_page(zram, index);
-		zram_set_flag(meta, index, ZRAM_ZERO);
+		zram_set_flag(meta, index, ZRAM_SAME);
+		meta->table[index].element = element;
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
 		atomic64_inc(&zram->stats.zero_pages);
@@ -757,6 +1154,8 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 
 	meta->table[index].handle = handle;
 	zram_set_obj_size(meta, index, clen);
+	if (clen == PAGE_SIZE)
+		zram_set_flag(meta, index, ZRAM_HUGE);
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
 	/* Update stats */
@@ -770,6 +1169,146 @@ out:
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* mark every page which currently holds memory as idle */
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	struct zram_meta *meta;
+	unsigned long index;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	meta = zram->meta;
+	for (index = 0; index < nr_pages; index++) {
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (meta->table[index].handle &&
+		    !zram_test_flag(meta, index, ZRAM_SAME) &&
+		    !zram_test_flag(meta, index, ZRAM_WB))
+			zram_set_flag(meta, index, ZRAM_IDLE);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+	}
+
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+#define HUGE_WRITEBACK 0x1
+#define IDLE_WRITEBACK 0x2
+
+/*
+ * Write huge or idle pages out to the backing device and free their
+ * compressed copies.  A page accessed or rewritten while its writeback
+ * is in flight loses ZRAM_UNDER_WB/ZRAM_IDLE and stays in memory.
+ */
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index, blk_idx = 0;
+	struct zram_meta *meta;
+	struct page *page;
+	ssize_t ret = len;
+	int mode, err;
+
+	if (sysfs_streq(buf, "idle"))
+		mode = IDLE_WRITEBACK;
+	else if (sysfs_streq(buf, "huge"))
+		mode = HUGE_WRITEBACK;
+	else
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
+	if (!zram_wb_enabled(zram)) {
+		ret = -ENODEV;
+		goto release_init_lock;
+	}
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		ret = -ENOMEM;
+		goto release_init_lock;
+	}
+
+	meta = zram->meta;
+	for (index = 0; index < nr_pages; index++) {
+		if (!blk_idx) {
+			blk_idx = alloc_block_bdev(zram);
+			if (!blk_idx) {
+				ret = -ENOSPC;
+				break;
+			}
+		}
+
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (!meta->table[index].handle ||
+		    zram_test_flag(meta, index, ZRAM_SAME) ||
+		    zram_test_flag(meta, index, ZRAM_WB) ||
+		    zram_test_flag(meta, index, ZRAM_UNDER_WB))
+			goto next;
+
+		if ((mode & IDLE_WRITEBACK &&
+		     !zram_test_flag(meta, index, ZRAM_IDLE)) ||
+		    (mode & HUGE_WRITEBACK &&
+		     !zram_test_flag(meta, index, ZRAM_HUGE)))
+			goto next;
+
+		zram_set_flag(meta, index, ZRAM_UNDER_WB);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+		err = zram_decompress_page(zram, page_address(page), index);
+		if (!err)
+			err = zram_bdev_rw(zram, page, blk_idx, WRITE);
+
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (err) {
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			ret = err;
+			goto next;
+		}
+
+		/* the page was freed, rewritten or accessed meanwhile */
+		if (!zram_test_flag(meta, index, ZRAM_UNDER_WB) ||
+		    (mode & IDLE_WRITEBACK &&
+		     !zram_test_flag(meta, index, ZRAM_IDLE))) {
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			goto next;
+		}
+
+		zram_free_page(zram, index);
+		zram_set_flag(meta, index, ZRAM_WB);
+		meta->table[index].handle = blk_idx;
+		blk_idx = 0;
+next:
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+	}
+
+	if (blk_idx)
+		free_block_bdev(zram, blk_idx);
+	__free_page(page);
+release_init_lock:
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+#endif
+
 /*
  * zram_bio_discard - handler on discard request
  * @index: physical block index in PAGE_SIZE units
@@ -838,6 +1377,110 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 	return ret;
 }
 
+/*
+ * Asynchronous writes: each page of a write bio is compressed by a work
+ * item of its own, spread over the online CPUs, and the bio completes
+ * once the last page is stored.  Swap writes a page per bio, so single
+ * page bios are spread too: consecutive ones go to different CPUs.
+ */
+struct zram_async_page {
+	struct work_struct work;
+	struct zram_async_bio *abio;
+	struct bio_vec bvec;
+	u32 index;
+};
+
+struct zram_async_bio {
+	struct zram *zram;
+	struct bio *bio;
+	atomic_t pending;
+	int error;
+	struct zram_async_page pages[];
+};
+
+static struct workqueue_struct *zram_async_wq;
+
+static void zram_async_page_fn(struct work_struct *work)
+{
+	struct zram_async_page *apage =
+		container_of(work, struct zram_async_page, work);
+	struct zram_async_bio *abio = apage->abio;
+	struct zram *zram = abio->zram;
+
+	if (zram_bvec_rw(zram, &apage->bvec, apage->index, 0, WRITE) < 0)
+		abio->error = -EIO;
+
+	if (!atomic_dec_and_test(&abio->pending))
+		return;
+
+	if (abio->error)
+		bio_io_error(abio->bio);
+	else
+		bio_endio(abio->bio);
+	kfree(abio);
+	zram_meta_put(zram);
+}
+
+/*
+ * Only page aligned write bios can be split into pages.  Returns false if
+ * @bio has to be handled synchronously.
+ */
+static bool zram_write_async(struct zram *zram, struct bio *bio)
+{
+	struct zram_async_bio *abio;
+	struct bio_vec bvec;
+	struct bvec_iter iter;
+	unsigned int nr_pages = 0;
+	int cpu = READ_ONCE(zram->async_cpu);
+	u32 index;
+
+	if (!READ_ONCE(zram->async_write) || bio_data_dir(bio) != WRITE ||
+	    bio->bi_iter.bi_sector & (SECTORS_PER_PAGE - 1))
+		return false;
+
+	bio_for_each_segment(bvec, bio, iter) {
+		if (bvec.bv_len != PAGE_SIZE || bvec.bv_offset)
+			return false;
+		nr_pages++;
+	}
+
+	abio = kmalloc(sizeof(*abio) + nr_pages * sizeof(abio->pages[0]),
+		       GFP_NOIO | __GFP_NOWARN);
+	if (!abio)
+		return false;
+
+	/* dropped by the last page, see zram_async_page_fn() */
+	if (!zram_meta_get(zram)) {
+		kfree(abio);
+		return false;
+	}
+
+	abio->zram = zram;
+	abio->bio = bio;
+	abio->error = 0;
+	atomic_set(&abio->pending, nr_pages);
+
+	index = bio->bi_iter.bi_sector >> SECTORS_PER_PAGE_SHIFT;
+	nr_pages = 0;
+	bio_for_each_segment(bvec, bio, iter) {
+		struct zram_async_page *apage = &abio->pages[nr_pages++];
+
+		apage->abio = abio;
+		apage->bvec = bvec;
+		apage->index = index++;
+		INIT_WORK(&apage->work, zram_async_page_fn);
+
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+		queue_work_on(cpu, zram_async_wq, &apage->work);
+	}
+	/* racing writers may pick the same CPU, that's fine */
+	WRITE_ONCE(zram->async_cpu, cpu);
+
+	return true;
+}
+
 static void __zram_make_request(struct zram *zram, struct bio *bio)
 {
 	int offset, rw;
@@ -855,6 +1498,9 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 		return;
 	}
 
+	if (zram_write_async(zram, bio))
+		return;
+
 	rw = bio_data_dir(bio);
 	bio_for_each_segment(bvec, bio, iter) {
 		int max_transfer_size = PAGE_SIZE - offset;
@@ -894,7 +1540,7 @@ out:
 /*
  * Handler function for all zram I/O requests.
  */
-static void zram_make_request(struct request_queue *queue, struct bio *bio)
+static blk_qc_t zram_make_request(struct request_queue *queue, struct bio *bio)
 {
 	struct zram *zram = queue->queuedata;
 
@@ -911,11 +1557,12 @@ static void zram_make_request(struct request_queue *queue, struct bio *bio)
 
 	__zram_make_request(zram, bio);
 	zram_meta_put(zram);
-	return;
+	return BLK_QC_T_NONE;
 put_zram:
 	zram_meta_put(zram);
 error:
 	bio_io_error(bio);
+	return BLK_QC_T_NONE;
 }
 
 static void zram_slot_free_notify(struct block_device *bdev,
@@ -942,6 +1589,10 @@ static int zram_rw_page(struct block_device *bdev, sector_t sector,
 	struct bio_vec bv;
 
 	zram = bdev->bd_disk->private_data;
+	/* fail, so that the page is resubmitted as a bio for async writes */
+	if (rw == WRITE && READ_ONCE(zram->async_write))
+		goto out;
+
 	if (unlikely(!zram_meta_get(zram)))
 		goto out;
 
@@ -1008,7 +1659,6 @@ static void zram_reset_device(struct zram *zram)
 	/* Reset stats */
 	memset(&zram->stats, 0, sizeof(zram->stats));
 	zram->disksize = 0;
-	zram->max_comp_streams = 1;
 
 	set_capacity(zram->disk, 0);
 	part_stat_set_all(&zram->disk->part0, 0);
@@ -1017,6 +1667,7 @@ static void zram_reset_device(struct zram *zram)
 	/* I/O operation under all of CPU are done so let's free */
 	zram_meta_free(meta, disksize);
 	zcomp_destroy(comp);
+	reset_bdev(zram);
 }
 
 static ssize_t disksize_store(struct device *dev,
@@ -1037,7 +1688,7 @@ static ssize_t disksize_store(struct device *dev,
 	if (!meta)
 		return -ENOMEM;
 
-	comp = zcomp_create(zram->compressor, zram->max_comp_streams);
+	comp = zcomp_create(zram->compressor);
 	if (IS_ERR(comp)) {
 		pr_err("Cannot initialise %s compressing backend\n",
 				zram->compressor);
@@ -1154,6 +1805,12 @@ static DEVICE_ATTR_RW(mem_limit);
 static DEVICE_ATTR_RW(mem_used_max);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+static DEVICE_ATTR_RW(async_write);
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR_RW(backing_dev);
+static DEVICE_ATTR_WO(idle);
+static DEVICE_ATTR_WO(writeback);
+#endif
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
@@ -1174,6 +1831,13 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_mem_used_max.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_async_write.attr,
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_backing_dev.attr,
+	&dev_attr_idle.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_bd_stat.attr,
+#endif
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
 	NULL,
@@ -1272,7 +1936,6 @@ static int zram_add(void)
 	}
 	strlcpy(zram->compressor, default_compressor, sizeof(zram->compressor));
 	zram->meta = NULL;
-	zram->max_comp_streams = 1;
 
 	pr_info("Added device: %s\n", zram->disk->disk_name);
 	return device_id;
@@ -1399,15 +2062,23 @@ static void destroy_devices(void)
 	idr_for_each(&zram_index_idr, &zram_remove_cb, NULL);
 	idr_destroy(&zram_index_idr);
 	unregister_blkdev(zram_major, "zram");
+	destroy_workqueue(zram_async_wq);
 }
 
 static int __init zram_init(void)
 {
 	int ret;
 
+	/* used on the swap out path, hence WQ_MEM_RECLAIM */
+	zram_async_wq = alloc_workqueue("zram_async",
+				WQ_MEM_RECLAIM | WQ_HIGHPRI, 0);
+	if (!zram_async_wq)
+		return -ENOMEM;
+
 	ret = class_register(&zram_control_class);
 	if (ret) {
 		pr_err("Unable to register zram-control class\n");
+		destroy_workqueue(zram_async_wq);
 		return ret;
 	}
 
@@ -1415,6 +2086,7 @@ static int __init zram_init(void)
 	if (zram_major <= 0) {
 		pr_err("Unable to get major number\n");
 		class_unregister(&zram_control_class);
+		destroy_workqueue(zram_async_wq);
 		return -EBUSY;
 	}
 
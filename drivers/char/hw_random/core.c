@@ -49,6 +49,13 @@
 #define RNG_MODULE_NAME		"hw_random"
 #define PFX			RNG_MODULE_NAME ": "
 #define RNG_MISCDEV_MINOR	183 /* official */
+/*
+ * khwrngd collects this much before mixing it into the input pool, so
+ * that the entropy is credited in a few large steps instead of one per
+ * (often 4 to 32 byte) read, which gets the nonblocking pool
+ * initialized far sooner on boot.
+ */
+#define RNG_FILLBUF_SIZE	512
 
 
 static struct hwrng *current_rng;
@@ -213,8 +220,21 @@ static inline int rng_get_data(struct hwrng *rng, u8 *buffer, size_t size,
 	else
 		present = 1;
 
-	if (present)
-		return rng->data_read(rng, (u32 *)buffer);
+	if (present) {
+		u32 data;
+		int bytes;
+
+		/*
+		 * data_read() stores a whole u32, but khwrngd fills its
+		 * buffer at any offset and may have less than that left.
+		 */
+		bytes = rng->data_read(rng, &data);
+		if (bytes > 0) {
+			bytes = min_t(size_t, bytes, size);
+			memcpy(buffer, &data, bytes);
+		}
+		return bytes;
+	}
 
 	return 0;
 }
@@ -404,23 +424,30 @@ static int hwrng_fillfn(void *unused)
 
 	while (!kthread_should_stop()) {
 		struct hwrng *rng;
+		size_t len = 0;
 
 		rng = get_current_rng();
 		if (IS_ERR(rng) || !rng)
 			break;
-		mutex_lock(&reading_mutex);
-		rc = rng_get_data(rng, rng_fillbuf,
-				  rng_buffer_size(), 1);
-		mutex_unlock(&reading_mutex);
+		/* drop the lock between reads, /dev/hwrng readers may wait */
+		while (len < RNG_FILLBUF_SIZE && !kthread_should_stop()) {
+			mutex_lock(&reading_mutex);
+			rc = rng_get_data(rng, rng_fillbuf + len,
+					  RNG_FILLBUF_SIZE - len, 1);
+			mutex_unlock(&reading_mutex);
+			if (rc <= 0)
+				break;
+			len += rc;
+		}
 		put_rng(rng);
-		if (rc <= 0) {
+		if (!len) {
 			pr_warn("hwrng: no data available\n");
 			msleep_interruptible(10000);
 			continue;
 		}
 		/* Outside lock, sure, but y'know: randomness. */
-		add_hwgenerator_randomness((void *)rng_fillbuf, rc,
-					   rc * current_quality * 8 >> 10);
+		add_hwgenerator_randomness((void *)rng_fillbuf, len,
+					   len * current_quality * 8 >> 10);
 	}
 	hwrng_fill = NULL;
 	return 0;
@@ -454,7 +481,7 @@ int hwrng_register(struct hwrng *rng)
 			goto out_unlock;
 	}
 	if (!rng_fillbuf) {
-		rng_fillbuf = kmalloc(rng_buffer_size(), GFP_KERNEL);
+		rng_fillbuf = kmalloc(RNG_FILLBUF_SIZE, GFP_KERNEL);
 		if (!rng_fillbuf) {
 			kfree(rng_buffer);
 			goto out_unlock;
@@ -261,6 +261,8 @@
 #include <linux/syscalls.h>
 #include <linux/completion.h>
 
+#include <crypto/chacha20.h>
+
 #include <asm/processor.h>
 #include <asm/uaccess.h>
 #include <asm/irq.h>
@@ -475,6 +477,27 @@ static struct entropy_store nonblocking_pool = {
 					push_to_pool),
 };
 
+/*
+ * Once the nonblocking pool is initialized, get_random_bytes() and
+ * /dev/urandom are served by a ChaCha20 generator on each CPU, keyed
+ * from the nonblocking pool (and thus ultimately the input pool). The
+ * generators are only ever touched by their own CPU with interrupts
+ * off, so readers on different CPUs never share a lock or a cacheline.
+ * Each one is rekeyed every CRNG_RESEED_INTERVAL, and whenever
+ * crng_generation is bumped.
+ */
+#define CRNG_RESEED_INTERVAL	(300 * HZ)
+#define CRNG_BATCH_SIZE		(4 * CHACHA20_BLOCK_SIZE)
+
+struct crng_state {
+	__u32		state[16];
+	unsigned long	init_time;
+	unsigned int	generation;
+};
+
+static DEFINE_PER_CPU(struct crng_state, crng_cpu_state);
+static atomic_t crng_generation = ATOMIC_INIT(1);
+
 static __u32 const twist_table[8] = {
 	0x00000000, 0x3b6e20c8, 0x76dc4190, 0x4db26158,
 	0xedb88320, 0xd6d6a3e8, 0x9b64c2b0, 0xa00ae278 };
@@ -678,6 +701,7 @@ retry:
 		r->initialized = 1;
 		r->entropy_total = 0;
 		if (r == &nonblocking_pool) {
+			atomic_inc(&crng_generation);
 			prandom_reseed_late();
 			process_random_ready_list();
 			wake_up_all(&urandom_init_wait);
@@ -1243,6 +1267,143 @@ static ssize_t extract_entropy_user(struct entropy_store *r, void __user *buf,
 	return ret;
 }
 
+static bool crng_ready(void)
+{
+	return nonblocking_pool.initialized && !fips_enabled;
+}
+
+static void crng_reseed(struct crng_state *crng, const __u32 *seed,
+			unsigned int generation)
+{
+	static const char constant[16] = "expand 32-byte k";
+	int i;
+
+	/* the old key is kept mixed in, the counter starts from the seed */
+	for (i = 0; i < 4; i++)
+		crng->state[i] = le32_to_cpup((const __le32 *)constant + i);
+	for (i = 4; i < 16; i++)
+		crng->state[i] ^= seed[i - 4];
+	crng->init_time = jiffies;
+	crng->generation = generation;
+}
+
+/*
+ * Return this CPU's generator with interrupts disabled, rekeying it
+ * first if it is due. The pool is read with interrupts enabled if they
+ * were on, and the generator of whichever CPU we end up on is rekeyed.
+ */
+static struct crng_state *crng_get(unsigned long *flags)
+{
+	struct crng_state *crng;
+	__u32 seed[12];
+	unsigned int generation;
+	unsigned long v;
+	int i;
+
+	local_irq_save(*flags);
+	crng = this_cpu_ptr(&crng_cpu_state);
+	generation = atomic_read(&crng_generation);
+	if (likely(crng->generation == generation &&
+		   time_before(jiffies, crng->init_time + CRNG_RESEED_INTERVAL)))
+		return crng;
+	local_irq_restore(*flags);
+
+	extract_entropy(&nonblocking_pool, seed, sizeof(seed), 0, 0);
+	for (i = 0; i < ARRAY_SIZE(seed); i++) {
+		if (!arch_get_random_long(&v))
+			break;
+		seed[i] ^= v;
+	}
+
+	local_irq_save(*flags);
+	crng = this_cpu_ptr(&crng_cpu_state);
+	crng_reseed(crng, seed, generation);
+	memzero_explicit(seed, sizeof(seed));
+
+	return crng;
+}
+
+/*
+ * Fill buf with up to CRNG_BATCH_SIZE bytes from this CPU's generator,
+ * bounding the time spent with interrupts off. Afterwards the key is
+ * replaced by fresh output, so that the bytes just handed out cannot
+ * be recomputed from the generator state later on.
+ */
+static void crng_fill(__u8 *buf, int nbytes)
+{
+	__u32 tmp[CHACHA20_BLOCK_SIZE / sizeof(__u32)];
+	struct crng_state *crng;
+	unsigned long flags;
+	int i;
+
+	crng = crng_get(&flags);
+
+	while (nbytes > 0) {
+		chacha20_block(crng->state, tmp);
+		if (crng->state[12] == 0)
+			crng->state[13]++;
+		i = min_t(int, nbytes, CHACHA20_BLOCK_SIZE);
+		memcpy(buf, tmp, i);
+		nbytes -= i;
+		buf += i;
+	}
+
+	chacha20_block(crng->state, tmp);
+	if (crng->state[12] == 0)
+		crng->state[13]++;
+	for (i = 0; i < 8; i++)
+		crng->state[i + 4] ^= tmp[i];
+
+	local_irq_restore(flags);
+
+	memzero_explicit(tmp, sizeof(tmp));
+}
+
+static void crng_get_bytes(void *buf, int nbytes)
+{
+	while (nbytes > 0) {
+		int i = min_t(int, nbytes, CRNG_BATCH_SIZE);
+
+		crng_fill(buf, i);
+		nbytes -= i;
+		buf += i;
+	}
+}
+
+static ssize_t crng_get_bytes_user(void __user *buf, size_t nbytes)
+{
+	ssize_t ret = 0, i;
+	__u8 tmp[CRNG_BATCH_SIZE];
+	int large_request = (nbytes > 256);
+
+	while (nbytes) {
+		if (large_request && need_resched()) {
+			if (signal_pending(current)) {
+				if (ret == 0)
+					ret = -ERESTARTSYS;
+				break;
+			}
+			schedule();
+		}
+
+		i = min_t(size_t, nbytes, CRNG_BATCH_SIZE);
+		crng_fill(tmp, i);
+		if (copy_to_user(buf, tmp, i)) {
+			ret = -EFAULT;
+			break;
+		}
+
+		nbytes -= i;
+		buf += i;
+		ret += i;
+	}
+
+	/* Wipe data just returned from memory */
+	memzero_explicit(tmp, sizeof(tmp));
+
+	return ret;
+}
+
 /*
  * This function is the exported kernel interface.  It returns some
  * number of good random numbers, suitable for key generation, seeding
@@ -1260,7 +1421,10 @@ void get_random_bytes(void *buf, int nbytes)
 		       nonblocking_pool.entropy_total);
 #endif
 	trace_get_random_bytes(nbytes, _RET_IP_);
-	extract_entropy(&nonblocking_pool, buf, nbytes, 0, 0);
+	if (crng_ready())
+		crng_get_bytes(buf, nbytes);
+	else
+		extract_entropy(&nonblocking_pool, buf, nbytes, 0, 0);
 }
 EXPORT_SYMBOL(get_random_bytes);
 
@@ -1465,7 +1629,10 @@ urandom_read(struct file *file, char __user *buf, size_t nbytes, loff_t *ppos)
 			    current->comm, nonblocking_pool.entropy_total);
 
 	nbytes = min_t(size_t, nbytes, INT_MAX >> (ENTROPY_SHIFT + 3));
-	ret = extract_entropy_user(&nonblocking_pool, buf, nbytes);
+	if (crng_ready())
+		ret = crng_get_bytes_user(buf, nbytes);
+	else
+		ret = extract_entropy_user(&nonblocking_pool, buf, nbytes);
 
 	trace_urandom_read(8 * nbytes, ENTROPY_BITS(&nonblocking_pool),
 			   ENTROPY_BITS(&input_pool));
@@ -1029,6 +1029,18 @@ static unsigned long clk_core_get_rate(struct clk_core *core)
 {
 	unsigned long rate;
 
+	/*
+	 * The cached rate can be read without prepare_lock: the caller could
+	 * not rely on it staying valid after the lock is dropped anyway, and
+	 * it is written as a whole word.
+	 */
+	if (core && !(core->flags & CLK_GET_RATE_NOCACHE)) {
+		rate = READ_ONCE(core->rate);
+		if (!(core->flags & CLK_IS_ROOT) && !READ_ONCE(core->parent))
+			rate = 0;
+		return rate;
+	}
+
 	clk_prepare_lock();
 
 	if (core && (core->flags & CLK_GET_RATE_NOCACHE))
@@ -1564,6 +1576,60 @@ int clk_set_rate(struct clk *clk, unsigned long rate)
 }
 EXPORT_SYMBOL_GPL(clk_set_rate);
 
+/**
+ * clk_set_rates - change the rates of several clks as one transaction
+ * @clks: the clks whose rates are being changed
+ * @rates: the new rates, one per clk
+ * @num: number of clks
+ *
+ * Works like calling clk_set_rate() on each clk in turn, but takes the
+ * clock tree lock only once, so that no other rate change or topology
+ * update is seen half way through, and if one rate change fails, the ones
+ * done before it are reverted to the rates previously requested.  Useful
+ * for DVFS of several clock domains together.
+ *
+ * Returns 0 on success, -EERROR otherwise.
+ */
+int clk_set_rates(struct clk **clks, const unsigned long *rates, int num)
+{
+	unsigned long *old;
+	int i, ret = 0;
+
+	if (num <= 0)
+		return 0;
+
+	old = kcalloc(num, sizeof(*old), GFP_KERNEL);
+	if (!old)
+		return -ENOMEM;
+
+	clk_prepare_lock();
+
+	for (i = 0; i < num; i++) {
+		if (!clks[i])
+			continue;
+
+		old[i] = clks[i]->core->req_rate;
+		ret = clk_core_set_rate_nolock(clks[i]->core, rates[i]);
+		if (ret)
+			break;
+	}
+
+	if (ret) {
+		pr_debug("%s: failed to set %s rate, reverting\n", __func__,
+			 clks[i]->core->name);
+		while (--i >= 0)
+			if (clks[i])
+				clk_core_set_rate_nolock(clks[i]->core, old[i]);
+	}
+
+	clk_prepare_unlock();
+
+	kfree(old);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(clk_set_rates);
+
 /**
  * clk_set_rate_range - set a rate range for a clock source
  * @clk: clock source
@@ -102,6 +102,38 @@ static const struct clk_ops rockchip_cpuclk_ops = {
 	.recalc_rate = rockchip_cpuclk_recalc_rate,
 };
 
+/*
+ * Dividers living in the core register, without touching the core divider
+ * or mux, are folded into the write re-muxing the core clock. They then
+ * switch together with the parent instead of in separate steps.
+ */
+static bool rockchip_cpuclk_div_in_core(struct rockchip_cpuclk *cpuclk,
+				const struct rockchip_cpuclk_clksel *clksel)
+{
+	const struct rockchip_cpuclk_reg_data *reg_data = cpuclk->reg_data;
+	u32 core_mask = (reg_data->div_core_mask << reg_data->div_core_shift) |
+			BIT(reg_data->mux_core_shift);
+
+	return clksel->reg == reg_data->core_reg &&
+	       !((clksel->val >> 16) & core_mask);
+}
+
+static u32 rockchip_cpuclk_core_dividers(struct rockchip_cpuclk *cpuclk,
+				const struct rockchip_cpuclk_rate_table *rate)
+{
+	u32 val = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(rate->divs); i++) {
+		const struct rockchip_cpuclk_clksel *clksel = &rate->divs[i];
+
+		if (clksel->reg && rockchip_cpuclk_div_in_core(cpuclk, clksel))
+			val |= clksel->val;
+	}
+
+	return val;
+}
+
 static void rockchip_cpuclk_set_dividers(struct rockchip_cpuclk *cpuclk,
 				const struct rockchip_cpuclk_rate_table *rate)
 {
@@ -111,7 +143,7 @@ static void rockchip_cpuclk_set_dividers(struct rockchip_cpuclk *cpuclk,
 	for (i = 0; i < ARRAY_SIZE(rate->divs); i++) {
 		const struct rockchip_cpuclk_clksel *clksel = &rate->divs[i];
 
-		if (!clksel->reg)
+		if (!clksel->reg || rockchip_cpuclk_div_in_core(cpuclk, clksel))
 			continue;
 
 		pr_debug("%s: setting reg 0x%x to 0x%x\n",
@@ -194,11 +226,13 @@ static int rockchip_cpuclk_post_rate_change(struct rockchip_cpuclk *cpuclk,
 	 *
 	 * NOTE: we do this in a single transaction so we're never dividing the
 	 * primary parent by the extra dividers that were needed for the alt.
+	 * The new rate's dividers from the same register go along with it.
 	 */
 
 	writel(HIWORD_UPDATE(0, reg_data->div_core_mask,
 				reg_data->div_core_shift) |
-	       HIWORD_UPDATE(0, 1, reg_data->mux_core_shift),
+	       HIWORD_UPDATE(0, 1, reg_data->mux_core_shift) |
+	       rockchip_cpuclk_core_dividers(cpuclk, rate),
 	       cpuclk->reg_base + reg_data->core_reg);
 
 	if (ndata->old_rate > ndata->new_rate)
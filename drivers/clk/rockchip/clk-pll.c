@@ -41,6 +41,9 @@ struct rockchip_clk_pll {
 	u8			flags;
 	const struct rockchip_pll_rate_table *rate_table;
 	unsigned int		rate_count;
+	/* settings last calculated for a rate missing from rate_table */
+	struct rockchip_pll_rate_table calc_rate;
+	unsigned long		calc_prate;
 	spinlock_t		*lock;
 };
 
@@ -62,6 +65,10 @@ static const struct rockchip_pll_rate_table *rockchip_get_pll_settings(
 	return NULL;
 }
 
+static const struct rockchip_pll_rate_table *rockchip_rk3066_pll_calc_settings(
+		struct rockchip_clk_pll *pll, unsigned long prate,
+		unsigned long drate);
+
 static long rockchip_pll_round_rate(struct clk_hw *hw,
 			    unsigned long drate, unsigned long *prate)
 {
@@ -69,6 +76,10 @@ static long rockchip_pll_round_rate(struct clk_hw *hw,
 	const struct rockchip_pll_rate_table *rate_table = pll->rate_table;
 	int i;
 
+	if (rockchip_get_pll_settings(pll, drate) ||
+	    rockchip_rk3066_pll_calc_settings(pll, *prate, drate))
+		return drate;
+
 	/* Assumming rate_table is in descending order */
 	for (i = 0; i < pll->rate_count; i++) {
 		if (drate >= rate_table[i].rate)
@@ -126,6 +137,63 @@ static int rockchip_pll_wait_lock(struct rockchip_clk_pll *pll)
 #define RK3066_PLLCON3_PWRDOWN		(1 << 1)
 #define RK3066_PLLCON3_BYPASS		(1 << 0)
 
+#define RK3066_PLL_NR_MAX		64
+#define RK3066_PLL_NF_MAX		4096
+#define RK3066_PLL_NO_MAX		16
+#define RK3066_PLL_FREF_MIN		269000UL
+#define RK3066_PLL_FVCO_MIN		440000000ULL
+#define RK3066_PLL_FVCO_MAX		2200000000ULL
+
+/*
+ * Find exact nr/nf/no settings for a rate missing from the rate table.
+ * The largest usable output divider is tried first, as a faster vco
+ * gives less jitter. The result is kept, so repeatedly switching to the
+ * same rate, like cpufreq does, only searches once.
+ */
+static const struct rockchip_pll_rate_table *rockchip_rk3066_pll_calc_settings(
+		struct rockchip_clk_pll *pll, unsigned long prate,
+		unsigned long drate)
+{
+	struct rockchip_pll_rate_table *rate = &pll->calc_rate;
+	unsigned int nr, no;
+	u64 fvco, nf;
+
+	if (!prate || !drate)
+		return NULL;
+
+	if (rate->rate == drate && pll->calc_prate == prate)
+		return rate;
+
+	/* output dividers are 1 or even */
+	for (no = RK3066_PLL_NO_MAX; no > 0; no -= (no > 2) ? 2 : 1) {
+		fvco = (u64)drate * no;
+		if (fvco < RK3066_PLL_FVCO_MIN || fvco > RK3066_PLL_FVCO_MAX)
+			continue;
+
+		for (nr = 1; nr <= RK3066_PLL_NR_MAX; nr++) {
+			if (prate / nr < RK3066_PLL_FREF_MIN)
+				break;
+
+			nf = fvco * nr;
+			if (do_div(nf, prate))
+				continue;
+			if (nf > RK3066_PLL_NF_MAX)
+				break;
+
+			rate->rate = drate;
+			rate->nr = nr;
+			rate->nf = nf;
+			rate->no = no;
+			rate->nb = (nf < 2) ? 1 : nf >> 1;
+			pll->calc_prate = prate;
+
+			return rate;
+		}
+	}
+
+	return NULL;
+}
+
 static unsigned long rockchip_rk3066_pll_recalc_rate(struct clk_hw *hw,
 						     unsigned long prate)
 {
@@ -176,8 +244,10 @@ static int rockchip_rk3066_pll_set_rate(struct clk_hw *hw, unsigned long drate,
 	pr_debug("%s: changing %s from %lu to %lu with a parent rate of %lu\n",
 		 __func__, clk_hw_get_name(hw), old_rate, drate, prate);
 
-	/* Get required rate settings from table */
+	/* Get required rate settings from table, or calculate them */
 	rate = rockchip_get_pll_settings(pll, drate);
+	if (!rate)
+		rate = rockchip_rk3066_pll_calc_settings(pll, prate, drate);
 	if (!rate) {
 		pr_err("%s: Invalid rate : %lu for pll clk %s\n", __func__,
 			drate, clk_hw_get_name(hw));
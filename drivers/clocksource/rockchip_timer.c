@@ -73,12 +73,23 @@ static void rk_timer_interrupt_clear(struct clock_event_device *ce)
 	dsb();
 }
 
+/*
+ * This runs on every wakeup programmed through the broadcast device. The
+ * writes all go to the same device and stay ordered, so a single barrier
+ * at the end is enough.
+ */
 static inline int rk_timer_set_next_event(unsigned long cycles,
 					  struct clock_event_device *ce)
 {
-	rk_timer_disable(ce);
-	rk_timer_update_counter(cycles, ce);
-	rk_timer_enable(ce, TIMER_MODE_USER_DEFINED_COUNT);
+	void __iomem *base = rk_base(ce);
+
+	writel_relaxed(TIMER_DISABLE, base + TIMER_CONTROL_REG);
+	writel_relaxed(cycles, base + TIMER_LOAD_COUNT0);
+	writel_relaxed(0, base + TIMER_LOAD_COUNT1);
+	writel_relaxed(TIMER_ENABLE | TIMER_INT_UNMASK |
+		       TIMER_MODE_USER_DEFINED_COUNT,
+		       base + TIMER_CONTROL_REG);
+	dsb();
 	return 0;
 }
 
@@ -153,13 +164,20 @@ static void __init rk_timer_init(struct device_node *np)
 		return;
 	}
 
+	/*
+	 * The arch timers stop in deep idle, so this mostly serves as the
+	 * broadcast device. With DYNIRQ the broadcast code steers the
+	 * interrupt to the CPU whose event expires first, which then wakes
+	 * up directly instead of CPU0 waking it with an IPI.
+	 */
 	ce->name = TIMER_NAME;
-	ce->features = CLOCK_EVT_FEAT_PERIODIC | CLOCK_EVT_FEAT_ONESHOT;
+	ce->features = CLOCK_EVT_FEAT_PERIODIC | CLOCK_EVT_FEAT_ONESHOT |
+		       CLOCK_EVT_FEAT_DYNIRQ;
 	ce->set_next_event = rk_timer_set_next_event;
 	ce->set_state_shutdown = rk_timer_shutdown;
 	ce->set_state_periodic = rk_timer_set_periodic;
 	ce->irq = irq;
-	ce->cpumask = cpumask_of(0);
+	ce->cpumask = cpu_possible_mask;
 	ce->rating = 250;
 
 	rk_timer_interrupt_clear(ce);
@@ -0,0 +1,437 @@
+/*
+ *  linux/drivers/cpufreq/cpufreq_schedutil.c
+ *
+ *  CPUFreq governor based on scheduler-provided CPU utilization data.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/cpufreq.h>
+#include <linux/init.h>
+#include <linux/irq_work.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+/* Lower bound of the default rate limit, see sugov_init() */
+#define SUGOV_MIN_RATE_LIMIT_US		1000
+
+struct sugov_policy {
+	struct cpufreq_policy *policy;
+
+	raw_spinlock_t update_lock;	/* For shared policies */
+	u64 last_freq_update_time;
+	s64 freq_update_delay_ns;
+	unsigned int rate_limit_us;
+	unsigned int next_freq;
+
+	/* Frequency changes are carried out from this kthread */
+	struct irq_work irq_work;
+	struct kthread_work work;
+	struct mutex work_lock;
+	struct kthread_worker worker;
+	struct task_struct *thread;
+	bool work_in_progress;
+};
+
+struct sugov_cpu {
+	struct update_util_data update_util;
+	struct sugov_policy *sg_policy;
+
+	/* The fields below are only needed when sharing a policy */
+	unsigned long util;
+	unsigned long max;
+	u64 last_update;
+};
+
+static DEFINE_PER_CPU(struct sugov_cpu, sugov_cpu);
+
+/************************ Governor internals ***********************/
+
+static bool sugov_should_update_freq(struct sugov_policy *sg_policy, u64 time)
+{
+	s64 delta_ns;
+
+	if (sg_policy->work_in_progress)
+		return false;
+
+	delta_ns = time - sg_policy->last_freq_update_time;
+	return delta_ns >= sg_policy->freq_update_delay_ns;
+}
+
+/*
+ * update_curr_rt() asks for the maximum frequency while an RT task runs,
+ * and that includes our own SCHED_FIFO worker when it ticks or goes to
+ * sleep after a frequency change. Acting on that would undo every
+ * decrease as soon as it is done, so ignore it.
+ */
+static bool sugov_own_rt_kick(struct sugov_policy *sg_policy,
+			      unsigned long util)
+{
+	return util == ULONG_MAX && current == sg_policy->thread;
+}
+
+static void sugov_update_commit(struct sugov_policy *sg_policy, u64 time,
+				unsigned int next_freq)
+{
+	sg_policy->last_freq_update_time = time;
+
+	if (sg_policy->next_freq == next_freq)
+		return;
+
+	sg_policy->next_freq = next_freq;
+	sg_policy->work_in_progress = true;
+	irq_work_queue(&sg_policy->irq_work);
+}
+
+/**
+ * get_next_freq - Compute a new frequency for a given cpufreq policy.
+ * @policy: cpufreq policy object to compute the new frequency for.
+ * @util: Current CPU utilization.
+ * @max: CPU capacity.
+ *
+ * The utilization is not frequency invariant, so it is relative to the
+ * current frequency: next_freq = 1.25 * cur_freq * util / max. The 1.25
+ * factor leaves headroom, so that a CPU running at 80% of its current
+ * capacity is moved up and a busy CPU ramps up to the maximum quickly.
+ */
+static unsigned int get_next_freq(struct cpufreq_policy *policy,
+				  unsigned long util, unsigned long max)
+{
+	unsigned int freq = policy->cur;
+
+	return (freq + (freq >> 2)) * util / max;
+}
+
+static void sugov_update_single(struct update_util_data *hook, u64 time,
+				unsigned long util, unsigned long max)
+{
+	struct sugov_cpu *sg_cpu = container_of(hook, struct sugov_cpu,
+						update_util);
+	struct sugov_policy *sg_policy = sg_cpu->sg_policy;
+	struct cpufreq_policy *policy = sg_policy->policy;
+	unsigned int next_f;
+
+	if (sugov_own_rt_kick(sg_policy, util) ||
+	    !sugov_should_update_freq(sg_policy, time))
+		return;
+
+	next_f = util == ULONG_MAX ? policy->cpuinfo.max_freq :
+			get_next_freq(policy, util, max);
+	sugov_update_commit(sg_policy, time, next_f);
+}
+
+static unsigned int sugov_next_freq_shared(struct sugov_policy *sg_policy,
+					   unsigned long util,
+					   unsigned long max)
+{
+	struct cpufreq_policy *policy = sg_policy->policy;
+	unsigned int max_f = policy->cpuinfo.max_freq;
+	u64 last_freq_update_time = sg_policy->last_freq_update_time;
+	unsigned int j;
+
+	if (util == ULONG_MAX)
+		return max_f;
+
+	for_each_cpu(j, policy->cpus) {
+		struct sugov_cpu *j_sg_cpu;
+		unsigned long j_util, j_max;
+		s64 delta_ns;
+
+		if (j == smp_processor_id())
+			continue;
+
+		j_sg_cpu = &per_cpu(sugov_cpu, j);
+		/*
+		 * If the CPU utilization was last updated before the previous
+		 * frequency update and the time elapsed between the last update
+		 * of the CPU utilization and the last frequency update is long
+		 * enough, don't take the CPU into account as it probably is
+		 * idle now.
+		 */
+		delta_ns = last_freq_update_time - j_sg_cpu->last_update;
+		if (delta_ns > TICK_NSEC)
+			continue;
+
+		j_util = j_sg_cpu->util;
+		if (j_util == ULONG_MAX)
+			return max_f;
+
+		j_max = j_sg_cpu->max;
+		if (j_util * max > j_max * util) {
+			util = j_util;
+			max = j_max;
+		}
+	}
+
+	return get_next_freq(policy, util, max);
+}
+
+static void sugov_update_shared(struct update_util_data *hook, u64 time,
+				unsigned long util, unsigned long max)
+{
+	struct sugov_cpu *sg_cpu = container_of(hook, struct sugov_cpu,
+						update_util);
+	struct sugov_policy *sg_policy = sg_cpu->sg_policy;
+	unsigned int next_f;
+
+	if (sugov_own_rt_kick(sg_policy, util))
+		return;
+
+	raw_spin_lock(&sg_policy->update_lock);
+
+	sg_cpu->util = util;
+	sg_cpu->max = max;
+	sg_cpu->last_update = time;
+
+	if (sugov_should_update_freq(sg_policy, time)) {
+		next_f = sugov_next_freq_shared(sg_policy, util, max);
+		sugov_update_commit(sg_policy, time, next_f);
+	}
+
+	raw_spin_unlock(&sg_policy->update_lock);
+}
+
+static void sugov_work(struct kthread_work *work)
+{
+	struct sugov_policy *sg_policy = container_of(work, struct sugov_policy,
+						      work);
+
+	mutex_lock(&sg_policy->work_lock);
+	__cpufreq_driver_target(sg_policy->policy, sg_policy->next_freq,
+				CPUFREQ_RELATION_L);
+	mutex_unlock(&sg_policy->work_lock);
+
+	sg_policy->work_in_progress = false;
+}
+
+static void sugov_irq_work(struct irq_work *irq_work)
+{
+	struct sugov_policy *sg_policy = container_of(irq_work,
+						      struct sugov_policy,
+						      irq_work);
+
+	queue_kthread_work(&sg_policy->worker, &sg_policy->work);
+}
+
+/************************** sysfs interface ************************/
+
+static ssize_t show_rate_limit_us(struct cpufreq_policy *policy, char *buf)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+
+	return sprintf(buf, "%u\n", sg_policy->rate_limit_us);
+}
+
+static ssize_t store_rate_limit_us(struct cpufreq_policy *policy,
+				   const char *buf, size_t count)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+	unsigned int rate_limit_us;
+
+	if (kstrtouint(buf, 10, &rate_limit_us))
+		return -EINVAL;
+
+	sg_policy->rate_limit_us = rate_limit_us;
+	sg_policy->freq_update_delay_ns = rate_limit_us * NSEC_PER_USEC;
+
+	return count;
+}
+
+static struct freq_attr rate_limit_us =
+	__ATTR(rate_limit_us, 0644, show_rate_limit_us, store_rate_limit_us);
+
+static struct attribute *sugov_attributes[] = {
+	&rate_limit_us.attr,
+	NULL
+};
+
+static struct attribute_group sugov_attr_group = {
+	.attrs = sugov_attributes,
+	.name = "schedutil",
+};
+
+/********************** cpufreq governor interface *********************/
+
+static int sugov_init(struct cpufreq_policy *policy)
+{
+	struct sched_param param = { .sched_priority = MAX_USER_RT_PRIO / 2 };
+	struct sugov_policy *sg_policy;
+	unsigned int lat;
+	int ret;
+
+	if (policy->governor_data)
+		return -EBUSY;
+
+	sg_policy = kzalloc(sizeof(*sg_policy), GFP_KERNEL);
+	if (!sg_policy)
+		return -ENOMEM;
+
+	sg_policy->policy = policy;
+	raw_spin_lock_init(&sg_policy->update_lock);
+	init_irq_work(&sg_policy->irq_work, sugov_irq_work);
+	mutex_init(&sg_policy->work_lock);
+	init_kthread_work(&sg_policy->work, sugov_work);
+	init_kthread_worker(&sg_policy->worker);
+
+	sg_policy->thread = kthread_create(kthread_worker_fn,
+					   &sg_policy->worker, "sugov:%d",
+					   cpumask_first(policy->related_cpus));
+	if (IS_ERR(sg_policy->thread)) {
+		ret = PTR_ERR(sg_policy->thread);
+		pr_err("failed to create sugov thread: %d\n", ret);
+		goto free_sg_policy;
+	}
+
+	ret = sched_setscheduler_nocheck(sg_policy->thread, SCHED_FIFO,
+					 &param);
+	if (ret) {
+		pr_warn("%s: failed to set SCHED_FIFO\n", __func__);
+		goto stop_thread;
+	}
+
+	/* changing the frequency is the business of the policy's CPUs */
+	kthread_bind_mask(sg_policy->thread, policy->related_cpus);
+
+	/*
+	 * Don't ask for a new frequency more often than the hardware can
+	 * switch, but keep the window short enough to follow bursts.
+	 */
+	lat = policy->cpuinfo.transition_latency / NSEC_PER_USEC;
+	sg_policy->rate_limit_us = max_t(unsigned int, lat,
+					 SUGOV_MIN_RATE_LIMIT_US);
+
+	policy->governor_data = sg_policy;
+
+	ret = sysfs_create_group(&policy->kobj, &sugov_attr_group);
+	if (ret)
+		goto clear_data;
+
+	wake_up_process(sg_policy->thread);
+	return 0;
+
+clear_data:
+	policy->governor_data = NULL;
+stop_thread:
+	kthread_stop(sg_policy->thread);
+free_sg_policy:
+	kfree(sg_policy);
+	return ret;
+}
+
+static void sugov_exit(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+
+	sysfs_remove_group(&policy->kobj, &sugov_attr_group);
+	policy->governor_data = NULL;
+
+	flush_kthread_worker(&sg_policy->worker);
+	kthread_stop(sg_policy->thread);
+	mutex_destroy(&sg_policy->work_lock);
+	kfree(sg_policy);
+}
+
+static int sugov_start(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+	unsigned int cpu;
+
+	sg_policy->freq_update_delay_ns = sg_policy->rate_limit_us *
+					  NSEC_PER_USEC;
+	sg_policy->last_freq_update_time = 0;
+	sg_policy->next_freq = UINT_MAX;
+	sg_policy->work_in_progress = false;
+
+	for_each_cpu(cpu, policy->cpus) {
+		struct sugov_cpu *sg_cpu = &per_cpu(sugov_cpu, cpu);
+
+		sg_cpu->sg_policy = sg_policy;
+		if (policy_is_shared(policy)) {
+			sg_cpu->util = 0;
+			sg_cpu->max = 0;
+			sg_cpu->last_update = 0;
+			sg_cpu->update_util.func = sugov_update_shared;
+		} else {
+			sg_cpu->update_util.func = sugov_update_single;
+		}
+		cpufreq_set_update_util_data(cpu, &sg_cpu->update_util);
+	}
+
+	return 0;
+}
+
+static void sugov_stop(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+	unsigned int cpu;
+
+	for_each_cpu(cpu, policy->cpus)
+		cpufreq_set_update_util_data(cpu, NULL);
+
+	synchronize_sched();
+
+	irq_work_sync(&sg_policy->irq_work);
+	flush_kthread_work(&sg_policy->work);
+}
+
+static void sugov_limits(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+
+	mutex_lock(&sg_policy->work_lock);
+
+	if (policy->max < policy->cur)
+		__cpufreq_driver_target(policy, policy->max,
+					CPUFREQ_RELATION_H);
+	else if (policy->min > policy->cur)
+		__cpufreq_driver_target(policy, policy->min,
+					CPUFREQ_RELATION_L);
+
+	mutex_unlock(&sg_policy->work_lock);
+}
+
+static int cpufreq_governor_schedutil(struct cpufreq_policy *policy,
+				      unsigned int event)
+{
+	switch (event) {
+	case CPUFREQ_GOV_POLICY_INIT:
+		return sugov_init(policy);
+	case CPUFREQ_GOV_POLICY_EXIT:
+		sugov_exit(policy);
+		break;
+	case CPUFREQ_GOV_START:
+		return sugov_start(policy);
+	case CPUFREQ_GOV_STOP:
+		sugov_stop(policy);
+		break;
+	case CPUFREQ_GOV_LIMITS:
+		sugov_limits(policy);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static struct cpufreq_governor cpufreq_gov_schedutil = {
+	.name		= "schedutil",
+	.governor	= cpufreq_governor_schedutil,
+	.owner		= THIS_MODULE,
+};
+
+static int __init cpufreq_gov_schedutil_init(void)
+{
+	return cpufreq_register_governor(&cpufreq_gov_schedutil);
+}
+
+MODULE_DESCRIPTION("CPUfreq policy governor 'schedutil'");
+MODULE_LICENSE("GPL");
+
+fs_initcall(cpufreq_gov_schedutil_init);
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2015 Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * Coupled cpuidle support based on the exynos driver.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/cpuidle.h>
+#include <linux/cpu_pm.h>
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/platform_data/cpuidle-rockchip.h>
+
+#include <asm/cpuidle.h>
+
+static atomic_t rockchip_idle_barrier;
+
+static struct cpuidle_rockchip_data *rockchip_cpuidle_pdata;
+
+static int rockchip_enter_coupled_powerdown(struct cpuidle_device *dev,
+					    struct cpuidle_driver *drv,
+					    int index)
+{
+	int ret;
+
+	cpu_pm_enter();
+
+	/*
+	 * Waiting all cpus to reach this point at the same moment
+	 */
+	cpuidle_coupled_parallel_barrier(dev, &rockchip_idle_barrier);
+
+	/*
+	 * The secondary cores flush their caches and wait in wfi to be
+	 * powered down by cpu0, which also brings them back on wakeup.
+	 */
+	ret = dev->cpu ? rockchip_cpuidle_pdata->cpu_powerdown()
+		       : rockchip_cpuidle_pdata->cpu0_enter_idle();
+	if (ret)
+		index = drv->safe_state_index;
+
+	/*
+	 * Waiting all cpus to finish the power sequence before going further
+	 */
+	cpuidle_coupled_parallel_barrier(dev, &rockchip_idle_barrier);
+
+	/* all cpus are out of the power sequence, reset it for the next time */
+	if (!dev->cpu)
+		rockchip_cpuidle_pdata->cpu0_exit_idle();
+
+	cpu_pm_exit();
+
+	return index;
+}
+
+static struct cpuidle_driver rockchip_coupled_idle_driver = {
+	.name			= "rockchip_coupled_idle",
+	.owner			= THIS_MODULE,
+	.states = {
+		[0] = ARM_CPUIDLE_WFI_STATE,
+		[1] = {
+			.enter			= rockchip_enter_coupled_powerdown,
+			.exit_latency		= 2000,
+			.target_residency	= 10000,
+			.flags			= CPUIDLE_FLAG_COUPLED |
+						  CPUIDLE_FLAG_TIMER_STOP,
+			.name			= "C1",
+			.desc			= "ARM core power down",
+		},
+	},
+	.state_count = 2,
+	.safe_state_index = 0,
+};
+
+static int rockchip_cpuidle_probe(struct platform_device *pdev)
+{
+	int ret;
+
+	rockchip_cpuidle_pdata = pdev->dev.platform_data;
+	if (!rockchip_cpuidle_pdata) {
+		dev_err(&pdev->dev, "missing platform data\n");
+		return -EINVAL;
+	}
+
+	ret = cpuidle_register(&rockchip_coupled_idle_driver,
+			       cpu_possible_mask);
+	if (ret) {
+		dev_err(&pdev->dev, "failed to register cpuidle driver\n");
+		return ret;
+	}
+
+	return 0;
+}
+
+static struct platform_driver rockchip_cpuidle_driver = {
+	.probe	= rockchip_cpuidle_probe,
+	.driver = {
+		.name = "rockchip_cpuidle",
+	},
+};
+
+module_platform_driver(rockchip_cpuidle_driver);
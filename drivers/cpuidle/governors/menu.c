@@ -12,6 +12,8 @@
 
 #include <linux/kernel.h>
 #include <linux/cpuidle.h>
+#include <linux/interrupt.h>
+#include <linux/mutex.h>
 #include <linux/pm_qos.h>
 #include <linux/time.h>
 #include <linux/ktime.h>
@@ -36,6 +38,7 @@
 #define RESOLUTION 1024
 #define DECAY 8
 #define MAX_INTERESTING 50000
+#define WAKEUP_HISTORY 8
 
 
 /*
@@ -116,8 +119,25 @@
  * The iowait factor may look low, but realize that this is also already
  * represented in the system load average.
  *
+ * Wakeup source prediction
+ * ------------------------
+ * With the irq_prediction parameter set, the governor also classifies
+ * each wakeup of a CPU as caused by its next timer, by a device interrupt
+ * or by something else (mostly IPIs), and asks the interrupt core when
+ * the periodic interrupts seen on this CPU are next due:
+ * - if the last WAKEUP_HISTORY wakeups were all timer wakeups, the next
+ *   timer is trusted as is, so the CPU goes as deep as that timer allows;
+ * - if a periodic interrupt is due before the predicted wakeup, it is
+ *   taken as the prediction, so that no deep state is picked that the
+ *   interrupt would cut short.
  */
 
+enum menu_wakeup {
+	MENU_WAKEUP_TIMER,
+	MENU_WAKEUP_IRQ,
+	MENU_WAKEUP_OTHER,
+};
+
 struct menu_device {
 	int		last_state_idx;
 	int             needs_update;
@@ -128,8 +148,73 @@ struct menu_device {
 	unsigned int	correction_factor[BUCKETS];
 	unsigned int	intervals[INTERVALS];
 	int		interval_ptr;
+
+	/* Wakeup source tracking, see "Wakeup source prediction" above */
+	u64		idle_entry_ns;
+	unsigned int	wakeup_history;	/* 2 bits per wakeup, latest lowest */
+	unsigned int	wakeup_count;
 };
 
+static bool irq_prediction;
+static DEFINE_MUTEX(irq_prediction_lock);
+
+static int set_irq_prediction(const char *val, const struct kernel_param *kp)
+{
+	bool old;
+	int ret;
+
+	mutex_lock(&irq_prediction_lock);
+	old = irq_prediction;
+	ret = param_set_bool(val, kp);
+	if (!ret && old != irq_prediction) {
+		if (irq_prediction)
+			irq_timings_enable();
+		else
+			irq_timings_disable();
+	}
+	mutex_unlock(&irq_prediction_lock);
+
+	return ret;
+}
+
+static const struct kernel_param_ops irq_prediction_ops = {
+	.set = set_irq_prediction,
+	.get = param_get_bool,
+};
+module_param_cb(irq_prediction, &irq_prediction_ops, &irq_prediction, 0644);
+MODULE_PARM_DESC(irq_prediction,
+		 "Predict wakeups from timer, interrupt and IPI history");
+
+static bool menu_timer_wakeups_only(struct menu_device *data)
+{
+	return data->wakeup_count == WAKEUP_HISTORY &&
+	       data->wakeup_history == MENU_WAKEUP_TIMER;
+}
+
+static void menu_record_wakeup(struct menu_device *data,
+			       unsigned int measured_us, unsigned int exit_us)
+{
+	enum menu_wakeup src;
+	u64 last_irq;
+
+	if (measured_us >= data->next_timer_us - (data->next_timer_us >> 4)) {
+		src = MENU_WAKEUP_TIMER;
+	} else {
+		last_irq = irq_timings_last_event();
+		if (last_irq >= data->idle_entry_ns &&
+		    last_irq - data->idle_entry_ns <=
+		    (u64)(measured_us + exit_us) * NSEC_PER_USEC)
+			src = MENU_WAKEUP_IRQ;
+		else
+			src = MENU_WAKEUP_OTHER;
+	}
+
+	data->wakeup_history = (data->wakeup_history << 2 | src) &
+			       ((1 << (2 * WAKEUP_HISTORY)) - 1);
+	if (data->wakeup_count < WAKEUP_HISTORY)
+		data->wakeup_count++;
+}
+
 
 #define LOAD_INT(x) ((x) >> FSHIFT)
 #define LOAD_FRAC(x) LOAD_INT(((x) & (FIXED_1-1)) * 100)
@@ -317,6 +402,20 @@ static int menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 
 	get_typical_interval(data);
 
+	if (irq_prediction) {
+		u64 irq_next_ns;
+
+		data->idle_entry_ns = local_clock();
+		irq_next_ns = irq_timings_next_event(data->idle_entry_ns);
+
+		if (menu_timer_wakeups_only(data))
+			data->predicted_us = data->next_timer_us;
+
+		if (irq_next_ns < (u64)data->predicted_us * NSEC_PER_USEC)
+			data->predicted_us = div_u64(irq_next_ns,
+						     NSEC_PER_USEC);
+	}
+
 	/*
 	 * Performance multiplier defines a minimum predicted idle
 	 * duration / latency ratio. Adjust the latency limit if
@@ -439,6 +538,9 @@ static void menu_update(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 	data->intervals[data->interval_ptr++] = measured_us;
 	if (data->interval_ptr >= INTERVALS)
 		data->interval_ptr = 0;
+
+	if (irq_prediction)
+		menu_record_wakeup(data, measured_us, target->exit_latency);
 }
 
 /**
@@ -0,0 +1,497 @@
+/*
+ * Crypto acceleration support for Rockchip RK3288
+ *
+ * Core file which registers the algorithms, owns the request queue and
+ * moves request data to and from the engine by DMA.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include "rk3288_crypto.h"
+#include <linux/clk.h>
+#include <linux/dma-mapping.h>
+#include <linux/io.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <linux/reset.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
+
+static int rk_crypto_enable_clk(struct rk_crypto_info *dev)
+{
+	int err;
+
+	err = clk_prepare_enable(dev->sclk);
+	if (err) {
+		dev_err(dev->dev, "[%s:%d], Couldn't enable clock sclk\n",
+			__func__, __LINE__);
+		goto err_return;
+	}
+	err = clk_prepare_enable(dev->aclk);
+	if (err) {
+		dev_err(dev->dev, "[%s:%d], Couldn't enable clock aclk\n",
+			__func__, __LINE__);
+		goto err_aclk;
+	}
+	err = clk_prepare_enable(dev->hclk);
+	if (err) {
+		dev_err(dev->dev, "[%s:%d], Couldn't enable clock hclk\n",
+			__func__, __LINE__);
+		goto err_hclk;
+	}
+	err = clk_prepare_enable(dev->dmaclk);
+	if (err) {
+		dev_err(dev->dev, "[%s:%d], Couldn't enable clock dmaclk\n",
+			__func__, __LINE__);
+		goto err_dmaclk;
+	}
+	return 0;
+
+err_dmaclk:
+	clk_disable_unprepare(dev->hclk);
+err_hclk:
+	clk_disable_unprepare(dev->aclk);
+err_aclk:
+	clk_disable_unprepare(dev->sclk);
+err_return:
+	return err;
+}
+
+static void rk_crypto_disable_clk(struct rk_crypto_info *dev)
+{
+	clk_disable_unprepare(dev->dmaclk);
+	clk_disable_unprepare(dev->hclk);
+	clk_disable_unprepare(dev->aclk);
+	clk_disable_unprepare(dev->sclk);
+}
+
+/*
+ * The engine DMAs words, one scatterlist entry at a time: entries can be
+ * used directly if they are word aligned, hold whole blocks and, for
+ * ciphers, the source and destination entries have the same length.
+ */
+bool rk_crypto_check_alignment(struct scatterlist *sg_src,
+			       struct scatterlist *sg_dst,
+			       unsigned int total, unsigned int align_size)
+{
+	bool cipher = sg_dst;
+	unsigned int len;
+
+	while (total) {
+		if (!sg_src || (cipher && !sg_dst))
+			return false;
+
+		len = min(sg_src->length, total);
+		if (!IS_ALIGNED(sg_src->offset, sizeof(u32)) ||
+		    !IS_ALIGNED(len, align_size))
+			return false;
+
+		if (cipher) {
+			if (!IS_ALIGNED(sg_dst->offset, sizeof(u32)) ||
+			    min(sg_dst->length, total) != len)
+				return false;
+			sg_dst = sg_next(sg_dst);
+		}
+
+		total -= len;
+		sg_src = sg_next(sg_src);
+	}
+
+	return true;
+}
+
+/*
+ * Map the next part of the request for DMA: the current scatterlist
+ * entries if the request is aligned, a page of it copied to the bounce
+ * page otherwise.
+ */
+int rk_crypto_load_data(struct rk_crypto_info *dev)
+{
+	unsigned int offset = dev->total - dev->left_bytes;
+
+	if (dev->aligned) {
+		dev->count = min(dev->left_bytes, dev->sg_src->length);
+
+		if (dev->sg_src == dev->sg_dst) {
+			if (!dma_map_sg(dev->dev, dev->sg_src, 1,
+					DMA_BIDIRECTIONAL))
+				return -ENOMEM;
+			dev->addr_in = sg_dma_address(dev->sg_src);
+			dev->addr_out = dev->addr_in;
+			goto out;
+		}
+
+		if (!dma_map_sg(dev->dev, dev->sg_src, 1, DMA_TO_DEVICE))
+			return -ENOMEM;
+		dev->addr_in = sg_dma_address(dev->sg_src);
+
+		if (dev->sg_dst) {
+			if (!dma_map_sg(dev->dev, dev->sg_dst, 1,
+					DMA_FROM_DEVICE)) {
+				dma_unmap_sg(dev->dev, dev->sg_src, 1,
+					     DMA_TO_DEVICE);
+				return -ENOMEM;
+			}
+			dev->addr_out = sg_dma_address(dev->sg_dst);
+		}
+	} else {
+		dev->count = min_t(unsigned int, dev->left_bytes, PAGE_SIZE);
+
+		if (sg_pcopy_to_buffer(dev->first_src, dev->src_nents,
+				       dev->addr_vir, dev->count,
+				       offset) != dev->count)
+			return -EINVAL;
+
+		sg_init_one(&dev->sg_tmp, dev->addr_vir, dev->count);
+		if (!dma_map_sg(dev->dev, &dev->sg_tmp, 1, DMA_BIDIRECTIONAL))
+			return -ENOMEM;
+		dev->addr_in = sg_dma_address(&dev->sg_tmp);
+		dev->addr_out = dev->addr_in;
+	}
+out:
+	dev->left_bytes -= dev->count;
+	return 0;
+}
+
+void rk_crypto_unload_data(struct rk_crypto_info *dev)
+{
+	if (!dev->aligned) {
+		dma_unmap_sg(dev->dev, &dev->sg_tmp, 1, DMA_BIDIRECTIONAL);
+		return;
+	}
+
+	if (dev->sg_src == dev->sg_dst) {
+		dma_unmap_sg(dev->dev, dev->sg_src, 1, DMA_BIDIRECTIONAL);
+		return;
+	}
+
+	dma_unmap_sg(dev->dev, dev->sg_src, 1, DMA_TO_DEVICE);
+	if (dev->sg_dst)
+		dma_unmap_sg(dev->dev, dev->sg_dst, 1, DMA_FROM_DEVICE);
+}
+
+static irqreturn_t rk_crypto_irq_handle(int irq, void *dev_id)
+{
+	struct rk_crypto_info *dev  = platform_get_drvdata(dev_id);
+	u32 interrupt_status;
+
+	spin_lock(&dev->lock);
+	interrupt_status = CRYPTO_READ(dev, RK_CRYPTO_INTSTS);
+	if (!interrupt_status) {
+		spin_unlock(&dev->lock);
+		return IRQ_NONE;
+	}
+	CRYPTO_WRITE(dev, RK_CRYPTO_INTSTS, interrupt_status);
+
+	if (interrupt_status & (RK_CRYPTO_HRDMA_ERR_INT |
+				RK_CRYPTO_BCDMA_ERR_INT)) {
+		dev_warn(dev->dev, "DMA Error\n");
+		dev->err = -EFAULT;
+	}
+	spin_unlock(&dev->lock);
+
+	tasklet_schedule(&dev->done_task);
+
+	return IRQ_HANDLED;
+}
+
+/*
+ * Requests are processed one at a time: the first one queued on an idle
+ * engine schedules the queue tasklet, which keeps the engine busy until
+ * the queue is empty.
+ */
+int rk_crypto_enqueue(struct rk_crypto_info *dev,
+		      struct crypto_async_request *async_req)
+{
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	ret = crypto_enqueue_request(&dev->queue, async_req);
+	if (dev->busy || dev->plugged) {
+		spin_unlock_irqrestore(&dev->lock, flags);
+		return ret;
+	}
+	dev->busy = true;
+	spin_unlock_irqrestore(&dev->lock, flags);
+	tasklet_schedule(&dev->queue_task);
+
+	return ret;
+}
+
+/*
+ * Queue all requests of a batch before kicking an idle engine, so that it
+ * works through them back to back.
+ */
+int rk_crypto_enqueue_batch(struct rk_crypto_info *dev,
+			    struct crypto_batch *batch,
+			    int (*issue)(struct crypto_async_request *req))
+{
+	unsigned long flags;
+	bool kick = false;
+	int ret;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	dev->plugged++;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	ret = crypto_batch_submit(batch, issue);
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (!--dev->plugged && !dev->busy && dev->queue.qlen) {
+		dev->busy = true;
+		kick = true;
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+	if (kick)
+		tasklet_schedule(&dev->queue_task);
+
+	return ret;
+}
+
+void rk_crypto_request_done(struct rk_crypto_info *dev, int err)
+{
+	struct crypto_async_request *async_req = dev->async_req;
+
+	dev->async_req = NULL;
+	async_req->complete(async_req, err);
+	tasklet_schedule(&dev->queue_task);
+}
+
+static void rk_crypto_queue_task_cb(unsigned long data)
+{
+	struct rk_crypto_info *dev = (struct rk_crypto_info *)data;
+	struct crypto_async_request *async_req, *backlog;
+	unsigned long flags;
+	int err;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	backlog   = crypto_get_backlog(&dev->queue);
+	async_req = crypto_dequeue_request(&dev->queue);
+	if (!async_req) {
+		dev->busy = false;
+		spin_unlock_irqrestore(&dev->lock, flags);
+		return;
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	if (backlog)
+		backlog->complete(backlog, -EINPROGRESS);
+
+	if (crypto_tfm_alg_type(async_req->tfm) == CRYPTO_ALG_TYPE_AHASH) {
+		dev->start = rk_ahash_start;
+		dev->update = rk_ahash_rx;
+	} else {
+		dev->start = rk_ablk_start;
+		dev->update = rk_ablk_rx;
+	}
+
+	dev->async_req = async_req;
+	dev->err = 0;
+	err = dev->start(dev);
+	if (err)
+		rk_crypto_request_done(dev, err);
+}
+
+static void rk_crypto_done_task_cb(unsigned long data)
+{
+	struct rk_crypto_info *dev = (struct rk_crypto_info *)data;
+	int err;
+
+	if (dev->err) {
+		rk_crypto_unload_data(dev);
+		rk_crypto_request_done(dev, dev->err);
+		return;
+	}
+
+	err = dev->update(dev);
+	if (err)
+		rk_crypto_request_done(dev, err);
+}
+
+static struct rk_crypto_tmp *rk_cipher_algs[] = {
+	&rk_ecb_aes_alg,
+	&rk_cbc_aes_alg,
+	&rk_ecb_des_alg,
+	&rk_cbc_des_alg,
+	&rk_ecb_des3_ede_alg,
+	&rk_cbc_des3_ede_alg,
+	&rk_ahash_sha1,
+	&rk_ahash_sha256,
+	&rk_ahash_md5,
+};
+
+static void rk_crypto_unregister(unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if (rk_cipher_algs[i]->type == ALG_TYPE_CIPHER)
+			crypto_unregister_alg(&rk_cipher_algs[i]->alg.crypto);
+		else
+			crypto_unregister_ahash(&rk_cipher_algs[i]->alg.hash);
+	}
+}
+
+static int rk_crypto_register(struct rk_crypto_info *crypto_info)
+{
+	unsigned int i;
+	int err = 0;
+
+	for (i = 0; i < ARRAY_SIZE(rk_cipher_algs); i++) {
+		rk_cipher_algs[i]->dev = crypto_info;
+		if (rk_cipher_algs[i]->type == ALG_TYPE_CIPHER)
+			err = crypto_register_alg(
+					&rk_cipher_algs[i]->alg.crypto);
+		else
+			err = crypto_register_ahash(
+					&rk_cipher_algs[i]->alg.hash);
+		if (err) {
+			rk_crypto_unregister(i);
+			return err;
+		}
+	}
+	return 0;
+}
+
+static const struct of_device_id crypto_of_id_table[] = {
+	{ .compatible = "rockchip,rk3288-crypto" },
+	{}
+};
+MODULE_DEVICE_TABLE(of, crypto_of_id_table);
+
+static int rk_crypto_probe(struct platform_device *pdev)
+{
+	struct resource *res;
+	struct device *dev = &pdev->dev;
+	struct rk_crypto_info *crypto_info;
+	int err = 0;
+
+	crypto_info = devm_kzalloc(&pdev->dev,
+				   sizeof(*crypto_info), GFP_KERNEL);
+	if (!crypto_info)
+		return -ENOMEM;
+
+	crypto_info->rst = devm_reset_control_get(dev, "crypto-rst");
+	if (IS_ERR(crypto_info->rst))
+		return PTR_ERR(crypto_info->rst);
+
+	reset_control_assert(crypto_info->rst);
+	usleep_range(10, 20);
+	reset_control_deassert(crypto_info->rst);
+
+	spin_lock_init(&crypto_info->lock);
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	crypto_info->reg = devm_ioremap_resource(&pdev->dev, res);
+	if (IS_ERR(crypto_info->reg))
+		return PTR_ERR(crypto_info->reg);
+
+	crypto_info->aclk = devm_clk_get(&pdev->dev, "aclk");
+	if (IS_ERR(crypto_info->aclk))
+		return PTR_ERR(crypto_info->aclk);
+
+	crypto_info->hclk = devm_clk_get(&pdev->dev, "hclk");
+	if (IS_ERR(crypto_info->hclk))
+		return PTR_ERR(crypto_info->hclk);
+
+	crypto_info->sclk = devm_clk_get(&pdev->dev, "sclk");
+	if (IS_ERR(crypto_info->sclk))
+		return PTR_ERR(crypto_info->sclk);
+
+	crypto_info->dmaclk = devm_clk_get(&pdev->dev, "apb_pclk");
+	if (IS_ERR(crypto_info->dmaclk))
+		return PTR_ERR(crypto_info->dmaclk);
+
+	crypto_info->irq = platform_get_irq(pdev, 0);
+	if (crypto_info->irq < 0) {
+		dev_warn(&pdev->dev,
+			 "control Interrupt is not available.\n");
+		return crypto_info->irq;
+	}
+
+	crypto_info->addr_vir = (void *)devm_get_free_pages(&pdev->dev,
+							    GFP_KERNEL, 0);
+	if (!crypto_info->addr_vir)
+		return -ENOMEM;
+
+	crypto_info->dev = &pdev->dev;
+	platform_set_drvdata(pdev, crypto_info);
+
+	tasklet_init(&crypto_info->queue_task,
+		     rk_crypto_queue_task_cb, (unsigned long)crypto_info);
+	tasklet_init(&crypto_info->done_task,
+		     rk_crypto_done_task_cb, (unsigned long)crypto_info);
+	crypto_init_queue(&crypto_info->queue, 50);
+
+	err = rk_crypto_enable_clk(crypto_info);
+	if (err)
+		goto err_clk;
+
+	err = devm_request_irq(&pdev->dev, crypto_info->irq,
+			       rk_crypto_irq_handle, 0,
+			       "rk-crypto", pdev);
+	if (err) {
+		dev_err(crypto_info->dev, "irq request failed.\n");
+		goto err_irq;
+	}
+
+	err = rk_crypto_register(crypto_info);
+	if (err) {
+		dev_err(dev, "err in register alg");
+		goto err_register_alg;
+	}
+
+	err = rk_crypto_trng_register(crypto_info);
+	if (err) {
+		dev_err(dev, "err in register trng");
+		goto err_register_trng;
+	}
+
+	dev_info(dev, "Crypto Accelerator successfully registered\n");
+	return 0;
+
+err_register_trng:
+	rk_crypto_unregister(ARRAY_SIZE(rk_cipher_algs));
+err_register_alg:
+	devm_free_irq(&pdev->dev, crypto_info->irq, pdev);
+err_irq:
+	rk_crypto_disable_clk(crypto_info);
+err_clk:
+	tasklet_kill(&crypto_info->queue_task);
+	tasklet_kill(&crypto_info->done_task);
+	reset_control_assert(crypto_info->rst);
+	return err;
+}
+
+static int rk_crypto_remove(struct platform_device *pdev)
+{
+	struct rk_crypto_info *crypto_tmp = platform_get_drvdata(pdev);
+
+	if (IS_ENABLED(CONFIG_CRYPTO_DEV_ROCKCHIP_TRNG))
+		devm_hwrng_unregister(&pdev->dev, &crypto_tmp->trng);
+	rk_crypto_unregister(ARRAY_SIZE(rk_cipher_algs));
+	devm_free_irq(&pdev->dev, crypto_tmp->irq, pdev);
+	tasklet_kill(&crypto_tmp->done_task);
+	tasklet_kill(&crypto_tmp->queue_task);
+	rk_crypto_disable_clk(crypto_tmp);
+	reset_control_assert(crypto_tmp->rst);
+	return 0;
+}
+
+static struct platform_driver crypto_driver = {
+	.probe		= rk_crypto_probe,
+	.remove		= rk_crypto_remove,
+	.driver		= {
+		.name	= "rk3288-crypto",
+		.of_match_table	= crypto_of_id_table,
+	},
+};
+
+module_platform_driver(crypto_driver);
+
+MODULE_DESCRIPTION("Rockchip RK3288 crypto engine");
+MODULE_LICENSE("GPL");
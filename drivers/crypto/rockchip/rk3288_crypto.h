@@ -0,0 +1,296 @@
+#ifndef __RK3288_CRYPTO_H__
+#define __RK3288_CRYPTO_H__
+
+#include <crypto/aes.h>
+#include <crypto/des.h>
+#include <crypto/algapi.h>
+#include <crypto/md5.h>
+#include <crypto/sha.h>
+#include <crypto/internal/hash.h>
+#include <linux/interrupt.h>
+#include <linux/delay.h>
+#include <linux/hw_random.h>
+
+#define _SBF(v, f)			((v) << (f))
+
+/* Crypto control registers*/
+#define RK_CRYPTO_INTSTS		0x0000
+#define RK_CRYPTO_PKA_DONE_INT		BIT(5)
+#define RK_CRYPTO_HASH_DONE_INT		BIT(4)
+#define RK_CRYPTO_HRDMA_ERR_INT		BIT(3)
+#define RK_CRYPTO_HRDMA_DONE_INT	BIT(2)
+#define RK_CRYPTO_BCDMA_ERR_INT		BIT(1)
+#define RK_CRYPTO_BCDMA_DONE_INT	BIT(0)
+
+#define RK_CRYPTO_INTENA		0x0004
+#define RK_CRYPTO_PKA_DONE_ENA		BIT(5)
+#define RK_CRYPTO_HASH_DONE_ENA		BIT(4)
+#define RK_CRYPTO_HRDMA_ERR_ENA		BIT(3)
+#define RK_CRYPTO_HRDMA_DONE_ENA	BIT(2)
+#define RK_CRYPTO_BCDMA_ERR_ENA		BIT(1)
+#define RK_CRYPTO_BCDMA_DONE_ENA	BIT(0)
+
+/* the upper half of CTRL selects which bits of the lower half are written */
+#define RK_CRYPTO_CTRL			0x0008
+#define RK_CRYPTO_WRITE_MASK		_SBF(0xffff, 16)
+#define RK_CRYPTO_TRNG_FLUSH		BIT(9)
+#define RK_CRYPTO_TRNG_START		BIT(8)
+#define RK_CRYPTO_PKA_FLUSH		BIT(7)
+#define RK_CRYPTO_HASH_FLUSH		BIT(6)
+#define RK_CRYPTO_BLOCK_FLUSH		BIT(5)
+#define RK_CRYPTO_PKA_START		BIT(4)
+#define RK_CRYPTO_HASH_START		BIT(3)
+#define RK_CRYPTO_BLOCK_START		BIT(2)
+#define RK_CRYPTO_TDES_START		BIT(1)
+#define RK_CRYPTO_AES_START		BIT(0)
+
+#define RK_CRYPTO_CONF			0x000c
+/* DMA address modes: fixed = 0, increment = 1 */
+#define RK_CRYPTO_HR_ADDR_MODE		BIT(8)
+#define RK_CRYPTO_BT_ADDR_MODE		BIT(7)
+#define RK_CRYPTO_BR_ADDR_MODE		BIT(6)
+#define RK_CRYPTO_BYTESWAP_HRFIFO	BIT(5)
+#define RK_CRYPTO_BYTESWAP_BTFIFO	BIT(4)
+#define RK_CRYPTO_BYTESWAP_BRFIFO	BIT(3)
+/* AES = 0, DES/TDES = 1 */
+#define RK_CRYPTO_DESSEL		BIT(2)
+#define RK_CRYPTO_HASHINSEL_INDEPENDENT_SOURCE	0
+#define RK_CRYPTO_HASHINSEL_BLOCK_CIPHER_INPUT	1
+#define RK_CRYPTO_HASHINSEL_BLOCK_CIPHER_OUTPUT	2
+
+/* block cipher receive/transmit DMA, lengths are in words */
+#define RK_CRYPTO_BRDMAS		0x0010
+#define RK_CRYPTO_BTDMAS		0x0014
+#define RK_CRYPTO_BRDMAL		0x0018
+/* hash receive DMA */
+#define RK_CRYPTO_HRDMAS		0x001c
+#define RK_CRYPTO_HRDMAL		0x0020
+
+/* AES registers */
+#define RK_CRYPTO_AES_CTRL		0x0080
+#define RK_CRYPTO_AES_BYTESWAP_CNT	BIT(11)
+#define RK_CRYPTO_AES_BYTESWAP_KEY	BIT(10)
+#define RK_CRYPTO_AES_BYTESWAP_IV	BIT(9)
+#define RK_CRYPTO_AES_BYTESWAP_DO	BIT(8)
+#define RK_CRYPTO_AES_BYTESWAP_DI	BIT(7)
+#define RK_CRYPTO_AES_KEY_CHANGE	BIT(6)
+#define RK_CRYPTO_AES_ECB_MODE		0x00
+#define RK_CRYPTO_AES_CBC_MODE		BIT(4)
+#define RK_CRYPTO_AES_CTR_MODE		BIT(5)
+#define RK_CRYPTO_AES_128BIT_KEY	0x00
+#define RK_CRYPTO_AES_192BIT_KEY	BIT(2)
+#define RK_CRYPTO_AES_256BIT_KEY	BIT(3)
+/* slave = 0, fifo = 1 */
+#define RK_CRYPTO_AES_FIFO_MODE		BIT(1)
+/* encryption = 0, decryption = 1 */
+#define RK_CRYPTO_AES_DEC		BIT(0)
+
+#define RK_CRYPTO_AES_STS		0x0084
+#define RK_CRYPTO_AES_DONE		BIT(0)
+
+#define RK_CRYPTO_AES_DIN_0		0x0088
+#define RK_CRYPTO_AES_DOUT_0		0x0098
+#define RK_CRYPTO_AES_IV_0		0x00a8
+#define RK_CRYPTO_AES_KEY_0		0x00b8
+#define RK_CRYPTO_AES_CNT_0		0x00d8
+
+/* DES/TDES registers */
+#define RK_CRYPTO_TDES_CTRL		0x0100
+#define RK_CRYPTO_TDES_BYTESWAP_KEY	BIT(8)
+#define RK_CRYPTO_TDES_BYTESWAP_IV	BIT(7)
+#define RK_CRYPTO_TDES_BYTESWAP_DO	BIT(6)
+#define RK_CRYPTO_TDES_BYTESWAP_DI	BIT(5)
+/* ECB = 0, CBC = 1 */
+#define RK_CRYPTO_TDES_CHAINMODE_CBC	BIT(4)
+/* EDE = 0, EEE = 1 */
+#define RK_CRYPTO_TDES_EEE		BIT(3)
+/* DES = 0, TDES = 1 */
+#define RK_CRYPTO_TDES_SELECT		BIT(2)
+/* slave = 0, fifo = 1 */
+#define RK_CRYPTO_TDES_FIFO_MODE	BIT(1)
+/* encryption = 0, decryption = 1 */
+#define RK_CRYPTO_TDES_DEC		BIT(0)
+
+#define RK_CRYPTO_TDES_STS		0x0104
+#define RK_CRYPTO_TDES_DONE		BIT(0)
+
+#define RK_CRYPTO_TDES_DIN_0		0x0108
+#define RK_CRYPTO_TDES_DOUT_0		0x0110
+#define RK_CRYPTO_TDES_IV_0		0x0118
+/* the three keys follow each other */
+#define RK_CRYPTO_TDES_KEY1_0		0x0120
+#define RK_CRYPTO_TDES_KEY2_0		0x0128
+#define RK_CRYPTO_TDES_KEY3_0		0x0130
+
+/* HASH registers */
+#define RK_CRYPTO_HASH_CTRL		0x0180
+#define RK_CRYPTO_HASH_SWAP_DO		BIT(3)
+#define RK_CRYPTO_HASH_SWAP_DI		BIT(2)
+#define RK_CRYPTO_HASH_SHA1		0x00
+#define RK_CRYPTO_HASH_MD5		BIT(0)
+#define RK_CRYPTO_HASH_SHA256		BIT(1)
+#define RK_CRYPTO_HASH_PRNG		0x03
+
+#define RK_CRYPTO_HASH_STS		0x0184
+#define RK_CRYPTO_HASH_DONE		BIT(0)
+
+/* total message length, needed before the first byte is hashed */
+#define RK_CRYPTO_HASH_MSG_LEN		0x0188
+#define RK_CRYPTO_HASH_DOUT_0		0x018c
+#define RK_CRYPTO_HASH_SEED_0		0x01ac
+
+/* TRNG registers */
+#define RK_CRYPTO_TRNG_CTRL		0x0200
+#define RK_CRYPTO_TRNG_OSC_ENABLE	BIT(16)
+#define RK_CRYPTO_TRNG_SAMPLE_PERIOD(x)	((x) & 0xffff)
+#define RK_CRYPTO_TRNG_DOUT_0		0x0204
+#define RK_CRYPTO_TRNG_DOUT_WORDS	8
+
+#define CRYPTO_READ(dev, offset)		  \
+		readl_relaxed(((dev)->reg + (offset)))
+#define CRYPTO_WRITE(dev, offset, val)	  \
+		writel_relaxed((val), ((dev)->reg + (offset)))
+
+/*
+ * Requests shorter than this are handed to the software implementation:
+ * below it, mapping the buffers and taking the interrupt costs more than
+ * the NEON code takes for the whole request.
+ */
+#define RK_CRYPTO_MIN_HW_LEN		512
+
+/**
+ * struct rk_crypto_info - the crypto engine
+ * @queue:	requests waiting for the engine, protected by @lock
+ * @queue_task:	starts the next request once the engine is idle
+ * @done_task:	continues or completes the request after each DMA transfer
+ * @async_req:	the request being processed
+ * @err:	set by the interrupt handler on DMA errors
+ * @busy:	a request is being processed or @queue_task is scheduled
+ * @plugged:	batches being queued, which hold off starting the engine
+ * @aligned:	the request's buffers are DMA'd directly, without @addr_vir
+ * @addr_vir:	bounce page for unaligned requests
+ * @left_bytes:	what is left of the request after the current transfer
+ * @count:	length of the current transfer
+ * @trng:	the true random number generator, if enabled
+ */
+struct rk_crypto_info {
+	struct device			*dev;
+	struct clk			*aclk;
+	struct clk			*hclk;
+	struct clk			*sclk;
+	struct clk			*dmaclk;
+	struct reset_control		*rst;
+	void __iomem			*reg;
+	int				irq;
+	struct crypto_queue		queue;
+	struct tasklet_struct		queue_task;
+	struct tasklet_struct		done_task;
+	struct crypto_async_request	*async_req;
+	int				err;
+	bool				busy;
+	unsigned int			plugged;
+	/* protects @queue, @busy and @plugged */
+	spinlock_t			lock;
+
+	/* state of the current request */
+	struct scatterlist		*first_src;
+	struct scatterlist		*first_dst;
+	struct scatterlist		*sg_src;
+	struct scatterlist		*sg_dst;
+	struct scatterlist		sg_tmp;
+	unsigned int			src_nents;
+	unsigned int			dst_nents;
+	unsigned int			total;
+	unsigned int			left_bytes;
+	unsigned int			count;
+	bool				aligned;
+	void				*addr_vir;
+	dma_addr_t			addr_in;
+	dma_addr_t			addr_out;
+
+	/* set for each request type by rk_crypto_queue_task_cb() */
+	int (*start)(struct rk_crypto_info *dev);
+	int (*update)(struct rk_crypto_info *dev);
+
+	struct hwrng			trng;
+};
+
+/* the private variable of hash */
+struct rk_ahash_ctx {
+	struct rk_crypto_info		*dev;
+	struct crypto_ahash		*fallback_tfm;
+};
+
+/* the request context of hash, also used for the fallback */
+struct rk_ahash_rctx {
+	u32				mode;
+	/* must be last, the fallback's request context follows it */
+	struct ahash_request		fallback_req;
+};
+
+/* the private variable of cipher */
+struct rk_cipher_ctx {
+	struct rk_crypto_info		*dev;
+	unsigned int			keylen;
+	u8				key[AES_MAX_KEY_SIZE];
+	struct crypto_blkcipher		*fallback;
+};
+
+struct rk_cipher_rctx {
+	u32				mode;
+	/* IV of the next transfer of the request */
+	u8				iv[AES_BLOCK_SIZE];
+};
+
+enum alg_type {
+	ALG_TYPE_HASH,
+	ALG_TYPE_CIPHER,
+};
+
+struct rk_crypto_tmp {
+	struct rk_crypto_info		*dev;
+	union {
+		struct crypto_alg	crypto;
+		struct ahash_alg	hash;
+	} alg;
+	enum alg_type			type;
+};
+
+extern struct rk_crypto_tmp rk_ecb_aes_alg;
+extern struct rk_crypto_tmp rk_cbc_aes_alg;
+extern struct rk_crypto_tmp rk_ecb_des_alg;
+extern struct rk_crypto_tmp rk_cbc_des_alg;
+extern struct rk_crypto_tmp rk_ecb_des3_ede_alg;
+extern struct rk_crypto_tmp rk_cbc_des3_ede_alg;
+
+extern struct rk_crypto_tmp rk_ahash_sha1;
+extern struct rk_crypto_tmp rk_ahash_sha256;
+extern struct rk_crypto_tmp rk_ahash_md5;
+
+int rk_ablk_start(struct rk_crypto_info *dev);
+int rk_ablk_rx(struct rk_crypto_info *dev);
+int rk_ahash_start(struct rk_crypto_info *dev);
+int rk_ahash_rx(struct rk_crypto_info *dev);
+
+int rk_crypto_enqueue(struct rk_crypto_info *dev,
+		      struct crypto_async_request *async_req);
+int rk_crypto_enqueue_batch(struct rk_crypto_info *dev,
+			    struct crypto_batch *batch,
+			    int (*issue)(struct crypto_async_request *req));
+bool rk_crypto_check_alignment(struct scatterlist *sg_src,
+			       struct scatterlist *sg_dst,
+			       unsigned int total, unsigned int align_size);
+int rk_crypto_load_data(struct rk_crypto_info *dev);
+void rk_crypto_unload_data(struct rk_crypto_info *dev);
+void rk_crypto_request_done(struct rk_crypto_info *dev, int err);
+
+#ifdef CONFIG_CRYPTO_DEV_ROCKCHIP_TRNG
+int rk_crypto_trng_register(struct rk_crypto_info *dev);
+#else
+static inline int rk_crypto_trng_register(struct rk_crypto_info *dev)
+{
+	return 0;
+}
+#endif
+
+#endif
@@ -0,0 +1,415 @@
+/*
+ * Crypto acceleration support for Rockchip RK3288
+ *
+ * AES, DES and 3DES in ECB and CBC modes.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include "rk3288_crypto.h"
+#include <linux/scatterlist.h>
+
+#define RK_CRYPTO_DEC			BIT(0)
+
+static int rk_cipher_setkey(struct crypto_ablkcipher *cipher,
+			    const u8 *key, unsigned int keylen)
+{
+	struct crypto_tfm *tfm = crypto_ablkcipher_tfm(cipher);
+	struct rk_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	int ret;
+
+	/* the fallback checks key lengths and weak keys for us */
+	crypto_blkcipher_clear_flags(ctx->fallback, CRYPTO_TFM_REQ_MASK);
+	crypto_blkcipher_set_flags(ctx->fallback,
+				   tfm->crt_flags & CRYPTO_TFM_REQ_MASK);
+
+	ret = crypto_blkcipher_setkey(ctx->fallback, key, keylen);
+
+	tfm->crt_flags &= ~CRYPTO_TFM_RES_MASK;
+	tfm->crt_flags |= crypto_blkcipher_get_flags(ctx->fallback) &
+			  CRYPTO_TFM_RES_MASK;
+	if (ret)
+		return ret;
+
+	ctx->keylen = keylen;
+	memcpy(ctx->key, key, keylen);
+	return 0;
+}
+
+static int rk_cipher_fallback(struct ablkcipher_request *req, u32 mode)
+{
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(req);
+	struct rk_cipher_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+	struct blkcipher_desc desc = {
+		.tfm	= ctx->fallback,
+		.info	= req->info,
+		.flags	= req->base.flags,
+	};
+
+	if (mode & RK_CRYPTO_DEC)
+		return crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+						   req->nbytes);
+
+	return crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+					   req->nbytes);
+}
+
+static int rk_handle_req(struct ablkcipher_request *req, u32 mode)
+{
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(req);
+	struct rk_cipher_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+	struct rk_cipher_rctx *rctx = ablkcipher_request_ctx(req);
+
+	if (!IS_ALIGNED(req->nbytes, crypto_ablkcipher_blocksize(tfm)))
+		return -EINVAL;
+
+	if (req->nbytes < RK_CRYPTO_MIN_HW_LEN)
+		return rk_cipher_fallback(req, mode);
+
+	rctx->mode = mode;
+	return rk_crypto_enqueue(ctx->dev, &req->base);
+}
+
+static int rk_ablk_issue_encrypt(struct crypto_async_request *req)
+{
+	return crypto_ablkcipher_encrypt(ablkcipher_request_cast(req));
+}
+
+static int rk_ablk_issue_decrypt(struct crypto_async_request *req)
+{
+	return crypto_ablkcipher_decrypt(ablkcipher_request_cast(req));
+}
+
+static int rk_ablk_encrypt_batch(struct crypto_batch *batch)
+{
+	struct rk_cipher_ctx *ctx = crypto_tfm_ctx(batch->reqs[0]->tfm);
+
+	return rk_crypto_enqueue_batch(ctx->dev, batch, rk_ablk_issue_encrypt);
+}
+
+static int rk_ablk_decrypt_batch(struct crypto_batch *batch)
+{
+	struct rk_cipher_ctx *ctx = crypto_tfm_ctx(batch->reqs[0]->tfm);
+
+	return rk_crypto_enqueue_batch(ctx->dev, batch, rk_ablk_issue_decrypt);
+}
+
+static int rk_aes_ecb_encrypt(struct ablkcipher_request *req)
+{
+	return rk_handle_req(req, RK_CRYPTO_AES_ECB_MODE);
+}
+
+static int rk_aes_ecb_decrypt(struct ablkcipher_request *req)
+{
+	return rk_handle_req(req, RK_CRYPTO_AES_ECB_MODE | RK_CRYPTO_AES_DEC);
+}
+
+static int rk_aes_cbc_encrypt(struct ablkcipher_request *req)
+{
+	return rk_handle_req(req, RK_CRYPTO_AES_CBC_MODE);
+}
+
+static int rk_aes_cbc_decrypt(struct ablkcipher_request *req)
+{
+	return rk_handle_req(req, RK_CRYPTO_AES_CBC_MODE | RK_CRYPTO_AES_DEC);
+}
+
+static int rk_des_ecb_encrypt(struct ablkcipher_request *req)
+{
+	return rk_handle_req(req, 0);
+}
+
+static int rk_des_ecb_decrypt(struct ablkcipher_request *req)
+{
+	return rk_handle_req(req, RK_CRYPTO_TDES_DEC);
+}
+
+static int rk_des_cbc_encrypt(struct ablkcipher_request *req)
+{
+	return rk_handle_req(req, RK_CRYPTO_TDES_CHAINMODE_CBC);
+}
+
+static int rk_des_cbc_decrypt(struct ablkcipher_request *req)
+{
+	return rk_handle_req(req, RK_CRYPTO_TDES_CHAINMODE_CBC |
+				  RK_CRYPTO_TDES_DEC);
+}
+
+static int rk_des3_ede_ecb_encrypt(struct ablkcipher_request *req)
+{
+	return rk_handle_req(req, RK_CRYPTO_TDES_SELECT);
+}
+
+static int rk_des3_ede_ecb_decrypt(struct ablkcipher_request *req)
+{
+	return rk_handle_req(req, RK_CRYPTO_TDES_SELECT | RK_CRYPTO_TDES_DEC);
+}
+
+static int rk_des3_ede_cbc_encrypt(struct ablkcipher_request *req)
+{
+	return rk_handle_req(req, RK_CRYPTO_TDES_SELECT |
+				  RK_CRYPTO_TDES_CHAINMODE_CBC);
+}
+
+static int rk_des3_ede_cbc_decrypt(struct ablkcipher_request *req)
+{
+	return rk_handle_req(req, RK_CRYPTO_TDES_SELECT |
+				  RK_CRYPTO_TDES_CHAINMODE_CBC |
+				  RK_CRYPTO_TDES_DEC);
+}
+
+static bool rk_cipher_is_des(struct crypto_ablkcipher *cipher)
+{
+	return crypto_ablkcipher_blocksize(cipher) == DES_BLOCK_SIZE;
+}
+
+static void rk_ablk_hw_init(struct rk_crypto_info *dev)
+{
+	struct ablkcipher_request *req =
+		ablkcipher_request_cast(dev->async_req);
+	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(req);
+	struct rk_cipher_ctx *ctx = crypto_ablkcipher_ctx(cipher);
+	struct rk_cipher_rctx *rctx = ablkcipher_request_ctx(req);
+	u32 ivsize = crypto_ablkcipher_ivsize(cipher);
+	u32 mode = rctx->mode;
+	u32 conf_reg = 0;
+
+	if (rk_cipher_is_des(cipher)) {
+		mode |= RK_CRYPTO_TDES_FIFO_MODE |
+			RK_CRYPTO_TDES_BYTESWAP_KEY |
+			RK_CRYPTO_TDES_BYTESWAP_IV;
+		CRYPTO_WRITE(dev, RK_CRYPTO_TDES_CTRL, mode);
+		memcpy_toio(dev->reg + RK_CRYPTO_TDES_KEY1_0, ctx->key,
+			    ctx->keylen);
+		conf_reg = RK_CRYPTO_DESSEL;
+	} else {
+		mode |= RK_CRYPTO_AES_FIFO_MODE |
+			RK_CRYPTO_AES_KEY_CHANGE |
+			RK_CRYPTO_AES_BYTESWAP_KEY |
+			RK_CRYPTO_AES_BYTESWAP_IV;
+		if (ctx->keylen == AES_KEYSIZE_192)
+			mode |= RK_CRYPTO_AES_192BIT_KEY;
+		else if (ctx->keylen == AES_KEYSIZE_256)
+			mode |= RK_CRYPTO_AES_256BIT_KEY;
+		CRYPTO_WRITE(dev, RK_CRYPTO_AES_CTRL, mode);
+		memcpy_toio(dev->reg + RK_CRYPTO_AES_KEY_0, ctx->key,
+			    ctx->keylen);
+	}
+	conf_reg |= RK_CRYPTO_BYTESWAP_BTFIFO |
+		    RK_CRYPTO_BYTESWAP_BRFIFO;
+	CRYPTO_WRITE(dev, RK_CRYPTO_CONF, conf_reg);
+	CRYPTO_WRITE(dev, RK_CRYPTO_INTENA,
+		     RK_CRYPTO_BCDMA_ERR_ENA | RK_CRYPTO_BCDMA_DONE_ENA);
+
+	if (ivsize)
+		memcpy(rctx->iv, req->info, ivsize);
+}
+
+/*
+ * Each transfer is a separate operation for the engine, CBC chaining
+ * between them is done by loading the IV: the last ciphertext block of
+ * the previous transfer.  When decrypting in place it must be saved
+ * before the engine overwrites it.
+ */
+static void rk_ablk_save_iv(struct rk_crypto_info *dev, bool dst)
+{
+	struct ablkcipher_request *req =
+		ablkcipher_request_cast(dev->async_req);
+	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(req);
+	struct rk_cipher_rctx *rctx = ablkcipher_request_ctx(req);
+	u32 ivsize = crypto_ablkcipher_ivsize(cipher);
+	unsigned int end = dev->total - dev->left_bytes;
+
+	if (!ivsize)
+		return;
+
+	if (dst)
+		sg_pcopy_to_buffer(dev->first_dst, dev->dst_nents, rctx->iv,
+				   ivsize, end - ivsize);
+	else
+		sg_pcopy_to_buffer(dev->first_src, dev->src_nents, rctx->iv,
+				   ivsize, end - ivsize);
+}
+
+static int rk_set_data_start(struct rk_crypto_info *dev)
+{
+	struct ablkcipher_request *req =
+		ablkcipher_request_cast(dev->async_req);
+	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(req);
+	struct rk_cipher_rctx *rctx = ablkcipher_request_ctx(req);
+	u32 ivsize = crypto_ablkcipher_ivsize(cipher);
+	int err;
+
+	if (ivsize)
+		memcpy_toio(dev->reg + (rk_cipher_is_des(cipher) ?
+					RK_CRYPTO_TDES_IV_0 :
+					RK_CRYPTO_AES_IV_0),
+			    rctx->iv, ivsize);
+
+	err = rk_crypto_load_data(dev);
+	if (err)
+		return err;
+
+	if (rctx->mode & RK_CRYPTO_DEC)
+		rk_ablk_save_iv(dev, false);
+
+	CRYPTO_WRITE(dev, RK_CRYPTO_BRDMAS, dev->addr_in);
+	CRYPTO_WRITE(dev, RK_CRYPTO_BRDMAL, dev->count / 4);
+	CRYPTO_WRITE(dev, RK_CRYPTO_BTDMAS, dev->addr_out);
+	CRYPTO_WRITE(dev, RK_CRYPTO_CTRL, RK_CRYPTO_BLOCK_START |
+		     _SBF(RK_CRYPTO_BLOCK_START, 16));
+	return 0;
+}
+
+int rk_ablk_start(struct rk_crypto_info *dev)
+{
+	struct ablkcipher_request *req =
+		ablkcipher_request_cast(dev->async_req);
+	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(req);
+	unsigned int bs = crypto_ablkcipher_blocksize(cipher);
+
+	dev->left_bytes = req->nbytes;
+	dev->total = req->nbytes;
+	dev->first_src = req->src;
+	dev->first_dst = req->dst;
+	dev->sg_src = req->src;
+	dev->sg_dst = req->dst;
+	dev->src_nents = sg_nents(req->src);
+	dev->dst_nents = sg_nents(req->dst);
+	dev->aligned = rk_crypto_check_alignment(req->src, req->dst,
+						 req->nbytes, bs);
+
+	rk_ablk_hw_init(dev);
+	return rk_set_data_start(dev);
+}
+
+/* called by the done tasklet after each transfer */
+int rk_ablk_rx(struct rk_crypto_info *dev)
+{
+	struct ablkcipher_request *req =
+		ablkcipher_request_cast(dev->async_req);
+	struct rk_cipher_rctx *rctx = ablkcipher_request_ctx(req);
+	u32 ivsize = crypto_ablkcipher_ivsize(crypto_ablkcipher_reqtfm(req));
+	unsigned int offset = dev->total - dev->left_bytes - dev->count;
+
+	rk_crypto_unload_data(dev);
+	if (!dev->aligned &&
+	    sg_pcopy_from_buffer(dev->first_dst, dev->dst_nents,
+				 dev->addr_vir, dev->count,
+				 offset) != dev->count)
+		return -EINVAL;
+
+	if (!(rctx->mode & RK_CRYPTO_DEC))
+		rk_ablk_save_iv(dev, true);
+
+	if (dev->left_bytes) {
+		if (dev->aligned) {
+			dev->sg_src = sg_next(dev->sg_src);
+			dev->sg_dst = sg_next(dev->sg_dst);
+		}
+		return rk_set_data_start(dev);
+	}
+
+	/* the IV of a following request continues the chain */
+	if (ivsize)
+		memcpy(req->info, rctx->iv, ivsize);
+	rk_crypto_request_done(dev, 0);
+	return 0;
+}
+
+static int rk_ablk_cra_init(struct crypto_tfm *tfm)
+{
+	struct rk_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct crypto_alg *alg = tfm->__crt_alg;
+	struct rk_crypto_tmp *algt;
+
+	algt = container_of(alg, struct rk_crypto_tmp, alg.crypto);
+
+	ctx->dev = algt->dev;
+	ctx->fallback = crypto_alloc_blkcipher(crypto_tfm_alg_name(tfm), 0,
+					       CRYPTO_ALG_ASYNC |
+					       CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback)) {
+		dev_err(ctx->dev->dev, "Could not load fallback for %s\n",
+			crypto_tfm_alg_name(tfm));
+		return PTR_ERR(ctx->fallback);
+	}
+
+	tfm->crt_ablkcipher.reqsize = sizeof(struct rk_cipher_rctx);
+	return 0;
+}
+
+static void rk_ablk_cra_exit(struct crypto_tfm *tfm)
+{
+	struct rk_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_blkcipher(ctx->fallback);
+}
+
+/*
+ * Above the bit-sliced NEON implementations: the engine handles large
+ * requests without any CPU time, small ones go to the fallback anyway.
+ */
+#define RK_CIPHER_PRIORITY	400
+
+#define RK_CIPHER_ALG(_name, _drv, _bs, _min, _max, _iv, _enc, _dec)	\
+{									\
+	.type = ALG_TYPE_CIPHER,					\
+	.alg.crypto = {							\
+		.cra_name		= _name,			\
+		.cra_driver_name	= _drv,				\
+		.cra_priority		= RK_CIPHER_PRIORITY,		\
+		.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER |	\
+					  CRYPTO_ALG_ASYNC |		\
+					  CRYPTO_ALG_NEED_FALLBACK,	\
+		.cra_blocksize		= _bs,				\
+		.cra_ctxsize		= sizeof(struct rk_cipher_ctx),	\
+		.cra_alignmask		= 0x03,				\
+		.cra_type		= &crypto_ablkcipher_type,	\
+		.cra_module		= THIS_MODULE,			\
+		.cra_init		= rk_ablk_cra_init,		\
+		.cra_exit		= rk_ablk_cra_exit,		\
+		.cra_u.ablkcipher	= {				\
+			.min_keysize	= _min,				\
+			.max_keysize	= _max,				\
+			.ivsize		= _iv,				\
+			.setkey		= rk_cipher_setkey,		\
+			.encrypt	= _enc,				\
+			.decrypt	= _dec,				\
+			.encrypt_batch	= rk_ablk_encrypt_batch,	\
+			.decrypt_batch	= rk_ablk_decrypt_batch,	\
+		}							\
+	}								\
+}
+
+struct rk_crypto_tmp rk_ecb_aes_alg =
+	RK_CIPHER_ALG("ecb(aes)", "ecb-aes-rk", AES_BLOCK_SIZE,
+		      AES_MIN_KEY_SIZE, AES_MAX_KEY_SIZE, 0,
+		      rk_aes_ecb_encrypt, rk_aes_ecb_decrypt);
+
+struct rk_crypto_tmp rk_cbc_aes_alg =
+	RK_CIPHER_ALG("cbc(aes)", "cbc-aes-rk", AES_BLOCK_SIZE,
+		      AES_MIN_KEY_SIZE, AES_MAX_KEY_SIZE, AES_BLOCK_SIZE,
+		      rk_aes_cbc_encrypt, rk_aes_cbc_decrypt);
+
+struct rk_crypto_tmp rk_ecb_des_alg =
+	RK_CIPHER_ALG("ecb(des)", "ecb-des-rk", DES_BLOCK_SIZE,
+		      DES_KEY_SIZE, DES_KEY_SIZE, 0,
+		      rk_des_ecb_encrypt, rk_des_ecb_decrypt);
+
+struct rk_crypto_tmp rk_cbc_des_alg =
+	RK_CIPHER_ALG("cbc(des)", "cbc-des-rk", DES_BLOCK_SIZE,
+		      DES_KEY_SIZE, DES_KEY_SIZE, DES_BLOCK_SIZE,
+		      rk_des_cbc_encrypt, rk_des_cbc_decrypt);
+
+struct rk_crypto_tmp rk_ecb_des3_ede_alg =
+	RK_CIPHER_ALG("ecb(des3_ede)", "ecb-des3-ede-rk", DES_BLOCK_SIZE,
+		      DES3_EDE_KEY_SIZE, DES3_EDE_KEY_SIZE, 0,
+		      rk_des3_ede_ecb_encrypt, rk_des3_ede_ecb_decrypt);
+
+struct rk_crypto_tmp rk_cbc_des3_ede_alg =
+	RK_CIPHER_ALG("cbc(des3_ede)", "cbc-des3-ede-rk", DES_BLOCK_SIZE,
+		      DES3_EDE_KEY_SIZE, DES3_EDE_KEY_SIZE, DES_BLOCK_SIZE,
+		      rk_des3_ede_cbc_encrypt, rk_des3_ede_cbc_decrypt);
@@ -0,0 +1,286 @@
+/*
+ * Crypto acceleration support for Rockchip RK3288
+ *
+ * SHA1, SHA256 and MD5.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include "rk3288_crypto.h"
+#include <linux/iopoll.h>
+#include <linux/scatterlist.h>
+
+/*
+ * The engine needs the length of the whole message before it starts, so
+ * only digest() of a long enough message is done in hardware.  Everything
+ * else, including the incremental init/update/final interface, goes to
+ * the fallback, whose state is also what export() and import() handle.
+ */
+
+static void rk_ahash_fallback_req(struct ahash_request *req)
+{
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
+	struct rk_ahash_rctx *rctx = ahash_request_ctx(req);
+	struct rk_ahash_ctx *ctx = crypto_ahash_ctx(tfm);
+
+	ahash_request_set_tfm(&rctx->fallback_req, ctx->fallback_tfm);
+	rctx->fallback_req.base.flags = req->base.flags &
+					CRYPTO_TFM_REQ_MAY_SLEEP;
+	ahash_request_set_crypt(&rctx->fallback_req, req->src, req->result,
+				req->nbytes);
+}
+
+static int rk_ahash_init(struct ahash_request *req)
+{
+	struct rk_ahash_rctx *rctx = ahash_request_ctx(req);
+
+	rk_ahash_fallback_req(req);
+	return crypto_ahash_init(&rctx->fallback_req);
+}
+
+static int rk_ahash_update(struct ahash_request *req)
+{
+	struct rk_ahash_rctx *rctx = ahash_request_ctx(req);
+
+	rk_ahash_fallback_req(req);
+	return crypto_ahash_update(&rctx->fallback_req);
+}
+
+static int rk_ahash_final(struct ahash_request *req)
+{
+	struct rk_ahash_rctx *rctx = ahash_request_ctx(req);
+
+	rk_ahash_fallback_req(req);
+	return crypto_ahash_final(&rctx->fallback_req);
+}
+
+static int rk_ahash_finup(struct ahash_request *req)
+{
+	struct rk_ahash_rctx *rctx = ahash_request_ctx(req);
+
+	rk_ahash_fallback_req(req);
+	return crypto_ahash_finup(&rctx->fallback_req);
+}
+
+static int rk_ahash_import(struct ahash_request *req, const void *in)
+{
+	struct rk_ahash_rctx *rctx = ahash_request_ctx(req);
+
+	rk_ahash_fallback_req(req);
+	return crypto_ahash_import(&rctx->fallback_req, in);
+}
+
+static int rk_ahash_export(struct ahash_request *req, void *out)
+{
+	struct rk_ahash_rctx *rctx = ahash_request_ctx(req);
+
+	rk_ahash_fallback_req(req);
+	return crypto_ahash_export(&rctx->fallback_req, out);
+}
+
+static int rk_ahash_digest(struct ahash_request *req)
+{
+	struct rk_ahash_ctx *tctx = crypto_tfm_ctx(req->base.tfm);
+	struct rk_ahash_rctx *rctx = ahash_request_ctx(req);
+
+	if (req->nbytes < RK_CRYPTO_MIN_HW_LEN) {
+		rk_ahash_fallback_req(req);
+		return crypto_ahash_digest(&rctx->fallback_req);
+	}
+
+	switch (crypto_ahash_digestsize(crypto_ahash_reqtfm(req))) {
+	case SHA1_DIGEST_SIZE:
+		rctx->mode = RK_CRYPTO_HASH_SHA1;
+		break;
+	case SHA256_DIGEST_SIZE:
+		rctx->mode = RK_CRYPTO_HASH_SHA256;
+		break;
+	case MD5_DIGEST_SIZE:
+		rctx->mode = RK_CRYPTO_HASH_MD5;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return rk_crypto_enqueue(tctx->dev, &req->base);
+}
+
+static void rk_ahash_reg_init(struct rk_crypto_info *dev)
+{
+	struct ahash_request *req = ahash_request_cast(dev->async_req);
+	struct rk_ahash_rctx *rctx = ahash_request_ctx(req);
+	u32 reg_status;
+
+	reg_status = CRYPTO_READ(dev, RK_CRYPTO_CTRL) |
+		     RK_CRYPTO_HASH_FLUSH | RK_CRYPTO_WRITE_MASK;
+	CRYPTO_WRITE(dev, RK_CRYPTO_CTRL, reg_status);
+
+	reg_status = CRYPTO_READ(dev, RK_CRYPTO_CTRL);
+	reg_status &= ~RK_CRYPTO_HASH_FLUSH;
+	reg_status |= RK_CRYPTO_WRITE_MASK;
+	CRYPTO_WRITE(dev, RK_CRYPTO_CTRL, reg_status);
+
+	memset_io(dev->reg + RK_CRYPTO_HASH_DOUT_0, 0, 32);
+
+	CRYPTO_WRITE(dev, RK_CRYPTO_INTENA, RK_CRYPTO_HRDMA_ERR_ENA |
+					    RK_CRYPTO_HRDMA_DONE_ENA);
+
+	CRYPTO_WRITE(dev, RK_CRYPTO_INTSTS, RK_CRYPTO_HRDMA_ERR_INT |
+					    RK_CRYPTO_HRDMA_DONE_INT);
+
+	CRYPTO_WRITE(dev, RK_CRYPTO_HASH_CTRL, rctx->mode |
+					       RK_CRYPTO_HASH_SWAP_DO);
+
+	CRYPTO_WRITE(dev, RK_CRYPTO_CONF, RK_CRYPTO_BYTESWAP_HRFIFO |
+					  RK_CRYPTO_BYTESWAP_BRFIFO |
+					  RK_CRYPTO_BYTESWAP_BTFIFO);
+
+	CRYPTO_WRITE(dev, RK_CRYPTO_HASH_MSG_LEN, dev->total);
+}
+
+static int rk_ahash_set_data_start(struct rk_crypto_info *dev)
+{
+	int err;
+
+	err = rk_crypto_load_data(dev);
+	if (err)
+		return err;
+
+	CRYPTO_WRITE(dev, RK_CRYPTO_HRDMAS, dev->addr_in);
+	CRYPTO_WRITE(dev, RK_CRYPTO_HRDMAL, DIV_ROUND_UP(dev->count, 4));
+	CRYPTO_WRITE(dev, RK_CRYPTO_CTRL, RK_CRYPTO_HASH_START |
+					  _SBF(RK_CRYPTO_HASH_START, 16));
+	return 0;
+}
+
+int rk_ahash_start(struct rk_crypto_info *dev)
+{
+	struct ahash_request *req = ahash_request_cast(dev->async_req);
+
+	dev->total = req->nbytes;
+	dev->left_bytes = req->nbytes;
+	dev->first_src = req->src;
+	dev->sg_src = req->src;
+	dev->src_nents = sg_nents(req->src);
+	dev->first_dst = NULL;
+	dev->sg_dst = NULL;
+	dev->dst_nents = 0;
+	/* the engine reads whole words from each entry */
+	dev->aligned = rk_crypto_check_alignment(req->src, NULL, req->nbytes,
+						 sizeof(u32));
+
+	rk_ahash_reg_init(dev);
+	return rk_ahash_set_data_start(dev);
+}
+
+/* called by the done tasklet after each transfer */
+int rk_ahash_rx(struct rk_crypto_info *dev)
+{
+	struct ahash_request *req = ahash_request_cast(dev->async_req);
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
+	u32 sts;
+	int err;
+
+	rk_crypto_unload_data(dev);
+
+	if (dev->left_bytes) {
+		if (dev->aligned)
+			dev->sg_src = sg_next(dev->sg_src);
+		return rk_ahash_set_data_start(dev);
+	}
+
+	/*
+	 * The DMA is done, the last blocks are still being hashed; that
+	 * only takes a few cycles and there is no interrupt for it.
+	 */
+	err = readl_poll_timeout_atomic(dev->reg + RK_CRYPTO_HASH_STS, sts,
+					sts & RK_CRYPTO_HASH_DONE, 1, 1000);
+	if (err)
+		return err;
+
+	memcpy_fromio(req->result, dev->reg + RK_CRYPTO_HASH_DOUT_0,
+		      crypto_ahash_digestsize(tfm));
+	rk_crypto_request_done(dev, 0);
+	return 0;
+}
+
+static int rk_cra_hash_init(struct crypto_tfm *tfm)
+{
+	struct rk_ahash_ctx *tctx = crypto_tfm_ctx(tfm);
+	struct rk_crypto_tmp *algt;
+	struct ahash_alg *alg = __crypto_ahash_alg(tfm->__crt_alg);
+	const char *alg_name = crypto_tfm_alg_name(tfm);
+
+	algt = container_of(alg, struct rk_crypto_tmp, alg.hash);
+
+	tctx->dev = algt->dev;
+
+	/* a synchronous fallback, so that its state is ours to export */
+	tctx->fallback_tfm = crypto_alloc_ahash(alg_name, 0,
+						CRYPTO_ALG_ASYNC |
+						CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(tctx->fallback_tfm)) {
+		dev_err(tctx->dev->dev, "Could not load fallback driver.\n");
+		return PTR_ERR(tctx->fallback_tfm);
+	}
+	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
+				 sizeof(struct rk_ahash_rctx) +
+				 crypto_ahash_reqsize(tctx->fallback_tfm));
+
+	return 0;
+}
+
+static void rk_cra_hash_exit(struct crypto_tfm *tfm)
+{
+	struct rk_ahash_ctx *tctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_ahash(tctx->fallback_tfm);
+}
+
+/* above the NEON implementations */
+#define RK_HASH_PRIORITY	300
+
+#define RK_AHASH_ALG(_name, _drv, _digest, _block, _state)		\
+{									\
+	.type = ALG_TYPE_HASH,						\
+	.alg.hash = {							\
+		.init = rk_ahash_init,					\
+		.update = rk_ahash_update,				\
+		.final = rk_ahash_final,				\
+		.finup = rk_ahash_finup,				\
+		.export = rk_ahash_export,				\
+		.import = rk_ahash_import,				\
+		.digest = rk_ahash_digest,				\
+		.halg = {						\
+			.digestsize = _digest,				\
+			.statesize = sizeof(_state),			\
+			.base = {					\
+				.cra_name = _name,			\
+				.cra_driver_name = _drv,		\
+				.cra_priority = RK_HASH_PRIORITY,	\
+				.cra_flags = CRYPTO_ALG_ASYNC |		\
+					     CRYPTO_ALG_NEED_FALLBACK,	\
+				.cra_blocksize = _block,		\
+				.cra_ctxsize = sizeof(struct rk_ahash_ctx), \
+				.cra_alignmask = 3,			\
+				.cra_init = rk_cra_hash_init,		\
+				.cra_exit = rk_cra_hash_exit,		\
+				.cra_module = THIS_MODULE,		\
+			}						\
+		}							\
+	}								\
+}
+
+struct rk_crypto_tmp rk_ahash_sha1 =
+	RK_AHASH_ALG("sha1", "rk-sha1", SHA1_DIGEST_SIZE,
+		     SHA1_BLOCK_SIZE, struct sha1_state);
+
+struct rk_crypto_tmp rk_ahash_sha256 =
+	RK_AHASH_ALG("sha256", "rk-sha256", SHA256_DIGEST_SIZE,
+		     SHA256_BLOCK_SIZE, struct sha256_state);
+
+struct rk_crypto_tmp rk_ahash_md5 =
+	RK_AHASH_ALG("md5", "rk-md5", MD5_DIGEST_SIZE,
+		     MD5_HMAC_BLOCK_SIZE, struct md5_state);
@@ -0,0 +1,103 @@
+/*
+ * Crypto acceleration support for Rockchip RK3288
+ *
+ * True random number generator, exposed through the hwrng core.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include "rk3288_crypto.h"
+#include <linux/hw_random.h>
+#include <linux/iopoll.h>
+
+/*
+ * The TRNG samples a ring oscillator and hands out 256 bits per run. It
+ * only shares the START/FLUSH bits of RK_CRYPTO_CTRL with the cipher and
+ * hash engines, and those are written through the write mask, so it can
+ * run while the engine is busy with a request.
+ */
+
+/* oscillator cycles per sampled bit, as recommended by the TRM */
+#define RK_TRNG_SAMPLE_PERIOD		100
+#define RK_TRNG_TIMEOUT_US		1000
+
+static struct rk_crypto_info *to_rk_crypto(struct hwrng *rng)
+{
+	return container_of(rng, struct rk_crypto_info, trng);
+}
+
+static int rk_trng_init(struct hwrng *rng)
+{
+	struct rk_crypto_info *dev = to_rk_crypto(rng);
+
+	CRYPTO_WRITE(dev, RK_CRYPTO_TRNG_CTRL, RK_CRYPTO_TRNG_OSC_ENABLE |
+		     RK_CRYPTO_TRNG_SAMPLE_PERIOD(RK_TRNG_SAMPLE_PERIOD));
+	return 0;
+}
+
+static void rk_trng_cleanup(struct hwrng *rng)
+{
+	struct rk_crypto_info *dev = to_rk_crypto(rng);
+
+	CRYPTO_WRITE(dev, RK_CRYPTO_TRNG_CTRL, 0);
+}
+
+/*
+ * Runs the generator as often as it takes to fill @max bytes, so that the
+ * hwrng core's batched fill gets a whole buffer from a single call.
+ */
+static int rk_trng_read(struct hwrng *rng, void *data, size_t max, bool wait)
+{
+	struct rk_crypto_info *dev = to_rk_crypto(rng);
+	unsigned long delay_us = wait ? 10 : 0;
+	u32 buf[RK_CRYPTO_TRNG_DOUT_WORDS];
+	size_t len, ret = 0;
+	u32 ctrl;
+	int i, err = 0;
+
+	while (max) {
+		CRYPTO_WRITE(dev, RK_CRYPTO_CTRL, RK_CRYPTO_TRNG_START |
+			     _SBF(RK_CRYPTO_TRNG_START, 16));
+
+		err = readl_relaxed_poll_timeout(dev->reg + RK_CRYPTO_CTRL,
+						 ctrl,
+						 !(ctrl & RK_CRYPTO_TRNG_START),
+						 delay_us, RK_TRNG_TIMEOUT_US);
+		if (err)
+			break;
+
+		for (i = 0; i < RK_CRYPTO_TRNG_DOUT_WORDS; i++)
+			buf[i] = CRYPTO_READ(dev, RK_CRYPTO_TRNG_DOUT_0 + 4 * i);
+
+		len = min(max, sizeof(buf));
+		memcpy(data + ret, buf, len);
+		ret += len;
+		max -= len;
+
+		if (!wait)
+			break;
+	}
+
+	memzero_explicit(buf, sizeof(buf));
+
+	if (!ret && err) {
+		dev_warn(dev->dev, "TRNG timed out\n");
+		return err;
+	}
+
+	return ret;
+}
+
+int rk_crypto_trng_register(struct rk_crypto_info *dev)
+{
+	dev->trng.name = dev_name(dev->dev);
+	dev->trng.init = rk_trng_init;
+	dev->trng.cleanup = rk_trng_cleanup;
+	dev->trng.read = rk_trng_read;
+	/* entropy per mill of output, what the vendor kernel uses */
+	dev->trng.quality = 900;
+
+	return devm_hwrng_register(dev->dev, &dev->trng);
+}
@@ -0,0 +1,189 @@
+/*
+ * rockchip-dfi.c - Rockchip DFI (DDR PHY interface) monitor support
+ *
+ * The DDR monitor sits on the DFI bus between each memory controller
+ * channel and its PHY and counts the read, write and activate commands
+ * as well as the DFI clock cycles. Its controls and counters live in the
+ * GRF.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/devfreq-event.h>
+#include <linux/kernel.h>
+#include <linux/mfd/syscon.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <linux/regmap.h>
+
+#define RK3288_DFI_CHANNELS		2
+
+#define RK3288_GRF_SOC_CON4		0x254
+#define RK3288_DFI_EN			BIT(15)
+#define RK3288_DFI_LPDDR_SEL		BIT(13)
+/* per channel: write, read, activate and DFI clock counts */
+#define RK3288_GRF_SOC_STATUS_WR(ch)	(0x2ac + (ch) * 0x10)
+#define RK3288_GRF_SOC_STATUS_RD(ch)	(0x2b0 + (ch) * 0x10)
+#define RK3288_GRF_SOC_STATUS_ACT(ch)	(0x2b4 + (ch) * 0x10)
+#define RK3288_GRF_SOC_STATUS_CNT(ch)	(0x2b8 + (ch) * 0x10)
+
+#define RK3288_PMU_SYS_REG2		0x9c
+#define RK3288_PMU_DDR_TYPE(v)		(((v) >> 13) & 0x7)
+#define RK3288_DDR_TYPE_LPDDR3		6
+
+/* the upper half of GRF registers selects which bits are written */
+#define HIWORD_UPDATE(val, mask)	((val) | (mask) << 16)
+
+struct rockchip_dfi {
+	struct devfreq_event_dev *edev;
+	struct devfreq_event_desc desc;
+	struct device *dev;
+	struct regmap *grf;
+	bool lpddr;
+};
+
+static void rockchip_dfi_start(struct rockchip_dfi *dfi)
+{
+	u32 sel = dfi->lpddr ? RK3288_DFI_LPDDR_SEL : 0;
+
+	regmap_write(dfi->grf, RK3288_GRF_SOC_CON4,
+		     HIWORD_UPDATE(RK3288_DFI_EN | sel,
+				   RK3288_DFI_EN | RK3288_DFI_LPDDR_SEL));
+}
+
+static void rockchip_dfi_stop(struct rockchip_dfi *dfi)
+{
+	regmap_write(dfi->grf, RK3288_GRF_SOC_CON4,
+		     HIWORD_UPDATE(0, RK3288_DFI_EN));
+}
+
+static int rockchip_dfi_disable(struct devfreq_event_dev *edev)
+{
+	struct rockchip_dfi *dfi = devfreq_event_get_drvdata(edev);
+
+	rockchip_dfi_stop(dfi);
+
+	return 0;
+}
+
+static int rockchip_dfi_enable(struct devfreq_event_dev *edev)
+{
+	struct rockchip_dfi *dfi = devfreq_event_get_drvdata(edev);
+
+	rockchip_dfi_start(dfi);
+
+	return 0;
+}
+
+static int rockchip_dfi_set_event(struct devfreq_event_dev *edev)
+{
+	return 0;
+}
+
+/*
+ * Report the busier channel: every read or write is a burst of 8 on the
+ * DDR bus, which takes 4 DFI clock cycles. The counters restart from
+ * zero whenever the monitor is re-enabled, which starts the next period.
+ */
+static int rockchip_dfi_get_event(struct devfreq_event_dev *edev,
+				  struct devfreq_event_data *edata)
+{
+	struct rockchip_dfi *dfi = devfreq_event_get_drvdata(edev);
+	u32 rd, wr, cnt;
+	int ch;
+
+	edata->load_count = 0;
+	edata->total_count = 1;
+
+	rockchip_dfi_stop(dfi);
+
+	for (ch = 0; ch < RK3288_DFI_CHANNELS; ch++) {
+		unsigned long load;
+
+		regmap_read(dfi->grf, RK3288_GRF_SOC_STATUS_RD(ch), &rd);
+		regmap_read(dfi->grf, RK3288_GRF_SOC_STATUS_WR(ch), &wr);
+		regmap_read(dfi->grf, RK3288_GRF_SOC_STATUS_CNT(ch), &cnt);
+
+		load = ((unsigned long)rd + wr) * 4;
+		if (cnt && load * edata->total_count >
+			   edata->load_count * cnt) {
+			edata->load_count = load;
+			edata->total_count = cnt;
+		}
+	}
+
+	rockchip_dfi_start(dfi);
+
+	return 0;
+}
+
+static const struct devfreq_event_ops rockchip_dfi_ops = {
+	.disable = rockchip_dfi_disable,
+	.enable = rockchip_dfi_enable,
+	.get_event = rockchip_dfi_get_event,
+	.set_event = rockchip_dfi_set_event,
+};
+
+static const struct of_device_id rockchip_dfi_id_match[] = {
+	{ .compatible = "rockchip,rk3288-dfi" },
+	{ },
+};
+MODULE_DEVICE_TABLE(of, rockchip_dfi_id_match);
+
+static int rockchip_dfi_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct device_node *np = dev->of_node;
+	struct rockchip_dfi *dfi;
+	struct regmap *pmu;
+	u32 val;
+
+	dfi = devm_kzalloc(dev, sizeof(*dfi), GFP_KERNEL);
+	if (!dfi)
+		return -ENOMEM;
+
+	dfi->grf = syscon_regmap_lookup_by_phandle(np, "rockchip,grf");
+	if (IS_ERR(dfi->grf)) {
+		dev_err(dev, "failed to get the GRF\n");
+		return PTR_ERR(dfi->grf);
+	}
+
+	/* the loader records the DRAM type in the PMU */
+	pmu = syscon_regmap_lookup_by_phandle(np, "rockchip,pmu");
+	if (IS_ERR(pmu)) {
+		dev_err(dev, "failed to get the PMU\n");
+		return PTR_ERR(pmu);
+	}
+	regmap_read(pmu, RK3288_PMU_SYS_REG2, &val);
+	dfi->lpddr = RK3288_PMU_DDR_TYPE(val) == RK3288_DDR_TYPE_LPDDR3;
+
+	dfi->dev = dev;
+	dfi->desc.name = np->name;
+	dfi->desc.ops = &rockchip_dfi_ops;
+	dfi->desc.driver_data = dfi;
+
+	dfi->edev = devm_devfreq_event_add_edev(dev, &dfi->desc);
+	if (IS_ERR(dfi->edev)) {
+		dev_err(dev, "failed to add devfreq-event device\n");
+		return PTR_ERR(dfi->edev);
+	}
+
+	platform_set_drvdata(pdev, dfi);
+
+	return 0;
+}
+
+static struct platform_driver rockchip_dfi_driver = {
+	.probe	= rockchip_dfi_probe,
+	.driver = {
+		.name	= "rockchip-dfi",
+		.of_match_table = rockchip_dfi_id_match,
+	},
+};
+module_platform_driver(rockchip_dfi_driver);
+
+MODULE_DESCRIPTION("Rockchip DFI (DDR PHY interface) monitor driver");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,416 @@
+/*
+ * Rockchip RK3288 DDR memory controller frequency scaling
+ *
+ * The load is measured by the DFI monitor (a devfreq-event device), the
+ * frequency is set through the DDR clock, whose provider takes care of
+ * putting the memory into self-refresh and retraining the PHY, and the
+ * "center" supply is raised and lowered with it.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/clk.h>
+#include <linux/completion.h>
+#include <linux/devfreq.h>
+#include <linux/devfreq-event.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <linux/pm_opp.h>
+#include <linux/regulator/consumer.h>
+#include <linux/spinlock.h>
+
+#include <soc/rockchip/rockchip_dmc.h>
+
+/* how often to look for a vblank that leaves enough time to retrain */
+#define RK3288_DMC_VBLANK_TRIES		4
+#define RK3288_DMC_VBLANK_TIMEOUT_MS	100
+
+struct rk3288_dmcfreq {
+	struct device *dev;
+	struct devfreq *devfreq;
+	struct devfreq_simple_ondemand_data ondemand_data;
+	struct devfreq_event_dev *edev;
+	struct clk *dmc_clk;
+	struct regulator *vdd_center;
+	/* serializes rate changes */
+	struct mutex lock;
+	unsigned long rate;
+	unsigned long volt;
+	/* time the DDR is unavailable during a rate change */
+	unsigned int retrain_us;
+};
+
+/*
+ * The display controllers scanning out, see rockchip_dmc.h. They are
+ * global rather than per DMC instance, since the VOPs come and go
+ * independently of this driver.
+ */
+static DEFINE_SPINLOCK(rk3288_dmc_vop_lock);
+static LIST_HEAD(rk3288_dmc_vops);
+static struct rockchip_dmc_vop *rk3288_dmc_vop_waiting;
+static DECLARE_COMPLETION(rk3288_dmc_vblank_done);
+
+void rockchip_dmc_vop_enable(struct rockchip_dmc_vop *vop)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&rk3288_dmc_vop_lock, flags);
+	list_add_tail(&vop->node, &rk3288_dmc_vops);
+	spin_unlock_irqrestore(&rk3288_dmc_vop_lock, flags);
+}
+EXPORT_SYMBOL_GPL(rockchip_dmc_vop_enable);
+
+void rockchip_dmc_vop_disable(struct rockchip_dmc_vop *vop)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&rk3288_dmc_vop_lock, flags);
+	list_del(&vop->node);
+	/* release a rate change waiting for a vblank that won't come */
+	if (rk3288_dmc_vop_waiting == vop) {
+		rk3288_dmc_vop_waiting = NULL;
+		complete(&rk3288_dmc_vblank_done);
+	}
+	spin_unlock_irqrestore(&rk3288_dmc_vop_lock, flags);
+}
+EXPORT_SYMBOL_GPL(rockchip_dmc_vop_disable);
+
+/* called from the VOP's frame start interrupt */
+void rockchip_dmc_vblank(struct rockchip_dmc_vop *vop)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&rk3288_dmc_vop_lock, flags);
+	if (rk3288_dmc_vop_waiting == vop) {
+		vop->vblank_time = ktime_get();
+		rk3288_dmc_vop_waiting = NULL;
+		complete(&rk3288_dmc_vblank_done);
+	}
+	spin_unlock_irqrestore(&rk3288_dmc_vop_lock, flags);
+}
+EXPORT_SYMBOL_GPL(rockchip_dmc_vblank);
+
+/*
+ * Wait until the single active VOP has just started its vertical blanking,
+ * and there is still time to retrain before it fetches the next line. With
+ * nothing scanning out this returns right away; with more than one VOP
+ * their blanking periods do not line up, so the rate is left alone.
+ *
+ * On success this returns with preemption disabled, so that nothing gets
+ * scheduled between the check of the remaining blanking time and the rate
+ * switch; the caller enables it again once the rate is set.  The dmc_clk
+ * provider runs the switch from SRAM with interrupts off and must not
+ * sleep in its set_rate.
+ */
+static int rk3288_dmcfreq_wait_vblank(struct rk3288_dmcfreq *dmcfreq)
+{
+	struct rockchip_dmc_vop *vop;
+	unsigned long timeout = msecs_to_jiffies(RK3288_DMC_VBLANK_TIMEOUT_MS);
+	unsigned long flags;
+	int i, ret = -ETIMEDOUT;
+
+	spin_lock_irqsave(&rk3288_dmc_vop_lock, flags);
+	if (list_empty(&rk3288_dmc_vops)) {
+		spin_unlock_irqrestore(&rk3288_dmc_vop_lock, flags);
+		preempt_disable();
+		return 0;
+	}
+	vop = list_first_entry(&rk3288_dmc_vops, struct rockchip_dmc_vop,
+			       node);
+	if (!list_is_singular(&rk3288_dmc_vops) ||
+	    vop->vblank_us <= dmcfreq->retrain_us) {
+		spin_unlock_irqrestore(&rk3288_dmc_vop_lock, flags);
+		return -EBUSY;
+	}
+	spin_unlock_irqrestore(&rk3288_dmc_vop_lock, flags);
+
+	if (vop->vblank_irq(vop, true))
+		return -EBUSY;
+
+	for (i = 0; i < RK3288_DMC_VBLANK_TRIES; i++) {
+		spin_lock_irqsave(&rk3288_dmc_vop_lock, flags);
+		if (list_empty(&rk3288_dmc_vops) ||
+		    list_first_entry(&rk3288_dmc_vops, struct rockchip_dmc_vop,
+				     node) != vop) {
+			/* the VOP went away, the next poll starts over */
+			spin_unlock_irqrestore(&rk3288_dmc_vop_lock, flags);
+			break;
+		}
+		reinit_completion(&rk3288_dmc_vblank_done);
+		rk3288_dmc_vop_waiting = vop;
+		spin_unlock_irqrestore(&rk3288_dmc_vop_lock, flags);
+
+		if (!wait_for_completion_timeout(&rk3288_dmc_vblank_done,
+						 timeout)) {
+			spin_lock_irqsave(&rk3288_dmc_vop_lock, flags);
+			rk3288_dmc_vop_waiting = NULL;
+			spin_unlock_irqrestore(&rk3288_dmc_vop_lock, flags);
+			break;
+		}
+
+		preempt_disable();
+		if (ktime_us_delta(ktime_get(), vop->vblank_time) +
+		    dmcfreq->retrain_us < vop->vblank_us) {
+			ret = 0;
+			break;
+		}
+		preempt_enable();
+	}
+
+	vop->vblank_irq(vop, false);
+
+	return ret;
+}
+
+static int rk3288_dmcfreq_target(struct device *dev, unsigned long *freq,
+				 u32 flags)
+{
+	struct rk3288_dmcfreq *dmcfreq = dev_get_drvdata(dev);
+	struct dev_pm_opp *opp;
+	unsigned long rate, volt;
+	int err;
+
+	rcu_read_lock();
+	opp = devfreq_recommended_opp(dev, freq, flags);
+	if (IS_ERR(opp)) {
+		rcu_read_unlock();
+		return PTR_ERR(opp);
+	}
+	rate = dev_pm_opp_get_freq(opp);
+	volt = dev_pm_opp_get_voltage(opp);
+	rcu_read_unlock();
+
+	if (rate == dmcfreq->rate)
+		return 0;
+
+	mutex_lock(&dmcfreq->lock);
+
+	if (rate > dmcfreq->rate) {
+		err = regulator_set_voltage(dmcfreq->vdd_center, volt, volt);
+		if (err) {
+			dev_err(dev, "cannot set voltage %lu uV: %d\n",
+				volt, err);
+			goto out;
+		}
+	}
+
+	err = rk3288_dmcfreq_wait_vblank(dmcfreq);
+	if (!err) {
+		err = clk_set_rate(dmcfreq->dmc_clk, rate);
+		preempt_enable();
+	}
+	if (err) {
+		/* keep the supply for the rate we are still running at */
+		if (rate > dmcfreq->rate)
+			regulator_set_voltage(dmcfreq->vdd_center,
+					      dmcfreq->volt, dmcfreq->volt);
+		*freq = dmcfreq->rate;
+		if (err == -EBUSY || err == -ETIMEDOUT) {
+			/* no usable vblank, postponed to the next poll */
+			dev_dbg(dev, "rate change to %lu postponed\n", rate);
+			err = 0;
+		} else {
+			dev_err(dev, "cannot set rate %lu: %d\n", rate, err);
+		}
+		goto out;
+	}
+
+	if (rate < dmcfreq->rate) {
+		err = regulator_set_voltage(dmcfreq->vdd_center, volt, volt);
+		if (err)
+			dev_err(dev, "cannot set voltage %lu uV: %d\n",
+				volt, err);
+	}
+
+	dmcfreq->rate = clk_get_rate(dmcfreq->dmc_clk);
+	dmcfreq->volt = volt;
+	*freq = dmcfreq->rate;
+out:
+	mutex_unlock(&dmcfreq->lock);
+	return err;
+}
+
+static int rk3288_dmcfreq_get_dev_status(struct device *dev,
+					 struct devfreq_dev_status *stat)
+{
+	struct rk3288_dmcfreq *dmcfreq = dev_get_drvdata(dev);
+	struct devfreq_event_data edata;
+	int err;
+
+	err = devfreq_event_get_event(dmcfreq->edev, &edata);
+	if (err < 0)
+		return err;
+
+	stat->current_frequency = dmcfreq->rate;
+	stat->busy_time = edata.load_count;
+	stat->total_time = edata.total_count;
+
+	return 0;
+}
+
+static int rk3288_dmcfreq_get_cur_freq(struct device *dev,
+				       unsigned long *freq)
+{
+	struct rk3288_dmcfreq *dmcfreq = dev_get_drvdata(dev);
+
+	*freq = dmcfreq->rate;
+
+	return 0;
+}
+
+static struct devfreq_dev_profile rk3288_devfreq_dmc_profile = {
+	.polling_ms	= 200,
+	.target		= rk3288_dmcfreq_target,
+	.get_dev_status	= rk3288_dmcfreq_get_dev_status,
+	.get_cur_freq	= rk3288_dmcfreq_get_cur_freq,
+};
+
+static int rk3288_dmcfreq_suspend(struct device *dev)
+{
+	struct rk3288_dmcfreq *dmcfreq = dev_get_drvdata(dev);
+	int err;
+
+	err = devfreq_event_disable_edev(dmcfreq->edev);
+	if (err < 0)
+		return err;
+
+	return devfreq_suspend_device(dmcfreq->devfreq);
+}
+
+static int rk3288_dmcfreq_resume(struct device *dev)
+{
+	struct rk3288_dmcfreq *dmcfreq = dev_get_drvdata(dev);
+	int err;
+
+	err = devfreq_event_enable_edev(dmcfreq->edev);
+	if (err < 0)
+		return err;
+
+	return devfreq_resume_device(dmcfreq->devfreq);
+}
+
+static SIMPLE_DEV_PM_OPS(rk3288_dmcfreq_pm, rk3288_dmcfreq_suspend,
+			 rk3288_dmcfreq_resume);
+
+static int rk3288_dmcfreq_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct device_node *np = dev->of_node;
+	struct rk3288_dmcfreq *dmcfreq;
+	struct dev_pm_opp *opp;
+	int err;
+
+	dmcfreq = devm_kzalloc(dev, sizeof(*dmcfreq), GFP_KERNEL);
+	if (!dmcfreq)
+		return -ENOMEM;
+
+	mutex_init(&dmcfreq->lock);
+	dmcfreq->dev = dev;
+
+	dmcfreq->vdd_center = devm_regulator_get(dev, "center");
+	if (IS_ERR(dmcfreq->vdd_center)) {
+		dev_err(dev, "cannot get the center supply\n");
+		return PTR_ERR(dmcfreq->vdd_center);
+	}
+
+	dmcfreq->dmc_clk = devm_clk_get(dev, "dmc_clk");
+	if (IS_ERR(dmcfreq->dmc_clk)) {
+		dev_err(dev, "cannot get the DDR clock\n");
+		return PTR_ERR(dmcfreq->dmc_clk);
+	}
+
+	dmcfreq->edev = devfreq_event_get_edev_by_phandle(dev, 0);
+	if (IS_ERR(dmcfreq->edev))
+		return PTR_ERR(dmcfreq->edev);
+
+	/* a conservative default for DDR3 at the lowest rates */
+	dmcfreq->retrain_us = 300;
+	of_property_read_u32(np, "rockchip,retrain-time-us",
+			     &dmcfreq->retrain_us);
+	of_property_read_u32(np, "upthreshold",
+			     &dmcfreq->ondemand_data.upthreshold);
+	of_property_read_u32(np, "downdifferential",
+			     &dmcfreq->ondemand_data.downdifferential);
+
+	err = of_init_opp_table(dev);
+	if (err) {
+		dev_err(dev, "invalid operating-points in device tree\n");
+		return err;
+	}
+
+	dmcfreq->rate = clk_get_rate(dmcfreq->dmc_clk);
+
+	rcu_read_lock();
+	opp = devfreq_recommended_opp(dev, &dmcfreq->rate, 0);
+	if (IS_ERR(opp)) {
+		rcu_read_unlock();
+		err = PTR_ERR(opp);
+		goto err_free_opp;
+	}
+	dmcfreq->rate = dev_pm_opp_get_freq(opp);
+	dmcfreq->volt = dev_pm_opp_get_voltage(opp);
+	rcu_read_unlock();
+
+	err = devfreq_event_enable_edev(dmcfreq->edev);
+	if (err < 0) {
+		dev_err(dev, "failed to enable the DFI monitor\n");
+		goto err_free_opp;
+	}
+
+	platform_set_drvdata(pdev, dmcfreq);
+
+	rk3288_devfreq_dmc_profile.initial_freq = dmcfreq->rate;
+	dmcfreq->devfreq = devm_devfreq_add_device(dev,
+					&rk3288_devfreq_dmc_profile,
+					"simple_ondemand",
+					&dmcfreq->ondemand_data);
+	if (IS_ERR(dmcfreq->devfreq)) {
+		err = PTR_ERR(dmcfreq->devfreq);
+		goto err_disable_edev;
+	}
+
+	devm_devfreq_register_opp_notifier(dev, dmcfreq->devfreq);
+
+	return 0;
+
+err_disable_edev:
+	devfreq_event_disable_edev(dmcfreq->edev);
+err_free_opp:
+	of_free_opp_table(dev);
+	return err;
+}
+
+static int rk3288_dmcfreq_remove(struct platform_device *pdev)
+{
+	struct rk3288_dmcfreq *dmcfreq = platform_get_drvdata(pdev);
+
+	devm_devfreq_remove_device(&pdev->dev, dmcfreq->devfreq);
+	devfreq_event_disable_edev(dmcfreq->edev);
+	of_free_opp_table(&pdev->dev);
+
+	return 0;
+}
+
+static const struct of_device_id rk3288_dmcfreq_of_match[] = {
+	{ .compatible = "rockchip,rk3288-dmc" },
+	{ },
+};
+MODULE_DEVICE_TABLE(of, rk3288_dmcfreq_of_match);
+
+static struct platform_driver rk3288_dmcfreq_driver = {
+	.probe	= rk3288_dmcfreq_probe,
+	.remove	= rk3288_dmcfreq_remove,
+	.driver = {
+		.name	= "rk3288-dmc-freq",
+		.pm	= &rk3288_dmcfreq_pm,
+		.of_match_table = rk3288_dmcfreq_of_match,
+	},
+};
+module_platform_driver(rk3288_dmcfreq_driver);
+
+MODULE_DESCRIPTION("RK3288 DDR memory controller frequency scaling");
+MODULE_LICENSE("GPL v2");
@@ -19,9 +19,11 @@
 #include <linux/mutex.h>
 #include <linux/of_device.h>
 #include <linux/spinlock.h>
+#include <linux/workqueue.h>
 
 #include <drm/drm_of.h>
 #include <drm/drmP.h>
+#include <drm/drm_atomic_helper.h>
 #include <drm/drm_crtc_helper.h>
 #include <drm/drm_edid.h>
 #include <drm/drm_encoder_slave.h>
@@ -29,7 +31,8 @@
 
 #include "dw_hdmi.h"
 
-#define HDMI_EDID_LEN		512
+/* keep the PHY running this long after disable, for quick re-enables */
+#define HDMI_PHY_OFF_DELAY	msecs_to_jiffies(1000)
 
 #define RGB			0
 #define YCBCR444		1
@@ -114,10 +117,17 @@ struct dw_hdmi {
 
 	int vic;
 
-	u8 edid[HDMI_EDID_LEN];
+	/* EDID of the attached sink, dropped on every hotplug event */
+	struct edid *edid;
 	bool cable_plugin;
 
 	bool phy_enabled;
+	/* settings the running PHY was configured with */
+	const struct dw_hdmi_mpll_config *phy_mpll_config;
+	const struct dw_hdmi_curr_ctrl *phy_curr_ctrl;
+	const struct dw_hdmi_phy_config *phy_config;
+	bool phy_cscon;
+	struct delayed_work phy_off_work;
 	struct drm_display_mode previous_mode;
 
 	struct i2c_adapter *ddc;
@@ -789,34 +799,16 @@ static void dw_hdmi_phy_sel_interface_control(struct dw_hdmi *hdmi, u8 enable)
 			 HDMI_PHY_CONF0_SELDIPIF_MASK);
 }
 
-static int hdmi_phy_configure(struct dw_hdmi *hdmi, unsigned char prep,
-			      unsigned char res, int cscon)
+static int hdmi_phy_lookup(struct dw_hdmi *hdmi,
+			   const struct dw_hdmi_mpll_config **mpll,
+			   const struct dw_hdmi_curr_ctrl **curr,
+			   const struct dw_hdmi_phy_config **phy)
 {
-	unsigned res_idx;
-	u8 val, msec;
 	const struct dw_hdmi_plat_data *pdata = hdmi->plat_data;
 	const struct dw_hdmi_mpll_config *mpll_config = pdata->mpll_cfg;
 	const struct dw_hdmi_curr_ctrl *curr_ctrl = pdata->cur_ctr;
 	const struct dw_hdmi_phy_config *phy_config = pdata->phy_config;
 
-	if (prep)
-		return -EINVAL;
-
-	switch (res) {
-	case 0:	/* color resolution 0 is 8 bit colour depth */
-	case 8:
-		res_idx = DW_HDMI_RES_8;
-		break;
-	case 10:
-		res_idx = DW_HDMI_RES_10;
-		break;
-	case 12:
-		res_idx = DW_HDMI_RES_12;
-		break;
-	default:
-		return -EINVAL;
-	}
-
 	/* PLL/MPLL Cfg - always match on final entry */
 	for (; mpll_config->mpixelclock != ~0UL; mpll_config++)
 		if (hdmi->hdmi_data.video_mode.mpixelclock <=
@@ -841,6 +833,68 @@ static int hdmi_phy_configure(struct dw_hdmi *hdmi, unsigned char prep,
 		return -EINVAL;
 	}
 
+	*mpll = mpll_config;
+	*curr = curr_ctrl;
+	*phy = phy_config;
+
+	return 0;
+}
+
+static int hdmi_phy_wait_lock(struct dw_hdmi *hdmi)
+{
+	u8 val, msec;
+
+	/*Wait for PHY PLL lock */
+	msec = 5;
+	do {
+		val = hdmi_readb(hdmi, HDMI_PHY_STAT0) & HDMI_PHY_TX_PHY_LOCK;
+		if (!val)
+			break;
+
+		if (msec == 0) {
+			dev_err(hdmi->dev, "PHY PLL not locked\n");
+			return -ETIMEDOUT;
+		}
+
+		udelay(1000);
+		msec--;
+	} while (1);
+
+	return 0;
+}
+
+static int hdmi_phy_configure(struct dw_hdmi *hdmi, unsigned char prep,
+			      unsigned char res, int cscon)
+{
+	unsigned res_idx;
+	u8 val;
+	const struct dw_hdmi_mpll_config *mpll_config;
+	const struct dw_hdmi_curr_ctrl *curr_ctrl;
+	const struct dw_hdmi_phy_config *phy_config;
+	int ret;
+
+	if (prep)
+		return -EINVAL;
+
+	switch (res) {
+	case 0:	/* color resolution 0 is 8 bit colour depth */
+	case 8:
+		res_idx = DW_HDMI_RES_8;
+		break;
+	case 10:
+		res_idx = DW_HDMI_RES_10;
+		break;
+	case 12:
+		res_idx = DW_HDMI_RES_12;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	ret = hdmi_phy_lookup(hdmi, &mpll_config, &curr_ctrl, &phy_config);
+	if (ret)
+		return ret;
+
 	/* Enable csc path */
 	if (cscon)
 		val = HDMI_MC_FLOWCTRL_FEED_THROUGH_OFF_CSC_IN_PATH;
@@ -895,25 +949,40 @@ static int hdmi_phy_configure(struct dw_hdmi *hdmi, unsigned char prep,
 	if (hdmi->dev_type == RK3288_HDMI)
 		dw_hdmi_phy_enable_spare(hdmi, 1);
 
-	/*Wait for PHY PLL lock */
-	msec = 5;
-	do {
-		val = hdmi_readb(hdmi, HDMI_PHY_STAT0) & HDMI_PHY_TX_PHY_LOCK;
-		if (!val)
-			break;
-
-		if (msec == 0) {
-			dev_err(hdmi->dev, "PHY PLL not locked\n");
-			return -ETIMEDOUT;
-		}
+	ret = hdmi_phy_wait_lock(hdmi);
+	if (ret)
+		return ret;
 
-		udelay(1000);
-		msec--;
-	} while (1);
+	hdmi->phy_mpll_config = mpll_config;
+	hdmi->phy_curr_ctrl = curr_ctrl;
+	hdmi->phy_config = phy_config;
 
 	return 0;
 }
 
+/*
+ * The PHY settings only depend on the pixel clock band. While the PHY is
+ * still running with the settings of the band of the new mode, its MPLL
+ * follows the new pixel clock by itself and the reset and reprogramming
+ * sequence through the PHY I2C master can be skipped.
+ */
+static bool dw_hdmi_phy_can_reuse(struct dw_hdmi *hdmi, bool cscon)
+{
+	const struct dw_hdmi_mpll_config *mpll_config;
+	const struct dw_hdmi_curr_ctrl *curr_ctrl;
+	const struct dw_hdmi_phy_config *phy_config;
+
+	if (!hdmi->phy_enabled || cscon != hdmi->phy_cscon)
+		return false;
+
+	if (hdmi_phy_lookup(hdmi, &mpll_config, &curr_ctrl, &phy_config))
+		return false;
+
+	return mpll_config == hdmi->phy_mpll_config &&
+	       curr_ctrl == hdmi->phy_curr_ctrl &&
+	       phy_config == hdmi->phy_config;
+}
+
 static int dw_hdmi_phy_init(struct dw_hdmi *hdmi)
 {
 	int i, ret;
@@ -922,6 +991,16 @@ static int dw_hdmi_phy_init(struct dw_hdmi *hdmi)
 	/*check csc whether needed activated in HDMI mode */
 	cscon = hdmi->sink_is_hdmi && is_color_space_conversion(hdmi);
 
+	if (dw_hdmi_phy_can_reuse(hdmi, cscon)) {
+		dw_hdmi_phy_enable_tmds(hdmi, 1);
+		dw_hdmi_phy_gen2_txpwron(hdmi, 1);
+
+		if (!hdmi_phy_wait_lock(hdmi))
+			return 0;
+
+		/* fall back to the full sequence */
+	}
+
 	/* HDMI Phy spec says to do the phy initialization sequence twice */
 	for (i = 0; i < 2; i++) {
 		dw_hdmi_phy_sel_data_en_pol(hdmi, 1);
@@ -935,6 +1014,7 @@ static int dw_hdmi_phy_init(struct dw_hdmi *hdmi)
 			return ret;
 	}
 
+	hdmi->phy_cscon = cscon;
 	hdmi->phy_enabled = true;
 	return 0;
 }
@@ -1372,6 +1452,30 @@ static void dw_hdmi_poweroff(struct dw_hdmi *hdmi)
 	dw_hdmi_phy_disable(hdmi);
 }
 
+/*
+ * Stop driving the link but keep the PHY PLL running, the PHY is only
+ * powered down by phy_off_work if the bridge is not re-enabled first.
+ */
+static void dw_hdmi_blank(struct dw_hdmi *hdmi)
+{
+	if (!hdmi->phy_enabled)
+		return;
+
+	dw_hdmi_phy_gen2_txpwron(hdmi, 0);
+	dw_hdmi_phy_enable_tmds(hdmi, 0);
+}
+
+static void dw_hdmi_phy_off_work(struct work_struct *work)
+{
+	struct dw_hdmi *hdmi = container_of(to_delayed_work(work),
+					    struct dw_hdmi, phy_off_work);
+
+	mutex_lock(&hdmi->mutex);
+	if (hdmi->disabled)
+		dw_hdmi_poweroff(hdmi);
+	mutex_unlock(&hdmi->mutex);
+}
+
 static void dw_hdmi_bridge_mode_set(struct drm_bridge *bridge,
 				    struct drm_display_mode *orig_mode,
 				    struct drm_display_mode *mode)
@@ -1399,14 +1503,18 @@ static void dw_hdmi_bridge_disable(struct drm_bridge *bridge)
 
 	mutex_lock(&hdmi->mutex);
 	hdmi->disabled = true;
-	dw_hdmi_poweroff(hdmi);
+	dw_hdmi_blank(hdmi);
 	mutex_unlock(&hdmi->mutex);
+
+	schedule_delayed_work(&hdmi->phy_off_work, HDMI_PHY_OFF_DELAY);
 }
 
 static void dw_hdmi_bridge_enable(struct drm_bridge *bridge)
 {
 	struct dw_hdmi *hdmi = bridge->driver_private;
 
+	cancel_delayed_work_sync(&hdmi->phy_off_work);
+
 	mutex_lock(&hdmi->mutex);
 	dw_hdmi_poweron(hdmi);
 	hdmi->disabled = false;
@@ -1438,7 +1546,13 @@ static int dw_hdmi_connector_get_modes(struct drm_connector *connector)
 	if (!hdmi->ddc)
 		return 0;
 
-	edid = drm_get_edid(connector, hdmi->ddc);
+	mutex_lock(&hdmi->mutex);
+
+	/* The sink can only change with a hotplug event, which drops it */
+	if (!hdmi->edid)
+		hdmi->edid = drm_get_edid(connector, hdmi->ddc);
+
+	edid = hdmi->edid;
 	if (edid) {
 		dev_dbg(hdmi->dev, "got edid: width[%d] x height[%d]\n",
 			edid->width_cm, edid->height_cm);
@@ -1447,11 +1561,12 @@ static int dw_hdmi_connector_get_modes(struct drm_connector *connector)
 		hdmi->sink_has_audio = drm_detect_monitor_audio(edid);
 		drm_mode_connector_update_edid_property(connector, edid);
 		ret = drm_add_edid_modes(connector, edid);
-		kfree(edid);
 	} else {
 		dev_dbg(hdmi->dev, "failed to get edid\n");
 	}
 
+	mutex_unlock(&hdmi->mutex);
+
 	return ret;
 }
 
@@ -1495,6 +1610,16 @@ static struct drm_connector_funcs dw_hdmi_connector_funcs = {
 	.destroy = dw_hdmi_connector_destroy,
 };
 
+static struct drm_connector_funcs dw_hdmi_atomic_connector_funcs = {
+	.dpms = drm_atomic_helper_connector_dpms,
+	.fill_modes = drm_helper_probe_single_connector_modes,
+	.detect = dw_hdmi_connector_detect,
+	.destroy = dw_hdmi_connector_destroy,
+	.reset = drm_atomic_helper_connector_reset,
+	.atomic_duplicate_state = drm_atomic_helper_connector_duplicate_state,
+	.atomic_destroy_state = drm_atomic_helper_connector_destroy_state,
+};
+
 static struct drm_connector_helper_funcs dw_hdmi_connector_helper_funcs = {
 	.get_modes = dw_hdmi_connector_get_modes,
 	.mode_valid = dw_hdmi_connector_mode_valid,
@@ -1535,6 +1660,8 @@ static irqreturn_t dw_hdmi_irq(int irq, void *dev_id)
 	if (intr_stat & HDMI_IH_PHY_STAT0_HPD) {
 		hdmi_modb(hdmi, ~phy_int_pol, HDMI_PHY_HPD, HDMI_PHY_POL0);
 		mutex_lock(&hdmi->mutex);
+		kfree(hdmi->edid);
+		hdmi->edid = NULL;
 		if (phy_int_pol & HDMI_PHY_HPD) {
 			dev_dbg(hdmi->dev, "EVENT=plugin\n");
 
@@ -1582,8 +1709,14 @@ static int dw_hdmi_register(struct drm_device *drm, struct dw_hdmi *hdmi)
 
 	drm_connector_helper_add(&hdmi->connector,
 				 &dw_hdmi_connector_helper_funcs);
-	drm_connector_init(drm, &hdmi->connector, &dw_hdmi_connector_funcs,
-			   DRM_MODE_CONNECTOR_HDMIA);
+	if (drm_core_check_feature(drm, DRIVER_ATOMIC))
+		drm_connector_init(drm, &hdmi->connector,
+				   &dw_hdmi_atomic_connector_funcs,
+				   DRM_MODE_CONNECTOR_HDMIA);
+	else
+		drm_connector_init(drm, &hdmi->connector,
+				   &dw_hdmi_connector_funcs,
+				   DRM_MODE_CONNECTOR_HDMIA);
 
 	hdmi->connector.encoder = encoder;
 
@@ -1618,6 +1751,7 @@ int dw_hdmi_bind(struct device *dev, struct device *master,
 
 	mutex_init(&hdmi->mutex);
 	mutex_init(&hdmi->audio_mutex);
+	INIT_DELAYED_WORK(&hdmi->phy_off_work, dw_hdmi_phy_off_work);
 	spin_lock_init(&hdmi->audio_lock);
 
 	of_property_read_u32(np, "reg-io-width", &val);
@@ -1741,6 +1875,9 @@ void dw_hdmi_unbind(struct device *dev, struct device *master, void *data)
 	/* Disable all interrupts */
 	hdmi_writeb(hdmi, ~0, HDMI_IH_MUTE_PHY_STAT0);
 
+	cancel_delayed_work_sync(&hdmi->phy_off_work);
+	kfree(hdmi->edid);
+
 	hdmi->connector.funcs->destroy(&hdmi->connector);
 	hdmi->encoder->funcs->destroy(hdmi->encoder);
 
@@ -137,6 +137,9 @@ static int rockchip_drm_load(struct drm_device *drm_dev, unsigned long flags)
 	if (!private)
 		return -ENOMEM;
 
+	mutex_init(&private->commit.lock);
+	INIT_WORK(&private->commit.work, rockchip_drm_atomic_work);
+
 	drm_dev->dev_private = private;
 
 	drm_mode_config_init(drm_dev);
@@ -173,6 +176,9 @@ static int rockchip_drm_load(struct drm_device *drm_dev, unsigned long flags)
 	if (ret)
 		goto err_detach_device;
 
+	/* Build the initial atomic state for all crtcs, planes and connectors */
+	drm_mode_config_reset(drm_dev);
+
 	/*
 	 * All components are now added, we can publish the connector sysfs
 	 * entries to userspace.  This will generate hotplug events and so
@@ -268,12 +274,14 @@ static const struct file_operations rockchip_drm_driver_fops = {
 };
 
 const struct vm_operations_struct rockchip_drm_vm_ops = {
+	.fault = rockchip_gem_fault,
 	.open = drm_gem_vm_open,
 	.close = drm_gem_vm_close,
 };
 
 static struct drm_driver rockchip_drm_driver = {
-	.driver_features	= DRIVER_MODESET | DRIVER_GEM | DRIVER_PRIME,
+	.driver_features	= DRIVER_MODESET | DRIVER_GEM |
+				  DRIVER_PRIME | DRIVER_ATOMIC,
 	.load			= rockchip_drm_load,
 	.unload			= rockchip_drm_unload,
 	.lastclose		= rockchip_drm_lastclose,
@@ -290,6 +298,7 @@ static struct drm_driver rockchip_drm_driver = {
 	.gem_prime_import	= drm_gem_prime_import,
 	.gem_prime_export	= drm_gem_prime_export,
 	.gem_prime_get_sg_table	= rockchip_gem_prime_get_sg_table,
+	.gem_prime_import_sg_table = rockchip_gem_prime_import_sg_table,
 	.gem_prime_vmap		= rockchip_gem_prime_vmap,
 	.gem_prime_vunmap	= rockchip_gem_prime_vunmap,
 	.gem_prime_mmap		= rockchip_gem_mmap_buf,
@@ -365,8 +374,6 @@ static int rockchip_drm_sys_resume(struct device *dev)
 	}
 	drm_modeset_unlock_all(drm);
 
-	drm_helper_resume_force_mode(drm);
-
 	if (changed)
 		drm_kms_helper_hotplug_event(drm);
 
@@ -535,6 +542,12 @@ static int rockchip_drm_platform_probe(struct platform_device *pdev)
 		of_node_put(port);
 	}
 
+	/*
+	 * Restoring the outputs is the slowest part of resume, don't
+	 * let it hold up the rest of the system.
+	 */
+	device_enable_async_suspend(dev);
+
 	return component_master_add_with_match(dev, &rockchip_drm_ops, match);
 }
 
@@ -18,14 +18,17 @@
 #define _ROCKCHIP_DRM_DRV_H
 
 #include <drm/drm_fb_helper.h>
+#include <drm/drm_atomic_helper.h>
 #include <drm/drm_gem.h>
 
 #include <linux/module.h>
 #include <linux/component.h>
+#include <linux/workqueue.h>
 
 #define ROCKCHIP_MAX_FB_BUFFER	3
 #define ROCKCHIP_MAX_CONNECTOR	2
 #define ROCKCHIP_MAX_CRTC	2
+#define ROCKCHIP_MAX_WIN	4
 
 struct drm_device;
 struct drm_connector;
@@ -34,10 +37,26 @@ struct drm_connector;
  * Rockchip drm private crtc funcs.
  * @enable_vblank: enable crtc vblank irq.
  * @disable_vblank: disable crtc vblank irq.
+ * @wait_for_update: wait for the last committed config to be latched.
  */
 struct rockchip_crtc_funcs {
 	int (*enable_vblank)(struct drm_crtc *crtc);
 	void (*disable_vblank)(struct drm_crtc *crtc);
+	void (*wait_for_update)(struct drm_crtc *crtc);
+};
+
+/*
+ * Rockchip drm atomic commit tracking.
+ * @work: deferred commit work, used for non-blocking commits.
+ * @state: the atomic state handed over to @work.
+ * @dev: drm device the state belongs to.
+ * @lock: serializes commits against the outstanding @work.
+ */
+struct rockchip_atomic_commit {
+	struct work_struct work;
+	struct drm_atomic_state *state;
+	struct drm_device *dev;
+	struct mutex lock;
 };
 
 /*
@@ -45,13 +64,27 @@ struct rockchip_crtc_funcs {
  *
  * @crtc: array of enabled CRTCs, used to map from "pipe" to drm_crtc.
  * @num_pipe: number of pipes for this device.
+ * @plane_zpos_property: per-plane stacking order, 0 is the bottom layer.
+ * @plane_alpha_property: per-plane global alpha, 255 is opaque.
  */
 struct rockchip_drm_private {
 	struct drm_fb_helper fbdev_helper;
 	struct drm_gem_object *fbdev_bo;
+	/* fbdev draws here, damaged regions are copied to fbdev_bo */
+	void *fbdev_shadow;
+	struct delayed_work fbdev_dirty_work;
+	spinlock_t fbdev_dirty_lock;
+	struct drm_clip_rect fbdev_dirty;
 	const struct rockchip_crtc_funcs *crtc_funcs[ROCKCHIP_MAX_CRTC];
+
+	struct rockchip_atomic_commit commit;
+
+	struct drm_property *plane_zpos_property;
+	struct drm_property *plane_alpha_property;
 };
 
+void rockchip_drm_atomic_work(struct work_struct *work);
+
 int rockchip_register_crtc_funcs(struct drm_device *dev,
 				 const struct rockchip_crtc_funcs *crtc_funcs,
 				 int pipe);
@@ -15,8 +15,10 @@
 #include <linux/kernel.h>
 #include <drm/drm.h>
 #include <drm/drmP.h>
+#include <drm/drm_atomic.h>
 #include <drm/drm_fb_helper.h>
 #include <drm/drm_crtc_helper.h>
+#include <linux/reservation.h>
 
 #include "rockchip_drm_drv.h"
 #include "rockchip_drm_gem.h"
@@ -140,6 +142,13 @@ rockchip_user_fb_create(struct drm_device *dev, struct drm_file *file_priv,
 			ret = -EINVAL;
 			goto err_gem_object_unreference;
 		}
+
+		/* the VOP scans out from the IOMMU mapping of the pages */
+		ret = rockchip_gem_get_pages(to_rockchip_obj(obj));
+		if (ret) {
+			drm_gem_object_unreference_unlocked(obj);
+			goto err_gem_object_unreference;
+		}
 		objs[i] = obj;
 	}
 
@@ -166,9 +175,161 @@ static void rockchip_drm_output_poll_changed(struct drm_device *dev)
 		drm_fb_helper_hotplug_event(fb_helper);
 }
 
+static void rockchip_crtc_wait_for_update(struct drm_crtc *crtc)
+{
+	struct rockchip_drm_private *priv = crtc->dev->dev_private;
+	int pipe = drm_crtc_index(crtc);
+	const struct rockchip_crtc_funcs *crtc_funcs = priv->crtc_funcs[pipe];
+
+	if (crtc_funcs && crtc_funcs->wait_for_update)
+		crtc_funcs->wait_for_update(crtc);
+}
+
+static void
+rockchip_atomic_wait_for_complete(struct drm_atomic_state *old_state)
+{
+	struct drm_crtc_state *old_crtc_state;
+	struct drm_crtc *crtc;
+	int i;
+
+	for_each_crtc_in_state(old_state, crtc, old_crtc_state, i) {
+		if (!crtc->state->active)
+			continue;
+
+		rockchip_crtc_wait_for_update(crtc);
+	}
+}
+
+/*
+ * Wait for the producers of all new framebuffers, e.g. a GPU still
+ * rendering into them, before they are handed to the hardware.
+ */
+static void rockchip_atomic_wait_for_fences(struct drm_atomic_state *state)
+{
+	struct drm_plane_state *plane_state;
+	struct reservation_object *resv;
+	struct drm_plane *plane;
+	unsigned int j;
+	int i;
+
+	for_each_plane_in_state(state, plane, plane_state, i) {
+		struct drm_framebuffer *fb = plane->state->fb;
+
+		if (!fb || fb == plane_state->fb)
+			continue;
+
+		for (j = 0; j < ROCKCHIP_MAX_FB_BUFFER; j++) {
+			struct drm_gem_object *obj = rockchip_fb_get_gem_obj(fb, j);
+
+			if (!obj)
+				break;
+
+			resv = rockchip_gem_get_resv(obj);
+			if (resv)
+				reservation_object_wait_timeout_rcu(resv, false,
+						false, MAX_SCHEDULE_TIMEOUT);
+		}
+	}
+}
+
+/*
+ * Legacy cursor ioctls are unsynced, userspace issues lots of them and
+ * expects a cursor move to cost no more than the register writes. Only
+ * moves skip the wait though: a replaced framebuffer may be freed by the
+ * plane cleanup while the hardware is still scanning it out.
+ */
+static bool rockchip_atomic_is_cursor_move(struct drm_atomic_state *state)
+{
+	struct drm_plane_state *plane_state;
+	struct drm_plane *plane;
+	int i;
+
+	if (!state->legacy_cursor_update)
+		return false;
+
+	for_each_plane_in_state(state, plane, plane_state, i)
+		if (plane->state->fb != plane_state->fb)
+			return false;
+
+	return true;
+}
+
+static void
+rockchip_atomic_commit_complete(struct rockchip_atomic_commit *commit)
+{
+	struct drm_atomic_state *state = commit->state;
+	struct drm_device *dev = commit->dev;
+
+	rockchip_atomic_wait_for_fences(state);
+
+	/*
+	 * Rockchip crtcs support runtime PM, so the window registers can't be
+	 * touched while a crtc is off. Do the modeset first, so that every crtc
+	 * in the new state is powered when its planes are programmed, and
+	 * then let each crtc latch all of its planes with a single cfg_done.
+	 */
+	drm_atomic_helper_commit_modeset_disables(dev, state);
+
+	drm_atomic_helper_commit_modeset_enables(dev, state);
+
+	drm_atomic_helper_commit_planes(dev, state);
+
+	if (!rockchip_atomic_is_cursor_move(state))
+		rockchip_atomic_wait_for_complete(state);
+
+	drm_atomic_helper_cleanup_planes(dev, state);
+
+	drm_atomic_state_free(state);
+}
+
+void rockchip_drm_atomic_work(struct work_struct *work)
+{
+	struct rockchip_atomic_commit *commit = container_of(work,
+					struct rockchip_atomic_commit, work);
+
+	rockchip_atomic_commit_complete(commit);
+}
+
+static int rockchip_drm_atomic_commit(struct drm_device *dev,
+				      struct drm_atomic_state *state,
+				      bool async)
+{
+	struct rockchip_drm_private *private = dev->dev_private;
+	struct rockchip_atomic_commit *commit = &private->commit;
+	int ret;
+
+	ret = drm_atomic_helper_prepare_planes(dev, state);
+	if (ret)
+		return ret;
+
+	/* serialize outstanding asynchronous commits */
+	mutex_lock(&commit->lock);
+	flush_work(&commit->work);
+
+	/*
+	 * This is the point of no return - everything below never fails, so
+	 * we can commit the new state on the software side now.
+	 */
+	drm_atomic_helper_swap_state(dev, state);
+
+	commit->dev = dev;
+	commit->state = state;
+
+	if (async)
+		schedule_work(&commit->work);
+	else
+		rockchip_atomic_commit_complete(commit);
+
+	mutex_unlock(&commit->lock);
+
+	return 0;
+}
+
 static const struct drm_mode_config_funcs rockchip_drm_mode_config_funcs = {
 	.fb_create = rockchip_user_fb_create,
 	.output_poll_changed = rockchip_drm_output_poll_changed,
+	.atomic_check = drm_atomic_helper_check,
+	.atomic_commit = rockchip_drm_atomic_commit,
 };
 
 struct drm_framebuffer *
@@ -12,6 +12,8 @@
  * GNU General Public License for more details.
  */
 
+#include <linux/vmalloc.h>
+
 #include <drm/drm.h>
 #include <drm/drmP.h>
 #include <drm/drm_fb_helper.h>
@@ -22,24 +24,150 @@
 #include "rockchip_drm_fb.h"
 
 #define PREFERRED_BPP		32
+/* flush accumulated damage at most about once per frame */
+#define ROCKCHIP_FBDEV_DIRTY_DELAY	(HZ / 60)
 #define to_drm_private(x) \
 		container_of(x, struct rockchip_drm_private, fbdev_helper)
 
-static int rockchip_fbdev_mmap(struct fb_info *info,
-			       struct vm_area_struct *vma)
+static void rockchip_fbdev_dirty_reset(struct rockchip_drm_private *private)
+{
+	private->fbdev_dirty.x1 = USHRT_MAX;
+	private->fbdev_dirty.y1 = USHRT_MAX;
+	private->fbdev_dirty.x2 = 0;
+	private->fbdev_dirty.y2 = 0;
+}
+
+/*
+ * Copy the damaged region of the shadow buffer to the scanout buffer.
+ * The console draws into cached memory this way, instead of reading back
+ * from the write-combined scanout buffer on every scroll.
+ */
+static void rockchip_fbdev_dirty_work(struct work_struct *work)
+{
+	struct rockchip_drm_private *private =
+		container_of(to_delayed_work(work), struct rockchip_drm_private,
+			     fbdev_dirty_work);
+	struct rockchip_gem_object *rk_obj = to_rockchip_obj(private->fbdev_bo);
+	struct fb_info *fbi = private->fbdev_helper.fbdev;
+	unsigned int cpp = fbi->var.bits_per_pixel >> 3;
+	unsigned int pitch = fbi->fix.line_length;
+	struct drm_clip_rect clip;
+	unsigned long flags;
+	unsigned int y;
+
+	spin_lock_irqsave(&private->fbdev_dirty_lock, flags);
+	clip = private->fbdev_dirty;
+	rockchip_fbdev_dirty_reset(private);
+	spin_unlock_irqrestore(&private->fbdev_dirty_lock, flags);
+
+	if (clip.x1 >= clip.x2 || clip.y1 >= clip.y2)
+		return;
+
+	for (y = clip.y1; y < clip.y2; y++) {
+		unsigned long offset = y * pitch + clip.x1 * cpp;
+
+		memcpy(rk_obj->kvaddr + offset,
+		       private->fbdev_shadow + offset,
+		       (clip.x2 - clip.x1) * cpp);
+	}
+}
+
+static void rockchip_fbdev_dirty(struct fb_info *info, u32 x, u32 y,
+				 u32 width, u32 height)
 {
 	struct drm_fb_helper *helper = info->par;
 	struct rockchip_drm_private *private = to_drm_private(helper);
+	struct drm_clip_rect *dirty = &private->fbdev_dirty;
+	u32 x2 = min(x + width, info->var.xres_virtual);
+	u32 y2 = min(y + height, info->var.yres_virtual);
+	unsigned long flags;
+
+	if (x >= x2 || y >= y2)
+		return;
+
+	spin_lock_irqsave(&private->fbdev_dirty_lock, flags);
+	dirty->x1 = min_t(u32, dirty->x1, x);
+	dirty->y1 = min_t(u32, dirty->y1, y);
+	dirty->x2 = max_t(u32, dirty->x2, x2);
+	dirty->y2 = max_t(u32, dirty->y2, y2);
+	spin_unlock_irqrestore(&private->fbdev_dirty_lock, flags);
+
+	/* damage arriving before a pending flush runs is merged into it */
+	schedule_delayed_work(&private->fbdev_dirty_work,
+			      ROCKCHIP_FBDEV_DIRTY_DELAY);
+}
+
+static void rockchip_fbdev_deferred_io(struct fb_info *info,
+				       struct list_head *pagelist)
+{
+	unsigned long start, end, min = ULONG_MAX, max = 0;
+	struct page *page;
+
+	list_for_each_entry(page, pagelist, lru) {
+		start = page->index << PAGE_SHIFT;
+		end = start + PAGE_SIZE;
+		min = min(min, start);
+		max = max(max, end);
+	}
+
+	if (min < max)
+		rockchip_fbdev_dirty(info, 0, min / info->fix.line_length,
+				     info->var.xres_virtual,
+				     DIV_ROUND_UP(max, info->fix.line_length) -
+				     min / info->fix.line_length);
+}
+
+static struct fb_deferred_io rockchip_fbdev_defio = {
+	.delay		= ROCKCHIP_FBDEV_DIRTY_DELAY,
+	.deferred_io	= rockchip_fbdev_deferred_io,
+};
+
+static void rockchip_fbdev_fillrect(struct fb_info *info,
+				    const struct fb_fillrect *rect)
+{
+	drm_fb_helper_sys_fillrect(info, rect);
+	rockchip_fbdev_dirty(info, rect->dx, rect->dy, rect->width,
+			     rect->height);
+}
+
+static void rockchip_fbdev_copyarea(struct fb_info *info,
+				    const struct fb_copyarea *area)
+{
+	drm_fb_helper_sys_copyarea(info, area);
+	rockchip_fbdev_dirty(info, area->dx, area->dy, area->width,
+			     area->height);
+}
 
-	return rockchip_gem_mmap_buf(private->fbdev_bo, vma);
+static void rockchip_fbdev_imageblit(struct fb_info *info,
+				     const struct fb_image *image)
+{
+	drm_fb_helper_sys_imageblit(info, image);
+	rockchip_fbdev_dirty(info, image->dx, image->dy, image->width,
+			     image->height);
 }
 
+static ssize_t rockchip_fbdev_write(struct fb_info *info,
+				    const char __user *buf, size_t count,
+				    loff_t *ppos)
+{
+	ssize_t ret;
+
+	ret = drm_fb_helper_sys_write(info, buf, count, ppos);
+	if (ret > 0)
+		rockchip_fbdev_dirty(info, 0, 0, info->var.xres_virtual,
+				     info->var.yres_virtual);
+
+	return ret;
+}
+
+/* fb_mmap is installed by fb_deferred_io_init() */
 static struct fb_ops rockchip_drm_fbdev_ops = {
 	.owner		= THIS_MODULE,
-	.fb_mmap	= rockchip_fbdev_mmap,
-	.fb_fillrect	= drm_fb_helper_cfb_fillrect,
-	.fb_copyarea	= drm_fb_helper_cfb_copyarea,
-	.fb_imageblit	= drm_fb_helper_cfb_imageblit,
+	.fb_read	= drm_fb_helper_sys_read,
+	.fb_write	= rockchip_fbdev_write,
+	.fb_fillrect	= rockchip_fbdev_fillrect,
+	.fb_copyarea	= rockchip_fbdev_copyarea,
+	.fb_imageblit	= rockchip_fbdev_imageblit,
 	.fb_check_var	= drm_fb_helper_check_var,
 	.fb_set_par	= drm_fb_helper_set_par,
 	.fb_blank	= drm_fb_helper_blank,
@@ -77,11 +205,17 @@ static int rockchip_drm_fbdev_create(struct drm_fb_helper *helper,
 
 	private->fbdev_bo = &rk_obj->base;
 
+	private->fbdev_shadow = vzalloc(rk_obj->base.size);
+	if (!private->fbdev_shadow) {
+		ret = -ENOMEM;
+		goto err_rockchip_gem_free_object;
+	}
+
 	fbi = drm_fb_helper_alloc_fbi(helper);
 	if (IS_ERR(fbi)) {
 		dev_err(dev->dev, "Failed to create framebuffer info.\n");
 		ret = PTR_ERR(fbi);
-		goto err_rockchip_gem_free_object;
+		goto err_free_shadow;
 	}
 
 	helper->fb = rockchip_drm_framebuffer_init(dev, &mode_cmd,
@@ -104,7 +238,7 @@ static int rockchip_drm_fbdev_create(struct drm_fb_helper *helper,
 	offset += fbi->var.yoffset * fb->pitches[0];
 
 	dev->mode_config.fb_base = 0;
-	fbi->screen_base = rk_obj->kvaddr + offset;
+	fbi->screen_base = private->fbdev_shadow + offset;
 	fbi->screen_size = rk_obj->base.size;
 	fbi->fix.smem_len = rk_obj->base.size;
 
@@ -114,10 +248,15 @@ static int rockchip_drm_fbdev_create(struct drm_fb_helper *helper,
 
 	fbi->skip_vt_switch = true;
 
+	fbi->fbdefio = &rockchip_fbdev_defio;
+	fb_deferred_io_init(fbi);
+
 	return 0;
 
 err_release_fbi:
 	drm_fb_helper_release_fbi(helper);
+err_free_shadow:
+	vfree(private->fbdev_shadow);
 err_rockchip_gem_free_object:
 	rockchip_gem_free_object(&rk_obj->base);
 	return ret;
@@ -141,6 +280,11 @@ int rockchip_drm_fbdev_init(struct drm_device *dev)
 
 	helper = &private->fbdev_helper;
 
+	spin_lock_init(&private->fbdev_dirty_lock);
+	rockchip_fbdev_dirty_reset(private);
+	INIT_DELAYED_WORK(&private->fbdev_dirty_work,
+			  rockchip_fbdev_dirty_work);
+
 	drm_fb_helper_prepare(dev, helper, &rockchip_drm_fb_helper_funcs);
 
 	ret = drm_fb_helper_init(dev, helper, num_crtc, ROCKCHIP_MAX_CONNECTOR);
@@ -181,8 +325,13 @@ void rockchip_drm_fbdev_fini(struct drm_device *dev)
 	helper = &private->fbdev_helper;
 
 	drm_fb_helper_unregister_fbi(helper);
+	cancel_delayed_work_sync(&private->fbdev_dirty_work);
+	if (helper->fbdev)
+		fb_deferred_io_cleanup(helper->fbdev);
 	drm_fb_helper_release_fbi(helper);
 
+	vfree(private->fbdev_shadow);
+
 	if (helper->fb)
 		drm_framebuffer_unreference(helper->fb);
 
@@ -17,63 +17,195 @@
 #include <drm/drm_gem.h>
 #include <drm/drm_vma_manager.h>
 
-#include <linux/dma-attrs.h>
+#include <linux/dma-buf.h>
+#include <linux/vmalloc.h>
 
 #include "rockchip_drm_drv.h"
 #include "rockchip_drm_gem.h"
 
-static int rockchip_gem_alloc_buf(struct rockchip_gem_object *rk_obj,
-				  bool alloc_kmap)
+/*
+ * Return the length of the linear IOVA range at the head of a mapped sg
+ * table. IOMMU-backed dma_map_sg() merges page aligned segments, so a
+ * buffer scattered in physical memory normally ends up as one range.
+ */
+static unsigned long rockchip_sg_get_contiguous_size(struct sg_table *sgt)
+{
+	struct scatterlist *s;
+	dma_addr_t expected = sg_dma_address(sgt->sgl);
+	unsigned long size = 0;
+	unsigned int i;
+
+	for_each_sg(sgt->sgl, s, sgt->nents, i) {
+		if (!sg_dma_len(s) || sg_dma_address(s) != expected)
+			break;
+		expected = sg_dma_address(s) + sg_dma_len(s);
+		size += sg_dma_len(s);
+	}
+
+	return size;
+}
+
+static int rockchip_gem_get_pages_locked(struct rockchip_gem_object *rk_obj)
 {
 	struct drm_gem_object *obj = &rk_obj->base;
 	struct drm_device *drm = obj->dev;
+	struct page **pages;
+	struct sg_table *sgt;
+	int ret;
+
+	if (rk_obj->pages || obj->import_attach)
+		return 0;
 
-	init_dma_attrs(&rk_obj->dma_attrs);
-	dma_set_attr(DMA_ATTR_WRITE_COMBINE, &rk_obj->dma_attrs);
+	pages = drm_gem_get_pages(obj);
+	if (IS_ERR(pages))
+		return PTR_ERR(pages);
+
+	sgt = drm_prime_pages_to_sg(pages, rk_obj->num_pages);
+	if (IS_ERR(sgt)) {
+		ret = PTR_ERR(sgt);
+		goto err_put_pages;
+	}
 
-	if (!alloc_kmap)
-		dma_set_attr(DMA_ATTR_NO_KERNEL_MAPPING, &rk_obj->dma_attrs);
+	/*
+	 * The drm device and all VOPs share one IOMMU domain, so this single
+	 * mapping is what the hardware scans out from.
+	 */
+	if (!dma_map_sg(drm->dev, sgt->sgl, sgt->nents, DMA_BIDIRECTIONAL)) {
+		ret = -ENOMEM;
+		goto err_free_sgt;
+	}
 
-	rk_obj->kvaddr = dma_alloc_attrs(drm->dev, obj->size,
-					 &rk_obj->dma_addr, GFP_KERNEL,
-					 &rk_obj->dma_attrs);
-	if (!rk_obj->kvaddr) {
-		DRM_ERROR("failed to allocate %#x byte dma buffer", obj->size);
-		return -ENOMEM;
+	if (rockchip_sg_get_contiguous_size(sgt) < obj->size) {
+		DRM_ERROR("failed to map buffer to contiguous linear address\n");
+		ret = -EINVAL;
+		goto err_unmap_sg;
 	}
 
+	rk_obj->dma_addr = sg_dma_address(sgt->sgl);
+	rk_obj->sgt = sgt;
+	rk_obj->pages = pages;
+
 	return 0;
+
+err_unmap_sg:
+	dma_unmap_sg(drm->dev, sgt->sgl, sgt->nents, DMA_BIDIRECTIONAL);
+err_free_sgt:
+	sg_free_table(sgt);
+	kfree(sgt);
+err_put_pages:
+	drm_gem_put_pages(obj, pages, false, false);
+	return ret;
 }
 
-static void rockchip_gem_free_buf(struct rockchip_gem_object *rk_obj)
+/*
+ * rockchip_gem_get_pages - make sure the object is backed by pages
+ *
+ * Objects are created without any backing storage. The shmem pages are
+ * allocated and mapped into the IOMMU on first use, either on a CPU fault
+ * or when the buffer is handed to the hardware.
+ */
+int rockchip_gem_get_pages(struct rockchip_gem_object *rk_obj)
+{
+	int ret;
+
+	mutex_lock(&rk_obj->lock);
+	ret = rockchip_gem_get_pages_locked(rk_obj);
+	mutex_unlock(&rk_obj->lock);
+
+	return ret;
+}
+
+static void rockchip_gem_put_pages(struct rockchip_gem_object *rk_obj)
 {
 	struct drm_gem_object *obj = &rk_obj->base;
 	struct drm_device *drm = obj->dev;
 
-	dma_free_attrs(drm->dev, obj->size, rk_obj->kvaddr, rk_obj->dma_addr,
-		       &rk_obj->dma_attrs);
+	if (!rk_obj->pages)
+		return;
+
+	if (rk_obj->kvaddr)
+		vunmap(rk_obj->kvaddr);
+
+	dma_unmap_sg(drm->dev, rk_obj->sgt->sgl, rk_obj->sgt->nents,
+		     DMA_BIDIRECTIONAL);
+	sg_free_table(rk_obj->sgt);
+	kfree(rk_obj->sgt);
+
+	drm_gem_put_pages(obj, rk_obj->pages, true, false);
+}
+
+static void *rockchip_gem_vmap(struct rockchip_gem_object *rk_obj)
+{
+	mutex_lock(&rk_obj->lock);
+
+	if (rk_obj->kvaddr || rk_obj->base.import_attach)
+		goto out;
+
+	if (rockchip_gem_get_pages_locked(rk_obj))
+		goto out;
+
+	rk_obj->kvaddr = vmap(rk_obj->pages, rk_obj->num_pages, VM_MAP,
+			      pgprot_writecombine(PAGE_KERNEL));
+out:
+	mutex_unlock(&rk_obj->lock);
+
+	return rk_obj->kvaddr;
+}
+
+int rockchip_gem_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+	struct drm_gem_object *obj = vma->vm_private_data;
+	struct rockchip_gem_object *rk_obj = to_rockchip_obj(obj);
+	unsigned long vaddr = (unsigned long)vmf->virtual_address;
+	pgoff_t pgoff;
+	int ret;
+
+	ret = rockchip_gem_get_pages(rk_obj);
+	if (ret)
+		return ret == -ENOMEM ? VM_FAULT_OOM : VM_FAULT_SIGBUS;
+
+	pgoff = ((vaddr - vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
+	if (pgoff >= rk_obj->num_pages)
+		return VM_FAULT_SIGBUS;
+
+	ret = vm_insert_page(vma, vaddr, rk_obj->pages[pgoff]);
+	switch (ret) {
+	case 0:
+	case -EBUSY:
+		/* -EBUSY means another thread already faulted this page in */
+		return VM_FAULT_NOPAGE;
+	case -ENOMEM:
+		return VM_FAULT_OOM;
+	default:
+		return VM_FAULT_SIGBUS;
+	}
 }
 
 static int rockchip_drm_gem_object_mmap(struct drm_gem_object *obj,
 					struct vm_area_struct *vma)
 
 {
-	int ret;
 	struct rockchip_gem_object *rk_obj = to_rockchip_obj(obj);
-	struct drm_device *drm = obj->dev;
 
 	/*
-	 * dma_alloc_attrs() allocated a struct page table for rk_obj, so clear
-	 * VM_PFNMAP flag that was set by drm_gem_mmap_obj()/drm_gem_mmap().
+	 * Imported buffers have no kernel-side backing of our own; they
+	 * must be mapped through the exporter's dma-buf.
 	 */
-	vma->vm_flags &= ~VM_PFNMAP;
-
-	ret = dma_mmap_attrs(drm->dev, vma, rk_obj->kvaddr, rk_obj->dma_addr,
-			     obj->size, &rk_obj->dma_attrs);
-	if (ret)
+	if (obj->import_attach ||
+	    vma->vm_pgoff + vma_pages(vma) > rk_obj->num_pages) {
 		drm_gem_vm_close(vma);
+		return -EINVAL;
+	}
 
-	return ret;
+	/*
+	 * Pages are inserted one at a time by rockchip_gem_fault(), so turn
+	 * the VM_PFNMAP mapping set up by drm_gem_mmap_obj()/drm_gem_mmap()
+	 * into a mixed one.
+	 */
+	vma->vm_flags &= ~VM_PFNMAP;
+	vma->vm_flags |= VM_MIXEDMAP;
+
+	return 0;
 }
 
 int rockchip_gem_mmap_buf(struct drm_gem_object *obj,
@@ -101,11 +233,32 @@ int rockchip_gem_mmap(struct file *filp, struct vm_area_struct *vma)
 	if (ret)
 		return ret;
 
+	/*
+	 * Set vm_pgoff (used as a fake buffer offset by DRM) to 0 as we
+	 * want to map the whole buffer.
+	 */
+	vma->vm_pgoff = 0;
+
 	obj = vma->vm_private_data;
 
 	return rockchip_drm_gem_object_mmap(obj, vma);
 }
 
+static struct rockchip_gem_object *
+	rockchip_gem_alloc_object(struct drm_device *drm, unsigned int size)
+{
+	struct rockchip_gem_object *rk_obj;
+
+	rk_obj = kzalloc(sizeof(*rk_obj), GFP_KERNEL);
+	if (!rk_obj)
+		return ERR_PTR(-ENOMEM);
+
+	rk_obj->num_pages = size >> PAGE_SHIFT;
+	mutex_init(&rk_obj->lock);
+
+	return rk_obj;
+}
+
 struct rockchip_gem_object *
 	rockchip_gem_create_object(struct drm_device *drm, unsigned int size,
 				   bool alloc_kmap)
@@ -116,23 +269,25 @@ struct rockchip_gem_object *
 
 	size = round_up(size, PAGE_SIZE);
 
-	rk_obj = kzalloc(sizeof(*rk_obj), GFP_KERNEL);
-	if (!rk_obj)
-		return ERR_PTR(-ENOMEM);
+	rk_obj = rockchip_gem_alloc_object(drm, size);
+	if (IS_ERR(rk_obj))
+		return rk_obj;
 
 	obj = &rk_obj->base;
 
-	drm_gem_private_object_init(drm, obj, size);
+	ret = drm_gem_object_init(drm, obj, size);
+	if (ret) {
+		kfree(rk_obj);
+		return ERR_PTR(ret);
+	}
 
-	ret = rockchip_gem_alloc_buf(rk_obj, alloc_kmap);
-	if (ret)
-		goto err_free_rk_obj;
+	if (alloc_kmap && !rockchip_gem_vmap(rk_obj)) {
+		DRM_ERROR("failed to allocate %#x byte buffer\n", size);
+		rockchip_gem_free_object(obj);
+		return ERR_PTR(-ENOMEM);
+	}
 
 	return rk_obj;
-
-err_free_rk_obj:
-	kfree(rk_obj);
-	return ERR_PTR(ret);
 }
 
 /*
@@ -143,11 +298,14 @@ void rockchip_gem_free_object(struct drm_gem_object *obj)
 {
 	struct rockchip_gem_object *rk_obj;
 
-	drm_gem_free_mmap_offset(obj);
-
 	rk_obj = to_rockchip_obj(obj);
 
-	rockchip_gem_free_buf(rk_obj);
+	if (obj->import_attach)
+		drm_prime_gem_destroy(obj, rk_obj->sgt);
+	else
+		rockchip_gem_put_pages(rk_obj);
+
+	drm_gem_object_release(obj);
 
 	kfree(rk_obj);
 }
@@ -259,37 +417,68 @@ int rockchip_gem_dumb_create(struct drm_file *file_priv,
 struct sg_table *rockchip_gem_prime_get_sg_table(struct drm_gem_object *obj)
 {
 	struct rockchip_gem_object *rk_obj = to_rockchip_obj(obj);
-	struct drm_device *drm = obj->dev;
-	struct sg_table *sgt;
 	int ret;
 
-	sgt = kzalloc(sizeof(*sgt), GFP_KERNEL);
-	if (!sgt)
-		return ERR_PTR(-ENOMEM);
-
-	ret = dma_get_sgtable_attrs(drm->dev, sgt, rk_obj->kvaddr,
-				    rk_obj->dma_addr, obj->size,
-				    &rk_obj->dma_attrs);
-	if (ret) {
-		DRM_ERROR("failed to allocate sgt, %d\n", ret);
-		kfree(sgt);
+	ret = rockchip_gem_get_pages(rk_obj);
+	if (ret)
 		return ERR_PTR(ret);
+
+	return drm_prime_pages_to_sg(rk_obj->pages, rk_obj->num_pages);
+}
+
+/*
+ * rockchip_gem_prime_import_sg_table - (struct drm_driver)->
+ * gem_prime_import_sg_table callback function
+ *
+ * The sg table has already been mapped for the drm device by the dma-buf
+ * attachment, i.e. into the IOMMU domain shared by all the VOPs, so the
+ * buffer can be scanned out in place as long as that mapping is linear.
+ */
+struct drm_gem_object *
+rockchip_gem_prime_import_sg_table(struct drm_device *drm,
+				   struct dma_buf_attachment *attach,
+				   struct sg_table *sgt)
+{
+	struct rockchip_gem_object *rk_obj;
+
+	if (rockchip_sg_get_contiguous_size(sgt) < attach->dmabuf->size) {
+		DRM_ERROR("failed to map sg_table to contiguous linear address\n");
+		return ERR_PTR(-EINVAL);
 	}
 
-	return sgt;
+	rk_obj = rockchip_gem_alloc_object(drm, attach->dmabuf->size);
+	if (IS_ERR(rk_obj))
+		return ERR_CAST(rk_obj);
+
+	drm_gem_private_object_init(drm, &rk_obj->base, attach->dmabuf->size);
+
+	rk_obj->dma_addr = sg_dma_address(sgt->sgl);
+	rk_obj->sgt = sgt;
+
+	return &rk_obj->base;
 }
 
-void *rockchip_gem_prime_vmap(struct drm_gem_object *obj)
+/*
+ * Return the reservation object of the dma-buf sharing this object, if
+ * any. Only shared buffers can have fences from other devices attached.
+ */
+struct reservation_object *rockchip_gem_get_resv(struct drm_gem_object *obj)
 {
-	struct rockchip_gem_object *rk_obj = to_rockchip_obj(obj);
+	if (obj->import_attach)
+		return obj->import_attach->dmabuf->resv;
 
-	if (dma_get_attr(DMA_ATTR_NO_KERNEL_MAPPING, &rk_obj->dma_attrs))
-		return NULL;
+	if (obj->dma_buf)
+		return obj->dma_buf->resv;
 
-	return rk_obj->kvaddr;
+	return NULL;
+}
+
+void *rockchip_gem_prime_vmap(struct drm_gem_object *obj)
+{
+	return rockchip_gem_vmap(to_rockchip_obj(obj));
 }
 
 void rockchip_gem_prime_vunmap(struct drm_gem_object *obj, void *vaddr)
 {
-	/* Nothing to do */
+	/* The kernel mapping is kept until the object is freed */
 }
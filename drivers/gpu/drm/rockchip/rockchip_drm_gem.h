@@ -23,13 +23,21 @@ struct rockchip_gem_object {
 
 	void *kvaddr;
 	dma_addr_t dma_addr;
-	struct dma_attrs dma_attrs;
+
+	/* protects lazy population of pages, sgt and kvaddr */
+	struct mutex lock;
+	struct page **pages;
+	unsigned int num_pages;
+	/* IOMMU mapped pages, or the sg table of an imported dma-buf */
+	struct sg_table *sgt;
 };
 
 struct sg_table *rockchip_gem_prime_get_sg_table(struct drm_gem_object *obj);
 struct drm_gem_object *
-rockchip_gem_prime_import_sg_table(struct drm_device *dev, size_t size,
+rockchip_gem_prime_import_sg_table(struct drm_device *dev,
+				   struct dma_buf_attachment *attach,
 				   struct sg_table *sgt);
+struct reservation_object *rockchip_gem_get_resv(struct drm_gem_object *obj);
 void *rockchip_gem_prime_vmap(struct drm_gem_object *obj);
 void rockchip_gem_prime_vunmap(struct drm_gem_object *obj, void *vaddr);
 
@@ -46,6 +54,9 @@ struct rockchip_gem_object *
 
 void rockchip_gem_free_object(struct drm_gem_object *obj);
 
+int rockchip_gem_get_pages(struct rockchip_gem_object *rk_obj);
+int rockchip_gem_fault(struct vm_area_struct *vma, struct vm_fault *vmf);
+
 int rockchip_gem_dumb_create(struct drm_file *file_priv,
 			     struct drm_device *dev,
 			     struct drm_mode_create_dumb *args);
@@ -0,0 +1,101 @@
+#if !defined(_ROCKCHIP_DRM_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _ROCKCHIP_DRM_TRACE_H_
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rockchip_drm
+#define TRACE_INCLUDE_FILE rockchip_drm_trace
+
+DECLARE_EVENT_CLASS(rockchip_vop_pipe,
+	    TP_PROTO(int pipe),
+	    TP_ARGS(pipe),
+
+	    TP_STRUCT__entry(
+			     __field(int, pipe)
+			     ),
+
+	    TP_fast_assign(
+			   __entry->pipe = pipe;
+			   ),
+
+	    TP_printk("pipe=%d", __entry->pipe)
+);
+
+DEFINE_EVENT(rockchip_vop_pipe, rockchip_vop_cfg_done,
+	    TP_PROTO(int pipe),
+	    TP_ARGS(pipe)
+);
+
+DEFINE_EVENT(rockchip_vop_pipe, rockchip_vop_bus_error,
+	    TP_PROTO(int pipe),
+	    TP_ARGS(pipe)
+);
+
+TRACE_EVENT(rockchip_vop_commit,
+	    TP_PROTO(int pipe, bool has_event, bool joined),
+	    TP_ARGS(pipe, has_event, joined),
+
+	    TP_STRUCT__entry(
+			     __field(int, pipe)
+			     __field(bool, has_event)
+			     __field(bool, joined)
+			     ),
+
+	    TP_fast_assign(
+			   __entry->pipe = pipe;
+			   __entry->has_event = has_event;
+			   __entry->joined = joined;
+			   ),
+
+	    TP_printk("pipe=%d, event=%d, joined=%d",
+		      __entry->pipe, __entry->has_event, __entry->joined)
+);
+
+TRACE_EVENT(rockchip_vop_frame_start,
+	    TP_PROTO(int pipe, u32 frame, bool update_pending),
+	    TP_ARGS(pipe, frame, update_pending),
+
+	    TP_STRUCT__entry(
+			     __field(int, pipe)
+			     __field(u32, frame)
+			     __field(bool, update_pending)
+			     ),
+
+	    TP_fast_assign(
+			   __entry->pipe = pipe;
+			   __entry->frame = frame;
+			   __entry->update_pending = update_pending;
+			   ),
+
+	    TP_printk("pipe=%d, frame=%u, pending=%d",
+		      __entry->pipe, __entry->frame, __entry->update_pending)
+);
+
+TRACE_EVENT(rockchip_vop_flip_complete,
+	    TP_PROTO(int pipe, u32 frame, s64 latency_us),
+	    TP_ARGS(pipe, frame, latency_us),
+
+	    TP_STRUCT__entry(
+			     __field(int, pipe)
+			     __field(u32, frame)
+			     __field(s64, latency_us)
+			     ),
+
+	    TP_fast_assign(
+			   __entry->pipe = pipe;
+			   __entry->frame = frame;
+			   __entry->latency_us = latency_us;
+			   ),
+
+	    TP_printk("pipe=%d, frame=%u, latency=%lldus",
+		      __entry->pipe, __entry->frame, __entry->latency_us)
+);
+
+#endif /* _ROCKCHIP_DRM_TRACE_H_ */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#include <trace/define_trace.h>
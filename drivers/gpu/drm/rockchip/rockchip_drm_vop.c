@@ -14,6 +14,7 @@
 
 #include <drm/drm.h>
 #include <drm/drmP.h>
+#include <drm/drm_atomic.h>
 #include <drm/drm_crtc.h>
 #include <drm/drm_crtc_helper.h>
 #include <drm/drm_plane_helper.h>
@@ -26,15 +27,24 @@
 #include <linux/of_device.h>
 #include <linux/pm_runtime.h>
 #include <linux/component.h>
+#include <linux/debugfs.h>
+#include <linux/fence.h>
+#include <linux/reservation.h>
 
 #include <linux/reset.h>
 #include <linux/delay.h>
+#include <linux/seq_file.h>
+
+#include <soc/rockchip/rockchip_dmc.h>
 
 #include "rockchip_drm_drv.h"
 #include "rockchip_drm_gem.h"
 #include "rockchip_drm_fb.h"
 #include "rockchip_drm_vop.h"
 
+#define CREATE_TRACE_POINTS
+#include "rockchip_drm_trace.h"
+
 #define VOP_REG(off, _mask, s) \
 		{.offset = off, \
 		 .mask = _mask, \
@@ -63,21 +73,63 @@
 
 #define to_vop(x) container_of(x, struct vop, crtc)
 #define to_vop_win(x) container_of(x, struct vop_win, base)
-
-struct vop_win_state {
-	struct list_head head;
-	struct drm_framebuffer *fb;
-	dma_addr_t yrgb_mst;
-	struct drm_pending_vblank_event *event;
+#define to_vop_plane_state(x) container_of(x, struct vop_plane_state, base)
+
+struct vop_plane_state {
+	struct drm_plane_state base;
+	int format;
+	struct drm_rect src;
+	struct drm_rect dest;
+	bool enable;
+
+	/* user properties */
+	unsigned int zpos;
+	unsigned int alpha;
 };
 
 struct vop_win {
 	struct drm_plane base;
 	const struct vop_win_data *data;
 	struct vop *vop;
+	/* default stacking position */
+	unsigned int zpos;
+
+	/*
+	 * Config written since the last cfg_done that the hardware has not
+	 * latched yet. Protected by vop->vsync_mutex.
+	 */
+	bool pending;
+	bool pending_enable;
+	dma_addr_t pending_yrgb_mst;
+
+	/*
+	 * Scanout fences, added as shared fences to the reservation object
+	 * of the framebuffer and signaled once the window stops reading it.
+	 * Protected by vop->vsync_mutex.
+	 */
+	struct fence *fence;
+	struct fence *pending_fence;
+	unsigned int fence_context;
+	unsigned int fence_seqno;
+};
+
+#define VOP_LATENCY_BUCKETS	8
 
-	struct list_head pending;
-	struct vop_win_state *active;
+/*
+ * Frame timing statistics, exposed through debugfs. @frames and
+ * @bus_errors are only updated from the hard irq, everything else is
+ * protected by vop->vsync_mutex.
+ */
+struct vop_stats {
+	unsigned long frames;
+	unsigned long bus_errors;
+	unsigned long commits;
+	unsigned long flips;
+	/* frame starts where a committed update was not latched yet */
+	unsigned long late_frames;
+	/* commit to scanout latency, bucket n counts latencies below 2^n ms */
+	unsigned long latency[VOP_LATENCY_BUCKETS];
+	ktime_t commit_time;
 };
 
 struct vop {
@@ -93,6 +145,10 @@ struct vop {
 	struct mutex vsync_mutex;
 	bool vsync_work_pending;
 	struct completion dsp_hold_completion;
+	struct completion wait_update_complete;
+	/* events of the commits the pending update completes */
+	struct list_head events;
+	spinlock_t fence_lock;
 
 	const struct vop_data *data;
 
@@ -121,6 +177,12 @@ struct vop {
 
 	int pipe;
 
+	struct vop_stats stats;
+	struct dentry *debugfs;
+
+	/* lets the DDR frequency change during vertical blanking */
+	struct rockchip_dmc_vop dmc;
+
 	struct vop_win win[];
 };
 
@@ -157,6 +219,7 @@ struct vop_ctrl {
 	struct vop_reg dither_down;
 	struct vop_reg dither_up;
 	struct vop_reg pin_pol;
+	struct vop_reg dsp_layer_sel;
 
 	struct vop_reg htotal_pw;
 	struct vop_reg hact_st_end;
@@ -327,6 +390,7 @@ static const struct vop_ctrl ctrl_data = {
 	.data_blank = VOP_REG(DSP_CTRL0, 0x1, 19),
 	.out_mode = VOP_REG(DSP_CTRL0, 0xf, 0),
 	.pin_pol = VOP_REG(DSP_CTRL0, 0xf, 4),
+	.dsp_layer_sel = VOP_REG(DSP_CTRL1, 0xff, 8),
 	.htotal_pw = VOP_REG(DSP_HTOTAL_HS_END, 0x1fff1fff, 0),
 	.hact_st_end = VOP_REG(DSP_HACT_ST_END, 0x1fff1fff, 0),
 	.vtotal_pw = VOP_REG(DSP_VTOTAL_VS_END, 0x1fff1fff, 0),
@@ -395,6 +459,7 @@ static inline uint32_t vop_read_reg(struct vop *vop, uint32_t base,
 static inline void vop_cfg_done(struct vop *vop)
 {
 	writel(0x01, vop->regs + REG_CFG_DONE);
+	trace_rockchip_vop_cfg_done(vop->pipe);
 }
 
 static inline void vop_mask_write(struct vop *vop, uint32_t offset,
@@ -603,6 +668,50 @@ static void scl_vop_cal_scl_fac(struct vop *vop, const struct vop_win_data *win,
 	}
 }
 
+/*
+ * Check a scaled window against the line buffer limits that
+ * scl_vop_cal_scl_fac() has to work with.
+ */
+static int scl_vop_check_scale(uint32_t src_w, uint32_t src_h,
+			       uint32_t dst_w, uint32_t dst_h,
+			       uint32_t pixel_format)
+{
+	int hsub = drm_format_horz_chroma_subsampling(pixel_format);
+	int vsub = drm_format_vert_chroma_subsampling(pixel_format);
+	bool is_yuv = is_yuv_support(pixel_format);
+	uint16_t cbcr_src_w = src_w / hsub;
+	uint16_t cbcr_src_h = src_h / vsub;
+	int lb_mode;
+
+	if (dst_w > 3840) {
+		DRM_DEBUG_KMS("Maximum destination width (3840) exceeded\n");
+		return -EINVAL;
+	}
+
+	if (is_yuv) {
+		if (scl_get_scl_mode(cbcr_src_w, dst_w) == SCALE_DOWN)
+			lb_mode = scl_vop_cal_lb_mode(dst_w, true);
+		else
+			lb_mode = scl_vop_cal_lb_mode(cbcr_src_w, true);
+	} else {
+		if (scl_get_scl_mode(src_w, dst_w) == SCALE_DOWN)
+			lb_mode = scl_vop_cal_lb_mode(dst_w, false);
+		else
+			lb_mode = scl_vop_cal_lb_mode(src_w, false);
+	}
+
+	/* The widest line buffer mode has no room for vertical filtering */
+	if (lb_mode == LB_RGB_3840X2 &&
+	    (scl_get_scl_mode(src_h, dst_h) != SCALE_NONE ||
+	     (is_yuv && scl_get_scl_mode(cbcr_src_h, dst_h) != SCALE_NONE))) {
+		DRM_DEBUG_KMS("Vertical scaling not allowed for width %u\n",
+			      max(src_w, dst_w));
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
 static void vop_dsp_hold_valid_irq_enable(struct vop *vop)
 {
 	unsigned long flags;
@@ -633,24 +742,24 @@ static void vop_dsp_hold_valid_irq_disable(struct vop *vop)
 	spin_unlock_irqrestore(&vop->irq_lock, flags);
 }
 
-static void vop_enable(struct drm_crtc *crtc)
+static int vop_enable(struct drm_crtc *crtc)
 {
 	struct vop *vop = to_vop(crtc);
 	int ret;
 
 	if (vop->is_enabled)
-		return;
+		return 0;
 
 	ret = pm_runtime_get_sync(vop->dev);
 	if (ret < 0) {
 		dev_err(vop->dev, "failed to get pm runtime: %d\n", ret);
-		return;
+		return ret;
 	}
 
 	ret = clk_enable(vop->hclk);
 	if (ret < 0) {
 		dev_err(vop->dev, "failed to enable hclk - %d\n", ret);
-		return;
+		return ret;
 	}
 
 	ret = clk_enable(vop->dclk);
@@ -689,11 +798,20 @@ static void vop_enable(struct drm_crtc *crtc)
 
 	spin_unlock(&vop->reg_lock);
 
+	/*
+	 * There is no dedicated underflow interrupt, a bus error is what
+	 * shows up when the window fetch cannot keep up with the scanout.
+	 */
+	spin_lock_irq(&vop->irq_lock);
+	vop_mask_write(vop, INTR_CTRL0, BUS_ERROR_INTR_MASK,
+		       BUS_ERROR_INTR_EN(1));
+	spin_unlock_irq(&vop->irq_lock);
+
 	enable_irq(vop->irq);
 
-	drm_vblank_on(vop->drm_dev, vop->pipe);
+	drm_crtc_vblank_on(crtc);
 
-	return;
+	return 0;
 
 err_disable_aclk:
 	clk_disable(vop->aclk);
@@ -701,16 +819,148 @@ err_disable_dclk:
 	clk_disable(vop->dclk);
 err_disable_hclk:
 	clk_disable(vop->hclk);
+	return ret;
 }
 
-static void vop_disable(struct drm_crtc *crtc)
+static const char *vop_fence_get_driver_name(struct fence *fence)
+{
+	return "rockchip";
+}
+
+static const char *vop_fence_get_timeline_name(struct fence *fence)
+{
+	return "vop-scanout";
+}
+
+static bool vop_fence_enable_signaling(struct fence *fence)
+{
+	return true;
+}
+
+static const struct fence_ops vop_fence_ops = {
+	.get_driver_name = vop_fence_get_driver_name,
+	.get_timeline_name = vop_fence_get_timeline_name,
+	.enable_signaling = vop_fence_enable_signaling,
+	.wait = fence_default_wait,
+};
+
+/*
+ * Create a scanout fence for a window and add it to the reservation
+ * object of the framebuffer, so that its producer waits for the scanout
+ * to retire before rendering into it again. Returns NULL when the buffer
+ * is not shared, or if the fence could not be added.
+ */
+static struct fence *vop_win_create_fence(struct vop_win *vop_win,
+					  struct drm_framebuffer *fb)
+{
+	struct reservation_object *resv;
+	struct fence *fence;
+
+	resv = rockchip_gem_get_resv(rockchip_fb_get_gem_obj(fb, 0));
+	if (!resv)
+		return NULL;
+
+	fence = kzalloc(sizeof(*fence), GFP_KERNEL);
+	if (!fence)
+		return NULL;
+
+	fence_init(fence, &vop_fence_ops, &vop_win->vop->fence_lock,
+		   vop_win->fence_context, ++vop_win->fence_seqno);
+
+	ww_mutex_lock(&resv->lock, NULL);
+	if (reservation_object_reserve_shared(resv)) {
+		ww_mutex_unlock(&resv->lock);
+		fence_put(fence);
+		return NULL;
+	}
+	reservation_object_add_shared_fence(resv, fence);
+	ww_mutex_unlock(&resv->lock);
+
+	return fence;
+}
+
+/*
+ * Set the fence of the framebuffer the pending update switches to.
+ * Caller must hold vsync_mutex.
+ */
+static void vop_win_set_pending_fence(struct vop_win *vop_win,
+				      struct fence *fence)
+{
+	struct fence *old = vop_win->pending_fence;
+
+	/* an earlier update that was never latched is superseded */
+	if (old && old != vop_win->fence && old != fence)
+		fence_signal(old);
+	fence_put(old);
+
+	vop_win->pending_fence = fence;
+}
+
+/*
+ * The pending update has been latched: the previous framebuffer is no
+ * longer scanned out. Caller must hold vsync_mutex.
+ */
+static void vop_win_retire_fence(struct vop_win *vop_win)
+{
+	if (vop_win->fence && vop_win->fence != vop_win->pending_fence)
+		fence_signal(vop_win->fence);
+	fence_put(vop_win->fence);
+
+	vop_win->fence = vop_win->pending_fence;
+	vop_win->pending_fence = NULL;
+}
+
+/*
+ * Caller must hold vsync_mutex.
+ */
+static void vop_update_complete(struct vop *vop)
+{
+	struct drm_crtc *crtc = &vop->crtc;
+	struct drm_device *drm = vop->drm_dev;
+	struct drm_pending_vblank_event *event, *tmp;
+	unsigned long flags;
+	unsigned int i;
+
+	for (i = 0; i < vop->data->win_size; i++) {
+		struct vop_win *vop_win = &vop->win[i];
+
+		if (vop_win->pending)
+			vop_win_retire_fence(vop_win);
+		vop_win->pending = false;
+	}
+
+	vop->vsync_work_pending = false;
+
+	spin_lock_irqsave(&drm->event_lock, flags);
+	list_for_each_entry_safe(event, tmp, &vop->events, base.link) {
+		list_del(&event->base.link);
+		drm_crtc_send_vblank_event(crtc, event);
+	}
+	spin_unlock_irqrestore(&drm->event_lock, flags);
+
+	drm_crtc_vblank_put(crtc);
+	complete_all(&vop->wait_update_complete);
+}
+
+static void vop_crtc_disable(struct drm_crtc *crtc)
 {
 	struct vop *vop = to_vop(crtc);
+	unsigned int i;
 
 	if (!vop->is_enabled)
 		return;
 
-	drm_vblank_off(crtc->dev, vop->pipe);
+	/*
+	 * The frame start irq goes away with the vblank, so complete any
+	 * update that is still waiting to be latched now.
+	 */
+	mutex_lock(&vop->vsync_mutex);
+	if (vop->vsync_work_pending)
+		vop_update_complete(vop);
+	mutex_unlock(&vop->vsync_mutex);
+
+	rockchip_dmc_vop_disable(&vop->dmc);
+	drm_crtc_vblank_off(crtc);
 
 	/*
 	 * Vop standby will take effect at end of current frame,
@@ -732,8 +982,25 @@ static void vop_disable(struct drm_crtc *crtc)
 
 	vop_dsp_hold_valid_irq_disable(vop);
 
+	/* mask the bus error irq of vop_enable() and drop a stale one */
+	spin_lock_irq(&vop->irq_lock);
+	vop_mask_write(vop, INTR_CTRL0, BUS_ERROR_INTR_MASK,
+		       BUS_ERROR_INTR_EN(0));
+	/* the clear bit is write-only, keep it out of regsbak */
+	writel(vop->regsbak[INTR_CTRL0 >> 2] | BUS_ERROR_INTR_CLR,
+	       vop->regs + INTR_CTRL0);
+	spin_unlock_irq(&vop->irq_lock);
+
 	disable_irq(vop->irq);
 
+	/* Nothing is scanned out any more, retire all framebuffers */
+	mutex_lock(&vop->vsync_mutex);
+	for (i = 0; i < vop->data->win_size; i++) {
+		vop_win_set_pending_fence(&vop->win[i], NULL);
+		vop_win_retire_fence(&vop->win[i]);
+	}
+	mutex_unlock(&vop->vsync_mutex);
+
 	vop->is_enabled = false;
 
 	/*
@@ -747,231 +1014,204 @@ static void vop_disable(struct drm_crtc *crtc)
 	pm_runtime_put(vop->dev);
 }
 
-/*
- * Caller must hold vsync_mutex.
- */
-static struct drm_framebuffer *vop_win_last_pending_fb(struct vop_win *vop_win)
-{
-	struct vop_win_state *last;
-	struct vop_win_state *active = vop_win->active;
-
-	if (list_empty(&vop_win->pending))
-		return active ? active->fb : NULL;
-
-	last = list_last_entry(&vop_win->pending, struct vop_win_state, head);
-	return last ? last->fb : NULL;
-}
-
-/*
- * Caller must hold vsync_mutex.
- */
-static int vop_win_queue_fb(struct vop_win *vop_win,
-			    struct drm_framebuffer *fb, dma_addr_t yrgb_mst,
-			    struct drm_pending_vblank_event *event)
+static void vop_plane_destroy(struct drm_plane *plane)
 {
-	struct vop_win_state *state;
-
-	state = kzalloc(sizeof(*state), GFP_KERNEL);
-	if (!state)
-		return -ENOMEM;
-
-	state->fb = fb;
-	state->yrgb_mst = yrgb_mst;
-	state->event = event;
-
-	list_add_tail(&state->head, &vop_win->pending);
-
-	return 0;
+	drm_plane_cleanup(plane);
 }
 
-static int vop_update_plane_event(struct drm_plane *plane,
-				  struct drm_crtc *crtc,
-				  struct drm_framebuffer *fb, int crtc_x,
-				  int crtc_y, unsigned int crtc_w,
-				  unsigned int crtc_h, uint32_t src_x,
-				  uint32_t src_y, uint32_t src_w,
-				  uint32_t src_h,
-				  struct drm_pending_vblank_event *event)
+static int vop_plane_atomic_check(struct drm_plane *plane,
+				  struct drm_plane_state *state)
 {
+	struct drm_crtc *crtc = state->crtc;
+	struct drm_framebuffer *fb = state->fb;
 	struct vop_win *vop_win = to_vop_win(plane);
+	struct vop_plane_state *vop_plane_state = to_vop_plane_state(state);
 	const struct vop_win_data *win = vop_win->data;
-	struct vop *vop = to_vop(crtc);
-	struct drm_gem_object *obj;
-	struct rockchip_gem_object *rk_obj;
-	struct drm_gem_object *uv_obj;
-	struct rockchip_gem_object *rk_uv_obj;
-	unsigned long offset;
-	unsigned int actual_w;
-	unsigned int actual_h;
-	unsigned int dsp_stx;
-	unsigned int dsp_sty;
-	unsigned int y_vir_stride;
-	unsigned int uv_vir_stride = 0;
-	dma_addr_t yrgb_mst;
-	dma_addr_t uv_mst = 0;
-	enum vop_data_format format;
-	uint32_t val;
-	bool is_alpha;
-	bool rb_swap;
-	bool is_yuv;
-	bool visible;
-	int ret;
-	struct drm_rect dest = {
-		.x1 = crtc_x,
-		.y1 = crtc_y,
-		.x2 = crtc_x + crtc_w,
-		.y2 = crtc_y + crtc_h,
-	};
-	struct drm_rect src = {
-		/* 16.16 fixed point */
-		.x1 = src_x,
-		.y1 = src_y,
-		.x2 = src_x + src_w,
-		.y2 = src_y + src_h,
-	};
-	const struct drm_rect clip = {
-		.x2 = crtc->mode.hdisplay,
-		.y2 = crtc->mode.vdisplay,
-	};
+	struct drm_crtc_state *crtc_state;
+	struct drm_rect *dest = &vop_plane_state->dest;
+	struct drm_rect *src = &vop_plane_state->src;
+	struct drm_rect clip;
 	bool can_position = plane->type != DRM_PLANE_TYPE_PRIMARY;
 	int min_scale = win->phy->scl ? FRAC_16_16(1, 8) :
 					DRM_PLANE_HELPER_NO_SCALING;
 	int max_scale = win->phy->scl ? FRAC_16_16(8, 1) :
 					DRM_PLANE_HELPER_NO_SCALING;
+	bool visible;
+	uint32_t val;
+	int ret;
+
+	if (!crtc || !fb)
+		goto out_disable;
+
+	crtc_state = drm_atomic_get_crtc_state(state->state, crtc);
+	if (IS_ERR(crtc_state))
+		return PTR_ERR(crtc_state);
+
+	if (!crtc_state->enable)
+		goto out_disable;
+
+	src->x1 = state->src_x;
+	src->y1 = state->src_y;
+	src->x2 = state->src_x + state->src_w;
+	src->y2 = state->src_y + state->src_h;
+	dest->x1 = state->crtc_x;
+	dest->y1 = state->crtc_y;
+	dest->x2 = state->crtc_x + state->crtc_w;
+	dest->y2 = state->crtc_y + state->crtc_h;
+
+	clip.x1 = 0;
+	clip.y1 = 0;
+	clip.x2 = crtc_state->adjusted_mode.hdisplay;
+	clip.y2 = crtc_state->adjusted_mode.vdisplay;
 
 	ret = drm_plane_helper_check_update(plane, crtc, fb,
-					    &src, &dest, &clip,
+					    src, dest, &clip,
 					    min_scale,
 					    max_scale,
-					    can_position, false, &visible);
+					    can_position, true, &visible);
 	if (ret)
 		return ret;
 
 	if (!visible)
-		return 0;
-
-	is_alpha = is_alpha_support(fb->pixel_format);
-	rb_swap = has_rb_swapped(fb->pixel_format);
-	is_yuv = is_yuv_support(fb->pixel_format);
+		goto out_disable;
 
-	format = vop_convert_format(fb->pixel_format);
-	if (format < 0)
-		return format;
+	vop_plane_state->format = vop_convert_format(fb->pixel_format);
+	if (vop_plane_state->format < 0)
+		return vop_plane_state->format;
 
-	obj = rockchip_fb_get_gem_obj(fb, 0);
-	if (!obj) {
+	if (!rockchip_fb_get_gem_obj(fb, 0)) {
 		DRM_ERROR("fail to get rockchip gem object from framebuffer\n");
 		return -EINVAL;
 	}
 
-	rk_obj = to_rockchip_obj(obj);
+	if (is_yuv_support(fb->pixel_format)) {
+		if (!rockchip_fb_get_gem_obj(fb, 1)) {
+			DRM_ERROR("fail to get uv object from framebuffer\n");
+			return -EINVAL;
+		}
 
-	if (is_yuv) {
 		/*
 		 * Src.x1 can be odd when do clip, but yuv plane start point
 		 * need align with 2 pixel.
 		 */
-		val = (src.x1 >> 16) % 2;
-		src.x1 += val << 16;
-		src.x2 += val << 16;
+		val = (src->x1 >> 16) % 2;
+		src->x1 += val << 16;
+		src->x2 += val << 16;
 	}
 
-	actual_w = (src.x2 - src.x1) >> 16;
-	actual_h = (src.y2 - src.y1) >> 16;
+	if (win->phy->scl) {
+		ret = scl_vop_check_scale(drm_rect_width(src) >> 16,
+					  drm_rect_height(src) >> 16,
+					  drm_rect_width(dest),
+					  drm_rect_height(dest),
+					  fb->pixel_format);
+		if (ret)
+			return ret;
+	}
 
-	dsp_stx = dest.x1 + crtc->mode.htotal - crtc->mode.hsync_start;
-	dsp_sty = dest.y1 + crtc->mode.vtotal - crtc->mode.vsync_start;
+	vop_plane_state->enable = true;
 
-	offset = (src.x1 >> 16) * drm_format_plane_cpp(fb->pixel_format, 0);
-	offset += (src.y1 >> 16) * fb->pitches[0];
+	return 0;
 
-	yrgb_mst = rk_obj->dma_addr + offset + fb->offsets[0];
-	y_vir_stride = fb->pitches[0] >> 2;
+out_disable:
+	vop_plane_state->enable = false;
+	return 0;
+}
 
-	if (is_yuv) {
-		int hsub = drm_format_horz_chroma_subsampling(fb->pixel_format);
-		int vsub = drm_format_vert_chroma_subsampling(fb->pixel_format);
-		int bpp = drm_format_plane_cpp(fb->pixel_format, 1);
+/*
+ * Program one window from its plane state. Caller must hold reg_lock; the
+ * new config is only latched by the next vop_cfg_done().
+ */
+static dma_addr_t vop_win_update(struct vop *vop,
+				 const struct vop_win_data *win,
+				 struct drm_plane_state *state)
+{
+	struct vop_plane_state *vop_plane_state = to_vop_plane_state(state);
+	struct drm_display_mode *mode = &vop->crtc.state->adjusted_mode;
+	struct drm_framebuffer *fb = state->fb;
+	struct drm_rect *src = &vop_plane_state->src;
+	struct drm_rect *dest = &vop_plane_state->dest;
+	struct rockchip_gem_object *rk_obj;
+	struct rockchip_gem_object *rk_uv_obj;
+	unsigned long offset;
+	unsigned int actual_w;
+	unsigned int actual_h;
+	unsigned int dsp_stx;
+	unsigned int dsp_sty;
+	dma_addr_t yrgb_mst;
+	dma_addr_t uv_mst;
+	uint32_t val;
 
-		uv_obj = rockchip_fb_get_gem_obj(fb, 1);
-		if (!uv_obj) {
-			DRM_ERROR("fail to get uv object from framebuffer\n");
-			return -EINVAL;
-		}
-		rk_uv_obj = to_rockchip_obj(uv_obj);
-		uv_vir_stride = fb->pitches[1] >> 2;
+	rk_obj = to_rockchip_obj(rockchip_fb_get_gem_obj(fb, 0));
 
-		offset = (src.x1 >> 16) * bpp / hsub;
-		offset += (src.y1 >> 16) * fb->pitches[1] / vsub;
+	actual_w = drm_rect_width(src) >> 16;
+	actual_h = drm_rect_height(src) >> 16;
 
-		uv_mst = rk_uv_obj->dma_addr + offset + fb->offsets[1];
-	}
+	dsp_stx = dest->x1 + mode->htotal - mode->hsync_start;
+	dsp_sty = dest->y1 + mode->vtotal - mode->vsync_start;
 
-	/*
-	 * If this plane update changes the plane's framebuffer, (or more
-	 * precisely, if this update has a different framebuffer than the last
-	 * update), enqueue it so we can track when it completes.
-	 *
-	 * Only when we discover that this update has completed, can we
-	 * unreference any previous framebuffers.
-	 */
-	mutex_lock(&vop->vsync_mutex);
-	if (fb != vop_win_last_pending_fb(vop_win)) {
-		ret = drm_vblank_get(plane->dev, vop->pipe);
-		if (ret) {
-			DRM_ERROR("failed to get vblank, %d\n", ret);
-			mutex_unlock(&vop->vsync_mutex);
-			return ret;
-		}
+	offset = (src->x1 >> 16) * drm_format_plane_cpp(fb->pixel_format, 0);
+	offset += (src->y1 >> 16) * fb->pitches[0];
+	yrgb_mst = rk_obj->dma_addr + offset + fb->offsets[0];
 
-		drm_framebuffer_reference(fb);
+	VOP_WIN_SET(vop, win, format, vop_plane_state->format);
+	VOP_WIN_SET(vop, win, yrgb_vir, fb->pitches[0] >> 2);
+	VOP_WIN_SET(vop, win, yrgb_mst, yrgb_mst);
 
-		ret = vop_win_queue_fb(vop_win, fb, yrgb_mst, event);
-		if (ret) {
-			drm_vblank_put(plane->dev, vop->pipe);
-			mutex_unlock(&vop->vsync_mutex);
-			return ret;
-		}
+	if (is_yuv_support(fb->pixel_format)) {
+		int hsub = drm_format_horz_chroma_subsampling(fb->pixel_format);
+		int vsub = drm_format_vert_chroma_subsampling(fb->pixel_format);
+		int bpp = drm_format_plane_cpp(fb->pixel_format, 1);
 
-		vop->vsync_work_pending = true;
-	}
-	mutex_unlock(&vop->vsync_mutex);
+		rk_uv_obj = to_rockchip_obj(rockchip_fb_get_gem_obj(fb, 1));
 
-	spin_lock(&vop->reg_lock);
+		offset = (src->x1 >> 16) * bpp / hsub;
+		offset += (src->y1 >> 16) * fb->pitches[1] / vsub;
+		uv_mst = rk_uv_obj->dma_addr + offset + fb->offsets[1];
 
-	VOP_WIN_SET(vop, win, format, format);
-	VOP_WIN_SET(vop, win, yrgb_vir, y_vir_stride);
-	VOP_WIN_SET(vop, win, yrgb_mst, yrgb_mst);
-	if (is_yuv) {
-		VOP_WIN_SET(vop, win, uv_vir, uv_vir_stride);
+		VOP_WIN_SET(vop, win, uv_vir, fb->pitches[1] >> 2);
 		VOP_WIN_SET(vop, win, uv_mst, uv_mst);
 	}
 
 	if (win->phy->scl)
 		scl_vop_cal_scl_fac(vop, win, actual_w, actual_h,
-				    dest.x2 - dest.x1, dest.y2 - dest.y1,
+				    drm_rect_width(dest), drm_rect_height(dest),
 				    fb->pixel_format);
 
 	val = (actual_h - 1) << 16;
 	val |= (actual_w - 1) & 0xffff;
 	VOP_WIN_SET(vop, win, act_info, val);
 
-	val = (dest.y2 - dest.y1 - 1) << 16;
-	val |= (dest.x2 - dest.x1 - 1) & 0xffff;
+	val = (drm_rect_height(dest) - 1) << 16;
+	val |= (drm_rect_width(dest) - 1) & 0xffff;
 	VOP_WIN_SET(vop, win, dsp_info, val);
 	val = (dsp_sty - 1) << 16;
 	val |= (dsp_stx - 1) & 0xffff;
 	VOP_WIN_SET(vop, win, dsp_st, val);
-	VOP_WIN_SET(vop, win, rb_swap, rb_swap);
+	VOP_WIN_SET(vop, win, rb_swap, has_rb_swapped(fb->pixel_format));
 
-	if (is_alpha) {
+	if (is_alpha_support(fb->pixel_format)) {
 		VOP_WIN_SET(vop, win, dst_alpha_ctl,
 			    DST_FACTOR_M0(ALPHA_SRC_INVERSE));
 		val = SRC_ALPHA_EN(1) | SRC_COLOR_M0(ALPHA_SRC_PRE_MUL) |
 			SRC_ALPHA_M0(ALPHA_STRAIGHT) |
-			SRC_BLEND_M0(ALPHA_PER_PIX) |
 			SRC_ALPHA_CAL_M0(ALPHA_NO_SATURATION) |
 			SRC_FACTOR_M0(ALPHA_ONE);
+		if (vop_plane_state->alpha < 0xff)
+			val |= SRC_BLEND_M0(ALPHA_PER_PIX_GLOBAL) |
+			       SRC_GLOBAL_ALPHA(vop_plane_state->alpha);
+		else
+			val |= SRC_BLEND_M0(ALPHA_PER_PIX);
+		VOP_WIN_SET(vop, win, src_alpha_ctl, val);
+	} else if (vop_plane_state->alpha < 0xff) {
+		VOP_WIN_SET(vop, win, dst_alpha_ctl,
+			    DST_FACTOR_M0(ALPHA_SRC_INVERSE));
+		val = SRC_ALPHA_EN(1) | SRC_COLOR_M0(ALPHA_SRC_NO_PRE_MUL) |
+			SRC_ALPHA_M0(ALPHA_STRAIGHT) |
+			SRC_BLEND_M0(ALPHA_GLOBAL) |
+			SRC_ALPHA_CAL_M0(ALPHA_NO_SATURATION) |
+			SRC_FACTOR_M0(ALPHA_ONE) |
+			SRC_GLOBAL_ALPHA(vop_plane_state->alpha);
 		VOP_WIN_SET(vop, win, src_alpha_ctl, val);
 	} else {
 		VOP_WIN_SET(vop, win, src_alpha_ctl, SRC_ALPHA_EN(0));
@@ -979,87 +1219,233 @@ static int vop_update_plane_event(struct drm_plane *plane,
 
 	VOP_WIN_SET(vop, win, enable, 1);
 
-	vop_cfg_done(vop);
-	spin_unlock(&vop->reg_lock);
-
-	return 0;
+	return yrgb_mst;
 }
 
-static int vop_update_plane(struct drm_plane *plane, struct drm_crtc *crtc,
-			    struct drm_framebuffer *fb, int crtc_x, int crtc_y,
-			    unsigned int crtc_w, unsigned int crtc_h,
-			    uint32_t src_x, uint32_t src_y, uint32_t src_w,
-			    uint32_t src_h)
+static void vop_plane_atomic_disable(struct drm_plane *plane,
+				     struct drm_plane_state *old_state)
 {
-	return vop_update_plane_event(plane, crtc, fb, crtc_x, crtc_y, crtc_w,
-				      crtc_h, src_x, src_y, src_w, src_h,
-				      NULL);
-}
+	struct vop_win *vop_win = to_vop_win(plane);
+	const struct vop_win_data *win = vop_win->data;
+	struct vop *vop;
 
-static int vop_update_primary_plane(struct drm_crtc *crtc,
-				    struct drm_pending_vblank_event *event)
-{
-	unsigned int crtc_w, crtc_h;
+	if (!old_state->crtc)
+		return;
 
-	crtc_w = crtc->primary->fb->width - crtc->x;
-	crtc_h = crtc->primary->fb->height - crtc->y;
+	vop = to_vop(old_state->crtc);
 
-	return vop_update_plane_event(crtc->primary, crtc, crtc->primary->fb,
-				      0, 0, crtc_w, crtc_h, crtc->x << 16,
-				      crtc->y << 16, crtc_w << 16,
-				      crtc_h << 16, event);
+	/*
+	 * A disabled vop is reprogrammed from the plane states when the crtc
+	 * is enabled again, nothing to do here.
+	 */
+	if (!vop->is_enabled)
+		return;
+
+	mutex_lock(&vop->vsync_mutex);
+	vop_win->pending = true;
+	vop_win->pending_enable = false;
+	vop_win_set_pending_fence(vop_win, NULL);
+	mutex_unlock(&vop->vsync_mutex);
+
+	spin_lock(&vop->reg_lock);
+	VOP_WIN_SET(vop, win, enable, 0);
+	spin_unlock(&vop->reg_lock);
 }
 
-static int vop_disable_plane(struct drm_plane *plane)
+static void vop_plane_atomic_update(struct drm_plane *plane,
+				    struct drm_plane_state *old_state)
 {
+	struct drm_plane_state *state = plane->state;
+	struct vop_plane_state *vop_plane_state = to_vop_plane_state(state);
 	struct vop_win *vop_win = to_vop_win(plane);
-	const struct vop_win_data *win = vop_win->data;
+	struct fence *fence = NULL;
+	bool same_fb;
 	struct vop *vop;
-	int ret;
-
-	if (!plane->crtc)
-		return 0;
+	dma_addr_t yrgb_mst;
 
-	vop = to_vop(plane->crtc);
+	if (!state->crtc)
+		return;
 
-	ret = drm_vblank_get(plane->dev, vop->pipe);
-	if (ret) {
-		DRM_ERROR("failed to get vblank, %d\n", ret);
-		return ret;
+	if (!vop_plane_state->enable) {
+		vop_plane_atomic_disable(plane, old_state);
+		return;
 	}
 
+	vop = to_vop(state->crtc);
+	if (!vop->is_enabled)
+		return;
+
+	/* a framebuffer that stays on screen keeps its scanout fence */
+	same_fb = old_state->fb == state->fb &&
+		  to_vop_plane_state(old_state)->enable;
+	if (!same_fb)
+		fence = vop_win_create_fence(vop_win, state->fb);
+
+	spin_lock(&vop->reg_lock);
+	yrgb_mst = vop_win_update(vop, vop_win->data, state);
+	spin_unlock(&vop->reg_lock);
+
 	mutex_lock(&vop->vsync_mutex);
+	vop_win->pending = true;
+	vop_win->pending_enable = true;
+	vop_win->pending_yrgb_mst = yrgb_mst;
+	if (same_fb)
+		fence = fence_get(vop_win->fence);
+	vop_win_set_pending_fence(vop_win, fence);
+	mutex_unlock(&vop->vsync_mutex);
+}
 
-	ret = vop_win_queue_fb(vop_win, NULL, 0, NULL);
-	if (ret) {
-		drm_vblank_put(plane->dev, vop->pipe);
-		mutex_unlock(&vop->vsync_mutex);
-		return ret;
+static const struct drm_plane_helper_funcs plane_helper_funcs = {
+	.atomic_check = vop_plane_atomic_check,
+	.atomic_update = vop_plane_atomic_update,
+	.atomic_disable = vop_plane_atomic_disable,
+};
+
+static void vop_atomic_plane_reset(struct drm_plane *plane)
+{
+	struct vop_plane_state *vop_plane_state;
+
+	if (plane->state) {
+		__drm_atomic_helper_plane_destroy_state(plane, plane->state);
+		kfree(to_vop_plane_state(plane->state));
+		plane->state = NULL;
 	}
 
-	vop->vsync_work_pending = true;
-	mutex_unlock(&vop->vsync_mutex);
+	vop_plane_state = kzalloc(sizeof(*vop_plane_state), GFP_KERNEL);
+	if (!vop_plane_state)
+		return;
 
-	spin_lock(&vop->reg_lock);
-	VOP_WIN_SET(vop, win, enable, 0);
-	vop_cfg_done(vop);
-	spin_unlock(&vop->reg_lock);
+	vop_plane_state->zpos = to_vop_win(plane)->zpos;
+	vop_plane_state->alpha = 0xff;
 
-	return 0;
+	plane->state = &vop_plane_state->base;
+	plane->state->plane = plane;
 }
 
-static void vop_plane_destroy(struct drm_plane *plane)
+static struct drm_plane_state *
+vop_atomic_plane_duplicate_state(struct drm_plane *plane)
 {
-	vop_disable_plane(plane);
-	drm_plane_cleanup(plane);
+	struct vop_plane_state *old_vop_plane_state;
+	struct vop_plane_state *vop_plane_state;
+
+	if (WARN_ON(!plane->state))
+		return NULL;
+
+	old_vop_plane_state = to_vop_plane_state(plane->state);
+	vop_plane_state = kmemdup(old_vop_plane_state,
+				  sizeof(*vop_plane_state), GFP_KERNEL);
+	if (!vop_plane_state)
+		return NULL;
+
+	__drm_atomic_helper_plane_duplicate_state(plane,
+						  &vop_plane_state->base);
+
+	return &vop_plane_state->base;
+}
+
+static void vop_atomic_plane_destroy_state(struct drm_plane *plane,
+					   struct drm_plane_state *state)
+{
+	struct vop_plane_state *vop_state = to_vop_plane_state(state);
+
+	__drm_atomic_helper_plane_destroy_state(plane, state);
+
+	kfree(vop_state);
+}
+
+static int vop_atomic_plane_set_property(struct drm_plane *plane,
+					 struct drm_plane_state *state,
+					 struct drm_property *property,
+					 uint64_t val)
+{
+	struct rockchip_drm_private *private = plane->dev->dev_private;
+	struct vop_plane_state *vop_plane_state = to_vop_plane_state(state);
+
+	if (property == private->plane_zpos_property) {
+		vop_plane_state->zpos = val;
+		return 0;
+	}
+
+	if (property == private->plane_alpha_property) {
+		vop_plane_state->alpha = val;
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+static int vop_atomic_plane_get_property(struct drm_plane *plane,
+					 const struct drm_plane_state *state,
+					 struct drm_property *property,
+					 uint64_t *val)
+{
+	struct rockchip_drm_private *private = plane->dev->dev_private;
+	const struct vop_plane_state *vop_plane_state =
+		container_of(state, const struct vop_plane_state, base);
+
+	if (property == private->plane_zpos_property) {
+		*val = vop_plane_state->zpos;
+		return 0;
+	}
+
+	if (property == private->plane_alpha_property) {
+		*val = vop_plane_state->alpha;
+		return 0;
+	}
+
+	return -EINVAL;
 }
 
 static const struct drm_plane_funcs vop_plane_funcs = {
-	.update_plane = vop_update_plane,
-	.disable_plane = vop_disable_plane,
+	.update_plane = drm_atomic_helper_update_plane,
+	.disable_plane = drm_atomic_helper_disable_plane,
 	.destroy = vop_plane_destroy,
+	.reset = vop_atomic_plane_reset,
+	.set_property = drm_atomic_helper_plane_set_property,
+	.atomic_duplicate_state = vop_atomic_plane_duplicate_state,
+	.atomic_destroy_state = vop_atomic_plane_destroy_state,
+	.atomic_set_property = vop_atomic_plane_set_property,
+	.atomic_get_property = vop_atomic_plane_get_property,
 };
 
+/*
+ * Program the window stacking order from the plane zpos properties.
+ * Windows with the same zpos keep their hardware order. Caller must hold
+ * reg_lock.
+ */
+static void vop_update_layer_sel(struct vop *vop)
+{
+	unsigned int order[ROCKCHIP_MAX_WIN];
+	unsigned int zpos[ROCKCHIP_MAX_WIN];
+	unsigned int win_size = vop->data->win_size;
+	unsigned int i, j, tmp;
+	uint32_t val = 0;
+
+	if (WARN_ON(win_size > ARRAY_SIZE(order)))
+		return;
+
+	for (i = 0; i < win_size; i++) {
+		struct drm_plane_state *state = vop->win[i].base.state;
+
+		order[i] = i;
+		zpos[i] = state ? to_vop_plane_state(state)->zpos : i;
+	}
+
+	/* insertion sort, stable for equal zpos */
+	for (i = 1; i < win_size; i++) {
+		tmp = order[i];
+		for (j = i; j > 0 && zpos[order[j - 1]] > zpos[tmp]; j--)
+			order[j] = order[j - 1];
+		order[j] = tmp;
+	}
+
+	/* layer 0 is the bottom of the stack */
+	for (i = 0; i < win_size; i++)
+		val |= order[i] << (i * 2);
+
+	VOP_CTRL_SET(vop, dsp_layer_sel, val);
+}
+
 int rockchip_drm_crtc_mode_config(struct drm_crtc *crtc,
 				  int connector_type,
 				  int out_mode)
@@ -1103,35 +1489,34 @@ static void vop_crtc_disable_vblank(struct drm_crtc *crtc)
 	spin_unlock_irqrestore(&vop->irq_lock, flags);
 }
 
-static const struct rockchip_crtc_funcs private_crtc_funcs = {
-	.enable_vblank = vop_crtc_enable_vblank,
-	.disable_vblank = vop_crtc_disable_vblank,
-};
-
-static void vop_crtc_dpms(struct drm_crtc *crtc, int mode)
+static void vop_crtc_wait_for_update(struct drm_crtc *crtc)
 {
-	DRM_DEBUG_KMS("crtc[%d] mode[%d]\n", crtc->base.id, mode);
+	struct vop *vop = to_vop(crtc);
 
-	switch (mode) {
-	case DRM_MODE_DPMS_ON:
-		vop_enable(crtc);
-		break;
-	case DRM_MODE_DPMS_STANDBY:
-	case DRM_MODE_DPMS_SUSPEND:
-	case DRM_MODE_DPMS_OFF:
-		vop_disable(crtc);
-		break;
-	default:
-		DRM_DEBUG_KMS("unspecified mode %d\n", mode);
-		break;
-	}
+	if (!wait_for_completion_timeout(&vop->wait_update_complete,
+					 msecs_to_jiffies(100)))
+		DRM_ERROR("crtc[%d] timed out waiting for config done\n",
+			  crtc->base.id);
 }
 
-static void vop_crtc_prepare(struct drm_crtc *crtc)
+static int vop_dmc_vblank_irq(struct rockchip_dmc_vop *dmc, bool on)
 {
-	vop_crtc_dpms(crtc, DRM_MODE_DPMS_ON);
+	struct vop *vop = container_of(dmc, struct vop, dmc);
+
+	if (!on) {
+		drm_crtc_vblank_put(&vop->crtc);
+		return 0;
+	}
+
+	return drm_crtc_vblank_get(&vop->crtc);
 }
 
+static const struct rockchip_crtc_funcs private_crtc_funcs = {
+	.enable_vblank = vop_crtc_enable_vblank,
+	.disable_vblank = vop_crtc_disable_vblank,
+	.wait_for_update = vop_crtc_wait_for_update,
+};
+
 static bool vop_crtc_mode_fixup(struct drm_crtc *crtc,
 				const struct drm_display_mode *mode,
 				struct drm_display_mode *adjusted_mode)
@@ -1142,29 +1527,10 @@ static bool vop_crtc_mode_fixup(struct drm_crtc *crtc,
 	return true;
 }
 
-static int vop_crtc_mode_set_base(struct drm_crtc *crtc, int x, int y,
-				  struct drm_framebuffer *old_fb)
-{
-	int ret;
-
-	crtc->x = x;
-	crtc->y = y;
-
-	ret = vop_update_primary_plane(crtc, NULL);
-	if (ret < 0) {
-		DRM_ERROR("fail to update plane\n");
-		return ret;
-	}
-
-	return 0;
-}
-
-static int vop_crtc_mode_set(struct drm_crtc *crtc,
-			     struct drm_display_mode *mode,
-			     struct drm_display_mode *adjusted_mode,
-			     int x, int y, struct drm_framebuffer *fb)
+static void vop_crtc_enable(struct drm_crtc *crtc)
 {
 	struct vop *vop = to_vop(crtc);
+	struct drm_display_mode *adjusted_mode = &crtc->state->adjusted_mode;
 	u16 hsync_len = adjusted_mode->hsync_end - adjusted_mode->hsync_start;
 	u16 hdisplay = adjusted_mode->hdisplay;
 	u16 htotal = adjusted_mode->htotal;
@@ -1175,8 +1541,12 @@ static int vop_crtc_mode_set(struct drm_crtc *crtc,
 	u16 vsync_len = adjusted_mode->vsync_end - adjusted_mode->vsync_start;
 	u16 vact_st = adjusted_mode->vtotal - adjusted_mode->vsync_start;
 	u16 vact_end = vact_st + vdisplay;
-	int ret, ret_clk;
+	unsigned int i;
 	uint32_t val;
+	int ret;
+
+	if (vop_enable(crtc))
+		return;
 
 	/*
 	 * disable dclk to stop frame scan, so that we can safe config mode and
@@ -1197,7 +1567,6 @@ static int vop_crtc_mode_set(struct drm_crtc *crtc,
 	default:
 		DRM_ERROR("unsupport connector_type[%d]\n",
 			  vop->connector_type);
-		ret = -EINVAL;
 		goto out;
 	};
 	VOP_CTRL_SET(vop, out_mode, vop->connector_out_mode);
@@ -1219,9 +1588,43 @@ static int vop_crtc_mode_set(struct drm_crtc *crtc,
 	VOP_CTRL_SET(vop, vact_st_end, val);
 	VOP_CTRL_SET(vop, vpost_st_end, val);
 
-	ret = vop_crtc_mode_set_base(crtc, x, y, fb);
-	if (ret)
-		goto out;
+	/* The restored windows start scanning out their framebuffers */
+	for (i = 0; i < vop->data->win_size; i++) {
+		struct vop_win *vop_win = &vop->win[i];
+		struct drm_plane_state *state = vop_win->base.state;
+		struct fence *fence;
+
+		if (!state || state->crtc != crtc ||
+		    !to_vop_plane_state(state)->enable)
+			continue;
+
+		fence = vop_win_create_fence(vop_win, state->fb);
+
+		mutex_lock(&vop->vsync_mutex);
+		vop_win_set_pending_fence(vop_win, fence);
+		vop_win_retire_fence(vop_win);
+		mutex_unlock(&vop->vsync_mutex);
+	}
+
+	/*
+	 * Planes that did not change in this commit keep their current state,
+	 * but their windows may have been updated while the vop was off, so
+	 * restore every window from its plane state.
+	 */
+	spin_lock(&vop->reg_lock);
+	for (i = 0; i < vop->data->win_size; i++) {
+		struct vop_win *vop_win = &vop->win[i];
+		struct drm_plane_state *state = vop_win->base.state;
+
+		if (state && state->crtc == crtc &&
+		    to_vop_plane_state(state)->enable)
+			vop_win_update(vop, vop_win->data, state);
+		else
+			VOP_WIN_SET(vop, vop_win->data, enable, 0);
+	}
+	vop_update_layer_sel(vop);
+	vop_cfg_done(vop);
+	spin_unlock(&vop->reg_lock);
 
 	/*
 	 * reset dclk, take all mode config affect, so the clk would run in
@@ -1233,150 +1636,132 @@ static int vop_crtc_mode_set(struct drm_crtc *crtc,
 
 	clk_set_rate(vop->dclk, adjusted_mode->clock * 1000);
 out:
-	ret_clk = clk_enable(vop->dclk);
-	if (ret_clk < 0) {
-		dev_err(vop->dev, "failed to enable dclk - %d\n", ret_clk);
-		return ret_clk;
-	}
-
-	return ret;
-}
+	ret = clk_enable(vop->dclk);
+	if (ret < 0)
+		dev_err(vop->dev, "failed to enable dclk - %d\n", ret);
 
-static void vop_crtc_commit(struct drm_crtc *crtc)
-{
+	/* time from the frame start irq to the first active line */
+	vop->dmc.vblank_us = div_u64((u64)vact_st * htotal * 1000,
+				     adjusted_mode->clock);
+	rockchip_dmc_vop_enable(&vop->dmc);
 }
 
-static const struct drm_crtc_helper_funcs vop_crtc_helper_funcs = {
-	.dpms = vop_crtc_dpms,
-	.prepare = vop_crtc_prepare,
-	.mode_fixup = vop_crtc_mode_fixup,
-	.mode_set = vop_crtc_mode_set,
-	.mode_set_base = vop_crtc_mode_set_base,
-	.commit = vop_crtc_commit,
-};
-
-static int vop_crtc_page_flip(struct drm_crtc *crtc,
-			      struct drm_framebuffer *fb,
-			      struct drm_pending_vblank_event *event,
-			      uint32_t page_flip_flags)
+static void vop_crtc_atomic_flush(struct drm_crtc *crtc,
+				  struct drm_crtc_state *old_crtc_state)
 {
 	struct vop *vop = to_vop(crtc);
-	struct drm_framebuffer *old_fb = crtc->primary->fb;
-	int ret;
-
-	/* when the page flip is requested, crtc should be on */
-	if (!vop->is_enabled) {
-		DRM_DEBUG("page flip request rejected because crtc is off.\n");
-		return 0;
-	}
+	struct drm_device *drm = crtc->dev;
+	struct drm_pending_vblank_event *event = crtc->state->event;
+	unsigned long flags;
+	unsigned int i;
 
-	crtc->primary->fb = fb;
+	crtc->state->event = NULL;
 
-	ret = vop_update_primary_plane(crtc, event);
-	if (ret)
-		crtc->primary->fb = old_fb;
+	if (!vop->is_enabled)
+		goto send_event;
 
-	return ret;
-}
+	/*
+	 * All windows of this commit were programmed by the plane updates,
+	 * latch them together at the next frame start and complete the
+	 * event once the hardware has picked them up.
+	 */
+	mutex_lock(&vop->vsync_mutex);
+	trace_rockchip_vop_commit(vop->pipe, event, vop->vsync_work_pending);
+	vop->stats.commits++;
+	if (vop->vsync_work_pending) {
+		/*
+		 * An unsynced cursor update has not been latched yet, this
+		 * update joins it and completes at the same frame start.
+		 */
+		if (event) {
+			list_add_tail(&event->base.link, &vop->events);
+			event = NULL;
+		}
+	} else if (!drm_crtc_vblank_get(crtc)) {
+		WARN_ON(!list_empty(&vop->events));
+		if (event) {
+			list_add_tail(&event->base.link, &vop->events);
+			event = NULL;
+		}
+		reinit_completion(&vop->wait_update_complete);
+		vop->vsync_work_pending = true;
+		vop->stats.commit_time = ktime_get();
+	} else {
+		/* no frame start to wait for, retire right away */
+		for (i = 0; i < vop->data->win_size; i++) {
+			if (vop->win[i].pending)
+				vop_win_retire_fence(&vop->win[i]);
+			vop->win[i].pending = false;
+		}
+	}
+	mutex_unlock(&vop->vsync_mutex);
 
-static void vop_win_state_complete(struct vop_win *vop_win,
-				   struct vop_win_state *state)
-{
-	struct vop *vop = vop_win->vop;
-	struct drm_crtc *crtc = &vop->crtc;
-	struct drm_device *drm = crtc->dev;
-	unsigned long flags;
+	spin_lock(&vop->reg_lock);
+	vop_update_layer_sel(vop);
+	vop_cfg_done(vop);
+	spin_unlock(&vop->reg_lock);
 
-	if (state->event) {
+send_event:
+	/* Nothing to wait for, signal the event right away */
+	if (event) {
 		spin_lock_irqsave(&drm->event_lock, flags);
-		drm_send_vblank_event(drm, -1, state->event);
+		drm_crtc_send_vblank_event(crtc, event);
 		spin_unlock_irqrestore(&drm->event_lock, flags);
 	}
-
-	list_del(&state->head);
-	drm_vblank_put(crtc->dev, vop->pipe);
 }
 
+static const struct drm_crtc_helper_funcs vop_crtc_helper_funcs = {
+	.enable = vop_crtc_enable,
+	.disable = vop_crtc_disable,
+	.mode_fixup = vop_crtc_mode_fixup,
+	.atomic_flush = vop_crtc_atomic_flush,
+};
+
 static void vop_crtc_destroy(struct drm_crtc *crtc)
 {
 	drm_crtc_cleanup(crtc);
 }
 
 static const struct drm_crtc_funcs vop_crtc_funcs = {
-	.set_config = drm_crtc_helper_set_config,
-	.page_flip = vop_crtc_page_flip,
+	.set_config = drm_atomic_helper_set_config,
+	.page_flip = drm_atomic_helper_page_flip,
 	.destroy = vop_crtc_destroy,
+	.reset = drm_atomic_helper_crtc_reset,
+	.atomic_duplicate_state = drm_atomic_helper_crtc_duplicate_state,
+	.atomic_destroy_state = drm_atomic_helper_crtc_destroy_state,
 };
 
-static bool vop_win_state_is_active(struct vop_win *vop_win,
-				    struct vop_win_state *state)
-{
-	bool active = false;
-
-	if (state->fb) {
-		dma_addr_t yrgb_mst;
-
-		/* check yrgb_mst to tell if pending_fb is now front */
-		yrgb_mst = VOP_WIN_GET_YRGBADDR(vop_win->vop, vop_win->data);
-
-		active = (yrgb_mst == state->yrgb_mst);
-	} else {
-		bool enabled;
-
-		/* if enable bit is clear, plane is now disabled */
-		enabled = VOP_WIN_GET(vop_win->vop, vop_win->data, enable);
-
-		active = (enabled == 0);
-	}
-
-	return active;
-}
-
-static void vop_win_state_destroy(struct vop_win_state *state)
-{
-	struct drm_framebuffer *fb = state->fb;
-
-	if (fb)
-		drm_framebuffer_unreference(fb);
-
-	kfree(state);
-}
-
-static void vop_win_update_state(struct vop_win *vop_win)
+static bool vop_win_pending_is_complete(struct vop_win *vop_win)
 {
-	struct vop_win_state *state, *n, *new_active = NULL;
-
-	/* Check if any pending states are now active */
-	list_for_each_entry(state, &vop_win->pending, head)
-		if (vop_win_state_is_active(vop_win, state)) {
-			new_active = state;
-			break;
-		}
+	dma_addr_t yrgb_mst;
 
-	if (!new_active)
-		return;
+	if (!vop_win->pending)
+		return true;
 
-	/*
-	 * Destroy any 'skipped' pending states - states that were queued
-	 * before the newly active state.
-	 */
-	list_for_each_entry_safe(state, n, &vop_win->pending, head) {
-		if (state == new_active)
-			break;
-		vop_win_state_complete(vop_win, state);
-		vop_win_state_destroy(state);
-	}
+	/* if enable bit is clear, plane is now disabled */
+	if (!vop_win->pending_enable)
+		return VOP_WIN_GET(vop_win->vop, vop_win->data, enable) == 0;
 
-	vop_win_state_complete(vop_win, new_active);
+	/* check yrgb_mst to tell if the pending fb is now front */
+	yrgb_mst = VOP_WIN_GET_YRGBADDR(vop_win->vop, vop_win->data);
 
-	if (vop_win->active)
-		vop_win_state_destroy(vop_win->active);
-	vop_win->active = new_active;
+	return yrgb_mst == vop_win->pending_yrgb_mst;
 }
 
-static bool vop_win_has_pending_state(struct vop_win *vop_win)
+/*
+ * Caller must hold vsync_mutex.
+ */
+static void vop_account_flip(struct vop *vop)
 {
-	return !list_empty(&vop_win->pending);
+	struct vop_stats *stats = &vop->stats;
+	s64 latency_us = ktime_us_delta(ktime_get(), stats->commit_time);
+	unsigned int bucket = fls(div_s64(latency_us, USEC_PER_MSEC));
+
+	stats->flips++;
+	stats->latency[min(bucket, VOP_LATENCY_BUCKETS - 1)]++;
+	trace_rockchip_vop_flip_complete(vop->pipe,
+					 drm_crtc_vblank_count(&vop->crtc),
+					 latency_us);
 }
 
 static irqreturn_t vop_isr_thread(int irq, void *data)
@@ -1390,16 +1775,16 @@ static irqreturn_t vop_isr_thread(int irq, void *data)
 	if (!vop->vsync_work_pending)
 		goto done;
 
-	vop->vsync_work_pending = false;
-
 	for (i = 0; i < vop_data->win_size; i++) {
-		struct vop_win *vop_win = &vop->win[i];
-
-		vop_win_update_state(vop_win);
-		if (vop_win_has_pending_state(vop_win))
-			vop->vsync_work_pending = true;
+		if (!vop_win_pending_is_complete(&vop->win[i])) {
+			vop->stats.late_frames++;
+			goto done;
+		}
 	}
 
+	vop_account_flip(vop);
+	vop_update_complete(vop);
+
 done:
 	mutex_unlock(&vop->vsync_mutex);
 
@@ -1436,8 +1821,20 @@ static irqreturn_t vop_isr(int irq, void *data)
 		ret = IRQ_HANDLED;
 	}
 
+	if (active_irqs & BUS_ERROR_INTR) {
+		vop->stats.bus_errors++;
+		trace_rockchip_vop_bus_error(vop->pipe);
+		active_irqs &= ~BUS_ERROR_INTR;
+		ret = IRQ_HANDLED;
+	}
+
 	if (active_irqs & FS_INTR) {
+		rockchip_dmc_vblank(&vop->dmc);
 		drm_handle_vblank(vop->drm_dev, vop->pipe);
+		vop->stats.frames++;
+		trace_rockchip_vop_frame_start(vop->pipe,
+					       drm_crtc_vblank_count(&vop->crtc),
+					       vop->vsync_work_pending);
 		active_irqs &= ~FS_INTR;
 		ret = (vop->vsync_work_pending) ? IRQ_WAKE_THREAD : IRQ_HANDLED;
 	}
@@ -1449,6 +1846,37 @@ static irqreturn_t vop_isr(int irq, void *data)
 	return ret;
 }
 
+static int vop_plane_attach_properties(struct drm_plane *plane,
+				       unsigned int zpos)
+{
+	struct drm_device *dev = plane->dev;
+	struct rockchip_drm_private *private = dev->dev_private;
+	struct drm_property *prop;
+
+	prop = private->plane_zpos_property;
+	if (!prop) {
+		prop = drm_property_create_range(dev, 0, "zpos", 0,
+						 ROCKCHIP_MAX_WIN - 1);
+		if (!prop)
+			return -ENOMEM;
+
+		private->plane_zpos_property = prop;
+	}
+	drm_object_attach_property(&plane->base, prop, zpos);
+
+	prop = private->plane_alpha_property;
+	if (!prop) {
+		prop = drm_property_create_range(dev, 0, "alpha", 0, 0xff);
+		if (!prop)
+			return -ENOMEM;
+
+		private->plane_alpha_property = prop;
+	}
+	drm_object_attach_property(&plane->base, prop, 0xff);
+
+	return 0;
+}
+
 static int vop_create_crtc(struct vop *vop)
 {
 	const struct vop_data *vop_data = vop->data;
@@ -1484,6 +1912,10 @@ static int vop_create_crtc(struct vop *vop)
 		}
 
 		plane = &vop_win->base;
+		drm_plane_helper_add(plane, &plane_helper_funcs);
+		ret = vop_plane_attach_properties(plane, vop_win->zpos);
+		if (ret)
+			goto err_cleanup_planes;
 		if (plane->type == DRM_PLANE_TYPE_PRIMARY)
 			primary = plane;
 		else if (plane->type == DRM_PLANE_TYPE_CURSOR)
@@ -1519,6 +1951,11 @@ static int vop_create_crtc(struct vop *vop)
 			DRM_ERROR("failed to initialize overlay plane\n");
 			goto err_cleanup_crtc;
 		}
+		drm_plane_helper_add(&vop_win->base, &plane_helper_funcs);
+		ret = vop_plane_attach_properties(&vop_win->base,
+						  vop_win->zpos);
+		if (ret)
+			goto err_cleanup_crtc;
 	}
 
 	port = of_get_child_by_name(dev->of_node, "port");
@@ -1529,6 +1966,11 @@ static int vop_create_crtc(struct vop *vop)
 	}
 
 	init_completion(&vop->dsp_hold_completion);
+	INIT_LIST_HEAD(&vop->events);
+	vop->dmc.vblank_irq = vop_dmc_vblank_irq;
+	/* nothing is pending yet, so waiters must not block */
+	init_completion(&vop->wait_update_complete);
+	complete_all(&vop->wait_update_complete);
 	crtc->port = port;
 	vop->pipe = drm_crtc_index(crtc);
 	rockchip_register_crtc_funcs(drm_dev, &private_crtc_funcs, vop->pipe);
@@ -1552,6 +1994,94 @@ static void vop_destroy_crtc(struct vop *vop)
 	drm_crtc_cleanup(crtc);
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int vop_debugfs_show(struct seq_file *s, void *data)
+{
+	struct vop *vop = s->private;
+	struct drm_device *drm = vop->drm_dev;
+	struct vop_stats *stats = &vop->stats;
+	unsigned int i;
+
+	seq_printf(s, "frames: %lu\n", stats->frames);
+	seq_printf(s, "bus errors: %lu\n", stats->bus_errors);
+	seq_printf(s, "late frames: %lu\n", stats->late_frames);
+	seq_printf(s, "commits: %lu\n", stats->commits);
+	seq_printf(s, "flips: %lu\n", stats->flips);
+
+	seq_puts(s, "commit to scanout latency:\n");
+	for (i = 0; i < VOP_LATENCY_BUCKETS - 1; i++)
+		seq_printf(s, "\t< %ums: %lu\n", 1 << i, stats->latency[i]);
+	seq_printf(s, "\t>= %ums: %lu\n", 1 << (i - 1), stats->latency[i]);
+
+	drm_modeset_lock_all(drm);
+	for (i = 0; i < vop->data->win_size; i++) {
+		struct vop_win *vop_win = &vop->win[i];
+		struct drm_plane_state *state = vop_win->base.state;
+		struct vop_plane_state *vop_plane_state;
+
+		seq_printf(s, "win%u:", i);
+		if (!state || !state->fb) {
+			seq_puts(s, " disabled\n");
+			continue;
+		}
+
+		vop_plane_state = to_vop_plane_state(state);
+		seq_printf(s, " fb=%u %ux%u@%d,%d zpos=%u alpha=%u",
+			   state->fb->base.id, state->crtc_w, state->crtc_h,
+			   state->crtc_x, state->crtc_y,
+			   vop_plane_state->zpos, vop_plane_state->alpha);
+		if (vop->is_enabled)
+			seq_printf(s, " hw_enable=%u yrgb=%#x",
+				   VOP_WIN_GET(vop, vop_win->data, enable),
+				   VOP_WIN_GET_YRGBADDR(vop, vop_win->data));
+		seq_puts(s, "\n");
+	}
+	drm_modeset_unlock_all(drm);
+
+	return 0;
+}
+
+static int vop_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vop_debugfs_show, inode->i_private);
+}
+
+static const struct file_operations vop_debugfs_fops = {
+	.owner = THIS_MODULE,
+	.open = vop_debugfs_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void vop_debugfs_init(struct vop *vop)
+{
+	struct drm_minor *minor = vop->drm_dev->primary;
+	char name[16];
+
+	if (!minor || !minor->debugfs_root)
+		return;
+
+	snprintf(name, sizeof(name), "vop%d", vop->pipe);
+	vop->debugfs = debugfs_create_file(name, S_IRUGO, minor->debugfs_root,
+					   vop, &vop_debugfs_fops);
+}
+
+static void vop_debugfs_cleanup(struct vop *vop)
+{
+	debugfs_remove(vop->debugfs);
+	vop->debugfs = NULL;
+}
+#else
+static inline void vop_debugfs_init(struct vop *vop)
+{
+}
+
+static inline void vop_debugfs_cleanup(struct vop *vop)
+{
+}
+#endif
+
 static int vop_initial(struct vop *vop)
 {
 	const struct vop_data *vop_data = vop->data;
@@ -1671,7 +2201,8 @@ static void vop_win_init(struct vop *vop)
 
 		vop_win->data = win_data;
 		vop_win->vop = vop;
-		INIT_LIST_HEAD(&vop_win->pending);
+		vop_win->zpos = i;
+		vop_win->fence_context = fence_context_alloc(1);
 	}
 }
 
@@ -1729,6 +2260,7 @@ static int vop_bind(struct device *dev, struct device *master, void *data)
 
 	spin_lock_init(&vop->reg_lock);
 	spin_lock_init(&vop->irq_lock);
+	spin_lock_init(&vop->fence_lock);
 
 	mutex_init(&vop->vsync_mutex);
 
@@ -1744,6 +2276,9 @@ static int vop_bind(struct device *dev, struct device *master, void *data)
 	if (ret)
 		return ret;
 
+	vop_debugfs_init(vop);
+
+	device_enable_async_suspend(&pdev->dev);
 	pm_runtime_enable(&pdev->dev);
 	return 0;
 }
@@ -1753,6 +2288,7 @@ static void vop_unbind(struct device *dev, struct device *master, void *data)
 	struct vop *vop = dev_get_drvdata(dev);
 
 	pm_runtime_disable(dev);
+	vop_debugfs_cleanup(vop);
 	vop_destroy_crtc(vop);
 }
 
@@ -25,6 +25,7 @@
 #include <linux/pm_runtime.h>
 #include <linux/seq_file.h>
 #include <linux/coresight.h>
+#include <linux/perf_event.h>
 #include <linux/amba/bus.h>
 #include <linux/clk.h>
 
@@ -180,13 +181,18 @@ static void etb_disable_hw(struct etb_drvdata *drvdata)
 	CS_LOCK(drvdata->base);
 }
 
-static void etb_dump_hw(struct etb_drvdata *drvdata)
+/*
+ * Copies the RAM content, oldest word first, to drvdata->buf and returns
+ * the number of bytes holding valid trace.
+ */
+static u32 etb_dump_hw(struct etb_drvdata *drvdata)
 {
 	int i;
 	u8 *buf_ptr;
 	u32 read_data, depth;
 	u32 read_ptr, write_ptr;
 	u32 frame_off, frame_endoff;
+	bool full;
 
 	CS_UNLOCK(drvdata->base);
 
@@ -204,8 +210,9 @@ static void etb_dump_hw(struct etb_drvdata *drvdata)
 		write_ptr += frame_endoff;
 	}
 
-	if ((readl_relaxed(drvdata->base + ETB_STATUS_REG)
-		      & ETB_STATUS_RAM_FULL) == 0)
+	full = readl_relaxed(drvdata->base + ETB_STATUS_REG) &
+	       ETB_STATUS_RAM_FULL;
+	if (!full)
 		writel_relaxed(0x0, drvdata->base + ETB_RAM_READ_POINTER);
 	else
 		writel_relaxed(write_ptr, drvdata->base + ETB_RAM_READ_POINTER);
@@ -234,6 +241,8 @@ static void etb_dump_hw(struct etb_drvdata *drvdata)
 	writel_relaxed(read_ptr, drvdata->base + ETB_RAM_READ_POINTER);
 
 	CS_LOCK(drvdata->base);
+
+	return (full ? depth : min(write_ptr, depth)) * 4;
 }
 
 static void etb_disable(struct coresight_device *csdev)
@@ -252,9 +261,58 @@ static void etb_disable(struct coresight_device *csdev)
 	dev_info(drvdata->dev, "ETB disabled\n");
 }
 
+static unsigned long etb_update_buffer(struct coresight_device *csdev,
+				       struct perf_output_handle *handle,
+				       struct cs_buffers *buf, bool *lost)
+{
+	struct etb_drvdata *drvdata = dev_get_drvdata(csdev->dev.parent);
+	unsigned long flags, size, room, to_copy, offset, len;
+	unsigned long buf_size = (unsigned long)buf->nr_pages << PAGE_SHIFT;
+	u8 *src;
+
+	spin_lock_irqsave(&drvdata->spinlock, flags);
+	if (!drvdata->enable) {
+		spin_unlock_irqrestore(&drvdata->spinlock, flags);
+		return 0;
+	}
+
+	etb_disable_hw(drvdata);
+	size = etb_dump_hw(drvdata);
+	etb_enable_hw(drvdata);
+
+	/* a full RAM means the oldest trace has been overwritten */
+	*lost = size == drvdata->buffer_depth * 4;
+
+	/* in snapshot mode the AUX area is simply overwritten */
+	room = buf->snapshot ? buf_size : handle->size;
+	to_copy = min(size, room);
+	if (to_copy < size)
+		*lost = true;
+
+	/* keep the most recent trace when it doesn't all fit */
+	src = drvdata->buf + size - to_copy;
+	offset = handle->head % buf_size;
+	size = to_copy;
+	while (to_copy) {
+		len = min(to_copy, PAGE_SIZE - offset % PAGE_SIZE);
+		memcpy(buf->data_pages[offset >> PAGE_SHIFT] +
+		       offset % PAGE_SIZE, src, len);
+		src += len;
+		to_copy -= len;
+		offset = (offset + len) % buf_size;
+	}
+
+	if (buf->snapshot)
+		handle->head += size;
+	spin_unlock_irqrestore(&drvdata->spinlock, flags);
+
+	return size;
+}
+
 static const struct coresight_ops_sink etb_sink_ops = {
 	.enable		= etb_enable,
 	.disable	= etb_disable,
+	.update_buffer	= etb_update_buffer,
 };
 
 static const struct coresight_ops etb_cs_ops = {
@@ -0,0 +1,254 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/types.h>
+#include <linux/device.h>
+#include <linux/err.h>
+#include <linux/slab.h>
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/percpu.h>
+#include <linux/workqueue.h>
+#include <linux/perf_event.h>
+#include <linux/coresight.h>
+
+#include "coresight-priv.h"
+
+static struct pmu etm_pmu;
+
+/* the ETM registered for each CPU, if any */
+static DEFINE_PER_CPU(struct coresight_device *, csdev_src);
+/* the AUX transaction of the event currently traced on each CPU */
+static DEFINE_PER_CPU(struct perf_output_handle, ctx_handle);
+
+/**
+ * struct etm_event_data - per AUX area tracing session
+ * @work:	releases the paths, free_aux() is called in atomic context.
+ * @mask:	CPUs whose path has been claimed for this session.
+ * @buf:	the AUX area, as handed to the sinks.
+ * @sink:	per CPU, the sink the ETM of that CPU is routed to.
+ */
+struct etm_event_data {
+	struct work_struct work;
+	cpumask_t mask;
+	struct cs_buffers buf;
+	struct coresight_device **sink;
+};
+
+static void free_event_data(struct work_struct *work)
+{
+	int cpu;
+	struct etm_event_data *event_data;
+
+	event_data = container_of(work, struct etm_event_data, work);
+
+	for_each_cpu(cpu, &event_data->mask) {
+		if (event_data->sink[cpu])
+			coresight_release_path(per_cpu(csdev_src, cpu));
+	}
+
+	kfree(event_data->sink);
+	kfree(event_data);
+}
+
+static void *etm_setup_aux(int event_cpu, void **pages,
+			   int nr_pages, bool overwrite)
+{
+	int cpu;
+	struct coresight_device *csdev, *sink;
+	struct etm_event_data *event_data;
+
+	event_data = kzalloc(sizeof(*event_data), GFP_KERNEL);
+	if (!event_data)
+		return NULL;
+
+	event_data->sink = kcalloc(nr_cpu_ids, sizeof(*event_data->sink),
+				   GFP_KERNEL);
+	if (!event_data->sink) {
+		kfree(event_data);
+		return NULL;
+	}
+
+	INIT_WORK(&event_data->work, free_event_data);
+	event_data->buf.nr_pages = nr_pages;
+	event_data->buf.snapshot = overwrite;
+	event_data->buf.data_pages = pages;
+
+	/* a per task event may run on any of the CPUs that have an ETM */
+	get_online_cpus();
+	if (event_cpu == -1)
+		cpumask_copy(&event_data->mask, cpu_online_mask);
+	else
+		cpumask_set_cpu(event_cpu, &event_data->mask);
+
+	for_each_cpu(cpu, &event_data->mask) {
+		csdev = per_cpu(csdev_src, cpu);
+		if (!csdev) {
+			cpumask_clear_cpu(cpu, &event_data->mask);
+			continue;
+		}
+
+		sink = coresight_claim_path(csdev);
+		if (IS_ERR(sink))
+			goto err;
+		event_data->sink[cpu] = sink;
+
+		if (!sink_ops(sink)->update_buffer) {
+			dev_err(&sink->dev, "sink can't be used with perf\n");
+			goto err;
+		}
+	}
+	put_online_cpus();
+
+	if (cpumask_empty(&event_data->mask))
+		goto err_free;
+
+	return event_data;
+
+err:
+	put_online_cpus();
+err_free:
+	free_event_data(&event_data->work);
+	return NULL;
+}
+
+static void etm_free_aux(void *data)
+{
+	struct etm_event_data *event_data = data;
+
+	schedule_work(&event_data->work);
+}
+
+static int etm_event_init(struct perf_event *event)
+{
+	if (event->attr.type != etm_pmu.type)
+		return -ENOENT;
+
+	if (event->cpu >= 0 && !per_cpu(csdev_src, event->cpu))
+		return -ENODEV;
+
+	return 0;
+}
+
+static void etm_event_start(struct perf_event *event, int flags)
+{
+	int cpu = smp_processor_id();
+	struct etm_event_data *event_data;
+	struct perf_output_handle *handle = this_cpu_ptr(&ctx_handle);
+	struct coresight_device *csdev = per_cpu(csdev_src, cpu);
+
+	if (!csdev)
+		goto fail;
+
+	event_data = perf_aux_output_begin(handle, event);
+	if (!event_data)
+		goto fail;
+
+	/* this CPU was offline when the session was set up */
+	if (!event_data->sink[cpu])
+		goto fail_end;
+
+	if (source_ops(csdev)->perf_enable(csdev, &event->attr))
+		goto fail_end;
+
+	event->hw.state = 0;
+	return;
+
+fail_end:
+	perf_aux_output_end(handle, 0, true);
+fail:
+	event->hw.state = PERF_HES_STOPPED;
+}
+
+static void etm_event_stop(struct perf_event *event, int mode)
+{
+	int cpu = smp_processor_id();
+	unsigned long size = 0;
+	bool lost = false;
+	struct coresight_device *sink;
+	struct etm_event_data *event_data;
+	struct perf_output_handle *handle = this_cpu_ptr(&ctx_handle);
+	struct coresight_device *csdev = per_cpu(csdev_src, cpu);
+
+	if (event->hw.state == PERF_HES_STOPPED)
+		return;
+
+	event->hw.state = PERF_HES_STOPPED;
+	if (!csdev || !handle->event)
+		return;
+
+	source_ops(csdev)->perf_disable(csdev);
+
+	event_data = perf_get_aux(handle);
+	sink = event_data->sink[cpu];
+	size = sink_ops(sink)->update_buffer(sink, handle,
+					     &event_data->buf, &lost);
+	perf_aux_output_end(handle, size, lost);
+}
+
+static int etm_event_add(struct perf_event *event, int mode)
+{
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (mode & PERF_EF_START) {
+		etm_event_start(event, 0);
+		if (hwc->state & PERF_HES_STOPPED)
+			return -EINVAL;
+	} else {
+		hwc->state = PERF_HES_STOPPED;
+	}
+
+	return 0;
+}
+
+static void etm_event_del(struct perf_event *event, int mode)
+{
+	etm_event_stop(event, PERF_EF_UPDATE);
+}
+
+static void etm_event_read(struct perf_event *event)
+{
+}
+
+void etm_perf_add_source(struct coresight_device *csdev, int cpu)
+{
+	if (WARN_ON(!source_ops(csdev)->perf_enable ||
+		    !source_ops(csdev)->perf_disable))
+		return;
+
+	per_cpu(csdev_src, cpu) = csdev;
+}
+
+void etm_perf_del_source(struct coresight_device *csdev, int cpu)
+{
+	if (per_cpu(csdev_src, cpu) == csdev)
+		per_cpu(csdev_src, cpu) = NULL;
+}
+
+static int __init etm_perf_init(void)
+{
+	etm_pmu.capabilities	= PERF_PMU_CAP_EXCLUSIVE | PERF_PMU_CAP_ITRACE;
+	etm_pmu.task_ctx_nr	= perf_sw_context;
+	etm_pmu.event_init	= etm_event_init;
+	etm_pmu.setup_aux	= etm_setup_aux;
+	etm_pmu.free_aux	= etm_free_aux;
+	etm_pmu.start		= etm_event_start;
+	etm_pmu.stop		= etm_event_stop;
+	etm_pmu.add		= etm_event_add;
+	etm_pmu.del		= etm_event_del;
+	etm_pmu.read		= etm_event_read;
+
+	return perf_pmu_register(&etm_pmu, "cs_etm", -1);
+}
+device_initcall(etm_perf_init);
@@ -27,6 +27,7 @@
 #include <linux/clk.h>
 #include <linux/cpu.h>
 #include <linux/coresight.h>
+#include <linux/perf_event.h>
 #include <linux/pm_wakeup.h>
 #include <linux/amba/bus.h>
 #include <linux/seq_file.h>
@@ -259,10 +260,52 @@ static void etm4_disable(struct coresight_device *csdev)
 	dev_info(drvdata->dev, "ETM tracing disabled\n");
 }
 
+static int etm4_perf_enable(struct coresight_device *csdev,
+			    struct perf_event_attr *attr)
+{
+	struct etmv4_drvdata *drvdata = dev_get_drvdata(csdev->dev.parent);
+	u32 vinst_ctrl;
+
+	if (WARN_ON_ONCE(drvdata->cpu != smp_processor_id()))
+		return -EINVAL;
+
+	spin_lock(&drvdata->spinlock);
+
+	/*
+	 * The sysfs configuration is used as is, apart from the exception
+	 * levels excluded by the event: TRCVICTLR.EXLEVEL_NS, bit[20] for
+	 * EL0 and bit[21] for EL1, stops tracing at that level when set.
+	 */
+	vinst_ctrl = drvdata->vinst_ctrl;
+	if (attr->exclude_user)
+		drvdata->vinst_ctrl |= BIT(20);
+	if (attr->exclude_kernel)
+		drvdata->vinst_ctrl |= BIT(21);
+	etm4_enable_hw(drvdata);
+	drvdata->vinst_ctrl = vinst_ctrl;
+	drvdata->enable = true;
+
+	spin_unlock(&drvdata->spinlock);
+
+	return 0;
+}
+
+static void etm4_perf_disable(struct coresight_device *csdev)
+{
+	struct etmv4_drvdata *drvdata = dev_get_drvdata(csdev->dev.parent);
+
+	spin_lock(&drvdata->spinlock);
+	etm4_disable_hw(drvdata);
+	drvdata->enable = false;
+	spin_unlock(&drvdata->spinlock);
+}
+
 static const struct coresight_ops_source etm4_source_ops = {
 	.trace_id	= etm4_trace_id,
 	.enable		= etm4_enable,
 	.disable	= etm4_disable,
+	.perf_enable	= etm4_perf_enable,
+	.perf_disable	= etm4_perf_disable,
 };
 
 static const struct coresight_ops etm4_cs_ops = {
@@ -2657,6 +2700,8 @@ static int etm4_probe(struct amba_device *adev, const struct amba_id *id)
 		goto err_coresight_register;
 	}
 
+	etm_perf_add_source(drvdata->csdev, drvdata->cpu);
+
 	dev_info(dev, "%s initialized\n", (char *)id->data);
 
 	if (boot_enable) {
@@ -2678,6 +2723,7 @@ static int etm4_remove(struct amba_device *adev)
 {
 	struct etmv4_drvdata *drvdata = amba_get_drvdata(adev);
 
+	etm_perf_del_source(drvdata->csdev, drvdata->cpu);
 	coresight_unregister(drvdata->csdev);
 	if (--etm4_count == 0)
 		unregister_hotcpu_notifier(&etm4_cpu_notifier);
@@ -52,6 +52,32 @@ static inline void CS_UNLOCK(void __iomem *addr)
 	} while (0);
 }
 
+/**
+ * struct cs_buffers - perf AUX area handed to a sink
+ * @nr_pages:	number of pages in @data_pages.
+ * @snapshot:	the AUX area is in overwrite (snapshot) mode.
+ * @data_pages:	virtual addresses of the AUX pages.
+ */
+struct cs_buffers {
+	unsigned int	nr_pages;
+	bool		snapshot;
+	void		**data_pages;
+};
+
+extern struct coresight_device *
+coresight_claim_path(struct coresight_device *csdev);
+extern void coresight_release_path(struct coresight_device *csdev);
+
+#ifdef CONFIG_CORESIGHT_ETM_PERF
+extern void etm_perf_add_source(struct coresight_device *csdev, int cpu);
+extern void etm_perf_del_source(struct coresight_device *csdev, int cpu);
+#else
+static inline void
+etm_perf_add_source(struct coresight_device *csdev, int cpu) {}
+static inline void
+etm_perf_del_source(struct coresight_device *csdev, int cpu) {}
+#endif
+
 #ifdef CONFIG_CORESIGHT_SOURCE_ETM3X
 extern int etm_readl_cp14(u32 off, unsigned int *val);
 extern int etm_writel_cp14(u32 off, u32 val);
@@ -24,6 +24,7 @@
 #include <linux/coresight.h>
 #include <linux/of_platform.h>
 #include <linux/delay.h>
+#include <linux/pm_runtime.h>
 
 #include "coresight-priv.h"
 
@@ -340,6 +341,10 @@ int coresight_enable(struct coresight_device *csdev)
 		dev_err(&csdev->dev, "wrong device type in %s\n", __func__);
 		goto out;
 	}
+	if (csdev->perf) {
+		ret = -EBUSY;
+		goto out;
+	}
 	if (csdev->enable)
 		goto out;
 
@@ -365,7 +370,7 @@ void coresight_disable(struct coresight_device *csdev)
 		dev_err(&csdev->dev, "wrong device type in %s\n", __func__);
 		goto out;
 	}
-	if (!csdev->enable)
+	if (!csdev->enable || csdev->perf)
 		goto out;
 
 	coresight_disable_source(csdev);
@@ -377,6 +382,98 @@ out:
 }
 EXPORT_SYMBOL_GPL(coresight_disable);
 
+static struct coresight_device *
+coresight_find_activated_sink(struct coresight_device *csdev)
+{
+	int i;
+	struct coresight_device *sink;
+
+	if ((csdev->type == CORESIGHT_DEV_TYPE_SINK ||
+	     csdev->type == CORESIGHT_DEV_TYPE_LINKSINK) &&
+	    csdev->activated)
+		return csdev;
+
+	for (i = 0; i < csdev->nr_outport; i++) {
+		if (!csdev->conns[i].child_dev)
+			continue;
+		sink = coresight_find_activated_sink(csdev->conns[i].child_dev);
+		if (sink)
+			return sink;
+	}
+
+	return NULL;
+}
+
+/**
+ * coresight_claim_path - enable the links and sink(s) downstream of a source
+ * @csdev: the source, which is left for the caller to switch on and off.
+ *
+ * Used by perf, where the source is toggled from atomic context every time
+ * the traced task is scheduled in or out.  Everything that may sleep, i.e.
+ * powering up the components, is done here once for the whole session.
+ *
+ * Return: the first activated sink found downstream of @csdev or an
+ * ERR_PTR() if the source is busy or no path could be enabled.
+ */
+struct coresight_device *coresight_claim_path(struct coresight_device *csdev)
+{
+	struct coresight_device *sink;
+	LIST_HEAD(path);
+	int ret;
+
+	mutex_lock(&coresight_mutex);
+	if (csdev->type != CORESIGHT_DEV_TYPE_SOURCE) {
+		sink = ERR_PTR(-EINVAL);
+		goto out;
+	}
+	if (csdev->enable) {
+		sink = ERR_PTR(-EBUSY);
+		goto out;
+	}
+
+	sink = coresight_find_activated_sink(csdev);
+	if (!sink) {
+		sink = ERR_PTR(-ENODEV);
+		goto out;
+	}
+
+	ret = coresight_build_paths(csdev, &path, true);
+	if (ret) {
+		dev_err(&csdev->dev, "building path(s) failed\n");
+		sink = ERR_PTR(ret);
+		goto out;
+	}
+
+	pm_runtime_get_sync(csdev->dev.parent);
+	csdev->enable = true;
+	csdev->perf = true;
+out:
+	mutex_unlock(&coresight_mutex);
+	return sink;
+}
+
+/**
+ * coresight_release_path - undo coresight_claim_path()
+ * @csdev: the source, which must have been turned off already.
+ */
+void coresight_release_path(struct coresight_device *csdev)
+{
+	LIST_HEAD(path);
+
+	mutex_lock(&coresight_mutex);
+	if (!csdev->perf)
+		goto out;
+
+	if (coresight_build_paths(csdev, &path, false))
+		dev_err(&csdev->dev, "releasing path(s) failed\n");
+
+	csdev->perf = false;
+	csdev->enable = false;
+	pm_runtime_put(csdev->dev.parent);
+out:
+	mutex_unlock(&coresight_mutex);
+}
+
 static ssize_t enable_sink_show(struct device *dev,
 				struct device_attribute *attr, char *buf)
 {
@@ -25,6 +25,8 @@
 #include <linux/mfd/syscon.h>
 #include <linux/regmap.h>
 #include <linux/math64.h>
+#include <linux/ktime.h>
+#include <linux/delay.h>
 
 
 /* Register Map */
@@ -74,6 +76,9 @@ enum {
 /* Constants */
 #define WAIT_TIMEOUT      1000 /* ms */
 #define DEFAULT_SCL_RATE  (100 * 1000) /* Hz */
+#define POLL_MAX_LEN      8    /* bytes, transfers up to this are polled */
+#define POLL_INTERVAL     5    /* us */
+#define POLL_TIMEOUT      500  /* us, then wait for the interrupt instead */
 
 enum rk3x_i2c_state {
 	STATE_IDLE,
@@ -98,6 +103,7 @@ struct rk3x_i2c {
 	/* Hardware resources */
 	void __iomem *regs;
 	struct clk *clk;
+	int irq;
 	struct notifier_block clk_rate_nb;
 
 	/* Settings */
@@ -111,6 +117,10 @@ struct rk3x_i2c {
 	wait_queue_head_t wait;
 	bool busy;
 
+	/* Messages of the current transfer not handed to the hw yet */
+	struct i2c_msg *msgs;
+	unsigned int num_msgs;
+
 	/* Current message */
 	struct i2c_msg *msg;
 	u8 addr;
@@ -165,6 +175,8 @@ static void rk3x_i2c_start(struct rk3x_i2c *i2c)
  *
  * @error: Error code to return in rk3x_i2c_xfer
  */
+static void rk3x_i2c_next(struct rk3x_i2c *i2c);
+
 static void rk3x_i2c_stop(struct rk3x_i2c *i2c, int error)
 {
 	unsigned int ctrl;
@@ -183,10 +195,6 @@ static void rk3x_i2c_stop(struct rk3x_i2c *i2c, int error)
 		ctrl |= REG_CON_STOP;
 		i2c_writel(i2c, ctrl, REG_CON);
 	} else {
-		/* Signal rk3x_i2c_xfer to start the next message. */
-		i2c->busy = false;
-		i2c->state = STATE_IDLE;
-
 		/*
 		 * The HW is actually not capable of REPEATED START. But we can
 		 * get the intended effect by resetting its internal state
@@ -194,8 +202,20 @@ static void rk3x_i2c_stop(struct rk3x_i2c *i2c, int error)
 		 */
 		i2c_writel(i2c, 0, REG_CON);
 
-		/* signal that we are finished with the current msg */
-		wake_up(&i2c->wait);
+		if (error) {
+			/* Signal rk3x_i2c_xfer that the transfer failed. */
+			i2c->busy = false;
+			i2c->state = STATE_IDLE;
+			wake_up(&i2c->wait);
+			return;
+		}
+
+		/*
+		 * Start the next message right away instead of bouncing
+		 * through rk3x_i2c_xfer.
+		 */
+		rk3x_i2c_next(i2c);
+		rk3x_i2c_start(i2c);
 	}
 }
 
@@ -772,64 +792,111 @@ static int rk3x_i2c_setup(struct rk3x_i2c *i2c, struct i2c_msg *msgs, int num)
 	return ret;
 }
 
+/**
+ * Hand the next message(s) of the current transfer to the hw. Called from
+ * rk3x_i2c_xfer for the first ones and from the interrupt handler for the
+ * following ones, so all messages of a transfer are chained without
+ * returning to process context in between.
+ */
+static void rk3x_i2c_next(struct rk3x_i2c *i2c)
+{
+	int ret;
+
+	/*
+	 * We can handle more than one message at once (see
+	 * rk3x_i2c_setup()).
+	 */
+	ret = rk3x_i2c_setup(i2c, i2c->msgs, i2c->num_msgs);
+
+	i2c->msgs += ret;
+	i2c->num_msgs -= ret;
+	i2c->is_last_msg = i2c->num_msgs == 0;
+}
+
+/**
+ * Short transfers, like the voltage updates of a PMIC during a cpufreq
+ * transition, complete in a few hundred microseconds at most. Waiting for
+ * them in wait_event_timeout() adds a wakeup and the scheduler latency of
+ * the caller on top, so drive the state machine by polling instead.
+ */
+static bool rk3x_i2c_should_poll(struct i2c_msg *msgs, int num)
+{
+	unsigned int len = 0;
+	int i;
+
+	for (i = 0; i < num; i++)
+		len += msgs[i].len;
+
+	return len <= POLL_MAX_LEN;
+}
+
+/**
+ * Run the interrupt handler with the IRQ line disabled, until the transfer
+ * is done or for POLL_TIMEOUT at most. A slow or stuck device must not keep
+ * the CPU spinning, so whatever is left then completes through the IRQ.
+ */
+static void rk3x_i2c_wait_xfer_poll(struct rk3x_i2c *i2c)
+{
+	ktime_t timeout = ktime_add_us(ktime_get(), POLL_TIMEOUT);
+
+	while (READ_ONCE(i2c->busy) &&
+	       ktime_compare(ktime_get(), timeout) < 0) {
+		udelay(POLL_INTERVAL);
+		rk3x_i2c_irq(0, i2c);
+	}
+}
+
 static int rk3x_i2c_xfer(struct i2c_adapter *adap,
 			 struct i2c_msg *msgs, int num)
 {
 	struct rk3x_i2c *i2c = (struct rk3x_i2c *)adap->algo_data;
+	bool polling = rk3x_i2c_should_poll(msgs, num);
 	unsigned long timeout, flags;
 	int ret = 0;
-	int i;
 
 	spin_lock_irqsave(&i2c->lock, flags);
 
 	clk_enable(i2c->clk);
 
-	i2c->is_last_msg = false;
-
-	/*
-	 * Process msgs. We can handle more than one message at once (see
-	 * rk3x_i2c_setup()).
-	 */
-	for (i = 0; i < num; i += ret) {
-		ret = rk3x_i2c_setup(i2c, msgs + i, num - i);
-
-		if (ret < 0) {
-			dev_err(i2c->dev, "rk3x_i2c_setup() failed\n");
-			break;
-		}
+	i2c->msgs = msgs;
+	i2c->num_msgs = num;
+	rk3x_i2c_next(i2c);
 
-		if (i + ret >= num)
-			i2c->is_last_msg = true;
-
-		spin_unlock_irqrestore(&i2c->lock, flags);
+	spin_unlock_irqrestore(&i2c->lock, flags);
 
+	if (polling) {
+		disable_irq(i2c->irq);
 		rk3x_i2c_start(i2c);
+		rk3x_i2c_wait_xfer_poll(i2c);
+		enable_irq(i2c->irq);
+	} else {
+		rk3x_i2c_start(i2c);
+	}
 
-		timeout = wait_event_timeout(i2c->wait, !i2c->busy,
-					     msecs_to_jiffies(WAIT_TIMEOUT));
-
-		spin_lock_irqsave(&i2c->lock, flags);
+	/* returns right away if polling already completed the transfer */
+	timeout = wait_event_timeout(i2c->wait, !i2c->busy,
+				     msecs_to_jiffies(WAIT_TIMEOUT * num));
 
-		if (timeout == 0) {
-			dev_err(i2c->dev, "timeout, ipd: 0x%02x, state: %d\n",
-				i2c_readl(i2c, REG_IPD), i2c->state);
+	spin_lock_irqsave(&i2c->lock, flags);
 
-			/* Force a STOP condition without interrupt */
-			i2c_writel(i2c, 0, REG_IEN);
-			i2c_writel(i2c, REG_CON_EN | REG_CON_STOP, REG_CON);
+	if (timeout == 0) {
+		dev_err(i2c->dev, "timeout, ipd: 0x%02x, state: %d\n",
+			i2c_readl(i2c, REG_IPD), i2c->state);
 
-			i2c->state = STATE_IDLE;
+		/* Force a STOP condition without interrupt */
+		i2c_writel(i2c, 0, REG_IEN);
+		i2c_writel(i2c, REG_CON_EN | REG_CON_STOP, REG_CON);
 
-			ret = -ETIMEDOUT;
-			break;
-		}
+		i2c->state = STATE_IDLE;
 
-		if (i2c->error) {
-			ret = i2c->error;
-			break;
-		}
+		ret = -ETIMEDOUT;
+	} else if (i2c->error) {
+		ret = i2c->error;
 	}
 
+	i2c->msgs = NULL;
+	i2c->num_msgs = 0;
+
 	clk_disable(i2c->clk);
 	spin_unlock_irqrestore(&i2c->lock, flags);
 
@@ -979,8 +1046,10 @@ static int rk3x_i2c_probe(struct platform_device *pdev)
 		dev_err(&pdev->dev, "cannot request IRQ\n");
 		return ret;
 	}
+	i2c->irq = irq;
 
 	platform_set_drvdata(pdev, i2c);
+	device_enable_async_suspend(&pdev->dev);
 
 	ret = clk_prepare(i2c->clk);
 	if (ret < 0) {
@@ -23,6 +23,9 @@
 #include <linux/completion.h>
 #include <linux/regulator/consumer.h>
 #include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
 
 #define SARADC_DATA			0x00
 
@@ -39,6 +42,7 @@
 #define SARADC_DLY_PU_SOC_MASK		0x3f
 
 #define SARADC_TIMEOUT			msecs_to_jiffies(100)
+#define SARADC_MAX_CHANNELS		3
 
 struct rockchip_saradc_data {
 	int				num_bits;
@@ -55,8 +59,28 @@ struct rockchip_saradc {
 	struct regulator	*vref;
 	const struct rockchip_saradc_data *data;
 	u16			last_val;
+
+	/*
+	 * Channels of a triggered scan, the isr moves on to the next one
+	 * by itself and only completes once all of them are converted.
+	 */
+	unsigned int		scan_chans[SARADC_MAX_CHANNELS];
+	unsigned int		scan_count;
+	unsigned int		scan_pos;
+	/* Room for all samples plus the 8 byte aligned timestamp */
+	u16			buffer[8] __aligned(8);
 };
 
+static void rockchip_saradc_start(struct rockchip_saradc *info, int chn)
+{
+	/* 8 clock periods as delay between power up and start cmd */
+	writel_relaxed(8, info->regs + SARADC_DLY_PU_SOC);
+
+	/* Select the channel to be used and trigger conversion */
+	writel(SARADC_CTRL_POWER_CTRL | (chn & SARADC_CTRL_CHN_MASK) |
+	       SARADC_CTRL_IRQ_ENABLE, info->regs + SARADC_CTRL);
+}
+
 static int rockchip_saradc_read_raw(struct iio_dev *indio_dev,
 				    struct iio_chan_spec const *chan,
 				    int *val, int *val2, long mask)
@@ -68,16 +92,13 @@ static int rockchip_saradc_read_raw(struct iio_dev *indio_dev,
 	case IIO_CHAN_INFO_RAW:
 		mutex_lock(&indio_dev->mlock);
 
-		reinit_completion(&info->completion);
-
-		/* 8 clock periods as delay between power up and start cmd */
-		writel_relaxed(8, info->regs + SARADC_DLY_PU_SOC);
+		if (iio_buffer_enabled(indio_dev)) {
+			mutex_unlock(&indio_dev->mlock);
+			return -EBUSY;
+		}
 
-		/* Select the channel to be used and trigger conversion */
-		writel(SARADC_CTRL_POWER_CTRL
-				| (chan->channel & SARADC_CTRL_CHN_MASK)
-				| SARADC_CTRL_IRQ_ENABLE,
-		       info->regs + SARADC_CTRL);
+		reinit_completion(&info->completion);
+		rockchip_saradc_start(info, chan->channel);
 
 		if (!wait_for_completion_timeout(&info->completion,
 						 SARADC_TIMEOUT)) {
@@ -115,29 +136,85 @@ static irqreturn_t rockchip_saradc_isr(int irq, void *dev_id)
 	/* Clear irq & power down adc */
 	writel_relaxed(0, info->regs + SARADC_CTRL);
 
+	if (info->scan_pos < info->scan_count) {
+		info->buffer[info->scan_pos++] = info->last_val;
+		if (info->scan_pos < info->scan_count) {
+			rockchip_saradc_start(info,
+					      info->scan_chans[info->scan_pos]);
+			return IRQ_HANDLED;
+		}
+	}
+
 	complete(&info->completion);
 
 	return IRQ_HANDLED;
 }
 
+static irqreturn_t rockchip_saradc_trigger_handler(int irq, void *p)
+{
+	struct iio_poll_func *pf = p;
+	struct iio_dev *indio_dev = pf->indio_dev;
+	struct rockchip_saradc *info = iio_priv(indio_dev);
+	unsigned int count = 0;
+	int i;
+
+	mutex_lock(&indio_dev->mlock);
+
+	for_each_set_bit(i, indio_dev->active_scan_mask, indio_dev->masklength)
+		info->scan_chans[count++] = indio_dev->channels[i].channel;
+
+	if (!count)
+		goto out;
+
+	info->scan_pos = 0;
+	info->scan_count = count;
+
+	reinit_completion(&info->completion);
+	rockchip_saradc_start(info, info->scan_chans[0]);
+
+	if (wait_for_completion_timeout(&info->completion, SARADC_TIMEOUT)) {
+		iio_push_to_buffers_with_timestamp(indio_dev, info->buffer,
+						   pf->timestamp);
+	} else {
+		writel_relaxed(0, info->regs + SARADC_CTRL);
+		dev_warn(&indio_dev->dev, "scan timed out\n");
+	}
+
+	info->scan_count = 0;
+out:
+	mutex_unlock(&indio_dev->mlock);
+
+	iio_trigger_notify_done(indio_dev->trig);
+
+	return IRQ_HANDLED;
+}
+
 static const struct iio_info rockchip_saradc_iio_info = {
 	.read_raw = rockchip_saradc_read_raw,
 	.driver_module = THIS_MODULE,
 };
 
-#define ADC_CHANNEL(_index, _id) {				\
+#define ADC_CHANNEL(_index, _id, _res) {			\
 	.type = IIO_VOLTAGE,					\
 	.indexed = 1,						\
 	.channel = _index,					\
 	.info_mask_separate = BIT(IIO_CHAN_INFO_RAW),		\
 	.info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE),	\
 	.datasheet_name = _id,					\
+	.scan_index = _index,					\
+	.scan_type = {						\
+		.sign = 'u',					\
+		.realbits = _res,				\
+		.storagebits = 16,				\
+		.endianness = IIO_CPU,				\
+	},							\
 }
 
 static const struct iio_chan_spec rockchip_saradc_iio_channels[] = {
-	ADC_CHANNEL(0, "adc0"),
-	ADC_CHANNEL(1, "adc1"),
-	ADC_CHANNEL(2, "adc2"),
+	ADC_CHANNEL(0, "adc0", 10),
+	ADC_CHANNEL(1, "adc1", 10),
+	ADC_CHANNEL(2, "adc2", 10),
+	IIO_CHAN_SOFT_TIMESTAMP(3),
 };
 
 static const struct rockchip_saradc_data saradc_data = {
@@ -148,8 +225,9 @@ static const struct rockchip_saradc_data saradc_data = {
 };
 
 static const struct iio_chan_spec rockchip_rk3066_tsadc_iio_channels[] = {
-	ADC_CHANNEL(0, "adc0"),
-	ADC_CHANNEL(1, "adc1"),
+	ADC_CHANNEL(0, "adc0", 12),
+	ADC_CHANNEL(1, "adc1", 12),
+	IIO_CHAN_SOFT_TIMESTAMP(2),
 };
 
 static const struct rockchip_saradc_data rk3066_tsadc_data = {
@@ -272,12 +350,20 @@ static int rockchip_saradc_probe(struct platform_device *pdev)
 	indio_dev->channels = info->data->channels;
 	indio_dev->num_channels = info->data->num_channels;
 
-	ret = iio_device_register(indio_dev);
+	ret = iio_triggered_buffer_setup(indio_dev, &iio_pollfunc_store_time,
+					 &rockchip_saradc_trigger_handler,
+					 NULL);
 	if (ret)
 		goto err_clk;
 
+	ret = iio_device_register(indio_dev);
+	if (ret)
+		goto err_buffer_cleanup;
+
 	return 0;
 
+err_buffer_cleanup:
+	iio_triggered_buffer_cleanup(indio_dev);
 err_clk:
 	clk_disable_unprepare(info->clk);
 err_pclk:
@@ -293,6 +379,7 @@ static int rockchip_saradc_remove(struct platform_device *pdev)
 	struct rockchip_saradc *info = iio_priv(indio_dev);
 
 	iio_device_unregister(indio_dev);
+	iio_triggered_buffer_cleanup(indio_dev);
 	clk_disable_unprepare(info->clk);
 	clk_disable_unprepare(info->pclk);
 	regulator_disable(info->vref);
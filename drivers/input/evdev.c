@@ -14,6 +14,7 @@
 #define EVDEV_MINORS		32
 #define EVDEV_MIN_BUFFER_SIZE	64U
 #define EVDEV_BUF_PACKETS	8
+#define EVDEV_MAX_RING_EVENTS	65536U
 
 #include <linux/poll.h>
 #include <linux/sched.h>
@@ -58,6 +59,16 @@ struct evdev_client {
 	struct list_head node;
 	int clk_type;
 	bool revoked;
+	/*
+	 * mmap()ed event ring, replaces buffer once set. Userspace can write
+	 * the whole header, so the kernel keeps its own size and indices.
+	 */
+	struct input_ring_header *ring;
+	struct input_ring_event *ring_events;
+	unsigned int ring_size;
+	unsigned int ring_head; /* next entry to write */
+	unsigned int ring_published; /* last head value stored in the ring */
+	bool ring_dropping; /* discarding the rest of an overflowed packet */
 	unsigned int bufsize;
 	struct input_event buffer[];
 };
@@ -208,6 +219,51 @@ static void __pass_event(struct evdev_client *client,
 	}
 }
 
+/* caller must hold client->buffer_lock */
+static bool __pass_ring_event(struct evdev_client *client,
+			      const struct input_event *event)
+{
+	struct input_ring_header *ring = client->ring;
+	struct input_ring_event *rev;
+	bool is_report = event->type == EV_SYN && event->code == SYN_REPORT;
+
+	if (client->ring_dropping) {
+		if (is_report) {
+			client->ring_dropping = false;
+			ring->dropped++;
+		}
+		return false;
+	}
+
+	if (client->ring_head - READ_ONCE(ring->tail) >= client->ring_size) {
+		/* full: discard the packet back to the last published head */
+		client->ring_head = client->ring_published;
+		if (is_report)
+			ring->dropped++;
+		else
+			client->ring_dropping = true;
+		return false;
+	}
+
+	rev = &client->ring_events[client->ring_head & (client->ring_size - 1)];
+	rev->sec = event->time.tv_sec;
+	rev->usec = event->time.tv_usec;
+	rev->type = event->type;
+	rev->code = event->code;
+	rev->value = event->value;
+	client->ring_head++;
+
+	if (is_report) {
+		/* paired with userspace's load-acquire of head */
+		client->ring_published = client->ring_head;
+		smp_store_release(&ring->head, client->ring_head);
+		kill_fasync(&client->fasync, SIGIO, POLL_IN);
+		return true;
+	}
+
+	return false;
+}
+
 static void evdev_pass_values(struct evdev_client *client,
 			const struct input_value *vals, unsigned int count,
 			ktime_t *ev_time)
@@ -229,6 +285,10 @@ static void evdev_pass_values(struct evdev_client *client,
 		event.type = v->type;
 		event.code = v->code;
 		event.value = v->value;
+		if (client->ring) {
+			wakeup |= __pass_ring_event(client, &event);
+			continue;
+		}
 		__pass_event(client, &event);
 		if (v->type == EV_SYN && v->code == SYN_REPORT)
 			wakeup = true;
@@ -417,6 +477,7 @@ static int evdev_release(struct inode *inode, struct file *file)
 
 	evdev_detach_client(evdev, client);
 
+	vfree(client->ring);
 	kvfree(client);
 
 	evdev_close_device(evdev);
@@ -535,6 +596,9 @@ static ssize_t evdev_read(struct file *file, char __user *buffer,
 	if (count != 0 && count < input_event_size())
 		return -EINVAL;
 
+	if (client->ring)
+		return -EINVAL;
+
 	for (;;) {
 		if (!evdev->exist || client->revoked)
 			return -ENODEV;
@@ -574,6 +638,16 @@ static ssize_t evdev_read(struct file *file, char __user *buffer,
 	return read;
 }
 
+static bool evdev_client_has_events(struct evdev_client *client)
+{
+	struct input_ring_header *ring = client->ring;
+
+	if (ring)
+		return READ_ONCE(ring->head) != READ_ONCE(ring->tail);
+
+	return client->packet_head != client->tail;
+}
+
 /* No kernel lock - fine */
 static unsigned int evdev_poll(struct file *file, poll_table *wait)
 {
@@ -588,12 +662,83 @@ static unsigned int evdev_poll(struct file *file, poll_table *wait)
 	else
 		mask = POLLHUP | POLLERR;
 
-	if (client->packet_head != client->tail)
+	if (evdev_client_has_events(client))
 		mask |= POLLIN | POLLRDNORM;
 
 	return mask;
 }
 
+/*
+ * Map an event ring (struct input_ring_header) for this client. Events go
+ * to the ring from then on, saving a copy and a read() per packet.
+ */
+static int evdev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct evdev_client *client = file->private_data;
+	struct evdev *evdev = client->evdev;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	struct input_ring_header *ring;
+	unsigned long nevents;
+	int error;
+
+	if (vma->vm_pgoff || !(vma->vm_flags & VM_SHARED) ||
+	    size <= PAGE_SIZE)
+		return -EINVAL;
+
+	nevents = (size - PAGE_SIZE) / sizeof(struct input_ring_event);
+	if (nevents < EVDEV_MIN_BUFFER_SIZE)
+		return -EINVAL;
+	nevents = rounddown_pow_of_two(min_t(unsigned long, nevents,
+					     EVDEV_MAX_RING_EVENTS));
+
+	/* don't map pages past the ring that we would never write to */
+	if (size > PAGE_ALIGN(PAGE_SIZE +
+			      nevents * sizeof(struct input_ring_event)))
+		return -EINVAL;
+
+	error = mutex_lock_interruptible(&evdev->mutex);
+	if (error)
+		return error;
+
+	if (!evdev->exist || client->revoked) {
+		error = -ENODEV;
+		goto out;
+	}
+
+	if (client->ring) {
+		error = -EBUSY;
+		goto out;
+	}
+
+	ring = vmalloc_user(size);
+	if (!ring) {
+		error = -ENOMEM;
+		goto out;
+	}
+
+	ring->size = nevents;
+	ring->offset = PAGE_SIZE;
+
+	error = remap_vmalloc_range(vma, ring, 0);
+	if (error) {
+		vfree(ring);
+		goto out;
+	}
+
+	spin_lock_irq(&client->buffer_lock);
+	client->ring_events = (void *)ring + PAGE_SIZE;
+	client->ring_size = nevents;
+	client->ring_head = 0;
+	client->ring_published = 0;
+	client->ring_dropping = false;
+	client->ring = ring;
+	spin_unlock_irq(&client->buffer_lock);
+
+ out:
+	mutex_unlock(&evdev->mutex);
+	return error;
+}
+
 #ifdef CONFIG_COMPAT
 
 #define BITS_PER_LONG_COMPAT (sizeof(compat_long_t) * 8)
@@ -1092,6 +1237,7 @@ static const struct file_operations evdev_fops = {
 	.read		= evdev_read,
 	.write		= evdev_write,
 	.poll		= evdev_poll,
+	.mmap		= evdev_mmap,
 	.open		= evdev_open,
 	.release	= evdev_release,
 	.unlocked_ioctl	= evdev_ioctl,
@@ -75,6 +75,9 @@
 
 #define IOMMU_REG_POLL_COUNT_FAST 1000
 
+/* Zap the whole iotlb instead of line by line above this many pages */
+#define RK_IOMMU_ZAP_ALL_PAGES	256
+
 struct rk_iommu_domain {
 	struct list_head iommus;
 	u32 *dt; /* page directory table */
@@ -546,7 +549,11 @@ static void rk_iommu_zap_iova(struct rk_iommu_domain *rk_domain,
 	list_for_each(pos, &rk_domain->iommus) {
 		struct rk_iommu *iommu;
 		iommu = list_entry(pos, struct rk_iommu, node);
-		rk_iommu_zap_lines(iommu, iova, size);
+		/* A full zap only drops translations the MMU will refetch */
+		if (size > RK_IOMMU_ZAP_ALL_PAGES * SPAGE_SIZE)
+			rk_iommu_command(iommu, RK_MMU_CMD_ZAP_CACHE);
+		else
+			rk_iommu_zap_lines(iommu, iova, size);
 	}
 	spin_unlock_irqrestore(&rk_domain->iommus_lock, flags);
 }
@@ -718,12 +725,103 @@ static size_t rk_iommu_unmap(struct iommu_domain *domain, unsigned long _iova,
 
 	spin_unlock_irqrestore(&rk_domain->dt_lock, flags);
 
-	/* Shootdown iotlb entries for iova range that was just unmapped */
+	/*
+	 * Shootdown iotlb entries for iova range that was just unmapped.
+	 * The caller may free the pages as soon as we return, so this
+	 * can't be deferred past this call.
+	 */
 	rk_iommu_zap_iova(rk_domain, iova, unmap_size);
 
 	return unmap_size;
 }
 
+/*
+ * Map a whole scatterlist under a single dt_lock hold. PTEs are written
+ * straight into the page tables and each page table touched is flushed
+ * once, instead of once per iommu_map() chunk. Only the first and last
+ * iova of the whole range can share a dte or pte cacheline with an
+ * existing mapping, so those are the only ones that need zapping.
+ */
+static size_t rk_iommu_map_sg(struct iommu_domain *domain,
+			      unsigned long _iova, struct scatterlist *sg,
+			      unsigned int nents, int prot)
+{
+	struct rk_iommu_domain *rk_domain = to_rk_domain(domain);
+	unsigned long flags;
+	dma_addr_t iova = (dma_addr_t)_iova;
+	u32 *page_table, *pte_addr = NULL;
+	unsigned int pte_count = 0;
+	struct scatterlist *s;
+	size_t mapped = 0;
+	unsigned int i;
+
+	if (!IS_ALIGNED(iova, SPAGE_SIZE))
+		return 0;
+
+	spin_lock_irqsave(&rk_domain->dt_lock, flags);
+
+	for_each_sg(sg, s, nents, i) {
+		phys_addr_t paddr = sg_phys(s);
+		size_t len = s->length;
+
+		if (!IS_ALIGNED(paddr | len, SPAGE_SIZE))
+			goto unwind;
+
+		for (; len; len -= SPAGE_SIZE) {
+			/* Start a new run at each page table boundary */
+			if (!pte_addr || !rk_iova_pte_index(iova)) {
+				if (pte_count)
+					rk_table_flush(pte_addr, pte_count);
+
+				page_table = rk_dte_get_page_table(rk_domain,
+								   iova);
+				if (IS_ERR(page_table)) {
+					pte_count = 0;
+					goto unwind;
+				}
+
+				pte_addr = &page_table[rk_iova_pte_index(iova)];
+				pte_count = 0;
+			}
+
+			if (rk_pte_is_page_valid(pte_addr[pte_count])) {
+				phys_addr_t page_phys =
+					rk_pte_page_address(pte_addr[pte_count]);
+
+				pr_err("iova: %pad already mapped to %pa cannot remap to phys: %pa prot: %#x\n",
+				       &iova, &page_phys, &paddr, prot);
+				goto unwind;
+			}
+
+			pte_addr[pte_count++] = rk_mk_pte(paddr, prot);
+
+			iova += SPAGE_SIZE;
+			paddr += SPAGE_SIZE;
+			mapped += SPAGE_SIZE;
+		}
+	}
+
+	if (pte_count)
+		rk_table_flush(pte_addr, pte_count);
+
+	spin_unlock_irqrestore(&rk_domain->dt_lock, flags);
+
+	rk_iommu_zap_iova_first_last(rk_domain, _iova, mapped);
+
+	return mapped;
+
+unwind:
+	if (pte_count)
+		rk_table_flush(pte_addr, pte_count);
+
+	spin_unlock_irqrestore(&rk_domain->dt_lock, flags);
+
+	/* Unmap the range of iovas that we just mapped */
+	iommu_unmap(domain, _iova, mapped);
+
+	return 0;
+}
+
 static struct rk_iommu *rk_iommu_from_dev(struct device *dev)
 {
 	struct iommu_group *group;
@@ -757,13 +855,24 @@ static int rk_iommu_attach_device(struct iommu_domain *domain,
 	if (!iommu)
 		return 0;
 
-	ret = rk_iommu_enable_stall(iommu);
-	if (ret)
-		return ret;
-
-	ret = rk_iommu_force_reset(iommu);
-	if (ret)
-		return ret;
+	/*
+	 * Detach leaves MMU_DTE_ADDR programmed. If the iommu kept its state
+	 * (its power domain stayed up) and still points at this domain's
+	 * directory table, there is nothing to reset: re-attaching then only
+	 * needs the iotlb zap below.
+	 */
+	dte_addr = virt_to_phys(rk_domain->dt);
+	if (rk_iommu_read(iommu, RK_MMU_DTE_ADDR) != dte_addr ||
+	    rk_iommu_read(iommu, RK_MMU_STATUS) &
+	    RK_MMU_STATUS_PAGE_FAULT_ACTIVE) {
+		ret = rk_iommu_enable_stall(iommu);
+		if (ret)
+			return ret;
+
+		ret = rk_iommu_force_reset(iommu);
+		if (ret)
+			return ret;
+	}
 
 	iommu->domain = domain;
 
@@ -772,7 +881,6 @@ static int rk_iommu_attach_device(struct iommu_domain *domain,
 	if (ret)
 		return ret;
 
-	dte_addr = virt_to_phys(rk_domain->dt);
 	rk_iommu_write(iommu, RK_MMU_DTE_ADDR, dte_addr);
 	rk_iommu_command(iommu, RK_MMU_CMD_ZAP_CACHE);
 	rk_iommu_write(iommu, RK_MMU_INT_MASK, RK_MMU_IRQ_MASK);
@@ -812,7 +920,6 @@ static void rk_iommu_detach_device(struct iommu_domain *domain,
 	rk_iommu_enable_stall(iommu);
 	rk_iommu_disable_paging(iommu);
 	rk_iommu_write(iommu, RK_MMU_INT_MASK, 0);
-	rk_iommu_write(iommu, RK_MMU_DTE_ADDR, 0);
 	rk_iommu_disable_stall(iommu);
 
 	devm_free_irq(dev, iommu->irq, iommu);
@@ -977,6 +1084,7 @@ static const struct iommu_ops rk_iommu_ops = {
 	.detach_dev = rk_iommu_detach_device,
 	.map = rk_iommu_map,
 	.unmap = rk_iommu_unmap,
+	.map_sg = rk_iommu_map_sg,
 	.add_device = rk_iommu_add_device,
 	.remove_device = rk_iommu_remove_device,
 	.iova_to_phys = rk_iommu_iova_to_phys,
@@ -1007,6 +1115,9 @@ static int rk_iommu_probe(struct platform_device *pdev)
 		return -ENXIO;
 	}
 
+	/* no ordering against other devices needed, resume in parallel */
+	device_enable_async_suspend(dev);
+
 	return 0;
 }
 
@@ -42,6 +42,11 @@
 #include <linux/irqchip/chained_irq.h>
 #include <linux/irqchip/arm-gic.h>
 #include <linux/irqchip/arm-gic-acpi.h>
+#include <linux/irqdesc.h>
+#include <linux/kernel_stat.h>
+#include <linux/moduleparam.h>
+#include <linux/sort.h>
+#include <linux/workqueue.h>
 
 #include <asm/cputype.h>
 #include <asm/irq.h>
@@ -285,14 +290,27 @@ static int gic_irq_set_vcpu_affinity(struct irq_data *d, void *vcpu)
 }
 
 #ifdef CONFIG_SMP
-static int gic_set_affinity(struct irq_data *d, const struct cpumask *mask_val,
-			    bool force)
+static void gic_route_spi(void __iomem *dist_base, unsigned int hwirq,
+			  unsigned int cpu)
 {
-	void __iomem *reg = gic_dist_base(d) + GIC_DIST_TARGET + (gic_irq(d) & ~3);
-	unsigned int cpu, shift = (gic_irq(d) % 4) * 8;
+	void __iomem *reg = dist_base + GIC_DIST_TARGET + (hwirq & ~3);
+	unsigned int shift = (hwirq % 4) * 8;
 	u32 val, mask, bit;
 	unsigned long flags;
 
+	raw_spin_lock_irqsave(&irq_controller_lock, flags);
+	mask = 0xff << shift;
+	bit = gic_cpu_map[cpu] << shift;
+	val = readl_relaxed(reg) & ~mask;
+	writel_relaxed(val | bit, reg);
+	raw_spin_unlock_irqrestore(&irq_controller_lock, flags);
+}
+
+static int gic_set_affinity(struct irq_data *d, const struct cpumask *mask_val,
+			    bool force)
+{
+	unsigned int cpu;
+
 	if (!force)
 		cpu = cpumask_any_and(mask_val, cpu_online_mask);
 	else
@@ -301,15 +319,202 @@ static int gic_set_affinity(struct irq_data *d, const struct cpumask *mask_val,
 	if (cpu >= NR_GIC_CPU_IF || cpu >= nr_cpu_ids)
 		return -EINVAL;
 
-	raw_spin_lock_irqsave(&irq_controller_lock, flags);
-	mask = 0xff << shift;
-	bit = gic_cpu_map[cpu] << shift;
-	val = readl_relaxed(reg) & ~mask;
-	writel_relaxed(val | bit, reg);
-	raw_spin_unlock_irqrestore(&irq_controller_lock, flags);
+	gic_route_spi(gic_dist_base(d), gic_irq(d), cpu);
 
 	return IRQ_SET_MASK_OK;
 }
+
+/*
+ * SPI balancing. A SPI is delivered to a single CPU, the first one of its
+ * affinity mask unless told otherwise, so with the default mask of all
+ * CPUs every device interrupt ends up on CPU0. When balance_interval is
+ * set (in ms), the SPIs of the primary GIC whose mask allows more than
+ * one online CPU are periodically moved to the CPU with the least
+ * interrupt load, as counted over the last interval. An affinity hint,
+ * as set by multiqueue drivers for the CPU consuming a queue, narrows the
+ * choice further. SPIs affine to a single CPU are left alone, but their
+ * load is accounted to that CPU.
+ */
+static unsigned int gic_balance_interval;
+static bool gic_balance_ready;
+static unsigned int *gic_balance_last;
+static struct gic_balance_irq {
+	unsigned int irq;
+	unsigned int hwirq;
+	unsigned int load;
+} *gic_balance_irqs;
+
+static void gic_balance_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(gic_balance_work, gic_balance_work_fn);
+
+static int gic_balance_cmp(const void *a, const void *b)
+{
+	const struct gic_balance_irq *x = a, *y = b;
+
+	if (x->load != y->load)
+		return x->load < y->load ? 1 : -1;
+	return 0;
+}
+
+static unsigned int gic_spi_target(void __iomem *dist_base, unsigned int hwirq)
+{
+	u32 bits = readl_relaxed(dist_base + GIC_DIST_TARGET + (hwirq & ~3));
+	unsigned int cpu;
+
+	bits = (bits >> ((hwirq % 4) * 8)) & 0xff;
+	for_each_online_cpu(cpu)
+		if (cpu < NR_GIC_CPU_IF && (gic_cpu_map[cpu] & bits))
+			return cpu;
+
+	return nr_cpu_ids;
+}
+
+static bool gic_balance_mask(struct irq_desc *desc, struct cpumask *mask)
+{
+	struct irq_data *d = irq_desc_get_irq_data(desc);
+
+	/* per-CPU and IRQF_NOBALANCING interrupts stay where they are */
+	if (!irqd_can_balance(d))
+		return false;
+
+	cpumask_and(mask, irq_data_get_affinity_mask(d), cpu_online_mask);
+	if (desc->affinity_hint &&
+	    cpumask_intersects(mask, desc->affinity_hint))
+		cpumask_and(mask, mask, desc->affinity_hint);
+
+	return cpumask_weight(mask) > 1 ||
+	       (desc->affinity_hint && !cpumask_empty(mask));
+}
+
+static void gic_balance_work_fn(struct work_struct *work)
+{
+	struct gic_chip_data *gic = &gic_data[0];
+	void __iomem *dist_base = gic_data_dist_base(gic);
+	unsigned int load[NR_GIC_CPU_IF] = { 0 };
+	unsigned int i, n = 0, cpu;
+	cpumask_var_t mask;
+
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+		goto out;
+
+	get_online_cpus();
+
+	/* Measure, counting the load of the SPIs we won't move */
+	for (i = 32; i < gic->gic_irqs; i++) {
+		unsigned int irq = irq_find_mapping(gic->domain, i);
+		struct irq_desc *desc = irq ? irq_to_desc(irq) : NULL;
+		unsigned int count, delta;
+
+		if (!desc || !desc->action)
+			continue;
+
+		count = kstat_irqs_usr(irq);
+		delta = count - gic_balance_last[i];
+		gic_balance_last[i] = count;
+
+		raw_spin_lock_irq(&desc->lock);
+		if (gic_balance_mask(desc, mask)) {
+			gic_balance_irqs[n].irq = irq;
+			gic_balance_irqs[n].hwirq = i;
+			gic_balance_irqs[n].load = delta;
+			n++;
+		} else {
+			cpu = gic_spi_target(dist_base, i);
+			if (cpu < NR_GIC_CPU_IF)
+				load[cpu] += delta;
+		}
+		raw_spin_unlock_irq(&desc->lock);
+	}
+
+	/* Place the busiest first, each on the least loaded CPU it may use */
+	sort(gic_balance_irqs, n, sizeof(*gic_balance_irqs),
+	     gic_balance_cmp, NULL);
+
+	for (i = 0; i < n; i++) {
+		struct gic_balance_irq *b = &gic_balance_irqs[i];
+		struct irq_desc *desc = irq_to_desc(b->irq);
+		unsigned int cur, best;
+
+		raw_spin_lock_irq(&desc->lock);
+
+		/* the mask may have changed since we looked */
+		if (!desc->action || !gic_balance_mask(desc, mask))
+			goto next;
+
+		best = nr_cpu_ids;
+		for_each_cpu(cpu, mask)
+			if (cpu < NR_GIC_CPU_IF &&
+			    (best == nr_cpu_ids || load[cpu] < load[best]))
+				best = cpu;
+		if (best == nr_cpu_ids)
+			goto next;
+
+		/* only move if it beats staying put, to avoid ping-pong */
+		cur = gic_spi_target(dist_base, b->hwirq);
+		if (cur < NR_GIC_CPU_IF && cpumask_test_cpu(cur, mask) &&
+		    load[cur] <= load[best] + b->load)
+			best = cur;
+
+		if (best != cur)
+			gic_route_spi(dist_base, b->hwirq, best);
+		load[best] += b->load;
+next:
+		raw_spin_unlock_irq(&desc->lock);
+	}
+
+	put_online_cpus();
+	free_cpumask_var(mask);
+out:
+	if (gic_balance_interval)
+		schedule_delayed_work(&gic_balance_work,
+				msecs_to_jiffies(gic_balance_interval));
+}
+
+static int gic_balance_set_interval(const char *val,
+				    const struct kernel_param *kp)
+{
+	int ret = param_set_uint(val, kp);
+
+	if (!ret && gic_balance_ready && gic_balance_interval)
+		mod_delayed_work(system_wq, &gic_balance_work, 0);
+
+	return ret;
+}
+
+static const struct kernel_param_ops gic_balance_interval_ops = {
+	.set = gic_balance_set_interval,
+	.get = param_get_uint,
+};
+module_param_cb(balance_interval, &gic_balance_interval_ops,
+		&gic_balance_interval, 0644);
+MODULE_PARM_DESC(balance_interval,
+		 "Rebalance SPIs across CPUs every this many ms (0 = off)");
+
+static int __init gic_balance_init(void)
+{
+	struct gic_chip_data *gic = &gic_data[0];
+
+	if (!gic->domain || num_possible_cpus() < 2)
+		return 0;
+
+	gic_balance_last = kcalloc(gic->gic_irqs, sizeof(*gic_balance_last),
+				   GFP_KERNEL);
+	gic_balance_irqs = kcalloc(gic->gic_irqs, sizeof(*gic_balance_irqs),
+				   GFP_KERNEL);
+	if (!gic_balance_last || !gic_balance_irqs) {
+		kfree(gic_balance_last);
+		kfree(gic_balance_irqs);
+		return -ENOMEM;
+	}
+
+	gic_balance_ready = true;
+	if (gic_balance_interval)
+		schedule_delayed_work(&gic_balance_work,
+				msecs_to_jiffies(gic_balance_interval));
+
+	return 0;
+}
+late_initcall(gic_balance_init);
 #endif
 
 static void __exception_irq_entry gic_handle_irq(struct pt_regs *regs)
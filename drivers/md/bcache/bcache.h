@@ -325,10 +325,14 @@ struct cached_dev {
 	struct delayed_work	writeback_rate_update;
 
 	/*
-	 * Internal to the writeback code, so read_dirty() can keep track of
-	 * where it's at.
+	 * Internal to the writeback code: writes to the backing device are
+	 * issued in the order read_dirty() numbered them, see write_dirty().
 	 */
-	sector_t		last_read;
+	atomic_t		writeback_sequence_next;
+	struct closure_waitlist	writeback_ordering_wait;
+
+	/* jiffies of the last request from above, to spot idle periods */
+	unsigned long		last_request;
 
 	/* Limit number of writeback bios in flight */
 	struct semaphore	in_flight;
@@ -358,6 +362,7 @@ struct cached_dev {
 	unsigned		writeback_running:1;
 	unsigned char		writeback_percent;
 	unsigned		writeback_delay;
+	unsigned		writeback_idle_seconds;
 
 	uint64_t		writeback_rate_target;
 	int64_t			writeback_rate_proportional;
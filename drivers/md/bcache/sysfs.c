@@ -77,6 +77,7 @@ rw_attribute(writeback_metadata);
 rw_attribute(writeback_running);
 rw_attribute(writeback_percent);
 rw_attribute(writeback_delay);
+rw_attribute(writeback_idle_seconds);
 rw_attribute(writeback_rate);
 
 rw_attribute(writeback_rate_update_seconds);
@@ -125,6 +126,7 @@ SHOW(__bch_cached_dev)
 	var_printf(writeback_metadata,	"%i");
 	var_printf(writeback_running,	"%i");
 	var_print(writeback_delay);
+	var_print(writeback_idle_seconds);
 	var_print(writeback_percent);
 	sysfs_hprint(writeback_rate,	dc->writeback_rate.rate << 9);
 
@@ -205,6 +207,7 @@ STORE(__cached_dev)
 	d_strtoul(writeback_metadata);
 	d_strtoul(writeback_running);
 	d_strtoul(writeback_delay);
+	d_strtoul(writeback_idle_seconds);
 
 	sysfs_strtoul_clamp(writeback_percent, dc->writeback_percent, 0, 40);
 
@@ -315,6 +318,7 @@ static struct attribute *bch_cached_dev_files[] = {
 	&sysfs_writeback_metadata,
 	&sysfs_writeback_running,
 	&sysfs_writeback_delay,
+	&sysfs_writeback_idle_seconds,
 	&sysfs_writeback_percent,
 	&sysfs_writeback_rate,
 	&sysfs_writeback_rate_update_seconds,
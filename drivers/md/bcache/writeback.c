@@ -93,12 +93,23 @@ static unsigned writeback_delay(struct cached_dev *dc, unsigned sectors)
 	    !dc->writeback_percent)
 		return 0;
 
+	/* Nobody is using the device, write back as fast as it takes it */
+	if (dc->writeback_idle_seconds &&
+	    time_after(jiffies, READ_ONCE(dc->last_request) +
+		       dc->writeback_idle_seconds * HZ))
+		return 0;
+
 	return bch_next_delay(&dc->writeback_rate, sectors);
 }
 
+/* Limits on the keys read_dirty() gathers for back to back writes */
+#define MAX_WRITEBACKS_IN_PASS	5
+#define MAX_WRITESIZE_IN_PASS	5000	/* sectors */
+
 struct dirty_io {
 	struct closure		cl;
 	struct cached_dev	*dc;
+	uint16_t		sequence;
 	struct bio		bio;
 };
 
@@ -181,14 +192,37 @@ static void write_dirty(struct closure *cl)
 {
 	struct dirty_io *io = container_of(cl, struct dirty_io, cl);
 	struct keybuf_key *w = io->bio.bi_private;
+	struct cached_dev *dc = io->dc;
 
-	dirty_init(w);
-	io->bio.bi_rw		= WRITE;
-	io->bio.bi_iter.bi_sector = KEY_START(&w->key);
-	io->bio.bi_bdev		= io->dc->bdev;
-	io->bio.bi_end_io	= dirty_endio;
+	/*
+	 * Reads from the cache complete in any order, but the backing device
+	 * should see the writes in the order of their offsets, which is the
+	 * order read_dirty() numbered them in.
+	 */
+	if (atomic_read(&dc->writeback_sequence_next) != io->sequence) {
+		closure_wait(&dc->writeback_ordering_wait, cl);
 
-	closure_bio_submit(&io->bio, cl);
+		/* our turn may have come before we were on the list */
+		if (atomic_read(&dc->writeback_sequence_next) == io->sequence)
+			closure_wake_up(&dc->writeback_ordering_wait);
+
+		continue_at(cl, write_dirty, system_wq);
+		return;
+	}
+
+	/* Nothing to write if the read failed, see dirty_endio() */
+	if (KEY_DIRTY(&w->key)) {
+		dirty_init(w);
+		io->bio.bi_rw		= WRITE;
+		io->bio.bi_iter.bi_sector = KEY_START(&w->key);
+		io->bio.bi_bdev		= dc->bdev;
+		io->bio.bi_end_io	= dirty_endio;
+
+		closure_bio_submit(&io->bio, cl);
+	}
+
+	atomic_set(&dc->writeback_sequence_next, (uint16_t) (io->sequence + 1));
+	closure_wake_up(&dc->writeback_ordering_wait);
 
 	continue_at(cl, write_dirty_finish, system_wq);
 }
@@ -216,67 +250,100 @@ static void read_dirty_submit(struct closure *cl)
 static void read_dirty(struct cached_dev *dc)
 {
 	unsigned delay = 0;
-	struct keybuf_key *w;
+	struct keybuf_key *next, *w, *keys[MAX_WRITEBACKS_IN_PASS];
 	struct dirty_io *io;
 	struct closure cl;
+	uint16_t sequence = 0;
+	size_t size;
+	int nk, i = 0;
 
 	closure_init_stack(&cl);
+	atomic_set(&dc->writeback_sequence_next, sequence);
 
 	/*
 	 * XXX: if we error, background writeback just spins. Should use some
 	 * mempools.
 	 */
 
-	while (!kthread_should_stop()) {
+	next = bch_keybuf_next(&dc->writeback_keys);
+
+	while (!kthread_should_stop() && next) {
 		try_to_freeze();
 
-		w = bch_keybuf_next(&dc->writeback_keys);
-		if (!w)
-			break;
+		/*
+		 * Gather a few keys that are contiguous on the backing device,
+		 * the keybuf hands them out in order, so that they are
+		 * written back to back.
+		 */
+		size = 0;
+		nk = 0;
 
-		BUG_ON(ptr_stale(dc->disk.c, &w->key, 0));
+		do {
+			BUG_ON(ptr_stale(dc->disk.c, &next->key, 0));
 
-		if (KEY_START(&w->key) != dc->last_read ||
-		    jiffies_to_msecs(delay) > 50)
-			while (!kthread_should_stop() && delay)
-				delay = schedule_timeout_interruptible(delay);
+			if (nk >= MAX_WRITEBACKS_IN_PASS ||
+			    size >= MAX_WRITESIZE_IN_PASS)
+				break;
 
-		dc->last_read	= KEY_OFFSET(&w->key);
+			if (nk && bkey_cmp(&keys[nk - 1]->key,
+					   &START_KEY(&next->key)))
+				break;
 
-		io = kzalloc(sizeof(struct dirty_io) + sizeof(struct bio_vec)
-			     * DIV_ROUND_UP(KEY_SIZE(&w->key), PAGE_SECTORS),
-			     GFP_KERNEL);
-		if (!io)
-			goto err;
+			size += KEY_SIZE(&next->key);
+			keys[nk++] = next;
+		} while ((next = bch_keybuf_next(&dc->writeback_keys)));
 
-		w->private	= io;
-		io->dc		= dc;
+		for (i = 0; i < nk; i++) {
+			w = keys[i];
 
-		dirty_init(w);
-		io->bio.bi_iter.bi_sector = PTR_OFFSET(&w->key, 0);
-		io->bio.bi_bdev		= PTR_CACHE(dc->disk.c,
-						    &w->key, 0)->bdev;
-		io->bio.bi_rw		= READ;
-		io->bio.bi_end_io	= read_dirty_endio;
+			io = kzalloc(sizeof(struct dirty_io) +
+				     sizeof(struct bio_vec) *
+				     DIV_ROUND_UP(KEY_SIZE(&w->key),
+						  PAGE_SECTORS),
+				     GFP_KERNEL);
+			if (!io)
+				goto err;
 
-		if (bio_alloc_pages(&io->bio, GFP_KERNEL))
-			goto err_free;
+			w->private	= io;
+			io->dc		= dc;
 
-		trace_bcache_writeback(&w->key);
+			dirty_init(w);
+			io->bio.bi_iter.bi_sector = PTR_OFFSET(&w->key, 0);
+			io->bio.bi_bdev		= PTR_CACHE(dc->disk.c,
+							    &w->key, 0)->bdev;
+			io->bio.bi_rw		= READ;
+			io->bio.bi_end_io	= read_dirty_endio;
 
-		down(&dc->in_flight);
-		closure_call(&io->cl, read_dirty_submit, NULL, &cl);
+			if (bio_alloc_pages(&io->bio, GFP_KERNEL))
+				goto err_free;
 
-		delay = writeback_delay(dc, KEY_SIZE(&w->key));
+			io->sequence	= sequence++;
+
+			trace_bcache_writeback(&w->key);
+
+			down(&dc->in_flight);
+			closure_call(&io->cl, read_dirty_submit, NULL, &cl);
+		}
+
+		delay = writeback_delay(dc, size);
+		while (!kthread_should_stop() && delay) {
+			schedule_timeout_interruptible(delay);
+			delay = writeback_delay(dc, 0);
+		}
 	}
 
 	if (0) {
 err_free:
 		kfree(w->private);
 err:
-		bch_keybuf_del(&dc->writeback_keys, w);
+		for (; i < nk; i++)
+			bch_keybuf_del(&dc->writeback_keys, keys[i]);
 	}
 
+	/* taken from the keybuf but not issued */
+	if (next)
+		bch_keybuf_del(&dc->writeback_keys, next);
+
 	/*
 	 * Wait for outstanding writeback IOs to finish (and keybuf slots to be
 	 * freed) before refilling again
@@ -488,6 +555,7 @@ void bch_cached_dev_writeback_init(struct cached_dev *dc)
 	dc->writeback_running		= true;
 	dc->writeback_percent		= 10;
 	dc->writeback_delay		= 30;
+	dc->last_request		= jiffies;
 	dc->writeback_rate.rate		= 1024;
 
 	dc->writeback_rate_update_seconds = 5;
@@ -0,0 +1,862 @@
+/*
+ * Rockchip VPU codec driver
+ *
+ * A v4l2 mem2mem device for the video codec block of the RK3288. Only
+ * its JPEG encoder is exposed so far. Buffers on both queues can be
+ * imported from and exported as dma-bufs, so that frames from the camera
+ * or the display pipeline are encoded without being copied. The block
+ * sits behind its own IOMMU, and all buffers are mapped through it.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <asm/dma-iommu.h>
+#include <linux/dma-mapping.h>
+#include <linux/interrupt.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/pm_runtime.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <media/v4l2-event.h>
+#include <media/v4l2-ioctl.h>
+#include <media/videobuf2-dma-contig.h>
+
+#include "rockchip_vpu.h"
+#include "rockchip_vpu_regs.h"
+
+static const struct rockchip_vpu_fmt rockchip_vpu_formats[] = {
+	{
+		.fourcc = V4L2_PIX_FMT_YUV420M,
+		.types = VPU_FMT_OUTPUT,
+		.num_planes = 3,
+		.bpp = { 8, 2, 2 },
+		.enc_fmt = VEPU_ENC_FMT_YUV420P,
+	}, {
+		.fourcc = V4L2_PIX_FMT_NV12M,
+		.types = VPU_FMT_OUTPUT,
+		.num_planes = 2,
+		.bpp = { 8, 4 },
+		.enc_fmt = VEPU_ENC_FMT_YUV420SP,
+	}, {
+		.fourcc = V4L2_PIX_FMT_YUYV,
+		.types = VPU_FMT_OUTPUT,
+		.num_planes = 1,
+		.bpp = { 16 },
+		.enc_fmt = VEPU_ENC_FMT_YUYV422,
+	}, {
+		.fourcc = V4L2_PIX_FMT_UYVY,
+		.types = VPU_FMT_OUTPUT,
+		.num_planes = 1,
+		.bpp = { 16 },
+		.enc_fmt = VEPU_ENC_FMT_UYVY422,
+	}, {
+		.fourcc = V4L2_PIX_FMT_JPEG,
+		.types = VPU_FMT_CAPTURE,
+		.num_planes = 1,
+	},
+};
+
+static const struct rockchip_vpu_fmt *
+rockchip_vpu_find_format(u32 fourcc, unsigned int type)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(rockchip_vpu_formats); i++)
+		if (rockchip_vpu_formats[i].fourcc == fourcc &&
+		    rockchip_vpu_formats[i].types & type)
+			return &rockchip_vpu_formats[i];
+
+	return NULL;
+}
+
+/*
+ * ============================================================================
+ * Job handling
+ * ============================================================================
+ */
+
+/* Called with vpu->irqlock held */
+static void rockchip_vpu_job_done(struct rockchip_vpu_dev *vpu,
+				  enum vb2_buffer_state state)
+{
+	struct rockchip_vpu_ctx *ctx = vpu->curr;
+	struct vb2_buffer *src_buf, *dst_buf;
+
+	vpu->curr = NULL;
+
+	src_buf = v4l2_m2m_src_buf_remove(ctx->fh.m2m_ctx);
+	dst_buf = v4l2_m2m_dst_buf_remove(ctx->fh.m2m_ctx);
+
+	if (state == VB2_BUF_STATE_DONE)
+		rockchip_vpu_jpeg_enc_done(ctx, dst_buf);
+
+	src_buf->v4l2_buf.sequence = ctx->sequence_out++;
+	dst_buf->v4l2_buf.sequence = ctx->sequence_cap++;
+	dst_buf->v4l2_buf.timestamp = src_buf->v4l2_buf.timestamp;
+	dst_buf->v4l2_buf.timecode = src_buf->v4l2_buf.timecode;
+	dst_buf->v4l2_buf.field = V4L2_FIELD_NONE;
+	dst_buf->v4l2_buf.flags &= ~(V4L2_BUF_FLAG_TSTAMP_SRC_MASK |
+				     V4L2_BUF_FLAG_TIMECODE);
+	dst_buf->v4l2_buf.flags |= V4L2_BUF_FLAG_KEYFRAME |
+				   (src_buf->v4l2_buf.flags &
+				    (V4L2_BUF_FLAG_TSTAMP_SRC_MASK |
+				     V4L2_BUF_FLAG_TIMECODE));
+
+	v4l2_m2m_buf_done(src_buf, state);
+	v4l2_m2m_buf_done(dst_buf, state);
+}
+
+static void rockchip_vpu_finish(struct rockchip_vpu_dev *vpu,
+				struct rockchip_vpu_ctx *ctx)
+{
+	pm_runtime_mark_last_busy(vpu->dev);
+	pm_runtime_put_autosuspend(vpu->dev);
+	v4l2_m2m_job_finish(vpu->m2m_dev, ctx->fh.m2m_ctx);
+}
+
+static irqreturn_t rockchip_vpu_enc_irq(int irq, void *dev_id)
+{
+	struct rockchip_vpu_dev *vpu = dev_id;
+	struct rockchip_vpu_ctx *ctx;
+	enum vb2_buffer_state state;
+	u32 status;
+
+	status = vepu_read(vpu, VEPU_REG_INTERRUPT);
+	if (!(status & VEPU_REG_INTERRUPT_BIT))
+		return IRQ_NONE;
+
+	vepu_write(vpu, 0, VEPU_REG_INTERRUPT);
+	vepu_write(vpu, 0, VEPU_REG_AXI_CTRL);
+
+	state = status & VEPU_REG_INTERRUPT_FRAME_RDY ?
+		VB2_BUF_STATE_DONE : VB2_BUF_STATE_ERROR;
+
+	spin_lock(&vpu->irqlock);
+	ctx = vpu->curr;
+	if (ctx && cancel_delayed_work(&vpu->watchdog))
+		rockchip_vpu_job_done(vpu, state);
+	else
+		ctx = NULL;
+	spin_unlock(&vpu->irqlock);
+
+	if (ctx)
+		rockchip_vpu_finish(vpu, ctx);
+
+	return IRQ_HANDLED;
+}
+
+static void rockchip_vpu_watchdog(struct work_struct *work)
+{
+	struct rockchip_vpu_dev *vpu =
+		container_of(to_delayed_work(work), struct rockchip_vpu_dev,
+			     watchdog);
+	struct rockchip_vpu_ctx *ctx;
+	unsigned long flags;
+
+	spin_lock_irqsave(&vpu->irqlock, flags);
+	ctx = vpu->curr;
+	if (ctx) {
+		dev_warn(vpu->dev, "frame processing timed out\n");
+		/* stop the encoder before its buffers go back */
+		vepu_write(vpu, 0, VEPU_REG_ENC_CTRL);
+		vepu_write(vpu, 0, VEPU_REG_INTERRUPT);
+		vepu_write(vpu, 0, VEPU_REG_AXI_CTRL);
+		rockchip_vpu_job_done(vpu, VB2_BUF_STATE_ERROR);
+	}
+	spin_unlock_irqrestore(&vpu->irqlock, flags);
+
+	if (ctx)
+		rockchip_vpu_finish(vpu, ctx);
+}
+
+static void rockchip_vpu_device_run(void *priv)
+{
+	struct rockchip_vpu_ctx *ctx = priv;
+	struct rockchip_vpu_dev *vpu = ctx->vpu;
+	struct vb2_buffer *src_buf, *dst_buf;
+	unsigned long flags;
+	int ret;
+
+	ret = pm_runtime_get_sync(vpu->dev);
+
+	spin_lock_irqsave(&vpu->irqlock, flags);
+	vpu->curr = ctx;
+	if (ret >= 0) {
+		src_buf = v4l2_m2m_next_src_buf(ctx->fh.m2m_ctx);
+		dst_buf = v4l2_m2m_next_dst_buf(ctx->fh.m2m_ctx);
+		ret = rockchip_vpu_jpeg_enc_run(ctx, src_buf, dst_buf);
+	}
+	if (ret < 0) {
+		rockchip_vpu_job_done(vpu, VB2_BUF_STATE_ERROR);
+		spin_unlock_irqrestore(&vpu->irqlock, flags);
+		rockchip_vpu_finish(vpu, ctx);
+		return;
+	}
+	schedule_delayed_work(&vpu->watchdog,
+			      msecs_to_jiffies(VPU_JOB_TIMEOUT));
+	spin_unlock_irqrestore(&vpu->irqlock, flags);
+}
+
+static void rockchip_vpu_job_abort(void *priv)
+{
+	/*
+	 * A frame cannot be stopped half way through. The running job ends
+	 * with its interrupt or, at the latest, with the watchdog, and
+	 * v4l2_m2m_job_finish() is called on either path.
+	 */
+}
+
+static struct v4l2_m2m_ops rockchip_vpu_m2m_ops = {
+	.device_run	= rockchip_vpu_device_run,
+	.job_abort	= rockchip_vpu_job_abort,
+};
+
+/*
+ * ============================================================================
+ * V4L2 ioctls
+ * ============================================================================
+ */
+static int rockchip_vpu_querycap(struct file *file, void *priv,
+				 struct v4l2_capability *cap)
+{
+	struct rockchip_vpu_ctx *ctx = fh_to_ctx(priv);
+
+	strlcpy(cap->driver, DRV_NAME, sizeof(cap->driver));
+	strlcpy(cap->card, DRV_NAME " encoder", sizeof(cap->card));
+	snprintf(cap->bus_info, sizeof(cap->bus_info), "platform:%s",
+		 dev_name(ctx->vpu->dev));
+	cap->device_caps = V4L2_CAP_STREAMING | V4L2_CAP_VIDEO_M2M_MPLANE;
+	cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+
+	return 0;
+}
+
+static int rockchip_vpu_enum_fmt(struct v4l2_fmtdesc *f, unsigned int type)
+{
+	unsigned int i, num = 0;
+
+	for (i = 0; i < ARRAY_SIZE(rockchip_vpu_formats); i++) {
+		if (!(rockchip_vpu_formats[i].types & type))
+			continue;
+		if (num++ == f->index) {
+			f->pixelformat = rockchip_vpu_formats[i].fourcc;
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+static int rockchip_vpu_enum_fmt_cap(struct file *file, void *priv,
+				     struct v4l2_fmtdesc *f)
+{
+	return rockchip_vpu_enum_fmt(f, VPU_FMT_CAPTURE);
+}
+
+static int rockchip_vpu_enum_fmt_out(struct file *file, void *priv,
+				     struct v4l2_fmtdesc *f)
+{
+	return rockchip_vpu_enum_fmt(f, VPU_FMT_OUTPUT);
+}
+
+static int rockchip_vpu_enum_framesizes(struct file *file, void *priv,
+					struct v4l2_frmsizeenum *fsize)
+{
+	if (fsize->index != 0 ||
+	    (!rockchip_vpu_find_format(fsize->pixel_format, VPU_FMT_OUTPUT) &&
+	     !rockchip_vpu_find_format(fsize->pixel_format, VPU_FMT_CAPTURE)))
+		return -EINVAL;
+
+	fsize->type = V4L2_FRMSIZE_TYPE_STEPWISE;
+	fsize->stepwise.min_width = VPU_ENC_WIDTH_MIN;
+	fsize->stepwise.max_width = VPU_ENC_WIDTH_MAX;
+	fsize->stepwise.step_width = VPU_MB_DIM;
+	fsize->stepwise.min_height = VPU_ENC_HEIGHT_MIN;
+	fsize->stepwise.max_height = VPU_ENC_HEIGHT_MAX;
+	fsize->stepwise.step_height = VPU_MB_DIM;
+
+	return 0;
+}
+
+static void rockchip_vpu_fill_fmt(struct v4l2_pix_format_mplane *pix,
+				  const struct rockchip_vpu_fmt *fmt)
+{
+	unsigned int i;
+
+	pix->pixelformat = fmt->fourcc;
+	pix->field = V4L2_FIELD_NONE;
+	pix->num_planes = fmt->num_planes;
+	pix->colorspace = fmt->fourcc == V4L2_PIX_FMT_JPEG ?
+			  V4L2_COLORSPACE_JPEG : V4L2_COLORSPACE_REC709;
+	pix->flags = 0;
+	memset(pix->reserved, 0, sizeof(pix->reserved));
+
+	v4l_bound_align_image(&pix->width, VPU_ENC_WIDTH_MIN,
+			      VPU_ENC_WIDTH_MAX, 4, &pix->height,
+			      VPU_ENC_HEIGHT_MIN, VPU_ENC_HEIGHT_MAX, 4, 0);
+
+	if (fmt->fourcc == V4L2_PIX_FMT_JPEG) {
+		/* headers, plus a generous bound on the coded data */
+		pix->plane_fmt[0].bytesperline = 0;
+		pix->plane_fmt[0].sizeimage = VPU_JPEG_HDR_SIZE +
+					      pix->width * pix->height * 2;
+		memset(pix->plane_fmt[0].reserved, 0,
+		       sizeof(pix->plane_fmt[0].reserved));
+		return;
+	}
+
+	/*
+	 * The hardware takes no stride, only the width. All the multi-planar
+	 * formats are 4:2:0, so the chroma planes have half as many lines.
+	 */
+	for (i = 0; i < fmt->num_planes; i++) {
+		struct v4l2_plane_pix_format *plane = &pix->plane_fmt[i];
+
+		plane->bytesperline = pix->width * fmt->bpp[i] / (i ? 4 : 8);
+		plane->sizeimage = pix->width * pix->height * fmt->bpp[i] / 8;
+		memset(plane->reserved, 0, sizeof(plane->reserved));
+	}
+}
+
+static int rockchip_vpu_try_fmt(struct file *file, void *priv,
+				struct v4l2_format *f)
+{
+	struct v4l2_pix_format_mplane *pix = &f->fmt.pix_mp;
+	unsigned int type = V4L2_TYPE_IS_OUTPUT(f->type) ? VPU_FMT_OUTPUT :
+							   VPU_FMT_CAPTURE;
+	const struct rockchip_vpu_fmt *fmt;
+
+	fmt = rockchip_vpu_find_format(pix->pixelformat, type);
+	if (!fmt)
+		fmt = type == VPU_FMT_OUTPUT ? &rockchip_vpu_formats[0] :
+		      rockchip_vpu_find_format(V4L2_PIX_FMT_JPEG, type);
+
+	rockchip_vpu_fill_fmt(pix, fmt);
+
+	return 0;
+}
+
+static int rockchip_vpu_g_fmt(struct file *file, void *priv,
+			      struct v4l2_format *f)
+{
+	struct rockchip_vpu_ctx *ctx = fh_to_ctx(priv);
+
+	f->fmt.pix_mp = V4L2_TYPE_IS_OUTPUT(f->type) ? ctx->src_fmt :
+						       ctx->dst_fmt;
+
+	return 0;
+}
+
+static int rockchip_vpu_s_fmt(struct file *file, void *priv,
+			      struct v4l2_format *f)
+{
+	struct rockchip_vpu_ctx *ctx = fh_to_ctx(priv);
+	struct v4l2_pix_format_mplane *pix = &f->fmt.pix_mp;
+	struct vb2_queue *vq;
+
+	vq = v4l2_m2m_get_vq(ctx->fh.m2m_ctx, f->type);
+	if (vb2_is_busy(vq))
+		return -EBUSY;
+
+	rockchip_vpu_try_fmt(file, priv, f);
+
+	if (V4L2_TYPE_IS_OUTPUT(f->type)) {
+		ctx->src_fmt = *pix;
+		ctx->src_fmtinfo = rockchip_vpu_find_format(pix->pixelformat,
+							    VPU_FMT_OUTPUT);
+		/* the coded size follows the raw one */
+		ctx->dst_fmt.width = pix->width;
+		ctx->dst_fmt.height = pix->height;
+		rockchip_vpu_fill_fmt(&ctx->dst_fmt,
+			rockchip_vpu_find_format(V4L2_PIX_FMT_JPEG,
+						 VPU_FMT_CAPTURE));
+	} else {
+		/* the size comes from the output queue */
+		pix->width = ctx->src_fmt.width;
+		pix->height = ctx->src_fmt.height;
+		rockchip_vpu_try_fmt(file, priv, f);
+		ctx->dst_fmt = *pix;
+	}
+
+	return 0;
+}
+
+static const struct v4l2_ioctl_ops rockchip_vpu_ioctl_ops = {
+	.vidioc_querycap		= rockchip_vpu_querycap,
+	.vidioc_enum_framesizes		= rockchip_vpu_enum_framesizes,
+
+	.vidioc_enum_fmt_vid_cap_mplane	= rockchip_vpu_enum_fmt_cap,
+	.vidioc_enum_fmt_vid_out_mplane	= rockchip_vpu_enum_fmt_out,
+	.vidioc_g_fmt_vid_cap_mplane	= rockchip_vpu_g_fmt,
+	.vidioc_g_fmt_vid_out_mplane	= rockchip_vpu_g_fmt,
+	.vidioc_try_fmt_vid_cap_mplane	= rockchip_vpu_try_fmt,
+	.vidioc_try_fmt_vid_out_mplane	= rockchip_vpu_try_fmt,
+	.vidioc_s_fmt_vid_cap_mplane	= rockchip_vpu_s_fmt,
+	.vidioc_s_fmt_vid_out_mplane	= rockchip_vpu_s_fmt,
+
+	.vidioc_reqbufs			= v4l2_m2m_ioctl_reqbufs,
+	.vidioc_create_bufs		= v4l2_m2m_ioctl_create_bufs,
+	.vidioc_querybuf		= v4l2_m2m_ioctl_querybuf,
+	.vidioc_qbuf			= v4l2_m2m_ioctl_qbuf,
+	.vidioc_dqbuf			= v4l2_m2m_ioctl_dqbuf,
+	.vidioc_prepare_buf		= v4l2_m2m_ioctl_prepare_buf,
+	.vidioc_expbuf			= v4l2_m2m_ioctl_expbuf,
+
+	.vidioc_streamon		= v4l2_m2m_ioctl_streamon,
+	.vidioc_streamoff		= v4l2_m2m_ioctl_streamoff,
+
+	.vidioc_subscribe_event		= v4l2_ctrl_subscribe_event,
+	.vidioc_unsubscribe_event	= v4l2_event_unsubscribe,
+};
+
+static int rockchip_vpu_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct rockchip_vpu_ctx *ctx = container_of(ctrl->handler,
+						    struct rockchip_vpu_ctx,
+						    ctrl_handler);
+
+	switch (ctrl->id) {
+	case V4L2_CID_JPEG_COMPRESSION_QUALITY:
+		ctx->jpeg_quality = ctrl->val;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+static const struct v4l2_ctrl_ops rockchip_vpu_ctrl_ops = {
+	.s_ctrl = rockchip_vpu_s_ctrl,
+};
+
+/*
+ * ============================================================================
+ * Queue operations
+ * ============================================================================
+ */
+static int rockchip_vpu_queue_setup(struct vb2_queue *vq,
+				    const struct v4l2_format *fmt,
+				    unsigned int *nbuffers,
+				    unsigned int *nplanes,
+				    unsigned int sizes[], void *alloc_ctxs[])
+{
+	struct rockchip_vpu_ctx *ctx = vb2_get_drv_priv(vq);
+	const struct v4l2_pix_format_mplane *pix;
+	unsigned int i;
+
+	pix = V4L2_TYPE_IS_OUTPUT(vq->type) ? &ctx->src_fmt : &ctx->dst_fmt;
+
+	*nplanes = pix->num_planes;
+	for (i = 0; i < pix->num_planes; i++) {
+		sizes[i] = pix->plane_fmt[i].sizeimage;
+		if (fmt && fmt->fmt.pix_mp.plane_fmt[i].sizeimage < sizes[i])
+			return -EINVAL;
+		if (fmt)
+			sizes[i] = fmt->fmt.pix_mp.plane_fmt[i].sizeimage;
+		alloc_ctxs[i] = ctx->vpu->alloc_ctx;
+	}
+
+	return 0;
+}
+
+static int rockchip_vpu_buf_prepare(struct vb2_buffer *vb)
+{
+	struct rockchip_vpu_ctx *ctx = vb2_get_drv_priv(vb->vb2_queue);
+	const struct v4l2_pix_format_mplane *pix;
+	unsigned int i;
+
+	pix = V4L2_TYPE_IS_OUTPUT(vb->vb2_queue->type) ? &ctx->src_fmt :
+							 &ctx->dst_fmt;
+
+	for (i = 0; i < pix->num_planes; i++) {
+		if (vb2_plane_size(vb, i) < pix->plane_fmt[i].sizeimage)
+			return -EINVAL;
+		if (V4L2_TYPE_IS_OUTPUT(vb->vb2_queue->type))
+			vb2_set_plane_payload(vb, i,
+					      pix->plane_fmt[i].sizeimage);
+	}
+
+	return 0;
+}
+
+static void rockchip_vpu_buf_queue(struct vb2_buffer *vb)
+{
+	struct rockchip_vpu_ctx *ctx = vb2_get_drv_priv(vb->vb2_queue);
+
+	v4l2_m2m_buf_queue(ctx->fh.m2m_ctx, vb);
+}
+
+static int rockchip_vpu_start_streaming(struct vb2_queue *q,
+					unsigned int count)
+{
+	struct rockchip_vpu_ctx *ctx = vb2_get_drv_priv(q);
+
+	if (V4L2_TYPE_IS_OUTPUT(q->type))
+		ctx->sequence_out = 0;
+	else
+		ctx->sequence_cap = 0;
+
+	return 0;
+}
+
+static void rockchip_vpu_stop_streaming(struct vb2_queue *q)
+{
+	struct rockchip_vpu_ctx *ctx = vb2_get_drv_priv(q);
+	struct vb2_buffer *vb;
+
+	for (;;) {
+		if (V4L2_TYPE_IS_OUTPUT(q->type))
+			vb = v4l2_m2m_src_buf_remove(ctx->fh.m2m_ctx);
+		else
+			vb = v4l2_m2m_dst_buf_remove(ctx->fh.m2m_ctx);
+		if (!vb)
+			break;
+		v4l2_m2m_buf_done(vb, VB2_BUF_STATE_ERROR);
+	}
+}
+
+static struct vb2_ops rockchip_vpu_qops = {
+	.queue_setup		= rockchip_vpu_queue_setup,
+	.buf_prepare		= rockchip_vpu_buf_prepare,
+	.buf_queue		= rockchip_vpu_buf_queue,
+	.start_streaming	= rockchip_vpu_start_streaming,
+	.stop_streaming		= rockchip_vpu_stop_streaming,
+	.wait_prepare		= vb2_ops_wait_prepare,
+	.wait_finish		= vb2_ops_wait_finish,
+};
+
+static int rockchip_vpu_queue_init(void *priv, struct vb2_queue *src_vq,
+				   struct vb2_queue *dst_vq)
+{
+	struct rockchip_vpu_ctx *ctx = priv;
+	int ret;
+
+	src_vq->type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	src_vq->io_modes = VB2_MMAP | VB2_DMABUF;
+	src_vq->drv_priv = ctx;
+	src_vq->ops = &rockchip_vpu_qops;
+	src_vq->mem_ops = &vb2_dma_contig_memops;
+	src_vq->timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_COPY;
+	src_vq->lock = &ctx->vpu->mutex;
+
+	ret = vb2_queue_init(src_vq);
+	if (ret)
+		return ret;
+
+	/* the CPU writes the JPEG headers, so capture buffers need a vaddr */
+	dst_vq->type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	dst_vq->io_modes = VB2_MMAP | VB2_DMABUF;
+	dst_vq->drv_priv = ctx;
+	dst_vq->ops = &rockchip_vpu_qops;
+	dst_vq->mem_ops = &vb2_dma_contig_memops;
+	dst_vq->timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_COPY;
+	dst_vq->lock = &ctx->vpu->mutex;
+
+	return vb2_queue_init(dst_vq);
+}
+
+/*
+ * ============================================================================
+ * File operations
+ * ============================================================================
+ */
+static int rockchip_vpu_open(struct file *file)
+{
+	struct rockchip_vpu_dev *vpu = video_drvdata(file);
+	struct rockchip_vpu_ctx *ctx;
+	struct v4l2_format f = {
+		.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE,
+	};
+	int ret;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+
+	v4l2_fh_init(&ctx->fh, video_devdata(file));
+	file->private_data = &ctx->fh;
+	ctx->vpu = vpu;
+
+	ctx->fh.m2m_ctx = v4l2_m2m_ctx_init(vpu->m2m_dev, ctx,
+					    rockchip_vpu_queue_init);
+	if (IS_ERR(ctx->fh.m2m_ctx)) {
+		ret = PTR_ERR(ctx->fh.m2m_ctx);
+		goto err_fh_exit;
+	}
+
+	v4l2_ctrl_handler_init(&ctx->ctrl_handler, 1);
+	v4l2_ctrl_new_std(&ctx->ctrl_handler, &rockchip_vpu_ctrl_ops,
+			  V4L2_CID_JPEG_COMPRESSION_QUALITY, 5, 100, 1, 50);
+	if (ctx->ctrl_handler.error) {
+		ret = ctx->ctrl_handler.error;
+		goto err_ctrl_free;
+	}
+	v4l2_ctrl_handler_setup(&ctx->ctrl_handler);
+	ctx->fh.ctrl_handler = &ctx->ctrl_handler;
+
+	/* default to 640x480 YUV420M in, JPEG out */
+	f.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_YUV420M;
+	f.fmt.pix_mp.width = 640;
+	f.fmt.pix_mp.height = 480;
+	rockchip_vpu_s_fmt(file, &ctx->fh, &f);
+
+	v4l2_fh_add(&ctx->fh);
+
+	return 0;
+
+err_ctrl_free:
+	v4l2_ctrl_handler_free(&ctx->ctrl_handler);
+	v4l2_m2m_ctx_release(ctx->fh.m2m_ctx);
+err_fh_exit:
+	v4l2_fh_exit(&ctx->fh);
+	kfree(ctx);
+	return ret;
+}
+
+static int rockchip_vpu_release(struct file *file)
+{
+	struct rockchip_vpu_ctx *ctx = fh_to_ctx(file->private_data);
+	struct rockchip_vpu_dev *vpu = ctx->vpu;
+
+	mutex_lock(&vpu->mutex);
+	v4l2_m2m_ctx_release(ctx->fh.m2m_ctx);
+	mutex_unlock(&vpu->mutex);
+	v4l2_ctrl_handler_free(&ctx->ctrl_handler);
+	v4l2_fh_del(&ctx->fh);
+	v4l2_fh_exit(&ctx->fh);
+	kfree(ctx);
+
+	return 0;
+}
+
+static const struct v4l2_file_operations rockchip_vpu_fops = {
+	.owner		= THIS_MODULE,
+	.open		= rockchip_vpu_open,
+	.release	= rockchip_vpu_release,
+	.poll		= v4l2_m2m_fop_poll,
+	.unlocked_ioctl	= video_ioctl2,
+	.mmap		= v4l2_m2m_fop_mmap,
+};
+
+/*
+ * ============================================================================
+ * Driver basic infrastructure
+ * ============================================================================
+ */
+static int rockchip_vpu_iommu_init(struct rockchip_vpu_dev *vpu)
+{
+	struct dma_iommu_mapping *mapping;
+	struct device *dev = vpu->dev;
+	int ret;
+
+	if (!of_find_property(dev->of_node, "iommus", NULL))
+		return 0;
+
+	dev->dma_parms = devm_kzalloc(dev, sizeof(*dev->dma_parms),
+				      GFP_KERNEL);
+	if (!dev->dma_parms)
+		return -ENOMEM;
+	dma_set_max_seg_size(dev, DMA_BIT_MASK(32));
+
+	/* buffers only need to be contiguous in the IOMMU address space */
+	mapping = arm_iommu_create_mapping(&platform_bus_type, 0x10000000,
+					   SZ_2G);
+	if (IS_ERR(mapping))
+		return PTR_ERR(mapping);
+
+	ret = arm_iommu_attach_device(dev, mapping);
+	if (ret)
+		arm_iommu_release_mapping(mapping);
+	return ret;
+}
+
+static void rockchip_vpu_iommu_cleanup(struct rockchip_vpu_dev *vpu)
+{
+	struct dma_iommu_mapping *mapping = to_dma_iommu_mapping(vpu->dev);
+
+	if (!mapping)
+		return;
+
+	arm_iommu_detach_device(vpu->dev);
+	arm_iommu_release_mapping(mapping);
+}
+
+static int rockchip_vpu_probe(struct platform_device *pdev)
+{
+	struct rockchip_vpu_dev *vpu;
+	struct resource *res;
+	int irq, ret;
+
+	vpu = devm_kzalloc(&pdev->dev, sizeof(*vpu), GFP_KERNEL);
+	if (!vpu)
+		return -ENOMEM;
+
+	vpu->dev = &pdev->dev;
+	mutex_init(&vpu->mutex);
+	spin_lock_init(&vpu->irqlock);
+	INIT_DELAYED_WORK(&vpu->watchdog, rockchip_vpu_watchdog);
+
+	/* the encoder registers come first, the decoder's follow */
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	vpu->enc_base = devm_ioremap_resource(vpu->dev, res);
+	if (IS_ERR(vpu->enc_base))
+		return PTR_ERR(vpu->enc_base);
+
+	vpu->aclk = devm_clk_get(vpu->dev, "aclk");
+	if (IS_ERR(vpu->aclk)) {
+		dev_err(vpu->dev, "failed to get aclk\n");
+		return PTR_ERR(vpu->aclk);
+	}
+
+	vpu->hclk = devm_clk_get(vpu->dev, "hclk");
+	if (IS_ERR(vpu->hclk)) {
+		dev_err(vpu->dev, "failed to get hclk\n");
+		return PTR_ERR(vpu->hclk);
+	}
+
+	irq = platform_get_irq_byname(pdev, "vepu");
+	if (irq < 0) {
+		dev_err(vpu->dev, "failed to get vepu irq\n");
+		return irq;
+	}
+
+	ret = devm_request_irq(vpu->dev, irq, rockchip_vpu_enc_irq, 0,
+			       dev_name(vpu->dev), vpu);
+	if (ret) {
+		dev_err(vpu->dev, "failed to request vepu irq\n");
+		return ret;
+	}
+
+	ret = rockchip_vpu_iommu_init(vpu);
+	if (ret) {
+		dev_err(vpu->dev, "failed to attach to the iommu\n");
+		return ret;
+	}
+
+	pm_runtime_set_autosuspend_delay(vpu->dev, 100);
+	pm_runtime_use_autosuspend(vpu->dev);
+	pm_runtime_enable(vpu->dev);
+
+	vpu->alloc_ctx = vb2_dma_contig_init_ctx(vpu->dev);
+	if (IS_ERR(vpu->alloc_ctx)) {
+		ret = PTR_ERR(vpu->alloc_ctx);
+		goto err_pm_disable;
+	}
+
+	ret = v4l2_device_register(vpu->dev, &vpu->v4l2_dev);
+	if (ret) {
+		dev_err(vpu->dev, "failed to register v4l2 device\n");
+		goto err_cleanup_ctx;
+	}
+
+	vpu->m2m_dev = v4l2_m2m_init(&rockchip_vpu_m2m_ops);
+	if (IS_ERR(vpu->m2m_dev)) {
+		v4l2_err(&vpu->v4l2_dev, "failed to init mem2mem device\n");
+		ret = PTR_ERR(vpu->m2m_dev);
+		goto err_v4l2_unreg;
+	}
+
+	strlcpy(vpu->vfd.name, DRV_NAME "-enc", sizeof(vpu->vfd.name));
+	vpu->vfd.fops		= &rockchip_vpu_fops;
+	vpu->vfd.ioctl_ops	= &rockchip_vpu_ioctl_ops;
+	vpu->vfd.minor		= -1;
+	vpu->vfd.release	= video_device_release_empty;
+	vpu->vfd.lock		= &vpu->mutex;
+	vpu->vfd.v4l2_dev	= &vpu->v4l2_dev;
+	vpu->vfd.vfl_dir	= VFL_DIR_M2M;
+	video_set_drvdata(&vpu->vfd, vpu);
+
+	ret = video_register_device(&vpu->vfd, VFL_TYPE_GRABBER, -1);
+	if (ret) {
+		v4l2_err(&vpu->v4l2_dev, "failed to register video device\n");
+		goto err_m2m_rel;
+	}
+
+	platform_set_drvdata(pdev, vpu);
+	v4l2_info(&vpu->v4l2_dev, "encoder registered as /dev/video%d\n",
+		  vpu->vfd.num);
+
+	return 0;
+
+err_m2m_rel:
+	v4l2_m2m_release(vpu->m2m_dev);
+err_v4l2_unreg:
+	v4l2_device_unregister(&vpu->v4l2_dev);
+err_cleanup_ctx:
+	vb2_dma_contig_cleanup_ctx(vpu->alloc_ctx);
+err_pm_disable:
+	pm_runtime_disable(vpu->dev);
+	rockchip_vpu_iommu_cleanup(vpu);
+	return ret;
+}
+
+static int rockchip_vpu_remove(struct platform_device *pdev)
+{
+	struct rockchip_vpu_dev *vpu = platform_get_drvdata(pdev);
+
+	video_unregister_device(&vpu->vfd);
+	cancel_delayed_work_sync(&vpu->watchdog);
+	v4l2_m2m_release(vpu->m2m_dev);
+	v4l2_device_unregister(&vpu->v4l2_dev);
+	vb2_dma_contig_cleanup_ctx(vpu->alloc_ctx);
+	pm_runtime_disable(vpu->dev);
+	rockchip_vpu_iommu_cleanup(vpu);
+
+	return 0;
+}
+
+#ifdef CONFIG_PM
+static int rockchip_vpu_runtime_suspend(struct device *dev)
+{
+	struct rockchip_vpu_dev *vpu = dev_get_drvdata(dev);
+
+	clk_disable_unprepare(vpu->hclk);
+	clk_disable_unprepare(vpu->aclk);
+
+	return 0;
+}
+
+static int rockchip_vpu_runtime_resume(struct device *dev)
+{
+	struct rockchip_vpu_dev *vpu = dev_get_drvdata(dev);
+	int ret;
+
+	ret = clk_prepare_enable(vpu->aclk);
+	if (ret)
+		return ret;
+
+	ret = clk_prepare_enable(vpu->hclk);
+	if (ret)
+		clk_disable_unprepare(vpu->aclk);
+
+	return ret;
+}
+#endif
+
+static const struct dev_pm_ops rockchip_vpu_pm_ops = {
+	SET_RUNTIME_PM_OPS(rockchip_vpu_runtime_suspend,
+			   rockchip_vpu_runtime_resume, NULL)
+};
+
+static const struct of_device_id rockchip_vpu_dt_ids[] = {
+	{ .compatible = "rockchip,rk3288-vpu" },
+	{ }
+};
+MODULE_DEVICE_TABLE(of, rockchip_vpu_dt_ids);
+
+static struct platform_driver rockchip_vpu_driver = {
+	.probe = rockchip_vpu_probe,
+	.remove = rockchip_vpu_remove,
+	.driver = {
+		.name = DRV_NAME,
+		.of_match_table = rockchip_vpu_dt_ids,
+		.pm = &rockchip_vpu_pm_ops,
+	},
+};
+module_platform_driver(rockchip_vpu_driver);
+
+MODULE_ALIAS("platform:" DRV_NAME);
+MODULE_DESCRIPTION("Rockchip VPU codec driver");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,109 @@
+/*
+ * Rockchip VPU codec driver
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __ROCKCHIP_VPU_H__
+#define __ROCKCHIP_VPU_H__
+
+#include <linux/clk.h>
+#include <linux/io.h>
+#include <linux/platform_device.h>
+#include <linux/spinlock.h>
+#include <linux/videodev2.h>
+#include <linux/workqueue.h>
+#include <media/v4l2-ctrls.h>
+#include <media/v4l2-device.h>
+#include <media/v4l2-fh.h>
+#include <media/v4l2-mem2mem.h>
+#include <media/videobuf2-core.h>
+
+#define DRV_NAME		"rockchip-vpu"
+
+#define VPU_ENC_WIDTH_MIN	96
+#define VPU_ENC_HEIGHT_MIN	32
+#define VPU_ENC_WIDTH_MAX	8192
+#define VPU_ENC_HEIGHT_MAX	8192
+#define VPU_MB_DIM		16
+#define VPU_JOB_TIMEOUT		2000 /* ms */
+
+/*
+ * Room for the JPEG headers written in front of the stream; their size
+ * is padded to this, as the stream the hardware writes must be aligned.
+ */
+#define VPU_JPEG_HDR_SIZE	640
+
+#define VPU_FMT_OUTPUT		BIT(0)
+#define VPU_FMT_CAPTURE		BIT(1)
+
+struct rockchip_vpu_fmt {
+	u32 fourcc;
+	unsigned int types;
+	unsigned int num_planes;
+	/* bits per pixel of each plane, at full width and height */
+	u8 bpp[3];
+	u32 enc_fmt;
+};
+
+struct rockchip_vpu_dev {
+	struct v4l2_device v4l2_dev;
+	struct v4l2_m2m_dev *m2m_dev;
+	struct video_device vfd;
+	struct device *dev;
+	void __iomem *enc_base;
+	struct clk *aclk;
+	struct clk *hclk;
+	void *alloc_ctx;
+	/* serializes ioctls and vb2 queue operations */
+	struct mutex mutex;
+	/* protects the hardware and the current job */
+	spinlock_t irqlock;
+	struct rockchip_vpu_ctx *curr;
+	struct delayed_work watchdog;
+};
+
+struct rockchip_vpu_ctx {
+	struct v4l2_fh fh;
+	struct rockchip_vpu_dev *vpu;
+	struct v4l2_ctrl_handler ctrl_handler;
+
+	const struct rockchip_vpu_fmt *src_fmtinfo;
+	struct v4l2_pix_format_mplane src_fmt;
+	struct v4l2_pix_format_mplane dst_fmt;
+	u32 sequence_out;
+	u32 sequence_cap;
+
+	int jpeg_quality;
+};
+
+static inline struct rockchip_vpu_ctx *fh_to_ctx(struct v4l2_fh *fh)
+{
+	return container_of(fh, struct rockchip_vpu_ctx, fh);
+}
+
+static inline void vepu_write_relaxed(struct rockchip_vpu_dev *vpu,
+				      u32 val, u32 reg)
+{
+	writel_relaxed(val, vpu->enc_base + reg);
+}
+
+static inline void vepu_write(struct rockchip_vpu_dev *vpu, u32 val, u32 reg)
+{
+	writel(val, vpu->enc_base + reg);
+}
+
+static inline u32 vepu_read(struct rockchip_vpu_dev *vpu, u32 reg)
+{
+	return readl(vpu->enc_base + reg);
+}
+
+int rockchip_vpu_jpeg_enc_run(struct rockchip_vpu_ctx *ctx,
+			      struct vb2_buffer *src_buf,
+			      struct vb2_buffer *dst_buf);
+void rockchip_vpu_jpeg_enc_done(struct rockchip_vpu_ctx *ctx,
+				struct vb2_buffer *dst_buf);
+
+#endif /* __ROCKCHIP_VPU_H__ */
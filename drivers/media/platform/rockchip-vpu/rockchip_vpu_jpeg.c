@@ -0,0 +1,324 @@
+/*
+ * Rockchip VPU codec driver, JPEG encoder
+ *
+ * The VEPU only produces the entropy coded data; the driver writes the
+ * JPEG headers, with the quantization tables scaled to the requested
+ * quality and the standard Huffman tables the hardware codes with, in
+ * front of it.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <asm/unaligned.h>
+#include <linux/kernel.h>
+#include <media/videobuf2-dma-contig.h>
+
+#include "rockchip_vpu.h"
+#include "rockchip_vpu_regs.h"
+
+/* JPEG markers */
+#define SOF0	0xc0
+#define DHT	0xc4
+#define SOI	0xd8
+#define SOS	0xda
+#define DQT	0xdb
+#define COM	0xfe
+
+/* ITU-T T.81 Annex K quantization tables, in raster order */
+static const u8 luma_q_table[64] = {
+	16, 11, 10, 16,  24,  40,  51,  61,
+	12, 12, 14, 19,  26,  58,  60,  55,
+	14, 13, 16, 24,  40,  57,  69,  56,
+	14, 17, 22, 29,  51,  87,  80,  62,
+	18, 22, 37, 56,  68, 109, 103,  77,
+	24, 35, 55, 64,  81, 104, 113,  92,
+	49, 64, 78, 87, 103, 121, 120, 101,
+	72, 92, 95, 98, 112, 100, 103,  99,
+};
+
+static const u8 chroma_q_table[64] = {
+	17, 18, 24, 47, 99, 99, 99, 99,
+	18, 21, 26, 66, 99, 99, 99, 99,
+	24, 26, 56, 99, 99, 99, 99, 99,
+	47, 66, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+/* raster position of each coefficient in zigzag order */
+static const u8 zigzag[64] = {
+	 0,  1,  8, 16,  9,  2,  3, 10,
+	17, 24, 32, 25, 18, 11,  4,  5,
+	12, 19, 26, 33, 40, 48, 41, 34,
+	27, 20, 13,  6,  7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36,
+	29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46,
+	53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+/* ITU-T T.81 Annex K Huffman tables: 16 code counts, then the values */
+static const u8 luma_dc_table[16 + 12] = {
+	0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b,
+};
+
+static const u8 chroma_dc_table[16 + 12] = {
+	0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b,
+};
+
+static const u8 luma_ac_table[16 + 162] = {
+	0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03,
+	0x05, 0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7d,
+	0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12,
+	0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+	0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+	0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+	0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16,
+	0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+	0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+	0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+	0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+	0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79,
+	0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+	0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98,
+	0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+	0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+	0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+	0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4,
+	0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+	0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
+	0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+	0xf9, 0xfa,
+};
+
+static const u8 chroma_ac_table[16 + 162] = {
+	0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04,
+	0x07, 0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77,
+	0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21,
+	0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+	0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+	0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+	0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34,
+	0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+	0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38,
+	0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+	0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+	0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+	0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78,
+	0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+	0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96,
+	0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+	0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+	0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+	0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2,
+	0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+	0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9,
+	0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+	0xf9, 0xfa,
+};
+
+struct jpeg_writer {
+	u8 *p;
+};
+
+static void put_u8(struct jpeg_writer *w, u8 val)
+{
+	*w->p++ = val;
+}
+
+static void put_be16(struct jpeg_writer *w, u16 val)
+{
+	put_u8(w, val >> 8);
+	put_u8(w, val & 0xff);
+}
+
+static void put_marker(struct jpeg_writer *w, u8 marker, u16 len)
+{
+	put_u8(w, 0xff);
+	put_u8(w, marker);
+	/* the segment length counts itself, but not the marker */
+	put_be16(w, len + 2);
+}
+
+static void put_table(struct jpeg_writer *w, u8 class_id, const u8 *table,
+		      size_t size)
+{
+	put_u8(w, class_id);
+	memcpy(w->p, table, size);
+	w->p += size;
+}
+
+/* IJG quality scaling of @table, kept in raster order for the hardware */
+static void jpeg_scale_q_table(u8 *q, const u8 *table, int quality)
+{
+	int scale, i;
+
+	scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+	for (i = 0; i < 64; i++)
+		q[i] = clamp(DIV_ROUND_CLOSEST(table[i] * scale, 100), 1, 255);
+}
+
+/*
+ * Write SOI, DQT, SOF0, DHT and SOS for a 4:2:0 image, padded with a COM
+ * segment to VPU_JPEG_HDR_SIZE bytes.
+ */
+static void jpeg_write_headers(struct jpeg_writer *w, const u8 *luma_q,
+			       const u8 *chroma_q, u16 width, u16 height)
+{
+	u8 *start = w->p;
+	int i;
+
+	put_u8(w, 0xff);
+	put_u8(w, SOI);
+
+	put_marker(w, DQT, 2 * (1 + 64));
+	put_u8(w, 0x00);
+	for (i = 0; i < 64; i++)
+		put_u8(w, luma_q[zigzag[i]]);
+	put_u8(w, 0x01);
+	for (i = 0; i < 64; i++)
+		put_u8(w, chroma_q[zigzag[i]]);
+
+	put_marker(w, SOF0, 6 + 3 * 3);
+	put_u8(w, 8);
+	put_be16(w, height);
+	put_be16(w, width);
+	put_u8(w, 3);
+	/* Y: 2x2 sampling, table 0; Cb and Cr: 1x1, table 1 */
+	put_u8(w, 1);
+	put_u8(w, 0x22);
+	put_u8(w, 0);
+	put_u8(w, 2);
+	put_u8(w, 0x11);
+	put_u8(w, 1);
+	put_u8(w, 3);
+	put_u8(w, 0x11);
+	put_u8(w, 1);
+
+	put_marker(w, DHT, 4 + sizeof(luma_dc_table) + sizeof(luma_ac_table) +
+		   sizeof(chroma_dc_table) + sizeof(chroma_ac_table));
+	put_table(w, 0x00, luma_dc_table, sizeof(luma_dc_table));
+	put_table(w, 0x10, luma_ac_table, sizeof(luma_ac_table));
+	put_table(w, 0x01, chroma_dc_table, sizeof(chroma_dc_table));
+	put_table(w, 0x11, chroma_ac_table, sizeof(chroma_ac_table));
+
+	/* COM, then the 14 bytes of SOS, must end the header exactly */
+	i = VPU_JPEG_HDR_SIZE - (w->p - start) - 4 - 14;
+	put_marker(w, COM, i);
+	memset(w->p, 0, i);
+	w->p += i;
+
+	put_marker(w, SOS, 1 + 3 * 2 + 3);
+	put_u8(w, 3);
+	put_u8(w, 1);
+	put_u8(w, 0x00);
+	put_u8(w, 2);
+	put_u8(w, 0x11);
+	put_u8(w, 3);
+	put_u8(w, 0x11);
+	/* baseline: full spectral range, no successive approximation */
+	put_u8(w, 0);
+	put_u8(w, 63);
+	put_u8(w, 0);
+}
+
+static void rockchip_vpu_jpeg_set_qtable(struct rockchip_vpu_dev *vpu,
+					 const u8 *luma_q, const u8 *chroma_q)
+{
+	int i;
+
+	for (i = 0; i < VEPU_JPEG_QUANT_TABLE_COUNT; i++) {
+		vepu_write_relaxed(vpu, get_unaligned_be32(&luma_q[i * 4]),
+				   VEPU_REG_JPEG_LUMA_QUAT(i));
+		vepu_write_relaxed(vpu, get_unaligned_be32(&chroma_q[i * 4]),
+				   VEPU_REG_JPEG_CHROMA_QUAT(i));
+	}
+}
+
+/* Called with vpu->irqlock held */
+int rockchip_vpu_jpeg_enc_run(struct rockchip_vpu_ctx *ctx,
+			      struct vb2_buffer *src_buf,
+			      struct vb2_buffer *dst_buf)
+{
+	struct rockchip_vpu_dev *vpu = ctx->vpu;
+	struct v4l2_pix_format_mplane *src_fmt = &ctx->src_fmt;
+	struct jpeg_writer w;
+	u8 luma_q[64], chroma_q[64];
+	unsigned int mb_width = DIV_ROUND_UP(src_fmt->width, VPU_MB_DIM);
+	unsigned int mb_height = DIV_ROUND_UP(src_fmt->height, VPU_MB_DIM);
+	dma_addr_t dst;
+	unsigned int i;
+	u32 reg;
+
+	w.p = vb2_plane_vaddr(dst_buf, 0);
+	if (!w.p) {
+		dev_err(vpu->dev, "cannot map the capture buffer\n");
+		return -EFAULT;
+	}
+
+	jpeg_scale_q_table(luma_q, luma_q_table, ctx->jpeg_quality);
+	jpeg_scale_q_table(chroma_q, chroma_q_table, ctx->jpeg_quality);
+	jpeg_write_headers(&w, luma_q, chroma_q, src_fmt->width,
+			   src_fmt->height);
+
+	/* switch to JPEG mode before writing the other registers */
+	vepu_write_relaxed(vpu, VEPU_REG_ENC_CTRL_ENC_MODE_JPEG,
+			   VEPU_REG_ENC_CTRL);
+
+	reg = VEPU_REG_IN_IMG_CTRL_ROW_LEN(src_fmt->width) |
+	      VEPU_REG_IN_IMG_CTRL_OVRFLR_D4(0) |
+	      VEPU_REG_IN_IMG_CTRL_OVRFLB(0) |
+	      VEPU_REG_IN_IMG_CTRL_FMT(ctx->src_fmtinfo->enc_fmt);
+	vepu_write_relaxed(vpu, reg, VEPU_REG_IN_IMG_CTRL);
+
+	dst = vb2_dma_contig_plane_dma_addr(dst_buf, 0);
+	vepu_write_relaxed(vpu, dst + VPU_JPEG_HDR_SIZE,
+			   VEPU_REG_ADDR_OUTPUT_STREAM);
+	vepu_write_relaxed(vpu, vb2_plane_size(dst_buf, 0) - VPU_JPEG_HDR_SIZE,
+			   VEPU_REG_STR_BUF_LIMIT);
+	for (i = 0; i < src_fmt->num_planes; i++)
+		vepu_write_relaxed(vpu,
+				   vb2_dma_contig_plane_dma_addr(src_buf, i),
+				   VEPU_REG_ADDR_IN_PLANE_0 + i * 4);
+
+	rockchip_vpu_jpeg_set_qtable(vpu, luma_q, chroma_q);
+
+	reg = VEPU_REG_AXI_CTRL_OUTPUT_SWAP16 |
+	      VEPU_REG_AXI_CTRL_INPUT_SWAP16 |
+	      VEPU_REG_AXI_CTRL_BURST_LEN(16) |
+	      VEPU_REG_AXI_CTRL_OUTPUT_SWAP32 |
+	      VEPU_REG_AXI_CTRL_INPUT_SWAP32 |
+	      VEPU_REG_AXI_CTRL_OUTPUT_SWAP8 |
+	      VEPU_REG_AXI_CTRL_INPUT_SWAP8;
+	/* makes sure all the relaxed writes above are done */
+	vepu_write(vpu, reg, VEPU_REG_AXI_CTRL);
+
+	reg = VEPU_REG_ENC_CTRL_WIDTH(mb_width) |
+	      VEPU_REG_ENC_CTRL_HEIGHT(mb_height) |
+	      VEPU_REG_ENC_CTRL_ENC_MODE_JPEG |
+	      VEPU_REG_ENC_PIC_INTRA |
+	      VEPU_REG_ENC_CTRL_EN_BIT;
+	vepu_write(vpu, reg, VEPU_REG_ENC_CTRL);
+
+	return 0;
+}
+
+void rockchip_vpu_jpeg_enc_done(struct rockchip_vpu_ctx *ctx,
+				struct vb2_buffer *dst_buf)
+{
+	/* the hardware reports the size of the stream in bits */
+	u32 bytes = vepu_read(ctx->vpu, VEPU_REG_STR_BUF_LIMIT) / 8;
+
+	vb2_set_plane_payload(dst_buf, 0, VPU_JPEG_HDR_SIZE + bytes);
+}
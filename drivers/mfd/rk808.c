@@ -63,6 +63,7 @@ static const struct regmap_config rk808_regmap_config = {
 	.max_register = RK808_IO_POL_REG,
 	.cache_type = REGCACHE_RBTREE,
 	.volatile_reg = rk808_is_volatile_reg,
+	.can_multi_write = true,
 };
 
 static struct resource rtc_resources[] = {
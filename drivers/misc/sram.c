@@ -27,6 +27,7 @@
 #include <linux/slab.h>
 
 #define SRAM_GRANULARITY	32
+#define SRAM_CACHE_MAX_SIZE	256
 
 struct sram_dev {
 	struct device *dev;
@@ -195,6 +196,14 @@ static int sram_probe(struct platform_device *pdev)
 	if (ret)
 		return ret;
 
+	/*
+	 * Small blocks such as DMA descriptors come from per-CPU caches, if
+	 * the SRAM is large enough to spare what the caches hold back.
+	 */
+	ret = gen_pool_enable_cache(sram->pool, SRAM_CACHE_MAX_SIZE);
+	if (ret)
+		dev_dbg(sram->dev, "no allocation caches: %d\n", ret);
+
 	sram->clk = devm_clk_get(sram->dev, NULL);
 	if (IS_ERR(sram->clk))
 		sram->clk = NULL;
@@ -213,6 +222,7 @@ static int sram_remove(struct platform_device *pdev)
 {
 	struct sram_dev *sram = platform_get_drvdata(pdev);
 
+	gen_pool_drain_cache(sram->pool);
 	if (gen_pool_avail(sram->pool) < gen_pool_size(sram->pool))
 		dev_err(sram->dev, "removed while SRAM allocated\n");
 
@@ -64,6 +64,8 @@ MODULE_ALIAS("mmc:block");
 #define MMC_BLK_TIMEOUT_MS  (10 * 60 * 1000)        /* 10 minute timeout */
 #define MMC_SANITIZE_REQ_TIMEOUT 240000
 #define MMC_EXTRACT_INDEX_FROM_ARG(x) ((x & 0x00FF0000) >> 16)
+#define MMC_CMDQ_RETRIES	3	/* requeues of a task before it fails */
+#define MMC_CMDQ_POLL_US	100	/* wait between queue status reads */
 
 #define mmc_req_rel_wr(req)	(((req->cmd_flags & REQ_FUA) || \
 				  (req->cmd_flags & REQ_META)) && \
@@ -187,6 +189,7 @@ static void mmc_blk_put(struct mmc_blk_data *md)
 	if (md->usage == 0) {
 		int devidx = mmc_get_devidx(md->disk);
 		blk_cleanup_queue(md->queue.queue);
+		blk_mq_free_tag_set(&md->queue.tag_set);
 
 		__clear_bit(devidx, dev_use);
 
@@ -536,6 +539,16 @@ static int mmc_blk_ioctl_cmd(struct block_device *bdev,
 	if (err)
 		goto cmd_rel_host;
 
+	/*
+	 * Most commands are illegal while command queuing is enabled. The
+	 * queue turns it back on with its next request.
+	 */
+	if (card->ext_csd.cmdq_en) {
+		err = mmc_cmdq_disable(card);
+		if (err)
+			goto cmd_rel_host;
+	}
+
 	if (idata->ic.is_acmd) {
 		err = mmc_app_cmd(card->host, card);
 		if (err)
@@ -652,8 +665,15 @@ static inline int mmc_blk_part_switch(struct mmc_card *card,
 	int ret;
 	struct mmc_blk_data *main_md = dev_get_drvdata(&card->dev);
 
+	/* Only the queue of the user area issues tasks */
+	if (card->ext_csd.cmdq_en && !md->queue.cmdq_depth) {
+		ret = mmc_cmdq_disable(card);
+		if (ret)
+			return ret;
+	}
+
 	if (main_md->part_curr == md->part_type)
-		return 0;
+		goto cmdq;
 
 	if (mmc_card_mmc(card)) {
 		u8 part_config = card->ext_csd.part_config;
@@ -671,6 +691,10 @@ static inline int mmc_blk_part_switch(struct mmc_card *card,
 	}
 
 	main_md->part_curr = md->part_type;
+
+cmdq:
+	if (!card->ext_csd.cmdq_en && md->queue.cmdq_depth)
+		return mmc_cmdq_enable(card);
 	return 0;
 }
 
@@ -1087,7 +1111,7 @@ out:
 		goto retry;
 	if (!err)
 		mmc_blk_reset_success(md, type);
-	blk_end_request(req, err, blk_rq_bytes(req));
+	mmc_queue_end_request(req, err, blk_rq_bytes(req));
 
 	return err ? 0 : 1;
 }
@@ -1154,7 +1178,7 @@ out_retry:
 	if (!err)
 		mmc_blk_reset_success(md, type);
 out:
-	blk_end_request(req, err, blk_rq_bytes(req));
+	mmc_queue_end_request(req, err, blk_rq_bytes(req));
 
 	return err ? 0 : 1;
 }
@@ -1169,7 +1193,7 @@ static int mmc_blk_issue_flush(struct mmc_queue *mq, struct request *req)
 	if (ret)
 		ret = -EIO;
 
-	blk_end_request_all(req, ret);
+	blk_mq_end_request(req, ret);
 
 	return ret ? 0 : 1;
 }
@@ -1601,9 +1625,7 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 			break;
 		}
 
-		spin_lock_irq(q->queue_lock);
-		next = blk_fetch_request(q);
-		spin_unlock_irq(q->queue_lock);
+		next = mmc_queue_fetch(mq);
 		if (!next) {
 			put_back = false;
 			break;
@@ -1637,11 +1659,8 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 		reqs++;
 	} while (1);
 
-	if (put_back) {
-		spin_lock_irq(q->queue_lock);
-		blk_requeue_request(q, next);
-		spin_unlock_irq(q->queue_lock);
-	}
+	if (put_back)
+		mmc_queue_requeue(mq, next);
 
 	if (reqs > 0) {
 		list_add(&req->queuelist, &mqrq->packed->list);
@@ -1759,11 +1778,12 @@ static int mmc_blk_cmd_err(struct mmc_blk_data *md, struct mmc_card *card,
 
 		blocks = mmc_sd_num_wr_blocks(card);
 		if (blocks != (u32)-1) {
-			ret = blk_end_request(req, 0, blocks << 9);
+			ret = mmc_queue_end_request(req, 0, blocks << 9);
 		}
 	} else {
 		if (!mmc_packed_cmd(mq_rq->cmd_type))
-			ret = blk_end_request(req, 0, brq->data.bytes_xfered);
+			ret = mmc_queue_end_request(req, 0,
+						    brq->data.bytes_xfered);
 	}
 	return ret;
 }
@@ -1792,7 +1812,7 @@ static int mmc_blk_end_packed_req(struct mmc_queue_req *mq_rq)
 			return ret;
 		}
 		list_del_init(&prq->queuelist);
-		blk_end_request(prq, 0, blk_rq_bytes(prq));
+		mmc_queue_end_request(prq, 0, blk_rq_bytes(prq));
 		i++;
 	}
 
@@ -1810,7 +1830,7 @@ static void mmc_blk_abort_packed_req(struct mmc_queue_req *mq_rq)
 	while (!list_empty(&packed->list)) {
 		prq = list_entry_rq(packed->list.next);
 		list_del_init(&prq->queuelist);
-		blk_end_request(prq, -EIO, blk_rq_bytes(prq));
+		mmc_queue_end_request(prq, -EIO, blk_rq_bytes(prq));
 	}
 
 	mmc_blk_clear_packed(mq_rq);
@@ -1820,7 +1840,6 @@ static void mmc_blk_revert_packed_req(struct mmc_queue *mq,
 				      struct mmc_queue_req *mq_rq)
 {
 	struct request *prq;
-	struct request_queue *q = mq->queue;
 	struct mmc_packed *packed = mq_rq->packed;
 
 	BUG_ON(!packed);
@@ -1829,9 +1848,7 @@ static void mmc_blk_revert_packed_req(struct mmc_queue *mq,
 		prq = list_entry_rq(packed->list.prev);
 		if (prq->queuelist.prev != &packed->list) {
 			list_del_init(&prq->queuelist);
-			spin_lock_irq(q->queue_lock);
-			blk_requeue_request(mq->queue, prq);
-			spin_unlock_irq(q->queue_lock);
+			mmc_queue_requeue(mq, prq);
 		} else {
 			list_del_init(&prq->queuelist);
 		}
@@ -1906,12 +1923,12 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 				ret = mmc_blk_end_packed_req(mq_rq);
 				break;
 			} else {
-				ret = blk_end_request(req, 0,
+				ret = mmc_queue_end_request(req, 0,
 						brq->data.bytes_xfered);
 			}
 
 			/*
-			 * If the blk_end_request function returns non-zero even
+			 * If mmc_queue_end_request() returns non-zero even
 			 * though all data has been transferred and no errors
 			 * were returned by the host controller, it's a bug.
 			 */
@@ -1963,7 +1980,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 			 * time, so we only reach here after trying to
 			 * read a single sector.
 			 */
-			ret = blk_end_request(req, -EIO,
+			ret = mmc_queue_end_request(req, -EIO,
 						brq->data.blksz);
 			if (!ret)
 				goto start_new_req;
@@ -2007,7 +2024,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 		if (mmc_card_removed(card))
 			req->cmd_flags |= REQ_QUIET;
 		while (ret)
-			ret = blk_end_request(req, -EIO,
+			ret = mmc_queue_end_request(req, -EIO,
 					blk_rq_cur_bytes(req));
 	}
 
@@ -2015,7 +2032,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 	if (rqc) {
 		if (mmc_card_removed(card)) {
 			rqc->cmd_flags |= REQ_QUIET;
-			blk_end_request_all(rqc, -EIO);
+			blk_mq_end_request(rqc, -EIO);
 		} else {
 			/*
 			 * If current request is packed, it needs to put back.
@@ -2048,7 +2065,7 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 	ret = mmc_blk_part_switch(card, md);
 	if (ret) {
 		if (req) {
-			blk_end_request_all(req, -EIO);
+			blk_mq_end_request(req, -EIO);
 		}
 		ret = 0;
 		goto out;
@@ -2090,12 +2107,218 @@ out:
 	return ret;
 }
 
+/*
+ * Drop every task on the card after an error. The tasks are given back to
+ * blk-mq, so they go through mmc_check_request() again before they are
+ * reissued. They are failed instead once the card is gone, or once the
+ * failed request, or all of them if the failure is not specific to one,
+ * have been requeued MMC_CMDQ_RETRIES times.
+ */
+static void mmc_blk_cmdq_abort(struct mmc_queue *mq, struct request *failed)
+{
+	struct mmc_card *card = mq->card;
+	bool removed = mmc_card_removed(card);
+	struct request *req;
+	unsigned int tag;
+
+	if (!removed && mmc_cmdq_discard_queue(card))
+		pr_err("%s: failed to discard the command queue\n",
+		       mmc_hostname(card->host));
+
+	for_each_set_bit(tag, &mq->cmdq_queued, mq->cmdq_depth) {
+		req = blk_mq_tag_to_rq(mq->tag_set.tags[0], tag);
+		if (removed) {
+			req->cmd_flags |= REQ_QUIET;
+			blk_mq_end_request(req, -EIO);
+		} else if ((!failed || req == failed) &&
+			   ++req->errors > MMC_CMDQ_RETRIES) {
+			blk_mq_end_request(req, -EIO);
+		} else {
+			blk_mq_requeue_request(req);
+		}
+	}
+	mq->cmdq_queued = 0;
+	blk_mq_kick_requeue_list(mq->queue);
+}
+
+/*
+ * Queue a read or write on the card: CMD44 gives the task id, direction
+ * and length, CMD45 the start address.
+ */
+static int mmc_blk_cmdq_queue_task(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = mq->card;
+	struct mmc_command cmd = {0};
+	int err;
+
+	mq->cmdq_queued |= BIT(req->tag);
+
+	cmd.opcode = MMC_QUE_TASK_PARAMS;
+	cmd.arg = req->tag << MMC_CMDQ_TASK_ID_SHIFT | blk_rq_sectors(req);
+	if (rq_data_dir(req) == READ)
+		cmd.arg |= MMC_CMDQ_DATA_DIR_READ;
+	else if (mmc_req_rel_wr(req) && (md->flags & MMC_BLK_REL_WR))
+		cmd.arg |= MMC_CMDQ_REL_WRITE;
+	cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	err = mmc_wait_for_cmd(card->host, &cmd, 0);
+	if (err)
+		return err;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.opcode = MMC_QUE_TASK_ADDR;
+	cmd.arg = blk_rq_pos(req);
+	cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	return mmc_wait_for_cmd(card->host, &cmd, 0);
+}
+
+/*
+ * Execute the first task the card reports ready in its queue status
+ * register, if any, with CMD46 or CMD47.
+ */
+static int mmc_blk_cmdq_execute(struct mmc_queue *mq)
+{
+	struct mmc_card *card = mq->card;
+	struct mmc_request mrq = {NULL};
+	struct mmc_command cmd = {0};
+	struct mmc_data data = {0};
+	struct mmc_queue_req *mqrq;
+	struct request *req;
+	unsigned int tag;
+	u32 qsr;
+	int err;
+
+	err = mmc_cmdq_get_qsr(card, &qsr);
+	if (err) {
+		mmc_blk_cmdq_abort(mq, NULL);
+		return err;
+	}
+
+	qsr &= mq->cmdq_queued;
+	if (!qsr) {
+		/* the card is still preparing the tasks, don't spin on CMD13 */
+		usleep_range(MMC_CMDQ_POLL_US, 2 * MMC_CMDQ_POLL_US);
+		return 0;
+	}
+
+	tag = __ffs(qsr);
+	req = blk_mq_tag_to_rq(mq->tag_set.tags[0], tag);
+	mqrq = req_to_mmc_queue_req(req);
+
+	if (rq_data_dir(req) == READ) {
+		cmd.opcode = MMC_EXECUTE_READ_TASK;
+		data.flags = MMC_DATA_READ;
+	} else {
+		cmd.opcode = MMC_EXECUTE_WRITE_TASK;
+		data.flags = MMC_DATA_WRITE;
+	}
+	cmd.arg = tag << MMC_CMDQ_TASK_ID_SHIFT;
+	cmd.flags = MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	data.blksz = 512;
+	data.blocks = blk_rq_sectors(req);
+	data.sg = mqrq->sg;
+	data.sg_len = blk_rq_map_sg(mq->queue, req, mqrq->sg);
+	mmc_set_data_timeout(&data, card);
+
+	mrq.cmd = &cmd;
+	mrq.data = &data;
+
+	mmc_wait_for_req(card->host, &mrq);
+
+	err = cmd.error ? cmd.error : data.error;
+	if (err) {
+		pr_err("%s: task %u failed, error %d\n",
+		       req->rq_disk->disk_name, tag, err);
+		mmc_blk_cmdq_abort(mq, req);
+		return err;
+	}
+
+	mq->cmdq_queued &= ~BIT(tag);
+	blk_mq_end_request(req, 0);
+
+	return 0;
+}
+
+/*
+ * Issue function of a queue in command queuing mode. Reads and writes are
+ * queued on the card as tasks while task ids are free, and executed when
+ * the card reports them ready, which it can do in any order. Discards and
+ * flushes are not tasks: the queue is drained, then they are issued the
+ * same way as without command queuing.
+ */
+static int mmc_blk_cmdq_issue_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	int ret = 0;
+
+	if (req && !mq->cmdq_queued) {
+		/* claim host only for the first request */
+		mmc_get_card(card);
+
+		ret = mmc_blk_part_switch(card, md);
+		if (ret) {
+			blk_mq_end_request(req, -EIO);
+			ret = 0;
+			goto out;
+		}
+	}
+
+	if (!req) {
+		mmc_blk_cmdq_execute(mq);
+	} else if (req->cmd_flags & MMC_REQ_SPECIAL_MASK) {
+		while (mq->cmdq_queued)
+			mmc_blk_cmdq_execute(mq);
+
+		if (req->cmd_flags & REQ_DISCARD) {
+			if (req->cmd_flags & REQ_SECURE)
+				ret = mmc_blk_issue_secdiscard_rq(mq, req);
+			else
+				ret = mmc_blk_issue_discard_rq(mq, req);
+		} else {
+			ret = mmc_blk_issue_flush(mq, req);
+		}
+	} else if (mmc_blk_cmdq_queue_task(mq, req)) {
+		pr_err("%s: failed to queue task %d\n",
+		       req->rq_disk->disk_name, req->tag);
+		mmc_blk_cmdq_abort(mq, req);
+	}
+
+out:
+	/* Release host when no task is left on the card */
+	if (!mq->cmdq_queued)
+		mmc_put_card(card);
+	return ret;
+}
+
 static inline int mmc_blk_readonly(struct mmc_card *card)
 {
 	return mmc_card_readonly(card) ||
 	       !(card->csd.cmdclass & CCC_BLOCK_WRITE);
 }
 
+/*
+ * Command queuing is used for the user area only, and needs block
+ * addressing with 512 byte sectors, since CMD45 takes the sector and
+ * CMD44 the block count. Hosts that need a bounce buffer don't get it, as
+ * every queued task needs a scatterlist of its own.
+ */
+static unsigned int mmc_blk_cmdq_depth(struct mmc_card *card, int area_type)
+{
+	if (!mmc_card_mmc(card) || area_type != MMC_BLK_DATA_AREA_MAIN)
+		return 0;
+
+	if (!(card->host->caps2 & MMC_CAP2_CMDQ) ||
+	    !card->ext_csd.cmdq_support || !mmc_card_blockaddr(card) ||
+	    mmc_large_sector(card) || card->host->max_segs == 1)
+		return 0;
+
+	return min_t(unsigned int, card->ext_csd.cmdq_depth, BITS_PER_LONG);
+}
+
 static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 					      struct device *parent,
 					      sector_t size,
@@ -2104,6 +2327,7 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 					      int area_type)
 {
 	struct mmc_blk_data *md;
+	unsigned int cmdq_depth;
 	int devidx, ret;
 
 	devidx = find_first_zero_bit(dev_use, max_devices);
@@ -2148,11 +2372,26 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 	INIT_LIST_HEAD(&md->part);
 	md->usage = 1;
 
-	ret = mmc_init_queue(&md->queue, card, &md->lock, subname);
+	cmdq_depth = mmc_blk_cmdq_depth(card, area_type);
+	if (cmdq_depth) {
+		mmc_get_card(card);
+		ret = mmc_cmdq_enable(card);
+		mmc_put_card(card);
+		if (ret) {
+			pr_warn("%s: failed to enable command queuing: %d\n",
+				mmc_hostname(card->host), ret);
+			cmdq_depth = 0;
+		} else {
+			card->reenable_cmdq = true;
+		}
+	}
+
+	ret = mmc_init_queue(&md->queue, card, &md->lock, subname, cmdq_depth);
 	if (ret)
 		goto err_putdisk;
 
-	md->queue.issue_fn = mmc_blk_issue_rq;
+	md->queue.issue_fn = cmdq_depth ? mmc_blk_cmdq_issue_rq :
+					  mmc_blk_issue_rq;
 	md->queue.data = md;
 
 	md->disk->major	= MMC_BLOCK_MAJOR;
@@ -2206,7 +2445,7 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 	if (mmc_card_mmc(card) &&
 	    (area_type == MMC_BLK_DATA_AREA_MAIN) &&
 	    (md->flags & MMC_BLK_CMD23) &&
-	    card->ext_csd.packed_event_en) {
+	    card->ext_csd.packed_event_en && !md->queue.cmdq_depth) {
 		if (!mmc_packed_init(&md->queue, card))
 			md->flags |= MMC_BLK_PACKED_CMD;
 	}
@@ -12,6 +12,7 @@
 #include <linux/slab.h>
 #include <linux/module.h>
 #include <linux/blkdev.h>
+#include <linux/blk-mq.h>
 #include <linux/freezer.h>
 #include <linux/kthread.h>
 #include <linux/scatterlist.h>
@@ -19,37 +20,116 @@
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
+#include <linux/mmc/mmc.h>
 #include "queue.h"
 
 #define MMC_QUEUE_BOUNCESZ	65536
 
+static struct scatterlist *mmc_alloc_sg(int sg_len, int *err)
+{
+	struct scatterlist *sg;
+
+	sg = kmalloc(sizeof(struct scatterlist)*sg_len, GFP_KERNEL);
+	if (!sg)
+		*err = -ENOMEM;
+	else {
+		*err = 0;
+		sg_init_table(sg, sg_len);
+	}
+
+	return sg;
+}
+
 /*
- * Prepare a MMC request. This just filters out odd stuff.
+ * Check a MMC request. This just filters out odd stuff.
  */
-static int mmc_prep_request(struct request_queue *q, struct request *req)
+static bool mmc_check_request(struct mmc_queue *mq, struct request *req)
 {
-	struct mmc_queue *mq = q->queuedata;
-
 	/*
 	 * We only like normal block requests and discards.
 	 */
 	if (req->cmd_type != REQ_TYPE_FS && !(req->cmd_flags & REQ_DISCARD)) {
 		blk_dump_rq_flags(req, "MMC bad request");
-		return BLKPREP_KILL;
+		return false;
 	}
 
-	if (mq && (mmc_card_removed(mq->card) || mmc_access_rpmb(mq)))
-		return BLKPREP_KILL;
+	if (mmc_card_removed(mq->card) || mmc_access_rpmb(mq))
+		return false;
+
+	return true;
+}
+
+static struct request *__mmc_queue_fetch(struct mmc_queue *mq)
+{
+	struct request *req;
+
+	req = list_first_entry_or_null(&mq->pending, struct request,
+				       queuelist);
+	if (req)
+		list_del_init(&req->queuelist);
+
+	return req;
+}
+
+/**
+ * mmc_queue_fetch - take the next request to issue
+ * @mq: MMC queue
+ *
+ * Returns the oldest request started by blk-mq that the queue thread has
+ * not picked up yet, or NULL.
+ */
+struct request *mmc_queue_fetch(struct mmc_queue *mq)
+{
+	struct request *req;
+	unsigned long flags;
+
+	spin_lock_irqsave(mq->lock, flags);
+	req = __mmc_queue_fetch(mq);
+	spin_unlock_irqrestore(mq->lock, flags);
 
-	req->cmd_flags |= REQ_DONTPREP;
+	return req;
+}
 
-	return BLKPREP_OK;
+/**
+ * mmc_queue_requeue - give back a fetched request
+ * @mq: MMC queue
+ * @req: request to issue again
+ *
+ * The request goes to the head of the pending list, so requests given back
+ * in reverse order of fetching keep their order.
+ */
+void mmc_queue_requeue(struct mmc_queue *mq, struct request *req)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(mq->lock, flags);
+	list_add(&req->queuelist, &mq->pending);
+	spin_unlock_irqrestore(mq->lock, flags);
+}
+
+/**
+ * mmc_queue_end_request - complete bytes of a request
+ * @req: request
+ * @error: error code, or 0
+ * @nr_bytes: number of bytes to complete
+ *
+ * The blk-mq counterpart of blk_end_request(): returns true while the
+ * request still has bytes left.
+ */
+bool mmc_queue_end_request(struct request *req, int error,
+			   unsigned int nr_bytes)
+{
+	if (blk_update_request(req, error, nr_bytes))
+		return true;
+
+	__blk_mq_end_request(req, error);
+
+	return false;
 }
 
 static int mmc_queue_thread(void *d)
 {
 	struct mmc_queue *mq = d;
-	struct request_queue *q = mq->queue;
 
 	current->flags |= PF_MEMALLOC;
 
@@ -58,11 +138,11 @@ static int mmc_queue_thread(void *d)
 		struct request *req = NULL;
 		unsigned int cmd_flags = 0;
 
-		spin_lock_irq(q->queue_lock);
+		spin_lock_irq(mq->lock);
 		set_current_state(TASK_INTERRUPTIBLE);
-		req = blk_fetch_request(q);
+		req = __mmc_queue_fetch(mq);
 		mq->mqrq_cur->req = req;
-		spin_unlock_irq(q->queue_lock);
+		spin_unlock_irq(mq->lock);
 
 		if (req || mq->mqrq_prev->req) {
 			set_current_state(TASK_RUNNING);
@@ -103,24 +183,75 @@ static int mmc_queue_thread(void *d)
 }
 
 /*
- * Generic MMC request handler.  This is called for any queue on a
- * particular host.  When the host is not busy, we look for a request
- * on any queue on this host, and attempt to issue it.  This may
- * not be the queue we were asked to process.
+ * With command queuing the thread keeps up to cmdq_depth requests queued
+ * on the card. The issue function is called with a new request while a
+ * task is free, and with NULL to execute queued tasks otherwise.
  */
-static void mmc_request_fn(struct request_queue *q)
+static int mmc_cmdq_thread(void *d)
 {
-	struct mmc_queue *mq = q->queuedata;
-	struct request *req;
-	unsigned long flags;
+	struct mmc_queue *mq = d;
+
+	current->flags |= PF_MEMALLOC;
+
+	down(&mq->thread_sem);
+	do {
+		struct request *req = NULL;
+
+		spin_lock_irq(mq->lock);
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (hweight_long(mq->cmdq_queued) < mq->cmdq_depth)
+			req = __mmc_queue_fetch(mq);
+		spin_unlock_irq(mq->lock);
+
+		if (req || mq->cmdq_queued) {
+			set_current_state(TASK_RUNNING);
+			mq->issue_fn(mq, req);
+			cond_resched();
+		} else {
+			if (kthread_should_stop()) {
+				set_current_state(TASK_RUNNING);
+				break;
+			}
+			up(&mq->thread_sem);
+			schedule();
+			down(&mq->thread_sem);
+		}
+	} while (1);
+	up(&mq->thread_sem);
+
+	return 0;
+}
+
+/*
+ * blk-mq dispatch. Requests are handed to the queue thread of this card,
+ * which may be blocked on the previous request, so wake it the same way
+ * as a new request arriving during a transfer.
+ */
+static int mmc_queue_rq(struct blk_mq_hw_ctx *hctx,
+			const struct blk_mq_queue_data *bd)
+{
+	struct request *req = bd->rq;
+	struct mmc_queue *mq = req->q->queuedata;
 	struct mmc_context_info *cntx;
+	unsigned long flags;
 
 	if (!mq) {
-		while ((req = blk_fetch_request(q)) != NULL) {
-			req->cmd_flags |= REQ_QUIET;
-			__blk_end_request_all(req, -EIO);
-		}
-		return;
+		req->cmd_flags |= REQ_QUIET;
+		return BLK_MQ_RQ_QUEUE_ERROR;
+	}
+
+	if (!mmc_check_request(mq, req))
+		return BLK_MQ_RQ_QUEUE_ERROR;
+
+	blk_mq_start_request(req);
+
+	spin_lock_irqsave(mq->lock, flags);
+	list_add_tail(&req->queuelist, &mq->pending);
+	spin_unlock_irqrestore(mq->lock, flags);
+
+	if (mq->cmdq_depth) {
+		wake_up_process(mq->thread);
+		return BLK_MQ_RQ_QUEUE_OK;
 	}
 
 	cntx = &mq->card->host->context_info;
@@ -138,23 +269,46 @@ static void mmc_request_fn(struct request_queue *q)
 		spin_unlock_irqrestore(&cntx->lock, flags);
 	} else if (!mq->mqrq_cur->req && !mq->mqrq_prev->req)
 		wake_up_process(mq->thread);
+
+	return BLK_MQ_RQ_QUEUE_OK;
 }
 
-static struct scatterlist *mmc_alloc_sg(int sg_len, int *err)
+static int mmc_init_request(void *data, struct request *req,
+			    unsigned int hctx_idx, unsigned int request_idx,
+			    unsigned int numa_node)
 {
-	struct scatterlist *sg;
+	struct mmc_queue *mq = data;
+	struct mmc_queue_req *mqrq = req_to_mmc_queue_req(req);
+	int ret;
 
-	sg = kmalloc(sizeof(struct scatterlist)*sg_len, GFP_KERNEL);
-	if (!sg)
-		*err = -ENOMEM;
-	else {
-		*err = 0;
-		sg_init_table(sg, sg_len);
-	}
+	if (!mq->cmdq_depth)
+		return 0;
 
-	return sg;
+	mqrq->sg = mmc_alloc_sg(mq->card->host->max_segs, &ret);
+
+	return ret;
+}
+
+static void mmc_exit_request(void *data, struct request *req,
+			     unsigned int hctx_idx, unsigned int request_idx)
+{
+	struct mmc_queue *mq = data;
+	struct mmc_queue_req *mqrq = req_to_mmc_queue_req(req);
+
+	if (!mq->cmdq_depth)
+		return;
+
+	kfree(mqrq->sg);
+	mqrq->sg = NULL;
 }
 
+static struct blk_mq_ops mmc_mq_ops = {
+	.queue_rq	= mmc_queue_rq,
+	.map_queue	= blk_mq_map_queue,
+	.init_request	= mmc_init_request,
+	.exit_request	= mmc_exit_request,
+};
+
 static void mmc_queue_setup_discard(struct request_queue *q,
 				    struct mmc_card *card)
 {
@@ -182,11 +336,15 @@ static void mmc_queue_setup_discard(struct request_queue *q,
  * @card: mmc card to attach this queue
  * @lock: queue lock
  * @subname: partition subname
+ * @cmdq_depth: number of tasks to queue on the card, or 0
  *
- * Initialise a MMC card request queue.
+ * Initialise a MMC card request queue. With @cmdq_depth set, requests are
+ * issued through eMMC command queuing, and tagged so that the tag of a
+ * request is its task id.
  */
 int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
-		   spinlock_t *lock, const char *subname)
+		   spinlock_t *lock, const char *subname,
+		   unsigned int cmdq_depth)
 {
 	struct mmc_host *host = card->host;
 	u64 limit = BLK_BOUNCE_HIGH;
@@ -198,22 +356,40 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 		limit = (u64)dma_max_pfn(mmc_dev(host)) << PAGE_SHIFT;
 
 	mq->card = card;
-	mq->queue = blk_init_queue(mmc_request_fn, lock);
-	if (!mq->queue)
-		return -ENOMEM;
+	mq->lock = lock;
+	INIT_LIST_HEAD(&mq->pending);
+	mq->cmdq_depth = cmdq_depth;
+	mq->cmdq_queued = 0;
+
+	mq->tag_set.ops = &mmc_mq_ops;
+	mq->tag_set.nr_hw_queues = 1;
+	mq->tag_set.queue_depth = cmdq_depth ? cmdq_depth : MMC_QUEUE_DEPTH;
+	mq->tag_set.numa_node = NUMA_NO_NODE;
+	mq->tag_set.flags = BLK_MQ_F_SHOULD_MERGE;
+	mq->tag_set.cmd_size = cmdq_depth ? sizeof(struct mmc_queue_req) : 0;
+	mq->tag_set.driver_data = mq;
+
+	ret = blk_mq_alloc_tag_set(&mq->tag_set);
+	if (ret)
+		return ret;
+
+	mq->queue = blk_mq_init_queue(&mq->tag_set);
+	if (IS_ERR(mq->queue)) {
+		ret = PTR_ERR(mq->queue);
+		goto free_tag_set;
+	}
 
 	mq->mqrq_cur = mqrq_cur;
 	mq->mqrq_prev = mqrq_prev;
 	mq->queue->queuedata = mq;
 
-	blk_queue_prep_rq(mq->queue, mmc_prep_request);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
 	queue_flag_clear_unlocked(QUEUE_FLAG_ADD_RANDOM, mq->queue);
 	if (mmc_can_erase(card))
 		mmc_queue_setup_discard(mq->queue, card);
 
 #ifdef CONFIG_MMC_BLOCK_BOUNCE
-	if (host->max_segs == 1) {
+	if (host->max_segs == 1 && !cmdq_depth) {
 		unsigned int bouncesz;
 
 		bouncesz = MMC_QUEUE_BOUNCESZ;
@@ -275,6 +451,11 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 			min(host->max_blk_count, host->max_req_size / 512));
 		blk_queue_max_segments(mq->queue, host->max_segs);
 		blk_queue_max_segment_size(mq->queue, host->max_seg_size);
+		/* CMD44 carries the block count of a task in 16 bits */
+		if (cmdq_depth)
+			blk_queue_max_hw_sectors(mq->queue,
+				min_t(unsigned int, MMC_CMDQ_BLOCKS_MASK,
+				      queue_max_hw_sectors(mq->queue)));
 
 		mqrq_cur->sg = mmc_alloc_sg(host->max_segs, &ret);
 		if (ret)
@@ -288,8 +469,9 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 
 	sema_init(&mq->thread_sem, 1);
 
-	mq->thread = kthread_run(mmc_queue_thread, mq, "mmcqd/%d%s",
-		host->index, subname ? subname : "");
+	mq->thread = kthread_run(cmdq_depth ? mmc_cmdq_thread :
+				 mmc_queue_thread, mq, "mmcqd/%d%s",
+				 host->index, subname ? subname : "");
 
 	if (IS_ERR(mq->thread)) {
 		ret = PTR_ERR(mq->thread);
@@ -315,6 +497,8 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 	mqrq_prev->bounce_buf = NULL;
 
 	blk_cleanup_queue(mq->queue);
+ free_tag_set:
+	blk_mq_free_tag_set(&mq->tag_set);
 	return ret;
 }
 
@@ -324,6 +508,8 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	unsigned long flags;
 	struct mmc_queue_req *mqrq_cur = mq->mqrq_cur;
 	struct mmc_queue_req *mqrq_prev = mq->mqrq_prev;
+	struct request *req;
+	LIST_HEAD(pending);
 
 	/* Make sure the queue isn't suspended, as that will deadlock */
 	mmc_queue_resume(mq);
@@ -332,10 +518,17 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	kthread_stop(mq->thread);
 
 	/* Empty the queue */
-	spin_lock_irqsave(q->queue_lock, flags);
+	spin_lock_irqsave(mq->lock, flags);
 	q->queuedata = NULL;
-	blk_start_queue(q);
-	spin_unlock_irqrestore(q->queue_lock, flags);
+	list_splice_init(&mq->pending, &pending);
+	spin_unlock_irqrestore(mq->lock, flags);
+
+	while (!list_empty(&pending)) {
+		req = list_entry_rq(pending.next);
+		list_del_init(&req->queuelist);
+		req->cmd_flags |= REQ_QUIET;
+		blk_mq_end_request(req, -EIO);
+	}
 
 	kfree(mqrq_cur->bounce_sg);
 	mqrq_cur->bounce_sg = NULL;
@@ -413,14 +606,11 @@ void mmc_packed_clean(struct mmc_queue *mq)
 void mmc_queue_suspend(struct mmc_queue *mq)
 {
 	struct request_queue *q = mq->queue;
-	unsigned long flags;
 
 	if (!(mq->flags & MMC_QUEUE_SUSPENDED)) {
 		mq->flags |= MMC_QUEUE_SUSPENDED;
 
-		spin_lock_irqsave(q->queue_lock, flags);
-		blk_stop_queue(q);
-		spin_unlock_irqrestore(q->queue_lock, flags);
+		blk_mq_stop_hw_queues(q);
 
 		down(&mq->thread_sem);
 	}
@@ -433,16 +623,13 @@ void mmc_queue_suspend(struct mmc_queue *mq)
 void mmc_queue_resume(struct mmc_queue *mq)
 {
 	struct request_queue *q = mq->queue;
-	unsigned long flags;
 
 	if (mq->flags & MMC_QUEUE_SUSPENDED) {
 		mq->flags &= ~MMC_QUEUE_SUSPENDED;
 
 		up(&mq->thread_sem);
 
-		spin_lock_irqsave(q->queue_lock, flags);
-		blk_start_queue(q);
-		spin_unlock_irqrestore(q->queue_lock, flags);
+		blk_mq_start_stopped_hw_queues(q, true);
 	}
 }
 
@@ -1,6 +1,8 @@
 #ifndef MMC_QUEUE_H
 #define MMC_QUEUE_H
 
+#include <linux/blk-mq.h>
+
 #define MMC_REQ_SPECIAL_MASK	(REQ_DISCARD | REQ_FLUSH)
 
 struct request;
@@ -55,17 +57,38 @@ struct mmc_queue {
 	int			(*issue_fn)(struct mmc_queue *, struct request *);
 	void			*data;
 	struct request_queue	*queue;
+	struct blk_mq_tag_set	tag_set;
+	/* requests started by blk-mq, waiting for the queue thread */
+	spinlock_t		*lock;
+	struct list_head	pending;
 	struct mmc_queue_req	mqrq[2];
 	struct mmc_queue_req	*mqrq_cur;
 	struct mmc_queue_req	*mqrq_prev;
+	/*
+	 * With command queuing each request carries its own mmc_queue_req
+	 * and is queued on the card as the task numbered by its tag.
+	 */
+	unsigned int		cmdq_depth;
+	unsigned long		cmdq_queued;	/* tasks queued on the card */
 };
 
+#define MMC_QUEUE_DEPTH		64
+
+static inline struct mmc_queue_req *req_to_mmc_queue_req(struct request *rq)
+{
+	return blk_mq_rq_to_pdu(rq);
+}
+
 extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *,
-			  const char *);
+			  const char *, unsigned int);
 extern void mmc_cleanup_queue(struct mmc_queue *);
 extern void mmc_queue_suspend(struct mmc_queue *);
 extern void mmc_queue_resume(struct mmc_queue *);
 
+extern struct request *mmc_queue_fetch(struct mmc_queue *);
+extern void mmc_queue_requeue(struct mmc_queue *, struct request *);
+extern bool mmc_queue_end_request(struct request *, int, unsigned int);
+
 extern unsigned int mmc_queue_map_sg(struct mmc_queue *,
 				     struct mmc_queue_req *);
 extern void mmc_queue_bounce_pre(struct mmc_queue_req *);
@@ -586,6 +586,14 @@ static int mmc_decode_ext_csd(struct mmc_card *card, u8 *ext_csd)
 			(ext_csd[EXT_CSD_SUPPORTED_MODE] & 0x1) &&
 			!(ext_csd[EXT_CSD_FW_CONFIG] & 0x1);
 	}
+
+	/* eMMC v5.1 or later */
+	if (card->ext_csd.rev >= 8) {
+		card->ext_csd.cmdq_support = ext_csd[EXT_CSD_CMDQ_SUPPORT] &
+					     EXT_CSD_CMDQ_SUPPORTED;
+		card->ext_csd.cmdq_depth = (ext_csd[EXT_CSD_CMDQ_DEPTH] &
+					    EXT_CSD_CMDQ_DEPTH_MASK) + 1;
+	}
 out:
 	return err;
 }
@@ -1338,6 +1346,10 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 	 */
 	mmc_go_idle(host);
 
+	/* the reset leaves command queuing disabled */
+	if (oldcard)
+		oldcard->ext_csd.cmdq_en = false;
+
 	/* The extra bit indicates that we support high capacity */
 	err = mmc_send_op_cond(host, ocr | (1 << 30), &rocr);
 	if (err)
@@ -1610,6 +1622,22 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 		}
 	}
 
+	/*
+	 * Command queuing is switched on by the block driver, bring it
+	 * back after the card has been reinitialised.
+	 */
+	if (card->reenable_cmdq && !card->ext_csd.cmdq_en) {
+		err = mmc_cmdq_enable(card);
+		if (err && err != -EBADMSG)
+			goto free_card;
+		if (err) {
+			pr_warn("%s: Enabling CMDQ failed\n",
+				mmc_hostname(card->host));
+			card->reenable_cmdq = false;
+			err = 0;
+		}
+	}
+
 	if (!oldcard)
 		host->card = card;
 
@@ -1778,6 +1806,12 @@ static int _mmc_suspend(struct mmc_host *host, bool is_suspend)
 	if (err)
 		goto out;
 
+	if (host->card->ext_csd.cmdq_en) {
+		err = mmc_cmdq_disable(host->card);
+		if (err)
+			goto out;
+	}
+
 	if (mmc_can_poweroff_notify(host->card) &&
 		((host->caps2 & MMC_CAP2_FULL_PWR_CYCLE) || !is_suspend))
 		err = mmc_poweroff_notify(host->card, notify_type);
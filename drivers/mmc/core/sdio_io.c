@@ -352,6 +352,66 @@ static int sdio_io_rw_ext_helper(struct sdio_func *func, int write,
 	return 0;
 }
 
+/**
+ *	sdio_prep_async_req - set up a block mode transfer for a SDIO function
+ *	@func: SDIO function to access
+ *	@req: request to set up
+ *	@write: non-zero to write to the function, zero to read from it
+ *	@addr: address to start the transfer at
+ *	@incr_addr: non-zero to increment the address over the transfer
+ *	@sg: scatterlist holding the data
+ *	@sg_len: number of entries in @sg
+ *	@blocks: number of blocks of the current block size to transfer
+ *
+ *	Sets up a single IO_RW_EXTENDED command for sdio_start_async_req().
+ *	The caller keeps @req and @sg alive until the request has completed,
+ *	and may reuse it afterwards. The block count is limited to what the
+ *	host and the command can do, see sdio_align_size().
+ */
+int sdio_prep_async_req(struct sdio_func *func, struct sdio_async_req *req,
+	int write, unsigned int addr, int incr_addr, struct scatterlist *sg,
+	unsigned int sg_len, unsigned int blocks)
+{
+	BUG_ON(!func);
+
+	if (!func->card->cccr.multi_block || !blocks ||
+	    blocks > min(func->card->host->max_blk_count, 511u))
+		return -EINVAL;
+
+	return mmc_io_rw_extended_async(func->card, req, write, func->num,
+		addr, incr_addr, sg, sg_len, blocks, func->cur_blksize);
+}
+EXPORT_SYMBOL_GPL(sdio_prep_async_req);
+
+/**
+ *	sdio_start_async_req - start a transfer without waiting for it
+ *	@func: SDIO function to access
+ *	@req: request set up by sdio_prep_async_req(), or NULL
+ *	@err_ret: status of the completed request
+ *
+ *	Waits for the request started by the previous call, if any, and
+ *	starts @req. The host prepares @req, typically mapping it for DMA,
+ *	while the previous request is still on the bus, and unmaps that one
+ *	after @req has been started. Call with a NULL @req to wait for the
+ *	last request.
+ *
+ *	Returns the completed request, NULL if none was running. If it
+ *	failed, @err_ret holds the error and @req is not started.
+ */
+struct sdio_async_req *sdio_start_async_req(struct sdio_func *func,
+	struct sdio_async_req *req, int *err_ret)
+{
+	struct mmc_async_req *done;
+
+	BUG_ON(!func);
+
+	done = mmc_start_req(func->card->host, req ? &req->areq : NULL,
+			     err_ret);
+
+	return done ? container_of(done, struct sdio_async_req, areq) : NULL;
+}
+EXPORT_SYMBOL_GPL(sdio_start_async_req);
+
 /**
  *	sdio_readb - read a single byte from a SDIO function
  *	@func: SDIO function to access
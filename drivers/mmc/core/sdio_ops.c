@@ -15,6 +15,7 @@
 #include <linux/mmc/card.h>
 #include <linux/mmc/mmc.h>
 #include <linux/mmc/sdio.h>
+#include <linux/mmc/sdio_func.h>
 
 #include "core.h"
 #include "sdio_ops.h"
@@ -118,6 +119,49 @@ int mmc_io_rw_direct(struct mmc_card *card, int write, unsigned fn,
 	return mmc_io_rw_direct_host(card->host, write, fn, addr, in, out);
 }
 
+static void mmc_io_rw_extended_prep(struct mmc_command *cmd,
+	struct mmc_data *data, int write, unsigned fn, unsigned addr,
+	int incr_addr, unsigned blocks, unsigned blksz)
+{
+	cmd->opcode = SD_IO_RW_EXTENDED;
+	cmd->arg = write ? 0x80000000 : 0x00000000;
+	cmd->arg |= fn << 28;
+	cmd->arg |= incr_addr ? 0x04000000 : 0x00000000;
+	cmd->arg |= addr << 9;
+	if (blocks == 0)
+		cmd->arg |= (blksz == 512) ? 0 : blksz;	/* byte mode */
+	else
+		cmd->arg |= 0x08000000 | blocks;	/* block mode */
+	cmd->flags = MMC_RSP_SPI_R5 | MMC_RSP_R5 | MMC_CMD_ADTC;
+
+	data->blksz = blksz;
+	/* Code in host drivers/fwk assumes that "blocks" always is >=1 */
+	data->blocks = blocks ? blocks : 1;
+	data->flags = write ? MMC_DATA_WRITE : MMC_DATA_READ;
+}
+
+static int mmc_io_rw_extended_status(struct mmc_card *card,
+	struct mmc_command *cmd, struct mmc_data *data)
+{
+	if (cmd->error)
+		return cmd->error;
+	if (data->error)
+		return data->error;
+
+	if (mmc_host_is_spi(card->host)) {
+		/* host driver already reported errors */
+	} else {
+		if (cmd->resp[0] & R5_ERROR)
+			return -EIO;
+		if (cmd->resp[0] & R5_FUNCTION_NUMBER)
+			return -EINVAL;
+		if (cmd->resp[0] & R5_OUT_OF_RANGE)
+			return -ERANGE;
+	}
+
+	return 0;
+}
+
 int mmc_io_rw_extended(struct mmc_card *card, int write, unsigned fn,
 	unsigned addr, int incr_addr, u8 *buf, unsigned blocks, unsigned blksz)
 {
@@ -140,21 +184,8 @@ int mmc_io_rw_extended(struct mmc_card *card, int write, unsigned fn,
 	mrq.cmd = &cmd;
 	mrq.data = &data;
 
-	cmd.opcode = SD_IO_RW_EXTENDED;
-	cmd.arg = write ? 0x80000000 : 0x00000000;
-	cmd.arg |= fn << 28;
-	cmd.arg |= incr_addr ? 0x04000000 : 0x00000000;
-	cmd.arg |= addr << 9;
-	if (blocks == 0)
-		cmd.arg |= (blksz == 512) ? 0 : blksz;	/* byte mode */
-	else
-		cmd.arg |= 0x08000000 | blocks;		/* block mode */
-	cmd.flags = MMC_RSP_SPI_R5 | MMC_RSP_R5 | MMC_CMD_ADTC;
-
-	data.blksz = blksz;
-	/* Code in host drivers/fwk assumes that "blocks" always is >=1 */
-	data.blocks = blocks ? blocks : 1;
-	data.flags = write ? MMC_DATA_WRITE : MMC_DATA_READ;
+	mmc_io_rw_extended_prep(&cmd, &data, write, fn, addr, incr_addr,
+				blocks, blksz);
 
 	left_size = data.blksz * data.blocks;
 	nents = (left_size - 1) / seg_size + 1;
@@ -185,21 +216,53 @@ int mmc_io_rw_extended(struct mmc_card *card, int write, unsigned fn,
 	if (nents > 1)
 		sg_free_table(&sgtable);
 
-	if (cmd.error)
-		return cmd.error;
-	if (data.error)
-		return data.error;
+	return mmc_io_rw_extended_status(card, &cmd, &data);
+}
 
-	if (mmc_host_is_spi(card->host)) {
-		/* host driver already reported errors */
-	} else {
-		if (cmd.resp[0] & R5_ERROR)
-			return -EIO;
-		if (cmd.resp[0] & R5_FUNCTION_NUMBER)
-			return -EINVAL;
-		if (cmd.resp[0] & R5_OUT_OF_RANGE)
-			return -ERANGE;
-	}
+static int mmc_io_rw_extended_err_check(struct mmc_card *card,
+					struct mmc_async_req *areq)
+{
+	struct sdio_async_req *req =
+		container_of(areq, struct sdio_async_req, areq);
+
+	return mmc_io_rw_extended_status(card, &req->cmd, &req->data);
+}
+
+/*
+ * Set up an IO_RW_EXTENDED request on a scatterlist of the caller, to be
+ * started with mmc_start_req(). Unlike mmc_io_rw_extended(),
+ * this doesn't allocate anything, so the request can be prepared ahead
+ * of time and reused.
+ */
+int mmc_io_rw_extended_async(struct mmc_card *card, struct sdio_async_req *req,
+	int write, unsigned fn, unsigned addr, int incr_addr,
+	struct scatterlist *sg, unsigned sg_len, unsigned blocks,
+	unsigned blksz)
+{
+	BUG_ON(!card);
+	BUG_ON(fn > 7);
+	WARN_ON(blksz == 0);
+
+	/* sanity check */
+	if (addr & ~0x1FFFF)
+		return -EINVAL;
+
+	memset(&req->mrq, 0, sizeof(req->mrq));
+	memset(&req->cmd, 0, sizeof(req->cmd));
+	memset(&req->data, 0, sizeof(req->data));
+
+	req->mrq.cmd = &req->cmd;
+	req->mrq.data = &req->data;
+
+	mmc_io_rw_extended_prep(&req->cmd, &req->data, write, fn, addr,
+				incr_addr, blocks, blksz);
+
+	req->data.sg = sg;
+	req->data.sg_len = sg_len;
+	mmc_set_data_timeout(&req->data, card);
+
+	req->areq.mrq = &req->mrq;
+	req->areq.err_check = mmc_io_rw_extended_err_check;
 
 	return 0;
 }
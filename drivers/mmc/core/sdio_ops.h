@@ -12,11 +12,18 @@
 #ifndef _MMC_SDIO_OPS_H
 #define _MMC_SDIO_OPS_H
 
+struct sdio_async_req;
+struct scatterlist;
+
 int mmc_send_io_op_cond(struct mmc_host *host, u32 ocr, u32 *rocr);
 int mmc_io_rw_direct(struct mmc_card *card, int write, unsigned fn,
 	unsigned addr, u8 in, u8* out);
 int mmc_io_rw_extended(struct mmc_card *card, int write, unsigned fn,
 	unsigned addr, int incr_addr, u8 *buf, unsigned blocks, unsigned blksz);
+int mmc_io_rw_extended_async(struct mmc_card *card, struct sdio_async_req *req,
+	int write, unsigned fn, unsigned addr, int incr_addr,
+	struct scatterlist *sg, unsigned sg_len, unsigned blocks,
+	unsigned blksz);
 int sdio_reset(struct mmc_host *host);
 
 #endif
@@ -72,6 +72,8 @@ enum {
 
 #define EMAC_BUFFER_SIZE	1536		/* EMAC buffer size */
 
+#define ARC_EMAC_RX_COPYBREAK	256		/* Copy frames up to this size */
+
 /**
  * struct arc_emac_bd - EMAC buffer descriptor (BD).
  *
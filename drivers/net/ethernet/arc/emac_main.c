@@ -149,11 +149,13 @@ static const struct ethtool_ops arc_emac_ethtool_ops = {
 /**
  * arc_emac_tx_clean - clears processed by EMAC Tx BDs.
  * @ndev:	Pointer to the network device.
+ * @budget:	NAPI budget of the caller.
  */
-static void arc_emac_tx_clean(struct net_device *ndev)
+static void arc_emac_tx_clean(struct net_device *ndev, int budget)
 {
 	struct arc_emac_priv *priv = netdev_priv(ndev);
 	struct net_device_stats *stats = &ndev->stats;
+	unsigned int pkts_compl = 0, bytes_compl = 0;
 	unsigned int i;
 
 	for (i = 0; i < TX_BD_NUM; i++) {
@@ -178,16 +180,21 @@ static void arc_emac_tx_clean(struct net_device *ndev)
 
 			if (info & UFLO)
 				stats->tx_fifo_errors++;
-		} else if (likely(info & FIRST_OR_LAST_MASK)) {
+		} else if (skb) {
 			stats->tx_packets++;
 			stats->tx_bytes += skb->len;
 		}
 
-		dma_unmap_single(&ndev->dev, dma_unmap_addr(tx_buff, addr),
-				 dma_unmap_len(tx_buff, len), DMA_TO_DEVICE);
+		dma_unmap_page(&ndev->dev, dma_unmap_addr(tx_buff, addr),
+			       dma_unmap_len(tx_buff, len), DMA_TO_DEVICE);
 
-		/* return the sk_buff to system */
-		dev_kfree_skb_irq(skb);
+		/* return the sk_buff to system, it is kept on the last BD */
+		if (skb) {
+			pkts_compl++;
+			bytes_compl += skb->len;
+			napi_consume_skb(skb, budget);
+			tx_buff->skb = NULL;
+		}
 
 		txbd->data = 0;
 		txbd->info = 0;
@@ -195,12 +202,15 @@ static void arc_emac_tx_clean(struct net_device *ndev)
 		*txbd_dirty = (*txbd_dirty + 1) % TX_BD_NUM;
 	}
 
+	netdev_completed_queue(ndev, pkts_compl, bytes_compl);
+
 	/* Ensure that txbd_dirty is visible to tx() before checking
 	 * for queue stopped.
 	 */
 	smp_mb();
 
-	if (netif_queue_stopped(ndev) && arc_emac_tx_avail(priv))
+	if (netif_queue_stopped(ndev) &&
+	    arc_emac_tx_avail(priv) > MAX_SKB_FRAGS)
 		netif_wake_queue(ndev);
 }
 
@@ -253,6 +263,32 @@ static int arc_emac_rx(struct net_device *ndev, int budget)
 		pktlen = info & LEN_MASK;
 		stats->rx_packets++;
 		stats->rx_bytes += pktlen;
+
+		/* Small frames are copied, the buffer stays mapped */
+		if (pktlen <= ARC_EMAC_RX_COPYBREAK) {
+			addr = dma_unmap_addr(rx_buff, addr);
+
+			skb = napi_alloc_skb(&priv->napi, pktlen);
+			if (unlikely(!skb)) {
+				stats->rx_errors++;
+				stats->rx_dropped++;
+			} else {
+				dma_sync_single_for_cpu(&ndev->dev, addr, pktlen,
+							DMA_FROM_DEVICE);
+				memcpy(skb_put(skb, pktlen), rx_buff->skb->data,
+				       pktlen);
+				dma_sync_single_for_device(&ndev->dev, addr,
+							   pktlen,
+							   DMA_FROM_DEVICE);
+				skb->protocol = eth_type_trans(skb, ndev);
+				napi_gro_receive(&priv->napi, skb);
+			}
+
+			/* Return ownership to EMAC */
+			rxbd->info = cpu_to_le32(FOR_EMAC | EMAC_BUFFER_SIZE);
+			continue;
+		}
+
 		skb = rx_buff->skb;
 		skb_put(skb, pktlen);
 		skb->dev = ndev;
@@ -272,7 +308,7 @@ static int arc_emac_rx(struct net_device *ndev, int budget)
 		}
 
 		/* receive_skb only if new skb was allocated to avoid holes */
-		netif_receive_skb(skb);
+		napi_gro_receive(&priv->napi, skb);
 
 		addr = dma_map_single(&ndev->dev, (void *)rx_buff->skb->data,
 				      EMAC_BUFFER_SIZE, DMA_FROM_DEVICE);
@@ -311,7 +347,7 @@ static int arc_emac_poll(struct napi_struct *napi, int budget)
 	struct arc_emac_priv *priv = netdev_priv(ndev);
 	unsigned int work_done;
 
-	arc_emac_tx_clean(ndev);
+	arc_emac_tx_clean(ndev, budget);
 
 	work_done = arc_emac_rx(ndev, budget);
 	if (work_done < budget) {
@@ -448,6 +484,9 @@ static int arc_emac_open(struct net_device *ndev)
 
 	/* Clean Tx BD's */
 	memset(priv->txbd, 0, TX_RING_SZ);
+	priv->txbd_curr = 0;
+	priv->txbd_dirty = 0;
+	netdev_reset_queue(ndev);
 
 	/* Initialize logical address filter */
 	arc_reg_set(priv, R_LAFL, 0);
@@ -583,45 +622,83 @@ static int arc_emac_tx(struct sk_buff *skb, struct net_device *ndev)
 {
 	struct arc_emac_priv *priv = netdev_priv(ndev);
 	unsigned int len, *txbd_curr = &priv->txbd_curr;
+	unsigned int first = *txbd_curr, curr = first;
 	struct net_device_stats *stats = &ndev->stats;
-	__le32 *info = &priv->txbd[*txbd_curr].info;
+	unsigned int nr_frags, first_info = 0, i;
+	bool kick = !skb->xmit_more;
 	dma_addr_t addr;
 
 	if (skb_padto(skb, ETH_ZLEN))
 		return NETDEV_TX_OK;
 
-	len = max_t(unsigned int, ETH_ZLEN, skb->len);
+	nr_frags = skb_shinfo(skb)->nr_frags;
 
-	if (unlikely(!arc_emac_tx_avail(priv))) {
+	if (unlikely(arc_emac_tx_avail(priv) <= nr_frags)) {
 		netif_stop_queue(ndev);
 		netdev_err(ndev, "BUG! Tx Ring full when queue awake!\n");
 		return NETDEV_TX_BUSY;
 	}
 
-	addr = dma_map_single(&ndev->dev, (void *)skb->data, len,
-			      DMA_TO_DEVICE);
+	/* One BD for the linear part and one per fragment. The buffers are
+	 * all mapped as pages so that tx_clean() can unmap them alike.
+	 */
+	for (i = 0; i <= nr_frags; i++) {
+		unsigned int info = 0;
+
+		if (i == 0) {
+			len = skb_headlen(skb);
+			if (!nr_frags)
+				len = max_t(unsigned int, ETH_ZLEN, len);
+			addr = dma_map_page(&ndev->dev,
+					    virt_to_page(skb->data),
+					    offset_in_page(skb->data), len,
+					    DMA_TO_DEVICE);
+			info |= FIRST_MASK;
+		} else {
+			const skb_frag_t *frag = &skb_shinfo(skb)->frags[i - 1];
 
-	if (unlikely(dma_mapping_error(&ndev->dev, addr))) {
-		stats->tx_dropped++;
-		stats->tx_errors++;
-		dev_kfree_skb(skb);
-		return NETDEV_TX_OK;
-	}
-	dma_unmap_addr_set(&priv->tx_buff[*txbd_curr], addr, addr);
-	dma_unmap_len_set(&priv->tx_buff[*txbd_curr], len, len);
+			len = skb_frag_size(frag);
+			addr = skb_frag_dma_map(&ndev->dev, frag, 0, len,
+						DMA_TO_DEVICE);
+		}
 
-	priv->tx_buff[*txbd_curr].skb = skb;
-	priv->txbd[*txbd_curr].data = cpu_to_le32(addr);
+		if (unlikely(dma_mapping_error(&ndev->dev, addr)))
+			goto out_unmap;
 
-	/* Make sure pointer to data buffer is set */
+		dma_unmap_addr_set(&priv->tx_buff[curr], addr, addr);
+		dma_unmap_len_set(&priv->tx_buff[curr], len, len);
+		priv->tx_buff[curr].skb = NULL;
+		priv->txbd[curr].data = cpu_to_le32(addr);
+
+		if (i == nr_frags) {
+			info |= LAST_MASK;
+			priv->tx_buff[curr].skb = skb;
+		}
+
+		if (i == 0) {
+			first_info = info | len;
+		} else {
+			/* Make sure pointer to data buffer is set */
+			wmb();
+			priv->txbd[curr].info = cpu_to_le32(FOR_EMAC | info |
+							    len);
+		}
+
+		curr = (curr + 1) % TX_BD_NUM;
+	}
+
+	/* Make sure the chain is set up before handing over the first BD */
 	wmb();
 
 	skb_tx_timestamp(skb);
 
-	*info = cpu_to_le32(FOR_EMAC | FIRST_OR_LAST_MASK | len);
+	/* Account before the hand over, tx_clean() may free the skb */
+	netdev_sent_queue(ndev, skb->len);
+
+	priv->txbd[first].info = cpu_to_le32(FOR_EMAC | first_info);
 
 	/* Increment index to point to the next BD */
-	*txbd_curr = (*txbd_curr + 1) % TX_BD_NUM;
+	*txbd_curr = curr;
 
 	/* Ensure that tx_clean() sees the new txbd_curr before
 	 * checking the queue status. This prevents an unneeded wake
@@ -629,17 +706,37 @@ static int arc_emac_tx(struct sk_buff *skb, struct net_device *ndev)
 	 */
 	smp_mb();
 
-	if (!arc_emac_tx_avail(priv)) {
+	if (arc_emac_tx_avail(priv) <= MAX_SKB_FRAGS) {
 		netif_stop_queue(ndev);
 		/* Refresh tx_dirty */
 		smp_mb();
-		if (arc_emac_tx_avail(priv))
+		if (arc_emac_tx_avail(priv) > MAX_SKB_FRAGS)
 			netif_start_queue(ndev);
 	}
 
-	arc_reg_set(priv, R_STATUS, TXPL_MASK);
+	/* Kick the EMAC only for the last frame of a burst */
+	if (kick || netif_xmit_stopped(netdev_get_tx_queue(ndev, 0)))
+		arc_reg_set(priv, R_STATUS, TXPL_MASK);
 
 	return NETDEV_TX_OK;
+
+out_unmap:
+	while (curr != first) {
+		curr = (curr + TX_BD_NUM - 1) % TX_BD_NUM;
+		dma_unmap_page(&ndev->dev,
+			       dma_unmap_addr(&priv->tx_buff[curr], addr),
+			       dma_unmap_len(&priv->tx_buff[curr], len),
+			       DMA_TO_DEVICE);
+		priv->tx_buff[curr].skb = NULL;
+		priv->txbd[curr].info = 0;
+		priv->txbd[curr].data = 0;
+	}
+	/* frames deferred by xmit_more still need their poll */
+	arc_reg_set(priv, R_STATUS, TXPL_MASK);
+	stats->tx_dropped++;
+	stats->tx_errors++;
+	dev_kfree_skb(skb);
+	return NETDEV_TX_OK;
 }
 
 static void arc_emac_set_address_internal(struct net_device *ndev)
@@ -827,6 +924,10 @@ int arc_emac_probe(struct net_device *ndev, int interface)
 	dev_info(dev, "connected to %s phy with id 0x%x\n",
 		 priv->phy_dev->drv->name, priv->phy_dev->phy_id);
 
+	/* No checksum offload, but fragments can be sent as a BD chain */
+	ndev->hw_features = NETIF_F_SG;
+	ndev->features |= ndev->hw_features;
+
 	netif_napi_add(ndev, &priv->napi, arc_emac_poll, ARC_EMAC_NAPI_WEIGHT);
 
 	err = register_netdev(ndev);
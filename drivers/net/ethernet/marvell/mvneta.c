@@ -1532,7 +1532,8 @@ static int mvneta_rx(struct mvneta_port *pp, int rx_todo,
 			goto err_drop_frame;
 		}
 
-		skb = build_skb(data, pp->frag_size > PAGE_SIZE ? 0 : pp->frag_size);
+		skb = napi_build_skb(data, pp->frag_size > PAGE_SIZE ?
+					   0 : pp->frag_size);
 		if (!skb)
 			goto err_drop_frame;
 
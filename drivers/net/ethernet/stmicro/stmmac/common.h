@@ -205,6 +205,10 @@ struct stmmac_extra_stats {
 #define STMMAC_MAX_COAL_TX_TICK	100000
 #define STMMAC_TX_MAX_FRAMES	256
 #define STMMAC_TX_FRAMES	64
+/* Adaptive coalesce defaults, rates in frames per second */
+#define STMMAC_COAL_SAMPLE_MS	50
+#define STMMAC_COAL_RATE_LOW	10000
+#define STMMAC_COAL_RATE_HIGH	60000
 
 /* Rx IPC status */
 enum rx_frame_status {
@@ -413,7 +417,8 @@ struct stmmac_ops {
 /* PTP and HW Timer helpers */
 struct stmmac_hwtimestamp {
 	void (*config_hw_tstamping) (void __iomem *ioaddr, u32 data);
-	void (*config_sub_second_increment) (void __iomem *ioaddr);
+	u32 (*config_sub_second_increment) (void __iomem *ioaddr,
+					    u32 ptp_clock);
 	int (*init_systime) (void __iomem *ioaddr, u32 sec, u32 nsec);
 	int (*config_addend) (void __iomem *ioaddr, u32 addend);
 	int (*adjust_systime) (void __iomem *ioaddr, u32 sec, u32 nsec,
@@ -47,6 +47,13 @@ struct stmmac_tx_info {
 	bool map_as_page;
 };
 
+/* Half-page RX buffer, kept DMA mapped while it is recycled */
+struct stmmac_rx_page {
+	struct page *page;
+	dma_addr_t dma;
+	unsigned int offset;
+};
+
 struct stmmac_priv {
 	/* Frequently used values are kept adjacent for cache effect */
 	struct dma_extended_desc *dma_etx ____cacheline_aligned_in_smp;
@@ -74,9 +81,23 @@ struct stmmac_priv {
 	unsigned int dma_rx_size;
 	unsigned int dma_buf_sz;
 	u32 rx_riwt;
+	bool rx_coal_adaptive;
+	bool tx_coal_adaptive;
+	u32 coal_rate_low;
+	u32 coal_rate_high;
+	u32 rx_riwt_low;
+	u32 rx_riwt_high;
+	u32 tx_coal_frames_low;
+	u32 tx_coal_frames_high;
+	u32 coal_rx_frames;
+	u32 coal_tx_frames;
+	unsigned long coal_stamp;
 	int hwts_rx_en;
 	dma_addr_t *rx_skbuff_dma;
 	dma_addr_t dma_rx_phy;
+	struct stmmac_rx_page *rx_page;
+	bool rx_page_mode;
+	struct bpf_prog __rcu *xdp_prog;
 
 	struct napi_struct napi ____cacheline_aligned_in_smp;
 
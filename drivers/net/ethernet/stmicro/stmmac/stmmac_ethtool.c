@@ -663,8 +663,20 @@ static int stmmac_get_coalesce(struct net_device *dev,
 	ec->tx_coalesce_usecs = priv->tx_coal_timer;
 	ec->tx_max_coalesced_frames = priv->tx_coal_frames;
 
-	if (priv->use_riwt)
+	if (priv->use_riwt) {
 		ec->rx_coalesce_usecs = stmmac_riwt2usec(priv->rx_riwt, priv);
+		ec->rx_coalesce_usecs_low =
+			stmmac_riwt2usec(priv->rx_riwt_low, priv);
+		ec->rx_coalesce_usecs_high =
+			stmmac_riwt2usec(priv->rx_riwt_high, priv);
+	}
+
+	ec->use_adaptive_rx_coalesce = priv->rx_coal_adaptive;
+	ec->use_adaptive_tx_coalesce = priv->tx_coal_adaptive;
+	ec->pkt_rate_low = priv->coal_rate_low;
+	ec->pkt_rate_high = priv->coal_rate_high;
+	ec->tx_max_coalesced_frames_low = priv->tx_coal_frames_low;
+	ec->tx_max_coalesced_frames_high = priv->tx_coal_frames_high;
 
 	return 0;
 }
@@ -673,22 +685,30 @@ static int stmmac_set_coalesce(struct net_device *dev,
 			       struct ethtool_coalesce *ec)
 {
 	struct stmmac_priv *priv = netdev_priv(dev);
-	unsigned int rx_riwt;
+	unsigned int rx_riwt, rx_riwt_low, rx_riwt_high;
 
 	/* Check not supported parameters  */
 	if ((ec->rx_max_coalesced_frames) || (ec->rx_coalesce_usecs_irq) ||
 	    (ec->rx_max_coalesced_frames_irq) || (ec->tx_coalesce_usecs_irq) ||
-	    (ec->use_adaptive_rx_coalesce) || (ec->use_adaptive_tx_coalesce) ||
-	    (ec->pkt_rate_low) || (ec->rx_coalesce_usecs_low) ||
 	    (ec->rx_max_coalesced_frames_low) || (ec->tx_coalesce_usecs_high) ||
-	    (ec->tx_max_coalesced_frames_low) || (ec->pkt_rate_high) ||
-	    (ec->tx_coalesce_usecs_low) || (ec->rx_coalesce_usecs_high) ||
+	    (ec->tx_coalesce_usecs_low) ||
 	    (ec->rx_max_coalesced_frames_high) ||
 	    (ec->tx_max_coalesced_frames_irq) ||
-	    (ec->stats_block_coalesce_usecs) ||
-	    (ec->tx_max_coalesced_frames_high) || (ec->rate_sample_interval))
+	    (ec->stats_block_coalesce_usecs) || (ec->rate_sample_interval))
+		return -EOPNOTSUPP;
+
+	if (ec->use_adaptive_rx_coalesce && !priv->use_riwt)
 		return -EOPNOTSUPP;
 
+	if (ec->pkt_rate_low >= ec->pkt_rate_high)
+		return -EINVAL;
+
+	if ((ec->tx_max_coalesced_frames_low == 0) ||
+	    (ec->tx_max_coalesced_frames_low >
+	     ec->tx_max_coalesced_frames_high) ||
+	    (ec->tx_max_coalesced_frames_high > STMMAC_TX_MAX_FRAMES))
+		return -EINVAL;
+
 	if (ec->rx_coalesce_usecs == 0)
 		return -EINVAL;
 
@@ -707,12 +727,31 @@ static int stmmac_set_coalesce(struct net_device *dev,
 	else if (!priv->use_riwt)
 		return -EOPNOTSUPP;
 
+	/* usec to riwt and back is lossy, so clamp the adaptive bounds */
+	rx_riwt_low = clamp_t(u32, stmmac_usec2riwt(ec->rx_coalesce_usecs_low,
+						    priv),
+			      MIN_DMA_RIWT, MAX_DMA_RIWT);
+	rx_riwt_high = clamp_t(u32, stmmac_usec2riwt(ec->rx_coalesce_usecs_high,
+						     priv),
+			       MIN_DMA_RIWT, MAX_DMA_RIWT);
+	if (rx_riwt_low > rx_riwt_high)
+		return -EINVAL;
+
 	/* Only copy relevant parameters, ignore all others. */
 	priv->tx_coal_frames = ec->tx_max_coalesced_frames;
 	priv->tx_coal_timer = ec->tx_coalesce_usecs;
 	priv->rx_riwt = rx_riwt;
 	priv->hw->dma->rx_watchdog(priv->ioaddr, priv->rx_riwt);
 
+	priv->coal_rate_low = ec->pkt_rate_low;
+	priv->coal_rate_high = ec->pkt_rate_high;
+	priv->rx_riwt_low = rx_riwt_low;
+	priv->rx_riwt_high = rx_riwt_high;
+	priv->tx_coal_frames_low = ec->tx_max_coalesced_frames_low;
+	priv->tx_coal_frames_high = ec->tx_max_coalesced_frames_high;
+	priv->rx_coal_adaptive = ec->use_adaptive_rx_coalesce;
+	priv->tx_coal_adaptive = ec->use_adaptive_tx_coalesce;
+
 	return 0;
 }
 
@@ -43,6 +43,8 @@
 #include <linux/dma-mapping.h>
 #include <linux/slab.h>
 #include <linux/prefetch.h>
+#include <linux/filter.h>
+#include <linux/bpf.h>
 #include <linux/pinctrl/consumer.h>
 #ifdef CONFIG_DEBUG_FS
 #include <linux/debugfs.h>
@@ -94,6 +96,10 @@ module_param(tc, int, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(tc, "DMA threshold control value");
 
 #define	DEFAULT_BUFSIZE	1536
+
+/* Page recycling is used when a frame fits in half a page */
+#define STMMAC_RX_PAGE_BUFSZ	(PAGE_SIZE / 2)
+#define STMMAC_RX_HDR_SIZE	256
 static int buf_sz = DEFAULT_BUFSIZE;
 module_param(buf_sz, int, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(buf_sz, "DMA buffer size");
@@ -426,6 +432,7 @@ static int stmmac_hwtstamp_ioctl(struct net_device *dev, struct ifreq *ifr)
 	struct hwtstamp_config config;
 	struct timespec now;
 	u64 temp = 0;
+	u32 sec_inc;
 	u32 ptp_v2 = 0;
 	u32 tstamp_all = 0;
 	u32 ptp_over_ipv4_udp = 0;
@@ -602,20 +609,21 @@ static int stmmac_hwtstamp_ioctl(struct net_device *dev, struct ifreq *ifr)
 		priv->hw->ptp->config_hw_tstamping(priv->ioaddr, value);
 
 		/* program Sub Second Increment reg */
-		priv->hw->ptp->config_sub_second_increment(priv->ioaddr);
+		sec_inc = priv->hw->ptp->config_sub_second_increment(
+				priv->ioaddr, priv->clk_ptp_rate);
 
 		/* calculate default added value:
 		 * formula is :
 		 * addend = (2^32)/freq_div_ratio;
-		 * where, freq_div_ratio = clk_ptp_ref_i/50MHz
-		 * hence, addend = ((2^32) * 50MHz)/clk_ptp_ref_i;
-		 * NOTE: clk_ptp_ref_i should be >= 50MHz to
-		 *       achieve 20ns accuracy.
+		 * where, freq_div_ratio = clk_ptp_ref_i/(1e9ns/sec_inc)
+		 * hence, addend = ((2^32) * (1e9ns/sec_inc))/clk_ptp_ref_i;
+		 * which holds for any reference rate, including the 50MHz
+		 * RMII clock.
 		 *
-		 * 2^x * y == (y << x), hence
-		 * 2^32 * 50000000 ==> (50000000 << 32)
+		 * 2^x * y == (y << x)
 		 */
-		temp = (u64) (50000000ULL << 32);
+		temp = div_u64(1000000000ULL, sec_inc);
+		temp = (u64)(temp << 32);
 		priv->default_addend = div_u64(temp, priv->clk_ptp_rate);
 		priv->hw->ptp->config_addend(priv->ioaddr,
 					     priv->default_addend);
@@ -981,11 +989,59 @@ static void stmmac_clear_descriptors(struct stmmac_priv *priv)
  * Description: this function is called to allocate a receive buffer, perform
  * the DMA mapping and init the descriptor.
  */
+static int stmmac_rx_page_alloc(struct stmmac_priv *priv,
+				struct stmmac_rx_page *buf, gfp_t flags)
+{
+	struct page *page;
+
+	page = __dev_alloc_page(flags);
+	if (!page)
+		return -ENOMEM;
+
+	buf->dma = dma_map_single(priv->device, page_address(page), PAGE_SIZE,
+				  DMA_FROM_DEVICE);
+	if (dma_mapping_error(priv->device, buf->dma)) {
+		__free_page(page);
+		return -EINVAL;
+	}
+	buf->page = page;
+	buf->offset = 0;
+
+	return 0;
+}
+
+/* The received part is synced for the cpu in stmmac_rx, skip the
+ * cpu sync on unmap: the other half of the page may still be in use (and
+ * dirty) in the stack.
+ */
+static void stmmac_rx_page_unmap(struct stmmac_priv *priv,
+				 struct stmmac_rx_page *buf)
+{
+	DEFINE_DMA_ATTRS(attrs);
+
+	dma_set_attr(DMA_ATTR_SKIP_CPU_SYNC, &attrs);
+	dma_unmap_single_attrs(priv->device, buf->dma, PAGE_SIZE,
+			       DMA_FROM_DEVICE, &attrs);
+}
+
 static int stmmac_init_rx_buffers(struct stmmac_priv *priv, struct dma_desc *p,
 				  int i, gfp_t flags)
 {
 	struct sk_buff *skb;
 
+	if (priv->rx_page_mode) {
+		struct stmmac_rx_page *buf = &priv->rx_page[i];
+
+		priv->rx_skbuff[i] = NULL;
+		if (stmmac_rx_page_alloc(priv, buf, flags)) {
+			pr_err("%s: Rx init fails; no page\n", __func__);
+			return -ENOMEM;
+		}
+		p->des2 = buf->dma + buf->offset;
+
+		return 0;
+	}
+
 	skb = __netdev_alloc_skb_ip_align(priv->dev, priv->dma_buf_sz, flags);
 	if (!skb) {
 		pr_err("%s: Rx init fails; skb is NULL\n", __func__);
@@ -1012,6 +1068,11 @@ static int stmmac_init_rx_buffers(struct stmmac_priv *priv, struct dma_desc *p,
 
 static void stmmac_free_rx_buffers(struct stmmac_priv *priv, int i)
 {
+	if (priv->rx_page[i].page) {
+		stmmac_rx_page_unmap(priv, &priv->rx_page[i]);
+		put_page(priv->rx_page[i].page);
+		priv->rx_page[i].page = NULL;
+	}
 	if (priv->rx_skbuff[i]) {
 		dma_unmap_single(priv->device, priv->rx_skbuff_dma[i],
 				 priv->dma_buf_sz, DMA_FROM_DEVICE);
@@ -1044,6 +1105,8 @@ static int init_dma_desc_rings(struct net_device *dev, gfp_t flags)
 		bfsize = stmmac_set_bfsize(dev->mtu, priv->dma_buf_sz);
 
 	priv->dma_buf_sz = bfsize;
+	priv->rx_page_mode = bfsize <= min_t(unsigned int, BUF_SIZE_2KiB,
+					     STMMAC_RX_PAGE_BUFSZ);
 
 	if (netif_msg_probe(priv))
 		pr_debug("%s: txsize %d, rxsize %d, bfsize %d\n", __func__,
@@ -1067,7 +1130,7 @@ static int init_dma_desc_rings(struct net_device *dev, gfp_t flags)
 		if (ret)
 			goto err_init_rx_buffers;
 
-		if (netif_msg_probe(priv))
+		if (netif_msg_probe(priv) && !priv->rx_page_mode)
 			pr_debug("[%p]\t[%p]\t[%x]\n", priv->rx_skbuff[i],
 				 priv->rx_skbuff[i]->data,
 				 (unsigned int)priv->rx_skbuff_dma[i]);
@@ -1186,6 +1249,10 @@ static int alloc_dma_desc_resources(struct stmmac_priv *priv)
 	if (!priv->rx_skbuff)
 		goto err_rx_skbuff;
 
+	priv->rx_page = kcalloc(rxsize, sizeof(*priv->rx_page), GFP_KERNEL);
+	if (!priv->rx_page)
+		goto err_rx_page;
+
 	priv->tx_skbuff_dma = kmalloc_array(txsize,
 					    sizeof(*priv->tx_skbuff_dma),
 					    GFP_KERNEL);
@@ -1244,6 +1311,8 @@ err_dma:
 err_tx_skbuff:
 	kfree(priv->tx_skbuff_dma);
 err_tx_skbuff_dma:
+	kfree(priv->rx_page);
+err_rx_page:
 	kfree(priv->rx_skbuff);
 err_rx_skbuff:
 	kfree(priv->rx_skbuff_dma);
@@ -1274,6 +1343,7 @@ static void free_dma_desc_resources(struct stmmac_priv *priv)
 	}
 	kfree(priv->rx_skbuff_dma);
 	kfree(priv->rx_skbuff);
+	kfree(priv->rx_page);
 	kfree(priv->tx_skbuff_dma);
 	kfree(priv->tx_skbuff);
 }
@@ -1309,9 +1379,10 @@ static void stmmac_dma_operation_mode(struct stmmac_priv *priv)
 /**
  * stmmac_tx_clean - to manage the transmission completion
  * @priv: driver private structure
+ * @budget: NAPI budget, 0 when not called from the poll method
  * Description: it reclaims the transmit resources after transmission completes.
  */
-static void stmmac_tx_clean(struct stmmac_priv *priv)
+static void stmmac_tx_clean(struct stmmac_priv *priv, int budget)
 {
 	unsigned int txsize = priv->dma_tx_size;
 	unsigned int bytes_compl = 0, pkts_compl = 0;
@@ -1372,8 +1443,9 @@ static void stmmac_tx_clean(struct stmmac_priv *priv)
 
 		if (likely(skb != NULL)) {
 			pkts_compl++;
+			priv->coal_tx_frames++;
 			bytes_compl += skb->len;
-			dev_consume_skb_any(skb);
+			napi_consume_skb(skb, budget);
 			priv->tx_skbuff[entry] = NULL;
 		}
 
@@ -1665,7 +1737,7 @@ static void stmmac_tx_timer(unsigned long data)
 {
 	struct stmmac_priv *priv = (struct stmmac_priv *)data;
 
-	stmmac_tx_clean(priv);
+	stmmac_tx_clean(priv, 0);
 }
 
 /**
@@ -1763,6 +1835,7 @@ static int stmmac_hw_setup(struct net_device *dev, bool init_ptp)
 		priv->rx_riwt = MAX_DMA_RIWT;
 		priv->hw->dma->rx_watchdog(priv->ioaddr, MAX_DMA_RIWT);
 	}
+	priv->coal_stamp = jiffies;
 
 	if (priv->pcs && priv->hw->mac->ctrl_ane)
 		priv->hw->mac->ctrl_ane(priv->hw, 0);
@@ -2079,12 +2152,20 @@ static netdev_tx_t stmmac_xmit(struct sk_buff *skb, struct net_device *dev)
 		skb_tx_timestamp(skb);
 
 	netdev_sent_queue(dev, skb->len);
-	priv->hw->dma->enable_dma_transmission(priv->ioaddr);
+
+	/* The GMAC has a single DMA channel, so the poll demand is the one
+	 * register write per frame left on this path. Only issue it once
+	 * the stack has no further frames queued behind this one.
+	 */
+	if (!skb->xmit_more || netif_xmit_stopped(netdev_get_tx_queue(dev, 0)))
+		priv->hw->dma->enable_dma_transmission(priv->ioaddr);
 
 	spin_unlock(&priv->tx_lock);
 	return NETDEV_TX_OK;
 
 dma_map_err:
+	/* kick the frames whose poll demand was deferred by xmit_more */
+	priv->hw->dma->enable_dma_transmission(priv->ioaddr);
 	spin_unlock(&priv->tx_lock);
 	dev_err(priv->device, "Tx dma map failed\n");
 	dev_kfree_skb(skb);
@@ -2129,7 +2210,17 @@ static inline void stmmac_rx_refill(struct stmmac_priv *priv)
 		else
 			p = priv->dma_rx + entry;
 
-		if (likely(priv->rx_skbuff[entry] == NULL)) {
+		if (priv->rx_page_mode) {
+			struct stmmac_rx_page *buf = &priv->rx_page[entry];
+
+			if (unlikely(!buf->page) &&
+			    stmmac_rx_page_alloc(priv, buf, GFP_ATOMIC))
+				break;
+
+			/* recycled buffers were synced back when released */
+			p->des2 = buf->dma + buf->offset;
+			priv->hw->mode->refill_desc3(priv, p);
+		} else if (likely(priv->rx_skbuff[entry] == NULL)) {
 			struct sk_buff *skb;
 
 			skb = netdev_alloc_skb_ip_align(priv->dev, bfsize);
@@ -2160,6 +2251,114 @@ static inline void stmmac_rx_refill(struct stmmac_priv *priv)
 	}
 }
 
+/**
+ * stmmac_rx_page_skb - build the skb for a frame held in a recycled page
+ * @priv: driver private structure
+ * @entry: rx ring entry
+ * @len: frame length
+ * Description: the received bytes have already been synced for the cpu.
+ * Small frames are copied and the buffer is synced back and kept; otherwise
+ * the headers are copied, the payload is attached as a page fragment and the
+ * other half of the page is reused once the stack has released it.
+ */
+static struct sk_buff *stmmac_rx_page_skb(struct stmmac_priv *priv,
+					  unsigned int entry, int len)
+{
+	struct stmmac_rx_page *buf = &priv->rx_page[entry];
+	struct page *page = buf->page;
+	void *va = page_address(page) + buf->offset;
+	struct sk_buff *skb;
+	unsigned int hlen;
+
+	skb = napi_alloc_skb(&priv->napi, STMMAC_RX_HDR_SIZE);
+	if (unlikely(!skb) || len <= STMMAC_RX_HDR_SIZE) {
+		if (likely(skb))
+			memcpy(__skb_put(skb, len), va, len);
+		/* the buffer is re-armed, give the device back what we read */
+		dma_sync_single_range_for_device(priv->device, buf->dma,
+						 buf->offset, len,
+						 DMA_FROM_DEVICE);
+		return skb;
+	}
+
+	hlen = eth_get_headlen(va, STMMAC_RX_HDR_SIZE);
+	memcpy(__skb_put(skb, hlen), va, hlen);
+	skb_add_rx_frag(skb, 0, page, buf->offset + hlen, len - hlen,
+			STMMAC_RX_PAGE_BUFSZ);
+
+	if (likely(page_count(page) == 1 && !page_is_pfmemalloc(page) &&
+		   page_to_nid(page) == numa_mem_id())) {
+		/* the stack may have written to the other half */
+		get_page(page);
+		buf->offset ^= STMMAC_RX_PAGE_BUFSZ;
+		dma_sync_single_range_for_device(priv->device, buf->dma,
+						 buf->offset,
+						 STMMAC_RX_PAGE_BUFSZ,
+						 DMA_FROM_DEVICE);
+	} else {
+		stmmac_rx_page_unmap(priv, buf);
+		buf->page = NULL;
+	}
+
+	return skb;
+}
+
+/**
+ * stmmac_rx_xdp - run the XDP program on a frame held in a recycled page
+ * @priv: driver private structure
+ * @prog: the attached XDP program
+ * @entry: rx ring entry
+ * @len: frame length
+ * Description: on XDP_TX the frame is copied into an skb for the normal
+ * transmit path, the rx buffer is always kept. Anything but XDP_PASS
+ * re-arms it, after syncing back whatever the program may have written.
+ */
+static u32 stmmac_rx_xdp(struct stmmac_priv *priv, struct bpf_prog *prog,
+			 unsigned int entry, int len)
+{
+	struct stmmac_rx_page *buf = &priv->rx_page[entry];
+	struct net_device *dev = priv->dev;
+	struct netdev_queue *txq;
+	struct xdp_buff xdp;
+	struct sk_buff *skb;
+	u32 act;
+
+	xdp.data = page_address(buf->page) + buf->offset;
+	xdp.len = len;
+	act = bpf_prog_run_xdp(prog, &xdp);
+	switch (act) {
+	case XDP_PASS:
+		return XDP_PASS;
+	case XDP_TX:
+		skb = napi_alloc_skb(&priv->napi, len);
+		if (unlikely(!skb)) {
+			dev->stats.tx_dropped++;
+			break;
+		}
+		memcpy(__skb_put(skb, len), xdp.data, len);
+
+		txq = netdev_get_tx_queue(dev, 0);
+		__netif_tx_lock(txq, smp_processor_id());
+		if (netif_xmit_frozen_or_stopped(txq) ||
+		    stmmac_xmit(skb, dev) != NETDEV_TX_OK) {
+			dev->stats.tx_dropped++;
+			kfree_skb(skb);
+		}
+		__netif_tx_unlock(txq);
+		break;
+	default:
+		bpf_warn_invalid_xdp_action(act);
+		/* fall through */
+	case XDP_ABORTED:
+	case XDP_DROP:
+		break;
+	}
+
+	dma_sync_single_range_for_device(priv->device, buf->dma, buf->offset,
+					 len, DMA_FROM_DEVICE);
+	return act;
+}
+
 /**
  * stmmac_rx - manage the receive process
  * @priv: driver private structure
@@ -2212,7 +2411,8 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit)
 							   entry);
 		if (unlikely(status == discard_frame)) {
 			priv->dev->stats.rx_errors++;
-			if (priv->hwts_rx_en && !priv->extend_desc) {
+			if (priv->hwts_rx_en && !priv->extend_desc &&
+			    !priv->rx_page_mode) {
 				/* DESC2 & DESC3 will be overwitten by device
 				 * with timestamp value, hence reinitialize
 				 * them in stmmac_rx_refill() function so that
@@ -2243,26 +2443,61 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit)
 					pr_debug("\tframe size %d, COE: %d\n",
 						 frame_len, status);
 			}
-			skb = priv->rx_skbuff[entry];
-			if (unlikely(!skb)) {
-				pr_err("%s: Inconsistent Rx descriptor chain\n",
-				       priv->dev->name);
-				priv->dev->stats.rx_dropped++;
-				break;
+			if (priv->rx_page_mode) {
+				struct stmmac_rx_page *buf =
+					&priv->rx_page[entry];
+				struct bpf_prog *xdp_prog;
+
+				dma_sync_single_range_for_cpu(priv->device,
+							      buf->dma,
+							      buf->offset,
+							      frame_len,
+							      DMA_FROM_DEVICE);
+				prefetch(page_address(buf->page) +
+					 buf->offset);
+
+				rcu_read_lock();
+				xdp_prog = rcu_dereference(priv->xdp_prog);
+				if (xdp_prog &&
+				    stmmac_rx_xdp(priv, xdp_prog, entry,
+						  frame_len) != XDP_PASS) {
+					rcu_read_unlock();
+					entry = next_entry;
+					continue;
+				}
+				rcu_read_unlock();
+
+				skb = stmmac_rx_page_skb(priv, entry,
+							 frame_len);
+				if (unlikely(!skb)) {
+					/* drop it, the buffer is re-armed */
+					priv->dev->stats.rx_dropped++;
+					entry = next_entry;
+					continue;
+				}
+			} else {
+				skb = priv->rx_skbuff[entry];
+				if (unlikely(!skb)) {
+					pr_err("%s: Inconsistent Rx descriptor chain\n",
+					       priv->dev->name);
+					priv->dev->stats.rx_dropped++;
+					break;
+				}
+				prefetch(skb->data - NET_IP_ALIGN);
+				priv->rx_skbuff[entry] = NULL;
+
+				skb_put(skb, frame_len);
+				dma_unmap_single(priv->device,
+						 priv->rx_skbuff_dma[entry],
+						 priv->dma_buf_sz,
+						 DMA_FROM_DEVICE);
 			}
-			prefetch(skb->data - NET_IP_ALIGN);
-			priv->rx_skbuff[entry] = NULL;
 
 			stmmac_get_rx_hwtstamp(priv, entry, skb);
 
-			skb_put(skb, frame_len);
-			dma_unmap_single(priv->device,
-					 priv->rx_skbuff_dma[entry],
-					 priv->dma_buf_sz, DMA_FROM_DEVICE);
-
 			if (netif_msg_pktdata(priv)) {
 				pr_debug("frame received (%dbytes)", frame_len);
-				print_pkt(skb->data, frame_len);
+				print_pkt(skb->data, skb_headlen(skb));
 			}
 
 			stmmac_rx_vlan(priv->dev, skb);
@@ -2289,6 +2524,61 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit)
 	return count;
 }
 
+static u32 stmmac_coal_scale(struct stmmac_priv *priv, u32 rate, u32 low,
+			     u32 high)
+{
+	if (rate <= priv->coal_rate_low)
+		return low;
+	if (rate >= priv->coal_rate_high)
+		return high;
+
+	return low + div_u64((u64)(high - low) * (rate - priv->coal_rate_low),
+			     priv->coal_rate_high - priv->coal_rate_low);
+}
+
+/**
+ * stmmac_adapt_coalesce - adjust the interrupt mitigation to the load
+ * @priv: driver private structure
+ * Description: called from the NAPI poll. Every STMMAC_COAL_SAMPLE_MS the
+ * rx and tx frame rates are sampled and the RI watchdog and the tx frame
+ * threshold are scaled between their low and high settings: low latency
+ * for light traffic, fewer interrupts at high rates.
+ */
+static void stmmac_adapt_coalesce(struct stmmac_priv *priv)
+{
+	unsigned long elapsed = jiffies - priv->coal_stamp;
+	u32 rate;
+
+	if (elapsed < msecs_to_jiffies(STMMAC_COAL_SAMPLE_MS))
+		return;
+
+	if (priv->rx_coal_adaptive) {
+		u32 riwt;
+
+		rate = div_u64((u64)priv->coal_rx_frames * HZ, elapsed);
+		riwt = stmmac_coal_scale(priv, rate, priv->rx_riwt_low,
+					 priv->rx_riwt_high);
+		if (riwt != priv->rx_riwt) {
+			priv->rx_riwt = riwt;
+			priv->hw->dma->rx_watchdog(priv->ioaddr, riwt);
+		}
+	}
+
+	if (priv->tx_coal_adaptive) {
+		/* the tx count is updated under tx_lock, a lost update only
+		 * skews a single sample
+		 */
+		rate = div_u64((u64)priv->coal_tx_frames * HZ, elapsed);
+		priv->tx_coal_frames = stmmac_coal_scale(priv, rate,
+						priv->tx_coal_frames_low,
+						priv->tx_coal_frames_high);
+	}
+
+	priv->coal_rx_frames = 0;
+	priv->coal_tx_frames = 0;
+	priv->coal_stamp = jiffies;
+}
+
 /**
  *  stmmac_poll - stmmac poll method (NAPI)
  *  @napi : pointer to the napi structure.
@@ -2303,9 +2593,15 @@ static int stmmac_poll(struct napi_struct *napi, int budget)
 	int work_done = 0;
 
 	priv->xstats.napi_poll++;
-	stmmac_tx_clean(priv);
+	stmmac_tx_clean(priv, budget);
 
 	work_done = stmmac_rx(priv, budget);
+
+	if (priv->rx_coal_adaptive || priv->tx_coal_adaptive) {
+		priv->coal_rx_frames += work_done;
+		stmmac_adapt_coalesce(priv);
+	}
+
 	if (work_done < budget) {
 		napi_complete(napi);
 		stmmac_enable_dma_irq(priv);
@@ -2374,6 +2670,10 @@ static int stmmac_change_mtu(struct net_device *dev, int new_mtu)
 	if (priv->plat->maxmtu < max_mtu)
 		max_mtu = priv->plat->maxmtu;
 
+	/* XDP needs the page mode rx buffers, see init_dma_desc_rings */
+	if (rtnl_dereference(priv->xdp_prog) && max_mtu > ETH_DATA_LEN)
+		max_mtu = ETH_DATA_LEN;
+
 	if ((new_mtu < 46) || (new_mtu > max_mtu)) {
 		pr_err("%s: invalid MTU, max MTU is: %d\n", dev->name, max_mtu);
 		return -EINVAL;
@@ -2703,6 +3003,32 @@ static void stmmac_exit_fs(struct net_device *dev)
 }
 #endif /* CONFIG_DEBUG_FS */
 
+static int stmmac_xdp(struct net_device *dev, struct netdev_xdp *xdp)
+{
+	struct stmmac_priv *priv = netdev_priv(dev);
+	struct bpf_prog *old_prog;
+
+	switch (xdp->command) {
+	case XDP_SETUP_PROG:
+		/* frames up to this size are received in page mode */
+		if (xdp->prog && dev->mtu > ETH_DATA_LEN) {
+			netdev_warn(dev, "XDP requires MTU less than %u\n",
+				    ETH_DATA_LEN + 1);
+			return -EINVAL;
+		}
+		old_prog = rtnl_dereference(priv->xdp_prog);
+		rcu_assign_pointer(priv->xdp_prog, xdp->prog);
+		if (old_prog)
+			bpf_prog_put_rcu(old_prog);
+		return 0;
+	case XDP_QUERY_PROG:
+		xdp->prog_attached = !!rtnl_dereference(priv->xdp_prog);
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
 static const struct net_device_ops stmmac_netdev_ops = {
 	.ndo_open = stmmac_open,
 	.ndo_start_xmit = stmmac_xmit,
@@ -2717,6 +3043,7 @@ static const struct net_device_ops stmmac_netdev_ops = {
 	.ndo_poll_controller = stmmac_poll_controller,
 #endif
 	.ndo_set_mac_address = eth_mac_addr,
+	.ndo_xdp = stmmac_xdp,
 };
 
 /**
@@ -2926,6 +3253,14 @@ int stmmac_dvr_probe(struct device *device,
 		pr_info(" Enable RX Mitigation via HW Watchdog Timer\n");
 	}
 
+	/* Adaptive coalescing is off by default, see ethtool -C */
+	priv->coal_rate_low = STMMAC_COAL_RATE_LOW;
+	priv->coal_rate_high = STMMAC_COAL_RATE_HIGH;
+	priv->rx_riwt_low = MIN_DMA_RIWT;
+	priv->rx_riwt_high = MAX_DMA_RIWT;
+	priv->tx_coal_frames_low = 1;
+	priv->tx_coal_frames_high = STMMAC_TX_FRAMES;
+
 	netif_napi_add(ndev, &priv->napi, stmmac_poll, 64);
 
 	spin_lock_init(&priv->lock);
@@ -2996,6 +3331,8 @@ int stmmac_dvr_remove(struct net_device *ndev)
 	stmmac_set_mac(priv->ioaddr, false);
 	netif_carrier_off(ndev);
 	unregister_netdev(ndev);
+	if (rcu_access_pointer(priv->xdp_prog))
+		bpf_prog_put(rcu_dereference_protected(priv->xdp_prog, 1));
 	if (priv->stmmac_rst)
 		reset_control_assert(priv->stmmac_rst);
 	clk_disable_unprepare(priv->pclk);
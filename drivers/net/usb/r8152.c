@@ -25,6 +25,7 @@
 #include <uapi/linux/mdio.h>
 #include <linux/mdio.h>
 #include <linux/usb/cdc.h>
+#include <linux/usb/usbnet.h>
 
 /* Information for net-next */
 #define NETNEXT_VERSION		"08"
@@ -575,6 +576,7 @@ struct rx_agg {
 	struct list_head list;
 	struct urb *urb;
 	struct r8152 *context;
+	struct page *page;
 	void *buffer;
 	void *head;
 };
@@ -1241,7 +1243,9 @@ static void free_all_mem(struct r8152 *tp)
 		usb_free_urb(tp->rx_info[i].urb);
 		tp->rx_info[i].urb = NULL;
 
-		kfree(tp->rx_info[i].buffer);
+		if (tp->rx_info[i].page)
+			put_page(tp->rx_info[i].page);
+		tp->rx_info[i].page = NULL;
 		tp->rx_info[i].buffer = NULL;
 		tp->rx_info[i].head = NULL;
 	}
@@ -1262,6 +1266,16 @@ static void free_all_mem(struct r8152 *tp)
 	tp->intr_buff = NULL;
 }
 
+/* rx buffers are pages, so that received frames can point into them */
+static struct page *alloc_rx_page(struct r8152 *tp, gfp_t mem_flags)
+{
+	struct device *parent = tp->netdev->dev.parent;
+	int node = parent ? dev_to_node(parent) : NUMA_NO_NODE;
+
+	return alloc_pages_node(node, mem_flags | __GFP_COMP,
+				get_order(agg_buf_sz));
+}
+
 static int alloc_all_mem(struct r8152 *tp)
 {
 	struct net_device *netdev = tp->netdev;
@@ -1281,29 +1295,23 @@ static int alloc_all_mem(struct r8152 *tp)
 	skb_queue_head_init(&tp->rx_queue);
 
 	for (i = 0; i < RTL8152_MAX_RX; i++) {
-		buf = kmalloc_node(agg_buf_sz, GFP_KERNEL, node);
-		if (!buf)
-			goto err1;
+		struct page *page = alloc_rx_page(tp, GFP_KERNEL);
 
-		if (buf != rx_agg_align(buf)) {
-			kfree(buf);
-			buf = kmalloc_node(agg_buf_sz + RX_ALIGN, GFP_KERNEL,
-					   node);
-			if (!buf)
-				goto err1;
-		}
+		if (!page)
+			goto err1;
 
 		urb = usb_alloc_urb(0, GFP_KERNEL);
 		if (!urb) {
-			kfree(buf);
+			put_page(page);
 			goto err1;
 		}
 
 		INIT_LIST_HEAD(&tp->rx_info[i].list);
 		tp->rx_info[i].context = tp;
 		tp->rx_info[i].urb = urb;
-		tp->rx_info[i].buffer = buf;
-		tp->rx_info[i].head = rx_agg_align(buf);
+		tp->rx_info[i].page = page;
+		tp->rx_info[i].buffer = page_address(page);
+		tp->rx_info[i].head = tp->rx_info[i].buffer;
 	}
 
 	for (i = 0; i < RTL8152_MAX_TX; i++) {
@@ -1724,7 +1732,7 @@ static int rx_bottom(struct r8152 *tp, int budget)
 		while (urb->actual_length > len_used) {
 			struct net_device *netdev = tp->netdev;
 			struct net_device_stats *stats = &netdev->stats;
-			unsigned int pkt_len;
+			unsigned int pkt_len, truesize;
 			struct sk_buff *skb;
 
 			pkt_len = le32_to_cpu(rx_desc->opts1) & RX_LEN_MASK;
@@ -1738,15 +1746,21 @@ static int rx_bottom(struct r8152 *tp, int budget)
 			pkt_len -= CRC_SIZE;
 			rx_data += sizeof(struct rx_desc);
 
-			skb = netdev_alloc_skb_ip_align(netdev, pkt_len);
+			/* no copy beyond the headers, the frame stays
+			 * in the page, which is replaced on resubmit
+			 * if the stack still holds on to it
+			 */
+			truesize = ALIGN(pkt_len + CRC_SIZE +
+					 sizeof(struct rx_desc), RX_ALIGN);
+			skb = usbnet_rx_frag_skb(&tp->napi, agg->page,
+						 rx_data - (u8 *)agg->buffer,
+						 pkt_len, truesize);
 			if (!skb) {
 				stats->rx_dropped++;
 				goto find_next_rx;
 			}
 
 			skb->ip_summed = r8152_rx_csum(tp, rx_desc);
-			memcpy(skb->data, rx_data, pkt_len);
-			skb_put(skb, pkt_len);
 			skb->protocol = eth_type_trans(skb, netdev);
 			rtl_rx_vlan_tag(rx_desc, skb);
 			if (work_done < budget) {
@@ -1866,11 +1880,26 @@ int r8152_submit_rx(struct r8152 *tp, struct rx_agg *agg, gfp_t mem_flags)
 	    !test_bit(WORK_ENABLE, &tp->flags) || !netif_carrier_ok(tp->netdev))
 		return 0;
 
+	/* frames received into the buffer may still be in use upstream */
+	if (page_count(agg->page) != 1) {
+		struct page *page = alloc_rx_page(tp, mem_flags);
+
+		if (!page) {
+			ret = -ENOMEM;
+			goto err;
+		}
+		put_page(agg->page);
+		agg->page = page;
+		agg->buffer = page_address(page);
+		agg->head = agg->buffer;
+	}
+
 	usb_fill_bulk_urb(agg->urb, tp->udev, usb_rcvbulkpipe(tp->udev, 1),
 			  agg->head, agg_buf_sz,
 			  (usb_complete_t)read_bulk_callback, agg);
 
 	ret = usb_submit_urb(agg->urb, mem_flags);
+err:
 	if (ret == -ENODEV) {
 		set_bit(RTL8152_UNPLUG, &tp->flags);
 		netif_device_detach(tp->netdev);
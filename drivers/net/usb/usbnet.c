@@ -313,6 +313,7 @@ static void __usbnet_status_stop_force(struct usbnet *dev)
 /* Passes this packet up the stack, updating its accounting.
  * Some link protocols batch packets, so their rx_fixup paths
  * can return clones as well as just modify the original skb.
+ * Only valid from rx_fixup(), which runs in NAPI context.
  */
 void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
 {
@@ -334,10 +335,10 @@ void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
 	if (skb_defer_rx_timestamp(skb))
 		return;
 
-	status = netif_rx (skb);
-	if (status != NET_RX_SUCCESS)
+	status = napi_gro_receive(&dev->napi, skb);
+	if (status == GRO_DROP)
 		netif_dbg(dev, rx_err, dev->net,
-			  "netif_rx status %d\n", status);
+			  "napi_gro_receive status %d\n", status);
 }
 EXPORT_SYMBOL_GPL(usbnet_skb_return);
 
@@ -437,7 +438,7 @@ static enum skb_state defer_bh(struct usbnet *dev, struct sk_buff *skb,
 
 	__skb_queue_tail(&dev->done, skb);
 	if (dev->done.qlen == 1)
-		tasklet_schedule(&dev->bh);
+		napi_schedule(&dev->napi);
 	spin_unlock(&dev->done.lock);
 	spin_unlock_irqrestore(&list->lock, flags);
 	return old_state;
@@ -517,7 +518,7 @@ static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 		default:
 			netif_dbg(dev, rx_err, dev->net,
 				  "rx submit, %d\n", retval);
-			tasklet_schedule (&dev->bh);
+			napi_schedule(&dev->napi);
 			break;
 		case 0:
 			__usbnet_queue_skb(&dev->rxq, skb, rx_start);
@@ -658,6 +659,17 @@ block:
 	netif_dbg(dev, rx_err, dev->net, "no read resubmitted\n");
 }
 
+/*
+ * napi_schedule() only raises NET_RX_SOFTIRQ, which process context does
+ * not run until the next interrupt; local_bh_enable() runs it right away.
+ */
+static void usbnet_napi_schedule(struct usbnet *dev)
+{
+	local_bh_disable();
+	napi_schedule(&dev->napi);
+	local_bh_enable();
+}
+
 /*-------------------------------------------------------------------------*/
 void usbnet_pause_rx(struct usbnet *dev)
 {
@@ -669,20 +681,14 @@ EXPORT_SYMBOL_GPL(usbnet_pause_rx);
 
 void usbnet_resume_rx(struct usbnet *dev)
 {
-	struct sk_buff *skb;
-	int num = 0;
-
 	clear_bit(EVENT_RX_PAUSED, &dev->flags);
 
-	while ((skb = skb_dequeue(&dev->rxq_pause)) != NULL) {
-		usbnet_skb_return(dev, skb);
-		num++;
-	}
-
-	tasklet_schedule(&dev->bh);
+	/* usbnet_poll() passes the paused frames up */
+	usbnet_napi_schedule(dev);
 
 	netif_dbg(dev, rx_status, dev->net,
-		  "paused rx queue disabled, %d skbs requeued\n", num);
+		  "paused rx queue disabled, %d skbs requeued\n",
+		  skb_queue_len(&dev->rxq_pause));
 }
 EXPORT_SYMBOL_GPL(usbnet_resume_rx);
 
@@ -748,7 +754,7 @@ void usbnet_unlink_rx_urbs(struct usbnet *dev)
 {
 	if (netif_running(dev->net)) {
 		(void) unlink_urbs (dev, &dev->rxq);
-		tasklet_schedule(&dev->bh);
+		usbnet_napi_schedule(dev);
 	}
 }
 EXPORT_SYMBOL_GPL(usbnet_unlink_rx_urbs);
@@ -834,7 +840,7 @@ int usbnet_stop (struct net_device *net)
 	 */
 	dev->flags = 0;
 	del_timer_sync (&dev->delay);
-	tasklet_kill (&dev->bh);
+	napi_disable(&dev->napi);
 	if (!pm)
 		usb_autopm_put_interface(dev->intf);
 
@@ -918,7 +924,8 @@ int usbnet_open (struct net_device *net)
 	clear_bit(EVENT_RX_KILL, &dev->flags);
 
 	// delay posting reads until we're fully open
-	tasklet_schedule (&dev->bh);
+	napi_enable(&dev->napi);
+	usbnet_napi_schedule(dev);
 	if (info->manage_power) {
 		retval = info->manage_power(dev, 1);
 		if (retval < 0) {
@@ -1060,7 +1067,7 @@ static void __handle_link_change(struct usbnet *dev)
 		 */
 	} else {
 		/* submitting URBs for reading packets */
-		tasklet_schedule(&dev->bh);
+		usbnet_napi_schedule(dev);
 	}
 
 	/* hard_mtu or rx_urb_size may change during link change */
@@ -1133,11 +1140,11 @@ fail_halt:
 					   status);
 		} else {
 			clear_bit (EVENT_RX_HALT, &dev->flags);
-			tasklet_schedule (&dev->bh);
+			usbnet_napi_schedule(dev);
 		}
 	}
 
-	/* tasklet could resubmit itself forever if memory is tight */
+	/* NAPI could resubmit itself forever if memory is tight */
 	if (test_bit (EVENT_RX_MEMORY, &dev->flags)) {
 		struct urb	*urb = NULL;
 		int resched = 1;
@@ -1158,7 +1165,7 @@ fail_halt:
 			usb_autopm_put_interface(dev->intf);
 fail_lowmem:
 			if (resched)
-				tasklet_schedule (&dev->bh);
+				usbnet_napi_schedule(dev);
 		}
 	}
 
@@ -1254,7 +1261,7 @@ void usbnet_tx_timeout (struct net_device *net)
 	struct usbnet		*dev = netdev_priv(net);
 
 	unlink_urbs (dev, &dev->txq);
-	tasklet_schedule (&dev->bh);
+	napi_schedule(&dev->napi);
 	/* this needs to be handled individually because the generic layer
 	 * doesn't know what is sufficient and could not restore private
 	 * information if a remedy of an unconditional reset were used.
@@ -1463,15 +1470,26 @@ err:
 
 /*-------------------------------------------------------------------------*/
 
-// tasklet (work deferred from completions, in_irq) or timer
+// NAPI poll (work deferred from completions, in_irq) or timer
 
-static void usbnet_bh (unsigned long param)
+/* returns how many frames were passed up the stack, maybe more than
+ * @budget since a single urb can carry many of them
+ */
+static int usbnet_rx_done(struct usbnet *dev, int budget)
 {
-	struct usbnet		*dev = (struct usbnet *) param;
+	struct net_device_stats	*stats = &dev->net->stats;
+	unsigned long		rx_start = stats->rx_packets;
 	struct sk_buff		*skb;
 	struct skb_data		*entry;
 
-	while ((skb = skb_dequeue (&dev->done))) {
+	/* frames held back while rx was paused go first */
+	while (!test_bit(EVENT_RX_PAUSED, &dev->flags) &&
+	       stats->rx_packets - rx_start < budget &&
+	       (skb = skb_dequeue(&dev->rxq_pause)))
+		usbnet_skb_return(dev, skb);
+
+	while (stats->rx_packets - rx_start < budget &&
+	       (skb = skb_dequeue (&dev->done))) {
 		entry = (struct skb_data *) skb->cb;
 		switch (entry->state) {
 		case rx_done:
@@ -1489,6 +1507,14 @@ static void usbnet_bh (unsigned long param)
 		}
 	}
 
+	return stats->rx_packets - rx_start;
+}
+
+/* returns true if it still needs to run again */
+static bool usbnet_bh(struct usbnet *dev)
+{
+	bool			resched = false;
+
 	/* restart RX again after disabling due to high error rate */
 	clear_bit(EVENT_RX_KILL, &dev->flags);
 
@@ -1509,17 +1535,47 @@ static void usbnet_bh (unsigned long param)
 
 		if (temp < RX_QLEN(dev)) {
 			if (rx_alloc_submit(dev, GFP_ATOMIC) == -ENOLINK)
-				return;
+				return false;
 			if (temp != dev->rxq.qlen)
 				netif_dbg(dev, link, dev->net,
 					  "rxqlen %d --> %d\n",
 					  temp, dev->rxq.qlen);
 			if (dev->rxq.qlen < RX_QLEN(dev))
-				tasklet_schedule (&dev->bh);
+				resched = true;
 		}
 		if (dev->txq.qlen < TX_QLEN (dev))
 			netif_wake_queue (dev->net);
 	}
+	return resched;
+}
+
+static int usbnet_poll(struct napi_struct *napi, int budget)
+{
+	struct usbnet	*dev = container_of(napi, struct usbnet, napi);
+	int		work;
+	bool		resched;
+
+	work = usbnet_rx_done(dev, budget);
+	if (work >= budget)
+		return budget;
+
+	resched = usbnet_bh(dev);
+
+	/* completions racing with us found NAPI still scheduled */
+	napi_complete(napi);
+	if (resched || !skb_queue_empty(&dev->done) ||
+	    (!test_bit(EVENT_RX_PAUSED, &dev->flags) &&
+	     !skb_queue_empty(&dev->rxq_pause)))
+		napi_schedule(napi);
+
+	return work;
+}
+
+static void usbnet_bh_timer(unsigned long param)
+{
+	struct usbnet		*dev = (struct usbnet *) param;
+
+	napi_schedule(&dev->napi);
 }
 
 
@@ -1642,11 +1698,10 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	skb_queue_head_init (&dev->txq);
 	skb_queue_head_init (&dev->done);
 	skb_queue_head_init(&dev->rxq_pause);
-	dev->bh.func = usbnet_bh;
-	dev->bh.data = (unsigned long) dev;
+	netif_napi_add(net, &dev->napi, usbnet_poll, NAPI_POLL_WEIGHT);
 	INIT_WORK (&dev->kevent, usbnet_deferred_kevent);
 	init_usb_anchor(&dev->deferred);
-	dev->delay.function = usbnet_bh;
+	dev->delay.function = usbnet_bh_timer;
 	dev->delay.data = (unsigned long) dev;
 	init_timer (&dev->delay);
 	mutex_init (&dev->phy_mutex);
@@ -1859,7 +1914,7 @@ int usbnet_resume (struct usb_interface *intf)
 
 			if (!(dev->txq.qlen >= TX_QLEN(dev)))
 				netif_tx_wake_all_queues(dev->net);
-			tasklet_schedule (&dev->bh);
+			usbnet_napi_schedule(dev);
 		}
 	}
 
@@ -27,6 +27,8 @@
 #include <linux/slab.h>
 #include <linux/cpu.h>
 #include <linux/average.h>
+#include <linux/filter.h>
+#include <linux/bpf.h>
 #include <net/busy_poll.h>
 
 static int napi_weight = NAPI_POLL_WEIGHT;
@@ -52,6 +54,12 @@ DECLARE_EWMA(pkt_len, 1, 64)
 
 #define VIRTNET_DRIVER_VERSION "1.0.0"
 
+/* Tags the TX tokens of mergeable buffers bounced back by XDP_TX: they are
+ * page fragments rather than skbs, their address is MERGEABLE_BUFFER_ALIGN
+ * aligned so the low bit is always clear otherwise.
+ */
+#define VIRTNET_XDP_BUF	0x1UL
+
 struct virtnet_stats {
 	struct u64_stats_sync tx_syncp;
 	struct u64_stats_sync rx_syncp;
@@ -95,6 +103,9 @@ struct receive_queue {
 
 	/* Name of this receive queue: input.$index */
 	char name[40];
+
+	/* XDP program run on each frame before an skb is built for it */
+	struct bpf_prog __rcu *xdp_prog;
 };
 
 struct virtnet_info {
@@ -311,13 +322,106 @@ static struct sk_buff *page_to_skb(struct virtnet_info *vi,
 	return skb;
 }
 
-static struct sk_buff *receive_small(struct virtnet_info *vi, void *buf, unsigned int len)
+static void free_old_xmit_skbs(struct send_queue *sq);
+
+static bool virtnet_is_xdp_buf(void *token)
+{
+	return (unsigned long)token & VIRTNET_XDP_BUF;
+}
+
+static void virtnet_free_xdp_buf(void *token)
+{
+	put_page(virt_to_head_page((void *)((unsigned long)token &
+					    ~VIRTNET_XDP_BUF)));
+}
+
+/* Bounce a frame back out of the send queue paired with @rq, @token is
+ * what free_old_xmit_skbs() will find once the host is done with it.
+ */
+static bool virtnet_xdp_xmit(struct virtnet_info *vi,
+			     struct receive_queue *rq,
+			     struct virtio_net_hdr_mrg_rxbuf *hdr,
+			     void *data, unsigned int len, void *token)
+{
+	unsigned int qnum = vq2rxq(rq->vq);
+	struct send_queue *sq = &vi->sq[qnum];
+	struct netdev_queue *txq = netdev_get_tx_queue(vi->dev, qnum);
+	int err;
+
+	/* no checksum or GSO request, the frame goes out as it is */
+	memset(hdr, 0, vi->hdr_len);
+
+	__netif_tx_lock(txq, raw_smp_processor_id());
+	free_old_xmit_skbs(sq);
+
+	sg_init_table(sq->sg, 2);
+	sg_set_buf(sq->sg, hdr, vi->hdr_len);
+	sg_set_buf(sq->sg + 1, data, len);
+	err = virtqueue_add_outbuf(sq->vq, sq->sg, 2, token, GFP_ATOMIC);
+	if (likely(!err))
+		virtqueue_kick(sq->vq);
+	__netif_tx_unlock(txq);
+
+	return !err;
+}
+
+/* Returns XDP_PASS, XDP_TX if the buffer was queued for transmission or
+ * XDP_DROP if the caller has to free it.
+ */
+static u32 do_xdp_prog(struct virtnet_info *vi, struct receive_queue *rq,
+		       struct bpf_prog *xdp_prog,
+		       struct virtio_net_hdr_mrg_rxbuf *hdr,
+		       void *data, unsigned int len, void *token)
+{
+	struct xdp_buff xdp;
+	u32 act;
+
+	xdp.data = data;
+	xdp.len = len;
+	act = bpf_prog_run_xdp(xdp_prog, &xdp);
+	switch (act) {
+	case XDP_PASS:
+		return XDP_PASS;
+	case XDP_TX:
+		if (virtnet_xdp_xmit(vi, rq, hdr, data, len, token))
+			return XDP_TX;
+		vi->dev->stats.tx_dropped++;
+		return XDP_DROP;
+	default:
+		bpf_warn_invalid_xdp_action(act);
+		/* fall through */
+	case XDP_ABORTED:
+	case XDP_DROP:
+		return XDP_DROP;
+	}
+}
+
+static struct sk_buff *receive_small(struct virtnet_info *vi,
+				     struct receive_queue *rq,
+				     void *buf, unsigned int len)
 {
 	struct sk_buff * skb = buf;
+	struct bpf_prog *xdp_prog;
 
 	len -= vi->hdr_len;
 	skb_trim(skb, len);
 
+	rcu_read_lock();
+	xdp_prog = rcu_dereference(rq->xdp_prog);
+	if (xdp_prog) {
+		u32 act;
+
+		act = do_xdp_prog(vi, rq, xdp_prog, skb_vnet_hdr(skb),
+				  skb->data, skb->len, skb);
+		if (act != XDP_PASS) {
+			rcu_read_unlock();
+			if (act == XDP_DROP)
+				dev_kfree_skb(skb);
+			return NULL;
+		}
+	}
+	rcu_read_unlock();
+
 	return skb;
 }
 
@@ -353,10 +457,38 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 	struct page *page = virt_to_head_page(buf);
 	int offset = buf - page_address(page);
 	unsigned int truesize = max(len, mergeable_ctx_to_buf_truesize(ctx));
+	struct sk_buff *head_skb = NULL, *curr_skb;
+	struct bpf_prog *xdp_prog;
 
-	struct sk_buff *head_skb = page_to_skb(vi, rq, page, offset, len,
-					       truesize);
-	struct sk_buff *curr_skb = head_skb;
+	rcu_read_lock();
+	xdp_prog = rcu_dereference(rq->xdp_prog);
+	if (xdp_prog) {
+		void *token = (void *)((unsigned long)buf | VIRTNET_XDP_BUF);
+		u32 act;
+
+		/* a program only ever sees linear frames, attaching one
+		 * turns off the offloads that produce bigger ones
+		 */
+		if (unlikely(num_buf > 1)) {
+			rcu_read_unlock();
+			net_warn_ratelimited("%s: XDP frame spans %u buffers, dropping\n",
+					     dev->name, num_buf);
+			goto err_skb;
+		}
+
+		act = do_xdp_prog(vi, rq, xdp_prog, hdr, buf + vi->hdr_len,
+				  len - vi->hdr_len, token);
+		if (act != XDP_PASS) {
+			rcu_read_unlock();
+			if (act == XDP_DROP)
+				put_page(page);
+			return NULL;
+		}
+	}
+	rcu_read_unlock();
+
+	head_skb = page_to_skb(vi, rq, page, offset, len, truesize);
+	curr_skb = head_skb;
 
 	if (unlikely(!curr_skb))
 		goto err_skb;
@@ -457,7 +589,7 @@ static void receive_buf(struct virtnet_info *vi, struct receive_queue *rq,
 	else if (vi->big_packets)
 		skb = receive_big(dev, vi, rq, buf, len);
 	else
-		skb = receive_small(vi, buf, len);
+		skb = receive_small(vi, rq, buf, len);
 
 	if (unlikely(!skb))
 		return;
@@ -788,6 +920,7 @@ again:
 	received += virtnet_receive(rq, budget);
 
 	r = virtqueue_enable_cb_prepare(rq->vq);
+	gro_normal_list(napi);
 	clear_bit(NAPI_STATE_SCHED, &napi->state);
 	if (unlikely(virtqueue_poll(rq->vq, r)) &&
 	    napi_schedule_prep(napi)) {
@@ -828,6 +961,14 @@ static void free_old_xmit_skbs(struct send_queue *sq)
 	struct virtnet_stats *stats = this_cpu_ptr(vi->stats);
 
 	while ((skb = virtqueue_get_buf(sq->vq, &len)) != NULL) {
+		if (virtnet_is_xdp_buf(skb)) {
+			virtnet_free_xdp_buf(skb);
+			u64_stats_update_begin(&stats->tx_syncp);
+			stats->tx_packets++;
+			u64_stats_update_end(&stats->tx_syncp);
+			continue;
+		}
+
 		pr_debug("Sent skb %p\n", skb);
 
 		u64_stats_update_begin(&stats->tx_syncp);
@@ -1386,14 +1527,81 @@ static const struct ethtool_ops virtnet_ethtool_ops = {
 #define MIN_MTU 68
 #define MAX_MTU 65535
 
+static bool virtnet_xdp_attached(struct virtnet_info *vi)
+{
+	return !!rtnl_dereference(vi->rq[0].xdp_prog);
+}
+
 static int virtnet_change_mtu(struct net_device *dev, int new_mtu)
 {
+	struct virtnet_info *vi = netdev_priv(dev);
+
 	if (new_mtu < MIN_MTU || new_mtu > MAX_MTU)
 		return -EINVAL;
+	/* XDP frames must fit in a single receive buffer */
+	if (new_mtu > ETH_DATA_LEN && virtnet_xdp_attached(vi))
+		return -EINVAL;
 	dev->mtu = new_mtu;
 	return 0;
 }
 
+static int virtnet_xdp_set(struct net_device *dev, struct bpf_prog *prog)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+	struct bpf_prog *old_prog;
+	int i;
+
+	if (prog) {
+		if (vi->big_packets && !vi->mergeable_rx_bufs) {
+			netdev_warn(dev, "XDP doesn't support big packets mode\n");
+			return -EOPNOTSUPP;
+		}
+		if (virtio_has_feature(vi->vdev, VIRTIO_NET_F_GUEST_TSO4) ||
+		    virtio_has_feature(vi->vdev, VIRTIO_NET_F_GUEST_TSO6) ||
+		    virtio_has_feature(vi->vdev, VIRTIO_NET_F_GUEST_ECN) ||
+		    virtio_has_feature(vi->vdev, VIRTIO_NET_F_GUEST_UFO)) {
+			netdev_warn(dev, "XDP requires the guest offloads to be off\n");
+			return -EOPNOTSUPP;
+		}
+		if (dev->mtu > ETH_DATA_LEN) {
+			netdev_warn(dev, "XDP requires MTU less than %u\n",
+				    ETH_DATA_LEN + 1);
+			return -EINVAL;
+		}
+
+		/* the caller's reference covers the first queue */
+		if (vi->max_queue_pairs > 1) {
+			prog = bpf_prog_add(prog, vi->max_queue_pairs - 1);
+			if (IS_ERR(prog))
+				return PTR_ERR(prog);
+		}
+	}
+
+	for (i = 0; i < vi->max_queue_pairs; i++) {
+		old_prog = rtnl_dereference(vi->rq[i].xdp_prog);
+		rcu_assign_pointer(vi->rq[i].xdp_prog, prog);
+		if (old_prog)
+			bpf_prog_put_rcu(old_prog);
+	}
+
+	return 0;
+}
+
+static int virtnet_xdp(struct net_device *dev, struct netdev_xdp *xdp)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+
+	switch (xdp->command) {
+	case XDP_SETUP_PROG:
+		return virtnet_xdp_set(dev, xdp->prog);
+	case XDP_QUERY_PROG:
+		xdp->prog_attached = virtnet_xdp_attached(vi);
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
 static const struct net_device_ops virtnet_netdev = {
 	.ndo_open            = virtnet_open,
 	.ndo_stop   	     = virtnet_close,
@@ -1411,6 +1619,7 @@ static const struct net_device_ops virtnet_netdev = {
 #ifdef CONFIG_NET_RX_BUSY_POLL
 	.ndo_busy_poll		= virtnet_busy_poll,
 #endif
+	.ndo_xdp		= virtnet_xdp,
 };
 
 static void virtnet_config_changed_work(struct work_struct *work)
@@ -1454,11 +1663,16 @@ static void virtnet_config_changed(struct virtio_device *vdev)
 
 static void virtnet_free_queues(struct virtnet_info *vi)
 {
+	struct bpf_prog *old_prog;
 	int i;
 
 	for (i = 0; i < vi->max_queue_pairs; i++) {
 		napi_hash_del(&vi->rq[i].napi);
 		netif_napi_del(&vi->rq[i].napi);
+
+		old_prog = rcu_dereference_protected(vi->rq[i].xdp_prog, 1);
+		if (old_prog)
+			bpf_prog_put(old_prog);
 	}
 
 	kfree(vi->rq);
@@ -1490,8 +1704,12 @@ static void free_unused_bufs(struct virtnet_info *vi)
 
 	for (i = 0; i < vi->max_queue_pairs; i++) {
 		struct virtqueue *vq = vi->sq[i].vq;
-		while ((buf = virtqueue_detach_unused_buf(vq)) != NULL)
-			dev_kfree_skb(buf);
+		while ((buf = virtqueue_detach_unused_buf(vq)) != NULL) {
+			if (virtnet_is_xdp_buf(buf))
+				virtnet_free_xdp_buf(buf);
+			else
+				dev_kfree_skb(buf);
+		}
 	}
 
 	for (i = 0; i < vi->max_queue_pairs; i++) {
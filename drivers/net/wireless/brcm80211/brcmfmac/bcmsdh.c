@@ -514,11 +514,10 @@ static int brcmf_sdiod_sglist_rw(struct brcmf_sdio_dev *sdiodev, uint fn,
 	unsigned char *pkt_data, *orig_data, *dst_data;
 	struct sk_buff *pkt_next = NULL, *local_pkt_next;
 	struct sk_buff_head local_list, *target_list;
-	struct mmc_request mmc_req;
-	struct mmc_command mmc_cmd;
-	struct mmc_data mmc_dat;
+	struct sdio_func *func = sdiodev->func[fn];
+	struct sdio_async_req *req;
 	struct scatterlist *sgl;
-	int ret = 0;
+	int ret = 0, err, idx = 0;
 
 	if (!pktlist->qlen)
 		return -EINVAL;
@@ -557,27 +556,15 @@ static int brcmf_sdiod_sglist_rw(struct brcmf_sdio_dev *sdiodev, uint fn,
 	pkt_offset = 0;
 	pkt_next = target_list->next;
 
-	memset(&mmc_req, 0, sizeof(struct mmc_request));
-	memset(&mmc_cmd, 0, sizeof(struct mmc_command));
-	memset(&mmc_dat, 0, sizeof(struct mmc_data));
-
-	mmc_dat.sg = sdiodev->sgtable.sgl;
-	mmc_dat.blksz = func_blk_sz;
-	mmc_dat.flags = write ? MMC_DATA_WRITE : MMC_DATA_READ;
-	mmc_cmd.opcode = SD_IO_RW_EXTENDED;
-	mmc_cmd.arg = write ? 1<<31 : 0;	/* write flag  */
-	mmc_cmd.arg |= (fn & 0x7) << 28;	/* SDIO func num */
-	mmc_cmd.arg |= 1<<27;			/* block mode */
-	/* for function 1 the addr will be incremented */
-	mmc_cmd.arg |= (fn == 1) ? 1<<26 : 0;
-	mmc_cmd.flags = MMC_RSP_SPI_R5 | MMC_RSP_R5 | MMC_CMD_ADTC;
-	mmc_req.cmd = &mmc_cmd;
-	mmc_req.data = &mmc_dat;
-
+	/*
+	 * The packets are sent with as few CMD53s as the host allows. Each
+	 * one is set up on one of two scatterlists while the previous one
+	 * is on the bus, so that the host can map it for DMA meanwhile.
+	 */
 	while (seg_sz) {
 		req_sz = 0;
 		sg_cnt = 0;
-		sgl = sdiodev->sgtable.sgl;
+		sgl = sdiodev->sgtable[idx].sgl;
 		/* prep sg table */
 		while (pkt_next != (struct sk_buff *)target_list) {
 			pkt_data = pkt_next->data + pkt_offset;
@@ -606,31 +593,41 @@ static int brcmf_sdiod_sglist_rw(struct brcmf_sdio_dev *sdiodev, uint fn,
 		if (req_sz % func_blk_sz != 0) {
 			brcmf_err("sg request length %u is not %u aligned\n",
 				  req_sz, func_blk_sz);
+			sdio_start_async_req(func, NULL, &err);
 			ret = -ENOTBLK;
 			goto exit;
 		}
 
-		mmc_dat.sg_len = sg_cnt;
-		mmc_dat.blocks = req_sz / func_blk_sz;
-		mmc_cmd.arg |= (addr & 0x1FFFF) << 9;	/* address */
-		mmc_cmd.arg |= mmc_dat.blocks & 0x1FF;	/* block count */
-		/* incrementing addr for function 1 */
+		/* for function 1 the addr will be incremented */
+		req = &sdiodev->sgreq[idx];
+		err = sdio_prep_async_req(func, req, write, addr & 0x1FFFF,
+					  fn == 1, sdiodev->sgtable[idx].sgl,
+					  sg_cnt, req_sz / func_blk_sz);
+		if (err) {
+			sdio_start_async_req(func, NULL, &err);
+			ret = -EINVAL;
+			goto exit;
+		}
 		if (fn == 1)
 			addr += req_sz;
 
-		mmc_set_data_timeout(&mmc_dat, sdiodev->func[fn]->card);
-		mmc_wait_for_req(sdiodev->func[fn]->card->host, &mmc_req);
-
-		ret = mmc_cmd.error ? mmc_cmd.error : mmc_dat.error;
-		if (ret == -ENOMEDIUM) {
-			brcmf_sdiod_change_state(sdiodev, BRCMF_SDIOD_NOMEDIUM);
+		/* starts this CMD53 once the previous one is done */
+		sdio_start_async_req(func, req, &ret);
+		if (ret)
 			break;
-		} else if (ret != 0) {
-			brcmf_err("CMD53 sg block %s failed %d\n",
-				  write ? "write" : "read", ret);
-			ret = -EIO;
-			break;
-		}
+		idx ^= 1;
+	}
+
+	/* wait for the last CMD53 */
+	if (!ret)
+		sdio_start_async_req(func, NULL, &ret);
+
+	if (ret == -ENOMEDIUM) {
+		brcmf_sdiod_change_state(sdiodev, BRCMF_SDIOD_NOMEDIUM);
+	} else if (ret != 0) {
+		brcmf_err("CMD53 sg block %s failed %d\n",
+			  write ? "write" : "read", ret);
+		ret = -EIO;
 	}
 
 	if (sdiodev->pdata && sdiodev->pdata->broken_sg_support && !write) {
@@ -658,7 +655,8 @@ static int brcmf_sdiod_sglist_rw(struct brcmf_sdio_dev *sdiodev, uint fn,
 	}
 
 exit:
-	sg_init_table(sdiodev->sgtable.sgl, sdiodev->sgtable.orig_nents);
+	sg_init_table(sdiodev->sgtable[0].sgl, sdiodev->sgtable[0].orig_nents);
+	sg_init_table(sdiodev->sgtable[1].sgl, sdiodev->sgtable[1].orig_nents);
 	while ((pkt_next = __skb_dequeue(&local_list)) != NULL)
 		brcmu_pkt_buf_free_skb(pkt_next);
 
@@ -896,7 +894,12 @@ static void brcmf_sdiod_sgtable_alloc(struct brcmf_sdio_dev *sdiodev)
 	WARN_ON(nents > sdiodev->max_segment_count);
 
 	brcmf_dbg(TRACE, "nents=%d\n", nents);
-	err = sg_alloc_table(&sdiodev->sgtable, nents, GFP_KERNEL);
+	err = sg_alloc_table(&sdiodev->sgtable[0], nents, GFP_KERNEL);
+	if (!err) {
+		err = sg_alloc_table(&sdiodev->sgtable[1], nents, GFP_KERNEL);
+		if (err < 0)
+			sg_free_table(&sdiodev->sgtable[0]);
+	}
 	if (err < 0) {
 		brcmf_err("allocation failed: disable scatter-gather");
 		sdiodev->sg_support = false;
@@ -1006,7 +1009,8 @@ static int brcmf_sdiod_remove(struct brcmf_sdio_dev *sdiodev)
 	sdio_disable_func(sdiodev->func[1]);
 	sdio_release_host(sdiodev->func[1]);
 
-	sg_free_table(&sdiodev->sgtable);
+	sg_free_table(&sdiodev->sgtable[0]);
+	sg_free_table(&sdiodev->sgtable[1]);
 	sdiodev->sbwad = 0;
 
 	pm_runtime_allow(sdiodev->func[1]->card->host->parent);
@@ -114,8 +114,17 @@ struct rte_console {
 #define BRCMF_TXBOUND	20	/* Default for max tx frames in
 				 one scheduling */
 
+#define BRCMF_TXBOUND_MAX	128	/* Max tx frames in one scheduling
+				 under sustained load */
+
 #define BRCMF_TXMINMAX	1	/* Max tx frames if rx still pending */
 
+#define BRCMF_RXPOLL_FRAMES	8	/* Rx frames in one scheduling that
+				 switch frame indication to polling */
+#define BRCMF_RXPOLL_IDLE	4	/* Empty polls before switching back
+				 to frame interrupts */
+#define BRCMF_RXPOLL_US		100	/* Interval between two polls */
+
 #define MEMBLOCK	2048	/* Block size used for downloading
 				 of dongle image */
 #define MAX_DATA_BUF	(32 * 1024)	/* Must be large enough to hold
@@ -454,7 +463,10 @@ struct brcmf_sdio {
 
 	uint rxbound;		/* Rx frames to read before resched */
 	uint txbound;		/* Tx frames to send before resched */
+	uint txburst;		/* Current tx limit, adapted to the load */
 	uint txminmax;
+	bool rxpoll;		/* Frame indication is polled by the DPC */
+	uint rxpoll_idle;	/* Polls in a row that found no frames */
 
 	struct sk_buff *glomd;	/* Packet containing glomming descriptor */
 	struct sk_buff_head glom; /* Packet list for glommed superframe */
@@ -2358,6 +2370,23 @@ done:
 	return ret;
 }
 
+/*
+ * Size the next tx glom after the backlog: when more frames are queued than
+ * fit in one glom, they are spread evenly over as few gloms as possible,
+ * rather than sending full gloms followed by a nearly empty one.
+ */
+static u8 brcmf_sdio_txglom_size(struct brcmf_sdio *bus)
+{
+	uint max = min_t(uint, (u8)(bus->tx_max - bus->tx_seq),
+			 bus->sdiodev->txglomsz);
+	uint qlen = brcmu_pktq_mlen(&bus->txq, ~bus->flowcontrol);
+
+	if (!max || qlen <= max)
+		return max;
+
+	return DIV_ROUND_UP(qlen, DIV_ROUND_UP(qlen, max));
+}
+
 static uint brcmf_sdio_sendfromq(struct brcmf_sdio *bus, uint maxframes)
 {
 	struct sk_buff *pkt;
@@ -2375,8 +2404,7 @@ static uint brcmf_sdio_sendfromq(struct brcmf_sdio *bus, uint maxframes)
 	for (cnt = 0; (cnt < maxframes) && data_ok(bus);) {
 		pkt_num = 1;
 		if (bus->txglom)
-			pkt_num = min_t(u8, bus->tx_max - bus->tx_seq,
-					bus->sdiodev->txglomsz);
+			pkt_num = brcmf_sdio_txglom_size(bus);
 		pkt_num = min_t(u32, pkt_num,
 				brcmu_pktq_mlen(&bus->txq, ~bus->flowcontrol));
 		__skb_queue_head_init(&pktq);
@@ -2511,6 +2539,7 @@ static void brcmf_sdio_bus_stop(struct device *dev)
 		w_sdreg32(bus, 0, offsetof(struct sdpcmd_regs, hostintmask));
 		local_hostintmask = bus->hostintmask;
 		bus->hostintmask = 0;
+		bus->rxpoll = false;
 
 		/* Force backplane clocks to assure F2 interrupt propagates */
 		saveclk = brcmf_sdiod_regrb(sdiodev, SBSDIO_FUNC1_CHIPCLKCSR,
@@ -2592,12 +2621,60 @@ static int brcmf_sdio_intr_rstatus(struct brcmf_sdio *bus)
 	return ret;
 }
 
+/*
+ * Interrupt mitigation: once a DPC run reads BRCMF_RXPOLL_FRAMES frames or
+ * more, the frame indication interrupt is masked in the dongle and the data
+ * worker polls for frames itself, until BRCMF_RXPOLL_IDLE polls in a row
+ * find none. The indication stays latched in intstatus while it is masked,
+ * so a frame that comes in meanwhile raises the interrupt on unmasking.
+ */
+static void brcmf_sdio_rxpoll_update(struct brcmf_sdio *bus, uint rxcount)
+{
+	bool poll = bus->rxpoll;
+	u32 hostintmask = bus->hostintmask;
+
+	if (rxcount >= BRCMF_RXPOLL_FRAMES || (poll && rxcount)) {
+		poll = true;
+		bus->rxpoll_idle = 0;
+	} else if (poll && ++bus->rxpoll_idle >= BRCMF_RXPOLL_IDLE) {
+		poll = false;
+	}
+
+	if (poll == bus->rxpoll)
+		return;
+
+	bus->rxpoll = poll;
+	if (poll)
+		hostintmask &= ~I_HMB_FRAME_IND;
+
+	sdio_claim_host(bus->sdiodev->func[1]);
+	w_sdreg32(bus, hostintmask, offsetof(struct sdpcmd_regs, hostintmask));
+	sdio_release_host(bus->sdiodev->func[1]);
+}
+
+/*
+ * Adapt the tx limit of a DPC run to the load: it doubles, up to
+ * BRCMF_TXBOUND_MAX, while runs use all of it and leave frames queued, so
+ * that a sustained stream goes out in full gloms with fewer runs, and
+ * halves back towards txbound when runs use less than half of it.
+ */
+static void brcmf_sdio_txburst_update(struct brcmf_sdio *bus, uint sent)
+{
+	if (sent >= bus->txburst &&
+	    brcmu_pktq_mlen(&bus->txq, ~bus->flowcontrol))
+		bus->txburst = min_t(uint, bus->txburst * 2,
+				     BRCMF_TXBOUND_MAX);
+	else if (sent < bus->txburst / 2)
+		bus->txburst = max_t(uint, bus->txburst / 2, bus->txbound);
+}
+
 static void brcmf_sdio_dpc(struct brcmf_sdio *bus)
 {
 	u32 newstatus = 0;
 	unsigned long intstatus;
-	uint txlimit = bus->txbound;	/* Tx frames to send before resched */
+	uint txlimit = bus->txburst;	/* Tx frames to send before resched */
 	uint framecnt;			/* Temporary counter of tx/rx frames */
+	uint rxcount = 0;
 	int err = 0;
 
 	brcmf_dbg(TRACE, "Enter\n");
@@ -2696,10 +2773,12 @@ static void brcmf_sdio_dpc(struct brcmf_sdio *bus)
 
 	/* On frame indication, read available frames */
 	if ((intstatus & I_HMB_FRAME_IND) && (bus->clkstate == CLK_AVAIL)) {
-		brcmf_sdio_readframes(bus, bus->rxbound);
+		rxcount = brcmf_sdio_readframes(bus, bus->rxbound);
 		if (!bus->rxpending)
 			intstatus &= ~I_HMB_FRAME_IND;
 	}
+	if (bus->sdiodev->state == BRCMF_SDIOD_DATA)
+		brcmf_sdio_rxpoll_update(bus, rxcount);
 
 	/* Keep still-pending events for next scheduling */
 	if (intstatus)
@@ -2724,9 +2803,13 @@ static void brcmf_sdio_dpc(struct brcmf_sdio *bus)
 	if ((bus->clkstate == CLK_AVAIL) && !atomic_read(&bus->fcstate) &&
 	    brcmu_pktq_mlen(&bus->txq, ~bus->flowcontrol) && txlimit &&
 	    data_ok(bus)) {
-		framecnt = bus->rxpending ? min(txlimit, bus->txminmax) :
-					    txlimit;
-		brcmf_sdio_sendfromq(bus, framecnt);
+		if (bus->rxpending) {
+			framecnt = min(txlimit, bus->txminmax);
+			brcmf_sdio_sendfromq(bus, framecnt);
+		} else {
+			framecnt = brcmf_sdio_sendfromq(bus, txlimit);
+			brcmf_sdio_txburst_update(bus, framecnt);
+		}
 	}
 
 	if ((bus->sdiodev->state != BRCMF_SDIOD_DATA) || (err != 0)) {
@@ -3662,6 +3745,15 @@ static void brcmf_sdio_dataworker(struct work_struct *work)
 		bus->dpc_triggered = false;
 		brcmf_sdio_dpc(bus);
 		bus->idlecount = 0;
+
+		/* Poll for frames while their interrupt is masked */
+		if (bus->rxpoll && !ACCESS_ONCE(bus->dpc_triggered) &&
+		    bus->sdiodev->state == BRCMF_SDIOD_DATA &&
+		    !brcmf_sdiod_freezing(bus->sdiodev)) {
+			usleep_range(BRCMF_RXPOLL_US, 2 * BRCMF_RXPOLL_US);
+			atomic_set(&bus->ipend, 1);
+			bus->dpc_triggered = true;
+		}
 	}
 	bus->dpc_running = false;
 	if (brcmf_sdiod_freezing(bus->sdiodev)) {
@@ -4042,6 +4134,7 @@ static void brcmf_sdio_firmware_callback(struct device *dev,
 	if (!err) {
 		/* Set up the interrupt mask and enable interrupts */
 		bus->hostintmask = HOSTINTMASK;
+		bus->rxpoll = false;
 		w_sdreg32(bus, bus->hostintmask,
 			  offsetof(struct sdpcmd_regs, hostintmask));
 
@@ -4103,6 +4196,7 @@ struct brcmf_sdio *brcmf_sdio_probe(struct brcmf_sdio_dev *sdiodev)
 	sdiodev->bus = bus;
 	skb_queue_head_init(&bus->glom);
 	bus->txbound = BRCMF_TXBOUND;
+	bus->txburst = BRCMF_TXBOUND;
 	bus->rxbound = BRCMF_RXBOUND;
 	bus->txminmax = BRCMF_TXMINMAX;
 	bus->tx_seq = SDPCM_SEQ_WRAP - 1;
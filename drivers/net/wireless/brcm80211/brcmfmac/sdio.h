@@ -19,6 +19,7 @@
 
 #include <linux/skbuff.h>
 #include <linux/firmware.h>
+#include <linux/mmc/sdio_func.h>
 #include "firmware.h"
 
 #define SDIO_FUNC_0		0
@@ -194,7 +195,8 @@ struct brcmf_sdio_dev {
 	ushort max_segment_count;
 	uint max_segment_size;
 	uint txglomsz;
-	struct sg_table sgtable;
+	struct sg_table sgtable[2];
+	struct sdio_async_req sgreq[2];
 	char fw_name[BRCMF_FW_PATH_LEN + BRCMF_FW_NAME_LEN];
 	char nvram_name[BRCMF_FW_PATH_LEN + BRCMF_FW_NAME_LEN];
 	bool wowl_enabled;
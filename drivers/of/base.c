@@ -20,6 +20,7 @@
 #include <linux/console.h>
 #include <linux/ctype.h>
 #include <linux/cpu.h>
+#include <linux/log2.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_graph.h>
@@ -54,6 +55,16 @@ DEFINE_MUTEX(of_mutex);
  */
 DEFINE_RAW_SPINLOCK(devtree_lock);
 
+/*
+ * Direct mapped cache of phandle lookups, indexed by the low bits of the
+ * phandle and sized for the phandles present once the core is initialised.
+ * An entry holds no reference: it is only used under devtree_lock, after
+ * checking it still has the phandle looked for, and cleared when its node
+ * is detached.
+ */
+static struct device_node **phandle_cache;
+static u32 phandle_cache_mask;
+
 int of_n_addr_cells(struct device_node *np)
 {
 	const __be32 *ip;
@@ -189,10 +200,58 @@ int __of_attach_node_sysfs(struct device_node *np)
 	return 0;
 }
 
+static void __init of_populate_phandle_cache(void)
+{
+	struct device_node **cache, *np;
+	unsigned long flags;
+	u32 count = 0;
+
+	raw_spin_lock_irqsave(&devtree_lock, flags);
+	for_each_of_allnodes(np)
+		if (np->phandle)
+			count++;
+	raw_spin_unlock_irqrestore(&devtree_lock, flags);
+
+	if (!count)
+		return;
+
+	count = roundup_pow_of_two(count);
+	cache = kcalloc(count, sizeof(*cache), GFP_KERNEL);
+	if (!cache)
+		return;
+
+	raw_spin_lock_irqsave(&devtree_lock, flags);
+	for_each_of_allnodes(np)
+		if (np->phandle)
+			cache[np->phandle & (count - 1)] = np;
+	phandle_cache_mask = count - 1;
+	phandle_cache = cache;
+	raw_spin_unlock_irqrestore(&devtree_lock, flags);
+}
+
+/* Called with devtree_lock held, @np and its children are going away */
+void __of_phandle_cache_inv(struct device_node *np)
+{
+	struct device_node *child;
+	u32 entry;
+
+	if (!phandle_cache)
+		return;
+
+	entry = np->phandle & phandle_cache_mask;
+	if (phandle_cache[entry] == np)
+		phandle_cache[entry] = NULL;
+
+	for (child = np->child; child; child = child->sibling)
+		__of_phandle_cache_inv(child);
+}
+
 void __init of_core_init(void)
 {
 	struct device_node *np;
 
+	of_populate_phandle_cache();
+
 	/* Create the kset, and register existing nodes */
 	mutex_lock(&of_mutex);
 	of_kset = kset_create_and_add("devicetree", NULL, firmware_kobj);
@@ -1064,16 +1123,27 @@ EXPORT_SYMBOL_GPL(of_modalias_node);
  */
 struct device_node *of_find_node_by_phandle(phandle handle)
 {
-	struct device_node *np;
+	struct device_node *np = NULL;
 	unsigned long flags;
+	u32 entry;
 
 	if (!handle)
 		return NULL;
 
+	entry = handle & phandle_cache_mask;
+
 	raw_spin_lock_irqsave(&devtree_lock, flags);
-	for_each_of_allnodes(np)
-		if (np->phandle == handle)
-			break;
+	if (phandle_cache && phandle_cache[entry] &&
+	    phandle_cache[entry]->phandle == handle)
+		np = phandle_cache[entry];
+
+	if (!np) {
+		for_each_of_allnodes(np)
+			if (np->phandle == handle)
+				break;
+		if (np && phandle_cache)
+			phandle_cache[entry] = np;
+	}
 	of_node_get(np);
 	raw_spin_unlock_irqrestore(&devtree_lock, flags);
 	return np;
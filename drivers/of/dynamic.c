@@ -281,6 +281,7 @@ void __of_detach_node(struct device_node *np)
 		prevsib->sibling = np->sibling;
 	}
 
+	__of_phandle_cache_inv(np);
 	of_node_set_flag(np, OF_DETACHED);
 }
 
@@ -80,6 +80,7 @@ extern void __of_attach_node(struct device_node *np);
 extern int __of_attach_node_sysfs(struct device_node *np);
 extern void __of_detach_node(struct device_node *np);
 extern void __of_detach_node_sysfs(struct device_node *np);
+extern void __of_phandle_cache_inv(struct device_node *np);
 
 /* iterators for transactions, used for overlays */
 /* forward iterator */
@@ -162,6 +162,11 @@ again:
 	return new_raw_count;
 }
 
+static bool armpmu_event_user_access(struct perf_event *event)
+{
+	return event->attr.config1 & ARMPMU_EVT_USER_ACCESS;
+}
+
 static void
 armpmu_read(struct perf_event *event)
 {
@@ -223,6 +228,10 @@ armpmu_del(struct perf_event *event, int flags)
 	if (armpmu->clear_event_idx)
 		armpmu->clear_event_idx(hw_events, event);
 
+	if (armpmu_event_user_access(event) &&
+	    --hw_events->user_access_events == 0)
+		armpmu->set_user_access(false);
+
 	perf_event_update_userpage(event);
 }
 
@@ -256,6 +265,10 @@ armpmu_add(struct perf_event *event, int flags)
 	armpmu->disable(event);
 	hw_events->events[idx] = event;
 
+	if (armpmu_event_user_access(event) &&
+	    hw_events->user_access_events++ == 0)
+		armpmu->set_user_access(true);
+
 	hwc->state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
 	if (flags & PERF_EF_START)
 		armpmu_start(event, PERF_EF_RELOAD);
@@ -474,6 +487,13 @@ static int armpmu_event_init(struct perf_event *event)
 	if (armpmu->map_event(event) == -ENOENT)
 		return -ENOENT;
 
+	if (armpmu_event_user_access(event)) {
+		if (!armpmu->set_user_access)
+			return -EOPNOTSUPP;
+		if (!armpmu->user_access)
+			return -EPERM;
+	}
+
 	event->destroy = hw_perf_event_destroy;
 
 	if (!atomic_inc_not_zero(active_events)) {
@@ -533,6 +553,81 @@ static int armpmu_filter_match(struct perf_event *event)
 	return cpumask_test_cpu(cpu, &armpmu->supported_cpus);
 }
 
+static int armpmu_event_idx(struct perf_event *event)
+{
+	if (!armpmu_event_user_access(event))
+		return 0;
+
+	return event->hw.idx + 1;
+}
+
+void arch_perf_update_userpage(struct perf_event *event,
+			       struct perf_event_mmap_page *userpg, u64 now)
+{
+	u64 prev;
+
+	if (event->pmu->event_idx != armpmu_event_idx)
+		return;
+
+	userpg->cap_user_rdpmc = !!userpg->index;
+	userpg->pmc_width = 32;
+	if (!userpg->index)
+		return;
+
+	/*
+	 * prev_count is either -left from armpmu_event_set_period() or a
+	 * zero extended raw count from armpmu_event_update().  Userspace
+	 * sign extends the counter, so base the offset on the sign extended
+	 * value in both cases.
+	 */
+	prev = local64_read(&event->hw.prev_count);
+	userpg->offset += prev - (u64)(s64)(s32)prev;
+}
+
+static ssize_t rdpmc_show(struct device *dev,
+			  struct device_attribute *attr, char *buf)
+{
+	struct arm_pmu *armpmu = to_arm_pmu(dev_get_drvdata(dev));
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", armpmu->user_access);
+}
+
+static ssize_t rdpmc_store(struct device *dev,
+			   struct device_attribute *attr,
+			   const char *buf, size_t count)
+{
+	struct arm_pmu *armpmu = to_arm_pmu(dev_get_drvdata(dev));
+	bool val;
+	int ret;
+
+	ret = strtobool(buf, &val);
+	if (ret)
+		return ret;
+
+	if (!armpmu->set_user_access)
+		return -EOPNOTSUPP;
+
+	/* events already granted access keep it until they are closed */
+	armpmu->user_access = val;
+
+	return count;
+}
+static DEVICE_ATTR_RW(rdpmc);
+
+static struct attribute *armpmu_common_attrs[] = {
+	&dev_attr_rdpmc.attr,
+	NULL,
+};
+
+static struct attribute_group armpmu_common_attr_group = {
+	.attrs = armpmu_common_attrs,
+};
+
+static const struct attribute_group *armpmu_attr_groups[] = {
+	&armpmu_common_attr_group,
+	NULL,
+};
+
 static void armpmu_init(struct arm_pmu *armpmu)
 {
 	atomic_set(&armpmu->active_events, 0);
@@ -548,6 +643,8 @@ static void armpmu_init(struct arm_pmu *armpmu)
 		.stop		= armpmu_stop,
 		.read		= armpmu_read,
 		.filter_match	= armpmu_filter_match,
+		.event_idx	= armpmu_event_idx,
+		.attr_groups	= armpmu_attr_groups,
 	};
 }
 
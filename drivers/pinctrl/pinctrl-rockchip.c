@@ -103,6 +103,9 @@ struct rockchip_iomux {
  * @gpio_chip: gpiolib chip
  * @grange: gpio range
  * @slock: spinlock for the gpio bank
+ * @mux_cache: last mux value written per pin, RK_PIN_CACHE_INVALID if unknown
+ * @pull_cache: last pull register value written per pin
+ * @drv_cache: last drive strength register value written per pin
  */
 struct rockchip_pin_bank {
 	void __iomem			*reg_base;
@@ -123,8 +126,13 @@ struct rockchip_pin_bank {
 	struct pinctrl_gpio_range	grange;
 	spinlock_t			slock;
 	u32				toggle_edge_mode;
+	u8				mux_cache[32];
+	u8				pull_cache[32];
+	u8				drv_cache[32];
 };
 
+#define RK_PIN_CACHE_INVALID		0xff
+
 #define PIN_BANK(id, pins, label)			\
 	{						\
 		.bank_num	= id,			\
@@ -423,6 +431,65 @@ static int rockchip_get_mux(struct rockchip_pin_bank *bank, int pin)
 	return ((val >> bit) & mask);
 }
 
+/*
+ * All GRF/PMU pin registers take a write-enable mask in their upper 16 bits,
+ * so updates never need to read the register back and updates of several
+ * pins sharing a register can be merged into a single write.
+ */
+struct rockchip_grf_batch {
+	struct regmap			*regmap;
+	int				reg;
+	u32				data;
+};
+
+static int rockchip_grf_batch_flush(struct rockchip_grf_batch *batch)
+{
+	int ret;
+
+	if (!batch->regmap)
+		return 0;
+
+	ret = regmap_write(batch->regmap, batch->reg, batch->data);
+	batch->regmap = NULL;
+	batch->data = 0;
+
+	return ret;
+}
+
+static int rockchip_grf_batch_add(struct rockchip_grf_batch *batch,
+				  struct regmap *regmap, int reg, u32 data)
+{
+	int ret = 0;
+
+	if (batch->regmap && (batch->regmap != regmap || batch->reg != reg))
+		ret = rockchip_grf_batch_flush(batch);
+
+	batch->regmap = regmap;
+	batch->reg = reg;
+	batch->data |= data;
+
+	return ret;
+}
+
+static void rockchip_pinctrl_invalidate_cache(struct rockchip_pinctrl *info)
+{
+	struct rockchip_pin_ctrl *ctrl = info->ctrl;
+	struct rockchip_pin_bank *bank = ctrl->pin_banks;
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < ctrl->nr_banks; ++i, ++bank) {
+		spin_lock_irqsave(&bank->slock, flags);
+		memset(bank->mux_cache, RK_PIN_CACHE_INVALID,
+		       sizeof(bank->mux_cache));
+		memset(bank->pull_cache, RK_PIN_CACHE_INVALID,
+		       sizeof(bank->pull_cache));
+		memset(bank->drv_cache, RK_PIN_CACHE_INVALID,
+		       sizeof(bank->drv_cache));
+		spin_unlock_irqrestore(&bank->slock, flags);
+	}
+}
+
 /*
  * Set a new mux function for a pin.
  *
@@ -432,11 +499,15 @@ static int rockchip_get_mux(struct rockchip_pin_bank *bank, int pin)
  * changed value gets set in the same offset in the lower 16 bit.
  * All pin settings seem to be 2 bit wide in both the upper and lower
  * parts.
+ * The write is added to @batch, the caller flushes it. Pins already set to
+ * @mux are skipped.
  * @bank: pin bank to change
  * @pin: pin to change
  * @mux: new mux function to set
+ * @batch: pending register write to merge into
  */
-static int rockchip_set_mux(struct rockchip_pin_bank *bank, int pin, int mux)
+static int rockchip_set_mux_batch(struct rockchip_pin_bank *bank, int pin,
+				  int mux, struct rockchip_grf_batch *batch)
 {
 	struct rockchip_pinctrl *info = bank->drvdata;
 	int iomux_num = (pin / 8);
@@ -444,7 +515,7 @@ static int rockchip_set_mux(struct rockchip_pin_bank *bank, int pin, int mux)
 	int reg, ret, mask;
 	unsigned long flags;
 	u8 bit;
-	u32 data, rmask;
+	u32 data;
 
 	if (iomux_num > 3)
 		return -EINVAL;
@@ -483,16 +554,33 @@ static int rockchip_set_mux(struct rockchip_pin_bank *bank, int pin, int mux)
 
 	spin_lock_irqsave(&bank->slock, flags);
 
+	if (bank->mux_cache[pin] == (mux & mask)) {
+		spin_unlock_irqrestore(&bank->slock, flags);
+		return 0;
+	}
+
 	data = (mask << (bit + 16));
-	rmask = data | (data >> 16);
 	data |= (mux & mask) << bit;
-	ret = regmap_update_bits(regmap, reg, rmask, data);
+	ret = rockchip_grf_batch_add(batch, regmap, reg, data);
+	bank->mux_cache[pin] = ret ? RK_PIN_CACHE_INVALID : (mux & mask);
 
 	spin_unlock_irqrestore(&bank->slock, flags);
 
 	return ret;
 }
 
+static int rockchip_set_mux(struct rockchip_pin_bank *bank, int pin, int mux)
+{
+	struct rockchip_grf_batch batch = { NULL };
+	int ret;
+
+	ret = rockchip_set_mux_batch(bank, pin, mux, &batch);
+	if (ret)
+		return ret;
+
+	return rockchip_grf_batch_flush(&batch);
+}
+
 #define RK2928_PULL_OFFSET		0x118
 #define RK2928_PULL_PINS_PER_REG	16
 #define RK2928_PULL_BANK_STRIDE		8
@@ -708,7 +796,7 @@ static int rockchip_set_drive_perpin(struct rockchip_pin_bank *bank,
 	struct regmap *regmap;
 	unsigned long flags;
 	int reg, ret, i;
-	u32 data, rmask;
+	u32 data;
 	u8 bit;
 
 	ctrl->drv_calc_reg(bank, pin_num, &regmap, &reg, &bit);
@@ -729,12 +817,19 @@ static int rockchip_set_drive_perpin(struct rockchip_pin_bank *bank,
 
 	spin_lock_irqsave(&bank->slock, flags);
 
+	if (bank->drv_cache[pin_num] == ret) {
+		spin_unlock_irqrestore(&bank->slock, flags);
+		return 0;
+	}
+	bank->drv_cache[pin_num] = ret;
+
 	/* enable the write to the equivalent lower bits */
 	data = ((1 << RK3288_DRV_BITS_PER_PIN) - 1) << (bit + 16);
-	rmask = data | (data >> 16);
 	data |= (ret << bit);
 
-	ret = regmap_update_bits(regmap, reg, rmask, data);
+	ret = regmap_write(regmap, reg, data);
+	if (ret)
+		bank->drv_cache[pin_num] = RK_PIN_CACHE_INVALID;
 	spin_unlock_irqrestore(&bank->slock, flags);
 
 	return ret;
@@ -798,7 +893,7 @@ static int rockchip_set_pull(struct rockchip_pin_bank *bank,
 	int reg, ret;
 	unsigned long flags;
 	u8 bit;
-	u32 data, rmask;
+	u32 data;
 
 	dev_dbg(info->dev, "setting pull of GPIO%d-%d to %d\n",
 		 bank->bank_num, pin_num, pull);
@@ -816,7 +911,13 @@ static int rockchip_set_pull(struct rockchip_pin_bank *bank,
 		data = BIT(bit + 16);
 		if (pull == PIN_CONFIG_BIAS_DISABLE)
 			data |= BIT(bit);
-		ret = regmap_write(regmap, reg, data);
+
+		ret = 0;
+		if (bank->pull_cache[pin_num] != !!(data & BIT(bit))) {
+			ret = regmap_write(regmap, reg, data);
+			bank->pull_cache[pin_num] = ret ? RK_PIN_CACHE_INVALID :
+						    !!(data & BIT(bit));
+		}
 
 		spin_unlock_irqrestore(&bank->slock, flags);
 		break;
@@ -827,7 +928,6 @@ static int rockchip_set_pull(struct rockchip_pin_bank *bank,
 
 		/* enable the write to the equivalent lower bits */
 		data = ((1 << RK3188_PULL_BITS_PER_PIN) - 1) << (bit + 16);
-		rmask = data | (data >> 16);
 
 		switch (pull) {
 		case PIN_CONFIG_BIAS_DISABLE:
@@ -848,7 +948,12 @@ static int rockchip_set_pull(struct rockchip_pin_bank *bank,
 			return -EINVAL;
 		}
 
-		ret = regmap_update_bits(regmap, reg, rmask, data);
+		ret = 0;
+		if (bank->pull_cache[pin_num] != (data & 0xffff) >> bit) {
+			ret = regmap_write(regmap, reg, data);
+			bank->pull_cache[pin_num] = ret ? RK_PIN_CACHE_INVALID :
+						    (data & 0xffff) >> bit;
+		}
 
 		spin_unlock_irqrestore(&bank->slock, flags);
 		break;
@@ -897,6 +1002,7 @@ static int rockchip_pmx_set(struct pinctrl_dev *pctldev, unsigned selector,
 	struct rockchip_pinctrl *info = pinctrl_dev_get_drvdata(pctldev);
 	const unsigned int *pins = info->groups[group].pins;
 	const struct rockchip_pin_config *data = info->groups[group].data;
+	struct rockchip_grf_batch batch = { NULL };
 	struct rockchip_pin_bank *bank;
 	int cnt, ret = 0;
 
@@ -905,17 +1011,23 @@ static int rockchip_pmx_set(struct pinctrl_dev *pctldev, unsigned selector,
 
 	/*
 	 * for each pin in the pin group selected, program the correspoding pin
-	 * pin function number in the config register.
+	 * pin function number in the config register. Group pins usually sit
+	 * next to each other, so neighbours in one register share a write.
 	 */
 	for (cnt = 0; cnt < info->groups[group].npins; cnt++) {
 		bank = pin_to_bank(info, pins[cnt]);
-		ret = rockchip_set_mux(bank, pins[cnt] - bank->pin_base,
-				       data[cnt].func);
+		ret = rockchip_set_mux_batch(bank, pins[cnt] - bank->pin_base,
+					     data[cnt].func, &batch);
 		if (ret)
 			break;
 	}
 
+	if (!ret)
+		ret = rockchip_grf_batch_flush(&batch);
+
 	if (ret) {
+		rockchip_pinctrl_invalidate_cache(info);
+
 		/* revert the already done pin settings */
 		for (cnt--; cnt >= 0; cnt--)
 			rockchip_set_mux(bank, pins[cnt] - bank->pin_base, 0);
@@ -1404,6 +1516,31 @@ static void rockchip_gpio_set(struct gpio_chip *gc, unsigned offset, int value)
 	clk_disable(bank->clk);
 }
 
+/*
+ * All 32 outputs of a bank live in one data register, so any set of lines
+ * can change in a single read-modify-write and switch at the same moment.
+ */
+static void rockchip_gpio_set_multiple(struct gpio_chip *gc,
+				       unsigned long *mask,
+				       unsigned long *bits)
+{
+	struct rockchip_pin_bank *bank = gc_to_pin_bank(gc);
+	void __iomem *reg = bank->reg_base + GPIO_SWPORT_DR;
+	unsigned long flags;
+	u32 data;
+
+	clk_enable(bank->clk);
+	spin_lock_irqsave(&bank->slock, flags);
+
+	data = readl(reg);
+	data &= ~*mask;
+	data |= *bits & *mask;
+	writel(data, reg);
+
+	spin_unlock_irqrestore(&bank->slock, flags);
+	clk_disable(bank->clk);
+}
+
 /*
  * Returns the level of the pin for input direction and setting of the DR
  * register for output gpios.
@@ -1464,6 +1601,7 @@ static const struct gpio_chip rockchip_gpiolib_chip = {
 	.request = rockchip_gpio_request,
 	.free = rockchip_gpio_free,
 	.set = rockchip_gpio_set,
+	.set_multiple = rockchip_gpio_set_multiple,
 	.get = rockchip_gpio_get,
 	.direction_input = rockchip_gpio_direction_input,
 	.direction_output = rockchip_gpio_direction_output,
@@ -1899,6 +2037,12 @@ static struct rockchip_pin_ctrl *rockchip_pinctrl_get_soc_data(
 		int bank_pins = 0;
 
 		spin_lock_init(&bank->slock);
+		memset(bank->mux_cache, RK_PIN_CACHE_INVALID,
+		       sizeof(bank->mux_cache));
+		memset(bank->pull_cache, RK_PIN_CACHE_INVALID,
+		       sizeof(bank->pull_cache));
+		memset(bank->drv_cache, RK_PIN_CACHE_INVALID,
+		       sizeof(bank->drv_cache));
 		bank->drvdata = d;
 		bank->pin_base = ctrl->nr_pins;
 		ctrl->nr_pins += bank->nr_pins;
@@ -1981,6 +2125,9 @@ static int __maybe_unused rockchip_pinctrl_resume(struct device *dev)
 	if (ret)
 		return ret;
 
+	/* the GRF may have been touched while asleep, write everything */
+	rockchip_pinctrl_invalidate_cache(info);
+
 	return pinctrl_force_default(info->pctl_dev);
 }
 
@@ -33,6 +33,7 @@
 struct rockchip_pwm_chip {
 	struct pwm_chip chip;
 	struct clk *clk;
+	unsigned long clk_rate;
 	const struct rockchip_pwm_data *data;
 	void __iomem *base;
 };
@@ -102,11 +103,12 @@ static int rockchip_pwm_config(struct pwm_chip *chip, struct pwm_device *pwm,
 			       int duty_ns, int period_ns)
 {
 	struct rockchip_pwm_chip *pc = to_rockchip_pwm_chip(chip);
-	unsigned long period, duty;
+	unsigned long period, duty, old_period;
 	u64 clk_rate, div;
 	int ret;
 
-	clk_rate = clk_get_rate(pc->clk);
+	/* cached at probe, clk_get_rate() may sleep */
+	clk_rate = pc->clk_rate;
 
 	/*
 	 * Since period and duty cycle registers have a width of 32
@@ -125,9 +127,24 @@ static int rockchip_pwm_config(struct pwm_chip *chip, struct pwm_device *pwm,
 	if (ret)
 		return ret;
 
-	writel(period, pc->base + pc->data->regs.period);
-	writel(duty, pc->base + pc->data->regs.duty);
-	writel(0, pc->base + pc->data->regs.cntr);
+	/*
+	 * In continuous mode the counter picks up new period and duty
+	 * values when it wraps, so a running PWM must not have its counter
+	 * reset or the current period is cut short. The two registers can
+	 * still straddle a wrap, so order the writes such that the duty
+	 * never exceeds the period in between.
+	 */
+	old_period = readl_relaxed(pc->base + pc->data->regs.period);
+	if (period >= old_period) {
+		writel(period, pc->base + pc->data->regs.period);
+		writel(duty, pc->base + pc->data->regs.duty);
+	} else {
+		writel(duty, pc->base + pc->data->regs.duty);
+		writel(period, pc->base + pc->data->regs.period);
+	}
+
+	if (!pwm_is_enabled(pwm))
+		writel(0, pc->base + pc->data->regs.cntr);
 
 	clk_disable(pc->clk);
 
@@ -257,6 +274,8 @@ static int rockchip_pwm_probe(struct platform_device *pdev)
 	if (ret)
 		return ret;
 
+	pc->clk_rate = clk_get_rate(pc->clk);
+
 	platform_set_drvdata(pdev, pc);
 
 	pc->data = id->data;
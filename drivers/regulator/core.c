@@ -2684,9 +2684,18 @@ static int _regulator_do_set_voltage(struct regulator_dev *rdev,
 		ret = -EINVAL;
 	}
 
-	/* Call set_voltage_time_sel if successfully obtained old_selector */
+	/*
+	 * Call set_voltage_time_sel if successfully obtained old_selector.
+	 * Consumers lowering their voltage are done with the higher one, so
+	 * if the constraints allow it, don't wait for the output to decay:
+	 * the delay of a later raise, timed from the new selector, can then
+	 * only be overestimated.
+	 */
 	if (ret == 0 && !rdev->constraints->ramp_disable && old_selector >= 0
-		&& old_selector != selector) {
+		&& old_selector != selector &&
+	    !(rdev->constraints->ramp_down_nowait &&
+	      rdev->desc->ops->list_voltage &&
+	      best_val < rdev->desc->ops->list_voltage(rdev, old_selector))) {
 
 		delay = rdev->desc->ops->set_voltage_time_sel(rdev,
 						old_selector, selector);
@@ -2696,13 +2705,9 @@ static int _regulator_do_set_voltage(struct regulator_dev *rdev,
 			delay = 0;
 		}
 
-		/* Insert any necessary delays */
-		if (delay >= 1000) {
-			mdelay(delay / 1000);
-			udelay(delay % 1000);
-		} else if (delay) {
-			udelay(delay);
-		}
+		/* Insert any necessary delays, we hold a mutex so can sleep */
+		if (delay)
+			_regulator_enable_delay(delay);
 	}
 
 	if (ret == 0 && best_val >= 0) {
@@ -84,6 +84,9 @@ static void of_get_regulation_constraints(struct device_node *np,
 			constraints->ramp_disable = true;
 	}
 
+	constraints->ramp_down_nowait = of_property_read_bool(np,
+					"regulator-ramp-down-nowait");
+
 	ret = of_property_read_u32(np, "regulator-enable-ramp-delay", &pval);
 	if (!ret)
 		constraints->enable_time = pval;
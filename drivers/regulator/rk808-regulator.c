@@ -55,6 +55,10 @@
 /* max steps for increase voltage of Buck1/2, equal 100mv*/
 #define MAX_STEPS_ONE_TIME 8
 
+/* writes needed to ramp Buck1/2 across the whole selector range */
+#define MAX_RAMP_WRITES \
+	DIV_ROUND_UP(RK808_BUCK_VSEL_MASK + 1, MAX_STEPS_ONE_TIME)
+
 struct rk808_regulator_data {
 	struct gpio_desc *dvs_gpio[2];
 };
@@ -113,7 +117,8 @@ static int rk808_buck1_2_get_voltage_sel_regmap(struct regulator_dev *rdev)
 static int rk808_buck1_2_i2c_set_voltage_sel(struct regulator_dev *rdev,
 					     unsigned sel)
 {
-	int ret, delta_sel;
+	struct reg_sequence seq[MAX_RAMP_WRITES];
+	int ret, delta_sel, n = 0;
 	unsigned int old_sel, tmp, val, mask = rdev->desc->vsel_mask;
 
 	ret = regmap_read(rdev->regmap, rdev->desc->vsel_reg, &val);
@@ -137,17 +142,26 @@ static int rk808_buck1_2_i2c_set_voltage_sel(struct regulator_dev *rdev,
 
 		/*
 		 * i2c is 400kHz (2.5us per bit) and we must transmit _at least_
-		 * 3 bytes (24 bits) plus start and stop so 26 bits.  So we've
-		 * got more than 65 us between each voltage change and thus
-		 * won't ramp faster than ~1500 uV / us.
+		 * 3 bytes (24 bits) plus a (repeated) start so 25 bits.  So
+		 * we've got more than 60 us between each voltage change and
+		 * thus won't ramp faster than ~1600 uV / us.
 		 */
-		ret = regmap_write(rdev->regmap, rdev->desc->vsel_reg, val);
+		seq[n].reg = rdev->desc->vsel_reg;
+		seq[n].def = val;
+		seq[n].delay_us = 0;
+		n++;
 		delta_sel = sel - old_sel;
 	}
 
 	sel <<= ffs(mask) - 1;
 	val = tmp | sel;
-	ret = regmap_write(rdev->regmap, rdev->desc->vsel_reg, val);
+	seq[n].reg = rdev->desc->vsel_reg;
+	seq[n].def = val;
+	seq[n].delay_us = 0;
+	n++;
+
+	/* all steps go out in a single i2c transaction */
+	ret = regmap_multi_reg_write(rdev->regmap, seq, n);
 
 	/*
 	 * When we change the voltage register directly, the ramp rate is about
@@ -148,6 +148,9 @@
 /* sclk_out: spi master internal logic in rk3x can support 50Mhz */
 #define MAX_SCLK_OUT		50000000
 
+/* transfers shorter than this on the wire are done by PIO */
+#define PIO_MAX_NSECS		(10 * NSEC_PER_USEC)
+
 enum rockchip_ssi_type {
 	SSI_MOTO_SPI = 0,
 	SSI_TI_SSP,
@@ -158,6 +161,10 @@ struct rockchip_spi_dma_data {
 	struct dma_chan *ch;
 	enum dma_transfer_direction direction;
 	dma_addr_t addr;
+	/* word size the channel is configured for, 0 if not configured */
+	u8 n_bytes;
+	/* burst length in words the channel is configured for */
+	u32 maxburst;
 };
 
 struct rockchip_spi {
@@ -405,11 +412,13 @@ static void rockchip_spi_dma_rxcb(void *data)
 
 	spin_lock_irqsave(&rs->lock, flags);
 
-	rs->state &= ~RXBUSY;
-	if (!(rs->state & TXBUSY)) {
-		spi_enable_chip(rs, 0);
-		spi_finalize_current_transfer(rs->master);
-	}
+	/*
+	 * Every word received has been sent before, so in full duplex mode
+	 * the tx side is done as well and has no callback of its own.
+	 */
+	rs->state &= ~(RXBUSY | TXBUSY);
+	spi_enable_chip(rs, 0);
+	spi_finalize_current_transfer(rs->master);
 
 	spin_unlock_irqrestore(&rs->lock, flags);
 }
@@ -433,6 +442,24 @@ static void rockchip_spi_dma_txcb(void *data)
 	spin_unlock_irqrestore(&rs->lock, flags);
 }
 
+/*
+ * The rx DMA request is raised once the FIFO holds a whole burst, so the
+ * burst must divide the transfer evenly. Longer bursts cut the number of
+ * DMA requests per word, which is what limits large flash reads.
+ */
+static u32 rockchip_spi_calc_burst_size(u32 data_len)
+{
+	u32 i;
+
+	/* burst size: 1, 2, 4, 8 */
+	for (i = 1; i < 8; i <<= 1) {
+		if (data_len & i)
+			break;
+	}
+
+	return i;
+}
+
 static void rockchip_spi_prepare_dma(struct rockchip_spi *rs)
 {
 	unsigned long flags;
@@ -446,11 +473,20 @@ static void rockchip_spi_prepare_dma(struct rockchip_spi *rs)
 
 	rxdesc = NULL;
 	if (rs->rx) {
-		rxconf.direction = rs->dma_rx.direction;
-		rxconf.src_addr = rs->dma_rx.addr;
-		rxconf.src_addr_width = rs->n_bytes;
-		rxconf.src_maxburst = rs->n_bytes;
-		dmaengine_slave_config(rs->dma_rx.ch, &rxconf);
+		u32 burst = rockchip_spi_calc_burst_size(rs->len / rs->n_bytes);
+
+		/* only the word and burst size change between transfers */
+		if (rs->dma_rx.n_bytes != rs->n_bytes ||
+		    rs->dma_rx.maxburst != burst) {
+			memset(&rxconf, 0, sizeof(rxconf));
+			rxconf.direction = rs->dma_rx.direction;
+			rxconf.src_addr = rs->dma_rx.addr;
+			rxconf.src_addr_width = rs->n_bytes;
+			rxconf.src_maxburst = burst;
+			dmaengine_slave_config(rs->dma_rx.ch, &rxconf);
+			rs->dma_rx.n_bytes = rs->n_bytes;
+			rs->dma_rx.maxburst = burst;
+		}
 
 		rxdesc = dmaengine_prep_slave_sg(
 				rs->dma_rx.ch,
@@ -463,19 +499,27 @@ static void rockchip_spi_prepare_dma(struct rockchip_spi *rs)
 
 	txdesc = NULL;
 	if (rs->tx) {
-		txconf.direction = rs->dma_tx.direction;
-		txconf.dst_addr = rs->dma_tx.addr;
-		txconf.dst_addr_width = rs->n_bytes;
-		txconf.dst_maxburst = rs->n_bytes;
-		dmaengine_slave_config(rs->dma_tx.ch, &txconf);
+		if (rs->dma_tx.n_bytes != rs->n_bytes) {
+			memset(&txconf, 0, sizeof(txconf));
+			txconf.direction = rs->dma_tx.direction;
+			txconf.dst_addr = rs->dma_tx.addr;
+			txconf.dst_addr_width = rs->n_bytes;
+			txconf.dst_maxburst = rs->n_bytes;
+			dmaengine_slave_config(rs->dma_tx.ch, &txconf);
+			rs->dma_tx.n_bytes = rs->n_bytes;
+		}
 
+		/* completion of full duplex transfers is signalled by rx */
 		txdesc = dmaengine_prep_slave_sg(
 				rs->dma_tx.ch,
 				rs->tx_sg.sgl, rs->tx_sg.nents,
-				rs->dma_tx.direction, DMA_PREP_INTERRUPT);
+				rs->dma_tx.direction,
+				rxdesc ? 0 : DMA_PREP_INTERRUPT);
 
-		txdesc->callback = rockchip_spi_dma_txcb;
-		txdesc->callback_param = rs;
+		if (!rxdesc) {
+			txdesc->callback = rockchip_spi_dma_txcb;
+			txdesc->callback_param = rs;
+		}
 	}
 
 	/* rx must be started before tx due to spi instinct */
@@ -551,7 +595,8 @@ static void rockchip_spi_config(struct rockchip_spi *rs)
 	writel_relaxed(rs->fifo_len / 2 - 1, rs->regs + ROCKCHIP_SPI_RXFTLR);
 
 	writel_relaxed(0, rs->regs + ROCKCHIP_SPI_DMATDLR);
-	writel_relaxed(0, rs->regs + ROCKCHIP_SPI_DMARDLR);
+	writel_relaxed(rockchip_spi_calc_burst_size(rs->len / rs->n_bytes) - 1,
+		       rs->regs + ROCKCHIP_SPI_DMARDLR);
 	writel_relaxed(dmacr, rs->regs + ROCKCHIP_SPI_DMACR);
 
 	spi_set_clk(rs, div);
@@ -626,8 +671,23 @@ static bool rockchip_spi_can_dma(struct spi_master *master,
 				 struct spi_transfer *xfer)
 {
 	struct rockchip_spi *rs = spi_master_get_devdata(master);
+	u32 speed = xfer->speed_hz ? : spi->max_speed_hz;
+	u64 nsecs;
+
+	if (xfer->len <= rs->fifo_len)
+		return false;
+
+	if (!speed)
+		return true;
+
+	/*
+	 * Setting up the descriptors and taking the completion interrupt
+	 * costs more than polling the FIFO for a transfer that is over
+	 * within a few microseconds.
+	 */
+	nsecs = div_u64((u64)xfer->len * BITS_PER_BYTE * NSEC_PER_SEC, speed);
 
-	return (xfer->len > rs->fifo_len);
+	return nsecs > PIO_MAX_NSECS;
 }
 
 static int rockchip_spi_probe(struct platform_device *pdev)
@@ -700,6 +760,7 @@ static int rockchip_spi_probe(struct platform_device *pdev)
 
 	spin_lock_init(&rs->lock);
 
+	device_enable_async_suspend(&pdev->dev);
 	pm_runtime_set_active(&pdev->dev);
 	pm_runtime_enable(&pdev->dev);
 
@@ -716,17 +716,57 @@ static int __spi_map_msg(struct spi_master *master, struct spi_message *msg)
 		}
 	}
 
-	master->cur_msg_mapped = true;
-
 	return 0;
 }
 
+static void spi_sync_msg_bufs(struct spi_master *master,
+			      struct spi_message *msg, bool for_device)
+{
+	struct spi_transfer *xfer;
+	struct device *tx_dev, *rx_dev;
+
+	if (!master->can_dma)
+		return;
+
+	if (master->dma_tx)
+		tx_dev = master->dma_tx->device->dev;
+	else
+		tx_dev = &master->dev;
+
+	if (master->dma_rx)
+		rx_dev = master->dma_rx->device->dev;
+	else
+		rx_dev = &master->dev;
+
+	list_for_each_entry(xfer, &msg->transfers, transfer_list) {
+		if (!master->can_dma(master, msg->spi, xfer))
+			continue;
+
+		if (for_device && xfer->tx_sg.orig_nents)
+			dma_sync_sg_for_device(tx_dev, xfer->tx_sg.sgl,
+					       xfer->tx_sg.orig_nents,
+					       DMA_TO_DEVICE);
+
+		if (!xfer->rx_sg.orig_nents)
+			continue;
+
+		if (for_device)
+			dma_sync_sg_for_device(rx_dev, xfer->rx_sg.sgl,
+					       xfer->rx_sg.orig_nents,
+					       DMA_FROM_DEVICE);
+		else
+			dma_sync_sg_for_cpu(rx_dev, xfer->rx_sg.sgl,
+					    xfer->rx_sg.orig_nents,
+					    DMA_FROM_DEVICE);
+	}
+}
+
 static int __spi_unmap_msg(struct spi_master *master, struct spi_message *msg)
 {
 	struct spi_transfer *xfer;
 	struct device *tx_dev, *rx_dev;
 
-	if (!master->cur_msg_mapped || !master->can_dma)
+	if (!master->can_dma)
 		return 0;
 
 	if (master->dma_tx)
@@ -761,13 +801,37 @@ static inline int __spi_unmap_msg(struct spi_master *master,
 {
 	return 0;
 }
+
+static inline void spi_sync_msg_bufs(struct spi_master *master,
+				     struct spi_message *msg, bool for_device)
+{
+}
 #endif /* !CONFIG_HAS_DMA */
 
+static int spi_queued_transfer(struct spi_device *spi,
+			       struct spi_message *msg);
+
+/*
+ * Optimized messages keep their DMA mappings between submissions, unless
+ * the master substitutes dummy buffers that only live for one message.
+ */
+static bool spi_msg_premapped(struct spi_master *master,
+			      struct spi_message *msg)
+{
+	return msg->optimized && master->transfer == spi_queued_transfer &&
+	       !(master->flags & (SPI_MASTER_MUST_RX | SPI_MASTER_MUST_TX));
+}
+
 static inline int spi_unmap_msg(struct spi_master *master,
 				struct spi_message *msg)
 {
 	struct spi_transfer *xfer;
 
+	if (spi_msg_premapped(master, msg)) {
+		spi_sync_msg_bufs(master, msg, false);
+		return 0;
+	}
+
 	list_for_each_entry(xfer, &msg->transfers, transfer_list) {
 		/*
 		 * Restore the original value of tx_buf or rx_buf if they are
@@ -779,6 +843,9 @@ static inline int spi_unmap_msg(struct spi_master *master,
 			xfer->rx_buf = NULL;
 	}
 
+	if (!master->cur_msg_mapped)
+		return 0;
+
 	return __spi_unmap_msg(master, msg);
 }
 
@@ -787,6 +854,13 @@ static int spi_map_msg(struct spi_master *master, struct spi_message *msg)
 	struct spi_transfer *xfer;
 	void *tmp;
 	unsigned int max_tx, max_rx;
+	int ret;
+
+	if (spi_msg_premapped(master, msg)) {
+		spi_sync_msg_bufs(master, msg, true);
+		master->cur_msg_mapped = true;
+		return 0;
+	}
 
 	if (master->flags & (SPI_MASTER_MUST_RX | SPI_MASTER_MUST_TX)) {
 		max_tx = 0;
@@ -829,7 +903,13 @@ static int spi_map_msg(struct spi_master *master, struct spi_message *msg)
 		}
 	}
 
-	return __spi_map_msg(master, msg);
+	ret = __spi_map_msg(master, msg);
+	if (ret)
+		return ret;
+
+	master->cur_msg_mapped = !!master->can_dma;
+
+	return 0;
 }
 
 /*
@@ -953,7 +1033,8 @@ EXPORT_SYMBOL_GPL(spi_finalize_current_transfer);
 /**
  * __spi_pump_messages - function which processes spi message queue
  * @master: master to process queue for
- * @in_kthread: true if we are in the context of the message pump thread
+ * @in_kthread: true if we are in the context of the message pump thread,
+ *	or in spi_sync() after the caller's message completed
  *
  * This function checks if there is any spi message in the queue that
  * needs processing and if so call out to the driver to initialize hardware
@@ -1186,7 +1267,9 @@ void spi_finalize_current_message(struct spi_master *master)
 	spin_lock_irqsave(&master->queue_lock, flags);
 	master->cur_msg = NULL;
 	master->cur_msg_prepared = false;
-	queue_kthread_work(&master->kworker, &master->pump_messages);
+	/* spi_sync() runs the queue itself once it is woken up below */
+	if (!mesg->caller_pumps)
+		queue_kthread_work(&master->kworker, &master->pump_messages);
 	spin_unlock_irqrestore(&master->queue_lock, flags);
 
 	trace_spi_message_done(mesg);
@@ -2016,6 +2099,12 @@ static int __spi_validate(struct spi_device *spi, struct spi_message *message)
 	struct spi_transfer *xfer;
 	int w_size;
 
+	/* checked and filled in by spi_optimize_message() already */
+	if (message->optimized) {
+		message->status = -EINPROGRESS;
+		return 0;
+	}
+
 	if (list_empty(&message->transfers))
 		return -EINVAL;
 
@@ -2264,6 +2353,7 @@ static int __spi_sync(struct spi_device *spi, struct spi_message *message,
 	message->complete = spi_complete;
 	message->context = &done;
 	message->spi = spi;
+	message->caller_pumps = master->transfer == spi_queued_transfer;
 
 	SPI_STATISTICS_INCREMENT_FIELD(&master->statistics, spi_sync);
 	SPI_STATISTICS_INCREMENT_FIELD(&spi->statistics, spi_sync);
@@ -2305,7 +2395,15 @@ static int __spi_sync(struct spi_device *spi, struct spi_message *message,
 
 		wait_for_completion(&done);
 		status = message->status;
+
+		/*
+		 * Start the next queued message, or idle the master, from
+		 * here rather than waking the message pump thread for it.
+		 */
+		if (message->caller_pumps)
+			__spi_pump_messages(master, true);
 	}
+	message->caller_pumps = 0;
 	message->context = NULL;
 	return status;
 }
@@ -2359,6 +2457,70 @@ int spi_sync_locked(struct spi_device *spi, struct spi_message *message)
 }
 EXPORT_SYMBOL_GPL(spi_sync_locked);
 
+/**
+ * spi_optimize_message - prepare a message for repeated submission
+ * @spi: device the message will be sent to
+ * @message: the message to prepare
+ * Context: can sleep
+ *
+ * Validates the message and, where the master allows it, maps its
+ * transfer buffers for DMA once. Later spi_sync() and spi_async() calls
+ * with the message skip the validation, and the mapping is only synced
+ * around each transfer. The transfers and their buffers must not be
+ * changed until spi_unoptimize_message() is called; the buffer contents
+ * may be.
+ *
+ * It returns zero on success, else a negative error code.
+ */
+int spi_optimize_message(struct spi_device *spi, struct spi_message *message)
+{
+	struct spi_master *master = spi->master;
+	int ret;
+
+	if (message->optimized)
+		return 0;
+
+	ret = __spi_validate(spi, message);
+	if (ret)
+		return ret;
+
+	message->spi = spi;
+	message->optimized = 1;
+
+	if (spi_msg_premapped(master, message)) {
+		ret = __spi_map_msg(master, message);
+		if (ret) {
+			message->optimized = 0;
+			return ret;
+		}
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(spi_optimize_message);
+
+/**
+ * spi_unoptimize_message - release a message set up by spi_optimize_message
+ * @message: the message to release
+ * Context: can sleep
+ *
+ * The message must not be in flight.
+ */
+void spi_unoptimize_message(struct spi_message *message)
+{
+	struct spi_master *master;
+
+	if (!message->optimized)
+		return;
+
+	master = message->spi->master;
+	if (spi_msg_premapped(master, message))
+		__spi_unmap_msg(master, message);
+
+	message->optimized = 0;
+}
+EXPORT_SYMBOL_GPL(spi_unoptimize_message);
+
 /**
  * spi_bus_lock - obtain a lock for exclusive SPI bus usage
  * @master: SPI bus master that should be locked for exclusive bus access
@@ -1057,6 +1057,49 @@ static void ion_dma_buf_kunmap(struct dma_buf *dmabuf, unsigned long offset,
 {
 }
 
+/*
+ * Do cache maintenance on the part of a cached buffer that overlaps
+ * [start, start + len) only, one scatterlist segment at a time, instead of
+ * flushing all of it for every cpu access window.
+ */
+static void ion_buffer_sync_range(struct ion_buffer *buffer, size_t start,
+				  size_t len, enum dma_data_direction dir,
+				  bool for_cpu)
+{
+	struct scatterlist *sg, seg;
+	size_t end, pos = 0;
+	int i;
+
+	if (!ion_buffer_cached(buffer) || !buffer->sg_table)
+		return;
+
+	if (start >= buffer->size)
+		return;
+	end = min(start + len, buffer->size);
+
+	for_each_sg(buffer->sg_table->sgl, sg, buffer->sg_table->nents, i) {
+		size_t s, e;
+
+		if (pos >= end)
+			break;
+		s = max(start, pos);
+		e = min(end, pos + sg->length);
+		pos += sg->length;
+		if (s >= e)
+			continue;
+
+		sg_init_table(&seg, 1);
+		sg_set_page(&seg, sg_page(sg), e - s,
+			    sg->offset + s - (pos - sg->length));
+		/* same caveat as in ion_pages_sync_for_device() */
+		sg_dma_address(&seg) = sg_phys(&seg);
+		if (for_cpu)
+			dma_sync_sg_for_cpu(NULL, &seg, 1, dir);
+		else
+			dma_sync_sg_for_device(NULL, &seg, 1, dir);
+	}
+}
+
 static int ion_dma_buf_begin_cpu_access(struct dma_buf *dmabuf, size_t start,
 					size_t len,
 					enum dma_data_direction direction)
@@ -1073,7 +1116,11 @@ static int ion_dma_buf_begin_cpu_access(struct dma_buf *dmabuf, size_t start,
 	mutex_lock(&buffer->lock);
 	vaddr = ion_buffer_kmap_get(buffer);
 	mutex_unlock(&buffer->lock);
-	return PTR_ERR_OR_ZERO(vaddr);
+	if (IS_ERR(vaddr))
+		return PTR_ERR(vaddr);
+
+	ion_buffer_sync_range(buffer, start, len, direction, true);
+	return 0;
 }
 
 static void ion_dma_buf_end_cpu_access(struct dma_buf *dmabuf, size_t start,
@@ -1082,6 +1129,8 @@ static void ion_dma_buf_end_cpu_access(struct dma_buf *dmabuf, size_t start,
 {
 	struct ion_buffer *buffer = dmabuf->priv;
 
+	ion_buffer_sync_range(buffer, start, len, direction, false);
+
 	mutex_lock(&buffer->lock);
 	ion_buffer_kmap_put(buffer);
 	mutex_unlock(&buffer->lock);
@@ -18,15 +18,34 @@
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/fs.h>
+#include <linux/jiffies.h>
 #include <linux/list.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/swap.h>
 #include "ion_priv.h"
 
-static void *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
+/*
+ * Each CPU keeps a few items of the small orders in front of the shared
+ * lists, so that most allocations and frees only take a lock that no other
+ * CPU contends for. The caches are refilled from, and flushed to, the lists
+ * in batches of half their size.
+ */
+#define ION_PAGE_POOL_PCP_MAX	16
+#define ION_PAGE_POOL_PCP_BYTES	SZ_64K
+
+struct ion_page_pool_pcp {
+	spinlock_t lock;
+	unsigned int count;
+	struct page *pages[ION_PAGE_POOL_PCP_MAX];
+};
+
+static struct page *ion_page_pool_alloc_pages(struct ion_page_pool *pool,
+					      gfp_t gfp_mask)
 {
-	struct page *page = alloc_pages(pool->gfp_mask, pool->order);
+	struct page *page = alloc_pages(gfp_mask, pool->order);
 
 	if (!page)
 		return NULL;
@@ -41,9 +60,8 @@ static void ion_page_pool_free_pages(struct ion_page_pool *pool,
 	__free_pages(page, pool->order);
 }
 
-static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+static void __ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 {
-	mutex_lock(&pool->mutex);
 	if (PageHighMem(page)) {
 		list_add_tail(&page->lru, &pool->high_items);
 		pool->high_count++;
@@ -51,7 +69,13 @@ static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 		list_add_tail(&page->lru, &pool->low_items);
 		pool->low_count++;
 	}
-	mutex_unlock(&pool->mutex);
+}
+
+static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+{
+	spin_lock(&pool->lock);
+	__ion_page_pool_add(pool, page);
+	spin_unlock(&pool->lock);
 	return 0;
 }
 
@@ -73,21 +97,106 @@ static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 	return page;
 }
 
+static struct page *__ion_page_pool_get(struct ion_page_pool *pool)
+{
+	if (pool->high_count)
+		return ion_page_pool_remove(pool, true);
+	if (pool->low_count)
+		return ion_page_pool_remove(pool, false);
+	return NULL;
+}
+
+static struct page *ion_page_pool_pcp_get(struct ion_page_pool *pool)
+{
+	struct ion_page_pool_pcp *pcp;
+	struct page *page = NULL;
+
+	pcp = get_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	if (!pcp->count) {
+		spin_lock(&pool->lock);
+		while (pcp->count < pool->pcp_max / 2 + 1) {
+			page = __ion_page_pool_get(pool);
+			if (!page)
+				break;
+			pcp->pages[pcp->count++] = page;
+		}
+		spin_unlock(&pool->lock);
+	}
+	page = pcp->count ? pcp->pages[--pcp->count] : NULL;
+	spin_unlock(&pcp->lock);
+	put_cpu_ptr(pool->pcp);
+
+	return page;
+}
+
+static void ion_page_pool_pcp_put(struct ion_page_pool *pool,
+				  struct page *page)
+{
+	struct ion_page_pool_pcp *pcp;
+
+	pcp = get_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	if (pcp->count == pool->pcp_max) {
+		spin_lock(&pool->lock);
+		while (pcp->count > pool->pcp_max / 2)
+			__ion_page_pool_add(pool, pcp->pages[--pcp->count]);
+		spin_unlock(&pool->lock);
+	}
+	pcp->pages[pcp->count++] = page;
+	spin_unlock(&pcp->lock);
+	put_cpu_ptr(pool->pcp);
+}
+
+/* Move the items of every per-cpu cache back to the lists */
+static void ion_page_pool_pcp_drain(struct ion_page_pool *pool)
+{
+	int cpu;
+
+	if (!pool->pcp_max)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct ion_page_pool_pcp *pcp = per_cpu_ptr(pool->pcp, cpu);
+
+		spin_lock(&pcp->lock);
+		spin_lock(&pool->lock);
+		while (pcp->count)
+			__ion_page_pool_add(pool, pcp->pages[--pcp->count]);
+		spin_unlock(&pool->lock);
+		spin_unlock(&pcp->lock);
+	}
+}
+
+static int ion_page_pool_pcp_count(struct ion_page_pool *pool)
+{
+	int cpu, count = 0;
+
+	if (!pool->pcp_max)
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		count += ACCESS_ONCE(per_cpu_ptr(pool->pcp, cpu)->count);
+
+	return count;
+}
+
 struct page *ion_page_pool_alloc(struct ion_page_pool *pool)
 {
 	struct page *page = NULL;
 
 	BUG_ON(!pool);
 
-	mutex_lock(&pool->mutex);
-	if (pool->high_count)
-		page = ion_page_pool_remove(pool, true);
-	else if (pool->low_count)
-		page = ion_page_pool_remove(pool, false);
-	mutex_unlock(&pool->mutex);
+	if (pool->pcp_max) {
+		page = ion_page_pool_pcp_get(pool);
+	} else {
+		spin_lock(&pool->lock);
+		page = __ion_page_pool_get(pool);
+		spin_unlock(&pool->lock);
+	}
 
 	if (!page)
-		page = ion_page_pool_alloc_pages(pool);
+		page = ion_page_pool_alloc_pages(pool, pool->gfp_mask);
 
 	return page;
 }
@@ -98,6 +207,11 @@ void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
 
 	BUG_ON(pool->order != compound_order(page));
 
+	if (pool->pcp_max) {
+		ion_page_pool_pcp_put(pool, page);
+		return;
+	}
+
 	ret = ion_page_pool_add(pool, page);
 	if (ret)
 		ion_page_pool_free_pages(pool, page);
@@ -109,10 +223,35 @@ static int ion_page_pool_total(struct ion_page_pool *pool, bool high)
 
 	if (high)
 		count += pool->high_count;
+	count += ion_page_pool_pcp_count(pool);
 
 	return count << pool->order;
 }
 
+bool ion_page_pool_needs_prefill(struct ion_page_pool *pool)
+{
+	return pool->high_count + pool->low_count < pool->low_wmark;
+}
+
+bool ion_page_pool_prefill(struct ion_page_pool *pool)
+{
+	gfp_t gfp_mask = pool->gfp_mask | __GFP_NORETRY | __GFP_NOWARN;
+	struct page *page;
+
+	while (ion_page_pool_needs_prefill(pool)) {
+		if (time_before(jiffies, pool->last_shrink + HZ))
+			return true;
+
+		page = ion_page_pool_alloc_pages(pool, gfp_mask);
+		if (!page)
+			return true;
+		ion_page_pool_add(pool, page);
+		cond_resched();
+	}
+
+	return false;
+}
+
 int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 				int nr_to_scan)
 {
@@ -127,19 +266,22 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 	if (nr_to_scan == 0)
 		return ion_page_pool_total(pool, high);
 
+	pool->last_shrink = jiffies;
+	ion_page_pool_pcp_drain(pool);
+
 	while (freed < nr_to_scan) {
 		struct page *page;
 
-		mutex_lock(&pool->mutex);
+		spin_lock(&pool->lock);
 		if (pool->low_count) {
 			page = ion_page_pool_remove(pool, false);
 		} else if (high && pool->high_count) {
 			page = ion_page_pool_remove(pool, true);
 		} else {
-			mutex_unlock(&pool->mutex);
+			spin_unlock(&pool->lock);
 			break;
 		}
-		mutex_unlock(&pool->mutex);
+		spin_unlock(&pool->lock);
 		ion_page_pool_free_pages(pool, page);
 		freed += (1 << pool->order);
 	}
@@ -151,6 +293,8 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
 {
 	struct ion_page_pool *pool = kmalloc(sizeof(struct ion_page_pool),
 					     GFP_KERNEL);
+	int cpu;
+
 	if (!pool)
 		return NULL;
 	pool->high_count = 0;
@@ -159,14 +303,41 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
 	INIT_LIST_HEAD(&pool->high_items);
 	pool->gfp_mask = gfp_mask | __GFP_COMP;
 	pool->order = order;
-	mutex_init(&pool->mutex);
+	spin_lock_init(&pool->lock);
 	plist_node_init(&pool->list, order);
+	pool->low_wmark = 0;
+	pool->last_shrink = jiffies - HZ;
+
+	pool->pcp_max = min_t(unsigned int, ION_PAGE_POOL_PCP_MAX,
+			      ION_PAGE_POOL_PCP_BYTES >> (PAGE_SHIFT + order));
+	pool->pcp = NULL;
+	if (pool->pcp_max) {
+		pool->pcp = alloc_percpu(struct ion_page_pool_pcp);
+		if (!pool->pcp) {
+			kfree(pool);
+			return NULL;
+		}
+		for_each_possible_cpu(cpu) {
+			struct ion_page_pool_pcp *pcp =
+				per_cpu_ptr(pool->pcp, cpu);
+
+			spin_lock_init(&pcp->lock);
+			pcp->count = 0;
+		}
+	}
 
 	return pool;
 }
 
 void ion_page_pool_destroy(struct ion_page_pool *pool)
 {
+	struct page *page;
+
+	ion_page_pool_pcp_drain(pool);
+	while ((page = __ion_page_pool_get(pool)))
+		ion_page_pool_free_pages(pool, page);
+
+	free_percpu(pool->pcp);
 	kfree(pool);
 }
 
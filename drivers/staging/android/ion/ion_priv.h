@@ -25,6 +25,7 @@
 #include <linux/rbtree.h>
 #include <linux/sched.h>
 #include <linux/shrinker.h>
+#include <linux/spinlock.h>
 #include <linux/types.h>
 
 #include "ion.h"
@@ -348,17 +349,23 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * invalidated from the cache, provides a significant performance benefit on
  * many systems */
 
+struct ion_page_pool_pcp;
+
 /**
  * struct ion_page_pool - pagepool struct
  * @high_count:		number of highmem items in the pool
  * @low_count:		number of lowmem items in the pool
  * @high_items:		list of highmem items
  * @low_items:		list of lowmem items
- * @mutex:		lock protecting this struct and especially the count
+ * @lock:		lock protecting this struct and especially the count
  *			item list
  * @gfp_mask:		gfp_mask to use from alloc
  * @order:		order of pages in the pool
  * @list:		plist node for list of pools
+ * @pcp:		per-cpu caches of items in front of the lists
+ * @pcp_max:		number of items each per-cpu cache holds, 0 if none
+ * @low_wmark:		number of items ion_page_pool_prefill() refills to
+ * @last_shrink:	time of the last shrink, in jiffies
  *
  * Allows you to keep a pool of pre allocated pages to use from your heap.
  * Keeping a pool of pages that is ready for dma, ie any cached mapping have
@@ -370,10 +377,14 @@ struct ion_page_pool {
 	int low_count;
 	struct list_head high_items;
 	struct list_head low_items;
-	struct mutex mutex;
+	spinlock_t lock;
 	gfp_t gfp_mask;
 	unsigned int order;
 	struct plist_node list;
+	struct ion_page_pool_pcp __percpu *pcp;
+	unsigned int pcp_max;
+	unsigned int low_wmark;
+	unsigned long last_shrink;
 };
 
 struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order);
@@ -381,6 +392,19 @@ void ion_page_pool_destroy(struct ion_page_pool *);
 struct page *ion_page_pool_alloc(struct ion_page_pool *);
 void ion_page_pool_free(struct ion_page_pool *, struct page *);
 
+/**
+ * ion_page_pool_prefill - allocate pages into the pool up to its watermark
+ * @pool:		the pool
+ *
+ * Meant to run in the background, so that allocations find pages that are
+ * already zeroed and flushed. Does nothing for a second after the pool was
+ * shrunk, not to undo the work of the shrinker under memory pressure.
+ *
+ * returns true if the pool is still below its watermark
+ */
+bool ion_page_pool_prefill(struct ion_page_pool *pool);
+bool ion_page_pool_needs_prefill(struct ion_page_pool *pool);
+
 /** ion_page_pool_shrink - shrinks the size of the memory cached in the pool
  * @pool:		the pool
  * @gfp_mask:		the memory type to reclaim
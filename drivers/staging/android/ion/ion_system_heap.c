@@ -23,6 +23,7 @@
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include "ion.h"
 #include "ion_priv.h"
 
@@ -30,6 +31,8 @@ static gfp_t high_order_gfp_flags = (GFP_HIGHUSER | __GFP_ZERO | __GFP_NOWARN |
 				     __GFP_NORETRY) & ~__GFP_WAIT;
 static gfp_t low_order_gfp_flags  = (GFP_HIGHUSER | __GFP_ZERO | __GFP_NOWARN);
 static const unsigned int orders[] = {8, 4, 0};
+/* pages of each order kept ready in the pools: 4MiB, 1MiB and 1MiB */
+static const unsigned int prefill_wmarks[] = {4, 16, 256};
 static const int num_orders = ARRAY_SIZE(orders);
 static int order_to_index(unsigned int order)
 {
@@ -49,9 +52,38 @@ static inline unsigned int order_to_size(int order)
 
 struct ion_system_heap {
 	struct ion_heap heap;
+	struct work_struct prefill_work;
 	struct ion_page_pool *pools[0];
 };
 
+/*
+ * Refill the pools below their watermark in the background, so that
+ * allocation bursts find pages that are already zeroed and flushed. The
+ * pools skip this for a while after the shrinker took pages from them.
+ */
+static void ion_system_heap_prefill(struct work_struct *work)
+{
+	struct ion_system_heap *sys_heap = container_of(work,
+							struct ion_system_heap,
+							prefill_work);
+	int i;
+
+	for (i = 0; i < num_orders; i++)
+		ion_page_pool_prefill(sys_heap->pools[i]);
+}
+
+static void ion_system_heap_kick_prefill(struct ion_system_heap *sys_heap)
+{
+	int i;
+
+	for (i = 0; i < num_orders; i++) {
+		if (ion_page_pool_needs_prefill(sys_heap->pools[i])) {
+			queue_work(system_unbound_wq, &sys_heap->prefill_work);
+			return;
+		}
+	}
+}
+
 static struct page *alloc_buffer_page(struct ion_system_heap *heap,
 				      struct ion_buffer *buffer,
 				      unsigned long order)
@@ -165,6 +197,8 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 	}
 
 	buffer->priv_virt = table;
+	if (!ion_buffer_cached(buffer))
+		ion_system_heap_kick_prefill(sys_heap);
 	return 0;
 
 free_table:
@@ -293,8 +327,11 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 		pool = ion_page_pool_create(gfp_flags, orders[i]);
 		if (!pool)
 			goto destroy_pools;
+		pool->low_wmark = prefill_wmarks[i];
 		heap->pools[i] = pool;
 	}
+	INIT_WORK(&heap->prefill_work, ion_system_heap_prefill);
+	queue_work(system_unbound_wq, &heap->prefill_work);
 
 	heap->heap.debug_show = ion_system_heap_debug_show;
 	return &heap->heap;
@@ -313,6 +350,7 @@ void ion_system_heap_destroy(struct ion_heap *heap)
 							heap);
 	int i;
 
+	cancel_work_sync(&sys_heap->prefill_work);
 	for (i = 0; i < num_orders; i++)
 		ion_page_pool_destroy(sys_heap->pools[i]);
 	kfree(sys_heap);
@@ -17,6 +17,11 @@
  * percentage of the cached memory is locked this can be very inaccurate
  * and processes may not get killed until the normal oom killer is triggered.
  *
+ * Reclaim only checks the thresholds and kicks a worker; choosing and
+ * killing a victim happens there, from a small cache of the best
+ * candidates that is refilled by walking the task list at most once a
+ * second, or when it runs dry.
+ *
  * Copyright (C) 2007-2008 Google, Inc.
  *
  * This software is licensed under the terms of the GNU General Public
@@ -41,6 +46,7 @@
 #include <linux/rcupdate.h>
 #include <linux/profile.h>
 #include <linux/notifier.h>
+#include <linux/workqueue.h>
 
 static uint32_t lowmem_debug_level = 1;
 static short lowmem_adj[6] = {
@@ -59,6 +65,20 @@ static int lowmem_minfree[6] = {
 static int lowmem_minfree_size = 4;
 
 static unsigned long lowmem_deathpending_timeout;
+static struct task_struct *lowmem_victim;
+
+struct lowmem_candidate {
+	struct task_struct *tsk;
+	short oom_score_adj;
+	int tasksize;
+};
+
+/* kill candidates, best first; only touched by lowmem_kill_work */
+#define LOWMEM_CACHE_SIZE	16
+static struct lowmem_candidate lowmem_cache[LOWMEM_CACHE_SIZE];
+static int lowmem_cache_next;
+static int lowmem_cache_count;
+static unsigned long lowmem_cache_expires;
 
 #define lowmem_print(level, x...)			\
 	do {						\
@@ -75,21 +95,15 @@ static unsigned long lowmem_count(struct shrinker *s,
 		global_page_state(NR_INACTIVE_FILE);
 }
 
-static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
+static short lowmem_get_min_score_adj(void)
 {
-	struct task_struct *tsk;
-	struct task_struct *selected = NULL;
-	unsigned long rem = 0;
-	int tasksize;
-	int i;
 	short min_score_adj = OOM_SCORE_ADJ_MAX + 1;
-	int selected_tasksize = 0;
-	short selected_oom_score_adj;
 	int array_size = ARRAY_SIZE(lowmem_adj);
 	int other_free = global_page_state(NR_FREE_PAGES) - totalreserve_pages;
 	int other_file = global_page_state(NR_FILE_PAGES) -
 						global_page_state(NR_SHMEM) -
 						total_swapcache_pages();
+	int i;
 
 	if (lowmem_adj_size < array_size)
 		array_size = lowmem_adj_size;
@@ -103,22 +117,56 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		}
 	}
 
-	lowmem_print(3, "lowmem_scan %lu, %x, ofree %d %d, ma %hd\n",
-			sc->nr_to_scan, sc->gfp_mask, other_free,
-			other_file, min_score_adj);
+	lowmem_print(3, "ofree %d %d, ma %hd\n",
+		     other_free, other_file, min_score_adj);
+	return min_score_adj;
+}
 
-	if (min_score_adj == OOM_SCORE_ADJ_MAX + 1) {
-		lowmem_print(5, "lowmem_scan %lu, %x, return 0\n",
-			     sc->nr_to_scan, sc->gfp_mask);
-		return 0;
-	}
+static void lowmem_cache_flush(void)
+{
+	while (lowmem_cache_next < lowmem_cache_count)
+		put_task_struct(lowmem_cache[lowmem_cache_next++].tsk);
+	lowmem_cache_next = 0;
+	lowmem_cache_count = 0;
+}
 
-	selected_oom_score_adj = min_score_adj;
+/* Insert @tsk at its place in the cache, dropping the worst if it is full */
+static void lowmem_cache_add(struct task_struct *tsk, short oom_score_adj,
+			     int tasksize)
+{
+	int i = lowmem_cache_count;
+
+	while (i > 0 &&
+	       (lowmem_cache[i - 1].oom_score_adj < oom_score_adj ||
+		(lowmem_cache[i - 1].oom_score_adj == oom_score_adj &&
+		 lowmem_cache[i - 1].tasksize < tasksize)))
+		i--;
+	if (i == LOWMEM_CACHE_SIZE)
+		return;
+
+	if (lowmem_cache_count == LOWMEM_CACHE_SIZE)
+		put_task_struct(lowmem_cache[--lowmem_cache_count].tsk);
+	memmove(&lowmem_cache[i + 1], &lowmem_cache[i],
+		(lowmem_cache_count - i) * sizeof(lowmem_cache[0]));
+	lowmem_cache_count++;
+
+	get_task_struct(tsk);
+	lowmem_cache[i].tsk = tsk;
+	lowmem_cache[i].oom_score_adj = oom_score_adj;
+	lowmem_cache[i].tasksize = tasksize;
+}
+
+static void lowmem_cache_fill(short min_score_adj)
+{
+	struct task_struct *tsk;
+
+	lowmem_cache_flush();
 
 	rcu_read_lock();
 	for_each_process(tsk) {
 		struct task_struct *p;
 		short oom_score_adj;
+		int tasksize;
 
 		if (tsk->flags & PF_KTHREAD)
 			continue;
@@ -127,12 +175,6 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		if (!p)
 			continue;
 
-		if (test_tsk_thread_flag(p, TIF_MEMDIE) &&
-		    time_before_eq(jiffies, lowmem_deathpending_timeout)) {
-			task_unlock(p);
-			rcu_read_unlock();
-			return 0;
-		}
 		oom_score_adj = p->signal->oom_score_adj;
 		if (oom_score_adj < min_score_adj) {
 			task_unlock(p);
@@ -142,45 +184,113 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		task_unlock(p);
 		if (tasksize <= 0)
 			continue;
-		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
-				continue;
-			if (oom_score_adj == selected_oom_score_adj &&
-			    tasksize <= selected_tasksize)
-				continue;
-		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_score_adj = oom_score_adj;
-		lowmem_print(2, "select %d (%s), adj %hd, size %d, to kill\n",
-			     p->pid, p->comm, oom_score_adj, tasksize);
+		lowmem_cache_add(tsk, oom_score_adj, tasksize);
 	}
-	if (selected) {
-		task_lock(selected);
-		if (!selected->mm) {
-			/* Already exited, cannot do mark_tsk_oom_victim() */
-			task_unlock(selected);
-			goto out;
-		}
-		/*
-		 * FIXME: lowmemorykiller shouldn't abuse global OOM killer
-		 * infrastructure. There is no real reason why the selected
-		 * task should have access to the memory reserves.
-		 */
-		mark_oom_victim(selected);
-		task_unlock(selected);
-		lowmem_print(1, "send sigkill to %d (%s), adj %hd, size %d\n",
-			     selected->pid, selected->comm,
-			     selected_oom_score_adj, selected_tasksize);
-		lowmem_deathpending_timeout = jiffies + HZ;
-		send_sig(SIGKILL, selected, 0);
-		rem += selected_tasksize;
-	}
-out:
-	lowmem_print(4, "lowmem_scan %lu, %x, return %lu\n",
-		     sc->nr_to_scan, sc->gfp_mask, rem);
 	rcu_read_unlock();
-	return rem;
+
+	lowmem_cache_expires = jiffies + HZ;
+	lowmem_print(4, "cached %d candidates with adj >= %hd\n",
+		     lowmem_cache_count, min_score_adj);
+}
+
+/*
+ * Pop candidates until one is still alive and still eligible. Returns the
+ * thread holding its mm, task_lock()ed, or NULL if the cache ran dry.
+ */
+static struct task_struct *lowmem_cache_pick(short min_score_adj,
+					     short *oom_score_adj,
+					     int *tasksize)
+{
+	while (lowmem_cache_next < lowmem_cache_count) {
+		struct task_struct *tsk = lowmem_cache[lowmem_cache_next++].tsk;
+		struct task_struct *p;
+
+		p = find_lock_task_mm(tsk);
+		put_task_struct(tsk);
+		if (!p)
+			continue;
+
+		*oom_score_adj = p->signal->oom_score_adj;
+		*tasksize = get_mm_rss(p->mm);
+		if (*oom_score_adj >= min_score_adj && *tasksize > 0)
+			return p;
+		task_unlock(p);
+	}
+	return NULL;
+}
+
+static void lowmem_kill(struct work_struct *work)
+{
+	struct task_struct *selected;
+	short min_score_adj, selected_oom_score_adj;
+	int selected_tasksize;
+
+	if (lowmem_victim) {
+		bool pending;
+
+		task_lock(lowmem_victim);
+		pending = lowmem_victim->mm &&
+			  test_tsk_thread_flag(lowmem_victim, TIF_MEMDIE) &&
+			  time_before_eq(jiffies, lowmem_deathpending_timeout);
+		task_unlock(lowmem_victim);
+		if (pending)
+			return;
+		put_task_struct(lowmem_victim);
+		lowmem_victim = NULL;
+	}
+
+	/* memory may have come back since reclaim asked */
+	min_score_adj = lowmem_get_min_score_adj();
+	if (min_score_adj == OOM_SCORE_ADJ_MAX + 1)
+		return;
+
+	if (time_after(jiffies, lowmem_cache_expires))
+		lowmem_cache_flush();
+	selected = lowmem_cache_pick(min_score_adj, &selected_oom_score_adj,
+				     &selected_tasksize);
+	if (!selected) {
+		lowmem_cache_fill(min_score_adj);
+		selected = lowmem_cache_pick(min_score_adj,
+					     &selected_oom_score_adj,
+					     &selected_tasksize);
+	}
+	if (!selected)
+		return;
+
+	/*
+	 * FIXME: lowmemorykiller shouldn't abuse global OOM killer
+	 * infrastructure. There is no real reason why the selected
+	 * task should have access to the memory reserves.
+	 */
+	mark_oom_victim(selected);
+	get_task_struct(selected);
+	task_unlock(selected);
+	lowmem_print(1, "send sigkill to %d (%s), adj %hd, size %d\n",
+		     selected->pid, selected->comm,
+		     selected_oom_score_adj, selected_tasksize);
+	lowmem_victim = selected;
+	lowmem_deathpending_timeout = jiffies + HZ;
+	send_sig(SIGKILL, selected, 0);
+}
+
+static DECLARE_WORK(lowmem_kill_work, lowmem_kill);
+
+/*
+ * Called from reclaim, so only check the thresholds here and leave the
+ * task list and the kill to lowmem_kill_work.
+ */
+static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
+{
+	short min_score_adj = lowmem_get_min_score_adj();
+
+	lowmem_print(3, "lowmem_scan %lu, %x, ma %hd\n",
+		     sc->nr_to_scan, sc->gfp_mask, min_score_adj);
+
+	if (min_score_adj == OOM_SCORE_ADJ_MAX + 1)
+		return 0;
+
+	queue_work(system_highpri_wq, &lowmem_kill_work);
+	return 0;
 }
 
 static struct shrinker lowmem_shrinker = {
@@ -198,6 +308,10 @@ static int __init lowmem_init(void)
 static void __exit lowmem_exit(void)
 {
 	unregister_shrinker(&lowmem_shrinker);
+	cancel_work_sync(&lowmem_kill_work);
+	lowmem_cache_flush();
+	if (lowmem_victim)
+		put_task_struct(lowmem_victim);
 }
 
 module_param_named(cost, lowmem_shrinker.seeks, int, S_IRUGO | S_IWUSR);
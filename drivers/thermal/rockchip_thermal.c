@@ -65,14 +65,24 @@ struct rockchip_tsadc_chip {
 
 	/* Per-sensor methods */
 	int (*get_temp)(int chn, void __iomem *reg, int *temp);
+	void (*set_alarm_temp)(int chn, void __iomem *reg, int temp);
 	void (*set_tshut_temp)(int chn, void __iomem *reg, long temp);
 	void (*set_tshut_mode)(int chn, void __iomem *reg, enum tshut_mode m);
 };
 
+#define ROCKCHIP_TEMP_HISTORY	4
+/* Changes below this over the history are taken as a stable temperature */
+#define ROCKCHIP_TREND_THRESHOLD	1000 /* millicelsius */
+
 struct rockchip_thermal_sensor {
 	struct rockchip_thermal_data *thermal;
 	struct thermal_zone_device *tzd;
 	enum sensor_id id;
+	int alarm_temp;
+
+	/* Last readings, to tell a real trend from conversion noise */
+	int history[ROCKCHIP_TEMP_HISTORY];
+	unsigned int history_count;
 };
 
 #define NUM_SENSORS	2 /* Ignore unused sensor 0 */
@@ -99,6 +109,7 @@ struct rockchip_thermal_data {
 #define TSADCV2_INT_EN				0x08
 #define TSADCV2_INT_PD				0x0c
 #define TSADCV2_DATA(chn)			(0x20 + (chn) * 0x04)
+#define TSADCV2_COMP_INT(chn)		        (0x30 + (chn) * 0x04)
 #define TSADCV2_COMP_SHUT(chn)		        (0x40 + (chn) * 0x04)
 #define TSADCV2_HIGHT_INT_DEBOUNCE		0x60
 #define TSADCV2_HIGHT_TSHUT_DEBOUNCE		0x64
@@ -169,26 +180,32 @@ static const struct tsadc_table v2_code_table[] = {
 
 static u32 rk_tsadcv2_temp_to_code(long temp)
 {
-	int high, low, mid;
-
-	low = 0;
-	high = ARRAY_SIZE(v2_code_table) - 1;
-	mid = (high + low) / 2;
+	/* Skip the catch-all entries at either end of the table */
+	unsigned int low = 1;
+	unsigned int high = ARRAY_SIZE(v2_code_table) - 2;
+	unsigned int mid;
+	unsigned long num, denom;
 
 	if (temp < v2_code_table[low].temp || temp > v2_code_table[high].temp)
 		return 0;
 
-	while (low <= high) {
-		if (temp == v2_code_table[mid].temp)
-			return v2_code_table[mid].code;
-		else if (temp < v2_code_table[mid].temp)
-			high = mid - 1;
-		else
-			low = mid + 1;
+	/* Find the first entry at or above temp */
+	while (low < high) {
 		mid = (low + high) / 2;
+		if (v2_code_table[mid].temp < temp)
+			low = mid + 1;
+		else
+			high = mid;
 	}
 
-	return 0;
+	if (v2_code_table[low].temp == temp)
+		return v2_code_table[low].code;
+
+	/* Interpolate like rk_tsadcv2_code_to_temp() does */
+	num = v2_code_table[low - 1].code - v2_code_table[low].code;
+	num *= temp - v2_code_table[low - 1].temp;
+	denom = v2_code_table[low].temp - v2_code_table[low - 1].temp;
+	return v2_code_table[low - 1].code - num / denom;
 }
 
 static int rk_tsadcv2_code_to_temp(u32 code)
@@ -291,6 +308,24 @@ static int rk_tsadcv2_get_temp(int chn, void __iomem *regs, int *temp)
 	return 0;
 }
 
+static void rk_tsadcv2_alarm_temp(int chn, void __iomem *regs, int temp)
+{
+	u32 alarm_value, int_en;
+
+	int_en = readl_relaxed(regs + TSADCV2_INT_EN);
+
+	alarm_value = rk_tsadcv2_temp_to_code(temp);
+	if (alarm_value) {
+		writel_relaxed(alarm_value, regs + TSADCV2_COMP_INT(chn));
+		int_en |= TSADCV2_INT_SRC_EN(chn);
+	} else {
+		/* Nothing to watch for within the sensor's range */
+		int_en &= ~TSADCV2_INT_SRC_EN(chn);
+	}
+
+	writel_relaxed(int_en, regs + TSADCV2_INT_EN);
+}
+
 static void rk_tsadcv2_tshut_temp(int chn, void __iomem *regs, long temp)
 {
 	u32 tshut_value, val;
@@ -329,6 +364,7 @@ static const struct rockchip_tsadc_chip rk3288_tsadc_data = {
 	.irq_ack = rk_tsadcv2_irq_ack,
 	.control = rk_tsadcv2_control,
 	.get_temp = rk_tsadcv2_get_temp,
+	.set_alarm_temp = rk_tsadcv2_alarm_temp,
 	.set_tshut_temp = rk_tsadcv2_tshut_temp,
 	.set_tshut_mode = rk_tsadcv2_tshut_mode,
 };
@@ -366,6 +402,42 @@ static irqreturn_t rockchip_thermal_alarm_irq_thread(int irq, void *dev)
 	return IRQ_HANDLED;
 }
 
+/*
+ * Arm the sensor's alarm at the lowest trip point above the current
+ * temperature, so the zone only needs updating when it gets crossed. A
+ * falling temperature is picked up by the passive polling of the zone,
+ * which moves the alarm back down here.
+ */
+static void rockchip_thermal_set_alarm(struct rockchip_thermal_sensor *sensor,
+				       int temp)
+{
+	struct rockchip_thermal_data *thermal = sensor->thermal;
+	struct thermal_zone_device *tzd = sensor->tzd;
+	int trip_temp, alarm_temp = INT_MAX;
+	int i;
+
+	/* Called while the zone is being registered */
+	if (IS_ERR_OR_NULL(tzd))
+		return;
+
+	for (i = 0; i < tzd->trips; i++) {
+		if (tzd->ops->get_trip_temp(tzd, i, &trip_temp))
+			continue;
+
+		if (trip_temp > temp && trip_temp < alarm_temp)
+			alarm_temp = trip_temp;
+	}
+
+	if (alarm_temp == sensor->alarm_temp)
+		return;
+
+	dev_dbg(&thermal->pdev->dev, "sensor %d - alarm at %d\n",
+		sensor->id, alarm_temp);
+
+	thermal->chip->set_alarm_temp(sensor->id, thermal->regs, alarm_temp);
+	sensor->alarm_temp = alarm_temp;
+}
+
 static int rockchip_thermal_get_temp(void *_sensor, int *out_temp)
 {
 	struct rockchip_thermal_sensor *sensor = _sensor;
@@ -377,11 +449,38 @@ static int rockchip_thermal_get_temp(void *_sensor, int *out_temp)
 	dev_dbg(&thermal->pdev->dev, "sensor %d - temp: %d, retval: %d\n",
 		sensor->id, *out_temp, retval);
 
+	if (!retval) {
+		sensor->history[sensor->history_count++ %
+				ROCKCHIP_TEMP_HISTORY] = *out_temp;
+		rockchip_thermal_set_alarm(sensor, *out_temp);
+	}
+
 	return retval;
 }
 
+static int rockchip_thermal_get_trend(void *_sensor, long *trend)
+{
+	struct rockchip_thermal_sensor *sensor = _sensor;
+	unsigned int count = sensor->history_count;
+	int newest, oldest;
+
+	if (count < 2)
+		return -EAGAIN;
+
+	newest = sensor->history[(count - 1) % ROCKCHIP_TEMP_HISTORY];
+	oldest = sensor->history[count <= ROCKCHIP_TEMP_HISTORY ? 0 :
+				 count % ROCKCHIP_TEMP_HISTORY];
+
+	*trend = newest - oldest;
+	if (abs(*trend) < ROCKCHIP_TREND_THRESHOLD)
+		*trend = 0;
+
+	return 0;
+}
+
 static const struct thermal_zone_of_device_ops rockchip_of_thermal_ops = {
 	.get_temp = rockchip_thermal_get_temp,
+	.get_trend = rockchip_thermal_get_trend,
 };
 
 static int rockchip_configure_from_dt(struct device *dev,
@@ -455,6 +554,7 @@ rockchip_thermal_register_sensor(struct platform_device *pdev,
 
 	sensor->thermal = thermal;
 	sensor->id = id;
+	sensor->alarm_temp = INT_MAX;
 	sensor->tzd = thermal_zone_of_sensor_register(&pdev->dev, id, sensor,
 						      &rockchip_of_thermal_ops);
 	if (IS_ERR(sensor->tzd)) {
@@ -671,6 +771,9 @@ static int __maybe_unused rockchip_thermal_resume(struct device *dev)
 					      thermal->tshut_mode);
 		thermal->chip->set_tshut_temp(id, thermal->regs,
 					      thermal->tshut_temp);
+		/* The reset cleared the alarm, re-arm it on the next update */
+		thermal->sensors[i].alarm_temp = INT_MAX;
+		thermal->sensors[i].history_count = 0;
 	}
 
 	thermal->chip->control(thermal->regs, true);
@@ -1536,16 +1536,27 @@ static void
 n_tty_receive_buf_raw(struct tty_struct *tty, const unsigned char *cp,
 		      char *fp, int count)
 {
-	struct n_tty_data *ldata = tty->disc_data;
-	char flag = TTY_NORMAL;
+	int n;
 
-	while (count--) {
+	/* Copy runs of unflagged characters in bulk. */
+	while (count) {
 		if (fp)
-			flag = *fp++;
-		if (likely(flag == TTY_NORMAL))
-			put_tty_queue(*cp++, ldata);
+			for (n = 0; n < count && fp[n] == TTY_NORMAL; n++)
+				;
 		else
-			n_tty_receive_char_flagged(tty, *cp++, flag);
+			n = count;
+
+		if (n) {
+			n_tty_receive_buf_real_raw(tty, cp, NULL, n);
+			cp += n;
+			count -= n;
+			if (fp)
+				fp += n;
+			continue;
+		}
+
+		n_tty_receive_char_flagged(tty, *cp++, *fp++);
+		count--;
 	}
 }
 
@@ -42,6 +42,16 @@ struct uart_8250_dma {
 	size_t			rx_size;
 	size_t			tx_size;
 
+	/*
+	 * If set, RX DMA runs continuously on rx_buf as a ring of rx_periods
+	 * periods, and the received data is pushed from rx_pos onwards at the
+	 * end of each period and on RX timeout.
+	 */
+	unsigned int		rx_periods;
+	size_t			rx_pos;
+	/* burst length asked for by the driver, before rx_trig_bytes */
+	u32			rx_maxburst;
+
 	unsigned char		tx_running;
 	unsigned char		tx_err;
 	unsigned char		rx_running;
@@ -179,6 +189,8 @@ extern int serial8250_tx_dma(struct uart_8250_port *);
 extern int serial8250_rx_dma(struct uart_8250_port *, unsigned int iir);
 extern int serial8250_request_dma(struct uart_8250_port *);
 extern void serial8250_release_dma(struct uart_8250_port *);
+extern void serial8250_rx_dma_set_trigger(struct uart_8250_port *,
+					  unsigned int bytes);
 #else
 static inline int serial8250_tx_dma(struct uart_8250_port *p)
 {
@@ -193,6 +205,8 @@ static inline int serial8250_request_dma(struct uart_8250_port *p)
 	return -1;
 }
 static inline void serial8250_release_dma(struct uart_8250_port *p) { }
+static inline void serial8250_rx_dma_set_trigger(struct uart_8250_port *p,
+						 unsigned int bytes) { }
 #endif
 
 static inline int ns16550a_goto_highspeed(struct uart_8250_port *up)
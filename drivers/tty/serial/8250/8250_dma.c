@@ -68,6 +68,109 @@ static void __dma_rx_complete(void *param)
 	tty_flip_buffer_push(tty_port);
 }
 
+/*
+ * Hand what the cyclic RX transfer wrote since the last call to the tty
+ * layer, must be called with the port lock held.
+ */
+static void __dma_rx_cyclic_push(struct uart_8250_port *p)
+{
+	struct uart_8250_dma	*dma = p->dma;
+	struct tty_port		*tty_port = &p->port.state->port;
+	struct dma_tx_state	state;
+	size_t			pos;
+
+	dmaengine_tx_status(dma->rxchan, dma->rx_cookie, &state);
+
+	pos = dma->rx_size - state.residue;
+	if (pos >= dma->rx_size)
+		pos = 0;
+
+	if (pos < dma->rx_pos) {
+		tty_insert_flip_string(tty_port, dma->rx_buf + dma->rx_pos,
+				       dma->rx_size - dma->rx_pos);
+		p->port.icount.rx += dma->rx_size - dma->rx_pos;
+		dma->rx_pos = 0;
+	}
+
+	tty_insert_flip_string(tty_port, dma->rx_buf + dma->rx_pos,
+			       pos - dma->rx_pos);
+	p->port.icount.rx += pos - dma->rx_pos;
+	dma->rx_pos = pos;
+}
+
+static void __dma_rx_cyclic_complete(void *param)
+{
+	struct uart_8250_port	*p = param;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&p->port.lock, flags);
+	if (p->dma->rx_running)
+		__dma_rx_cyclic_push(p);
+	spin_unlock_irqrestore(&p->port.lock, flags);
+
+	tty_flip_buffer_push(&p->port.state->port);
+}
+
+static int serial8250_rx_dma_cyclic(struct uart_8250_port *p, unsigned int iir)
+{
+	struct uart_8250_dma		*dma = p->dma;
+	struct dma_async_tx_descriptor	*desc;
+	unsigned char			lsr;
+
+	switch (iir & 0x3f) {
+	case UART_IIR_RLSI:
+		/* keep the data ahead of the error in order */
+		if (dma->rx_running)
+			__dma_rx_cyclic_push(p);
+		return -EIO;
+	case UART_IIR_RX_TIMEOUT:
+		if (!dma->rx_running)
+			return -ETIMEDOUT;
+		/*
+		 * Less than a burst is left in the FIFO. Push what the DMA
+		 * has written so far and read the rest by hand, with the
+		 * DMA held so that it cannot take bytes behind our back.
+		 */
+		dmaengine_pause(dma->rxchan);
+		__dma_rx_cyclic_push(p);
+		lsr = serial_port_in(&p->port, UART_LSR);
+		if (lsr & (UART_LSR_DR | UART_LSR_BI))
+			serial8250_rx_chars(p, lsr);
+		else
+			tty_flip_buffer_push(&p->port.state->port);
+		if (dmaengine_resume(dma->rxchan)) {
+			/* stuck paused, carry on one transfer at a time */
+			dmaengine_terminate_all(dma->rxchan);
+			dma->rx_running = 0;
+			dma->rx_periods = 0;
+		}
+		return 0;
+	default:
+		break;
+	}
+
+	if (dma->rx_running)
+		return 0;
+
+	desc = dmaengine_prep_dma_cyclic(dma->rxchan, dma->rx_addr,
+					 dma->rx_size,
+					 dma->rx_size / dma->rx_periods,
+					 DMA_DEV_TO_MEM, DMA_PREP_INTERRUPT);
+	if (!desc)
+		return -EBUSY;
+
+	dma->rx_running = 1;
+	dma->rx_pos = 0;
+	desc->callback = __dma_rx_cyclic_complete;
+	desc->callback_param = p;
+
+	dma->rx_cookie = dmaengine_submit(desc);
+
+	dma_async_issue_pending(dma->rxchan);
+
+	return 0;
+}
+
 int serial8250_tx_dma(struct uart_8250_port *p)
 {
 	struct uart_8250_dma		*dma = p->dma;
@@ -122,6 +225,9 @@ int serial8250_rx_dma(struct uart_8250_port *p, unsigned int iir)
 	struct uart_8250_dma		*dma = p->dma;
 	struct dma_async_tx_descriptor	*desc;
 
+	if (dma->rx_periods)
+		return serial8250_rx_dma_cyclic(p, iir);
+
 	switch (iir & 0x3f) {
 	case UART_IIR_RLSI:
 		/* 8250_core handles errors and break interrupts */
@@ -189,6 +295,23 @@ int serial8250_request_dma(struct uart_8250_port *p)
 		return -ENODEV;
 
 	dmaengine_slave_config(dma->rxchan, &dma->rxconf);
+	dma->rx_maxburst = dma->rxconf.src_maxburst;
+
+	/*
+	 * Cyclic RX needs to know how far into a period the DMA is on RX
+	 * timeout, and to hold it while the FIFO is drained.
+	 */
+	if (dma->rx_periods) {
+		struct dma_slave_caps caps;
+
+		if (dma_get_slave_caps(dma->rxchan, &caps) || !caps.cmd_pause ||
+		    !dma->rxchan->device->device_resume ||
+		    caps.residue_granularity ==
+				DMA_RESIDUE_GRANULARITY_DESCRIPTOR) {
+			dev_dbg(p->port.dev, "no cyclic RX DMA\n");
+			dma->rx_periods = 0;
+		}
+	}
 
 	/* Get a channel for TX */
 	dma->txchan = dma_request_slave_channel_compat(mask,
@@ -245,6 +368,7 @@ void serial8250_release_dma(struct uart_8250_port *p)
 			  dma->rx_addr);
 	dma_release_channel(dma->rxchan);
 	dma->rxchan = NULL;
+	dma->rx_running = 0;
 
 	/* Release TX resources */
 	dmaengine_terminate_all(dma->txchan);
@@ -257,3 +381,28 @@ void serial8250_release_dma(struct uart_8250_port *p)
 	dev_dbg_ratelimited(p->port.dev, "dma channels released\n");
 }
 EXPORT_SYMBOL_GPL(serial8250_release_dma);
+
+/*
+ * The UART only raises its RX DMA request once the FIFO holds rx_trig_bytes,
+ * so a longer burst would read past the data. Shorten the burst to match a
+ * new trigger level, restarting RX DMA on the next RX interrupt.
+ */
+void serial8250_rx_dma_set_trigger(struct uart_8250_port *p,
+				   unsigned int bytes)
+{
+	struct uart_8250_dma	*dma = p->dma;
+	unsigned long		flags;
+
+	if (!dma || !dma->rxchan || !dma->rx_maxburst)
+		return;
+
+	spin_lock_irqsave(&p->port.lock, flags);
+
+	dmaengine_terminate_all(dma->rxchan);
+	dma->rx_running = 0;
+
+	dma->rxconf.src_maxburst = min_t(u32, dma->rx_maxburst, bytes);
+	dmaengine_slave_config(dma->rxchan, &dma->rxconf);
+
+	spin_unlock_irqrestore(&p->port.lock, flags);
+}
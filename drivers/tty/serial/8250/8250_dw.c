@@ -323,6 +323,16 @@ static int dw8250_probe_of(struct uart_port *p,
 
 		up->dma->rxconf.src_maxburst = p->fifosize / 4;
 		up->dma->txconf.dst_maxburst = p->fifosize / 4;
+
+		/*
+		 * Rockchip UARTs often carry high speed Bluetooth HCI; keep
+		 * their RX DMA running on a ring rather than re-arming it,
+		 * and thereby taking an interrupt, every few bytes.
+		 */
+		if (of_device_is_compatible(np, "rockchip,rk3188-uart") ||
+		    of_device_is_compatible(np, "rockchip,rk3288-uart") ||
+		    of_device_is_compatible(np, "rockchip,rk3368-uart"))
+			up->dma->rx_periods = 4;
 	}
 
 	if (!of_property_read_u32(np, "reg-shift", &val))
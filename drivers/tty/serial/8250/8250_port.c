@@ -2607,6 +2607,10 @@ static int do_set_rxtrig(struct tty_port *port, unsigned char bytes)
 	up->fcr &= ~UART_FCR_TRIGGER_MASK;
 	up->fcr |= (unsigned char)rxtrig;
 	serial_out(up, UART_FCR, up->fcr);
+
+	if (up->dma)
+		serial8250_rx_dma_set_trigger(up, fcr_get_rxtrig_bytes(up));
+
 	return 0;
 }
 
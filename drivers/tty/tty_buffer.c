@@ -403,7 +403,10 @@ void tty_schedule_flip(struct tty_port *port)
 	 * flush_to_ldisc() sees buffer data.
 	 */
 	smp_store_release(&buf->tail->commit, buf->tail->used);
-	schedule_work(&buf->work);
+	if (port->low_latency)
+		queue_work(system_highpri_wq, &buf->work);
+	else
+		schedule_work(&buf->work);
 }
 EXPORT_SYMBOL(tty_schedule_flip);
 
@@ -534,10 +537,23 @@ static void flush_to_ldisc(struct work_struct *work)
  *
  *	In the event of the queue being busy for flipping the work will be
  *	held off and retried later.
+ *
+ *	For low_latency ports called from a context that may sleep, such as
+ *	a threaded interrupt handler, the line discipline is fed directly
+ *	instead, saving the round trip through the workqueue.
  */
 
 void tty_flip_buffer_push(struct tty_port *port)
 {
+	struct tty_bufhead *buf = &port->buf;
+
+	if (port->low_latency && preemptible()) {
+		/* paired w/ acquire in flush_to_ldisc() */
+		smp_store_release(&buf->tail->commit, buf->tail->used);
+		flush_to_ldisc(&buf->work);
+		return;
+	}
+
 	tty_schedule_flip(port);
 }
 EXPORT_SYMBOL(tty_flip_buffer_push);
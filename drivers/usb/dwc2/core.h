@@ -586,6 +586,10 @@ struct dwc2_hregs_backup {
  * @non_periodic_sched_active: Active QHs in the non-periodic schedule.
  *                      Transfers associated with these QHs are currently
  *                      assigned to a host channel.
+ * @non_periodic_sched_waiting: Waiting QHs in the non-periodic schedule.
+ *                      These QHs were NAKed repeatedly and are held back
+ *                      until their wait_timer moves them to the inactive
+ *                      schedule.
  * @non_periodic_qh_ptr: Pointer to next QH to process in the active
  *                      non-periodic schedule
  * @periodic_sched_inactive: Inactive QHs in the periodic schedule. This is a
@@ -647,6 +651,8 @@ struct dwc2_hregs_backup {
  * @status_buf_dma:     DMA address for status_buf
  * @start_work:         Delayed work for handling host A-cable connection
  * @reset_work:         Delayed work for handling a port reset
+ * @ddma_fallback_work: Work for dropping from descriptor DMA to buffer DMA
+ *                      mode once a split transaction is needed
  * @otg_port:           OTG port number
  * @frame_list:         Frame list
  * @frame_list_dma:     Frame list DMA address
@@ -739,6 +745,7 @@ struct dwc2_hsotg {
 
 	struct list_head non_periodic_sched_inactive;
 	struct list_head non_periodic_sched_active;
+	struct list_head non_periodic_sched_waiting;
 	struct list_head *non_periodic_qh_ptr;
 	struct list_head periodic_sched_inactive;
 	struct list_head periodic_sched_ready;
@@ -769,6 +776,7 @@ struct dwc2_hsotg {
 
 	struct delayed_work start_work;
 	struct delayed_work reset_work;
+	struct work_struct ddma_fallback_work;
 	u8 otg_port;
 	u32 *frame_list;
 	dma_addr_t frame_list_dma;
@@ -1365,9 +1365,8 @@ static void s3c_hsotg_program_zlp(struct dwc2_hsotg *hsotg,
  * @hs_req: The request to complete.
  * @result: The result code (0 => Ok, otherwise errno)
  *
- * The given request has finished, so call the necessary completion
- * if it has one and then look to see if we can start a new request
- * on the endpoint.
+ * The given request has finished, so start the next request queued on
+ * the endpoint and then call the necessary completion if it has one.
  *
  * Note, expects the ep to already be locked as appropriate.
  */
@@ -1402,6 +1401,15 @@ static void s3c_hsotg_complete_request(struct dwc2_hsotg *hsotg,
 	if (using_dma(hsotg))
 		s3c_hsotg_unmap_dma(hsotg, hs_ep, hs_req);
 
+	/*
+	 * Load the next queued request before giving this one back, so the
+	 * endpoint keeps moving data while the gadget driver runs its
+	 * completion instead of NAKing the host until it requeues. EP0 is
+	 * left alone as its state machine advances from the completions.
+	 */
+	if (hs_ep->index != 0 && result >= 0 && !list_empty(&hs_ep->queue))
+		s3c_hsotg_start_req(hsotg, hs_ep, get_ep_head(hs_ep), false);
+
 	/*
 	 * call the complete request with the locks off, just in case the
 	 * request tries to queue more work for this endpoint.
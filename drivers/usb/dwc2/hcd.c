@@ -110,6 +110,10 @@ static void dwc2_dump_channel_info(struct dwc2_hsotg *hsotg,
 	list_for_each_entry(qh, &hsotg->non_periodic_sched_active,
 			    qh_list_entry)
 		dev_dbg(hsotg->dev, "    %p\n", qh);
+	dev_dbg(hsotg->dev, "  NP waiting sched:\n");
+	list_for_each_entry(qh, &hsotg->non_periodic_sched_waiting,
+			    qh_list_entry)
+		dev_dbg(hsotg->dev, "    %p\n", qh);
 	dev_dbg(hsotg->dev, "  Channels:\n");
 	for (i = 0; i < num_channels; i++) {
 		struct dwc2_host_chan *chan = hsotg->hc_ptr_array[i];
@@ -184,6 +188,7 @@ static void dwc2_kill_all_urbs(struct dwc2_hsotg *hsotg)
 {
 	dwc2_kill_urbs_in_qh_list(hsotg, &hsotg->non_periodic_sched_inactive);
 	dwc2_kill_urbs_in_qh_list(hsotg, &hsotg->non_periodic_sched_active);
+	dwc2_kill_urbs_in_qh_list(hsotg, &hsotg->non_periodic_sched_waiting);
 	dwc2_kill_urbs_in_qh_list(hsotg, &hsotg->periodic_sched_inactive);
 	dwc2_kill_urbs_in_qh_list(hsotg, &hsotg->periodic_sched_ready);
 	dwc2_kill_urbs_in_qh_list(hsotg, &hsotg->periodic_sched_assigned);
@@ -2266,6 +2271,54 @@ static void dwc2_hcd_reset_func(struct work_struct *work)
 	hsotg->flags.b.port_reset_change = 1;
 }
 
+/*
+ * Work queue function for leaving descriptor DMA mode
+ *
+ * Descriptor DMA cannot carry SPLIT transactions, so the first FS/LS device
+ * behind a HS hub makes the host switch to buffer DMA mode for good. HCFG
+ * DescDMA may only change while the port is idle, so the root port is
+ * power-cycled and everything on it re-enumerates in the new mode.
+ */
+static void dwc2_hcd_ddma_fallback_func(struct work_struct *work)
+{
+	struct dwc2_hsotg *hsotg = container_of(work, struct dwc2_hsotg,
+						ddma_fallback_work);
+	unsigned long flags;
+	u32 hprt0, hcfg;
+
+	spin_lock_irqsave(&hsotg->lock, flags);
+
+	if (hsotg->core_params->dma_desc_enable <= 0 ||
+	    !dwc2_is_host_mode(hsotg)) {
+		spin_unlock_irqrestore(&hsotg->lock, flags);
+		return;
+	}
+
+	dev_info(hsotg->dev,
+		 "SPLIT transfer needed, switching to buffer DMA mode\n");
+
+	hprt0 = dwc2_read_hprt0(hsotg);
+	hprt0 &= ~HPRT0_PWR;
+	writel(hprt0, hsotg->regs + HPRT0);
+	dwc2_hcd_disconnect(hsotg);
+
+	hsotg->core_params->dma_desc_enable = 0;
+	hcfg = readl(hsotg->regs + HCFG);
+	hcfg &= ~(HCFG_DESCDMA | HCFG_PERSCHEDENA);
+	writel(hcfg, hsotg->regs + HCFG);
+
+	spin_unlock_irqrestore(&hsotg->lock, flags);
+
+	/* Give the devices on the port time to see the power drop */
+	msleep(200);
+
+	spin_lock_irqsave(&hsotg->lock, flags);
+	hprt0 = dwc2_read_hprt0(hsotg);
+	hprt0 |= HPRT0_PWR;
+	writel(hprt0, hsotg->regs + HPRT0);
+	spin_unlock_irqrestore(&hsotg->lock, flags);
+}
+
 /*
  * =========================================================================
  *  Linux HC Driver Functions
@@ -2761,6 +2814,7 @@ static void dwc2_hcd_free(struct dwc2_hsotg *hsotg)
 	/* Free memory for QH/QTD lists */
 	dwc2_qh_list_free(hsotg, &hsotg->non_periodic_sched_inactive);
 	dwc2_qh_list_free(hsotg, &hsotg->non_periodic_sched_active);
+	dwc2_qh_list_free(hsotg, &hsotg->non_periodic_sched_waiting);
 	dwc2_qh_list_free(hsotg, &hsotg->periodic_sched_inactive);
 	dwc2_qh_list_free(hsotg, &hsotg->periodic_sched_ready);
 	dwc2_qh_list_free(hsotg, &hsotg->periodic_sched_assigned);
@@ -2804,6 +2858,7 @@ static void dwc2_hcd_free(struct dwc2_hsotg *hsotg)
 	}
 
 	if (hsotg->wq_otg) {
+		cancel_work_sync(&hsotg->ddma_fallback_work);
 		if (!cancel_work_sync(&hsotg->wf_otg))
 			flush_workqueue(hsotg->wq_otg);
 		destroy_workqueue(hsotg->wq_otg);
@@ -2912,6 +2967,7 @@ int dwc2_hcd_init(struct dwc2_hsotg *hsotg, int irq)
 	/* Initialize the non-periodic schedule */
 	INIT_LIST_HEAD(&hsotg->non_periodic_sched_inactive);
 	INIT_LIST_HEAD(&hsotg->non_periodic_sched_active);
+	INIT_LIST_HEAD(&hsotg->non_periodic_sched_waiting);
 
 	/* Initialize the periodic schedule */
 	INIT_LIST_HEAD(&hsotg->periodic_sched_inactive);
@@ -2944,6 +3000,9 @@ int dwc2_hcd_init(struct dwc2_hsotg *hsotg, int irq)
 	/* Initialize port reset work */
 	INIT_DELAYED_WORK(&hsotg->reset_work, dwc2_hcd_reset_func);
 
+	/* Initialize descriptor DMA fallback work */
+	INIT_WORK(&hsotg->ddma_fallback_work, dwc2_hcd_ddma_fallback_func);
+
 	/*
 	 * Allocate space for storing data on status transactions. Normally no
 	 * data is sent, but this space acts as a bit bucket. This must be
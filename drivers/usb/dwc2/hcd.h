@@ -255,6 +255,11 @@ enum dwc2_transaction_type {
  *                      descriptor and indicates original XferSize value for the
  *                      descriptor
  * @tt_buffer_dirty     True if clear_tt_buffer_complete is pending
+ * @want_wait:          Wait before re-queuing this non-periodic QH, set after
+ *                      a run of NAKed split transactions
+ * @wait_timer_cancel:  Set to true to keep a pending wait_timer from acting
+ * @wait_timer:         Timer used to wait before re-queuing
+ * @hsotg:              The HCD state structure this QH belongs to
  *
  * A Queue Head (QH) holds the static characteristics of an endpoint and
  * maintains a list of transfers (QTDs) for that endpoint. A QH structure may
@@ -286,6 +291,10 @@ struct dwc2_qh {
 	dma_addr_t desc_list_dma;
 	u32 *n_bytes;
 	unsigned tt_buffer_dirty:1;
+	unsigned want_wait:1;
+	unsigned wait_timer_cancel:1;
+	struct hrtimer wait_timer;
+	struct dwc2_hsotg *hsotg;
 };
 
 /**
@@ -313,6 +322,7 @@ struct dwc2_qh {
  * @ssplit_out_xfer_count: How many bytes transferred during SSPLIT OUT
  * @error_count:        Holds the number of bus errors that have occurred for
  *                      a transaction within this transfer
+ * @num_naks:           Number of NAKs received in a row on split transactions
  * @n_desc:             Number of DMA descriptors for this QTD
  * @isoc_frame_index_last: Last activated frame (packet) index, used in
  *                      descriptor DMA mode only
@@ -342,6 +352,7 @@ struct dwc2_qtd {
 	u16 isoc_split_offset;
 	u32 ssplit_out_xfer_count;
 	u8 error_count;
+	u8 num_naks;
 	u8 n_desc;
 	u16 isoc_frame_index_last;
 	struct dwc2_hcd_urb *urb;
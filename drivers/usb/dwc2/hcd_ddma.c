@@ -318,8 +318,14 @@ int dwc2_hcd_qh_init_ddma(struct dwc2_hsotg *hsotg, struct dwc2_qh *qh,
 	int retval;
 
 	if (qh->do_split) {
-		dev_err(hsotg->dev,
+		/*
+		 * The core cannot do SPLIT transactions from descriptor lists.
+		 * Fail this QH and let the host drop back to buffer DMA mode,
+		 * the device is picked up again when the port re-enumerates.
+		 */
+		dev_dbg(hsotg->dev,
 			"SPLIT Transfers are not supported in Descriptor DMA mode.\n");
+		queue_work(hsotg->wq_otg, &hsotg->ddma_fallback_work);
 		retval = -EINVAL;
 		goto err0;
 	}
@@ -52,6 +52,12 @@
 #include "core.h"
 #include "hcd.h"
 
+/*
+ * If we get this many NAKs on a split transaction we'll start delaying
+ * our retry, see dwc2_hc_nak_intr()
+ */
+#define DWC2_NAKS_BEFORE_DELAY		3
+
 /* This function is for debug only */
 static void dwc2_track_missed_sofs(struct dwc2_hsotg *hsotg)
 {
@@ -989,6 +995,10 @@ static void dwc2_hc_xfercomp_intr(struct dwc2_hsotg *hsotg,
 	if (!urb)
 		goto handle_xfercomp_done;
 
+	/* Data moved, so the endpoint is no longer idle */
+	qtd->num_naks = 0;
+	qtd->qh->want_wait = 0;
+
 	pipe_type = dwc2_hcd_get_pipe_type(&urb->pipe_info);
 
 	if (hsotg->core_params->dma_desc_enable > 0) {
@@ -1225,11 +1235,19 @@ static void dwc2_hc_nak_intr(struct dwc2_hsotg *hsotg,
 	/*
 	 * Handle NAK for IN/OUT SSPLIT/CSPLIT transfers, bulk, control, and
 	 * interrupt. Re-start the SSPLIT transfer.
+	 *
+	 * An idle FS/LS device behind a hub NAKs every start split. Retrying
+	 * straight from here just earns another NAK interrupt, so after a few
+	 * in a row the QH is parked in the waiting schedule and its channel
+	 * goes back to other endpoints until the retry delay expires.
 	 */
 	if (chan->do_split) {
 		if (chan->complete_split)
 			qtd->error_count = 0;
 		qtd->complete_split = 0;
+		if (qtd->num_naks < DWC2_NAKS_BEFORE_DELAY)
+			qtd->num_naks++;
+		qtd->qh->want_wait = qtd->num_naks >= DWC2_NAKS_BEFORE_DELAY;
 		dwc2_halt_channel(hsotg, chan, qtd, DWC2_HC_XFER_NAK);
 		goto handle_nak_done;
 	}
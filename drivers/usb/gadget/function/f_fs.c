@@ -33,6 +33,7 @@
 #include <linux/mmu_context.h>
 #include <linux/poll.h>
 #include <linux/eventfd.h>
+#include <linux/scatterlist.h>
 
 #include "u_fs.h"
 #include "u_f.h"
@@ -149,6 +150,10 @@ struct ffs_io_data {
 	const void *to_free;
 	char *buf;
 
+	/* user pages pinned for the request instead of buf */
+	bool use_sg;
+	struct sg_table sgt;
+
 	struct mm_struct *mm;
 	struct work_struct work;
 
@@ -630,6 +635,102 @@ static const struct file_operations ffs_ep0_operations = {
 
 /* "Normal" endpoints operations ********************************************/
 
+/*
+ * Below this, copying through a bounce buffer is cheaper than pinning the
+ * user pages and mapping them for the controller.
+ */
+#define FFS_ZERO_COPY_MIN	(4 * PAGE_SIZE)
+
+static bool ffs_epfile_can_pin(struct usb_gadget *gadget,
+			       struct ffs_io_data *io_data, size_t data_len)
+{
+	/*
+	 * The request has to cover the user buffer exactly: if it was rounded
+	 * up to maxpacketsize, the host could write past the end of it.
+	 */
+	return gadget->sg_supported && data_len >= FFS_ZERO_COPY_MIN &&
+	       data_len == iov_iter_count(&io_data->data) &&
+	       iter_is_iovec(&io_data->data);
+}
+
+static void ffs_epfile_unpin_pages(struct ffs_io_data *io_data,
+				   unsigned int nents)
+{
+	struct scatterlist *sg;
+	unsigned int i;
+
+	for_each_sg(io_data->sgt.sgl, sg, nents, i) {
+		if (io_data->read)
+			set_page_dirty_lock(sg_page(sg));
+		put_page(sg_page(sg));
+	}
+	sg_free_table(&io_data->sgt);
+	io_data->use_sg = false;
+}
+
+/*
+ * Pin the pages of the user buffer described by io_data->data into
+ * io_data->sgt, one entry per page, so that the controller reads or writes
+ * them directly.
+ */
+static int ffs_epfile_pin_pages(struct ffs_io_data *io_data)
+{
+	struct iov_iter iter = io_data->data;
+	struct scatterlist *sg = NULL;
+	unsigned int nents = 0;
+	struct page *pages[16];
+	ssize_t len;
+	size_t start, n;
+	int i, ret;
+
+	ret = sg_alloc_table(&io_data->sgt, iov_iter_npages(&iter, INT_MAX),
+			     GFP_KERNEL);
+	if (unlikely(ret))
+		return ret;
+
+	while (iov_iter_count(&iter)) {
+		len = iov_iter_get_pages(&iter, pages, iov_iter_count(&iter),
+					 ARRAY_SIZE(pages), &start);
+		if (unlikely(len <= 0)) {
+			ret = len ? len : -EFAULT;
+			goto error;
+		}
+		iov_iter_advance(&iter, len);
+
+		for (i = 0; len; i++) {
+			n = min_t(size_t, len, PAGE_SIZE - start);
+			sg = sg ? sg_next(sg) : io_data->sgt.sgl;
+			sg_set_page(sg, pages[i], n, start);
+			nents++;
+			len -= n;
+			start = 0;
+		}
+	}
+	io_data->use_sg = true;
+
+	return 0;
+
+error:
+	ffs_epfile_unpin_pages(io_data, nents);
+	return ret;
+}
+
+static void ffs_epfile_fill_req(struct usb_request *req,
+				struct ffs_io_data *io_data,
+				char *data, size_t data_len)
+{
+	if (io_data->use_sg) {
+		req->buf     = NULL;
+		req->sg      = io_data->sgt.sgl;
+		req->num_sgs = io_data->sgt.orig_nents;
+	} else {
+		req->buf     = data;
+		req->sg      = NULL;
+		req->num_sgs = 0;
+	}
+	req->length = data_len;
+}
+
 static void ffs_epfile_io_complete(struct usb_ep *_ep, struct usb_request *req)
 {
 	ENTER();
@@ -647,7 +748,7 @@ static void ffs_user_copy_worker(struct work_struct *work)
 	int ret = io_data->req->status ? io_data->req->status :
 					 io_data->req->actual;
 
-	if (io_data->read && ret > 0) {
+	if (io_data->read && ret > 0 && !io_data->use_sg) {
 		use_mm(io_data->mm);
 		ret = copy_to_iter(io_data->buf, ret, &io_data->data);
 		if (iov_iter_count(&io_data->data))
@@ -664,6 +765,8 @@ static void ffs_user_copy_worker(struct work_struct *work)
 	usb_ep_free_request(io_data->ep, io_data->req);
 
 	io_data->kiocb->private = NULL;
+	if (io_data->use_sg)
+		ffs_epfile_unpin_pages(io_data, io_data->sgt.orig_nents);
 	if (io_data->read)
 		kfree(io_data->to_free);
 	kfree(io_data->buf);
@@ -689,6 +792,8 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 	ssize_t ret, data_len = -EINVAL;
 	int halt;
 
+	io_data->use_sg = false;
+
 	/* Are we still active? */
 	if (WARN_ON(epfile->ffs->state != FFS_ACTIVE)) {
 		ret = -ENODEV;
@@ -741,6 +846,16 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 			data_len = usb_ep_align_maybe(gadget, ep->ep, data_len);
 		spin_unlock_irq(&epfile->ffs->eps_lock);
 
+		if (ffs_epfile_can_pin(gadget, io_data, data_len)) {
+			ret = ffs_epfile_pin_pages(io_data);
+			if (unlikely(ret))
+				return ret;
+			/* The request sends it all, as the copy would. */
+			if (!io_data->read)
+				iov_iter_advance(&io_data->data, data_len);
+			goto pinned;
+		}
+
 		data = kmalloc(data_len, GFP_KERNEL);
 		if (unlikely(!data))
 			return -ENOMEM;
@@ -753,6 +868,7 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 		}
 	}
 
+pinned:
 	/* We will be using request */
 	ret = ffs_mutex_lock(&epfile->mutex, file->f_flags & O_NONBLOCK);
 	if (unlikely(ret))
@@ -763,7 +879,7 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 	if (epfile->ep != ep) {
 		/* In the meantime, endpoint got disabled or changed. */
 		ret = -ESHUTDOWN;
-		spin_unlock_irq(&epfile->ffs->eps_lock);
+		goto error_lock;
 	} else if (halt) {
 		/* Halt */
 		if (likely(epfile->ep == ep) && !WARN_ON(!ep->ep))
@@ -796,8 +912,7 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 			if (unlikely(!req))
 				goto error_lock;
 
-			req->buf      = data;
-			req->length   = data_len;
+			ffs_epfile_fill_req(req, io_data, data, data_len);
 
 			io_data->buf = data;
 			io_data->ep = ep->ep;
@@ -819,8 +934,7 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 			DECLARE_COMPLETION_ONSTACK(done);
 
 			req = ep->req;
-			req->buf      = data;
-			req->length   = data_len;
+			ffs_epfile_fill_req(req, io_data, data, data_len);
 
 			req->context  = &done;
 			req->complete = ffs_epfile_io_complete;
@@ -844,13 +958,19 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 				 * data then user space has space for.
 				 */
 				ret = ep->status;
-				if (io_data->read && ret > 0) {
+				if (io_data->read && ret > 0 &&
+				    io_data->use_sg) {
+					iov_iter_advance(&io_data->data, ret);
+				} else if (io_data->read && ret > 0) {
 					ret = copy_to_iter(data, ret, &io_data->data);
 					if (!ret)
 						ret = -EFAULT;
 				}
 			}
 			kfree(data);
+			if (io_data->use_sg)
+				ffs_epfile_unpin_pages(io_data,
+						       io_data->sgt.orig_nents);
 		}
 	}
 
@@ -862,6 +982,8 @@ error_lock:
 	mutex_unlock(&epfile->mutex);
 error:
 	kfree(data);
+	if (io_data->use_sg)
+		ffs_epfile_unpin_pages(io_data, io_data->sgt.orig_nents);
 	return ret;
 }
 
@@ -197,6 +197,7 @@
 /* #define VERBOSE_DEBUG */
 /* #define DUMP_MSGS */
 
+#include <linux/bio.h>
 #include <linux/blkdev.h>
 #include <linux/completion.h>
 #include <linux/dcache.h>
@@ -215,6 +216,7 @@
 #include <linux/freezer.h>
 #include <linux/module.h>
 #include <linux/uaccess.h>
+#include <linux/uio.h>
 
 #include <linux/usb/ch9.h>
 #include <linux/usb/gadget.h>
@@ -275,6 +277,7 @@ struct fsg_common {
 	struct fsg_buffhd	*next_buffhd_to_drain;
 	struct fsg_buffhd	*buffhds;
 	unsigned int		fsg_num_buffers;
+	unsigned int		buflen;
 
 	int			cmnd_size;
 	u8			cmnd[MAX_COMMAND_SIZE];
@@ -637,6 +640,39 @@ static int sleep_thread(struct fsg_common *common, bool can_freeze)
 
 /*-------------------------------------------------------------------------*/
 
+/*
+ * Read or write the backing file. Except for O_DIRECT, where the block
+ * layer needs the pages behind the buffer, the buffer is passed as user
+ * memory; the main thread runs with KERNEL_DS.
+ */
+static ssize_t fsg_lun_rw(struct fsg_lun *curlun, int rw,
+			  struct fsg_buffhd *bh, unsigned int amount,
+			  loff_t *pos)
+{
+	struct iov_iter iter;
+	unsigned int i, n;
+
+	if (!curlun->direct) {
+		if (rw == WRITE)
+			return vfs_write(curlun->filp, (char __user *)bh->buf,
+					 amount, pos);
+		return vfs_read(curlun->filp, (char __user *)bh->buf,
+				amount, pos);
+	}
+
+	for (i = 0, n = 0; n < amount; i++, n += PAGE_SIZE) {
+		bh->bvec[i].bv_page = virt_to_page(bh->buf + n);
+		bh->bvec[i].bv_offset = 0;
+		bh->bvec[i].bv_len = min_t(unsigned int, amount - n,
+					   PAGE_SIZE);
+	}
+	iov_iter_bvec(&iter, ITER_BVEC | rw, bh->bvec, i, amount);
+
+	if (rw == WRITE)
+		return vfs_iter_write(curlun->filp, &iter, pos);
+	return vfs_iter_read(curlun->filp, &iter, pos);
+}
+
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
@@ -685,7 +721,7 @@ static int do_read(struct fsg_common *common)
 		 * But don't read more than the buffer size.
 		 * And don't try to read past the end of the file.
 		 */
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, common->buflen);
 		amount = min((loff_t)amount,
 			     curlun->file_length - file_offset);
 
@@ -714,9 +750,7 @@ static int do_read(struct fsg_common *common)
 
 		/* Perform the read */
 		file_offset_tmp = file_offset;
-		nread = vfs_read(curlun->filp,
-				 (char __user *)bh->buf,
-				 amount, &file_offset_tmp);
+		nread = fsg_lun_rw(curlun, READ, bh, amount, &file_offset_tmp);
 		VLDBG(curlun, "file read %u @ %llu -> %d\n", amount,
 		      (unsigned long long)file_offset, (int)nread);
 		if (signal_pending(current))
@@ -835,7 +869,7 @@ static int do_write(struct fsg_common *common)
 			 * Try to get the remaining amount,
 			 * but not more than the buffer size.
 			 */
-			amount = min(amount_left_to_req, FSG_BUFLEN);
+			amount = min(amount_left_to_req, common->buflen);
 
 			/* Beyond the end of the backing file? */
 			if (usb_offset >= curlun->file_length) {
@@ -907,9 +941,8 @@ static int do_write(struct fsg_common *common)
 
 			/* Perform the write */
 			file_offset_tmp = file_offset;
-			nwritten = vfs_write(curlun->filp,
-					     (char __user *)bh->buf,
-					     amount, &file_offset_tmp);
+			nwritten = fsg_lun_rw(curlun, WRITE, bh, amount,
+					      &file_offset_tmp);
 			VLDBG(curlun, "file write %u @ %llu -> %d\n", amount,
 			      (unsigned long long)file_offset, (int)nwritten);
 			if (signal_pending(current))
@@ -1039,7 +1072,7 @@ static int do_verify(struct fsg_common *common)
 		 * the buffer size.
 		 * And don't try to read past the end of the file.
 		 */
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, common->buflen);
 		amount = min((loff_t)amount,
 			     curlun->file_length - file_offset);
 		if (amount == 0) {
@@ -1053,9 +1086,7 @@ static int do_verify(struct fsg_common *common)
 
 		/* Perform the read */
 		file_offset_tmp = file_offset;
-		nread = vfs_read(curlun->filp,
-				(char __user *) bh->buf,
-				amount, &file_offset_tmp);
+		nread = fsg_lun_rw(curlun, READ, bh, amount, &file_offset_tmp);
 		VLDBG(curlun, "file read %u @ %llu -> %d\n", amount,
 				(unsigned long long) file_offset,
 				(int) nread);
@@ -1497,7 +1528,7 @@ static int throw_away_data(struct fsg_common *common)
 		bh = common->next_buffhd_to_fill;
 		if (bh->state == BUF_STATE_EMPTY
 		 && common->usb_amount_left > 0) {
-			amount = min(common->usb_amount_left, FSG_BUFLEN);
+			amount = min(common->usb_amount_left, common->buflen);
 
 			/*
 			 * Except at the end of the transfer, amount will be
@@ -2662,10 +2693,21 @@ EXPORT_SYMBOL_GPL(fsg_common_put);
 /* check if fsg_num_buffers is within a valid range */
 static inline int fsg_num_buffers_validate(unsigned int fsg_num_buffers)
 {
-	if (fsg_num_buffers >= 2 && fsg_num_buffers <= 4)
+	if (fsg_num_buffers >= 2 && fsg_num_buffers <= 32)
 		return 0;
 	pr_err("fsg_num_buffers %u is out of range (%d to %d)\n",
-	       fsg_num_buffers, 2, 4);
+	       fsg_num_buffers, 2, 32);
+	return -EINVAL;
+}
+
+/* buffers are whole pages, which also suits every bulk maxpacket */
+static inline int fsg_buflen_validate(unsigned int buflen)
+{
+	if (buflen >= PAGE_SIZE && buflen <= FSG_BUFLEN_MAX &&
+	    PAGE_ALIGNED(buflen))
+		return 0;
+	pr_err("buflen %u is not a multiple of %lu up to %u\n",
+	       buflen, PAGE_SIZE, FSG_BUFLEN_MAX);
 	return -EINVAL;
 }
 
@@ -2685,6 +2727,7 @@ static struct fsg_common *fsg_common_setup(struct fsg_common *common)
 	init_completion(&common->thread_notifier);
 	init_waitqueue_head(&common->fsg_wait);
 	common->state = FSG_STATE_TERMINATED;
+	common->buflen = FSG_BUFLEN;
 	memset(common->luns, 0, sizeof(common->luns));
 
 	return common;
@@ -2696,26 +2739,30 @@ void fsg_common_set_sysfs(struct fsg_common *common, bool sysfs)
 }
 EXPORT_SYMBOL_GPL(fsg_common_set_sysfs);
 
-static void _fsg_common_free_buffers(struct fsg_buffhd *buffhds, unsigned n)
+static void _fsg_common_free_buffers(struct fsg_buffhd *buffhds, unsigned n,
+				     unsigned int buflen)
 {
 	if (buffhds) {
 		struct fsg_buffhd *bh = buffhds;
 		while (n--) {
-			kfree(bh->buf);
+			if (bh->buf)
+				free_pages_exact(bh->buf, buflen);
+			kfree(bh->bvec);
 			++bh;
 		}
 		kfree(buffhds);
 	}
 }
 
-int fsg_common_set_num_buffers(struct fsg_common *common, unsigned int n)
+/*
+ * The buffers are page aligned and made of whole pages, so that O_DIRECT
+ * I/O can use them as they are.
+ */
+static int _fsg_common_alloc_buffers(struct fsg_common *common,
+				     unsigned int n, unsigned int buflen)
 {
 	struct fsg_buffhd *bh, *buffhds;
-	int i, rc;
-
-	rc = fsg_num_buffers_validate(n);
-	if (rc != 0)
-		return rc;
+	int i;
 
 	buffhds = kcalloc(n, sizeof(*buffhds), GFP_KERNEL);
 	if (!buffhds)
@@ -2729,14 +2776,18 @@ int fsg_common_set_num_buffers(struct fsg_common *common, unsigned int n)
 		bh->next = bh + 1;
 		++bh;
 buffhds_first_it:
-		bh->buf = kmalloc(FSG_BUFLEN, GFP_KERNEL);
-		if (unlikely(!bh->buf))
+		bh->buf = alloc_pages_exact(buflen, GFP_KERNEL);
+		bh->bvec = kcalloc(buflen >> PAGE_SHIFT, sizeof(*bh->bvec),
+				   GFP_KERNEL);
+		if (unlikely(!bh->buf || !bh->bvec))
 			goto error_release;
 	} while (--i);
 	bh->next = buffhds;
 
-	_fsg_common_free_buffers(common->buffhds, common->fsg_num_buffers);
+	_fsg_common_free_buffers(common->buffhds, common->fsg_num_buffers,
+				 common->buflen);
 	common->fsg_num_buffers = n;
+	common->buflen = buflen;
 	common->buffhds = buffhds;
 
 	return 0;
@@ -2746,12 +2797,42 @@ error_release:
 	 * "buf"s pointed to by heads after n - i are NULL
 	 * so releasing them won't hurt
 	 */
-	_fsg_common_free_buffers(buffhds, n);
+	_fsg_common_free_buffers(buffhds, n, buflen);
 
 	return -ENOMEM;
 }
+
+int fsg_common_set_num_buffers(struct fsg_common *common, unsigned int n)
+{
+	int rc;
+
+	rc = fsg_num_buffers_validate(n);
+	if (rc != 0)
+		return rc;
+
+	return _fsg_common_alloc_buffers(common, n, common->buflen);
+}
 EXPORT_SYMBOL_GPL(fsg_common_set_num_buffers);
 
+int fsg_common_set_buflen(struct fsg_common *common, unsigned int buflen)
+{
+	int rc;
+
+	rc = fsg_buflen_validate(buflen);
+	if (rc != 0)
+		return rc;
+
+	/* Only remember it if the buffers come later */
+	if (!common->buffhds) {
+		common->buflen = buflen;
+		return 0;
+	}
+
+	return _fsg_common_alloc_buffers(common, common->fsg_num_buffers,
+					 buflen);
+}
+EXPORT_SYMBOL_GPL(fsg_common_set_buflen);
+
 void fsg_common_remove_lun(struct fsg_lun *lun)
 {
 	if (device_is_registered(&lun->dev))
@@ -2787,7 +2868,8 @@ EXPORT_SYMBOL_GPL(fsg_common_set_ops);
 
 void fsg_common_free_buffers(struct fsg_common *common)
 {
-	_fsg_common_free_buffers(common->buffhds, common->fsg_num_buffers);
+	_fsg_common_free_buffers(common->buffhds, common->fsg_num_buffers,
+				 common->buflen);
 	common->buffhds = NULL;
 }
 EXPORT_SYMBOL_GPL(fsg_common_free_buffers);
@@ -3019,7 +3101,8 @@ static void fsg_common_release(struct kref *ref)
 		kfree(lun);
 	}
 
-	_fsg_common_free_buffers(common->buffhds, common->fsg_num_buffers);
+	_fsg_common_free_buffers(common->buffhds, common->fsg_num_buffers,
+				 common->buflen);
 	if (common->free_storage_on_release)
 		kfree(common);
 }
@@ -3086,7 +3169,7 @@ static int fsg_bind(struct usb_configuration *c, struct usb_function *f)
 		fsg_fs_bulk_out_desc.bEndpointAddress;
 
 	/* Calculate bMaxBurst, we know packet size is 1024 */
-	max_burst = min_t(unsigned, FSG_BUFLEN / 1024, 15);
+	max_burst = min_t(unsigned, common->buflen / 1024, 15);
 
 	fsg_ss_bulk_in_desc.bEndpointAddress =
 		fsg_fs_bulk_in_desc.bEndpointAddress;
@@ -3255,12 +3338,33 @@ static struct fsg_lun_opts_attribute fsg_lun_opts_nofua =
 	__CONFIGFS_ATTR(nofua, S_IRUGO | S_IWUSR, fsg_lun_opts_nofua_show,
 			fsg_lun_opts_nofua_store);
 
+static ssize_t fsg_lun_opts_direct_show(struct fsg_lun_opts *opts, char *page)
+{
+	return fsg_show_direct(opts->lun, page);
+}
+
+static ssize_t fsg_lun_opts_direct_store(struct fsg_lun_opts *opts,
+					 const char *page, size_t len)
+{
+	struct fsg_opts *fsg_opts;
+
+	fsg_opts = to_fsg_opts(opts->group.cg_item.ci_parent);
+
+	return fsg_store_direct(opts->lun, &fsg_opts->common->filesem, page,
+				len);
+}
+
+static struct fsg_lun_opts_attribute fsg_lun_opts_direct =
+	__CONFIGFS_ATTR(direct, S_IRUGO | S_IWUSR, fsg_lun_opts_direct_show,
+			fsg_lun_opts_direct_store);
+
 static struct configfs_attribute *fsg_lun_attrs[] = {
 	&fsg_lun_opts_file.attr,
 	&fsg_lun_opts_ro.attr,
 	&fsg_lun_opts_removable.attr,
 	&fsg_lun_opts_cdrom.attr,
 	&fsg_lun_opts_nofua.attr,
+	&fsg_lun_opts_direct.attr,
 	NULL,
 };
 
@@ -3407,6 +3511,46 @@ static struct fsg_opts_attribute fsg_opts_stall =
 	__CONFIGFS_ATTR(stall, S_IRUGO | S_IWUSR, fsg_opts_stall_show,
 			fsg_opts_stall_store);
 
+static ssize_t fsg_opts_buflen_show(struct fsg_opts *opts, char *page)
+{
+	int result;
+
+	mutex_lock(&opts->lock);
+	result = sprintf(page, "%u", opts->common->buflen);
+	mutex_unlock(&opts->lock);
+
+	return result;
+}
+
+static ssize_t fsg_opts_buflen_store(struct fsg_opts *opts,
+				     const char *page, size_t len)
+{
+	unsigned int buflen;
+	int ret;
+
+	mutex_lock(&opts->lock);
+	if (opts->refcnt) {
+		ret = -EBUSY;
+		goto end;
+	}
+	ret = kstrtouint(page, 0, &buflen);
+	if (ret)
+		goto end;
+
+	ret = fsg_common_set_buflen(opts->common, buflen);
+	if (ret)
+		goto end;
+	ret = len;
+
+end:
+	mutex_unlock(&opts->lock);
+	return ret;
+}
+
+static struct fsg_opts_attribute fsg_opts_buflen =
+	__CONFIGFS_ATTR(buflen, S_IRUGO | S_IWUSR, fsg_opts_buflen_show,
+			fsg_opts_buflen_store);
+
 #ifdef CONFIG_USB_GADGET_DEBUG_FILES
 static ssize_t fsg_opts_num_buffers_show(struct fsg_opts *opts, char *page)
 {
@@ -3455,6 +3599,7 @@ static struct fsg_opts_attribute fsg_opts_num_buffers =
 
 static struct configfs_attribute *fsg_attrs[] = {
 	&fsg_opts_stall.attr,
+	&fsg_opts_buflen.attr,
 #ifdef CONFIG_USB_GADGET_DEBUG_FILES
 	&fsg_opts_num_buffers.attr,
 #endif
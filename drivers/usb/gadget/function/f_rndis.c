@@ -88,6 +88,19 @@ static inline struct f_rndis *func_to_rndis(struct usb_function *f)
 	return container_of(f, struct f_rndis, port.func);
 }
 
+/* RNDIS can pack several packet messages into one bulk transfer */
+#define RNDIS_MAX_PKT_PER_XFER		16
+
+static unsigned int rndis_ul_max_pkt_per_xfer = 3;
+module_param(rndis_ul_max_pkt_per_xfer, uint, S_IRUGO);
+MODULE_PARM_DESC(rndis_ul_max_pkt_per_xfer,
+		 "Maximum packets per host-to-device transfer");
+
+static unsigned int rndis_dl_max_pkt_per_xfer = 8;
+module_param(rndis_dl_max_pkt_per_xfer, uint, S_IRUGO);
+MODULE_PARM_DESC(rndis_dl_max_pkt_per_xfer,
+		 "Maximum packets per device-to-host transfer");
+
 /* peak (theoretical) bulk transfer rate in bits-per-second */
 static unsigned int bitrate(struct usb_gadget *g)
 {
@@ -457,6 +470,10 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 	if (status < 0)
 		pr_err("RNDIS command error %d, %d/%d\n",
 			status, req->actual, req->length);
+
+	/* REMOTE_NDIS_INITIALIZE_MSG says how much the host can take */
+	rndis->port.dl_max_xfer_size =
+		rndis_get_dl_max_xfer_size(rndis->params);
 //	spin_unlock(&dev->lock);
 }
 
@@ -578,6 +595,10 @@ static int rndis_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 		/* Avoid ZLPs; they can be troublesome. */
 		rndis->port.is_zlp_ok = false;
 
+		/* no batching past what the host last agreed to */
+		rndis->port.dl_max_xfer_size =
+			rndis_get_dl_max_xfer_size(rndis->params);
+
 		/* RNDIS should be in the "RNDIS uninitialized" state,
 		 * either never activated or after rndis_uninit().
 		 *
@@ -992,6 +1013,10 @@ static struct usb_function *rndis_alloc(struct usb_function_instance *fi)
 	rndis->port.header_len = sizeof(struct rndis_packet_msg_type);
 	rndis->port.wrap = rndis_add_header;
 	rndis->port.unwrap = rndis_rm_hdr;
+	rndis->port.ul_max_pkts_per_xfer = clamp_t(unsigned int,
+			rndis_ul_max_pkt_per_xfer, 1, RNDIS_MAX_PKT_PER_XFER);
+	rndis->port.dl_max_pkts_per_xfer = clamp_t(unsigned int,
+			rndis_dl_max_pkt_per_xfer, 1, RNDIS_MAX_PKT_PER_XFER);
 
 	rndis->port.func.name = "rndis";
 	/* descriptors are per-instance copies */
@@ -1008,6 +1033,7 @@ static struct usb_function *rndis_alloc(struct usb_function_instance *fi)
 		return ERR_CAST(params);
 	}
 	rndis->params = params;
+	rndis_set_max_pkt_xfer(params, rndis->port.ul_max_pkts_per_xfer);
 
 	return &rndis->port.func;
 }
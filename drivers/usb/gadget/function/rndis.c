@@ -571,6 +571,9 @@ static int rndis_init_response(struct rndis_params *params,
 		return -ENOMEM;
 	resp = (rndis_init_cmplt_type *)r->buf;
 
+	/* the most we may pack into one transfer to the host */
+	params->dl_max_xfer_size = le32_to_cpu(buf->MaxTransferSize);
+
 	resp->MessageType = cpu_to_le32(RNDIS_MSG_INIT_C);
 	resp->MessageLength = cpu_to_le32(52);
 	resp->RequestID = buf->RequestID; /* Still LE in msg buffer */
@@ -579,12 +582,12 @@ static int rndis_init_response(struct rndis_params *params,
 	resp->MinorVersion = cpu_to_le32(RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32(RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32(RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32(1);
-	resp->MaxTransferSize = cpu_to_le32(
-		  params->dev->mtu
+	resp->MaxPacketsPerTransfer = cpu_to_le32(params->max_pkt_per_xfer);
+	resp->MaxTransferSize = cpu_to_le32(params->max_pkt_per_xfer *
+		(params->dev->mtu
 		+ sizeof(struct ethhdr)
 		+ sizeof(struct rndis_packet_msg_type)
-		+ 22);
+		+ 22));
 	resp->PacketAlignmentFactor = cpu_to_le32(0);
 	resp->AFListOffset = cpu_to_le32(0);
 	resp->AFListSize = cpu_to_le32(0);
@@ -767,6 +770,7 @@ void rndis_uninit(struct rndis_params *params)
 	if (!params)
 		return;
 	params->state = RNDIS_UNINITIALIZED;
+	params->dl_max_xfer_size = RNDIS_MAX_TOTAL_SIZE;
 
 	/* drain the response queue */
 	while ((buf = rndis_get_next_response(params, &length)))
@@ -912,6 +916,8 @@ struct rndis_params *rndis_register(void (*resp_avail)(void *v), void *v)
 	params->used = 1;
 	params->state = RNDIS_UNINITIALIZED;
 	params->media_state = RNDIS_MEDIA_STATE_DISCONNECTED;
+	params->max_pkt_per_xfer = 1;
+	params->dl_max_xfer_size = RNDIS_MAX_TOTAL_SIZE;
 	params->resp_avail = resp_avail;
 	params->v = v;
 	INIT_LIST_HEAD(&(params->resp_queue));
@@ -989,6 +995,23 @@ int rndis_set_param_medium(struct rndis_params *params, u32 medium, u32 speed)
 }
 EXPORT_SYMBOL_GPL(rndis_set_param_medium);
 
+void rndis_set_max_pkt_xfer(struct rndis_params *params, u8 max_pkt_per_xfer)
+{
+	pr_debug("%s: %u\n", __func__, max_pkt_per_xfer);
+	if (!params)
+		return;
+
+	params->max_pkt_per_xfer = max_pkt_per_xfer;
+}
+EXPORT_SYMBOL_GPL(rndis_set_max_pkt_xfer);
+
+/* until the host has told us otherwise, stick to one packet per transfer */
+u32 rndis_get_dl_max_xfer_size(struct rndis_params *params)
+{
+	return params ? params->dl_max_xfer_size : RNDIS_MAX_TOTAL_SIZE;
+}
+EXPORT_SYMBOL_GPL(rndis_get_dl_max_xfer_size);
+
 void rndis_add_hdr(struct sk_buff *skb)
 {
 	struct rndis_packet_msg_type *header;
@@ -1057,30 +1080,64 @@ static rndis_resp_t *rndis_add_response(struct rndis_params *params, u32 length)
 	return r;
 }
 
+/*
+ * One transfer may hold up to MaxPacketsPerTransfer packet messages back
+ * to back; all but the last are handed up as clones sharing its data.
+ */
 int rndis_rm_hdr(struct gether *port,
 			struct sk_buff *skb,
 			struct sk_buff_head *list)
 {
-	/* tmp points to a struct rndis_packet_msg_type */
-	__le32 *tmp = (void *)skb->data;
+	bool first = true;
 
-	/* MessageType, MessageLength */
-	if (cpu_to_le32(RNDIS_MSG_PACKET)
-			!= get_unaligned(tmp++)) {
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
-	}
-	tmp++;
+	for (;;) {
+		/* tmp points to a struct rndis_packet_msg_type */
+		__le32 *tmp = (void *)skb->data;
+		struct sk_buff *skb2;
+		u32 msg_len, data_offset, data_len;
 
-	/* DataOffset, DataLength */
-	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8)) {
-		dev_kfree_skb_any(skb);
-		return -EOVERFLOW;
-	}
-	skb_trim(skb, get_unaligned_le32(tmp++));
+		/* MessageType, MessageLength; anything else after
+		 * the first packet is padding up to the end
+		 */
+		if (skb->len < sizeof(struct rndis_packet_msg_type)
+				|| cpu_to_le32(RNDIS_MSG_PACKET)
+					!= get_unaligned(tmp++)) {
+			dev_kfree_skb_any(skb);
+			return first ? -EINVAL : 0;
+		}
+		msg_len = get_unaligned_le32(tmp++);
+
+		/* DataOffset, DataLength */
+		data_offset = get_unaligned_le32(tmp++) + 8;
+		data_len = get_unaligned_le32(tmp++);
+
+		if (!msg_len || msg_len >= skb->len) {
+			if (!skb_pull(skb, data_offset)) {
+				dev_kfree_skb_any(skb);
+				return -EOVERFLOW;
+			}
+			skb_trim(skb, data_len);
+			skb_queue_tail(list, skb);
+			return 0;
+		}
 
-	skb_queue_tail(list, skb);
-	return 0;
+		if (data_offset > msg_len || data_len > msg_len - data_offset) {
+			dev_kfree_skb_any(skb);
+			return -EOVERFLOW;
+		}
+
+		skb2 = skb_clone(skb, GFP_ATOMIC);
+		if (!skb2) {
+			dev_kfree_skb_any(skb);
+			return -ENOMEM;
+		}
+		skb_pull(skb2, data_offset);
+		skb_trim(skb2, data_len);
+		skb_queue_tail(list, skb2);
+
+		skb_pull(skb, msg_len);
+		first = false;
+	}
 }
 EXPORT_SYMBOL_GPL(rndis_rm_hdr);
 
@@ -192,16 +192,20 @@ int fsg_lun_open(struct fsg_lun *curlun, const char *filename)
 	loff_t				min_sectors;
 	unsigned int			blkbits;
 	unsigned int			blksize;
+	int				flags = O_LARGEFILE;
+
+	if (curlun->direct)
+		flags |= O_DIRECT;
 
 	/* R/W if we can, R/O if we must */
 	ro = curlun->initially_ro;
 	if (!ro) {
-		filp = filp_open(filename, O_RDWR | O_LARGEFILE, 0);
+		filp = filp_open(filename, O_RDWR | flags, 0);
 		if (PTR_ERR(filp) == -EROFS || PTR_ERR(filp) == -EACCES)
 			ro = 1;
 	}
 	if (ro)
-		filp = filp_open(filename, O_RDONLY | O_LARGEFILE, 0);
+		filp = filp_open(filename, O_RDONLY | flags, 0);
 	if (IS_ERR(filp)) {
 		LINFO(curlun, "unable to open backing file: %s\n", filename);
 		return PTR_ERR(filp);
@@ -215,6 +219,11 @@ int fsg_lun_open(struct fsg_lun *curlun, const char *filename)
 		LINFO(curlun, "invalid file type: %s\n", filename);
 		goto out;
 	}
+	if (curlun->direct && !S_ISBLK(inode->i_mode)) {
+		LINFO(curlun, "direct I/O needs a block device: %s\n",
+		      filename);
+		goto out;
+	}
 
 	/*
 	 * If we can't read the file, it's no good.
@@ -245,6 +254,13 @@ int fsg_lun_open(struct fsg_lun *curlun, const char *filename)
 		blkbits = 9;
 	}
 
+	/* Whole blocks must be aligned for the device to take them directly */
+	if (curlun->direct && blksize % bdev_logical_block_size(inode->i_bdev)) {
+		LINFO(curlun, "block size too small for direct I/O: %s\n",
+		      filename);
+		goto out;
+	}
+
 	num_sectors = size >> blkbits; /* File size in logic-block-size blocks */
 	min_sectors = 1;
 	if (curlun->cdrom) {
@@ -333,6 +349,12 @@ ssize_t fsg_show_nofua(struct fsg_lun *curlun, char *buf)
 }
 EXPORT_SYMBOL_GPL(fsg_show_nofua);
 
+ssize_t fsg_show_direct(struct fsg_lun *curlun, char *buf)
+{
+	return sprintf(buf, "%u\n", curlun->direct);
+}
+EXPORT_SYMBOL_GPL(fsg_show_direct);
+
 ssize_t fsg_show_file(struct fsg_lun *curlun, struct rw_semaphore *filesem,
 		      char *buf)
 {
@@ -431,6 +453,31 @@ ssize_t fsg_store_nofua(struct fsg_lun *curlun, const char *buf, size_t count)
 }
 EXPORT_SYMBOL_GPL(fsg_store_nofua);
 
+ssize_t fsg_store_direct(struct fsg_lun *curlun, struct rw_semaphore *filesem,
+			 const char *buf, size_t count)
+{
+	bool		direct;
+	ssize_t		rc;
+
+	rc = strtobool(buf, &direct);
+	if (rc)
+		return rc;
+
+	/* The file is opened with or without O_DIRECT */
+	down_read(filesem);
+	if (fsg_lun_is_open(curlun)) {
+		LDBG(curlun, "direct change prevented\n");
+		rc = -EBUSY;
+	} else {
+		curlun->direct = direct;
+		rc = count;
+	}
+	up_read(filesem);
+
+	return rc;
+}
+EXPORT_SYMBOL_GPL(fsg_store_direct);
+
 ssize_t fsg_store_file(struct fsg_lun *curlun, struct rw_semaphore *filesem,
 		       const char *buf, size_t count)
 {
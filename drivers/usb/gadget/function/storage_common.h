@@ -101,6 +101,7 @@ struct fsg_lun {
 	unsigned int	registered:1;
 	unsigned int	info_valid:1;
 	unsigned int	nofua:1;
+	unsigned int	direct:1;	/* O_DIRECT I/O to a block device */
 
 	u32		sense_data;
 	u32		sense_data_info;
@@ -121,6 +122,8 @@ static inline bool fsg_lun_is_open(struct fsg_lun *curlun)
 
 /* Default size of buffer length. */
 #define FSG_BUFLEN	((u32)16384)
+/* Maximal buffer length, must be a power of two */
+#define FSG_BUFLEN_MAX	((u32)1048576)
 
 /* Maximal number of LUNs supported in mass storage function */
 #define FSG_MAX_LUNS	16
@@ -133,6 +136,8 @@ enum fsg_buffer_state {
 
 struct fsg_buffhd {
 	void				*buf;
+	/* buf's pages, for O_DIRECT I/O on the backing file */
+	struct bio_vec			*bvec;
 	enum fsg_buffer_state		state;
 	struct fsg_buffhd		*next;
 
@@ -208,6 +213,7 @@ int fsg_lun_fsync_sub(struct fsg_lun *curlun);
 void store_cdrom_address(u8 *dest, int msf, u32 addr);
 ssize_t fsg_show_ro(struct fsg_lun *curlun, char *buf);
 ssize_t fsg_show_nofua(struct fsg_lun *curlun, char *buf);
+ssize_t fsg_show_direct(struct fsg_lun *curlun, char *buf);
 ssize_t fsg_show_file(struct fsg_lun *curlun, struct rw_semaphore *filesem,
 		      char *buf);
 ssize_t fsg_show_cdrom(struct fsg_lun *curlun, char *buf);
@@ -215,6 +221,8 @@ ssize_t fsg_show_removable(struct fsg_lun *curlun, char *buf);
 ssize_t fsg_store_ro(struct fsg_lun *curlun, struct rw_semaphore *filesem,
 		     const char *buf, size_t count);
 ssize_t fsg_store_nofua(struct fsg_lun *curlun, const char *buf, size_t count);
+ssize_t fsg_store_direct(struct fsg_lun *curlun, struct rw_semaphore *filesem,
+			 const char *buf, size_t count);
 ssize_t fsg_store_file(struct fsg_lun *curlun, struct rw_semaphore *filesem,
 		       const char *buf, size_t count);
 ssize_t fsg_store_cdrom(struct fsg_lun *curlun, struct rw_semaphore *filesem,
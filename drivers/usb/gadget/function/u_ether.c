@@ -16,7 +16,9 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/gfp.h>
+#include <linux/slab.h>
 #include <linux/device.h>
+#include <linux/hrtimer.h>
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
@@ -61,6 +63,13 @@ struct eth_dev {
 	struct list_head	tx_reqs, rx_reqs;
 	atomic_t		tx_qlen;
 
+	/* IN transfer being filled, when the framing batches frames */
+	struct usb_request	*tx_agg_req;
+	unsigned		tx_agg_pkts;
+	unsigned		tx_agg_size;	/* 0 unless batching */
+	unsigned		tx_agg_frame;	/* largest wrapped frame */
+	struct hrtimer		tx_agg_timer;
+
 	struct sk_buff_head	rx_frames;
 
 	unsigned		qmult;
@@ -87,6 +96,9 @@ struct eth_dev {
 
 #define DEFAULT_QLEN	2	/* double buffering by default */
 
+/* longest a frame waits in a partial IN aggregate while others are queued */
+#define TX_AGG_TIMEOUT_NS	(300 * NSEC_PER_USEC)
+
 /* for dual-speed hardware, use deeper queues at high/super speed */
 static inline int qlen(struct usb_gadget *gadget, unsigned qmult)
 {
@@ -222,6 +234,8 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+	if (dev->port_usb->ul_max_pkts_per_xfer > 1)
+		size *= dev->port_usb->ul_max_pkts_per_xfer;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -410,6 +424,39 @@ done:
 	return status;
 }
 
+/*
+ * Give each IN request a buffer for dl_max_pkts_per_xfer wrapped frames,
+ * plus the byte zlp avoidance may append.  Without memory for all of
+ * them, frames are just sent one per transfer.
+ */
+static void alloc_tx_agg_buffers(struct eth_dev *dev, struct gether *link)
+{
+	struct usb_request	*req;
+	unsigned		frame, size;
+
+	frame = link->header_len + VLAN_ETH_HLEN + dev->net->mtu;
+	size = link->dl_max_pkts_per_xfer * frame;
+
+	spin_lock(&dev->req_lock);
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		req->buf = kmalloc(size + 1, GFP_ATOMIC);
+		if (!req->buf)
+			goto fail;
+	}
+	dev->tx_agg_frame = frame;
+	dev->tx_agg_size = size;
+	spin_unlock(&dev->req_lock);
+	return;
+
+fail:
+	DBG(dev, "no memory for %u byte tx aggregates\n", size);
+	list_for_each_entry_continue_reverse(req, &dev->tx_reqs, list) {
+		kfree(req->buf);
+		req->buf = NULL;
+	}
+	spin_unlock(&dev->req_lock);
+}
+
 static void rx_fill(struct eth_dev *dev, gfp_t gfp_flags)
 {
 	struct usb_request	*req;
@@ -446,6 +493,83 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void tx_complete(struct usb_ep *ep, struct usb_request *req);
+
+/*
+ * Framings like RNDIS can carry several frames in one transfer.  Then
+ * each IN request owns a buffer the wrapped frames are copied into, and
+ * the transfer is queued once it is full, once the hardware queue runs
+ * dry, or at the latest TX_AGG_TIMEOUT_NS after its first frame.  That
+ * costs a copy per frame but saves most of the per-transfer overhead and
+ * completion interrupts.
+ */
+static void tx_agg_submit(struct eth_dev *dev, struct usb_ep *in,
+			  struct usb_request *req, unsigned pkts)
+{
+	unsigned long	flags;
+	int		retval;
+
+	req->context = NULL;
+	req->complete = tx_complete;
+	req->zero = 1;
+	req->no_interrupt = 0;
+
+	/* same zlp avoidance as for single frames; the framing
+	 * tolerates the padding byte, and the buffer has room for it
+	 */
+	if (!dev->zlp && (req->length % in->maxpacket) == 0)
+		((u8 *)req->buf)[req->length++] = 0;
+
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	if (retval == 0) {
+		dev->net->trans_start = jiffies;
+		atomic_inc(&dev->tx_qlen);
+		return;
+	}
+
+	DBG(dev, "tx queue err %d\n", retval);
+	dev->net->stats.tx_dropped += pkts;
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (list_empty(&dev->tx_reqs))
+		netif_start_queue(dev->net);
+	list_add(&req->list, &dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
+static void tx_agg_flush(struct eth_dev *dev)
+{
+	struct usb_request	*req;
+	struct usb_ep		*in;
+	unsigned long		flags;
+	unsigned		pkts;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	in = dev->port_usb ? dev->port_usb->in_ep : NULL;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = dev->tx_agg_req;
+	pkts = dev->tx_agg_pkts;
+	dev->tx_agg_req = NULL;
+	if (req && !in) {
+		list_add(&req->list, &dev->tx_reqs);
+		req = NULL;
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (req)
+		tx_agg_submit(dev, in, req, pkts);
+}
+
+static enum hrtimer_restart tx_agg_timeout(struct hrtimer *timer)
+{
+	struct eth_dev	*dev = container_of(timer, struct eth_dev,
+					    tx_agg_timer);
+
+	tx_agg_flush(dev);
+	return HRTIMER_NORESTART;
+}
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb = req->context;
@@ -460,16 +584,25 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	case -ESHUTDOWN:		/* disconnect etc */
 		break;
 	case 0:
-		dev->net->stats.tx_bytes += skb->len;
+		if (skb)
+			dev->net->stats.tx_bytes += skb->len;
 	}
-	dev->net->stats.tx_packets++;
+
+	/* aggregated frames were counted as they were copied in */
+	if (skb)
+		dev->net->stats.tx_packets++;
 
 	spin_lock(&dev->req_lock);
 	list_add(&req->list, &dev->tx_reqs);
 	spin_unlock(&dev->req_lock);
-	dev_kfree_skb_any(skb);
+	if (skb)
+		dev_kfree_skb_any(skb);
+
+	/* keep the pipe busy with whatever has been batched so far */
+	if (atomic_dec_and_test(&dev->tx_qlen) && dev->tx_agg_size &&
+	    req->status != -ESHUTDOWN)
+		tx_agg_flush(dev);
 
-	atomic_dec(&dev->tx_qlen);
 	if (netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
@@ -479,6 +612,87 @@ static inline int is_promisc(u16 cdc_filter)
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
 }
 
+static netdev_tx_t eth_xmit_aggregate(struct eth_dev *dev,
+				      struct usb_ep *in, struct sk_buff *skb)
+{
+	struct net_device	*net = dev->net;
+	struct usb_request	*req;
+	unsigned long		flags;
+	unsigned		limit = 0, max_pkts = 0;
+	bool			busy;
+
+	/* we need either a partial aggregate or a request to start one */
+	spin_lock_irqsave(&dev->req_lock, flags);
+	busy = !dev->tx_agg_req && list_empty(&dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+	if (busy)
+		return NETDEV_TX_BUSY;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->port_usb) {
+		skb = dev->wrap(dev->port_usb, skb);
+		limit = dev->port_usb->dl_max_xfer_size;
+		max_pkts = dev->port_usb->dl_max_pkts_per_xfer;
+	} else {
+		dev_kfree_skb_any(skb);
+		skb = NULL;
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+	if (!skb) {
+		net->stats.tx_dropped++;
+		return NETDEV_TX_OK;
+	}
+	if (!limit || limit > dev->tx_agg_size)
+		limit = dev->tx_agg_size;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = dev->tx_agg_req;
+	if (!req && !list_empty(&dev->tx_reqs)) {
+		req = container_of(dev->tx_reqs.next, struct usb_request,
+				   list);
+		list_del(&req->list);
+		req->length = 0;
+		dev->tx_agg_req = req;
+		dev->tx_agg_pkts = 0;
+
+		/* temporarily stop TX queue when the freelist empties */
+		if (list_empty(&dev->tx_reqs))
+			netif_stop_queue(net);
+	}
+
+	/* aggregates are flushed before they get too full for a frame */
+	if (!req || skb->len > dev->tx_agg_size - req->length) {
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		dev_kfree_skb_any(skb);
+		net->stats.tx_dropped++;
+		return NETDEV_TX_OK;
+	}
+
+	memcpy(req->buf + req->length, skb->data, skb->len);
+	req->length += skb->len;
+	dev->tx_agg_pkts++;
+	net->stats.tx_packets++;
+	net->stats.tx_bytes += skb->len;
+	dev_kfree_skb_any(skb);
+
+	if (dev->tx_agg_pkts >= max_pkts ||
+	    req->length + dev->tx_agg_frame > limit ||
+	    !atomic_read(&dev->tx_qlen)) {
+		unsigned	pkts = dev->tx_agg_pkts;
+
+		dev->tx_agg_req = NULL;
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		tx_agg_submit(dev, in, req, pkts);
+		return NETDEV_TX_OK;
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (!hrtimer_active(&dev->tx_agg_timer))
+		hrtimer_start(&dev->tx_agg_timer, ns_to_ktime(TX_AGG_TIMEOUT_NS),
+			      HRTIMER_MODE_REL);
+	return NETDEV_TX_OK;
+}
+
 static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 					struct net_device *net)
 {
@@ -527,6 +741,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	if (skb && dev->tx_agg_size)
+		return eth_xmit_aggregate(dev, in, skb);
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -778,6 +995,8 @@ struct eth_dev *gether_setup_name(struct usb_gadget *g,
 	INIT_WORK(&dev->work, eth_work);
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
+	hrtimer_init(&dev->tx_agg_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->tx_agg_timer.function = tx_agg_timeout;
 
 	skb_queue_head_init(&dev->rx_frames);
 
@@ -840,6 +1059,8 @@ struct net_device *gether_setup_name_default(const char *netname)
 	INIT_WORK(&dev->work, eth_work);
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
+	hrtimer_init(&dev->tx_agg_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->tx_agg_timer.function = tx_agg_timeout;
 
 	skb_queue_head_init(&dev->rx_frames);
 
@@ -1065,6 +1286,9 @@ struct net_device *gether_connect(struct gether *link)
 		result = alloc_requests(dev, link, qlen(dev->gadget,
 					dev->qmult));
 
+	if (result == 0 && link->wrap && link->dl_max_pkts_per_xfer > 1)
+		alloc_tx_agg_buffers(dev, link);
+
 	if (result == 0) {
 		dev->zlp = link->is_zlp_ok;
 		DBG(dev, "qlen %d\n", qlen(dev->gadget, dev->qmult));
@@ -1133,16 +1357,24 @@ void gether_disconnect(struct gether *link)
 	 * and forget about the endpoints.
 	 */
 	usb_ep_disable(link->in_ep);
+	hrtimer_cancel(&dev->tx_agg_timer);
 	spin_lock(&dev->req_lock);
+	if (dev->tx_agg_req) {
+		list_add(&dev->tx_agg_req->list, &dev->tx_reqs);
+		dev->tx_agg_req = NULL;
+	}
 	while (!list_empty(&dev->tx_reqs)) {
 		req = container_of(dev->tx_reqs.next,
 					struct usb_request, list);
 		list_del(&req->list);
 
 		spin_unlock(&dev->req_lock);
+		if (dev->tx_agg_size)
+			kfree(req->buf);
 		usb_ep_free_request(link->in_ep, req);
 		spin_lock(&dev->req_lock);
 	}
+	dev->tx_agg_size = 0;
 	spin_unlock(&dev->req_lock);
 	link->in_ep->driver_data = NULL;
 	link->in_ep->desc = NULL;
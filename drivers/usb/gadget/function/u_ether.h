@@ -74,6 +74,13 @@ struct gether {
 	u32				fixed_out_len;
 	u32				fixed_in_len;
 	bool				supports_multi_frame;
+	/* framings able to carry several frames per transfer (RNDIS)
+	 * let u_ether batch up to this many in one usb_request; the
+	 * host may cap the size of IN transfers with dl_max_xfer_size.
+	 */
+	u32				ul_max_pkts_per_xfer;
+	u32				dl_max_pkts_per_xfer;
+	u32				dl_max_xfer_size;
 	struct sk_buff			*(*wrap)(struct gether *port,
 						struct sk_buff *skb);
 	int				(*unwrap)(struct gether *port,
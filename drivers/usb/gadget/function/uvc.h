@@ -97,13 +97,28 @@ extern unsigned int uvc_gadget_trace_param;
  */
 
 #define UVC_NUM_REQUESTS			4
+#define UVC_MAX_NUM_REQUESTS			32
 #define UVC_MAX_REQUEST_SIZE			64
+#define UVC_HEADER_SIZE				2
 #define UVC_MAX_EVENTS				4
 
 /* ------------------------------------------------------------------------
  * Structures
  */
 
+struct uvc_video;
+
+struct uvc_request
+{
+	struct usb_request *req;
+	__u8 *req_buffer;
+	struct uvc_video *video;
+	/* header bounce buffer followed by the video buffer pages */
+	struct sg_table sgt;
+	/* video buffer to complete once the request is done */
+	struct uvc_buffer *last_buf;
+};
+
 struct uvc_video
 {
 	struct usb_ep *ep;
@@ -118,8 +133,8 @@ struct uvc_video
 
 	/* Requests */
 	unsigned int req_size;
-	struct usb_request *req[UVC_NUM_REQUESTS];
-	__u8 *req_buffer[UVC_NUM_REQUESTS];
+	unsigned int uvc_num_requests;
+	struct uvc_request *ureq;
 	struct list_head req_free;
 	spinlock_t req_lock;
 
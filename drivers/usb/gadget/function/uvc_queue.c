@@ -21,6 +21,7 @@
 #include <linux/wait.h>
 
 #include <media/v4l2-common.h>
+#include <media/videobuf2-dma-sg.h>
 #include <media/videobuf2-vmalloc.h>
 
 #include "uvc.h"
@@ -29,7 +30,9 @@
  * Video buffers queue management.
  *
  * Video queues is initialized by uvcg_queue_init(). The function performs
- * basic initialization of the uvc_video_queue struct and never fails.
+ * basic initialization of the uvc_video_queue struct, and only fails when
+ * the scatter-gather allocator context or the videobuf2 queue can't be set
+ * up.
  *
  * Video buffers are managed by videobuf2. The driver uses a mutex to protect
  * the videobuf2 queue operations by serializing calls to videobuf2 and a
@@ -54,6 +57,7 @@ static int uvc_queue_setup(struct vb2_queue *vq, const struct v4l2_format *fmt,
 	*nplanes = 1;
 
 	sizes[0] = video->imagesize;
+	alloc_ctxs[0] = queue->alloc_ctx;
 
 	return 0;
 }
@@ -74,6 +78,11 @@ static int uvc_buffer_prepare(struct vb2_buffer *vb)
 
 	buf->state = UVC_BUF_STATE_QUEUED;
 	buf->mem = vb2_plane_vaddr(vb, 0);
+	if (queue->use_sg) {
+		buf->sgt = vb2_dma_sg_plane_desc(vb, 0);
+		buf->sg = buf->sgt->sgl;
+		buf->offset = 0;
+	}
 	buf->length = vb2_plane_size(vb, 0);
 	if (vb->v4l2_buf.type == V4L2_BUF_TYPE_VIDEO_CAPTURE)
 		buf->bytesused = 0;
@@ -112,23 +121,40 @@ static struct vb2_ops uvc_queue_qops = {
 	.wait_finish = vb2_ops_wait_finish,
 };
 
-int uvcg_queue_init(struct uvc_video_queue *queue, enum v4l2_buf_type type,
-		    struct mutex *lock)
+/*
+ * When the UDC can do scatter-gather, pass its device as dev: the buffers
+ * are then allocated as page lists that the requests point to directly.
+ * With a NULL dev they are vmalloc'ed and copied into the requests.
+ */
+int uvcg_queue_init(struct uvc_video_queue *queue, struct device *dev,
+		    enum v4l2_buf_type type, struct mutex *lock)
 {
 	int ret;
 
+	queue->use_sg = false;
+	queue->alloc_ctx = NULL;
+	if (dev) {
+		queue->alloc_ctx = vb2_dma_sg_init_ctx(dev);
+		if (IS_ERR(queue->alloc_ctx))
+			return PTR_ERR(queue->alloc_ctx);
+		queue->use_sg = true;
+	}
+
 	queue->queue.type = type;
 	queue->queue.io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
 	queue->queue.drv_priv = queue;
 	queue->queue.buf_struct_size = sizeof(struct uvc_buffer);
 	queue->queue.ops = &uvc_queue_qops;
 	queue->queue.lock = lock;
-	queue->queue.mem_ops = &vb2_vmalloc_memops;
+	queue->queue.mem_ops = queue->use_sg ? &vb2_dma_sg_memops
+					     : &vb2_vmalloc_memops;
 	queue->queue.timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC
 				     | V4L2_BUF_FLAG_TSTAMP_SRC_EOF;
 	ret = vb2_queue_init(&queue->queue);
-	if (ret)
+	if (ret) {
+		uvcg_queue_cleanup(queue);
 		return ret;
+	}
 
 	spin_lock_init(&queue->irqlock);
 	INIT_LIST_HEAD(&queue->irqqueue);
@@ -137,6 +163,14 @@ int uvcg_queue_init(struct uvc_video_queue *queue, enum v4l2_buf_type type,
 	return 0;
 }
 
+void uvcg_queue_cleanup(struct uvc_video_queue *queue)
+{
+	if (queue->use_sg)
+		vb2_dma_sg_cleanup_ctx(queue->alloc_ctx);
+	queue->use_sg = false;
+	queue->alloc_ctx = NULL;
+}
+
 /*
  * Free the video buffers.
  */
@@ -305,6 +339,27 @@ int uvcg_queue_enable(struct uvc_video_queue *queue, int enable)
 	return ret;
 }
 
+/*
+ * Hand a buffer that is off the irq queue back to userspace.
+ *
+ * Called with &queue_irqlock held.
+ */
+void uvcg_complete_buffer(struct uvc_video_queue *queue,
+			  struct uvc_buffer *buf)
+{
+	if (buf->state == UVC_BUF_STATE_ERROR) {
+		vb2_buffer_done(&buf->buf, VB2_BUF_STATE_ERROR);
+		return;
+	}
+
+	buf->buf.v4l2_buf.field = V4L2_FIELD_NONE;
+	buf->buf.v4l2_buf.sequence = queue->sequence++;
+	v4l2_get_timestamp(&buf->buf.v4l2_buf.timestamp);
+
+	vb2_set_plane_payload(&buf->buf, 0, buf->bytesused);
+	vb2_buffer_done(&buf->buf, VB2_BUF_STATE_DONE);
+}
+
 /* called with &queue_irqlock held.. */
 struct uvc_buffer *uvcg_queue_next_buffer(struct uvc_video_queue *queue,
 					  struct uvc_buffer *buf)
@@ -325,12 +380,7 @@ struct uvc_buffer *uvcg_queue_next_buffer(struct uvc_video_queue *queue,
 	else
 		nextbuf = NULL;
 
-	buf->buf.v4l2_buf.field = V4L2_FIELD_NONE;
-	buf->buf.v4l2_buf.sequence = queue->sequence++;
-	v4l2_get_timestamp(&buf->buf.v4l2_buf.timestamp);
-
-	vb2_set_plane_payload(&buf->buf, 0, buf->bytesused);
-	vb2_buffer_done(&buf->buf, VB2_BUF_STATE_DONE);
+	uvcg_complete_buffer(queue, buf);
 
 	return nextbuf;
 }
@@ -5,6 +5,7 @@
 
 #include <linux/kernel.h>
 #include <linux/poll.h>
+#include <linux/scatterlist.h>
 #include <linux/videodev2.h>
 #include <media/videobuf2-core.h>
 
@@ -31,6 +32,10 @@ struct uvc_buffer {
 
 	enum uvc_buffer_state state;
 	void *mem;
+	struct sg_table *sgt;
+	/* scatter-gather position of the next byte to send */
+	struct scatterlist *sg;
+	unsigned int offset;
 	unsigned int length;
 	unsigned int bytesused;
 };
@@ -47,6 +52,10 @@ struct uvc_video_queue {
 
 	unsigned int buf_used;
 
+	/* buffers are scatter-gather lists the UDC can send from directly */
+	bool use_sg;
+	void *alloc_ctx;
+
 	spinlock_t irqlock;	/* Protects flags and irqqueue */
 	struct list_head irqqueue;
 };
@@ -56,8 +65,10 @@ static inline int uvc_queue_streaming(struct uvc_video_queue *queue)
 	return vb2_is_streaming(&queue->queue);
 }
 
-int uvcg_queue_init(struct uvc_video_queue *queue, enum v4l2_buf_type type,
-		    struct mutex *lock);
+int uvcg_queue_init(struct uvc_video_queue *queue, struct device *dev,
+		    enum v4l2_buf_type type, struct mutex *lock);
+
+void uvcg_queue_cleanup(struct uvc_video_queue *queue);
 
 void uvcg_free_buffers(struct uvc_video_queue *queue);
 
@@ -85,6 +96,9 @@ void uvcg_queue_cancel(struct uvc_video_queue *queue, int disconnect);
 
 int uvcg_queue_enable(struct uvc_video_queue *queue, int enable);
 
+void uvcg_complete_buffer(struct uvc_video_queue *queue,
+			  struct uvc_buffer *buf);
+
 struct uvc_buffer *uvcg_queue_next_buffer(struct uvc_video_queue *queue,
 					  struct uvc_buffer *buf);
 
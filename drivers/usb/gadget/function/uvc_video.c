@@ -31,13 +31,13 @@ static int
 uvc_video_encode_header(struct uvc_video *video, struct uvc_buffer *buf,
 		u8 *data, int len)
 {
-	data[0] = 2;
+	data[0] = UVC_HEADER_SIZE;
 	data[1] = UVC_STREAM_EOH | video->fid;
 
-	if (buf->bytesused - video->queue.buf_used <= len - 2)
+	if (buf->bytesused - video->queue.buf_used <= len - UVC_HEADER_SIZE)
 		data[1] |= UVC_STREAM_EOF;
 
-	return 2;
+	return UVC_HEADER_SIZE;
 }
 
 static int
@@ -125,6 +125,61 @@ uvc_video_encode_isoc(struct usb_request *req, struct uvc_video *video,
 	}
 }
 
+/*
+ * Scatter-gather version of uvc_video_encode_isoc(). Only the header is
+ * written to the request's own buffer; the payload entries point to the
+ * pages of the video buffer, which is thus completed from
+ * uvc_video_complete() once the request that sends its last byte is done.
+ */
+static void
+uvc_video_encode_isoc_sg(struct usb_request *req, struct uvc_video *video,
+		struct uvc_buffer *buf)
+{
+	struct uvc_request *ureq = req->context;
+	struct uvc_video_queue *queue = &video->queue;
+	struct scatterlist *sg = ureq->sgt.sgl;
+	unsigned int len, part;
+	int ret;
+
+	sg_init_table(sg, ureq->sgt.orig_nents);
+
+	/* Add the header. */
+	ret = uvc_video_encode_header(video, buf, ureq->req_buffer,
+				      video->req_size);
+	sg_set_buf(sg, ureq->req_buffer, ret);
+	req->length = ret;
+	req->num_sgs = 1;
+
+	/* Point to the video data, one entry per buffer segment. */
+	len = min(video->req_size - ret, buf->bytesused - queue->buf_used);
+	while (len) {
+		part = min(len, buf->sg->length - buf->offset);
+
+		sg = sg_next(sg);
+		sg_set_page(sg, sg_page(buf->sg), part,
+			    buf->sg->offset + buf->offset);
+		req->num_sgs++;
+		req->length += part;
+
+		len -= part;
+		queue->buf_used += part;
+		buf->offset += part;
+		if (buf->offset == buf->sg->length) {
+			buf->sg = sg_next(buf->sg);
+			buf->offset = 0;
+		}
+	}
+	sg_mark_end(sg);
+
+	if (buf->bytesused == video->queue.buf_used) {
+		video->queue.buf_used = 0;
+		buf->state = UVC_BUF_STATE_DONE;
+		list_del(&buf->queue);
+		ureq->last_buf = buf;
+		video->fid ^= UVC_STREAM_FID;
+	}
+}
+
 /* --------------------------------------------------------------------------
  * Request handling
  */
@@ -162,12 +217,22 @@ uvc_video_encode_isoc(struct usb_request *req, struct uvc_video *video,
 static void
 uvc_video_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct uvc_video *video = req->context;
+	struct uvc_request *ureq = req->context;
+	struct uvc_video *video = ureq->video;
 	struct uvc_video_queue *queue = &video->queue;
 	struct uvc_buffer *buf;
 	unsigned long flags;
 	int ret;
 
+	if (ureq->last_buf) {
+		spin_lock_irqsave(&queue->irqlock, flags);
+		if (req->status)
+			ureq->last_buf->state = UVC_BUF_STATE_ERROR;
+		uvcg_complete_buffer(queue, ureq->last_buf);
+		ureq->last_buf = NULL;
+		spin_unlock_irqrestore(&queue->irqlock, flags);
+	}
+
 	switch (req->status) {
 	case 0:
 		break;
@@ -213,18 +278,21 @@ requeue:
 static int
 uvc_video_free_requests(struct uvc_video *video)
 {
+	struct uvc_request *ureq;
 	unsigned int i;
 
-	for (i = 0; i < UVC_NUM_REQUESTS; ++i) {
-		if (video->req[i]) {
-			usb_ep_free_request(video->ep, video->req[i]);
-			video->req[i] = NULL;
-		}
+	if (video->ureq) {
+		for (i = 0; i < video->uvc_num_requests; ++i) {
+			ureq = &video->ureq[i];
 
-		if (video->req_buffer[i]) {
-			kfree(video->req_buffer[i]);
-			video->req_buffer[i] = NULL;
+			if (ureq->req)
+				usb_ep_free_request(video->ep, ureq->req);
+			kfree(ureq->req_buffer);
+			sg_free_table(&ureq->sgt);
 		}
+
+		kfree(video->ureq);
+		video->ureq = NULL;
 	}
 
 	INIT_LIST_HEAD(&video->req_free);
@@ -235,6 +303,8 @@ uvc_video_free_requests(struct uvc_video *video)
 static int
 uvc_video_alloc_requests(struct uvc_video *video)
 {
+	bool use_sg = video->encode == uvc_video_encode_isoc_sg;
+	struct uvc_request *ureq;
 	unsigned int req_size;
 	unsigned int i;
 	int ret = -ENOMEM;
@@ -245,21 +315,47 @@ uvc_video_alloc_requests(struct uvc_video *video)
 		 * max_t(unsigned int, video->ep->maxburst, 1)
 		 * (video->ep->mult + 1);
 
-	for (i = 0; i < UVC_NUM_REQUESTS; ++i) {
-		video->req_buffer[i] = kmalloc(req_size, GFP_KERNEL);
-		if (video->req_buffer[i] == NULL)
+	/*
+	 * Keep a quarter of a frame in flight, so that the endpoint does not
+	 * run dry while the completion handler is held off.
+	 */
+	video->uvc_num_requests = clamp_t(unsigned int,
+			DIV_ROUND_UP(video->imagesize, req_size) / 4,
+			UVC_NUM_REQUESTS, UVC_MAX_NUM_REQUESTS);
+
+	video->ureq = kcalloc(video->uvc_num_requests, sizeof(*video->ureq),
+			      GFP_KERNEL);
+	if (video->ureq == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < video->uvc_num_requests; ++i) {
+		ureq = &video->ureq[i];
+
+		/* With scatter-gather, only the header is bounced. */
+		ureq->req_buffer = kmalloc(use_sg ? UVC_HEADER_SIZE : req_size,
+					   GFP_KERNEL);
+		if (ureq->req_buffer == NULL)
+			goto error;
+
+		/* The header, and the payload spanning up to one extra page */
+		if (use_sg && sg_alloc_table(&ureq->sgt,
+				DIV_ROUND_UP(req_size, PAGE_SIZE) + 2,
+				GFP_KERNEL))
 			goto error;
 
-		video->req[i] = usb_ep_alloc_request(video->ep, GFP_KERNEL);
-		if (video->req[i] == NULL)
+		ureq->req = usb_ep_alloc_request(video->ep, GFP_KERNEL);
+		if (ureq->req == NULL)
 			goto error;
 
-		video->req[i]->buf = video->req_buffer[i];
-		video->req[i]->length = 0;
-		video->req[i]->complete = uvc_video_complete;
-		video->req[i]->context = video;
+		ureq->video = video;
+		ureq->req->buf = ureq->req_buffer;
+		ureq->req->length = 0;
+		ureq->req->complete = uvc_video_complete;
+		ureq->req->context = ureq;
+		if (use_sg)
+			ureq->req->sg = ureq->sgt.sgl;
 
-		list_add_tail(&video->req[i]->list, &video->req_free);
+		list_add_tail(&ureq->req->list, &video->req_free);
 	}
 
 	video->req_size = req_size;
@@ -352,9 +448,9 @@ int uvcg_video_enable(struct uvc_video *video, int enable)
 	}
 
 	if (!enable) {
-		for (i = 0; i < UVC_NUM_REQUESTS; ++i)
-			if (video->req[i])
-				usb_ep_dequeue(video->ep, video->req[i]);
+		for (i = 0; i < video->uvc_num_requests; ++i)
+			if (video->ureq && video->ureq[i].req)
+				usb_ep_dequeue(video->ep, video->ureq[i].req);
 
 		uvc_video_free_requests(video);
 		uvcg_queue_enable(&video->queue, 0);
@@ -364,22 +460,24 @@ int uvcg_video_enable(struct uvc_video *video, int enable)
 	if ((ret = uvcg_queue_enable(&video->queue, 1)) < 0)
 		return ret;
 
-	if ((ret = uvc_video_alloc_requests(video)) < 0)
-		return ret;
-
 	if (video->max_payload_size) {
 		video->encode = uvc_video_encode_bulk;
 		video->payload_size = 0;
-	} else
+	} else if (video->queue.use_sg)
+		video->encode = uvc_video_encode_isoc_sg;
+	else
 		video->encode = uvc_video_encode_isoc;
 
+	if ((ret = uvc_video_alloc_requests(video)) < 0)
+		return ret;
+
 	return uvcg_video_pump(video);
 }
 
 /*
  * Initialize the UVC video stream.
  */
-int uvcg_video_init(struct uvc_video *video)
+int uvcg_video_init(struct uvc_video *video, struct usb_gadget *gadget)
 {
 	INIT_LIST_HEAD(&video->req_free);
 	spin_lock_init(&video->req_lock);
@@ -390,9 +488,12 @@ int uvcg_video_init(struct uvc_video *video)
 	video->height = 240;
 	video->imagesize = 320 * 240 * 2;
 
-	/* Initialize the video buffers queue. */
-	uvcg_queue_init(&video->queue, V4L2_BUF_TYPE_VIDEO_OUTPUT,
-			&video->mutex);
-	return 0;
+	/*
+	 * Initialize the video buffers queue. Isochronous payloads are then
+	 * sent straight from the buffer pages if the UDC can gather them.
+	 */
+	return uvcg_queue_init(&video->queue,
+			       gadget->sg_supported ? gadget->dev.parent : NULL,
+			       V4L2_BUF_TYPE_VIDEO_OUTPUT, &video->mutex);
 }
 
@@ -32,6 +32,7 @@
 #include <linux/init.h>
 #include <linux/hrtimer.h>
 #include <linux/list.h>
+#include <linux/log2.h>
 #include <linux/interrupt.h>
 #include <linux/usb.h>
 #include <linux/usb/hcd.h>
@@ -185,6 +186,17 @@ static int tdi_in_host_mode (struct ehci_hcd *ehci)
 	return (tmp & 3) == USBMODE_CM_HC;
 }
 
+/*
+ * Software must not change USBCMD.ITC while the controller is running
+ * (EHCI spec section 2.3.1), so a new threshold from sysfs is picked up
+ * here, just before the controller is (re)started.
+ */
+static void ehci_update_irq_thresh(struct ehci_hcd *ehci)
+{
+	ehci->command &= ~CMD_ITC;
+	ehci->command |= ehci->irq_thresh << 16;
+}
+
 /*
  * Force HC to halt state from unknown (EHCI spec section 2.3).
  * Must be called with interrupts enabled and the lock not held.
@@ -534,7 +546,8 @@ static int ehci_init(struct usb_hcd *hcd)
 	/* clear interrupt enables, set irq latency */
 	if (log2_irq_thresh < 0 || log2_irq_thresh > 6)
 		log2_irq_thresh = 0;
-	temp = 1 << (16 + log2_irq_thresh);
+	ehci->irq_thresh = 1 << log2_irq_thresh;
+	temp = ehci->irq_thresh << 16;
 	if (HCC_PER_PORT_CHANGE_EVENT(hcc_params)) {
 		ehci->has_ppcd = 1;
 		ehci_dbg(ehci, "enable per-port change event\n");
@@ -1160,6 +1173,7 @@ int ehci_resume(struct usb_hcd *hcd, bool force_reset)
 	if (ehci->shutdown)
 		goto skip;
 
+	ehci_update_irq_thresh(ehci);
 	ehci_writel(ehci, ehci->command, &ehci->regs->command);
 	ehci_writel(ehci, FLAG_CF, &ehci->regs->configured_flag);
 	ehci_readl(ehci, &ehci->regs->command);	/* unblock posted writes */
@@ -1259,6 +1259,7 @@ static void single_unlink_async(struct ehci_hcd *ehci, struct ehci_qh *qh)
 
 	/* Add to the end of the list of QHs waiting for the next IAAD */
 	qh->qh_state = QH_STATE_UNLINK_WAIT;
+	qh->unlink_iaa_cycle = ehci->iaa_cycle;
 	list_add_tail(&qh->unlink_node, &ehci->async_unlink);
 
 	/* Unlink it from the schedule */
@@ -1292,6 +1293,7 @@ static void start_iaa_cycle(struct ehci_hcd *ehci)
 		ehci_writel(ehci, ehci->command | CMD_IAAD,
 				&ehci->regs->command);
 		ehci_readl(ehci, &ehci->regs->command);
+		++ehci->iaa_cycle;
 		ehci_enable_event(ehci, EHCI_HRTIMER_IAA_WATCHDOG, true);
 	}
 }
@@ -1300,8 +1302,9 @@ static void start_iaa_cycle(struct ehci_hcd *ehci)
 
 static void end_unlink_async(struct ehci_hcd *ehci)
 {
-	struct ehci_qh		*qh;
+	struct ehci_qh		*qh, *tmp;
 	bool			early_exit;
+	bool			iaa_ended = ehci->iaa_in_progress;
 
 	if (ehci->has_synopsys_hc_bug)
 		ehci_writel(ehci, (u32) ehci->async->qh_dma,
@@ -1328,8 +1331,29 @@ static void end_unlink_async(struct ehci_hcd *ehci)
 	/*
 	 * Intel (?) bug: The HC can write back the overlay region even
 	 * after the IAA interrupt occurs.  In self-defense, always go
-	 * through two IAA cycles for each QH.
+	 * through two IAA cycles for each QH.  Unless the controller
+	 * needs them one at a time, every QH that has been off the
+	 * schedule for two whole cycles is done, so that QHs unlinked
+	 * together share their IAA cycles.
 	 */
+	else if (!ehci->need_serial_unlinks) {
+		if (iaa_ended) {
+			list_for_each_entry_safe(qh, tmp, &ehci->async_unlink,
+					unlink_node) {
+				unsigned cycles = ehci->iaa_cycle -
+						qh->unlink_iaa_cycle;
+
+				if (cycles >= 2)
+					list_move_tail(&qh->unlink_node,
+							&ehci->async_idle);
+				else if (cycles == 1)
+					qh->qh_state = QH_STATE_UNLINK;
+			}
+		}
+		if (list_empty(&ehci->async_idle))
+			early_exit = true;
+	}
+
 	else if (qh->qh_state == QH_STATE_UNLINK_WAIT) {
 		qh->qh_state = QH_STATE_UNLINK;
 		early_exit = true;
@@ -1374,19 +1398,33 @@ static void start_unlink_async(struct ehci_hcd *ehci, struct ehci_qh *qh);
 
 static void unlink_empty_async(struct ehci_hcd *ehci)
 {
-	struct ehci_qh		*qh;
+	struct ehci_qh		*qh, *next;
 	struct ehci_qh		*qh_to_unlink = NULL;
 	int			count = 0;
+	bool			unlinked = false;
 
-	/* Find the last async QH which has been empty for a timer cycle */
-	for (qh = ehci->async->qh_next.qh; qh; qh = qh->qh_next.qh) {
+	/*
+	 * Find the last async QH which has been empty for a timer cycle,
+	 * or unlink all of them at once if they can share IAA cycles.
+	 */
+	for (qh = ehci->async->qh_next.qh; qh; qh = next) {
+		next = qh->qh_next.qh;
 		if (list_empty(&qh->qtd_list) &&
 				qh->qh_state == QH_STATE_LINKED) {
 			++count;
-			if (qh->unlink_cycle != ehci->async_unlink_cycle)
+			if (qh->unlink_cycle == ehci->async_unlink_cycle)
+				continue;
+			if (ehci->need_serial_unlinks) {
 				qh_to_unlink = qh;
+			} else {
+				single_unlink_async(ehci, qh);
+				unlinked = true;
+				--count;
+			}
 		}
 	}
+	if (unlinked)
+		start_iaa_cycle(ehci);
 
 	/* If nothing else is being unlinked, unlink the last empty QH */
 	if (list_empty(&ehci->async_unlink) && qh_to_unlink) {
@@ -159,6 +159,56 @@ out_unlock:
 static DEVICE_ATTR(uframe_periodic_max, 0644, show_uframe_periodic_max, store_uframe_periodic_max);
 
 
+/*
+ * Display / Set the interrupt threshold, the number of microframes
+ * (1, 2, 4, ... 64) over which the controller coalesces completion
+ * interrupts.  Larger values amortize completion processing, and
+ * schedule scanning, over more transfers at the cost of latency.
+ */
+static ssize_t show_irq_thresh(struct device *dev,
+			       struct device_attribute *attr,
+			       char *buf)
+{
+	struct ehci_hcd		*ehci;
+
+	ehci = hcd_to_ehci(dev_get_drvdata(dev));
+	return scnprintf(buf, PAGE_SIZE, "%u\n", ehci->irq_thresh);
+}
+
+static ssize_t store_irq_thresh(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct ehci_hcd		*ehci;
+	unsigned		irq_thresh;
+	unsigned long		flags;
+
+	ehci = hcd_to_ehci(dev_get_drvdata(dev));
+	if (kstrtouint(buf, 0, &irq_thresh) < 0)
+		return -EINVAL;
+
+	if (!is_power_of_2(irq_thresh) || irq_thresh > 64) {
+		ehci_info(ehci, "rejecting invalid request for "
+				"irq_thresh=%u\n", irq_thresh);
+		return -EINVAL;
+	}
+
+	spin_lock_irqsave(&ehci->lock, flags);
+	ehci->irq_thresh = irq_thresh;
+
+	/* a running controller picks it up when it is next restarted */
+	if (ehci->rh_state != EHCI_RH_RUNNING)
+		ehci_update_irq_thresh(ehci);
+	else
+		ehci_info(ehci, "irq threshold %u uframes from next restart\n",
+				irq_thresh);
+	spin_unlock_irqrestore(&ehci->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR(irq_thresh, 0644, show_irq_thresh, store_irq_thresh);
+
+
 static inline int create_sysfs_files(struct ehci_hcd *ehci)
 {
 	struct device	*controller = ehci_to_hcd(ehci)->self.controller;
@@ -171,6 +221,10 @@ static inline int create_sysfs_files(struct ehci_hcd *ehci)
 		goto out;
 
 	i = device_create_file(controller, &dev_attr_uframe_periodic_max);
+	if (i)
+		goto out;
+
+	i = device_create_file(controller, &dev_attr_irq_thresh);
 out:
 	return i;
 }
@@ -184,4 +238,5 @@ static inline void remove_sysfs_files(struct ehci_hcd *ehci)
 		device_remove_file(controller, &dev_attr_companion);
 
 	device_remove_file(controller, &dev_attr_uframe_periodic_max);
+	device_remove_file(controller, &dev_attr_irq_thresh);
 }
@@ -155,6 +155,7 @@ struct ehci_hcd {			/* one per controller */
 	struct list_head	async_unlink;
 	struct list_head	async_idle;
 	unsigned		async_unlink_cycle;
+	unsigned		iaa_cycle;	/* IAA doorbells rung */
 	unsigned		async_count;	/* async activity count */
 
 	/* periodic schedule support */
@@ -176,6 +177,7 @@ struct ehci_hcd {			/* one per controller */
 	unsigned		isoc_count;	/* isoc activity count */
 	unsigned		periodic_count;	/* periodic activity count */
 	unsigned		uframe_periodic_max; /* max periodic time per uframe */
+	unsigned		irq_thresh;	/* USBCMD.ITC, in uframes */
 
 
 	/* list of itds & sitds completed while now_frame was still active */
@@ -224,6 +226,7 @@ struct ehci_hcd {			/* one per controller */
 	unsigned		amd_pll_fix:1;
 	unsigned		use_dummy_qh:1;	/* AMD Frame List table quirk*/
 	unsigned		has_synopsys_hc_bug:1; /* Synopsys HC */
+	unsigned		need_serial_unlinks:1; /* one QH per IAA */
 	unsigned		frame_index_bug:1; /* MosChip (AKA NetMos) */
 	unsigned		need_oc_pp_cycle:1; /* MPC834X port power */
 	unsigned		imx28_write_fix:1; /* For Freescale i.MX28 */
@@ -421,6 +424,7 @@ struct ehci_qh {
 	struct ehci_per_sched	ps;		/* scheduling info */
 
 	unsigned		unlink_cycle;
+	unsigned		unlink_iaa_cycle; /* ehci->iaa_cycle at unlink */
 
 	u8			qh_state;
 #define	QH_STATE_LINKED		1		/* HC sees this */
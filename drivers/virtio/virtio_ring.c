@@ -25,6 +25,12 @@
 #include <linux/hrtimer.h>
 #include <linux/kmemleak.h>
 
+/*
+ * Number of descriptors in the indirect table preallocated for each head,
+ * longer chains get a table from kmalloc() as before.
+ */
+#define VRING_INDIRECT_CACHE_DESCS	8
+
 #ifdef DEBUG
 /* For development, we want to crash whenever the ring is screwed. */
 #define BAD_RING(_vq, fmt, args...)				\
@@ -69,6 +75,9 @@ struct vring_virtqueue {
 	/* Host supports indirect buffers */
 	bool indirect;
 
+	/* Preallocated indirect tables, VRING_INDIRECT_CACHE_DESCS per head */
+	struct vring_desc *indirect_cache;
+
 	/* Host publishes avail event idx */
 	bool event;
 
@@ -98,12 +107,26 @@ struct vring_virtqueue {
 
 #define to_vvq(_vq) container_of(_vq, struct vring_virtqueue, vq)
 
+static bool is_cached_indirect(const struct vring_virtqueue *vq,
+			       const struct vring_desc *desc)
+{
+	return vq->indirect_cache && desc >= vq->indirect_cache &&
+	       desc < vq->indirect_cache +
+		      vq->vring.num * VRING_INDIRECT_CACHE_DESCS;
+}
+
 static struct vring_desc *alloc_indirect(struct virtqueue *_vq,
+					 unsigned int head,
 					 unsigned int total_sg, gfp_t gfp)
 {
+	struct vring_virtqueue *vq = to_vvq(_vq);
 	struct vring_desc *desc;
 	unsigned int i;
 
+	/* The next links of the cached tables were set up front. */
+	if (vq->indirect_cache && total_sg <= VRING_INDIRECT_CACHE_DESCS)
+		return vq->indirect_cache + head * VRING_INDIRECT_CACHE_DESCS;
+
 	/*
 	 * We require lowmem mappings for the descriptors because
 	 * otherwise virt_to_phys will give us bogus addresses in the
@@ -165,7 +188,7 @@ static inline int virtqueue_add(struct virtqueue *_vq,
 	/* If the host supports indirect descriptor tables, and we have multiple
 	 * buffers, then go indirect. FIXME: tune this threshold */
 	if (vq->indirect && total_sg > 1 && vq->vq.num_free)
-		desc = alloc_indirect(_vq, total_sg, gfp);
+		desc = alloc_indirect(_vq, head, total_sg, gfp);
 	else
 		desc = NULL;
 
@@ -174,7 +197,8 @@ static inline int virtqueue_add(struct virtqueue *_vq,
 		vq->vring.desc[head].flags = cpu_to_virtio16(_vq->vdev, VRING_DESC_F_INDIRECT);
 		vq->vring.desc[head].addr = cpu_to_virtio64(_vq->vdev, virt_to_phys(desc));
 		/* avoid kmemleak false positive (hidden by virt_to_phys) */
-		kmemleak_ignore(desc);
+		if (!is_cached_indirect(vq, desc))
+			kmemleak_ignore(desc);
 		vq->vring.desc[head].len = cpu_to_virtio32(_vq->vdev, total_sg * sizeof(struct vring_desc));
 
 		/* Set up rest to use this indirect table. */
@@ -431,9 +455,13 @@ static void detach_buf(struct vring_virtqueue *vq, unsigned int head)
 	/* Put back on free list: find end */
 	i = head;
 
-	/* Free the indirect table */
-	if (vq->vring.desc[i].flags & cpu_to_virtio16(vq->vq.vdev, VRING_DESC_F_INDIRECT))
-		kfree(phys_to_virt(virtio64_to_cpu(vq->vq.vdev, vq->vring.desc[i].addr)));
+	/* Free the indirect table, unless it is one of ours */
+	if (vq->vring.desc[i].flags & cpu_to_virtio16(vq->vq.vdev, VRING_DESC_F_INDIRECT)) {
+		struct vring_desc *indir = phys_to_virt(virtio64_to_cpu(vq->vq.vdev, vq->vring.desc[i].addr));
+
+		if (!is_cached_indirect(vq, indir))
+			kfree(indir);
+	}
 
 	while (vq->vring.desc[i].flags & cpu_to_virtio16(vq->vq.vdev, VRING_DESC_F_NEXT)) {
 		i = virtio16_to_cpu(vq->vq.vdev, vq->vring.desc[i].next);
@@ -745,6 +773,22 @@ struct virtqueue *vring_new_virtqueue(unsigned int index,
 	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC);
 	vq->event = virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
 
+	/*
+	 * Keep a small indirect table per head, so that the common short
+	 * chains do not need an allocation per request. If that much lowmem
+	 * is not to be had, every table comes from kmalloc() instead.
+	 */
+	vq->indirect_cache = NULL;
+	if (vq->indirect) {
+		vq->indirect_cache = kmalloc_array(num * VRING_INDIRECT_CACHE_DESCS,
+						   sizeof(struct vring_desc),
+						   GFP_KERNEL | __GFP_NOWARN);
+		for (i = 0; vq->indirect_cache &&
+			    i < num * VRING_INDIRECT_CACHE_DESCS; i++)
+			vq->indirect_cache[i].next = cpu_to_virtio16(vdev,
+				(i + 1) % VRING_INDIRECT_CACHE_DESCS);
+	}
+
 	/* No callback?  Tell other side not to bother us. */
 	if (!callback)
 		vq->vring.avail->flags |= cpu_to_virtio16(vdev, VRING_AVAIL_F_NO_INTERRUPT);
@@ -764,6 +808,7 @@ EXPORT_SYMBOL_GPL(vring_new_virtqueue);
 void vring_del_virtqueue(struct virtqueue *vq)
 {
 	list_del(&vq->list);
+	kfree(to_vvq(vq)->indirect_cache);
 	kfree(to_vvq(vq));
 }
 EXPORT_SYMBOL_GPL(vring_del_virtqueue);
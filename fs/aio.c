@@ -40,6 +40,8 @@
 #include <linux/ramfs.h>
 #include <linux/percpu-refcount.h>
 #include <linux/mount.h>
+#include <linux/pagemap.h>
+#include <linux/cred.h>
 
 #include <asm/kmap_types.h>
 #include <asm/uaccess.h>
@@ -186,6 +188,16 @@ struct aio_kiocb {
 	 * this is the underlying eventfd context to deliver events to.
 	 */
 	struct eventfd_ctx	*ki_eventfd;
+
+	/*
+	 * Buffered reads missing the page cache and fsync are run from
+	 * aio_wq, so that io_submit() doesn't block on them.
+	 */
+	struct work_struct	ki_work;
+	struct iov_iter		ki_iter;
+	struct mm_struct	*ki_mm;
+	const struct cred	*ki_creds;
+	bool			ki_datasync;
 };
 
 /*------ sysctl variables----*/
@@ -197,6 +209,8 @@ unsigned long aio_max_nr = 0x10000; /* system wide maximum number of aio request
 static struct kmem_cache	*kiocb_cachep;
 static struct kmem_cache	*kioctx_cachep;
 
+static struct workqueue_struct	*aio_wq;
+
 static struct vfsmount *aio_mnt;
 
 static const struct file_operations aio_ring_fops;
@@ -260,6 +274,10 @@ static int __init aio_setup(void)
 	kiocb_cachep = KMEM_CACHE(aio_kiocb, SLAB_HWCACHE_ALIGN|SLAB_PANIC);
 	kioctx_cachep = KMEM_CACHE(kioctx,SLAB_HWCACHE_ALIGN|SLAB_PANIC);
 
+	aio_wq = alloc_workqueue("aio", WQ_UNBOUND, 0);
+	if (!aio_wq)
+		panic("Failed to create aio workqueue.");
+
 	pr_debug("sizeof(struct page) = %zu\n", sizeof(struct page));
 
 	return 0;
@@ -1396,6 +1414,131 @@ static int aio_setup_vectored_rw(int rw, char __user *buf, size_t len,
 				len, UIO_FASTIOV, iovec, iter);
 }
 
+static void aio_complete_ret(struct kiocb *req, long ret)
+{
+	if (ret == -EIOCBQUEUED)
+		return;
+
+	/*
+	 * There's no easy way to restart the syscall since other AIO's
+	 * may be already running. Just fail this IO with EINTR.
+	 */
+	if (unlikely(ret == -ERESTARTSYS || ret == -ERESTARTNOINTR ||
+		     ret == -ERESTARTNOHAND || ret == -ERESTART_RESTARTBLOCK))
+		ret = -EINTR;
+	aio_complete(req, ret, 0);
+}
+
+/*
+ * A buffered read blocks unless all of it is uptodate in the page cache.
+ * Only regular files are checked, others keep being read from
+ * io_submit().
+ */
+static bool aio_read_would_block(struct kiocb *req, size_t len)
+{
+	struct file *file = req->ki_filp;
+	struct address_space *mapping = file->f_mapping;
+	pgoff_t index, end;
+	struct page *page;
+	bool cached = true;
+
+	if ((req->ki_flags & IOCB_DIRECT) || !len ||
+	    !S_ISREG(file_inode(file)->i_mode))
+		return false;
+
+	index = req->ki_pos >> PAGE_CACHE_SHIFT;
+	end = (req->ki_pos + len - 1) >> PAGE_CACHE_SHIFT;
+	for (; cached && index <= end; index++) {
+		page = find_get_page(mapping, index);
+		cached = page && PageUptodate(page);
+		if (page)
+			page_cache_release(page);
+	}
+	return !cached;
+}
+
+static void aio_read_work(struct work_struct *work)
+{
+	struct aio_kiocb *iocb = container_of(work, struct aio_kiocb, ki_work);
+	struct kiocb *req = &iocb->common;
+	struct mm_struct *mm = iocb->ki_mm;
+	const struct cred *old_cred;
+	ssize_t ret = -EFAULT;
+	bool mm_live;
+
+	/* the user buffer belongs to the submitter's address space */
+	mm_live = atomic_inc_not_zero(&mm->mm_users);
+	if (mm_live) {
+		use_mm(mm);
+		old_cred = override_creds(iocb->ki_creds);
+		ret = req->ki_filp->f_op->read_iter(req, &iocb->ki_iter);
+		revert_creds(old_cred);
+		unuse_mm(mm);
+	}
+
+	kfree(iocb->ki_iter.iov);
+	put_cred(iocb->ki_creds);
+	aio_complete_ret(req, ret);
+
+	/* after completion, as exit_aio() waits for the request */
+	if (mm_live)
+		mmput(mm);
+	mmdrop(mm);
+}
+
+/*
+ * Take a copy of the iovecs, which may live on the caller's stack, and
+ * run the read from aio_wq.
+ */
+static ssize_t aio_defer_read(struct kiocb *req, struct iov_iter *iter)
+{
+	struct aio_kiocb *iocb = container_of(req, struct aio_kiocb, common);
+	struct iovec *iov;
+
+	iov = kmemdup(iter->iov, iter->nr_segs * sizeof(*iov), GFP_KERNEL);
+	if (!iov)
+		return -ENOMEM;
+
+	iocb->ki_iter = *iter;
+	iocb->ki_iter.iov = iov;
+	iocb->ki_mm = current->mm;
+	atomic_inc(&iocb->ki_mm->mm_count);
+	iocb->ki_creds = get_current_cred();
+
+	INIT_WORK(&iocb->ki_work, aio_read_work);
+	queue_work(aio_wq, &iocb->ki_work);
+	return -EIOCBQUEUED;
+}
+
+static void aio_fsync_work(struct work_struct *work)
+{
+	struct aio_kiocb *iocb = container_of(work, struct aio_kiocb, ki_work);
+	const struct cred *old_cred;
+	int ret;
+
+	old_cred = override_creds(iocb->ki_creds);
+	ret = vfs_fsync(iocb->common.ki_filp, iocb->ki_datasync);
+	revert_creds(old_cred);
+
+	put_cred(iocb->ki_creds);
+	aio_complete(&iocb->common, ret, 0);
+}
+
+static ssize_t aio_fsync(struct kiocb *req, bool datasync)
+{
+	struct aio_kiocb *iocb = container_of(req, struct aio_kiocb, common);
+	struct file *file = req->ki_filp;
+
+	if (file->f_op->aio_fsync)
+		return file->f_op->aio_fsync(req, datasync);
+
+	iocb->ki_datasync = datasync;
+	iocb->ki_creds = get_current_cred();
+	INIT_WORK(&iocb->ki_work, aio_fsync_work);
+	queue_work(aio_wq, &iocb->ki_work);
+	return -EIOCBQUEUED;
+}
+
 /*
  * aio_run_iocb:
  *	Performs the initial checks and io submission.
@@ -1449,6 +1592,12 @@ rw_common:
 
 		len = ret;
 
+		if (rw == READ && aio_read_would_block(req, len)) {
+			ret = aio_defer_read(req, &iter);
+			kfree(iovec);
+			break;
+		}
+
 		if (rw == WRITE)
 			file_start_write(file);
 
@@ -1460,17 +1609,11 @@ rw_common:
 		break;
 
 	case IOCB_CMD_FDSYNC:
-		if (!file->f_op->aio_fsync)
-			return -EINVAL;
-
-		ret = file->f_op->aio_fsync(req, 1);
-		break;
-
 	case IOCB_CMD_FSYNC:
-		if (!file->f_op->aio_fsync)
+		if (!file->f_op->aio_fsync && !file->f_op->fsync)
 			return -EINVAL;
 
-		ret = file->f_op->aio_fsync(req, 0);
+		ret = aio_fsync(req, opcode == IOCB_CMD_FDSYNC);
 		break;
 
 	default:
@@ -1478,18 +1621,7 @@ rw_common:
 		return -EINVAL;
 	}
 
-	if (ret != -EIOCBQUEUED) {
-		/*
-		 * There's no easy way to restart the syscall since other AIO's
-		 * may be already running. Just fail this IO with EINTR.
-		 */
-		if (unlikely(ret == -ERESTARTSYS || ret == -ERESTARTNOINTR ||
-			     ret == -ERESTARTNOHAND ||
-			     ret == -ERESTART_RESTARTBLOCK))
-			ret = -EINTR;
-		aio_complete(req, ret, 0);
-	}
-
+	aio_complete_ret(req, ret);
 	return 0;
 }
 
@@ -39,6 +39,7 @@
 #include <linux/ratelimit.h>
 #include <linux/list_lru.h>
 #include <linux/kasan.h>
+#include <linux/sysctl.h>
 
 #include "internal.h"
 #include "mount.h"
@@ -118,6 +119,13 @@ struct dentry_stat_t dentry_stat = {
 
 static DEFINE_PER_CPU(long, nr_dentry);
 static DEFINE_PER_CPU(long, nr_dentry_unused);
+static DEFINE_PER_CPU(long, nr_dentry_negative);
+
+/*
+ * Unused negative dentries a superblock may keep on its LRU before the
+ * excess is trimmed in the background, 0 for no limit.
+ */
+static unsigned long dentry_negative_limit __read_mostly;
 
 #if defined(CONFIG_SYSCTL) && defined(CONFIG_PROC_FS)
 
@@ -151,15 +159,61 @@ static long get_nr_dentry_unused(void)
 	return sum < 0 ? 0 : sum;
 }
 
+static long get_nr_dentry_negative(void)
+{
+	int i;
+	long sum = 0;
+	for_each_possible_cpu(i)
+		sum += per_cpu(nr_dentry_negative, i);
+	return sum < 0 ? 0 : sum;
+}
+
 int proc_nr_dentry(struct ctl_table *table, int write, void __user *buffer,
 		   size_t *lenp, loff_t *ppos)
 {
 	dentry_stat.nr_dentry = get_nr_dentry();
 	dentry_stat.nr_unused = get_nr_dentry_unused();
+	dentry_stat.nr_negative = get_nr_dentry_negative();
 	return proc_doulongvec_minmax(table, write, buffer, lenp, ppos);
 }
+
+static struct ctl_table dcache_sysctls[] = {
+	{
+		.procname	= "negative-dentry-limit",
+		.data		= &dentry_negative_limit,
+		.maxlen		= sizeof(dentry_negative_limit),
+		.mode		= 0644,
+		.proc_handler	= proc_doulongvec_minmax,
+	},
+	{ }
+};
+
+static int __init init_dcache_sysctls(void)
+{
+	register_sysctl("fs", dcache_sysctls);
+	return 0;
+}
+fs_initcall(init_dcache_sysctls);
 #endif
 
+/*
+ * The negative counts cover the negative dentries that have DCACHE_LRU_LIST
+ * set, and are adjusted whenever either of the two changes.  The superblock
+ * one is a percpu_counter, so that it can be checked against the limit in
+ * constant time; d_lock must be held.
+ */
+static void d_negative_add(struct dentry *dentry, int nr)
+{
+	struct super_block *sb = dentry->d_sb;
+	unsigned long limit = READ_ONCE(dentry_negative_limit);
+
+	this_cpu_add(nr_dentry_negative, nr);
+	percpu_counter_add(&sb->s_nr_dentry_negative, nr);
+	if (nr > 0 && limit &&
+	    percpu_counter_read(&sb->s_nr_dentry_negative) > limit)
+		schedule_work(&sb->s_prune_negative_work);
+}
+
 /*
  * Compare 2 name strings, return 0 if they match, otherwise non-zero.
  * The strings are both count bytes long, and count is non-zero.
@@ -302,6 +356,8 @@ static inline void __d_clear_type_and_inode(struct dentry *dentry)
 	WRITE_ONCE(dentry->d_flags, flags);
 	smp_wmb();
 	dentry->d_inode = NULL;
+	if (flags & DCACHE_LRU_LIST)
+		d_negative_add(dentry, 1);
 }
 
 static void dentry_free(struct dentry *dentry)
@@ -392,7 +448,8 @@ static void dentry_unlink_inode(struct dentry * dentry)
  * on the shrink list (ie not on the superblock LRU list).
  *
  * The per-cpu "nr_dentry_unused" counters are updated with
- * the DCACHE_LRU_LIST bit.
+ * the DCACHE_LRU_LIST bit, and so are the negative dentry
+ * counts for the dentries that have no inode.
  *
  * These helper functions make sure we always follow the
  * rules. d_lock must be held by the caller.
@@ -403,6 +460,8 @@ static void d_lru_add(struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, 0);
 	dentry->d_flags |= DCACHE_LRU_LIST;
 	this_cpu_inc(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		d_negative_add(dentry, 1);
 	WARN_ON_ONCE(!list_lru_add(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -411,6 +470,8 @@ static void d_lru_del(struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		d_negative_add(dentry, -1);
 	WARN_ON_ONCE(!list_lru_del(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -420,6 +481,8 @@ static void d_shrink_del(struct dentry *dentry)
 	list_del_init(&dentry->d_lru);
 	dentry->d_flags &= ~(DCACHE_SHRINK_LIST | DCACHE_LRU_LIST);
 	this_cpu_dec(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		d_negative_add(dentry, -1);
 }
 
 static void d_shrink_add(struct dentry *dentry, struct list_head *list)
@@ -428,6 +491,8 @@ static void d_shrink_add(struct dentry *dentry, struct list_head *list)
 	list_add(&dentry->d_lru, list);
 	dentry->d_flags |= DCACHE_SHRINK_LIST | DCACHE_LRU_LIST;
 	this_cpu_inc(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		d_negative_add(dentry, 1);
 }
 
 /*
@@ -441,6 +506,8 @@ static void d_lru_isolate(struct list_lru_one *lru, struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		d_negative_add(dentry, -1);
 	list_lru_isolate(lru, &dentry->d_lru);
 }
 
@@ -1100,6 +1167,79 @@ long prune_dcache_sb(struct super_block *sb, struct shrink_control *sc)
 	return freed;
 }
 
+static enum lru_status dentry_negative_lru_isolate(struct list_head *item,
+		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
+{
+	struct list_head *freeable = arg;
+	struct dentry	*dentry = container_of(item, struct dentry, d_lru);
+
+	if (!spin_trylock(&dentry->d_lock))
+		return LRU_SKIP;
+
+	if (dentry->d_lockref.count) {
+		d_lru_isolate(lru, dentry);
+		spin_unlock(&dentry->d_lock);
+		return LRU_REMOVED;
+	}
+
+	/*
+	 * Positive dentries are rotated out of the way so that the next
+	 * batch starts on entries that have not been looked at yet, and
+	 * referenced negative ones get another pass like in the shrinker.
+	 */
+	if (!d_is_negative(dentry) || (dentry->d_flags & DCACHE_REFERENCED)) {
+		if (d_is_negative(dentry))
+			dentry->d_flags &= ~DCACHE_REFERENCED;
+		spin_unlock(&dentry->d_lock);
+		return LRU_ROTATE;
+	}
+
+	d_lru_shrink_move(lru, dentry, freeable);
+	spin_unlock(&dentry->d_lock);
+
+	return LRU_REMOVED;
+}
+
+#define NEGATIVE_DENTRY_BATCH	1024
+
+/**
+ * prune_negative_dentries - trim the negative dentries of a superblock
+ * @work: the s_prune_negative_work of the superblock
+ *
+ * Queued once the unused negative dentries of the superblock exceed
+ * dentry_negative_limit, this frees the oldest of them until 7/8 of the
+ * limit is left, looking at each dentry on the LRU at most once.
+ */
+void prune_negative_dentries(struct work_struct *work)
+{
+	struct super_block *sb = container_of(work, struct super_block,
+					      s_prune_negative_work);
+	unsigned long limit = READ_ONCE(dentry_negative_limit);
+	unsigned long target = limit - limit / 8;
+	unsigned long nr_to_walk;
+
+	if (!limit || !trylock_super(sb))
+		return;
+	if (!sb->s_root)
+		goto out;
+
+	nr_to_walk = list_lru_count(&sb->s_dentry_lru);
+	while (nr_to_walk && percpu_counter_read_positive(
+					&sb->s_nr_dentry_negative) > target) {
+		unsigned long nr = min_t(unsigned long, nr_to_walk,
+					 NEGATIVE_DENTRY_BATCH);
+		LIST_HEAD(dispose);
+
+		list_lru_walk(&sb->s_dentry_lru, dentry_negative_lru_isolate,
+			      &dispose, nr);
+		shrink_dentry_list(&dispose);
+		nr_to_walk -= nr;
+		cond_resched();
+	}
+out:
+	up_read(&sb->s_umount);
+}
+
 static enum lru_status dentry_lru_isolate_shrink(struct list_head *item,
 		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
 {
@@ -1755,8 +1895,11 @@ static void __d_instantiate(struct dentry *dentry, struct inode *inode)
 	unsigned add_flags = d_flags_for_inode(inode);
 
 	spin_lock(&dentry->d_lock);
-	if (inode)
+	if (inode) {
 		hlist_add_head(&dentry->d_u.d_alias, &inode->i_dentry);
+		if (dentry->d_flags & DCACHE_LRU_LIST)
+			d_negative_add(dentry, -1);
+	}
 	__d_set_inode_and_type(dentry, inode, add_flags);
 	dentry_rcuwalk_invalidate(dentry);
 	spin_unlock(&dentry->d_lock);
@@ -42,6 +42,7 @@
 #include <linux/seq_file.h>
 #include <linux/compat.h>
 #include <linux/rculist.h>
+#include <net/busy_poll.h>
 
 /*
  * LOCKING:
@@ -92,7 +93,8 @@
  */
 
 /* Epoll private bits inside the event mask */
-#define EP_PRIVATE_BITS (EPOLLWAKEUP | EPOLLONESHOT | EPOLLET)
+#define EP_PRIVATE_BITS (EPOLLWAKEUP | EPOLLONESHOT | EPOLLET | \
+			 EPOLLROUNDROBIN)
 
 /* Maximum number of nesting allowed inside epoll sets */
 #define EP_MAX_NESTS 4
@@ -208,6 +210,13 @@ struct eventpoll {
 	 */
 	struct epitem *ovflist;
 
+	/*
+	 * EPOLLROUNDROBIN items delivered by ep_send_events_proc(), put back
+	 * on the ready list without waking up another waiter.  Only used
+	 * while ep_scan_ready_list() holds "mtx".
+	 */
+	struct list_head excllist;
+
 	/* wakeup_source used when ep_scan_ready_list is running */
 	struct wakeup_source *ws;
 
@@ -219,6 +228,11 @@ struct eventpoll {
 	/* used to optimize loop detection check */
 	int visited;
 	struct list_head visited_list_link;
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	/* used to track busy poll napi_id */
+	unsigned int napi_id;
+#endif
 };
 
 /* Wait structure used by the poll hooks */
@@ -576,6 +590,79 @@ static inline void ep_pm_stay_awake_rcu(struct epitem *epi)
 	rcu_read_unlock();
 }
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+static bool ep_busy_loop_end(void *p, unsigned long end_time)
+{
+	struct eventpoll *ep = p;
+
+	return ep_events_available(ep) || busy_loop_timeout(end_time) ||
+	       signal_pending(current);
+}
+
+/*
+ * Busy poll the NAPI context of the sockets that were last found ready,
+ * for up to sysctl_net_busy_poll microseconds or until an event shows up.
+ */
+static void ep_busy_loop(struct eventpoll *ep, int nonblock)
+{
+	unsigned int napi_id = READ_ONCE(ep->napi_id);
+
+	if (napi_id && net_busy_loop_on())
+		napi_busy_loop(napi_id, nonblock ? NULL : ep_busy_loop_end, ep);
+}
+
+static inline void ep_reset_busy_poll_napi_id(struct eventpoll *ep)
+{
+	if (ep->napi_id)
+		ep->napi_id = 0;
+}
+
+/*
+ * Remember the NAPI context of the socket behind @epi, if any, so that
+ * ep_poll() can spin on it.
+ */
+static inline void ep_set_busy_poll_napi_id(struct epitem *epi)
+{
+	struct eventpoll *ep;
+	unsigned int napi_id;
+	struct socket *sock;
+	struct sock *sk;
+	int err;
+
+	if (!net_busy_loop_on())
+		return;
+
+	sock = sock_from_file(epi->ffd.file, &err);
+	if (!sock)
+		return;
+
+	sk = sock->sk;
+	if (!sk)
+		return;
+
+	napi_id = READ_ONCE(sk->sk_napi_id);
+	ep = epi->ep;
+
+	/* Skip invalid ids and don't dirty the cacheline for no change */
+	if (!napi_id || napi_id == ep->napi_id)
+		return;
+
+	ep->napi_id = napi_id;
+}
+#else
+static inline void ep_busy_loop(struct eventpoll *ep, int nonblock)
+{
+}
+
+static inline void ep_reset_busy_poll_napi_id(struct eventpoll *ep)
+{
+}
+
+static inline void ep_set_busy_poll_napi_id(struct epitem *epi)
+{
+}
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+
 /**
  * ep_scan_ready_list - Scans the ready list in a way that makes possible for
  *                      the scan code, to call f_op->poll(). Also allows for
@@ -642,6 +729,12 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 		if (!ep_is_linked(&epi->rdllink)) {
 			list_add_tail(&epi->rdllink, &ep->rdllist);
 			ep_pm_stay_awake(epi);
+		} else if (epi->event.events & EPOLLROUNDROBIN) {
+			/*
+			 * A new event on an item kept aside on excllist
+			 * must still wake up the next waiter.
+			 */
+			list_move_tail(&epi->rdllink, &ep->rdllist);
 		}
 	}
 	/*
@@ -667,6 +760,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 		if (waitqueue_active(&ep->poll_wait))
 			pwake++;
 	}
+	list_splice_tail_init(&ep->excllist, &ep->rdllist);
 	spin_unlock_irqrestore(&ep->lock, flags);
 
 	if (!ep_locked)
@@ -949,6 +1043,7 @@ static int ep_alloc(struct eventpoll **pep)
 	init_waitqueue_head(&ep->wq);
 	init_waitqueue_head(&ep->poll_wait);
 	INIT_LIST_HEAD(&ep->rdllist);
+	INIT_LIST_HEAD(&ep->excllist);
 	ep->rbr = RB_ROOT;
 	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = user;
@@ -1350,6 +1445,8 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 
 	atomic_long_inc(&ep->user->epoll_watches);
 
+	ep_set_busy_poll_napi_id(epi);
+
 	/* We have to call this outside the lock */
 	if (pwake)
 		ep_poll_safewake(&ep->poll_wait);
@@ -1520,6 +1617,7 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 			}
 			eventcnt++;
 			uevent++;
+			ep_set_busy_poll_napi_id(epi);
 			if (epi->event.events & EPOLLONESHOT)
 				epi->event.events &= EP_PRIVATE_BITS;
 			else if (!(epi->event.events & EPOLLET)) {
@@ -1533,8 +1631,15 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 				 * callers are locked out by
 				 * ep_scan_ready_list() holding "mtx" and the
 				 * poll callback will queue them in ep->ovflist.
+				 * Exclusive items are kept aside so that they
+				 * don't wake up the other waiters.
 				 */
-				list_add_tail(&epi->rdllink, &ep->rdllist);
+				if (epi->event.events & EPOLLROUNDROBIN)
+					list_add_tail(&epi->rdllink,
+						      &ep->excllist);
+				else
+					list_add_tail(&epi->rdllink,
+						      &ep->rdllist);
 				ep_pm_stay_awake(epi);
 			}
 		}
@@ -1608,9 +1713,19 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 	}
 
 fetch_events:
+	if (!ep_events_available(ep))
+		ep_busy_loop(ep, timed_out);
+
 	spin_lock_irqsave(&ep->lock, flags);
 
 	if (!ep_events_available(ep)) {
+		/*
+		 * Busy poll timed out.  Drop NAPI ID for now, we can add
+		 * it back in when we have moved a socket with a valid NAPI
+		 * ID onto the ready list.
+		 */
+		ep_reset_busy_poll_napi_id(ep);
+
 		/*
 		 * We don't have any available event to return to the caller.
 		 * We need to sleep here, and we will be wake up by
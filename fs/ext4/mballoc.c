@@ -704,18 +704,36 @@ static void ext4_mb_mark_free_simple(struct super_block *sb,
 static void
 mb_set_largest_free_order(struct super_block *sb, struct ext4_group_info *grp)
 {
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int old = grp->bb_largest_free_order;
+	int new = -1; /* uninit */
 	int i;
 	int bits;
 
-	grp->bb_largest_free_order = -1; /* uninit */
-
 	bits = sb->s_blocksize_bits + 1;
 	for (i = bits; i >= 0; i--) {
 		if (grp->bb_counters[i] > 0) {
-			grp->bb_largest_free_order = i;
+			new = i;
 			break;
 		}
 	}
+
+	if (new == old && !list_empty(&grp->bb_largest_free_order_node))
+		return;
+
+	/* move the group to the list of its new order */
+	if (old >= 0 && !list_empty(&grp->bb_largest_free_order_node)) {
+		spin_lock(&sbi->s_mb_largest_free_orders_locks[old]);
+		list_del_init(&grp->bb_largest_free_order_node);
+		spin_unlock(&sbi->s_mb_largest_free_orders_locks[old]);
+	}
+	grp->bb_largest_free_order = new;
+	if (new >= 0) {
+		spin_lock(&sbi->s_mb_largest_free_orders_locks[new]);
+		list_add_tail(&grp->bb_largest_free_order_node,
+			      &sbi->s_mb_largest_free_orders[new]);
+		spin_unlock(&sbi->s_mb_largest_free_orders_locks[new]);
+	}
 }
 
 static noinline_for_stack
@@ -2082,6 +2100,49 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Find a group for a cr 0 request from the largest free order lists,
+ * starting with the smallest order that fits.  Groups are rotated to the
+ * tail of their list so that concurrent allocators spread over them.
+ * Returns false if no initialized group has a large enough free extent.
+ */
+static bool ext4_mb_find_group_cr0(struct ext4_allocation_context *ac,
+				   ext4_group_t ngroups, ext4_group_t *group)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
+	int flex_size = ext4_flex_bg_size(sbi);
+	struct ext4_group_info *grp;
+	bool found = false;
+	int i;
+
+	for (i = ac->ac_2order; i < MB_NUM_ORDERS(ac->ac_sb) && !found; i++) {
+		if (list_empty(&sbi->s_mb_largest_free_orders[i]))
+			continue;
+
+		spin_lock(&sbi->s_mb_largest_free_orders_locks[i]);
+		list_for_each_entry(grp, &sbi->s_mb_largest_free_orders[i],
+				    bb_largest_free_order_node) {
+			if (grp->bb_group >= ngroups ||
+			    grp->bb_free < ac->ac_g_ex.fe_len ||
+			    EXT4_MB_GRP_BBITMAP_CORRUPT(grp))
+				continue;
+			/* see ext4_mb_good_group() */
+			if ((ac->ac_flags & EXT4_MB_HINT_DATA) &&
+			    flex_size >= EXT4_FLEX_SIZE_DIR_ALLOC_SCHEME &&
+			    grp->bb_group % flex_size == 0)
+				continue;
+
+			*group = grp->bb_group;
+			list_move_tail(&grp->bb_largest_free_order_node,
+				       &sbi->s_mb_largest_free_orders[i]);
+			found = true;
+			break;
+		}
+		spin_unlock(&sbi->s_mb_largest_free_orders_locks[i]);
+	}
+	return found;
+}
+
 static noinline_for_stack int
 ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 {
@@ -2129,13 +2190,13 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 			ac->ac_2order = i - 1;
 	}
 
-	/* if stream allocation is enabled, use global goal */
+	/*
+	 * if stream allocation is enabled, use global goal; it is only a
+	 * hint, so a torn read of the pair is harmless
+	 */
 	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
-		/* TBD: may be hot point */
-		spin_lock(&sbi->s_md_lock);
-		ac->ac_g_ex.fe_group = sbi->s_mb_last_group;
-		ac->ac_g_ex.fe_start = sbi->s_mb_last_start;
-		spin_unlock(&sbi->s_md_lock);
+		ac->ac_g_ex.fe_group = READ_ONCE(sbi->s_mb_last_group);
+		ac->ac_g_ex.fe_start = READ_ONCE(sbi->s_mb_last_start);
 	}
 
 	/* Let's just scan groups to find more-less suitable blocks */
@@ -2156,6 +2217,15 @@ repeat:
 		for (i = 0; i < ngroups; group++, i++) {
 			int ret = 0;
 			cond_resched();
+
+			/*
+			 * The lists only hold initialized groups, the others
+			 * are found by cr 1 and later.
+			 */
+			if (cr == 0 && sbi->s_mb_optimize_scan &&
+			    ac->ac_2order < MB_NUM_ORDERS(sb) &&
+			    !ext4_mb_find_group_cr0(ac, ngroups, &group))
+				break;
 			/*
 			 * Artificially restricted ngroups for non-extent
 			 * files makes group > ngroups possible on first loop.
@@ -2436,9 +2506,11 @@ int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
 	}
 
 	INIT_LIST_HEAD(&meta_group_info[i]->bb_prealloc_list);
+	INIT_LIST_HEAD(&meta_group_info[i]->bb_largest_free_order_node);
 	init_rwsem(&meta_group_info[i]->alloc_sem);
 	meta_group_info[i]->bb_free_root = RB_ROOT;
 	meta_group_info[i]->bb_largest_free_order = -1;  /* uninit */
+	meta_group_info[i]->bb_group = group;
 
 #ifdef DOUBLE_CHECK
 	{
@@ -2588,6 +2660,21 @@ int ext4_mb_init(struct super_block *sb)
 		goto out;
 	}
 
+	i = MB_NUM_ORDERS(sb);
+	sbi->s_mb_largest_free_orders =
+		kmalloc_array(i, sizeof(struct list_head), GFP_KERNEL);
+	sbi->s_mb_largest_free_orders_locks =
+		kmalloc_array(i, sizeof(spinlock_t), GFP_KERNEL);
+	if (!sbi->s_mb_largest_free_orders ||
+	    !sbi->s_mb_largest_free_orders_locks) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < MB_NUM_ORDERS(sb); i++) {
+		INIT_LIST_HEAD(&sbi->s_mb_largest_free_orders[i]);
+		spin_lock_init(&sbi->s_mb_largest_free_orders_locks[i]);
+	}
+
 	ret = ext4_groupinfo_create_slab(sb->s_blocksize);
 	if (ret < 0)
 		goto out;
@@ -2615,6 +2702,7 @@ int ext4_mb_init(struct super_block *sb)
 	sbi->s_mb_stats = MB_DEFAULT_STATS;
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
+	sbi->s_mb_optimize_scan = MB_DEFAULT_OPTIMIZE_SCAN;
 	/*
 	 * The default group preallocation is 512, which for 4k block
 	 * sizes translates to 2 megabytes.  However for bigalloc file
@@ -2671,6 +2759,10 @@ out_free_locality_groups:
 	free_percpu(sbi->s_locality_groups);
 	sbi->s_locality_groups = NULL;
 out:
+	kfree(sbi->s_mb_largest_free_orders);
+	sbi->s_mb_largest_free_orders = NULL;
+	kfree(sbi->s_mb_largest_free_orders_locks);
+	sbi->s_mb_largest_free_orders_locks = NULL;
 	kfree(sbi->s_mb_offsets);
 	sbi->s_mb_offsets = NULL;
 	kfree(sbi->s_mb_maxs);
@@ -2726,6 +2818,8 @@ int ext4_mb_release(struct super_block *sb)
 			kfree(sbi->s_group_info[i]);
 		kvfree(sbi->s_group_info);
 	}
+	kfree(sbi->s_mb_largest_free_orders);
+	kfree(sbi->s_mb_largest_free_orders_locks);
 	kfree(sbi->s_mb_offsets);
 	kfree(sbi->s_mb_maxs);
 	iput(sbi->s_buddy_cache);
@@ -84,6 +84,15 @@ extern ushort ext4_mballoc_debug;
  */
 #define MB_DEFAULT_ORDER2_REQS		2
 
+/*
+ * pick 2^N requests' groups from the largest free order lists instead of
+ * testing every group in turn
+ */
+#define MB_DEFAULT_OPTIMIZE_SCAN	1
+
+/* number of buddy orders, order 0 being the block bitmap */
+#define MB_NUM_ORDERS(sb)		((sb)->s_blocksize_bits + 2)
+
 /*
  * default group prealloc size 512 blocks
  */
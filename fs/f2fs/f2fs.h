@@ -798,6 +798,13 @@ struct f2fs_sb_info {
 	unsigned int n_dirty_dirs;		/* # of dir inodes */
 #endif
 	unsigned int last_victim[2];		/* last victim segment # */
+	/*
+	 * best cost-benefit victims left over from the last background
+	 * scan, sorted by cost, protected by seglist_lock
+	 */
+	struct cb_victim *cb_victims;
+	unsigned int nr_cb_victims;
+	unsigned long cb_victims_expire;	/* in jiffies */
 	spinlock_t stat_lock;			/* lock for stat operations */
 
 	/* For sysfs suppport */
@@ -1803,7 +1810,8 @@ int start_gc_thread(struct f2fs_sb_info *);
 void stop_gc_thread(struct f2fs_sb_info *);
 block_t start_bidx_of_node(unsigned int, struct f2fs_inode_info *);
 int f2fs_gc(struct f2fs_sb_info *);
-void build_gc_manager(struct f2fs_sb_info *);
+int build_gc_manager(struct f2fs_sb_info *);
+void destroy_gc_manager(struct f2fs_sb_info *);
 
 /*
  * recovery.c
@@ -105,6 +105,7 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 	gc_th->no_gc_sleep_time = DEF_GC_THREAD_NOGC_SLEEP_TIME;
 
 	gc_th->gc_idle = 0;
+	gc_th->idle_interval = DEF_GC_IDLE_INTERVAL;
 
 	sbi->gc_thread = gc_th;
 	init_waitqueue_head(&sbi->gc_thread->gc_wait_queue_head);
@@ -230,6 +231,74 @@ static unsigned int get_cb_cost(struct f2fs_sb_info *sbi, unsigned int segno)
 	return UINT_MAX - ((100 * (100 - u) * age) / (100 + u));
 }
 
+/*
+ * Remember @segno among the best cost-benefit victims seen by the running
+ * scan.  The array is kept sorted by cost, the worst entry is dropped.
+ */
+static void cb_victim_insert(struct f2fs_sb_info *sbi, unsigned int segno,
+							unsigned int cost)
+{
+	unsigned int i = sbi->nr_cb_victims;
+
+	if (i == CB_VICTIM_CACHE_SIZE) {
+		if (cost >= sbi->cb_victims[i - 1].cost)
+			return;
+		i--;
+	} else {
+		sbi->nr_cb_victims++;
+	}
+
+	for (; i > 0 && sbi->cb_victims[i - 1].cost > cost; i--)
+		sbi->cb_victims[i] = sbi->cb_victims[i - 1];
+	sbi->cb_victims[i].segno = segno;
+	sbi->cb_victims[i].cost = cost;
+}
+
+static void cb_victim_remove(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	unsigned int i;
+
+	for (i = 0; i < sbi->nr_cb_victims; i++)
+		if (sbi->cb_victims[i].segno == segno)
+			break;
+	if (i == sbi->nr_cb_victims)
+		return;
+
+	sbi->nr_cb_victims--;
+	for (; i < sbi->nr_cb_victims; i++)
+		sbi->cb_victims[i] = sbi->cb_victims[i + 1];
+}
+
+/*
+ * Take the best victim left over from a previous cost-benefit scan which
+ * is still dirty and not in use, so that background GC doesn't have to
+ * walk the SIT every round.
+ */
+static unsigned int cb_victim_get(struct f2fs_sb_info *sbi,
+					struct victim_sel_policy *p)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	unsigned int i, segno, secno;
+
+	if (time_after(jiffies, sbi->cb_victims_expire))
+		sbi->nr_cb_victims = 0;
+
+	while (sbi->nr_cb_victims) {
+		segno = sbi->cb_victims[0].segno;
+		sbi->nr_cb_victims--;
+		for (i = 0; i < sbi->nr_cb_victims; i++)
+			sbi->cb_victims[i] = sbi->cb_victims[i + 1];
+
+		secno = GET_SECNO(sbi, segno);
+		if (!test_bit(segno, p->dirty_segmap) ||
+				sec_usage_check(sbi, secno) ||
+				test_bit(secno, dirty_i->victim_secmap))
+			continue;
+		return segno;
+	}
+	return NULL_SEGNO;
+}
+
 static inline unsigned int get_gc_cost(struct f2fs_sb_info *sbi,
 			unsigned int segno, struct victim_sel_policy *p)
 {
@@ -258,6 +327,7 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 	struct victim_sel_policy p;
 	unsigned int secno, max_cost;
 	int nsearched = 0;
+	bool cb_scan;
 
 	mutex_lock(&dirty_i->seglist_lock);
 
@@ -273,6 +343,15 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 			goto got_it;
 	}
 
+	cb_scan = p.alloc_mode == LFS && p.gc_mode == GC_CB &&
+							gc_type == BG_GC;
+	if (cb_scan) {
+		p.min_segno = cb_victim_get(sbi, &p);
+		if (p.min_segno != NULL_SEGNO)
+			goto got_it;
+		sbi->cb_victims_expire = jiffies + CB_VICTIM_CACHE_EXPIRE;
+	}
+
 	while (1) {
 		unsigned long cost;
 		unsigned int segno;
@@ -300,6 +379,9 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 
 		cost = get_gc_cost(sbi, segno, &p);
 
+		if (cb_scan && cost != max_cost)
+			cb_victim_insert(sbi, segno, cost);
+
 		if (p.min_cost > cost) {
 			p.min_segno = segno;
 			p.min_cost = cost;
@@ -312,6 +394,9 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 			break;
 		}
 	}
+	if (cb_scan && p.min_segno != NULL_SEGNO)
+		cb_victim_remove(sbi, p.min_segno);
+
 	if (p.min_segno != NULL_SEGNO) {
 got_it:
 		if (p.alloc_mode == LFS) {
@@ -850,7 +935,18 @@ stop:
 	return ret;
 }
 
-void build_gc_manager(struct f2fs_sb_info *sbi)
+int build_gc_manager(struct f2fs_sb_info *sbi)
 {
+	sbi->cb_victims = kcalloc(CB_VICTIM_CACHE_SIZE,
+				sizeof(struct cb_victim), GFP_KERNEL);
+	if (!sbi->cb_victims)
+		return -ENOMEM;
+
 	DIRTY_I(sbi)->v_ops = &default_v_ops;
+	return 0;
+}
+
+void destroy_gc_manager(struct f2fs_sb_info *sbi)
+{
+	kfree(sbi->cb_victims);
 }
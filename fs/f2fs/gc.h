@@ -16,6 +16,9 @@
 #define DEF_GC_THREAD_MIN_SLEEP_TIME	30000	/* milliseconds */
 #define DEF_GC_THREAD_MAX_SLEEP_TIME	60000
 #define DEF_GC_THREAD_NOGC_SLEEP_TIME	300000	/* wait 5 min */
+#define DEF_GC_IDLE_INTERVAL		1000	/* milliseconds */
+#define CB_VICTIM_CACHE_SIZE		16	/* victims kept between rounds */
+#define CB_VICTIM_CACHE_EXPIRE		(60 * HZ)	/* rescan every minute */
 #define LIMIT_INVALID_BLOCK	40 /* percentage over total user space */
 #define LIMIT_FREE_BLOCK	40 /* percentage over invalid + free space */
 
@@ -39,6 +42,14 @@ struct f2fs_gc_kthread {
 
 	/* for changing gc mode */
 	unsigned int gc_idle;
+
+	/* device must have been without I/O for this long to run gc */
+	unsigned int idle_interval;	/* milliseconds */
+};
+
+struct cb_victim {
+	unsigned int segno;
+	unsigned int cost;
 };
 
 struct gc_inode_list {
@@ -107,10 +118,19 @@ static inline bool has_enough_invalid_blocks(struct f2fs_sb_info *sbi)
 	return false;
 }
 
+/*
+ * The device is idle if the block layer has no request in flight for our
+ * partition and hasn't seen any for gc_idle_interval.  part->stamp is
+ * updated on every request start and completion, for request based and
+ * blk-mq devices alike.
+ */
 static inline int is_idle(struct f2fs_sb_info *sbi)
 {
-	struct block_device *bdev = sbi->sb->s_bdev;
-	struct request_queue *q = bdev_get_queue(bdev);
-	struct request_list *rl = &q->root_rl;
-	return !(rl->count[BLK_RW_SYNC]) && !(rl->count[BLK_RW_ASYNC]);
+	struct hd_struct *part = sbi->sb->s_bdev->bd_part;
+	unsigned long interval =
+		msecs_to_jiffies(sbi->gc_thread->idle_interval);
+
+	if (part_in_flight(part))
+		return 0;
+	return time_after_eq(jiffies, READ_ONCE(part->stamp) + interval);
 }
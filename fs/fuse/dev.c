@@ -19,6 +19,7 @@
 #include <linux/pipe_fs_i.h>
 #include <linux/swap.h>
 #include <linux/splice.h>
+#include <linux/percpu.h>
 
 MODULE_ALIAS_MISCDEV(FUSE_MINOR);
 MODULE_ALIAS("devname:fuse");
@@ -320,16 +321,68 @@ static unsigned len_args(unsigned numargs, struct fuse_arg *args)
 
 static u64 fuse_get_unique(struct fuse_iqueue *fiq)
 {
-	return ++fiq->reqctr;
+	return atomic64_inc_return(&fiq->reqctr);
 }
 
-static void queue_request(struct fuse_iqueue *fiq, struct fuse_req *req)
+/*
+ * Queue the request on the input queue of the submitting CPU if a device
+ * is bound to it, on the shared queue otherwise.  Returns false if the
+ * connection has been aborted.
+ */
+static bool queue_request(struct fuse_iqueue *fiq, struct fuse_req *req)
 {
+	struct fuse_cpu_queue __percpu *cpuq = READ_ONCE(fiq->cpuq);
+	struct fuse_cpu_queue *q = NULL;
+	wait_queue_head_t *waitq;
+
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
-	list_add_tail(&req->list, &fiq->pending);
-	wake_up_locked(&fiq->waitq);
+
+	if (cpuq) {
+		q = raw_cpu_ptr(cpuq);
+		spin_lock(&q->waitq.lock);
+		if (!q->nr_devs) {
+			spin_unlock(&q->waitq.lock);
+			q = NULL;
+		}
+	}
+	if (q) {
+		waitq = &q->waitq;
+	} else {
+		waitq = &fiq->waitq;
+		spin_lock(&waitq->lock);
+	}
+
+	if (!fiq->connected) {
+		spin_unlock(&waitq->lock);
+		return false;
+	}
+	req->cpuq = q;
+	list_add_tail(&req->list, q ? &q->pending : &fiq->pending);
+	wake_up_locked(waitq);
+	spin_unlock(&waitq->lock);
 	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
+
+	return true;
+}
+
+/*
+ * Lock the input queue the request is pending on.  It can move from a
+ * per-CPU queue to the shared one when the last device bound to that CPU
+ * goes away, which is done with both locks held.
+ */
+static spinlock_t *lock_req_queue(struct fuse_iqueue *fiq,
+				  struct fuse_req *req)
+{
+	for (;;) {
+		struct fuse_cpu_queue *q = READ_ONCE(req->cpuq);
+		spinlock_t *lock = q ? &q->waitq.lock : &fiq->waitq.lock;
+
+		spin_lock(lock);
+		if (req->cpuq == q)
+			return lock;
+		spin_unlock(lock);
+	}
 }
 
 void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
@@ -362,10 +415,12 @@ static void flush_bg_queue(struct fuse_conn *fc)
 		req = list_entry(fc->bg_queue.next, struct fuse_req, list);
 		list_del(&req->list);
 		fc->active_background++;
-		spin_lock(&fiq->waitq.lock);
 		req->in.h.unique = fuse_get_unique(fiq);
+		/*
+		 * Can't fail: fuse_abort_conn() empties bg_queue under
+		 * fc->lock before disconnecting the input queues.
+		 */
 		queue_request(fiq, req);
-		spin_unlock(&fiq->waitq.lock);
 	}
 }
 
@@ -429,6 +484,7 @@ static void queue_interrupt(struct fuse_iqueue *fiq, struct fuse_req *req)
 static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 {
 	struct fuse_iqueue *fiq = &fc->iq;
+	spinlock_t *lock;
 	int err;
 
 	if (!fc->no_interrupt) {
@@ -457,16 +513,16 @@ static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 		if (!err)
 			return;
 
-		spin_lock(&fiq->waitq.lock);
+		lock = lock_req_queue(fiq, req);
 		/* Request is not yet in userspace, bail out */
 		if (test_bit(FR_PENDING, &req->flags)) {
 			list_del(&req->list);
-			spin_unlock(&fiq->waitq.lock);
+			spin_unlock(lock);
 			__fuse_put_request(req);
 			req->out.h.error = -EINTR;
 			return;
 		}
-		spin_unlock(&fiq->waitq.lock);
+		spin_unlock(lock);
 	}
 
 	/*
@@ -481,18 +537,14 @@ static void __fuse_request_send(struct fuse_conn *fc, struct fuse_req *req)
 	struct fuse_iqueue *fiq = &fc->iq;
 
 	BUG_ON(test_bit(FR_BACKGROUND, &req->flags));
-	spin_lock(&fiq->waitq.lock);
-	if (!fiq->connected) {
-		spin_unlock(&fiq->waitq.lock);
+	req->in.h.unique = fuse_get_unique(fiq);
+	/* acquire extra reference, since request is still needed
+	   after request_end() */
+	__fuse_get_request(req);
+	if (!queue_request(fiq, req)) {
+		__fuse_put_request(req);
 		req->out.h.error = -ENOTCONN;
 	} else {
-		req->in.h.unique = fuse_get_unique(fiq);
-		queue_request(fiq, req);
-		/* acquire extra reference, since request is still needed
-		   after request_end() */
-		__fuse_get_request(req);
-		spin_unlock(&fiq->waitq.lock);
-
 		request_wait_answer(fc, req);
 		/* Pairs with smp_wmb() in request_end() */
 		smp_rmb();
@@ -625,12 +677,8 @@ static int fuse_request_send_notify_reply(struct fuse_conn *fc,
 
 	__clear_bit(FR_ISREPLY, &req->flags);
 	req->in.h.unique = unique;
-	spin_lock(&fiq->waitq.lock);
-	if (fiq->connected) {
-		queue_request(fiq, req);
+	if (queue_request(fiq, req))
 		err = 0;
-	}
-	spin_unlock(&fiq->waitq.lock);
 
 	return err;
 }
@@ -1223,6 +1271,49 @@ __releases(fiq->waitq.lock)
 		return fuse_read_batch_forget(fiq, cs, nbytes);
 }
 
+/*
+ * Take the next request off the input queue of the CPU the device is bound
+ * to.  Returns NULL if the device was rebound while waiting.
+ */
+static struct fuse_req *fuse_read_cpu_queue(struct fuse_dev *fud,
+					    struct file *file, int cpu)
+{
+	struct fuse_iqueue *fiq = &fud->fc->iq;
+	struct fuse_cpu_queue *q = per_cpu_ptr(fiq->cpuq, cpu);
+	struct fuse_req *req;
+	int err;
+
+	spin_lock(&q->waitq.lock);
+	err = -EAGAIN;
+	if ((file->f_flags & O_NONBLOCK) && fiq->connected &&
+	    list_empty(&q->pending) && READ_ONCE(fud->cpu) == cpu)
+		goto err_unlock;
+
+	err = wait_event_interruptible_exclusive_locked(q->waitq,
+				!fiq->connected || !list_empty(&q->pending) ||
+				READ_ONCE(fud->cpu) != cpu);
+	if (err)
+		goto err_unlock;
+
+	err = -ENODEV;
+	if (!fiq->connected)
+		goto err_unlock;
+
+	req = NULL;
+	if (READ_ONCE(fud->cpu) == cpu) {
+		req = list_entry(q->pending.next, struct fuse_req, list);
+		clear_bit(FR_PENDING, &req->flags);
+		list_del_init(&req->list);
+	}
+	spin_unlock(&q->waitq.lock);
+
+	return req;
+
+ err_unlock:
+	spin_unlock(&q->waitq.lock);
+	return ERR_PTR(err);
+}
+
 /*
  * Read a single request into the userspace filesystem's buffer.  This
  * function waits until a request is available, then removes it from
@@ -1242,8 +1333,19 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 	struct fuse_req *req;
 	struct fuse_in *in;
 	unsigned reqsize;
+	int cpu;
 
  restart:
+	cpu = READ_ONCE(fud->cpu);
+	if (cpu >= 0) {
+		req = fuse_read_cpu_queue(fud, file, cpu);
+		if (IS_ERR(req))
+			return PTR_ERR(req);
+		if (!req)
+			goto restart;
+		goto got_req;
+	}
+
 	spin_lock(&fiq->waitq.lock);
 	err = -EAGAIN;
 	if ((file->f_flags & O_NONBLOCK) && fiq->connected &&
@@ -1278,6 +1380,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 	list_del_init(&req->list);
 	spin_unlock(&fiq->waitq.lock);
 
+ got_req:
 	in = &req->in;
 	reqsize = in->h.len;
 	/* If request is too large, reply with an error and restart the read */
@@ -1707,7 +1810,7 @@ static int fuse_retrieve(struct fuse_conn *fc, struct inode *inode,
 		num = file_size - outarg->offset;
 
 	num_pages = (num + offset + PAGE_SIZE - 1) >> PAGE_SHIFT;
-	num_pages = min(num_pages, FUSE_MAX_PAGES_PER_REQ);
+	num_pages = min_t(int, num_pages, fc->max_pages);
 
 	req = fuse_get_req(fc, num_pages);
 	if (IS_ERR(req))
@@ -2055,11 +2158,28 @@ static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 	unsigned mask = POLLOUT | POLLWRNORM;
 	struct fuse_iqueue *fiq;
 	struct fuse_dev *fud = fuse_get_dev(file);
+	int cpu;
 
 	if (!fud)
 		return POLLERR;
 
 	fiq = &fud->fc->iq;
+	cpu = READ_ONCE(fud->cpu);
+	if (cpu >= 0) {
+		struct fuse_cpu_queue *q = per_cpu_ptr(fiq->cpuq, cpu);
+
+		poll_wait(file, &q->waitq, wait);
+
+		spin_lock(&q->waitq.lock);
+		if (!fiq->connected)
+			mask = POLLERR;
+		else if (!list_empty(&q->pending))
+			mask |= POLLIN | POLLRDNORM;
+		spin_unlock(&q->waitq.lock);
+
+		return mask;
+	}
+
 	poll_wait(file, &fiq->waitq, wait);
 
 	spin_lock(&fiq->waitq.lock);
@@ -2165,6 +2285,19 @@ void fuse_abort_conn(struct fuse_conn *fc)
 			kfree(dequeue_forget(fiq, 1, NULL));
 		wake_up_all_locked(&fiq->waitq);
 		spin_unlock(&fiq->waitq.lock);
+		if (fiq->cpuq) {
+			int cpu;
+
+			for_each_possible_cpu(cpu) {
+				struct fuse_cpu_queue *q;
+
+				q = per_cpu_ptr(fiq->cpuq, cpu);
+				spin_lock(&q->waitq.lock);
+				list_splice_tail_init(&q->pending, &to_end2);
+				wake_up_all_locked(&q->waitq);
+				spin_unlock(&q->waitq.lock);
+			}
+		}
 		kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
 		end_polls(fc);
 		wake_up_all(&fc->blocked_waitq);
@@ -2183,6 +2316,91 @@ void fuse_abort_conn(struct fuse_conn *fc)
 }
 EXPORT_SYMBOL_GPL(fuse_abort_conn);
 
+static struct fuse_cpu_queue __percpu *fuse_alloc_cpu_queues(void)
+{
+	struct fuse_cpu_queue __percpu *cpuq;
+	int cpu;
+
+	cpuq = alloc_percpu(struct fuse_cpu_queue);
+	if (!cpuq)
+		return NULL;
+
+	for_each_possible_cpu(cpu) {
+		struct fuse_cpu_queue *q = per_cpu_ptr(cpuq, cpu);
+
+		init_waitqueue_head(&q->waitq);
+		INIT_LIST_HEAD(&q->pending);
+		q->nr_devs = 0;
+	}
+	return cpuq;
+}
+
+/*
+ * Stop reading the per-CPU queue of the device.  Requests left on it when
+ * the last device bound to that CPU goes away are moved to the shared
+ * queue.  Called with fuse_mutex held.
+ */
+static void fuse_device_unbind(struct fuse_dev *fud)
+{
+	struct fuse_iqueue *fiq = &fud->fc->iq;
+	struct fuse_cpu_queue *q;
+	struct fuse_req *req;
+
+	if (fud->cpu < 0)
+		return;
+
+	q = per_cpu_ptr(fiq->cpuq, fud->cpu);
+	spin_lock(&q->waitq.lock);
+	WRITE_ONCE(fud->cpu, -1);
+	if (!--q->nr_devs && !list_empty(&q->pending)) {
+		spin_lock(&fiq->waitq.lock);
+		list_for_each_entry(req, &q->pending, list)
+			req->cpuq = NULL;
+		list_splice_tail_init(&q->pending, &fiq->pending);
+		wake_up_locked(&fiq->waitq);
+		spin_unlock(&fiq->waitq.lock);
+	}
+	/* readers on this device must go back to the shared queue */
+	wake_up_all_locked(&q->waitq);
+	spin_unlock(&q->waitq.lock);
+}
+
+/*
+ * Have the device read requests submitted on @cpu instead of the shared
+ * queue, or go back to the shared queue if @cpu is -1.  Called with
+ * fuse_mutex held.
+ */
+static int fuse_device_bind(struct fuse_dev *fud, int cpu)
+{
+	struct fuse_iqueue *fiq = &fud->fc->iq;
+	struct fuse_cpu_queue *q;
+
+	if (cpu != -1 && (cpu < 0 || cpu >= nr_cpu_ids || !cpu_possible(cpu)))
+		return -EINVAL;
+
+	if (cpu >= 0 && !fiq->cpuq) {
+		struct fuse_cpu_queue __percpu *cpuq = fuse_alloc_cpu_queues();
+
+		if (!cpuq)
+			return -ENOMEM;
+		/* pairs with READ_ONCE() in queue_request() */
+		smp_wmb();
+		WRITE_ONCE(fiq->cpuq, cpuq);
+	}
+
+	fuse_device_unbind(fud);
+	if (cpu < 0)
+		return 0;
+
+	q = per_cpu_ptr(fiq->cpuq, cpu);
+	spin_lock(&q->waitq.lock);
+	q->nr_devs++;
+	WRITE_ONCE(fud->cpu, cpu);
+	spin_unlock(&q->waitq.lock);
+
+	return 0;
+}
+
 int fuse_dev_release(struct inode *inode, struct file *file)
 {
 	struct fuse_dev *fud = fuse_get_dev(file);
@@ -2193,6 +2411,11 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 
 		WARN_ON(!list_empty(&fpq->io));
 		end_requests(fc, &fpq->processing);
+		if (fud->cpu >= 0) {
+			mutex_lock(&fuse_mutex);
+			fuse_device_unbind(fud);
+			mutex_unlock(&fuse_mutex);
+		}
 		/* Are we the last open device? */
 		if (atomic_dec_and_test(&fc->dev_count)) {
 			WARN_ON(fc->iq.fasync != NULL);
@@ -2264,6 +2487,20 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 				fput(old);
 			}
 		}
+	} else if (cmd == FUSE_DEV_IOC_BIND_CPU) {
+		struct fuse_dev *fud = fuse_get_dev(file);
+		int cpu;
+
+		err = -EPERM;
+		if (!fud)
+			return err;
+
+		err = -EFAULT;
+		if (!get_user(cpu, (__u32 __user *) arg)) {
+			mutex_lock(&fuse_mutex);
+			err = fuse_device_bind(fud, cpu);
+			mutex_unlock(&fuse_mutex);
+		}
 	}
 	return err;
 }
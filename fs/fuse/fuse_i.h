@@ -23,8 +23,11 @@
 #include <linux/poll.h>
 #include <linux/workqueue.h>
 
-/** Max number of pages that can be used in a single read request */
-#define FUSE_MAX_PAGES_PER_REQ 32
+/** Default max number of pages that can be used in a single read request */
+#define FUSE_DEFAULT_MAX_PAGES_PER_REQ 32
+
+/** Maximum of max_pages received in init_out */
+#define FUSE_MAX_MAX_PAGES 256
 
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
@@ -306,6 +309,9 @@ struct fuse_req {
 	/** Unique ID for the interrupt request */
 	u64 intr_unique;
 
+	/** Per-CPU input queue the request is pending on, NULL if shared */
+	struct fuse_cpu_queue *cpuq;
+
 	/* Request flags, updated with test/set/clear_bit() */
 	unsigned long flags;
 
@@ -384,7 +390,7 @@ struct fuse_iqueue {
 	wait_queue_head_t waitq;
 
 	/** The next unique request id */
-	u64 reqctr;
+	atomic64_t reqctr;
 
 	/** The list of pending requests */
 	struct list_head pending;
@@ -401,6 +407,25 @@ struct fuse_iqueue {
 
 	/** O_ASYNC requests */
 	struct fasync_struct *fasync;
+
+	/** Input queues of the CPUs, allocated when a device is bound */
+	struct fuse_cpu_queue __percpu *cpuq;
+};
+
+/**
+ * Requests submitted on one CPU, only read from the devices bound to that
+ * CPU with FUSE_DEV_IOC_BIND_CPU.  Interrupts, forgets and requests from
+ * CPUs without a bound device stay on the shared queue.
+ */
+struct fuse_cpu_queue {
+	/** Bound readers wait here, the lock protects the queue */
+	wait_queue_head_t waitq;
+
+	/** The list of pending requests */
+	struct list_head pending;
+
+	/** Number of devices bound to this CPU */
+	unsigned nr_devs;
 };
 
 struct fuse_pqueue {
@@ -429,6 +454,9 @@ struct fuse_dev {
 
 	/** list entry on fc->devices */
 	struct list_head entry;
+
+	/** CPU whose input queue is read, -1 for the shared queue */
+	int cpu;
 };
 
 /**
@@ -465,6 +493,9 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
+	/** Maximum number of pages that can be used in a single request */
+	unsigned max_pages;
+
 	/** Input queue */
 	struct fuse_iqueue iq;
 
@@ -337,6 +337,15 @@ static void jbd2_descr_block_csum_set(journal_t *j,
 	tail->t_checksum = cpu_to_be32(csum);
 }
 
+static void jbd2_submit_log_bh(struct buffer_head *bh)
+{
+	lock_buffer(bh);
+	clear_buffer_dirty(bh);
+	set_buffer_uptodate(bh);
+	bh->b_end_io = journal_end_buffer_io_sync;
+	submit_bh(WRITE_SYNC, bh);
+}
+
 static void jbd2_block_tag_csum_set(journal_t *j, journal_block_tag_t *tag,
 				    struct buffer_head *bh, __u32 sequence)
 {
@@ -396,12 +405,23 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	tid_t first_tid;
 	int update_tail;
 	int csum_size = 0;
+	bool early_submit;
 	LIST_HEAD(io_bufs);
 	LIST_HEAD(log_bufs);
 
 	if (jbd2_journal_has_csum_v2or3(journal))
 		csum_size = sizeof(struct jbd2_journal_block_tail);
 
+	/*
+	 * Log blocks are sent to the disk as soon as their tag is set up,
+	 * so that the I/O overlaps the checksumming of the blocks after
+	 * them; only the descriptor waits until it is full.  The v1 commit
+	 * checksum runs over the blocks in log order, descriptor first,
+	 * so it keeps submitting whole batches.
+	 */
+	early_submit = !JBD2_HAS_COMPAT_FEATURE(journal,
+					JBD2_FEATURE_COMPAT_CHECKSUM);
+
 	/*
 	 * First job: lock down the current transaction and wait for
 	 * all outstanding updates to complete.
@@ -699,7 +719,12 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 					commit_transaction->t_tid);
 		tagp += tag_bytes;
 		space_left -= tag_bytes;
-		bufs++;
+		if (early_submit) {
+			jbd2_submit_log_bh(wbuf[bufs]);
+			stats.run.rs_blocks_logged++;
+		} else {
+			bufs++;
+		}
 
 		if (first_tag) {
 			memcpy (tagp, journal->j_uuid, 16);
@@ -736,11 +761,7 @@ start_journal_io:
 					    jbd2_checksum_data(crc32_sum, bh);
 				}
 
-				lock_buffer(bh);
-				clear_buffer_dirty(bh);
-				set_buffer_uptodate(bh);
-				bh->b_end_io = journal_end_buffer_io_sync;
-				submit_bh(WRITE_SYNC, bh);
+				jbd2_submit_log_bh(bh);
 			}
 			cond_resched();
 			stats.run.rs_blocks_logged += bufs;
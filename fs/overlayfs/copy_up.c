@@ -76,6 +76,7 @@ static int ovl_copy_up_data(struct path *old, struct path *new, loff_t len)
 	struct file *new_file;
 	loff_t old_pos = 0;
 	loff_t new_pos = 0;
+	loff_t size = len;
 	int error = 0;
 
 	if (len == 0)
@@ -91,19 +92,38 @@ static int ovl_copy_up_data(struct path *old, struct path *new, loff_t len)
 		goto out_fput;
 	}
 
-	/* FIXME: copy up sparse files efficiently */
 	while (len) {
 		size_t this_len = OVL_COPY_UP_CHUNK_SIZE;
+		loff_t data, hole;
 		long bytes;
 
-		if (len < this_len)
-			this_len = len;
-
 		if (signal_pending_state(TASK_KILLABLE, current)) {
 			error = -EINTR;
 			break;
 		}
 
+		/*
+		 * Leave holes in the lower file as holes in the upper one.
+		 * Filesystems that don't track them report a single extent
+		 * of data, anything else failing means we copy everything.
+		 */
+		data = vfs_llseek(old_file, old_pos, SEEK_DATA);
+		if (data == -ENXIO)
+			break;
+		if (data > old_pos) {
+			if (data - old_pos >= len)
+				break;
+			len -= data - old_pos;
+			old_pos = new_pos = data;
+		}
+
+		hole = vfs_llseek(old_file, old_pos, SEEK_HOLE);
+		if (hole > old_pos && hole - old_pos < this_len)
+			this_len = hole - old_pos;
+
+		if (len < this_len)
+			this_len = len;
+
 		bytes = do_splice_direct(old_file, &old_pos,
 					 new_file, &new_pos,
 					 this_len, SPLICE_F_MOVE);
@@ -116,6 +136,10 @@ static int ovl_copy_up_data(struct path *old, struct path *new, loff_t len)
 		len -= bytes;
 	}
 
+	/* extend over a trailing hole */
+	if (!error && new_pos < size)
+		error = vfs_truncate(new, size);
+
 	fput(new_file);
 out_fput:
 	fput(old_file);
@@ -22,6 +22,13 @@ static void seq_set_overflow(struct seq_file *m)
 	m->count = m->size;
 }
 
+/*
+ * Bound on how far seq_read() grows the buffer to match a large read,
+ * so that a reader going through a long file with a big buffer gets it
+ * in few ->start() calls rather than one page per call.
+ */
+#define SEQ_BUF_BATCH_MAX	(32 * PAGE_SIZE)
+
 static void *seq_buf_alloc(unsigned long size)
 {
 	void *buf;
@@ -221,6 +228,20 @@ ssize_t seq_read(struct file *file, char __user *buf, size_t size, loff_t *ppos)
 		if (!size)
 			goto Done;
 	}
+	/* the buffer is empty here, size it for the rest of the read */
+	if (size > m->size && m->size < SEQ_BUF_BATCH_MAX) {
+		size_t bufsize = m->size;
+		void *newbuf;
+
+		while (bufsize < size && bufsize < SEQ_BUF_BATCH_MAX)
+			bufsize <<= 1;
+		newbuf = seq_buf_alloc(bufsize);
+		if (newbuf) {
+			kvfree(m->buf);
+			m->buf = newbuf;
+			m->size = bufsize;
+		}
+	}
 	/* we need at least one record in buffer */
 	pos = m->index;
 	p = m->op->start(m, &pos);
@@ -1152,7 +1152,8 @@ static long do_splice_to(struct file *in, loff_t *ppos,
  *    This is a special case helper to splice directly between two
  *    points, without requiring an explicit pipe. Internally an allocated
  *    pipe is cached in the process, and reused during the lifetime of
- *    that process.
+ *    that process.  It is sized to pipe_max_size, so that a sendfile()
+ *    moves that much data per round trip through the pipe.
  *
  */
 ssize_t splice_direct_to_actor(struct file *in, struct splice_desc *sd,
@@ -1190,6 +1191,10 @@ ssize_t splice_direct_to_actor(struct file *in, struct splice_desc *sd,
 		 */
 		pipe->readers = 1;
 
+		/* not fatal, the default size only makes for more loops */
+		if ((pipe_max_size >> PAGE_SHIFT) > pipe->buffers)
+			pipe_set_size(pipe, pipe_max_size >> PAGE_SHIFT);
+
 		current->splice_pipe = pipe;
 	}
 
@@ -212,3 +212,23 @@ read_failure:
 	kfree(bh);
 	return -EIO;
 }
+
+/*
+ * Start reading the device blocks of a datablock without waiting for them,
+ * so that a later squashfs_read_data() of it finds them in flight or
+ * uptodate.
+ */
+void squashfs_readahead_data(struct super_block *sb, u64 index, int length)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	u64 cur_index = index >> msblk->devblksize_log2;
+	u64 last_index;
+
+	length = SQUASHFS_COMPRESSED_SIZE_BLOCK(length);
+	if (!length || (index + length) > msblk->bytes_used)
+		return;
+
+	last_index = (index + length - 1) >> msblk->devblksize_log2;
+	for (; cur_index <= last_index; cur_index++)
+		sb_breadahead(sb, cur_index);
+}
@@ -41,6 +41,10 @@ static const struct squashfs_decompressor squashfs_lzma_unsupported_comp_ops = {
 	NULL, NULL, NULL, NULL, LZMA_COMPRESSION, "lzma", 0
 };
 
+static const struct squashfs_decompressor squashfs_zstd_unsupported_comp_ops = {
+	NULL, NULL, NULL, NULL, ZSTD_COMPRESSION, "zstd", 0
+};
+
 #ifndef CONFIG_SQUASHFS_LZ4
 static const struct squashfs_decompressor squashfs_lz4_comp_ops = {
 	NULL, NULL, NULL, NULL, LZ4_COMPRESSION, "lz4", 0
@@ -75,6 +79,7 @@ static const struct squashfs_decompressor *decompressor[] = {
 	&squashfs_lzo_comp_ops,
 	&squashfs_xz_comp_ops,
 	&squashfs_lzma_unsupported_comp_ops,
+	&squashfs_zstd_unsupported_comp_ops,
 	&squashfs_unknown_comp_ops
 };
 
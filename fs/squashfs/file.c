@@ -47,6 +47,7 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/blkdev.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -498,6 +499,59 @@ out:
 }
 
 
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+/*
+ * Read ahead whole datablocks.  Fragments, sparse blocks and whatever is
+ * left on the list when a block can't be read ahead are dropped, they're
+ * read by squashfs_readpage() when actually accessed.
+ */
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	int mask = (1 << shift) - 1;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	pgoff_t last_page = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	struct blk_plug plug;
+
+	TRACE("Entered squashfs_readpages, %u pages, start block %llx\n",
+				nr_pages, squashfs_i(inode)->start);
+
+	blk_start_plug(&plug);
+	while (!list_empty(pages)) {
+		struct page *page = list_entry(pages->prev, struct page, lru);
+		int index = page->index >> shift;
+		pgoff_t start = page->index & ~mask;
+		pgoff_t end = min_t(pgoff_t, start | mask, last_page);
+		u64 block = 0;
+		int bsize;
+
+		if (page->index > last_page)
+			break;
+
+		if (index >= file_end && squashfs_i(inode)->fragment_block !=
+						SQUASHFS_INVALID_BLK)
+			break;
+
+		bsize = read_blocklist(inode, index, &block);
+		if (bsize <= 0)
+			break;
+
+		if (squashfs_readahead_block(inode, block, bsize, pages,
+					     start, end))
+			break;
+	}
+	blk_finish_plug(&plug);
+
+	return 0;
+}
+#endif
+
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+	.readpages = squashfs_readpages,
+#endif
 };
@@ -13,6 +13,7 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -174,3 +175,119 @@ out:
 	squashfs_cache_put(buffer);
 	return res;
 }
+
+/*
+ * A datablock being read ahead.  All pages covered by the block are
+ * locked in the page cache and referenced, and get unlocked once the
+ * block has been decompressed into them.
+ */
+struct squashfs_readahead {
+	struct work_struct work;
+	struct super_block *sb;
+	u64 block;
+	int bsize;
+	int pages;
+	struct page *page[0];
+};
+
+static void squashfs_readahead_work(struct work_struct *work)
+{
+	struct squashfs_readahead *ra =
+		container_of(work, struct squashfs_readahead, work);
+	struct squashfs_page_actor *actor;
+	int i, bytes, res = -ENOMEM;
+	void *pageaddr;
+
+	actor = squashfs_page_actor_init_special(ra->page, ra->pages, 0);
+	if (actor) {
+		res = squashfs_read_data(ra->sb, ra->block, ra->bsize, NULL,
+					 actor);
+		kfree(actor);
+	}
+
+	/* Last page may have trailing bytes not filled */
+	bytes = res % PAGE_CACHE_SIZE;
+	if (res > 0 && bytes) {
+		pageaddr = kmap_atomic(ra->page[ra->pages - 1]);
+		memset(pageaddr + bytes, 0, PAGE_CACHE_SIZE - bytes);
+		kunmap_atomic(pageaddr);
+	}
+
+	for (i = 0; i < ra->pages; i++) {
+		flush_dcache_page(ra->page[i]);
+		if (res < 0)
+			SetPageError(ra->page[i]);
+		else
+			SetPageUptodate(ra->page[i]);
+		unlock_page(ra->page[i]);
+		page_cache_release(ra->page[i]);
+	}
+
+	kfree(ra);
+}
+
+/*
+ * Read ahead the datablock covering page cache indexes @start to @end,
+ * taking the pages in that range off the tail of the read-ahead list
+ * @list.  The device I/O is started right away and the decompression
+ * is run from a workqueue, so that the datablocks of one read-ahead
+ * window are decompressed in parallel, each directly into the page
+ * cache.  If some page of the block is uptodate already or can't be
+ * grabbed, the block is left to squashfs_readpage().
+ */
+int squashfs_readahead_block(struct inode *inode, u64 block, int bsize,
+	struct list_head *list, pgoff_t start, pgoff_t end)
+{
+	struct address_space *mapping = inode->i_mapping;
+	int i, pages = end - start + 1;
+	struct squashfs_readahead *ra;
+	bool missing = false;
+	struct page *page;
+
+	ra = kzalloc(sizeof(*ra) + pages * sizeof(struct page *), GFP_KERNEL);
+	if (ra == NULL)
+		return -ENOMEM;
+
+	while (!list_empty(list)) {
+		page = list_entry(list->prev, struct page, lru);
+		if (page->index > end)
+			break;
+
+		list_del(&page->lru);
+		if (add_to_page_cache_lru(page, mapping, page->index,
+					  GFP_KERNEL)) {
+			page_cache_release(page);
+			continue;
+		}
+		ra->page[page->index - start] = page;
+	}
+
+	for (i = 0; i < pages; i++) {
+		if (ra->page[i] == NULL)
+			ra->page[i] = grab_cache_page_nowait(mapping, start + i);
+
+		if (ra->page[i] == NULL || PageUptodate(ra->page[i]))
+			missing = true;
+	}
+
+	if (missing) {
+		for (i = 0; i < pages; i++) {
+			if (ra->page[i] == NULL)
+				continue;
+			unlock_page(ra->page[i]);
+			page_cache_release(ra->page[i]);
+		}
+		kfree(ra);
+		return 0;
+	}
+
+	ra->sb = inode->i_sb;
+	ra->block = block;
+	ra->bsize = bsize;
+	ra->pages = pages;
+	INIT_WORK(&ra->work, squashfs_readahead_work);
+
+	squashfs_readahead_data(inode->i_sb, block, bsize);
+	queue_work(system_unbound_wq, &ra->work);
+	return 0;
+}
@@ -30,6 +30,7 @@
 /* block.c */
 extern int squashfs_read_data(struct super_block *, u64, int, u64 *,
 				struct squashfs_page_actor *);
+extern void squashfs_readahead_data(struct super_block *, u64, int);
 
 /* cache.c */
 extern struct squashfs_cache *squashfs_cache_init(char *, int, int);
@@ -72,6 +73,8 @@ void squashfs_copy_cache(struct page *, struct squashfs_cache_entry *, int,
 
 /* file_xxx.c */
 extern int squashfs_readpage_block(struct page *, u64, int);
+extern int squashfs_readahead_block(struct inode *, u64, int,
+				struct list_head *, pgoff_t, pgoff_t);
 
 /* id.c */
 extern int squashfs_get_id(struct super_block *, unsigned int, unsigned int *);
@@ -46,6 +46,23 @@
 #include "decompressor.h"
 #include "xattr.h"
 
+/*
+ * Number of fragment and metadata blocks cached per filesystem, read at
+ * mount time.  Readers walking many small files at once thrash the
+ * default sized caches.
+ */
+static unsigned int fragment_cache_size = SQUASHFS_CACHED_FRAGMENTS;
+module_param(fragment_cache_size, uint, 0644);
+MODULE_PARM_DESC(fragment_cache_size,
+		 "Number of fragments cached per mount (default "
+		 __stringify(SQUASHFS_CACHED_FRAGMENTS) ")");
+
+static unsigned int metadata_cache_size = SQUASHFS_CACHED_BLKS;
+module_param(metadata_cache_size, uint, 0644);
+MODULE_PARM_DESC(metadata_cache_size,
+		 "Number of metadata blocks cached per mount (default "
+		 __stringify(SQUASHFS_CACHED_BLKS) ")");
+
 static struct file_system_type squashfs_fs_type;
 static const struct super_operations squashfs_super_ops;
 
@@ -202,7 +219,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	err = -ENOMEM;
 
 	msblk->block_cache = squashfs_cache_init("metadata",
-			SQUASHFS_CACHED_BLKS, SQUASHFS_METADATA_SIZE);
+			max(metadata_cache_size, 1U), SQUASHFS_METADATA_SIZE);
 	if (msblk->block_cache == NULL)
 		goto failed_mount;
 
@@ -278,7 +295,7 @@ handle_fragments:
 		goto check_directory_table;
 
 	msblk->fragment_cache = squashfs_cache_init("fragment",
-		SQUASHFS_CACHED_FRAGMENTS, msblk->block_size);
+		max(fragment_cache_size, 1U), msblk->block_size);
 	if (msblk->fragment_cache == NULL) {
 		err = -ENOMEM;
 		goto failed_mount;
@@ -161,6 +161,7 @@ static void destroy_super_rcu(struct rcu_head *head)
  */
 static void destroy_super(struct super_block *s)
 {
+	percpu_counter_destroy(&s->s_nr_dentry_negative);
 	list_lru_destroy(&s->s_dentry_lru);
 	list_lru_destroy(&s->s_inode_lru);
 	security_sb_free(s);
@@ -211,6 +212,9 @@ static struct super_block *alloc_super(struct file_system_type *type, int flags)
 		goto fail;
 	if (list_lru_init_memcg(&s->s_inode_lru))
 		goto fail;
+	if (percpu_counter_init(&s->s_nr_dentry_negative, 0, GFP_KERNEL))
+		goto fail;
+	INIT_WORK(&s->s_prune_negative_work, prune_negative_dentries);
 
 	init_rwsem(&s->s_umount);
 	lockdep_set_class(&s->s_umount, &type->s_umount_key);
@@ -411,6 +415,7 @@ void generic_shutdown_super(struct super_block *sb)
 
 	if (sb->s_root) {
 		shrink_dcache_for_umount(sb);
+		cancel_work_sync(&sb->s_prune_negative_work);
 		sync_filesystem(sb);
 		sb->s_flags &= ~MS_ACTIVE;
 
@@ -403,6 +403,17 @@ int crypto_ahash_final(struct ahash_request *req);
  */
 int crypto_ahash_digest(struct ahash_request *req);
 
+/**
+ * crypto_ahash_digest_batch() - calculate message digests of many buffers
+ * @batch: &ahash_request.base of the requests, set up like for
+ *	   crypto_ahash_digest(), and the callback for the whole batch
+ *
+ * Return: -EINPROGRESS if @batch->complete will be called once all digests
+ *	   are done; otherwise all requests completed synchronously, and the
+ *	   return value is 0 or the error of the first request that failed.
+ */
+int crypto_ahash_digest_batch(struct crypto_batch *batch);
+
 /**
  * crypto_ahash_export() - extract current message digest state
  * @req: reference to the ahash_request handle whose state is exported
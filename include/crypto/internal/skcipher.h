@@ -57,6 +57,8 @@ static inline struct crypto_ablkcipher *crypto_spawn_skcipher(
 
 int skcipher_null_givencrypt(struct skcipher_givcrypt_request *req);
 int skcipher_null_givdecrypt(struct skcipher_givcrypt_request *req);
+int skcipher_encrypt_batch(struct crypto_batch *batch);
+int skcipher_decrypt_batch(struct crypto_batch *batch);
 const char *crypto_default_geniv(const struct crypto_alg *alg);
 
 struct crypto_instance *skcipher_geniv_alloc(struct crypto_template *tmpl,
@@ -37,6 +37,7 @@ struct blk_mq_hw_ctx {
 	struct blk_flush_queue	*fq;
 
 	void			*driver_data;
+	void			*sched_data;
 
 	struct blk_mq_ctxmap	ctx_map;
 
@@ -57,6 +58,12 @@ struct blk_mq_hw_ctx {
 
 	atomic_t		nr_active;
 
+	/* mean completion time per data direction, for hybrid polling */
+	u64			poll_mean_ns[2];
+	unsigned long		poll_considered;
+	unsigned long		poll_invoked;
+	unsigned long		poll_success;
+
 	struct blk_mq_cpu_notifier	cpu_notifier;
 	struct kobject		kobj;
 };
@@ -89,6 +96,7 @@ typedef struct blk_mq_hw_ctx *(map_queue_fn)(struct request_queue *, const int);
 typedef enum blk_eh_timer_return (timeout_fn)(struct request *, bool);
 typedef int (init_hctx_fn)(struct blk_mq_hw_ctx *, void *, unsigned int);
 typedef void (exit_hctx_fn)(struct blk_mq_hw_ctx *, unsigned int);
+typedef int (poll_fn)(struct blk_mq_hw_ctx *, unsigned int);
 typedef int (init_request_fn)(void *, struct request *, unsigned int,
 		unsigned int, unsigned int);
 typedef void (exit_request_fn)(void *, struct request *, unsigned int,
@@ -116,6 +124,13 @@ struct blk_mq_ops {
 
 	softirq_done_fn		*complete;
 
+	/*
+	 * Called to poll for completion of a specific tag, returns the
+	 * number of requests completed, or a negative error if polling
+	 * can't make progress.
+	 */
+	poll_fn			*poll;
+
 	/*
 	 * Called when the block layer side of a hardware queue has been
 	 * set up, allowing the driver to allocate/init matching structures.
@@ -138,6 +138,17 @@ int clk_get_phase(struct clk *clk);
  */
 bool clk_is_match(const struct clk *p, const struct clk *q);
 
+/**
+ * clk_set_rates - change the rates of several clks as one transaction
+ * @clks: the clks whose rates are being changed
+ * @rates: the new rates, one per clk
+ * @num: number of clks
+ *
+ * Returns success (0) or negative errno; on failure the rates changed so
+ * far are reverted.
+ */
+int clk_set_rates(struct clk **clks, const unsigned long *rates, int num);
+
 #else
 
 static inline long clk_get_accuracy(struct clk *clk)
@@ -160,6 +171,12 @@ static inline bool clk_is_match(const struct clk *p, const struct clk *q)
 	return p == q;
 }
 
+static inline int clk_set_rates(struct clk **clks, const unsigned long *rates,
+				int num)
+{
+	return -ENOTSUPP;
+}
+
 #endif
 
 /**
@@ -16,6 +16,10 @@
 #include <linux/device.h>
 #include <linux/sched.h>
 
+struct perf_event_attr;
+struct perf_output_handle;
+struct cs_buffers;
+
 /* Peripheral id registers (0xFD0-0xFEC) */
 #define CORESIGHT_PERIPHIDR4	0xfd0
 #define CORESIGHT_PERIPHIDR5	0xfd4
@@ -158,6 +162,7 @@ struct coresight_connection {
  * @activated:	'true' only if a _sink_ has been activated.  A sink can be
 		activated but not yet enabled.  Enabling for a _sink_
 		happens when a source has been selected for that it.
+ * @perf:	'true' only if a _source_ path is owned by a perf session.
  */
 struct coresight_device {
 	struct coresight_connection *conns;
@@ -172,6 +177,7 @@ struct coresight_device {
 	bool orphan;
 	bool enable;	/* true only if configured as part of a path */
 	bool activated;	/* true only if a sink is part of a path */
+	bool perf;	/* true only if a source is used by perf */
 };
 
 #define to_coresight_device(d) container_of(d, struct coresight_device, dev)
@@ -185,10 +191,17 @@ struct coresight_device {
  * Operations available for sinks
  * @enable:	enables the sink.
  * @disable:	disables the sink.
+ * @update_buffer: moves the trace collected so far into the perf AUX
+		buffer described by @handle and restarts the capture.
+		Returns the number of bytes written, sets @lost if trace
+		was overwritten or didn't fit.  Called in atomic context.
  */
 struct coresight_ops_sink {
 	int (*enable)(struct coresight_device *csdev);
 	void (*disable)(struct coresight_device *csdev);
+	unsigned long (*update_buffer)(struct coresight_device *csdev,
+				       struct perf_output_handle *handle,
+				       struct cs_buffers *buf, bool *lost);
 };
 
 /**
@@ -209,11 +222,17 @@ struct coresight_ops_link {
 		to the HW.
  * @enable:	enables tracing from a source.
  * @disable:	disables tracing for a source.
+ * @perf_enable: enables tracing on the local CPU for a perf event,
+		honouring the exclusion bits of @attr.  Atomic context.
+ * @perf_disable: disables tracing on the local CPU.  Atomic context.
  */
 struct coresight_ops_source {
 	int (*trace_id)(struct coresight_device *csdev);
 	int (*enable)(struct coresight_device *csdev);
 	void (*disable)(struct coresight_device *csdev);
+	int (*perf_enable)(struct coresight_device *csdev,
+			   struct perf_event_attr *attr);
+	void (*perf_disable)(struct coresight_device *csdev);
 };
 
 struct coresight_ops {
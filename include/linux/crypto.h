@@ -160,6 +160,30 @@ struct crypto_async_request {
 	u32 flags;
 };
 
+/**
+ * struct crypto_batch - requests that complete with a single callback
+ * @reqs: the requests, such as &ablkcipher_request.base; they must all use
+ *	  the same transformation and have their flags set, while their own
+ *	  callbacks are replaced by the batch
+ * @nreqs: number of entries in @reqs
+ * @complete: called once all requests have completed, unless the
+ *	      submission returned something other than -EINPROGRESS
+ * @data: private data for @complete
+ * @err: error of the first failed request, 0 if none failed
+ * @pending: requests in flight, private to the crypto API
+ *
+ * Submitting many small requests as one batch saves their completion
+ * overhead in the caller and lets drivers queue them in one go.
+ */
+struct crypto_batch {
+	struct crypto_async_request **reqs;
+	unsigned int nreqs;
+	void (*complete)(struct crypto_batch *batch, int err);
+	void *data;
+	int err;
+	atomic_t pending;
+};
+
 struct ablkcipher_request {
 	struct crypto_async_request base;
 
@@ -239,6 +263,11 @@ struct hash_desc {
  *	        for encryption.
  * @givdecrypt: Update the IV for decryption. This is the reverse of
  *	        @givencrypt .
+ * @encrypt_batch: Encrypt all requests of a &struct crypto_batch. A driver
+ *		   that can queue many requests more cheaply than one at a
+ *		   time may provide this; otherwise the requests are passed
+ *		   to @encrypt one by one. See crypto_batch_submit().
+ * @decrypt_batch: The counterpart of @encrypt_batch for decryption.
  * @geniv: The transformation implementation may use an "IV generator" provided
  *	   by the kernel crypto API. Several use cases have a predefined
  *	   approach how IVs are to be updated. For such use cases, the kernel
@@ -247,8 +276,8 @@ struct hash_desc {
  * @ivsize: IV size applicable for transformation. The consumer must provide an
  *	    IV of exactly that size to perform the encrypt or decrypt operation.
  *
- * All fields except @givencrypt , @givdecrypt , @geniv and @ivsize are
- * mandatory and must be filled.
+ * All fields except @givencrypt , @givdecrypt , @encrypt_batch ,
+ * @decrypt_batch , @geniv and @ivsize are mandatory and must be filled.
  */
 struct ablkcipher_alg {
 	int (*setkey)(struct crypto_ablkcipher *tfm, const u8 *key,
@@ -257,6 +286,8 @@ struct ablkcipher_alg {
 	int (*decrypt)(struct ablkcipher_request *req);
 	int (*givencrypt)(struct skcipher_givcrypt_request *req);
 	int (*givdecrypt)(struct skcipher_givcrypt_request *req);
+	int (*encrypt_batch)(struct crypto_batch *batch);
+	int (*decrypt_batch)(struct crypto_batch *batch);
 
 	const char *geniv;
 
@@ -495,6 +526,8 @@ struct ablkcipher_tfm {
 	int (*decrypt)(struct ablkcipher_request *req);
 	int (*givencrypt)(struct skcipher_givcrypt_request *req);
 	int (*givdecrypt)(struct skcipher_givcrypt_request *req);
+	int (*encrypt_batch)(struct crypto_batch *batch);
+	int (*decrypt_batch)(struct crypto_batch *batch);
 
 	struct crypto_ablkcipher *base;
 
@@ -921,6 +954,47 @@ static inline int crypto_ablkcipher_decrypt(struct ablkcipher_request *req)
 	return crt->decrypt(req);
 }
 
+/**
+ * crypto_ablkcipher_encrypt_batch() - encrypt a batch of requests
+ * @batch: the requests, set up like for crypto_ablkcipher_encrypt(), and
+ *	   the callback for the whole batch
+ *
+ * Encrypt all requests of @batch, which must share one cipher handle.
+ *
+ * Return: -EINPROGRESS if @batch->complete will be called once all requests
+ *	   are done; otherwise all requests completed synchronously, and the
+ *	   return value is 0 or the error of the first request that failed.
+ */
+static inline int crypto_ablkcipher_encrypt_batch(struct crypto_batch *batch)
+{
+	struct crypto_ablkcipher *tfm;
+
+	if (!batch->nreqs)
+		return 0;
+
+	tfm = __crypto_ablkcipher_cast(batch->reqs[0]->tfm);
+	return crypto_ablkcipher_crt(tfm)->encrypt_batch(batch);
+}
+
+/**
+ * crypto_ablkcipher_decrypt_batch() - decrypt a batch of requests
+ * @batch: the requests and the callback for the whole batch
+ *
+ * The counterpart of crypto_ablkcipher_encrypt_batch() for decryption.
+ *
+ * Return: see crypto_ablkcipher_encrypt_batch()
+ */
+static inline int crypto_ablkcipher_decrypt_batch(struct crypto_batch *batch)
+{
+	struct crypto_ablkcipher *tfm;
+
+	if (!batch->nreqs)
+		return 0;
+
+	tfm = __crypto_ablkcipher_cast(batch->reqs[0]->tfm);
+	return crypto_ablkcipher_crt(tfm)->decrypt_batch(batch);
+}
+
 /**
  * DOC: Asynchronous Cipher Request Handle
  *
@@ -349,6 +349,28 @@ struct sk_filter {
 
 #define BPF_PROG_RUN(filter, ctx)  (*filter->bpf_func)(ctx, filter->insnsi)
 
+/* context of BPF_PROG_TYPE_XDP programs: a frame that sits linearly in a
+ * driver RX buffer, before any sk_buff has been built for it
+ */
+struct xdp_buff {
+	void *data;
+	unsigned int len;
+};
+
+static inline u32 bpf_prog_run_xdp(const struct bpf_prog *prog,
+				   struct xdp_buff *xdp)
+{
+	u32 ret;
+
+	rcu_read_lock();
+	ret = BPF_PROG_RUN(prog, (void *)xdp);
+	rcu_read_unlock();
+
+	return ret;
+}
+
+void bpf_warn_invalid_xdp_action(u32 act);
+
 static inline unsigned int bpf_prog_size(unsigned int proglen)
 {
 	return max(sizeof(struct bpf_prog),
@@ -34,6 +34,7 @@
 
 struct device;
 struct device_node;
+struct gen_pool_cache;
 
 /**
  * Allocation callback function type definition
@@ -61,6 +62,10 @@ struct gen_pool {
 	void *data;
 
 	const char *name;
+
+	/* per-CPU caches of small blocks, see gen_pool_enable_cache() */
+	struct gen_pool_cache __percpu *cache;
+	int cache_classes;		/* number of cached size classes */
 };
 
 /*
@@ -101,6 +106,8 @@ extern unsigned long gen_pool_alloc(struct gen_pool *, size_t);
 extern void *gen_pool_dma_alloc(struct gen_pool *pool, size_t size,
 		dma_addr_t *dma);
 extern void gen_pool_free(struct gen_pool *, unsigned long, size_t);
+extern int gen_pool_enable_cache(struct gen_pool *pool, size_t max_size);
+extern void gen_pool_drain_cache(struct gen_pool *pool);
 extern void gen_pool_for_each_chunk(struct gen_pool *,
 	void (*)(struct gen_pool *, struct gen_pool_chunk *, void *), void *);
 extern size_t gen_pool_avail(struct gen_pool *);
@@ -36,6 +36,9 @@ enum hrtimer_mode {
 	HRTIMER_MODE_PINNED = 0x02,	/* Timer is bound to CPU */
 	HRTIMER_MODE_ABS_PINNED = 0x02,
 	HRTIMER_MODE_REL_PINNED = 0x03,
+	HRTIMER_MODE_SLACK = 0x04,	/* Expiry may be coalesced */
+	HRTIMER_MODE_ABS_SLACK = 0x04,
+	HRTIMER_MODE_REL_SLACK = 0x05,
 };
 
 /*
@@ -61,6 +61,10 @@
  *                interrupt handler after suspending interrupts. For system
  *                wakeup devices users need to implement wakeup detection in
  *                their interrupt handlers.
+ * IRQF_THREAD_POLL - After the threaded handler ran, the irq thread busy polls
+ *                for a new interrupt for irqthread_poll_us before it goes back
+ *                to sleep. Interrupts arriving meanwhile only mark the thread
+ *                pending instead of waking it up. For high rate interrupts.
  */
 #define IRQF_SHARED		0x00000080
 #define IRQF_PROBE_SHARED	0x00000100
@@ -74,6 +78,7 @@
 #define IRQF_NO_THREAD		0x00010000
 #define IRQF_EARLY_RESUME	0x00020000
 #define IRQF_COND_SUSPEND	0x00040000
+#define IRQF_THREAD_POLL	0x00080000
 
 #define IRQF_TIMER		(__IRQF_TIMER | IRQF_NO_SUSPEND | IRQF_NO_THREAD)
 
@@ -670,4 +675,11 @@ extern int early_irq_init(void);
 extern int arch_probe_nr_irqs(void);
 extern int arch_early_irq_init(void);
 
+#ifdef CONFIG_IRQ_TIMINGS
+extern void irq_timings_enable(void);
+extern void irq_timings_disable(void);
+extern u64 irq_timings_next_event(u64 now);
+extern u64 irq_timings_last_event(void);
+#endif
+
 #endif
@@ -0,0 +1,91 @@
+/*
+ * Sampling lock contention profiler
+ *
+ * Hooks for the contended paths of the locking primitives. They sit in
+ * the lock entry points, so that the ip they report is the caller of
+ * spin_lock(), down_read() or mutex_lock(), as for lockdep. When the
+ * profiler is off the hooks cost a single patched out branch; when it is
+ * on, one in sample_rate contended acquisitions per CPU is timed and
+ * reported, see kernel/locking/lock_contention.c.
+ */
+#ifndef __LINUX_LOCK_CONTENTION_H
+#define __LINUX_LOCK_CONTENTION_H
+
+#include <linux/types.h>
+
+enum lock_contention_type {
+	LOCK_CONTENTION_SPIN,
+	LOCK_CONTENTION_MUTEX,
+	LOCK_CONTENTION_RWSEM_READ,
+	LOCK_CONTENTION_RWSEM_WRITE,
+	LOCK_CONTENTION_NR_TYPES,
+};
+
+#ifdef CONFIG_LOCK_CONTENTION_PROFILE
+
+#include <linux/jump_label.h>
+
+extern struct static_key lock_contention_enabled;
+
+extern u64 __lock_contention_begin(void *lock, unsigned long ip, int type);
+extern void __lock_contention_end(void *lock, unsigned long ip, int type,
+				  u64 start, int ret);
+extern unsigned int lock_contention_set_sample_rate(unsigned int rate);
+
+/*
+ * Returns the start timestamp of a sampled wait, or 0 if this wait is
+ * not being profiled. Pass the result back to lock_contention_end().
+ */
+static __always_inline u64
+lock_contention_begin(void *lock, unsigned long ip, int type)
+{
+	if (static_key_false(&lock_contention_enabled))
+		return __lock_contention_begin(lock, ip, type);
+	return 0;
+}
+
+static __always_inline void
+lock_contention_end(void *lock, unsigned long ip, int type, u64 start,
+		    int ret)
+{
+	if (unlikely(start))
+		__lock_contention_end(lock, ip, type, start, ret);
+}
+
+/*
+ * Take @_lock with @acquire, its usual slow path. While the profiler is
+ * on, a @try of the lock comes first: if it succeeds the lock is held and
+ * there is nothing left to do, otherwise @acquire is timed. Must be
+ * expanded in the lock entry point itself, for _RET_IP_ to be the callsite.
+ */
+#define LOCK_CONTENTION_PROFILED(_lock, try, type, acquire)		\
+do {									\
+	if (!static_key_false(&lock_contention_enabled)) {		\
+		acquire;						\
+	} else if (!try(_lock)) {					\
+		u64 __lc_start;						\
+									\
+		__lc_start = __lock_contention_begin(_lock, _RET_IP_, type); \
+		acquire;						\
+		lock_contention_end(_lock, _RET_IP_, type, __lc_start, 0); \
+	}								\
+} while (0)
+
+#else /* !CONFIG_LOCK_CONTENTION_PROFILE */
+
+static inline u64
+lock_contention_begin(void *lock, unsigned long ip, int type)
+{
+	return 0;
+}
+
+static inline void
+lock_contention_end(void *lock, unsigned long ip, int type, u64 start,
+		    int ret) { }
+
+#define LOCK_CONTENTION_PROFILED(_lock, try, type, acquire)		\
+	acquire
+
+#endif /* CONFIG_LOCK_CONTENTION_PROFILE */
+
+#endif /* __LINUX_LOCK_CONTENTION_H */
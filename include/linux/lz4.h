@@ -12,6 +12,9 @@
 #define LZ4_MEM_COMPRESS	(4096 * sizeof(unsigned char *))
 #define LZ4HC_MEM_COMPRESS	(65538 * sizeof(unsigned char *))
 
+#define LZ4_ACCELERATION_DEFAULT	1
+#define LZ4_ACCELERATION_MAX		65537
+
 /*
  * lz4_compressbound()
  * Provides the maximum size that LZ4 may output in a "worst case" scenario
@@ -39,6 +42,18 @@ static inline size_t lz4_compressbound(size_t isize)
 int lz4_compress(const unsigned char *src, size_t src_len,
 		unsigned char *dst, size_t *dst_len, void *wrkmem);
 
+/*
+ * lz4_compress_fast()
+ *	Same as lz4_compress(), but with a tunable speed/ratio trade off.
+ *	acceleration : LZ4_ACCELERATION_DEFAULT gives the same output as
+ *		lz4_compress(); each increment makes the match search skip
+ *		ahead faster, trading compression ratio for speed.
+ *		Values are clamped to LZ4_ACCELERATION_MAX.
+ */
+int lz4_compress_fast(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem,
+		int acceleration);
+
  /*
   * lz4hc_compress()
   *	 src	 : source address of the original data
@@ -80,6 +80,13 @@
   /* class 7 */
 #define MMC_LOCK_UNLOCK          42   /* adtc                    R1b */
 
+  /* class 11 */
+#define MMC_QUE_TASK_PARAMS      44   /* ac   [20:16] task id    R1  */
+#define MMC_QUE_TASK_ADDR        45   /* ac   [31:0] data addr   R1  */
+#define MMC_EXECUTE_READ_TASK    46   /* adtc [20:16] task id    R1  */
+#define MMC_EXECUTE_WRITE_TASK   47   /* adtc [20:16] task id    R1  */
+#define MMC_CMDQ_TASK_MGMT       48   /* ac   [20:16] task id    R1b */
+
   /* class 8 */
 #define MMC_APP_CMD              55   /* ac   [31:16] RCA        R1  */
 #define MMC_GEN_CMD              56   /* adtc [0] RD/WR          R1  */
@@ -272,6 +279,7 @@ struct _mmc_csd {
  * EXT_CSD fields
  */
 
+#define EXT_CSD_CMDQ_MODE_EN		15	/* R/W */
 #define EXT_CSD_FLUSH_CACHE		32      /* W */
 #define EXT_CSD_CACHE_CTRL		33      /* R/W */
 #define EXT_CSD_POWER_OFF_NOTIFICATION	34	/* R/W */
@@ -330,6 +338,8 @@ struct _mmc_csd {
 #define EXT_CSD_CACHE_SIZE		249	/* RO, 4 bytes */
 #define EXT_CSD_PWR_CL_DDR_200_360	253	/* RO */
 #define EXT_CSD_FIRMWARE_VERSION	254	/* RO, 8 bytes */
+#define EXT_CSD_CMDQ_DEPTH		307	/* RO */
+#define EXT_CSD_CMDQ_SUPPORT		308	/* RO */
 #define EXT_CSD_SUPPORTED_MODE		493	/* RO */
 #define EXT_CSD_TAG_UNIT_SIZE		498	/* RO */
 #define EXT_CSD_DATA_TAG_SUPPORT	499	/* RO */
@@ -413,6 +423,30 @@ struct _mmc_csd {
 
 #define EXT_CSD_PACKED_EVENT_EN	BIT(3)
 
+/*
+ * Command queuing
+ */
+#define EXT_CSD_CMDQ_MODE_ENABLED	BIT(0)
+#define EXT_CSD_CMDQ_DEPTH_MASK		0x1F
+#define EXT_CSD_CMDQ_SUPPORTED		BIT(0)
+
+/*
+ * CMD44 QUEUED_TASK_PARAMS argument, the task id is at bit 16 for CMD44,
+ * CMD46, CMD47 and CMD48
+ */
+#define MMC_CMDQ_REL_WRITE		BIT(31)
+#define MMC_CMDQ_DATA_DIR_READ		BIT(30)
+#define MMC_CMDQ_PRIORITY		BIT(23)
+#define MMC_CMDQ_TASK_ID_SHIFT		16
+#define MMC_CMDQ_BLOCKS_MASK		0xFFFF
+
+/* CMD13 argument bit selecting the queue status register */
+#define MMC_CMDQ_SEND_QSR		BIT(15)
+
+/* CMD48 CMDQ_TASK_MGMT TM op-codes */
+#define MMC_CMDQ_DISCARD_QUEUE		1
+#define MMC_CMDQ_DISCARD_TASK		2
+
 /*
  * EXCEPTION_EVENT_STATUS field
  */
@@ -15,6 +15,7 @@
 #include <linux/device.h>
 #include <linux/mod_devicetable.h>
 
+#include <linux/mmc/host.h>
 #include <linux/mmc/pm.h>
 
 struct mmc_card;
@@ -108,6 +109,17 @@ struct sdio_driver {
 	.class = (dev_class), \
 	.vendor = SDIO_ANY_ID, .device = SDIO_ANY_ID
 
+/*
+ * SDIO IO_RW_EXTENDED request that can be set up ahead of time and
+ * started without waiting for it, see sdio_start_async_req()
+ */
+struct sdio_async_req {
+	struct mmc_async_req	areq;
+	struct mmc_request	mrq;
+	struct mmc_command	cmd;
+	struct mmc_data		data;
+};
+
 extern int sdio_register_driver(struct sdio_driver *);
 extern void sdio_unregister_driver(struct sdio_driver *);
 
@@ -151,6 +163,13 @@ extern int sdio_memcpy_toio(struct sdio_func *func, unsigned int addr,
 extern int sdio_writesb(struct sdio_func *func, unsigned int addr,
 	void *src, int count);
 
+extern int sdio_prep_async_req(struct sdio_func *func,
+	struct sdio_async_req *req, int write, unsigned int addr,
+	int incr_addr, struct scatterlist *sg, unsigned int sg_len,
+	unsigned int blocks);
+extern struct sdio_async_req *sdio_start_async_req(struct sdio_func *func,
+	struct sdio_async_req *req, int *err_ret);
+
 extern unsigned char sdio_f0_readb(struct sdio_func *func,
 	unsigned int addr, int *err_ret);
 extern void sdio_f0_writeb(struct sdio_func *func, unsigned char b,
@@ -0,0 +1,119 @@
+/*
+ * Bounded lockless multi-producer/multi-consumer pointer ring
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Each slot carries a sequence number that tells producers and consumers
+ * which lap of the ring it belongs to, so neither side ever waits for
+ * another CPU to finish its copy: a producer or consumer that gets
+ * preempted or interrupted half way only makes its own slots look busy
+ * for a moment.  This makes the ring usable from any context, including
+ * several hard interrupt handlers and threads at once, without a lock.
+ *
+ * Unlike kfifo, the ring only stores pointers and NULL can't be queued.
+ */
+
+#ifndef _LINUX_MPMC_RING_H
+#define _LINUX_MPMC_RING_H
+
+#include <linux/cache.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/types.h>
+
+struct mpmc_ring_slot {
+	unsigned long		seq;
+	void			*ptr;
+};
+
+/**
+ * struct mpmc_ring - bounded lockless MPMC pointer ring
+ * @prod:	next position to be claimed by a producer
+ * @cons:	next position to be claimed by a consumer
+ * @mask:	number of slots minus one, the size is a power of two
+ * @slots:	the slot array
+ *
+ * @prod and @cons live in cache lines of their own so that producers and
+ * consumers don't bounce each other's line.
+ */
+struct mpmc_ring {
+	unsigned long		prod ____cacheline_aligned_in_smp;
+	unsigned long		cons ____cacheline_aligned_in_smp;
+	unsigned int		mask ____cacheline_aligned_in_smp;
+	struct mpmc_ring_slot	*slots;
+};
+
+int mpmc_ring_init(struct mpmc_ring *r, unsigned int size, gfp_t gfp);
+void mpmc_ring_cleanup(struct mpmc_ring *r);
+
+unsigned int mpmc_ring_produce_bulk(struct mpmc_ring *r, void **ptrs,
+				    unsigned int n);
+unsigned int mpmc_ring_consume_bulk(struct mpmc_ring *r, void **ptrs,
+				    unsigned int n);
+
+/**
+ * mpmc_ring_size - number of slots in the ring
+ * @r: the ring
+ */
+static inline unsigned int mpmc_ring_size(const struct mpmc_ring *r)
+{
+	return r->mask + 1;
+}
+
+/**
+ * mpmc_ring_count - approximate number of queued entries
+ * @r: the ring
+ *
+ * The result is only a snapshot, other CPUs may produce or consume at
+ * the same time.  It includes entries that are still being copied.
+ */
+static inline unsigned int mpmc_ring_count(const struct mpmc_ring *r)
+{
+	unsigned long cons = READ_ONCE(r->cons);
+	unsigned long prod = READ_ONCE(r->prod);
+	long count = prod - cons;
+
+	if (count < 0)
+		return 0;
+	return min_t(unsigned long, count, r->mask + 1);
+}
+
+/**
+ * mpmc_ring_empty - check whether the ring is empty
+ * @r: the ring
+ *
+ * Like mpmc_ring_count(), this is only a hint.
+ */
+static inline bool mpmc_ring_empty(const struct mpmc_ring *r)
+{
+	return !mpmc_ring_count(r);
+}
+
+/**
+ * mpmc_ring_produce - add one entry to the ring
+ * @r:		the ring
+ * @ptr:	the entry, must not be NULL
+ *
+ * Returns 0 on success or -ENOSPC if the ring is full.
+ */
+static inline int mpmc_ring_produce(struct mpmc_ring *r, void *ptr)
+{
+	return mpmc_ring_produce_bulk(r, &ptr, 1) ? 0 : -ENOSPC;
+}
+
+/**
+ * mpmc_ring_consume - remove the oldest entry from the ring
+ * @r:		the ring
+ *
+ * Returns the entry, or NULL if the ring is empty.
+ */
+static inline void *mpmc_ring_consume(struct mpmc_ring *r)
+{
+	void *ptr;
+
+	return mpmc_ring_consume_bulk(r, &ptr, 1) ? ptr : NULL;
+}
+
+#endif /* _LINUX_MPMC_RING_H */
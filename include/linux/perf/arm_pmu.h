@@ -37,6 +37,15 @@ struct arm_pmu_platdata {
  */
 #define ARMPMU_MAX_HWEVENTS		32
 
+/*
+ * attr.config1 flag asking for the counter to be readable from userspace.
+ * Allowed once root has written 1 to the PMU's "rdpmc" sysfs file.  While
+ * such an event is scheduled in, perf_event_mmap_page::index - 1 is the
+ * counter index (for ARMv7, 0 is PMCCNTR and n is PMXEVCNTR with PMSELR
+ * set to n - 1) and the count is ::offset plus the sign extended counter.
+ */
+#define ARMPMU_EVT_USER_ACCESS		BIT(0)
+
 #define HW_OP_UNSUPPORTED		0xFFFF
 #define C(_x)				PERF_COUNT_HW_CACHE_##_x
 #define CACHE_OP_UNSUPPORTED		0xFFFF
@@ -75,6 +84,9 @@ struct pmu_hw_events {
 	 * already have to allocate this struct per cpu.
 	 */
 	struct arm_pmu		*percpu_pmu;
+
+	/* Number of active events that userspace may read directly. */
+	int			user_access_events;
 };
 
 struct arm_pmu {
@@ -100,6 +112,8 @@ struct arm_pmu {
 	int		(*request_irq)(struct arm_pmu *, irq_handler_t handler);
 	void		(*free_irq)(struct arm_pmu *);
 	int		(*map_event)(struct perf_event *event);
+	void		(*set_user_access)(bool enable);
+	bool		user_access;
 	int		num_events;
 	atomic_t	active_events;
 	struct mutex	reserve_mutex;
@@ -131,6 +131,7 @@ void pipe_wait(struct pipe_inode_info *pipe);
 
 struct pipe_inode_info *alloc_pipe_info(void);
 void free_pipe_info(struct pipe_inode_info *);
+long pipe_set_size(struct pipe_inode_info *, unsigned long nr_pages);
 
 /* Generic pipe buffer ops functions */
 void generic_pipe_buf_get(struct pipe_inode_info *, struct pipe_buffer *);
@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) 2015 Fuzhou Rockchip Electronics Co., Ltd
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __CPUIDLE_ROCKCHIP_H
+#define __CPUIDLE_ROCKCHIP_H
+
+struct cpuidle_rockchip_data {
+	int (*cpu0_enter_idle)(void);
+	void (*cpu0_exit_idle)(void);
+	int (*cpu_powerdown)(void);
+};
+
+#endif
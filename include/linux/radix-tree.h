@@ -37,6 +37,11 @@
  * time callers need worry about this is when doing a lookup_slot under
  * RCU.
  *
+ * Pointers to child nodes in the slots of a node are tagged the same way,
+ * and so are the sibling entries filling the extra slots covered by a
+ * multi-order entry.  Neither is ever returned by the lookup and iteration
+ * functions.
+ *
  * Indirect pointer in fact is also used to tag the last pointer of a node
  * when it is shrunk, before we rcu free the node. See shrink code for
  * details.
@@ -150,11 +155,12 @@ do {									\
  * radix_tree_tag_get
  * radix_tree_gang_lookup
  * radix_tree_gang_lookup_slot
+ * radix_tree_gang_lookup_get
  * radix_tree_gang_lookup_tag
  * radix_tree_gang_lookup_tag_slot
  * radix_tree_tagged
  *
- * The first 7 functions are able to be called locklessly, using RCU. The
+ * The first 8 functions are able to be called locklessly, using RCU. The
  * caller must ensure calls to these functions are made within rcu_read_lock()
  * regions. Other readers (lock-free or otherwise) and modifications may be
  * running concurrently.
@@ -261,8 +267,15 @@ static inline void radix_tree_replace_slot(void **pslot, void *item)
 }
 
 int __radix_tree_create(struct radix_tree_root *root, unsigned long index,
-			struct radix_tree_node **nodep, void ***slotp);
-int radix_tree_insert(struct radix_tree_root *, unsigned long, void *);
+			unsigned int order, struct radix_tree_node **nodep,
+			void ***slotp);
+int __radix_tree_insert(struct radix_tree_root *, unsigned long index,
+			unsigned int order, void *);
+static inline int radix_tree_insert(struct radix_tree_root *root,
+			unsigned long index, void *entry)
+{
+	return __radix_tree_insert(root, index, 0, entry);
+}
 void *__radix_tree_lookup(struct radix_tree_root *root, unsigned long index,
 			  struct radix_tree_node **nodep, void ***slotp);
 void *radix_tree_lookup(struct radix_tree_root *, unsigned long);
@@ -277,6 +290,10 @@ radix_tree_gang_lookup(struct radix_tree_root *root, void **results,
 unsigned int radix_tree_gang_lookup_slot(struct radix_tree_root *root,
 			void ***results, unsigned long *indices,
 			unsigned long first_index, unsigned int max_items);
+unsigned int radix_tree_gang_lookup_get(struct radix_tree_root *root,
+			void **results, unsigned long *indices,
+			unsigned long first_index, unsigned int max_items,
+			bool (*get)(void *item), void (*put)(void *item));
 int radix_tree_preload(gfp_t gfp_mask);
 int radix_tree_maybe_preload(gfp_t gfp_mask);
 void radix_tree_init(void);
@@ -312,18 +329,21 @@ static inline void radix_tree_preload_end(void)
  * @index:	index of current slot
  * @next_index:	next-to-last index for this chunk
  * @tags:	bit-mask for tag-iterating
+ * @shift:	log2 of the number of indices each slot of the chunk covers
  *
  * This radix tree iterator works in terms of "chunks" of slots.  A chunk is a
  * subinterval of slots contained within one radix tree leaf node.  It is
  * described by a pointer to its first slot and a struct radix_tree_iter
  * which holds the chunk's position in the tree and its size.  For tagged
  * iteration radix_tree_iter also holds the slots' bit-mask for one chosen
- * radix tree tag.
+ * radix tree tag.  A multi-order entry is returned as a chunk of its own,
+ * consisting of the single slot it is stored in.
  */
 struct radix_tree_iter {
 	unsigned long	index;
 	unsigned long	next_index;
 	unsigned long	tags;
+	unsigned int	shift;
 };
 
 #define RADIX_TREE_ITER_TAG_MASK	0x00FF	/* tag index in lower byte */
@@ -378,7 +398,7 @@ void **radix_tree_next_chunk(struct radix_tree_root *root,
 static __always_inline unsigned
 radix_tree_chunk_size(struct radix_tree_iter *iter)
 {
-	return iter->next_index - iter->index;
+	return (iter->next_index - iter->index) >> iter->shift;
 }
 
 /**
@@ -414,8 +434,16 @@ radix_tree_next_slot(void **slot, struct radix_tree_iter *iter, unsigned flags)
 		while (size--) {
 			slot++;
 			iter->index++;
-			if (likely(*slot))
-				return slot;
+			if (likely(*slot)) {
+				if (likely(!radix_tree_is_indirect_ptr(*slot)))
+					return slot;
+				/*
+				 * A sibling entry, or a retry hint: let
+				 * radix_tree_next_chunk() walk the tree again.
+				 */
+				iter->next_index = iter->index;
+				break;
+			}
 			if (flags & RADIX_TREE_ITER_CONTIG) {
 				/* forbid switching to the next chunk */
 				iter->next_index = 0;
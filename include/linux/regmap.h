@@ -182,7 +182,9 @@ typedef void (*regmap_unlock)(void *);
  *		    for device that does not support bulk read and write.
  * @can_multi_write: If set, the device supports the multi write mode of bulk
  *                   write operations, if clear multi write requests will be
- *                   split into individual write operations
+ *                   split into individual write operations. On buses that
+ *                   provide multi_write the register/value pairs are sent
+ *                   as separate messages of a single bus transaction.
  *
  * @cache_type: The actual cache type.
  * @reg_defaults_raw: Power on reset values for registers (for use with
@@ -282,6 +284,8 @@ struct regmap_async;
 
 typedef int (*regmap_hw_write)(void *context, const void *data,
 			       size_t count);
+typedef int (*regmap_hw_multi_write)(void *context, const void *data,
+				     size_t pair_size, size_t count);
 typedef int (*regmap_hw_gather_write)(void *context,
 				      const void *reg, size_t reg_len,
 				      const void *val, size_t val_len);
@@ -307,6 +311,9 @@ typedef void (*regmap_hw_free_context)(void *context);
  *	     functions are used (see fields lock/unlock of
  *	     struct regmap_config).
  * @write: Write operation.
+ * @multi_write: Write @count formatted register/value pairs of @pair_size
+ *               bytes each to individual registers in one bus transaction,
+ *               optional.
  * @gather_write: Write operation with split register/value, return -ENOTSUPP
  *                if not implemented  on a given device.
  * @async_write: Write operation which completes asynchronously, optional and
@@ -332,6 +339,7 @@ typedef void (*regmap_hw_free_context)(void *context);
 struct regmap_bus {
 	bool fast_io;
 	regmap_hw_write write;
+	regmap_hw_multi_write multi_write;
 	regmap_hw_gather_write gather_write;
 	regmap_hw_async_write async_write;
 	regmap_hw_reg_write reg_write;
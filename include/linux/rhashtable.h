@@ -62,7 +62,15 @@ struct rhash_head {
  * @walkers: List of active walkers
  * @rcu: RCU structure for freeing the table
  * @future_tbl: Table under construction during rehashing
- * @buckets: size * hash buckets
+ * @nest: log2 of the buckets per segment of a nested table, 0 if flat
+ * @segs: segments of a nested table, each a page of buckets or NULL
+ * @buckets: size * hash buckets, or the segment pointers if nested
+ *
+ * If the buckets cannot be allocated in one piece where sleeping is not
+ * allowed, the table is made of page sized segments instead, each one
+ * allocated on the first insertion into it; the deferred worker replaces
+ * the table by a flat one as soon as it can.  Use rht_bucket() to get at
+ * a bucket and rht_bucket_insert() to get one to insert into.
  */
 struct bucket_table {
 	unsigned int		size;
@@ -75,6 +83,9 @@ struct bucket_table {
 
 	struct bucket_table __rcu *future_tbl;
 
+	unsigned int		nest;
+	struct rhash_head __rcu	***segs;
+
 	struct rhash_head __rcu	*buckets[] ____cacheline_aligned_in_smp;
 };
 
@@ -320,6 +331,32 @@ static inline spinlock_t *rht_bucket_lock(const struct bucket_table *tbl,
 	return &tbl->locks[hash & tbl->locks_mask];
 }
 
+struct rhash_head __rcu **rht_bucket_nested(const struct bucket_table *tbl,
+					    unsigned int hash);
+struct rhash_head __rcu **rht_bucket_nested_insert(struct rhashtable *ht,
+						   struct bucket_table *tbl,
+						   unsigned int hash);
+
+/* The bucket may be a shared empty one, which must not be written to. */
+static inline struct rhash_head __rcu **rht_bucket(
+	const struct bucket_table *tbl, unsigned int hash)
+{
+	if (unlikely(tbl->nest))
+		return rht_bucket_nested(tbl, hash);
+
+	return (struct rhash_head __rcu **)&tbl->buckets[hash];
+}
+
+/* Returns NULL if the segment holding the bucket cannot be allocated. */
+static inline struct rhash_head __rcu **rht_bucket_insert(
+	struct rhashtable *ht, struct bucket_table *tbl, unsigned int hash)
+{
+	if (unlikely(tbl->nest))
+		return rht_bucket_nested_insert(ht, tbl, hash);
+
+	return &tbl->buckets[hash];
+}
+
 #ifdef CONFIG_PROVE_LOCKING
 int lockdep_rht_mutex_is_held(struct rhashtable *ht);
 int lockdep_rht_bucket_is_held(const struct bucket_table *tbl, u32 hash);
@@ -343,6 +380,8 @@ int rhashtable_insert_slow(struct rhashtable *ht, const void *key,
 			   struct rhash_head *obj,
 			   struct bucket_table *old_tbl);
 int rhashtable_insert_rehash(struct rhashtable *ht);
+int rhashtable_insert_bulk(struct rhashtable *ht, struct rhash_head **objs,
+			   unsigned int nr);
 
 int rhashtable_walk_init(struct rhashtable *ht, struct rhashtable_iter *iter);
 void rhashtable_walk_exit(struct rhashtable_iter *iter);
@@ -389,7 +428,7 @@ void rhashtable_destroy(struct rhashtable *ht);
  * @hash:	the hash value / bucket index
  */
 #define rht_for_each(pos, tbl, hash) \
-	rht_for_each_continue(pos, (tbl)->buckets[hash], tbl, hash)
+	rht_for_each_continue(pos, *rht_bucket(tbl, hash), tbl, hash)
 
 /**
  * rht_for_each_entry_continue - continue iterating over hash chain
@@ -414,7 +453,7 @@ void rhashtable_destroy(struct rhashtable *ht);
  * @member:	name of the &struct rhash_head within the hashable struct.
  */
 #define rht_for_each_entry(tpos, pos, tbl, hash, member)		\
-	rht_for_each_entry_continue(tpos, pos, (tbl)->buckets[hash],	\
+	rht_for_each_entry_continue(tpos, pos, *rht_bucket(tbl, hash),	\
 				    tbl, hash, member)
 
 /**
@@ -430,7 +469,7 @@ void rhashtable_destroy(struct rhashtable *ht);
  * remove the loop cursor from the list.
  */
 #define rht_for_each_entry_safe(tpos, pos, next, tbl, hash, member)	    \
-	for (pos = rht_dereference_bucket((tbl)->buckets[hash], tbl, hash), \
+	for (pos = rht_dereference_bucket(*rht_bucket(tbl, hash), tbl, hash), \
 	     next = !rht_is_a_nulls(pos) ?				    \
 		       rht_dereference_bucket(pos->next, tbl, hash) : NULL; \
 	     (!rht_is_a_nulls(pos)) && rht_entry(tpos, pos, member);	    \
@@ -466,7 +505,7 @@ void rhashtable_destroy(struct rhashtable *ht);
  * traversal is guarded by rcu_read_lock().
  */
 #define rht_for_each_rcu(pos, tbl, hash)				\
-	rht_for_each_rcu_continue(pos, (tbl)->buckets[hash], tbl, hash)
+	rht_for_each_rcu_continue(pos, *rht_bucket(tbl, hash), tbl, hash)
 
 /**
  * rht_for_each_entry_rcu_continue - continue iterating over rcu hash chain
@@ -500,7 +539,7 @@ void rhashtable_destroy(struct rhashtable *ht);
  * traversal is guarded by rcu_read_lock().
  */
 #define rht_for_each_entry_rcu(tpos, pos, tbl, hash, member)		\
-	rht_for_each_entry_rcu_continue(tpos, pos, (tbl)->buckets[hash],\
+	rht_for_each_entry_rcu_continue(tpos, pos, *rht_bucket(tbl, hash),\
 					tbl, hash, member)
 
 static inline int rhashtable_compare(struct rhashtable_compare_arg *arg,
@@ -570,6 +609,7 @@ static inline int __rhashtable_insert_fast(
 		.key = key,
 	};
 	struct bucket_table *tbl, *new_tbl;
+	struct rhash_head __rcu **bkt;
 	struct rhash_head *head;
 	spinlock_t *lock;
 	unsigned int elasticity;
@@ -631,13 +671,18 @@ slow_path:
 			goto slow_path;
 	}
 
+	err = -ENOMEM;
+	bkt = rht_bucket_insert(ht, tbl, hash);
+	if (unlikely(!bkt))
+		goto out;
+
 	err = 0;
 
-	head = rht_dereference_bucket(tbl->buckets[hash], tbl, hash);
+	head = rht_dereference_bucket(*bkt, tbl, hash);
 
 	RCU_INIT_POINTER(obj->next, head);
 
-	rcu_assign_pointer(tbl->buckets[hash], obj);
+	rcu_assign_pointer(*bkt, obj);
 
 	atomic_inc(&ht->nelems);
 	if (rht_grow_above_75(ht, tbl))
@@ -753,7 +798,7 @@ static inline int __rhashtable_remove_fast(
 
 	spin_lock_bh(lock);
 
-	pprev = &tbl->buckets[hash];
+	pprev = rht_bucket(tbl, hash);
 	rht_for_each(he, tbl, hash) {
 		if (he != obj) {
 			pprev = &he->next;
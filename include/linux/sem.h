@@ -20,7 +20,6 @@ struct sem_array {
 						/* that do not alter semvals */
 	struct list_head	list_id;	/* undo requests on this array */
 	int			sem_nsems;	/* no. of semaphores in array */
-	int			complex_count;	/* pending complex operations */
 };
 
 #ifdef CONFIG_SYSVIPC
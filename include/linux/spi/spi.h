@@ -698,6 +698,10 @@ struct spi_transfer {
  * @spi: SPI device to which the transaction is queued
  * @is_dma_mapped: if true, the caller provided both dma and cpu virtual
  *	addresses for each transfer buffer
+ * @optimized: the message was validated, and DMA mapped where the master
+ *	allows it, once by spi_optimize_message()
+ * @caller_pumps: spi_sync() runs the message queue itself once this
+ *	message completes, so the message pump thread needn't be woken
  * @complete: called to report transaction completions
  * @context: the argument to complete() when it's called
  * @frame_length: the total number of bytes in the message
@@ -727,6 +731,8 @@ struct spi_message {
 	struct spi_device	*spi;
 
 	unsigned		is_dma_mapped:1;
+	unsigned		optimized:1;
+	unsigned		caller_pumps:1;
 
 	/* REVISIT:  we might want a flag affecting the behavior of the
 	 * last transfer ... allowing things like "read 16 bit length L"
@@ -832,6 +838,9 @@ extern int spi_async_locked(struct spi_device *spi,
  */
 
 extern int spi_sync(struct spi_device *spi, struct spi_message *message);
+extern int spi_optimize_message(struct spi_device *spi,
+				struct spi_message *message);
+extern void spi_unoptimize_message(struct spi_message *message);
 extern int spi_sync_locked(struct spi_device *spi, struct spi_message *message);
 extern int spi_bus_lock(struct spi_master *master);
 extern int spi_bus_unlock(struct spi_master *master);
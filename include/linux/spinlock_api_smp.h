@@ -116,9 +116,11 @@ static inline unsigned long __raw_spin_lock_irqsave(raw_spinlock_t *lock)
 	 * that interrupts are not re-enabled during lock-acquire:
 	 */
 #ifdef CONFIG_LOCKDEP
-	LOCK_CONTENDED(lock, do_raw_spin_trylock, do_raw_spin_lock);
+	LOCK_CONTENTION_PROFILED(lock, do_raw_spin_trylock, LOCK_CONTENTION_SPIN,
+		LOCK_CONTENDED(lock, do_raw_spin_trylock, do_raw_spin_lock));
 #else
-	do_raw_spin_lock_flags(lock, &flags);
+	LOCK_CONTENTION_PROFILED(lock, do_raw_spin_trylock, LOCK_CONTENTION_SPIN,
+		do_raw_spin_lock_flags(lock, &flags));
 #endif
 	return flags;
 }
@@ -128,21 +130,24 @@ static inline void __raw_spin_lock_irq(raw_spinlock_t *lock)
 	local_irq_disable();
 	preempt_disable();
 	spin_acquire(&lock->dep_map, 0, 0, _RET_IP_);
-	LOCK_CONTENDED(lock, do_raw_spin_trylock, do_raw_spin_lock);
+	LOCK_CONTENTION_PROFILED(lock, do_raw_spin_trylock, LOCK_CONTENTION_SPIN,
+		LOCK_CONTENDED(lock, do_raw_spin_trylock, do_raw_spin_lock));
 }
 
 static inline void __raw_spin_lock_bh(raw_spinlock_t *lock)
 {
 	__local_bh_disable_ip(_RET_IP_, SOFTIRQ_LOCK_OFFSET);
 	spin_acquire(&lock->dep_map, 0, 0, _RET_IP_);
-	LOCK_CONTENDED(lock, do_raw_spin_trylock, do_raw_spin_lock);
+	LOCK_CONTENTION_PROFILED(lock, do_raw_spin_trylock, LOCK_CONTENTION_SPIN,
+		LOCK_CONTENDED(lock, do_raw_spin_trylock, do_raw_spin_lock));
 }
 
 static inline void __raw_spin_lock(raw_spinlock_t *lock)
 {
 	preempt_disable();
 	spin_acquire(&lock->dep_map, 0, 0, _RET_IP_);
-	LOCK_CONTENDED(lock, do_raw_spin_trylock, do_raw_spin_lock);
+	LOCK_CONTENTION_PROFILED(lock, do_raw_spin_trylock, LOCK_CONTENTION_SPIN,
+		LOCK_CONTENDED(lock, do_raw_spin_trylock, do_raw_spin_lock));
 }
 
 #endif /* !CONFIG_GENERIC_LOCKBREAK || CONFIG_DEBUG_LOCK_ALLOC */
@@ -156,6 +156,17 @@ extern void tick_nohz_full_kick(void);
 extern void tick_nohz_full_kick_cpu(int cpu);
 extern void tick_nohz_full_kick_all(void);
 extern void __tick_nohz_task_switch(void);
+extern void __tick_nohz_full_interrupt(const char *source, int nr);
+
+/*
+ * Report an interruption of a full dynticks CPU through the
+ * nohz_full_interrupt tracepoint.
+ */
+static inline void tick_nohz_full_interrupt(const char *source, int nr)
+{
+	if (tick_nohz_full_cpu(smp_processor_id()))
+		__tick_nohz_full_interrupt(source, nr);
+}
 #else
 static inline int housekeeping_any_cpu(void)
 {
@@ -168,6 +179,7 @@ static inline void tick_nohz_full_kick_cpu(int cpu) { }
 static inline void tick_nohz_full_kick(void) { }
 static inline void tick_nohz_full_kick_all(void) { }
 static inline void __tick_nohz_task_switch(void) { }
+static inline void tick_nohz_full_interrupt(const char *source, int nr) { }
 #endif
 
 static inline const struct cpumask *housekeeping_cpumask(void)
@@ -62,7 +62,7 @@ struct usbnet {
 	unsigned		interrupt_count;
 	struct mutex		interrupt_mutex;
 	struct usb_anchor	deferred;
-	struct tasklet_struct	bh;
+	struct napi_struct	napi;
 
 	struct work_struct	kevent;
 	unsigned long		flags;
@@ -244,6 +244,36 @@ usbnet_set_skb_tx_stats(struct sk_buff *skb,
 	entry->length = bytes_delta;
 }
 
+/* Devices that batch frames into one bulk-in transfer can receive into
+ * page backed buffers and use this instead of copying each frame into
+ * an skb of its own: only the first USBNET_RX_COPYBREAK bytes, enough
+ * for the headers, are copied and the rest is attached as a fragment
+ * of @page, taking a reference on it.  @truesize is the frame's share
+ * of the buffer.  A buffer may be reused once page_count() shows that
+ * the stack has let go of all its frames.  NAPI context only.
+ */
+#define USBNET_RX_COPYBREAK	128
+
+static inline struct sk_buff *
+usbnet_rx_frag_skb(struct napi_struct *napi, struct page *page,
+		   unsigned int offset, unsigned int len, unsigned int truesize)
+{
+	unsigned int hlen = min_t(unsigned int, len, USBNET_RX_COPYBREAK);
+	struct sk_buff *skb;
+
+	skb = napi_alloc_skb(napi, hlen);
+	if (!skb)
+		return NULL;
+
+	memcpy(skb_put(skb, hlen), page_address(page) + offset, hlen);
+	if (len > hlen) {
+		get_page(page);
+		skb_add_rx_frag(skb, 0, page, offset + hlen, len - hlen,
+				truesize);
+	}
+	return skb;
+}
+
 extern int usbnet_open(struct net_device *net);
 extern int usbnet_stop(struct net_device *net);
 extern netdev_tx_t usbnet_start_xmit(struct sk_buff *skb,
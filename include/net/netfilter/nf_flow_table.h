@@ -0,0 +1,116 @@
+#ifndef _NF_FLOW_TABLE_H
+#define _NF_FLOW_TABLE_H
+
+#include <linux/in.h>
+#include <linux/in6.h>
+#include <linux/netdevice.h>
+#include <linux/netfilter.h>
+#include <linux/rhashtable.h>
+#include <linux/rcupdate.h>
+#include <net/dst.h>
+
+struct nf_conn;
+
+/**
+ * struct nf_flowtable - software flow offload table
+ * @rhashtable:	both directions of every offloaded flow, by tuple
+ * @gc_work:	periodically releases flows that expired or were torn down
+ */
+struct nf_flowtable {
+	struct rhashtable		rhashtable;
+	struct delayed_work		gc_work;
+};
+
+enum flow_offload_tuple_dir {
+	FLOW_OFFLOAD_DIR_ORIGINAL = 0,
+	FLOW_OFFLOAD_DIR_REPLY,
+	FLOW_OFFLOAD_DIR_MAX,
+};
+
+/* everything up to @dir is the hash key, keep it free of padding */
+struct flow_offload_tuple {
+	union {
+		struct in_addr		src_v4;
+		struct in6_addr		src_v6;
+	};
+	union {
+		struct in_addr		dst_v4;
+		struct in6_addr		dst_v6;
+	};
+	struct {
+		__be16			src_port;
+		__be16			dst_port;
+	};
+
+	int				iifidx;
+
+	u8				l3proto;
+	u8				l4proto;
+	u8				dir;
+
+	u16				mtu;
+
+	struct dst_entry		*dst_cache;
+};
+
+struct flow_offload_tuple_rhash {
+	struct rhash_head		node;
+	struct flow_offload_tuple	tuple;
+};
+
+#define FLOW_OFFLOAD_SNAT	0x1
+#define FLOW_OFFLOAD_DNAT	0x2
+#define FLOW_OFFLOAD_DYING	0x4
+#define FLOW_OFFLOAD_TEARDOWN	0x8
+
+/**
+ * struct flow_offload - a conntrack entry handled by the fast path
+ * @tuplehash:	hash table entries, indexed by enum flow_offload_tuple_dir
+ * @ct:		the conntrack entry, a reference is held while offloaded
+ * @flags:	FLOW_OFFLOAD_*
+ * @timeout:	jiffies at which an idle flow is handed back to conntrack
+ */
+struct flow_offload {
+	struct flow_offload_tuple_rhash	tuplehash[FLOW_OFFLOAD_DIR_MAX];
+	struct nf_conn			*ct;
+	u32				flags;
+	u32				timeout;
+	struct rcu_head			rcu_head;
+};
+
+#define NF_FLOW_TIMEOUT		(30 * HZ)
+#define nf_flowtable_time_stamp	((u32)jiffies)
+
+struct nf_flow_route {
+	struct {
+		struct dst_entry	*dst;
+	} tuple[FLOW_OFFLOAD_DIR_MAX];
+};
+
+struct flow_offload *flow_offload_alloc(struct nf_conn *ct,
+					struct nf_flow_route *route);
+void flow_offload_free(struct flow_offload *flow);
+
+int flow_offload_add(struct nf_flowtable *flow_table,
+		     struct flow_offload *flow);
+struct flow_offload_tuple_rhash *
+flow_offload_lookup(struct nf_flowtable *flow_table,
+		    struct flow_offload_tuple *tuple);
+void flow_offload_teardown(struct flow_offload *flow);
+
+static inline void flow_offload_refresh(struct flow_offload *flow)
+{
+	u32 timeout = nf_flowtable_time_stamp + NF_FLOW_TIMEOUT;
+
+	if (READ_ONCE(flow->timeout) != timeout)
+		WRITE_ONCE(flow->timeout, timeout);
+}
+
+struct nf_flowtable *nf_flow_table_get(const struct net *net);
+void nf_flow_table_cleanup(struct net *net, struct net_device *dev);
+
+unsigned int nf_flow_offload_ip_hook(const struct nf_hook_ops *ops,
+				     struct sk_buff *skb,
+				     const struct nf_hook_state *state);
+
+#endif /* _NF_FLOW_TABLE_H */
@@ -747,6 +747,7 @@ enum nft_chain_type {
 	NFT_CHAIN_T_DEFAULT = 0,
 	NFT_CHAIN_T_ROUTE,
 	NFT_CHAIN_T_NAT,
+	NFT_CHAIN_T_OFFLOAD,
 	NFT_CHAIN_T_MAX
 };
 
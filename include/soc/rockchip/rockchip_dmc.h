@@ -0,0 +1,56 @@
+/*
+ * Rockchip DDR memory controller frequency scaling, display interface
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#ifndef __SOC_ROCKCHIP_DMC_H
+#define __SOC_ROCKCHIP_DMC_H
+
+#include <linux/ktime.h>
+#include <linux/list.h>
+
+/**
+ * struct rockchip_dmc_vop - a display controller scanning out of DDR
+ * @vblank_us:		time from the frame start interrupt to the first
+ *			active line, during which nothing is fetched
+ * @vblank_irq:		turn the frame start interrupt on or off; the DMC
+ *			driver turns it on while it waits for a vblank
+ * @node:		internal, entry in the DMC driver's list
+ * @vblank_time:	internal, time of the last frame start
+ *
+ * The DDR controller stops serving requests while its PHY retrains for a
+ * new frequency. While display controllers are scanning out, the DMC
+ * driver only changes the frequency right after a frame start, so that
+ * the retrain falls into the vertical blanking and the display FIFOs never
+ * underflow.
+ */
+struct rockchip_dmc_vop {
+	unsigned int vblank_us;
+	int (*vblank_irq)(struct rockchip_dmc_vop *vop, bool on);
+
+	struct list_head node;
+	ktime_t vblank_time;
+};
+
+#if IS_ENABLED(CONFIG_ARM_RK3288_DMC_DEVFREQ)
+void rockchip_dmc_vop_enable(struct rockchip_dmc_vop *vop);
+void rockchip_dmc_vop_disable(struct rockchip_dmc_vop *vop);
+void rockchip_dmc_vblank(struct rockchip_dmc_vop *vop);
+#else
+static inline void rockchip_dmc_vop_enable(struct rockchip_dmc_vop *vop)
+{
+}
+
+static inline void rockchip_dmc_vop_disable(struct rockchip_dmc_vop *vop)
+{
+}
+
+static inline void rockchip_dmc_vblank(struct rockchip_dmc_vop *vop)
+{
+}
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lock_contention
+
+#if !defined(_TRACE_LOCK_CONTENTION_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_LOCK_CONTENTION_H
+
+#include <linux/tracepoint.h>
+
+#define show_lock_contention_type(type)				\
+	__print_symbolic(type,					\
+			 { 0, "spin" },				\
+			 { 1, "mutex" },			\
+			 { 2, "rwsem_read" },			\
+			 { 3, "rwsem_write" })
+
+/*
+ * Unlike lock_contended/lock_acquired these do not depend on lockdep;
+ * they are only emitted for the sampled slow path entries picked by
+ * the lock contention profiler.
+ */
+TRACE_EVENT(contention_begin,
+
+	TP_PROTO(void *lock, unsigned long ip, int type),
+
+	TP_ARGS(lock, ip, type),
+
+	TP_STRUCT__entry(
+		__field(void *, lock_addr)
+		__field(unsigned long, ip)
+		__field(int, type)
+	),
+
+	TP_fast_assign(
+		__entry->lock_addr = lock;
+		__entry->ip = ip;
+		__entry->type = type;
+	),
+
+	TP_printk("%p %s caller=%pS", __entry->lock_addr,
+		  show_lock_contention_type(__entry->type),
+		  (void *)__entry->ip)
+);
+
+TRACE_EVENT(contention_end,
+
+	TP_PROTO(void *lock, unsigned long ip, int type, u64 wait_ns,
+		 int ret),
+
+	TP_ARGS(lock, ip, type, wait_ns, ret),
+
+	TP_STRUCT__entry(
+		__field(void *, lock_addr)
+		__field(unsigned long, ip)
+		__field(u64, wait_ns)
+		__field(int, type)
+		__field(int, ret)
+	),
+
+	TP_fast_assign(
+		__entry->lock_addr = lock;
+		__entry->ip = ip;
+		__entry->wait_ns = wait_ns;
+		__entry->type = type;
+		__entry->ret = ret;
+	),
+
+	TP_printk("%p %s caller=%pS wait_ns=%llu ret=%d", __entry->lock_addr,
+		  show_lock_contention_type(__entry->type),
+		  (void *)__entry->ip, __entry->wait_ns, __entry->ret)
+);
+
+#endif /* _TRACE_LOCK_CONTENTION_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -261,6 +261,28 @@ DEFINE_EVENT(hrtimer_class, hrtimer_cancel,
 	TP_ARGS(hrtimer)
 );
 
+/**
+ * hrtimer_coalesced - called after an hrtimer interrupt ran timers early
+ * @nr:		number of timers which were expired before their hard
+ *		expiry time, i.e. which did not need a wakeup of their own
+ */
+TRACE_EVENT(hrtimer_coalesced,
+
+	TP_PROTO(unsigned int nr),
+
+	TP_ARGS(nr),
+
+	TP_STRUCT__entry(
+		__field( unsigned int,	nr	)
+	),
+
+	TP_fast_assign(
+		__entry->nr	= nr;
+	),
+
+	TP_printk("nr=%u", __entry->nr)
+);
+
 /**
  * itimer_state - called when itimer is started or canceled
  * @which:	name of the interval timer
@@ -348,6 +370,32 @@ TRACE_EVENT(tick_stop,
 );
 #endif
 
+#ifdef CONFIG_NO_HZ_FULL
+/**
+ * nohz_full_interrupt - called when a full dynticks CPU is interrupted
+ * @source:	kind of interruption: "irq", "ipi" or "hrtimer"
+ * @nr:		interrupt or IPI number, 0 for "hrtimer"
+ */
+TRACE_EVENT(nohz_full_interrupt,
+
+	TP_PROTO(const char *source, int nr),
+
+	TP_ARGS(source, nr),
+
+	TP_STRUCT__entry(
+		__string( source,	source	)
+		__field( int,		nr	)
+	),
+
+	TP_fast_assign(
+		__assign_str(source, source);
+		__entry->nr	= nr;
+	),
+
+	TP_printk("source=%s nr=%d", __get_str(source), __entry->nr)
+);
+#endif
+
 #endif /*  _TRACE_TIMER_H */
 
 /* This part must be outside protection */
@@ -33,6 +33,7 @@ enum {
 	BINDER_TYPE_HANDLE	= B_PACK_CHARS('s', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_WEAK_HANDLE	= B_PACK_CHARS('w', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_FD		= B_PACK_CHARS('f', 'd', '*', B_TYPE_LARGE),
+	BINDER_TYPE_PTR		= B_PACK_CHARS('p', 't', '*', B_TYPE_LARGE),
 };
 
 enum {
@@ -70,6 +71,35 @@ struct flat_binder_object {
 	binder_uintptr_t	cookie;
 };
 
+/**
+ * struct binder_buffer_object - object describing a userspace buffer
+ * @type:		BINDER_TYPE_PTR
+ * @flags:		BINDER_BUFFER_FLAG_HAS_PARENT if @parent is valid
+ * @buffer:		address of the buffer in the sender
+ * @length:		length of the buffer
+ * @parent:		index in the offsets array of the parent buffer object
+ * @parent_offset:	offset in @parent of the pointer to this buffer
+ *
+ * The driver copies @length bytes at @buffer straight from the sender into
+ * the extra buffers area of the target's transaction buffer and rewrites
+ * @buffer to the address the target sees it at. With a parent, the pointer
+ * at @parent_offset in the (already copied) parent buffer is fixed up the
+ * same way, so nested data structures can be passed without flattening
+ * them in userspace first.
+ */
+struct binder_buffer_object {
+	__u32			type;
+	__u32			flags;
+	binder_uintptr_t	buffer;
+	binder_size_t		length;
+	binder_size_t		parent;
+	binder_size_t		parent_offset;
+};
+
+enum {
+	BINDER_BUFFER_FLAG_HAS_PARENT = 0x01,
+};
+
 /*
  * On 64-bit platforms where user code may run in 32-bits the driver must
  * translate the buffer (and local binder) addresses appropriately.
@@ -162,6 +192,15 @@ struct binder_transaction_data {
 	} data;
 };
 
+/*
+ * For BC_TRANSACTION_SG and BC_REPLY_SG: @buffers_size is the total size of
+ * the BINDER_TYPE_PTR buffers in the transaction, each padded to 8 bytes.
+ */
+struct binder_transaction_data_sg {
+	struct binder_transaction_data transaction_data;
+	binder_size_t buffers_size;
+};
+
 struct binder_ptr_cookie {
 	binder_uintptr_t ptr;
 	binder_uintptr_t cookie;
@@ -346,6 +385,13 @@ enum binder_driver_command_protocol {
 	/*
 	 * void *: cookie
 	 */
+
+	BC_TRANSACTION_SG = _IOW('c', 17, struct binder_transaction_data_sg),
+	BC_REPLY_SG = _IOW('c', 18, struct binder_transaction_data_sg),
+	/*
+	 * binder_transaction_data_sg: the sent command, with the size of its
+	 * BINDER_TYPE_PTR buffers.
+	 */
 };
 
 #endif /* _UAPI_LINUX_BINDER_H */
@@ -107,6 +107,43 @@ enum bpf_cmd {
 	 * returns fd or negative error
 	 */
 	BPF_PROG_LOAD,
+
+	/* lookup many elements of a map in one call
+	 * err = bpf(BPF_MAP_LOOKUP_BATCH, union bpf_attr *attr, u32 size)
+	 * Using attr->batch.map_fd, in_batch, out_batch, keys, values, count
+	 * starts at the position stored in the __u32 that in_batch points
+	 * to, or at the beginning of the map if in_batch is NULL, copies up
+	 * to 'count' keys and values into the 'keys' and 'values' arrays and
+	 * stores the position to resume from into the __u32 out_batch
+	 * points to. On return 'count' holds the number of copied elements.
+	 * Returns zero, -ENOENT once the end of the map was reached (some
+	 * elements may still have been copied), -ENOSPC if 'count' is too
+	 * small to hold all elements of a hash bucket, or negative error
+	 */
+	BPF_MAP_LOOKUP_BATCH,
+
+	/* same as BPF_MAP_LOOKUP_BATCH, and deletes the copied elements
+	 * err = bpf(BPF_MAP_LOOKUP_AND_DELETE_BATCH, union bpf_attr *attr,
+	 *           u32 size)
+	 */
+	BPF_MAP_LOOKUP_AND_DELETE_BATCH,
+
+	/* create or update many key/value pairs in one call
+	 * err = bpf(BPF_MAP_UPDATE_BATCH, union bpf_attr *attr, u32 size)
+	 * Using attr->batch.map_fd, keys, values, count, elem_flags
+	 * each element is updated as by BPF_MAP_UPDATE_ELEM using elem_flags.
+	 * On return 'count' holds the number of updated elements.
+	 * Returns zero or the error of the first failed element
+	 */
+	BPF_MAP_UPDATE_BATCH,
+
+	/* delete many elements by key in one call
+	 * err = bpf(BPF_MAP_DELETE_BATCH, union bpf_attr *attr, u32 size)
+	 * Using attr->batch.map_fd, keys, count
+	 * On return 'count' holds the number of deleted elements.
+	 * Returns zero or the error of the first failed element
+	 */
+	BPF_MAP_DELETE_BATCH,
 };
 
 enum bpf_map_type {
@@ -115,6 +152,8 @@ enum bpf_map_type {
 	BPF_MAP_TYPE_ARRAY,
 	BPF_MAP_TYPE_PROG_ARRAY,
 	BPF_MAP_TYPE_PERF_EVENT_ARRAY,
+	BPF_MAP_TYPE_PERCPU_HASH,
+	BPF_MAP_TYPE_PERCPU_ARRAY,
 };
 
 enum bpf_prog_type {
@@ -123,6 +162,7 @@ enum bpf_prog_type {
 	BPF_PROG_TYPE_KPROBE,
 	BPF_PROG_TYPE_SCHED_CLS,
 	BPF_PROG_TYPE_SCHED_ACT,
+	BPF_PROG_TYPE_XDP,
 };
 
 #define BPF_PSEUDO_MAP_FD	1
@@ -132,12 +172,20 @@ enum bpf_prog_type {
 #define BPF_NOEXIST	1 /* create new element if it didn't exist */
 #define BPF_EXIST	2 /* update existing element */
 
+/* flags for BPF_FUNC_perf_event_output helper */
+#define BPF_F_INDEX_MASK	0xffffffffULL
+#define BPF_F_CURRENT_CPU	BPF_F_INDEX_MASK
+
+/* flags for BPF_MAP_CREATE command */
+#define BPF_F_NO_PREALLOC	(1U << 0) /* allocate hash elems on demand */
+
 union bpf_attr {
 	struct { /* anonymous struct used by BPF_MAP_CREATE command */
 		__u32	map_type;	/* one of enum bpf_map_type */
 		__u32	key_size;	/* size of key in bytes */
 		__u32	value_size;	/* size of value in bytes */
 		__u32	max_entries;	/* max number of entries in a map */
+		__u32	map_flags;	/* prealloc or not */
 	};
 
 	struct { /* anonymous struct used by BPF_MAP_*_ELEM commands */
@@ -150,6 +198,17 @@ union bpf_attr {
 		__u64		flags;
 	};
 
+	struct { /* struct used by BPF_MAP_*_BATCH commands */
+		__aligned_u64	in_batch;	/* start position, NULL: begin */
+		__aligned_u64	out_batch;	/* output: next start batch */
+		__aligned_u64	keys;
+		__aligned_u64	values;
+		__u32		count;		/* in/out: number of elements */
+		__u32		map_fd;
+		__u64		elem_flags;
+		__u64		flags;
+	} batch;
+
 	struct { /* anonymous struct used by BPF_PROG_LOAD command */
 		__u32		prog_type;	/* one of enum bpf_prog_type */
 		__u32		insn_cnt;
@@ -272,6 +331,51 @@ enum bpf_func_id {
 	BPF_FUNC_skb_get_tunnel_key,
 	BPF_FUNC_skb_set_tunnel_key,
 	BPF_FUNC_perf_event_read,	/* u64 bpf_perf_event_read(&map, index) */
+
+	/**
+	 * bpf_perf_event_output(ctx, map, flags, data, size) - output a sample
+	 * @ctx: struct pt_regs*
+	 * @map: pointer to perf_event_array map
+	 * @flags: bits 0-31 - index of the event in the map, or
+	 *         BPF_F_CURRENT_CPU for the event of the current cpu
+	 *         other bits - reserved
+	 * @data: pointer to the sample on the program stack
+	 * @size: size of the sample in bytes
+	 * Writes the sample as PERF_SAMPLE_RAW record into the ring buffer of a
+	 * PERF_COUNT_SW_BPF_OUTPUT software event open on the current cpu
+	 * Return: 0 on success
+	 */
+	BPF_FUNC_perf_event_output,
+
+	/**
+	 * bpf_xdp_load_bytes(ctx, offset, to, len) - load bytes from frame
+	 * @ctx: pointer to struct xdp_md
+	 * @offset: offset within the frame, from the ethernet header on
+	 * @to: pointer to an initialized buffer on the program stack
+	 * @len: number of bytes to copy
+	 * Return: 0 on success, -EFAULT if the range is outside the frame
+	 */
+	BPF_FUNC_xdp_load_bytes,
+
+	/**
+	 * bpf_xdp_store_bytes(ctx, offset, from, len) - store bytes into frame
+	 * @ctx: pointer to struct xdp_md
+	 * @offset: offset within the frame, from the ethernet header on
+	 * @from: pointer to a buffer on the program stack
+	 * @len: number of bytes to copy
+	 * Return: 0 on success, -EFAULT if the range is outside the frame
+	 */
+	BPF_FUNC_xdp_store_bytes,
+
+	/**
+	 * bpf_skb_load_bytes(skb, offset, to, len) - load bytes from packet
+	 * @skb: pointer to skb
+	 * @offset: offset within packet from skb->data
+	 * @to: pointer to a buffer on the program stack
+	 * @len: number of bytes to copy
+	 * Return: 0 on success, -EFAULT if the range is outside the packet
+	 */
+	BPF_FUNC_skb_load_bytes,
 	__BPF_FUNC_MAX_ID,
 };
 
@@ -300,4 +404,23 @@ struct bpf_tunnel_key {
 	__u32 remote_ipv4;
 };
 
+/* User return codes for XDP prog type.
+ * A valid XDP program must return one of these defined values. All other
+ * return codes are reserved for future use. Unknown return codes will result
+ * in packet drop.
+ */
+enum xdp_action {
+	XDP_ABORTED = 0,
+	XDP_DROP,
+	XDP_PASS,
+	XDP_TX,
+};
+
+/* user accessible metadata for XDP packet hook
+ * new fields must be added to the end of this structure
+ */
+struct xdp_md {
+	__u32 len;
+};
+
 #endif /* _UAPI__LINUX_BPF_H__ */
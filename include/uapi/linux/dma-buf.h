@@ -0,0 +1,47 @@
+/*
+ * Framework for buffer objects that can be shared across devices/subsystems.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef _DMA_BUF_UAPI_H_
+#define _DMA_BUF_UAPI_H_
+
+#include <linux/types.h>
+
+/**
+ * struct dma_buf_sync_range - bracket cpu access to part of an mmap'ed dma-buf
+ * @flags:	DMA_BUF_SYNC_START or DMA_BUF_SYNC_END, plus the access mode
+ * @offset:	start of the range accessed, in bytes
+ * @len:	length of the range accessed, 0 meaning up to the end
+ *
+ * Every DMA_BUF_SYNC_START must be matched by a DMA_BUF_SYNC_END with the
+ * same range and access mode once the cpu is done with the range.
+ */
+struct dma_buf_sync_range {
+	__u64 flags;
+	__u64 offset;
+	__u64 len;
+};
+
+#define DMA_BUF_SYNC_READ      (1 << 0)
+#define DMA_BUF_SYNC_WRITE     (2 << 0)
+#define DMA_BUF_SYNC_RW        (DMA_BUF_SYNC_READ | DMA_BUF_SYNC_WRITE)
+#define DMA_BUF_SYNC_START     (0 << 2)
+#define DMA_BUF_SYNC_END       (1 << 2)
+#define DMA_BUF_SYNC_VALID_FLAGS_MASK \
+	(DMA_BUF_SYNC_RW | DMA_BUF_SYNC_END)
+
+#define DMA_BUF_BASE		'b'
+/* numbers below 0x10 are left for whole-buffer ioctls */
+#define DMA_BUF_IOCTL_SYNC_RANGE	\
+	_IOW(DMA_BUF_BASE, 0x10, struct dma_buf_sync_range)
+
+#endif
@@ -38,6 +38,14 @@
  */
 #define EPOLLWAKEUP (1 << 29)
 
+/*
+ * Exclusive wakeups for a Level Triggered descriptor shared by several
+ * epoll_wait() callers: each event wakes up a single waiter, in the order
+ * they went to sleep, and a delivered event doesn't wake up another waiter
+ * just because the descriptor is still ready.
+ */
+#define EPOLLROUNDROBIN (1 << 27)
+
 /* Set the One Shot behaviour for the target file descriptor */
 #define EPOLLONESHOT (1 << 30)
 
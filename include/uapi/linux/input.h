@@ -28,6 +28,38 @@ struct input_event {
 	__s32 value;
 };
 
+/*
+ * Event ring shared with userspace by mmap()ing an evdev file descriptor
+ * at offset 0 with MAP_SHARED. The first page holds the header, the events
+ * follow at @offset. The number of events is a power of two and the
+ * mapping must not extend past the page holding the last one, otherwise
+ * mmap() fails with -EINVAL. Once a ring is mapped, events are only
+ * delivered to it and read() fails with -EINVAL.
+ *
+ * @head and @tail are free running; entry i lives at index i & (size - 1).
+ * The kernel advances @head at the end of each packet (SYN_REPORT) with
+ * store-release semantics, userspace advances @tail once it has consumed
+ * the entries before it. poll() reports POLLIN while they differ. If the
+ * ring fills up, the packet being delivered is discarded and @dropped is
+ * incremented; userspace should then resync as it would on SYN_DROPPED.
+ */
+struct input_ring_event {
+	__s64 sec;
+	__u32 usec;
+	__u16 type;
+	__u16 code;
+	__s32 value;
+	__u32 reserved;
+};
+
+struct input_ring_header {
+	__u32 head;
+	__u32 tail;
+	__u32 size;
+	__u32 offset;
+	__u32 dropped;
+};
+
 /*
  * Protocol version.
  */
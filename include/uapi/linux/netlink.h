@@ -111,6 +111,7 @@ struct nlmsgerr {
 #define NETLINK_LISTEN_ALL_NSID		8
 #define NETLINK_LIST_MEMBERSHIPS	9
 #define NETLINK_CAP_ACK			10
+#define NETLINK_DUMP_SIZE		11
 
 struct nl_pktinfo {
 	__u32	group;
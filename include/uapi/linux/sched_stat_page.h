@@ -0,0 +1,43 @@
+#ifndef _UAPI_LINUX_SCHED_STAT_PAGE_H
+#define _UAPI_LINUX_SCHED_STAT_PAGE_H
+
+#include <linux/types.h>
+
+/*
+ * Binary per-CPU scheduler statistics, exported through /proc/schedstat_map.
+ *
+ * The file maps one page per possible CPU, the page at offset
+ * cpu * page size describing that CPU, and can only be mapped read-only.
+ * Each page starts with a struct sched_stat_page, refreshed by the
+ * scheduler tick and whenever the CPU goes idle.
+ *
+ * Readers don't take any lock; they retry while an update is in progress:
+ *
+ *	do {
+ *		seq = page->seq;
+ *		if (seq & 1)
+ *			continue;
+ *		read barrier;
+ *		copy the fields;
+ *		read barrier;
+ *	} while (page->seq != seq);
+ *
+ * Counters only ever increase, until they wrap.
+ */
+
+#define SCHED_STAT_PAGE_VERSION	1
+
+struct sched_stat_page {
+	__u32	version;	/* SCHED_STAT_PAGE_VERSION */
+	__u32	seq;		/* odd while the page is being updated */
+	__u64	timestamp_ns;	/* runqueue clock at the last update */
+	__u64	nr_running;	/* runnable tasks, of all classes */
+	__u64	nr_switches;	/* context switches */
+	__u64	run_delay_ns;	/* time tasks spent waiting to run */
+	__u64	pcount;		/* tasks picked to run */
+	__u64	nr_migrations;	/* tasks migrated to this CPU */
+	__u64	cfs_load_avg;	/* CFS load average, 0 on !SMP */
+	__u64	cfs_util_avg;	/* CFS utilization, 0 on !SMP */
+};
+
+#endif /* _UAPI_LINUX_SCHED_STAT_PAGE_H */
@@ -523,6 +523,8 @@ extern char __initramfs_start[];
 extern unsigned long __initramfs_size;
 #include <linux/initrd.h>
 #include <linux/kexec.h>
+#include <linux/async.h>
+#include <linux/file.h>
 
 static void __init free_initrd(void)
 {
@@ -605,8 +607,45 @@ static void __init clean_rootfs(void)
 }
 #endif
 
-static int __init populate_rootfs(void)
+/*
+ * Off by default: request_module() does not wait for the unpacker, so a
+ * module requested early in boot could be looked up in an empty rootfs.
+ */
+static bool initramfs_async;
+static int __init initramfs_async_setup(char *str)
+{
+	strtobool(str, &initramfs_async);
+	return 1;
+}
+__setup("initramfs_async=", initramfs_async_setup);
+
+static ASYNC_DOMAIN_EXCLUSIVE(initramfs_domain);
+static async_cookie_t initramfs_cookie;
+static bool initramfs_done;
+
+/**
+ * wait_for_initramfs - wait until the initramfs has been unpacked
+ *
+ * The initramfs is unpacked asynchronously, while the remaining initcalls
+ * run.  Anything that looks for files in rootfs before the first userspace
+ * process starts, such as the firmware loader, has to call this first.
+ */
+void wait_for_initramfs(void)
 {
+	if (smp_load_acquire(&initramfs_done))
+		return;
+	if (!initramfs_cookie) {
+		/* too early, the lookup will fail like it always did */
+		pr_warn_once("wait_for_initramfs() called before rootfs_initcall\n");
+		return;
+	}
+	async_synchronize_cookie_domain(initramfs_cookie + 1, &initramfs_domain);
+}
+EXPORT_SYMBOL_GPL(wait_for_initramfs);
+
+static void __init do_populate_rootfs(void *unused, async_cookie_t cookie)
+{
+	bool have_initrd = initrd_start != 0;
 	char *err = unpack_to_rootfs(__initramfs_start, __initramfs_size);
 	if (err)
 		panic("%s", err); /* Failed to decompress INTERNAL initramfs */
@@ -647,12 +686,29 @@ static int __init populate_rootfs(void)
 			printk(KERN_EMERG "Initramfs unpacking failed: %s\n", err);
 		free_initrd();
 #endif
-		/*
-		 * Try loading default modules from initramfs.  This gives
-		 * us a chance to load before device_initcalls.
-		 */
-		load_default_modules();
 	}
+
+	/*
+	 * Files written from a kernel thread are closed by delayed work;
+	 * make sure none is still open for writing when init is exec'ed.
+	 */
+	flush_delayed_fput();
+	smp_store_release(&initramfs_done, true);
+
+	/*
+	 * Try loading default modules from initramfs.  This gives us a
+	 * chance to load before device_initcalls.
+	 */
+	if (have_initrd)
+		load_default_modules();
+}
+
+static int __init populate_rootfs(void)
+{
+	initramfs_cookie = async_schedule_domain(do_populate_rootfs, NULL,
+						 &initramfs_domain);
+	if (!initramfs_async)
+		wait_for_initramfs();
 	return 0;
 }
 rootfs_initcall(populate_rootfs);
@@ -70,6 +70,9 @@
  *   and per-semaphore list (stored in the array). This allows to achieve FIFO
  *   ordering without always scanning all pending operations.
  *   The worst-case behavior is nevertheless O(N^2) for N wakeups.
+ * - Only the semaphores used by a sleeping complex operation switch to the
+ *   per-array list and the global lock (see sem.complex_count); simple
+ *   operations on all other semaphores keep using the per-semaphore lock.
  */
 
 #include <linux/slab.h>
@@ -98,6 +101,7 @@ struct sem {
 					/* that alter the semaphore */
 	struct list_head pending_const; /* pending single-sop operations */
 					/* that do not alter the semaphore*/
+	int	complex_count;	/* pending complex operations using it */
 	time_t	sem_otime;	/* candidate for sem_otime */
 } ____cacheline_aligned_in_smp;
 
@@ -156,13 +160,14 @@ static int sysvipc_sem_proc_show(struct seq_file *s, void *it);
 /*
  * Locking:
  *	sem_undo.id_next,
- *	sem_array.complex_count,
  *	sem_array.pending{_alter,_cont},
  *	sem_array.sem_undo: global sem_lock() for read/write
  *	sem_undo.proc_next: only "current" is allowed to read/write that field.
  *
  *	sem_array.sem_base[i].pending_{const,alter}:
  *		global or semaphore sem_lock() for read/write
+ *	sem_array.sem_base[i].complex_count:
+ *		global sem_lock() for write, semaphore sem_lock() for read
  */
 
 #define sc_semmsl	sem_ctls[0]
@@ -200,49 +205,66 @@ void __init sem_init(void)
  * unmerge_queues - unmerge queues, if possible.
  * @sma: semaphore array
  *
- * The function unmerges the wait queues if complex_count is 0.
- * It must be called prior to dropping the global semaphore array lock.
+ * The function moves the pending single-sop operations on semaphores that
+ * are no longer used by any complex operation back to their per-semaphore
+ * queues. It must be called prior to dropping the global semaphore array
+ * lock.
  */
 static void unmerge_queues(struct sem_array *sma)
 {
 	struct sem_queue *q, *tq;
 
-	/* complex operations still around? */
-	if (sma->complex_count)
-		return;
 	/*
-	 * We will switch back to simple mode.
-	 * Move all pending operation back into the per-semaphore
-	 * queues.
+	 * Semaphores without pending complex operations switch back to
+	 * simple mode.
 	 */
 	list_for_each_entry_safe(q, tq, &sma->pending_alter, list) {
 		struct sem *curr;
-		curr = &sma->sem_base[q->sops[0].sem_num];
 
-		list_add_tail(&q->list, &curr->pending_alter);
+		if (q->nsops > 1)
+			continue;
+		curr = &sma->sem_base[q->sops[0].sem_num];
+		if (!curr->complex_count)
+			list_move_tail(&q->list, &curr->pending_alter);
 	}
-	INIT_LIST_HEAD(&sma->pending_alter);
 }
 
 /**
  * merge_queues - merge single semop queues into global queue
  * @sma: semaphore array
+ * @q: the complex operation that is about to sleep
  *
- * This function merges all per-semaphore queues into the global queue.
- * It is necessary to achieve FIFO ordering for the pending single-sop
- * operations when a multi-semop operation must sleep.
+ * This function merges the per-semaphore queues of the semaphores used by
+ * @q into the global queue, and marks these semaphores as used by a
+ * complex operation. It is necessary to achieve FIFO ordering for the
+ * pending single-sop operations when a multi-semop operation must sleep.
  * Only the alter operations must be moved, the const operations can stay.
  */
-static void merge_queues(struct sem_array *sma)
+static void merge_queues(struct sem_array *sma, struct sem_queue *q)
 {
 	int i;
-	for (i = 0; i < sma->sem_nsems; i++) {
-		struct sem *sem = sma->sem_base + i;
 
-		list_splice_init(&sem->pending_alter, &sma->pending_alter);
+	for (i = 0; i < q->nsops; i++) {
+		struct sem *sem = sma->sem_base + q->sops[i].sem_num;
+
+		if (!sem->complex_count++)
+			list_splice_tail_init(&sem->pending_alter,
+					      &sma->pending_alter);
 	}
 }
 
+/*
+ * Do the per-array queues have to be scanned after @sops were applied?
+ * A single-sop operation on a semaphore that no sleeping complex operation
+ * uses holds just the per-semaphore lock, and none of the operations on
+ * the per-array queues can depend on that semaphore.
+ */
+static bool sem_global_queues(struct sem_array *sma, struct sembuf *sops,
+			      int nsops)
+{
+	return !sops || nsops > 1 || sma->sem_base[sops->sem_num].complex_count;
+}
+
 static void sem_rcu_free(struct rcu_head *head)
 {
 	struct ipc_rcu *p = container_of(head, struct ipc_rcu, rcu);
@@ -266,21 +288,15 @@ static void sem_rcu_free(struct rcu_head *head)
  * Wait until all currently ongoing simple ops have completed.
  * Caller must own sem_perm.lock.
  * New simple ops cannot start, because simple ops first check
- * that sem_perm.lock is free.
- * that a) sem_perm.lock is free and b) complex_count is 0.
+ * that a) sem_perm.lock is free and b) sem->complex_count is 0.
+ * Pending complex ops do not exclude simple ops on the semaphores they
+ * don't use, so the wait is always needed.
  */
 static void sem_wait_array(struct sem_array *sma)
 {
 	int i;
 	struct sem *sem;
 
-	if (sma->complex_count)  {
-		/* The thread that increased sma->complex_count waited on
-		 * all sem->lock locks. Thus we don't need to wait again.
-		 */
-		return;
-	}
-
 	for (i = 0; i < sma->sem_nsems; i++) {
 		sem = sma->sem_base + i;
 		spin_unlock_wait(&sem->lock);
@@ -315,20 +331,21 @@ static inline int sem_lock(struct sem_array *sma, struct sembuf *sops,
 	 * Only one semaphore affected - try to optimize locking.
 	 * The rules are:
 	 * - optimized locking is possible if no complex operation
-	 *   is either enqueued or processed right now.
+	 *   that uses the semaphore is enqueued, and no complex operation
+	 *   is processed right now.
 	 * - The test for enqueued complex ops is simple:
-	 *      sma->complex_count != 0
+	 *      sem->complex_count != 0
 	 * - Testing for complex ops that are processed right now is
 	 *   a bit more difficult. Complex ops acquire the full lock
 	 *   and first wait that the running simple ops have completed.
 	 *   (see above)
 	 *   Thus: If we own a simple lock and the global lock is free
-	 *	and complex_count is now 0, then it will stay 0 and
+	 *	and sem->complex_count is now 0, then it will stay 0 and
 	 *	thus just locking sem->lock is sufficient.
 	 */
 	sem = sma->sem_base + sops->sem_num;
 
-	if (sma->complex_count == 0) {
+	if (sem->complex_count == 0) {
 		/*
 		 * It appears that no complex operation is around.
 		 * Acquire the per-semaphore lock.
@@ -340,7 +357,7 @@ static inline int sem_lock(struct sem_array *sma, struct sembuf *sops,
 			/*
 			 * We need a memory barrier with acquire semantics,
 			 * otherwise we can race with another thread that does:
-			 *	complex_count++;
+			 *	sem->complex_count++;
 			 *	spin_unlock(sem_perm.lock);
 			 */
 			ipc_smp_acquire__after_spin_is_unlocked();
@@ -350,7 +367,7 @@ static inline int sem_lock(struct sem_array *sma, struct sembuf *sops,
 			 * It can't change anymore until we drop sem->lock.
 			 * Thus: if is now 0, then it will stay 0.
 			 */
-			if (sma->complex_count == 0) {
+			if (sem->complex_count == 0) {
 				/* fast path successful! */
 				return sops->sem_num;
 			}
@@ -361,10 +378,10 @@ static inline int sem_lock(struct sem_array *sma, struct sembuf *sops,
 	/* slow path: acquire the full lock */
 	ipc_lock_object(&sma->sem_perm);
 
-	if (sma->complex_count == 0) {
+	if (sem->complex_count == 0) {
 		/* False alarm:
-		 * There is no complex operation, thus we can switch
-		 * back to the fast path.
+		 * No complex operation uses the semaphore, thus we can
+		 * switch back to the fast path.
 		 */
 		spin_lock(&sem->lock);
 		ipc_unlock_object(&sma->sem_perm);
@@ -532,7 +549,6 @@ static int newary(struct ipc_namespace *ns, struct ipc_params *params)
 		spin_lock_init(&sma->sem_base[i].lock);
 	}
 
-	sma->complex_count = 0;
 	INIT_LIST_HEAD(&sma->pending_alter);
 	INIT_LIST_HEAD(&sma->pending_const);
 	INIT_LIST_HEAD(&sma->list_id);
@@ -730,9 +746,13 @@ static void wake_up_sem_queue_do(struct list_head *pt)
 
 static void unlink_queue(struct sem_array *sma, struct sem_queue *q)
 {
+	int i;
+
 	list_del(&q->list);
-	if (q->nsops > 1)
-		sma->complex_count--;
+	if (q->nsops > 1) {
+		for (i = 0; i < q->nsops; i++)
+			sma->sem_base[q->sops[i].sem_num].complex_count--;
+	}
 }
 
 /** check_restart(sma, q)
@@ -862,7 +882,7 @@ static int do_smart_wakeup_zero(struct sem_array *sma, struct sembuf *sops,
 	 * If one of the modified semaphores got 0,
 	 * then check the global queue, too.
 	 */
-	if (got_zero)
+	if (got_zero && sem_global_queues(sma, sops, nsops))
 		semop_completed |= wake_const_ops(sma, -1, pt);
 
 	return semop_completed;
@@ -928,7 +948,8 @@ again:
 		} else {
 			semop_completed = 1;
 			do_smart_wakeup_zero(sma, q->sops, q->nsops, pt);
-			restart = check_restart(sma, q);
+			/* per-semaphore queues hold only simple decrements */
+			restart = semnum == -1 && check_restart(sma, q);
 		}
 
 		wake_up_sem_queue_prepare(pt, q, error);
@@ -977,32 +998,37 @@ static void do_smart_update(struct sem_array *sma, struct sembuf *sops, int nsop
 
 	otime |= do_smart_wakeup_zero(sma, sops, nsops, pt);
 
-	if (!list_empty(&sma->pending_alter)) {
-		/* semaphore array uses the global queue - just process it. */
+	if (sem_global_queues(sma, sops, nsops) &&
+	    !list_empty(&sma->pending_alter)) {
+		/* some semaphores use the global queue - process it. */
 		otime |= update_queue(sma, -1, pt);
+	}
+
+	/*
+	 * The per-semaphore queues of semaphores used by complex operations
+	 * are empty, the others must be checked as well.
+	 */
+	if (!sops) {
+		/*
+		 * No sops, thus the modified semaphores are not
+		 * known. Check all.
+		 */
+		for (i = 0; i < sma->sem_nsems; i++)
+			otime |= update_queue(sma, i, pt);
 	} else {
-		if (!sops) {
-			/*
-			 * No sops, thus the modified semaphores are not
-			 * known. Check all.
-			 */
-			for (i = 0; i < sma->sem_nsems; i++)
-				otime |= update_queue(sma, i, pt);
-		} else {
-			/*
-			 * Check the semaphores that were increased:
-			 * - No complex ops, thus all sleeping ops are
-			 *   decrease.
-			 * - if we decreased the value, then any sleeping
-			 *   semaphore ops wont be able to run: If the
-			 *   previous value was too small, then the new
-			 *   value will be too small, too.
-			 */
-			for (i = 0; i < nsops; i++) {
-				if (sops[i].sem_op > 0) {
-					otime |= update_queue(sma,
-							sops[i].sem_num, pt);
-				}
+		/*
+		 * Check the semaphores that were increased:
+		 * - Only simple ops are on the per-semaphore queues,
+		 *   thus all sleeping ops are decrease.
+		 * - if we decreased the value, then any sleeping
+		 *   semaphore ops wont be able to run: If the
+		 *   previous value was too small, then the new
+		 *   value will be too small, too.
+		 */
+		for (i = 0; i < nsops; i++) {
+			if (sops[i].sem_op > 0) {
+				otime |= update_queue(sma,
+						sops[i].sem_num, pt);
 			}
 		}
 	}
@@ -1924,7 +1950,7 @@ SYSCALL_DEFINE4(semtimedop, int, semid, struct sembuf __user *, tsops,
 		curr = &sma->sem_base[sops->sem_num];
 
 		if (alter) {
-			if (sma->complex_count) {
+			if (curr->complex_count) {
 				list_add_tail(&queue.list,
 						&sma->pending_alter);
 			} else {
@@ -1936,15 +1962,12 @@ SYSCALL_DEFINE4(semtimedop, int, semid, struct sembuf __user *, tsops,
 			list_add_tail(&queue.list, &curr->pending_const);
 		}
 	} else {
-		if (!sma->complex_count)
-			merge_queues(sma);
+		merge_queues(sma, &queue);
 
 		if (alter)
 			list_add_tail(&queue.list, &sma->pending_alter);
 		else
 			list_add_tail(&queue.list, &sma->pending_const);
-
-		sma->complex_count++;
 	}
 
 	queue.status = -EINTR;
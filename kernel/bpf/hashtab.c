@@ -13,38 +13,146 @@
 #include <linux/jhash.h>
 #include <linux/filter.h>
 #include <linux/vmalloc.h>
+#include "percpu_freelist.h"
+
+struct bucket {
+	struct hlist_head head;
+	raw_spinlock_t lock;
+};
 
 struct bpf_htab {
 	struct bpf_map map;
-	struct hlist_head *buckets;
-	spinlock_t lock;
-	u32 count;	/* number of elements in this hashtable */
+	struct bucket *buckets;
+	void *elems;	/* preallocated elements, unless BPF_F_NO_PREALLOC */
+	struct pcpu_freelist freelist;
+	atomic_t count;	/* number of elements in this hashtable */
 	u32 n_buckets;	/* number of hash buckets */
 	u32 elem_size;	/* size of each element in bytes */
 };
 
-/* each htab element is struct htab_elem + key + value */
+/* each htab element is struct htab_elem + key + value, for per-cpu maps
+ * the value is a pointer to the per-cpu copies of the value
+ */
 struct htab_elem {
-	struct hlist_node hash_node;
+	union {
+		struct hlist_node hash_node;
+		struct pcpu_freelist_node fnode; /* free prealloc elem */
+	};
 	struct rcu_head rcu;
 	u32 hash;
+	u32 key_size;	/* per-cpu elements only, once unlinked */
 	char key[0] __aligned(8);
 };
 
+static bool htab_is_percpu(const struct bpf_htab *htab)
+{
+	return htab->map.map_type == BPF_MAP_TYPE_PERCPU_HASH;
+}
+
+static bool htab_is_prealloc(const struct bpf_htab *htab)
+{
+	return !(htab->map.map_flags & BPF_F_NO_PREALLOC);
+}
+
+static inline void htab_elem_set_ptr(struct htab_elem *l, u32 key_size,
+				     void __percpu *pptr)
+{
+	*(void __percpu **)(l->key + round_up(key_size, 8)) = pptr;
+}
+
+static inline void __percpu *htab_elem_get_ptr(struct htab_elem *l,
+						u32 key_size)
+{
+	return *(void __percpu **)(l->key + round_up(key_size, 8));
+}
+
+static struct htab_elem *get_htab_elem(struct bpf_htab *htab, int i)
+{
+	return (struct htab_elem *) (htab->elems + i * htab->elem_size);
+}
+
+/* one element more per cpu than max_entries: replacing an existing key
+ * takes the new element before the old one is released
+ */
+static u32 htab_nr_prealloc_elems(struct bpf_htab *htab)
+{
+	return htab->map.max_entries + num_possible_cpus();
+}
+
+static void htab_free_elems(struct bpf_htab *htab)
+{
+	int i;
+
+	if (!htab_is_percpu(htab))
+		goto free_elems;
+
+	for (i = 0; i < htab_nr_prealloc_elems(htab); i++)
+		free_percpu(htab_elem_get_ptr(get_htab_elem(htab, i),
+					      htab->map.key_size));
+
+free_elems:
+	vfree(htab->elems);
+}
+
+static int prealloc_elems(struct bpf_htab *htab)
+{
+	u32 num_entries = htab_nr_prealloc_elems(htab);
+	int err = -ENOMEM, i;
+
+	htab->elems = vzalloc(htab->elem_size * num_entries);
+	if (!htab->elems)
+		return -ENOMEM;
+
+	if (!htab_is_percpu(htab))
+		goto skip_percpu_elems;
+
+	for (i = 0; i < num_entries; i++) {
+		u32 size = round_up(htab->map.value_size, 8);
+		void __percpu *pptr;
+
+		pptr = __alloc_percpu_gfp(size, 8, GFP_USER | __GFP_NOWARN);
+		if (!pptr)
+			goto free_elems;
+		htab_elem_set_ptr(get_htab_elem(htab, i), htab->map.key_size,
+				  pptr);
+	}
+
+skip_percpu_elems:
+	err = pcpu_freelist_init(&htab->freelist);
+	if (err)
+		goto free_elems;
+
+	pcpu_freelist_populate(&htab->freelist, htab->elems, htab->elem_size,
+			       num_entries);
+	return 0;
+
+free_elems:
+	htab_free_elems(htab);
+	return err;
+}
+
 /* Called from syscall */
 static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 {
+	bool percpu = attr->map_type == BPF_MAP_TYPE_PERCPU_HASH;
 	struct bpf_htab *htab;
 	int err, i;
+	u64 cost;
+
+	if (attr->map_flags & ~BPF_F_NO_PREALLOC)
+		/* reserved bits should not be used */
+		return ERR_PTR(-EINVAL);
 
 	htab = kzalloc(sizeof(*htab), GFP_USER);
 	if (!htab)
 		return ERR_PTR(-ENOMEM);
 
 	/* mandatory map attributes */
+	htab->map.map_type = attr->map_type;
 	htab->map.key_size = attr->key_size;
 	htab->map.value_size = attr->value_size;
 	htab->map.max_entries = attr->max_entries;
+	htab->map.map_flags = attr->map_flags;
 
 	/* check sanity of attributes.
 	 * value_size == 0 may be allowed in the future to use map as a set
@@ -64,32 +172,55 @@ static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 		 */
 		goto free_htab;
 
-	err = -ENOMEM;
+	if (percpu && round_up(htab->map.value_size, 8) > PCPU_MIN_UNIT_SIZE)
+		/* make sure the size for pcpu_alloc() is reasonable */
+		goto free_htab;
+
+	htab->elem_size = sizeof(struct htab_elem) +
+			  round_up(htab->map.key_size, 8);
+	if (percpu)
+		htab->elem_size += sizeof(void *);
+	else
+		htab->elem_size += round_up(htab->map.value_size, 8);
+
 	/* prevent zero size kmalloc and check for u32 overflow */
 	if (htab->n_buckets == 0 ||
-	    htab->n_buckets > U32_MAX / sizeof(struct hlist_head))
+	    htab->n_buckets > U32_MAX / sizeof(struct bucket))
 		goto free_htab;
 
-	htab->buckets = kmalloc_array(htab->n_buckets, sizeof(struct hlist_head),
+	cost = (u64) htab->n_buckets * sizeof(struct bucket) +
+	       (u64) htab->elem_size * htab_nr_prealloc_elems(htab);
+	if (cost >= U32_MAX - PAGE_SIZE)
+		/* make sure the preallocation size stays sane */
+		goto free_htab;
+
+	err = -ENOMEM;
+	htab->buckets = kmalloc_array(htab->n_buckets, sizeof(struct bucket),
 				      GFP_USER | __GFP_NOWARN);
 
 	if (!htab->buckets) {
-		htab->buckets = vmalloc(htab->n_buckets * sizeof(struct hlist_head));
+		htab->buckets = vmalloc(htab->n_buckets * sizeof(struct bucket));
 		if (!htab->buckets)
 			goto free_htab;
 	}
 
-	for (i = 0; i < htab->n_buckets; i++)
-		INIT_HLIST_HEAD(&htab->buckets[i]);
+	for (i = 0; i < htab->n_buckets; i++) {
+		INIT_HLIST_HEAD(&htab->buckets[i].head);
+		raw_spin_lock_init(&htab->buckets[i].lock);
+	}
+
+	atomic_set(&htab->count, 0);
 
-	spin_lock_init(&htab->lock);
-	htab->count = 0;
+	if (htab_is_prealloc(htab)) {
+		err = prealloc_elems(htab);
+		if (err)
+			goto free_buckets;
+	}
 
-	htab->elem_size = sizeof(struct htab_elem) +
-			  round_up(htab->map.key_size, 8) +
-			  htab->map.value_size;
 	return &htab->map;
 
+free_buckets:
+	kvfree(htab->buckets);
 free_htab:
 	kfree(htab);
 	return ERR_PTR(err);
@@ -100,11 +231,16 @@ static inline u32 htab_map_hash(const void *key, u32 key_len)
 	return jhash(key, key_len, 0);
 }
 
-static inline struct hlist_head *select_bucket(struct bpf_htab *htab, u32 hash)
+static inline struct bucket *__select_bucket(struct bpf_htab *htab, u32 hash)
 {
 	return &htab->buckets[hash & (htab->n_buckets - 1)];
 }
 
+static inline struct hlist_head *select_bucket(struct bpf_htab *htab, u32 hash)
+{
+	return &__select_bucket(htab, hash)->head;
+}
+
 static struct htab_elem *lookup_elem_raw(struct hlist_head *head, u32 hash,
 					 void *key, u32 key_size)
 {
@@ -116,13 +252,10 @@ static struct htab_elem *lookup_elem_raw(struct hlist_head *head, u32 hash,
 
 	return NULL;
 }
-
-/* Called from syscall or from eBPF program */
-static void *htab_map_lookup_elem(struct bpf_map *map, void *key)
+static struct htab_elem *__htab_map_lookup_elem(struct bpf_map *map, void *key)
 {
 	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
 	struct hlist_head *head;
-	struct htab_elem *l;
 	u32 hash, key_size;
 
 	/* Must be called with rcu_read_lock. */
@@ -134,7 +267,13 @@ static void *htab_map_lookup_elem(struct bpf_map *map, void *key)
 
 	head = select_bucket(htab, hash);
 
-	l = lookup_elem_raw(head, hash, key, key_size);
+	return lookup_elem_raw(head, hash, key, key_size);
+}
+
+/* Called from syscall or from eBPF program */
+static void *htab_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	struct htab_elem *l = __htab_map_lookup_elem(map, key);
 
 	if (l)
 		return l->key + round_up(map->key_size, 8);
@@ -142,6 +281,46 @@ static void *htab_map_lookup_elem(struct bpf_map *map, void *key)
 	return NULL;
 }
 
+/* Called from eBPF program, returns this cpu's copy of the value */
+static void *htab_percpu_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	struct htab_elem *l = __htab_map_lookup_elem(map, key);
+
+	if (l)
+		return this_cpu_ptr(htab_elem_get_ptr(l, map->key_size));
+
+	return NULL;
+}
+
+/* Called from syscall, copies the values of all cpus one after another */
+int bpf_percpu_hash_copy(struct bpf_map *map, void *key, void *value)
+{
+	struct htab_elem *l;
+	void __percpu *pptr;
+	int ret = -ENOENT;
+	int cpu, off = 0;
+	u32 size;
+
+	/* per_cpu areas are zero-filled and bpf programs can only
+	 * access 'value_size' of them, so copying rounded areas
+	 * will not leak any kernel data
+	 */
+	size = round_up(map->value_size, 8);
+	rcu_read_lock();
+	l = __htab_map_lookup_elem(map, key);
+	if (!l)
+		goto out;
+	pptr = htab_elem_get_ptr(l, map->key_size);
+	for_each_possible_cpu(cpu) {
+		memcpy(value + off, per_cpu_ptr(pptr, cpu), size);
+		off += size;
+	}
+	ret = 0;
+out:
+	rcu_read_unlock();
+	return ret;
+}
+
 /* Called from syscall */
 static int htab_map_get_next_key(struct bpf_map *map, void *key, void *next_key)
 {
@@ -200,6 +379,152 @@ find_first_elem:
 	return -ENOENT;
 }
 
+static void htab_elem_free(struct bpf_htab *htab, struct htab_elem *l)
+{
+	if (htab_is_percpu(htab))
+		free_percpu(htab_elem_get_ptr(l, htab->map.key_size));
+	kfree(l);
+}
+
+static void htab_percpu_elem_free_rcu(struct rcu_head *head)
+{
+	struct htab_elem *l = container_of(head, struct htab_elem, rcu);
+
+	free_percpu(htab_elem_get_ptr(l, l->key_size));
+	kfree(l);
+}
+
+/* Called with the element unlinked and the bucket lock held.
+ *
+ * Preallocated elements go straight back to the freelist and can be handed
+ * out again before a grace period elapsed. A lookup walking the bucket at
+ * the same time may then follow 'fnode', which shares storage with
+ * 'hash_node', into the freelist, or follow the element into the bucket it
+ * was reused in: it can miss a key that is present, or return the element
+ * of another key, or one whose key and value are being rewritten. It never
+ * touches freed memory, the elements live as long as the map. Waiting for
+ * a grace period before the push would instead let back to back updates
+ * of an existing key run out of spare elements.
+ *
+ * Otherwise concurrent lookups may still walk over the element until a
+ * grace period elapsed, and find it as if it had not been deleted yet.
+ */
+static void free_htab_elem(struct bpf_htab *htab, struct htab_elem *l)
+{
+	if (htab_is_prealloc(htab)) {
+		pcpu_freelist_push(&htab->freelist, &l->fnode);
+	} else if (htab_is_percpu(htab)) {
+		l->key_size = htab->map.key_size;
+		call_rcu(&l->rcu, htab_percpu_elem_free_rcu);
+	} else {
+		kfree_rcu(l, rcu);
+	}
+}
+
+static void pcpu_copy_value(struct bpf_htab *htab, void __percpu *pptr,
+			    void *value, bool onallcpus)
+{
+	if (!onallcpus) {
+		/* copy true value_size bytes */
+		memcpy(this_cpu_ptr(pptr), value, htab->map.value_size);
+	} else {
+		u32 size = round_up(htab->map.value_size, 8);
+		int off = 0, cpu;
+
+		for_each_possible_cpu(cpu) {
+			memcpy(per_cpu_ptr(pptr, cpu), value + off, size);
+			off += size;
+		}
+	}
+}
+
+/* Called with the bucket lock held. A new key is accounted against
+ * max_entries, the replacement for an existing key is not.
+ */
+static struct htab_elem *alloc_htab_elem(struct bpf_htab *htab, void *key,
+					 void *value, u32 key_size, u32 hash,
+					 bool percpu, bool onallcpus,
+					 bool old_elem_exists)
+{
+	u32 size = round_up(htab->map.value_size, 8);
+	struct pcpu_freelist_node *node;
+	struct htab_elem *l_new;
+	void __percpu *pptr;
+	int err = -ENOMEM;
+	int cpu;
+
+	if (!old_elem_exists &&
+	    atomic_inc_return(&htab->count) > htab->map.max_entries) {
+		/* if elem with this 'key' doesn't exist and we've reached
+		 * max_entries limit, fail insertion of new elem
+		 */
+		err = -E2BIG;
+		goto dec_count;
+	}
+
+	if (htab_is_prealloc(htab)) {
+		node = pcpu_freelist_pop(&htab->freelist);
+		if (!node) {
+			err = -E2BIG;
+			goto dec_count;
+		}
+		l_new = container_of(node, struct htab_elem, fnode);
+	} else {
+		l_new = kmalloc(htab->elem_size, GFP_ATOMIC | __GFP_NOWARN);
+		if (!l_new)
+			goto dec_count;
+	}
+
+	memcpy(l_new->key, key, key_size);
+	if (percpu) {
+		if (htab_is_prealloc(htab)) {
+			pptr = htab_elem_get_ptr(l_new, key_size);
+			/* a reused element still has the values of its
+			 * previous key on the other cpus
+			 */
+			if (!onallcpus)
+				for_each_possible_cpu(cpu)
+					memset(per_cpu_ptr(pptr, cpu), 0, size);
+		} else {
+			/* per_cpu areas are zero-filled, so cpus other
+			 * than this one start out with a zeroed value
+			 */
+			pptr = __alloc_percpu_gfp(size, 8,
+						  GFP_ATOMIC | __GFP_NOWARN);
+			if (!pptr) {
+				kfree(l_new);
+				goto dec_count;
+			}
+			htab_elem_set_ptr(l_new, key_size, pptr);
+		}
+		pcpu_copy_value(htab, pptr, value, onallcpus);
+	} else {
+		memcpy(l_new->key + round_up(key_size, 8), value,
+		       htab->map.value_size);
+	}
+
+	l_new->hash = hash;
+	return l_new;
+
+dec_count:
+	if (!old_elem_exists)
+		atomic_dec(&htab->count);
+	return ERR_PTR(err);
+}
+
+static int check_flags(struct htab_elem *l_old, u64 map_flags)
+{
+	if (l_old && map_flags == BPF_NOEXIST)
+		/* elem already exists */
+		return -EEXIST;
+
+	if (!l_old && map_flags == BPF_EXIST)
+		/* elem doesn't exist, cannot update it */
+		return -ENOENT;
+
+	return 0;
+}
+
 /* Called from syscall or from eBPF program */
 static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 				u64 map_flags)
@@ -208,7 +533,8 @@ static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 	struct htab_elem *l_new, *l_old;
 	struct hlist_head *head;
 	unsigned long flags;
-	u32 key_size;
+	struct bucket *b;
+	u32 key_size, hash;
 	int ret;
 
 	if (map_flags > BPF_EXIST)
@@ -217,42 +543,27 @@ static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 
 	WARN_ON_ONCE(!rcu_read_lock_held());
 
-	/* allocate new element outside of lock */
-	l_new = kmalloc(htab->elem_size, GFP_ATOMIC);
-	if (!l_new)
-		return -ENOMEM;
-
 	key_size = map->key_size;
 
-	memcpy(l_new->key, key, key_size);
-	memcpy(l_new->key + round_up(key_size, 8), value, map->value_size);
+	hash = htab_map_hash(key, key_size);
 
-	l_new->hash = htab_map_hash(l_new->key, key_size);
+	b = __select_bucket(htab, hash);
+	head = &b->head;
 
 	/* bpf_map_update_elem() can be called in_irq() */
-	spin_lock_irqsave(&htab->lock, flags);
-
-	head = select_bucket(htab, l_new->hash);
+	raw_spin_lock_irqsave(&b->lock, flags);
 
-	l_old = lookup_elem_raw(head, l_new->hash, key, key_size);
+	l_old = lookup_elem_raw(head, hash, key, key_size);
 
-	if (!l_old && unlikely(htab->count >= map->max_entries)) {
-		/* if elem with this 'key' doesn't exist and we've reached
-		 * max_entries limit, fail insertion of new elem
-		 */
-		ret = -E2BIG;
-		goto err;
-	}
-
-	if (l_old && map_flags == BPF_NOEXIST) {
-		/* elem already exists */
-		ret = -EEXIST;
+	ret = check_flags(l_old, map_flags);
+	if (ret)
 		goto err;
-	}
 
-	if (!l_old && map_flags == BPF_EXIST) {
-		/* elem doesn't exist, cannot update it */
-		ret = -ENOENT;
+	l_new = alloc_htab_elem(htab, key, value, key_size, hash, false, false,
+				!!l_old);
+	if (IS_ERR(l_new)) {
+		/* all pre-allocated elements are in use or memory exhausted */
+		ret = PTR_ERR(l_new);
 		goto err;
 	}
 
@@ -262,16 +573,88 @@ static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 	hlist_add_head_rcu(&l_new->hash_node, head);
 	if (l_old) {
 		hlist_del_rcu(&l_old->hash_node);
-		kfree_rcu(l_old, rcu);
-	} else {
-		htab->count++;
+		free_htab_elem(htab, l_old);
 	}
-	spin_unlock_irqrestore(&htab->lock, flags);
+	ret = 0;
+err:
+	raw_spin_unlock_irqrestore(&b->lock, flags);
+	return ret;
+}
 
-	return 0;
+/* Existing elements are updated in place: from an eBPF program only this
+ * cpu's copy is written, which is what makes the map scale, from syscall
+ * the values of all cpus are replaced.
+ */
+static int __htab_percpu_map_update_elem(struct bpf_map *map, void *key,
+					 void *value, u64 map_flags,
+					 bool onallcpus)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+	struct htab_elem *l_new, *l_old;
+	struct hlist_head *head;
+	unsigned long flags;
+	struct bucket *b;
+	u32 key_size, hash;
+	int ret;
+
+	if (map_flags > BPF_EXIST)
+		/* unknown flags */
+		return -EINVAL;
+
+	WARN_ON_ONCE(!rcu_read_lock_held());
+
+	key_size = map->key_size;
+
+	hash = htab_map_hash(key, key_size);
+
+	b = __select_bucket(htab, hash);
+	head = &b->head;
+
+	/* bpf_map_update_elem() can be called in_irq() */
+	raw_spin_lock_irqsave(&b->lock, flags);
+
+	l_old = lookup_elem_raw(head, hash, key, key_size);
+
+	ret = check_flags(l_old, map_flags);
+	if (ret)
+		goto err;
+
+	if (l_old) {
+		/* per-cpu hash map can update value in-place */
+		pcpu_copy_value(htab, htab_elem_get_ptr(l_old, key_size),
+				value, onallcpus);
+	} else {
+		l_new = alloc_htab_elem(htab, key, value, key_size, hash,
+					true, onallcpus, false);
+		if (IS_ERR(l_new)) {
+			ret = PTR_ERR(l_new);
+			goto err;
+		}
+		hlist_add_head_rcu(&l_new->hash_node, head);
+	}
+	ret = 0;
 err:
-	spin_unlock_irqrestore(&htab->lock, flags);
-	kfree(l_new);
+	raw_spin_unlock_irqrestore(&b->lock, flags);
+	return ret;
+}
+
+/* Called from eBPF program */
+static int htab_percpu_map_update_elem(struct bpf_map *map, void *key,
+				       void *value, u64 map_flags)
+{
+	return __htab_percpu_map_update_elem(map, key, value, map_flags, false);
+}
+
+/* Called from syscall */
+int bpf_percpu_hash_update(struct bpf_map *map, void *key, void *value,
+			   u64 map_flags)
+{
+	int ret;
+
+	rcu_read_lock();
+	ret = __htab_percpu_map_update_elem(map, key, value, map_flags, true);
+	rcu_read_unlock();
+
 	return ret;
 }
 
@@ -280,6 +663,7 @@ static int htab_map_delete_elem(struct bpf_map *map, void *key)
 {
 	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
 	struct hlist_head *head;
+	struct bucket *b;
 	struct htab_elem *l;
 	unsigned long flags;
 	u32 hash, key_size;
@@ -290,24 +674,189 @@ static int htab_map_delete_elem(struct bpf_map *map, void *key)
 	key_size = map->key_size;
 
 	hash = htab_map_hash(key, key_size);
+	b = __select_bucket(htab, hash);
+	head = &b->head;
 
-	spin_lock_irqsave(&htab->lock, flags);
-
-	head = select_bucket(htab, hash);
+	raw_spin_lock_irqsave(&b->lock, flags);
 
 	l = lookup_elem_raw(head, hash, key, key_size);
 
 	if (l) {
 		hlist_del_rcu(&l->hash_node);
-		htab->count--;
-		kfree_rcu(l, rcu);
+		atomic_dec(&htab->count);
+		free_htab_elem(htab, l);
 		ret = 0;
 	}
 
-	spin_unlock_irqrestore(&htab->lock, flags);
+	raw_spin_unlock_irqrestore(&b->lock, flags);
 	return ret;
 }
 
+/* Called from syscall. The batch position is the index of the next bucket
+ * to copy; a bucket is always copied as a whole, under its lock, into
+ * kernel buffers first, since the user copy may fault.
+ */
+static int __htab_map_lookup_batch(struct bpf_map *map,
+				   const union bpf_attr *attr,
+				   union bpf_attr __user *uattr,
+				   bool do_delete)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+	u32 bucket_cnt, total = 0, max_count, batch = 0, bucket_size = 8;
+	u32 key_size = map->key_size, value_size, size;
+	void *keys = NULL, *values = NULL, *dst_key, *dst_val;
+	void __user *ubatch, *ukeys, *uvalues;
+	bool percpu = htab_is_percpu(htab);
+	struct hlist_node *n;
+	struct htab_elem *l;
+	unsigned long flags;
+	struct bucket *b;
+	int ret = 0, cpu;
+
+	if (attr->batch.elem_flags || attr->batch.flags)
+		return -EINVAL;
+
+	max_count = attr->batch.count;
+	if (!max_count)
+		return 0;
+
+	ubatch = (void __user *) (unsigned long) attr->batch.in_batch;
+	if (ubatch && copy_from_user(&batch, ubatch, sizeof(batch)))
+		return -EFAULT;
+
+	if (batch >= htab->n_buckets)
+		return -ENOENT;
+
+	ukeys = (void __user *) (unsigned long) attr->batch.keys;
+	uvalues = (void __user *) (unsigned long) attr->batch.values;
+
+	size = round_up(map->value_size, 8);
+	if (percpu)
+		value_size = size * num_possible_cpus();
+	else
+		value_size = map->value_size;
+
+alloc:
+	keys = kmalloc(key_size * bucket_size, GFP_USER | __GFP_NOWARN);
+	values = kmalloc(value_size * bucket_size, GFP_USER | __GFP_NOWARN);
+	if (!keys || !values) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+again:
+	b = &htab->buckets[batch];
+	if (do_delete) {
+		preempt_disable();
+		__this_cpu_inc(bpf_prog_active);
+	}
+	rcu_read_lock();
+	raw_spin_lock_irqsave(&b->lock, flags);
+
+	bucket_cnt = 0;
+	hlist_for_each_entry(l, &b->head, hash_node)
+		bucket_cnt++;
+
+	if (bucket_cnt > max_count - total || bucket_cnt > bucket_size) {
+		raw_spin_unlock_irqrestore(&b->lock, flags);
+		rcu_read_unlock();
+		if (do_delete) {
+			__this_cpu_dec(bpf_prog_active);
+			preempt_enable();
+		}
+
+		if (bucket_cnt > max_count - total) {
+			/* resume from this bucket next time */
+			if (!total)
+				ret = -ENOSPC;
+			goto after_loop;
+		}
+
+		/* bucket didn't fit into the buffers, grow them and retry */
+		bucket_size = bucket_cnt;
+		kfree(keys);
+		kfree(values);
+		goto alloc;
+	}
+
+	dst_key = keys;
+	dst_val = values;
+	hlist_for_each_entry_safe(l, n, &b->head, hash_node) {
+		memcpy(dst_key, l->key, key_size);
+		if (percpu) {
+			void __percpu *pptr = htab_elem_get_ptr(l, key_size);
+			int off = 0;
+
+			for_each_possible_cpu(cpu) {
+				memcpy(dst_val + off, per_cpu_ptr(pptr, cpu),
+				       size);
+				off += size;
+			}
+		} else {
+			memcpy(dst_val, l->key + round_up(key_size, 8),
+			       value_size);
+		}
+
+		if (do_delete) {
+			hlist_del_rcu(&l->hash_node);
+			atomic_dec(&htab->count);
+			free_htab_elem(htab, l);
+		}
+		dst_key += key_size;
+		dst_val += value_size;
+	}
+
+	raw_spin_unlock_irqrestore(&b->lock, flags);
+	rcu_read_unlock();
+	if (do_delete) {
+		__this_cpu_dec(bpf_prog_active);
+		preempt_enable();
+	}
+
+	if (bucket_cnt &&
+	    (copy_to_user(ukeys + total * key_size, keys,
+			  key_size * bucket_cnt) ||
+	     copy_to_user(uvalues + total * value_size, values,
+			  value_size * bucket_cnt))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	total += bucket_cnt;
+	batch++;
+	if (batch >= htab->n_buckets) {
+		ret = -ENOENT;
+		goto after_loop;
+	}
+	cond_resched();
+	goto again;
+
+after_loop:
+	ubatch = (void __user *) (unsigned long) attr->batch.out_batch;
+	if (copy_to_user(ubatch, &batch, sizeof(batch)) ||
+	    put_user(total, &uattr->batch.count))
+		ret = -EFAULT;
+
+out:
+	kfree(keys);
+	kfree(values);
+	return ret;
+}
+
+static int htab_map_lookup_batch(struct bpf_map *map,
+				 const union bpf_attr *attr,
+				 union bpf_attr __user *uattr)
+{
+	return __htab_map_lookup_batch(map, attr, uattr, false);
+}
+
+static int htab_map_lookup_and_delete_batch(struct bpf_map *map,
+					    const union bpf_attr *attr,
+					    union bpf_attr __user *uattr)
+{
+	return __htab_map_lookup_batch(map, attr, uattr, true);
+}
+
 static void delete_all_elements(struct bpf_htab *htab)
 {
 	int i;
@@ -319,8 +868,8 @@ static void delete_all_elements(struct bpf_htab *htab)
 
 		hlist_for_each_entry_safe(l, n, head, hash_node) {
 			hlist_del_rcu(&l->hash_node);
-			htab->count--;
-			kfree(l);
+			atomic_dec(&htab->count);
+			htab_elem_free(htab, l);
 		}
 	}
 }
@@ -337,10 +886,16 @@ static void htab_map_free(struct bpf_map *map)
 	 */
 	synchronize_rcu();
 
-	/* some of kfree_rcu() callbacks for elements of this map may not have
-	 * executed. It's ok. Proceed to free residual elements and map itself
+	/* some of free_htab_elem() callbacks for elements of this map may
+	 * not have executed. It's ok. Proceed to free residual elements and
+	 * map itself; preallocated elements all go away with the pool
 	 */
-	delete_all_elements(htab);
+	if (htab_is_prealloc(htab)) {
+		htab_free_elems(htab);
+		pcpu_freelist_destroy(&htab->freelist);
+	} else {
+		delete_all_elements(htab);
+	}
 	kvfree(htab->buckets);
 	kfree(htab);
 }
@@ -352,6 +907,10 @@ static const struct bpf_map_ops htab_ops = {
 	.map_lookup_elem = htab_map_lookup_elem,
 	.map_update_elem = htab_map_update_elem,
 	.map_delete_elem = htab_map_delete_elem,
+	.map_lookup_batch = htab_map_lookup_batch,
+	.map_lookup_and_delete_batch = htab_map_lookup_and_delete_batch,
+	.map_update_batch = generic_map_update_batch,
+	.map_delete_batch = generic_map_delete_batch,
 };
 
 static struct bpf_map_type_list htab_type __read_mostly = {
@@ -359,9 +918,28 @@ static struct bpf_map_type_list htab_type __read_mostly = {
 	.type = BPF_MAP_TYPE_HASH,
 };
 
+static const struct bpf_map_ops htab_percpu_ops = {
+	.map_alloc = htab_map_alloc,
+	.map_free = htab_map_free,
+	.map_get_next_key = htab_map_get_next_key,
+	.map_lookup_elem = htab_percpu_map_lookup_elem,
+	.map_update_elem = htab_percpu_map_update_elem,
+	.map_delete_elem = htab_map_delete_elem,
+	.map_lookup_batch = htab_map_lookup_batch,
+	.map_lookup_and_delete_batch = htab_map_lookup_and_delete_batch,
+	.map_update_batch = generic_map_update_batch,
+	.map_delete_batch = generic_map_delete_batch,
+};
+
+static struct bpf_map_type_list htab_percpu_type __read_mostly = {
+	.ops = &htab_percpu_ops,
+	.type = BPF_MAP_TYPE_PERCPU_HASH,
+};
+
 static int __init register_htab_map(void)
 {
 	bpf_register_map_type(&htab_type);
+	bpf_register_map_type(&htab_percpu_type);
 	return 0;
 }
 late_initcall(register_htab_map);
@@ -5229,6 +5229,16 @@ static void perf_output_read(struct perf_output_handle *handle,
 		perf_output_read_one(handle, event, enabled, running);
 }
 
+/*
+ * The u32 size of a raw record plus its data have to keep the sample u64
+ * aligned; tracepoints size their records accordingly, arbitrary sized
+ * records (bpf_perf_event_output()) are zero padded.
+ */
+static u32 perf_raw_padded_size(u32 size)
+{
+	return round_up(size + sizeof(u32), sizeof(u64)) - sizeof(u32);
+}
+
 void perf_output_sample(struct perf_output_handle *handle,
 			struct perf_event_header *header,
 			struct perf_sample_data *data,
@@ -5286,9 +5296,14 @@ void perf_output_sample(struct perf_output_handle *handle,
 
 	if (sample_type & PERF_SAMPLE_RAW) {
 		if (data->raw) {
-			perf_output_put(handle, data->raw->size);
-			__output_copy(handle, data->raw->data,
-					   data->raw->size);
+			u32 raw_size = data->raw->size;
+			u32 size = perf_raw_padded_size(raw_size);
+			u64 zero = 0;
+
+			perf_output_put(handle, size);
+			__output_copy(handle, data->raw->data, raw_size);
+			if (size != raw_size)
+				__output_copy(handle, &zero, size - raw_size);
 		} else {
 			struct {
 				u32	size;
@@ -5416,11 +5431,10 @@ void perf_prepare_sample(struct perf_event_header *header,
 		int size = sizeof(u32);
 
 		if (data->raw)
-			size += data->raw->size;
+			size += perf_raw_padded_size(data->raw->size);
 		else
 			size += sizeof(u32);
 
-		WARN_ON_ONCE(size & (sizeof(u64)-1));
 		header->size += size;
 	}
 
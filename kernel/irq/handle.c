@@ -15,6 +15,7 @@
 #include <linux/sched.h>
 #include <linux/interrupt.h>
 #include <linux/kernel_stat.h>
+#include <linux/tick.h>
 
 #include <trace/events/irq.h>
 
@@ -129,6 +130,15 @@ void __irq_wake_thread(struct irq_desc *desc, struct irqaction *action)
 	 */
 	atomic_inc(&desc->threads_active);
 
+	/*
+	 * An IRQF_THREAD_POLL thread which is still polling picks up
+	 * IRQTF_RUNTHREAD by itself, so spare the wakeup. The
+	 * test_and_set_bit() above orders the RUNTHREAD store against
+	 * this load and pairs with the barrier in irq_thread_poll().
+	 */
+	if (test_bit(IRQTF_POLLING, &action->thread_flags))
+		return;
+
 	wake_up_process(action->thread);
 }
 
@@ -138,6 +148,9 @@ handle_irq_event_percpu(struct irq_desc *desc, struct irqaction *action)
 	irqreturn_t retval = IRQ_NONE;
 	unsigned int flags = 0, irq = desc->irq_data.irq;
 
+	record_irq_time(desc);
+	tick_nohz_full_interrupt("irq", irq);
+
 	do {
 		irqreturn_t res;
 
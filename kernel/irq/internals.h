@@ -7,6 +7,7 @@
  */
 #include <linux/irqdesc.h>
 #include <linux/kernel_stat.h>
+#include <linux/static_key.h>
 
 #ifdef CONFIG_SPARSE_IRQ
 # define IRQ_BITMAP_BITS	(NR_IRQS + 8196)
@@ -24,12 +25,14 @@ extern bool noirqdebug;
  * IRQTF_WARNED    - warning "IRQ_WAKE_THREAD w/o thread_fn" has been printed
  * IRQTF_AFFINITY  - irq thread is requested to adjust affinity
  * IRQTF_FORCED_THREAD  - irq action is force threaded
+ * IRQTF_POLLING   - IRQF_THREAD_POLL thread is awake and polls IRQTF_RUNTHREAD
  */
 enum {
 	IRQTF_RUNTHREAD,
 	IRQTF_WARNED,
 	IRQTF_AFFINITY,
 	IRQTF_FORCED_THREAD,
+	IRQTF_POLLING,
 };
 
 /*
@@ -208,3 +211,17 @@ irq_pm_install_action(struct irq_desc *desc, struct irqaction *action) { }
 static inline void
 irq_pm_remove_action(struct irq_desc *desc, struct irqaction *action) { }
 #endif
+
+#ifdef CONFIG_IRQ_TIMINGS
+extern struct static_key irq_timing_enabled;
+
+void __irq_timings_record(unsigned int irq, u64 ts);
+
+static inline void record_irq_time(struct irq_desc *desc)
+{
+	if (static_key_false(&irq_timing_enabled))
+		__irq_timings_record(irq_desc_get_irq(desc), local_clock());
+}
+#else
+static inline void record_irq_time(struct irq_desc *desc) { }
+#endif /* CONFIG_IRQ_TIMINGS */
@@ -32,6 +32,10 @@ static int __init setup_forced_irqthreads(char *arg)
 early_param("threadirqs", setup_forced_irqthreads);
 #endif
 
+/* How long IRQF_THREAD_POLL threads poll for a new interrupt */
+static unsigned int irqthread_poll_us = 50;
+core_param(irqthread_poll_us, irqthread_poll_us, uint, 0644);
+
 static void __synchronize_hardirq(struct irq_desc *desc)
 {
 	bool inprogress;
@@ -140,15 +144,19 @@ int irq_can_set_affinity(unsigned int irq)
  *	We just set IRQTF_AFFINITY and delegate the affinity setting
  *	to the interrupt thread itself. We can not call
  *	set_cpus_allowed_ptr() here as we hold desc->lock and this
- *	code can be called from hard interrupt context.
+ *	code can be called from hard interrupt context. Kick the thread
+ *	so it follows the new affinity right away instead of running
+ *	the next interrupt on the old CPU.
  */
 void irq_set_thread_affinity(struct irq_desc *desc)
 {
 	struct irqaction *action = desc->action;
 
 	while (action) {
-		if (action->thread)
+		if (action->thread) {
 			set_bit(IRQTF_AFFINITY, &action->thread_flags);
+			wake_up_process(action->thread);
+		}
 		action = action->next;
 	}
 }
@@ -730,24 +738,6 @@ static irqreturn_t irq_nested_primary_handler(int irq, void *dev_id)
 	return IRQ_NONE;
 }
 
-static int irq_wait_for_interrupt(struct irqaction *action)
-{
-	set_current_state(TASK_INTERRUPTIBLE);
-
-	while (!kthread_should_stop()) {
-
-		if (test_and_clear_bit(IRQTF_RUNTHREAD,
-				       &action->thread_flags)) {
-			__set_current_state(TASK_RUNNING);
-			return 0;
-		}
-		schedule();
-		set_current_state(TASK_INTERRUPTIBLE);
-	}
-	__set_current_state(TASK_RUNNING);
-	return -1;
-}
-
 /*
  * Oneshot interrupts keep the irq line masked until the threaded
  * handler finished. unmask if the interrupt has not been disabled and
@@ -841,9 +831,71 @@ irq_thread_check_affinity(struct irq_desc *desc, struct irqaction *action)
 }
 #else
 static inline void
-irq_thread_check_affinity(struct irq_desc *desc, struct irqaction *action) { }
+irq_thread_check_affinity(struct irq_desc *desc, struct irqaction *action)
+{
+	clear_bit(IRQTF_AFFINITY, &action->thread_flags);
+}
 #endif
 
+/*
+ * Busy poll for the next interrupt of an IRQF_THREAD_POLL action, like
+ * NAPI does, instead of paying for a sleep and a wakeup per interrupt.
+ * Returns true if one arrived within irqthread_poll_us.
+ */
+static bool irq_thread_poll(struct irqaction *action)
+{
+	u64 end = local_clock() +
+		  (u64)READ_ONCE(irqthread_poll_us) * NSEC_PER_USEC;
+
+	do {
+		if (test_and_clear_bit(IRQTF_RUNTHREAD, &action->thread_flags))
+			return true;
+		cpu_relax();
+	} while (!need_resched() && !kthread_should_stop() &&
+		 !test_bit(IRQTF_AFFINITY, &action->thread_flags) &&
+		 local_clock() < end);
+
+	/*
+	 * From here on the hard irq handler has to wake us again. Order
+	 * the clear against the IRQTF_RUNTHREAD check below, pairs with
+	 * __irq_wake_thread().
+	 */
+	clear_bit(IRQTF_POLLING, &action->thread_flags);
+	smp_mb__after_atomic();
+	return false;
+}
+
+static int irq_wait_for_interrupt(struct irq_desc *desc,
+				  struct irqaction *action)
+{
+	if (test_bit(IRQTF_POLLING, &action->thread_flags) &&
+	    irq_thread_poll(action))
+		return 0;
+
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	while (!kthread_should_stop()) {
+
+		if (test_and_clear_bit(IRQTF_RUNTHREAD,
+				       &action->thread_flags)) {
+			__set_current_state(TASK_RUNNING);
+			if (action->flags & IRQF_THREAD_POLL)
+				set_bit(IRQTF_POLLING, &action->thread_flags);
+			return 0;
+		}
+		/* Follow an affinity change without waiting for an irq */
+		if (test_bit(IRQTF_AFFINITY, &action->thread_flags)) {
+			__set_current_state(TASK_RUNNING);
+			irq_thread_check_affinity(desc, action);
+			set_current_state(TASK_INTERRUPTIBLE);
+		}
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return -1;
+}
+
 /*
  * Interrupts which are not explicitely requested as threaded
  * interrupts rely on the implicit bh/preempt disable of the hard irq
@@ -932,7 +984,7 @@ static int irq_thread(void *data)
 
 	irq_thread_check_affinity(desc, action);
 
-	while (!irq_wait_for_interrupt(action)) {
+	while (!irq_wait_for_interrupt(desc, action)) {
 		irqreturn_t action_ret;
 
 		irq_thread_check_affinity(desc, action);
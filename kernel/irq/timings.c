@@ -0,0 +1,156 @@
+/*
+ * linux/kernel/irq/timings.c
+ *
+ * Per-CPU tracking of device interrupt arrival times, so that cpuidle
+ * governors can predict the next wakeup caused by a periodic interrupt
+ * the same way they use the next timer expiry.
+ *
+ * Each CPU keeps a small table of the interrupts it handled most
+ * recently, with a running average of their period and of the deviation
+ * from it. Only sources whose period is stable are used for prediction.
+ */
+
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/static_key.h>
+
+#include "internals.h"
+
+#define IRQT_SOURCES		8	/* interrupts tracked per CPU */
+#define IRQT_MIN_SAMPLES	4	/* intervals needed before predicting */
+#define IRQT_EWMA_SHIFT		3	/* weight of a new interval: 1/8 */
+#define IRQT_MAX_INTERVAL	NSEC_PER_SEC
+
+struct irqt_source {
+	unsigned int	irq;
+	unsigned int	samples;
+	u64		last_ts;
+	u64		avg;		/* average interval, in ns */
+	u64		dev;		/* average deviation from avg, in ns */
+};
+
+struct irqt_cpu {
+	struct irqt_source	src[IRQT_SOURCES];
+	u64			last_ts;	/* latest interrupt on this CPU */
+};
+
+static DEFINE_PER_CPU(struct irqt_cpu, irq_timings);
+
+struct static_key irq_timing_enabled = STATIC_KEY_INIT_FALSE;
+
+static inline u64 irqt_ewma(u64 avg, u64 sample)
+{
+	return avg - (avg >> IRQT_EWMA_SHIFT) + (sample >> IRQT_EWMA_SHIFT);
+}
+
+/* Called from handle_irq_event_percpu() with interrupts disabled */
+void __irq_timings_record(unsigned int irq, u64 ts)
+{
+	struct irqt_cpu *t = this_cpu_ptr(&irq_timings);
+	struct irqt_source *s, *victim = &t->src[0];
+	u64 interval, diff;
+	int i;
+
+	t->last_ts = ts;
+
+	for (i = 0; i < IRQT_SOURCES; i++) {
+		s = &t->src[i];
+		if (s->last_ts && s->irq == irq)
+			goto found;
+		if (s->last_ts < victim->last_ts)
+			victim = s;
+	}
+
+	/* Not tracked yet, replace the least recently seen source */
+	victim->irq = irq;
+	victim->samples = 0;
+	victim->last_ts = ts;
+	return;
+
+found:
+	interval = ts - s->last_ts;
+	s->last_ts = ts;
+
+	/* A long silence breaks the period, start learning again */
+	if (interval > IRQT_MAX_INTERVAL) {
+		s->samples = 0;
+		return;
+	}
+
+	if (!s->samples) {
+		s->avg = interval;
+		s->dev = 0;
+		s->samples = 1;
+		return;
+	}
+
+	diff = interval > s->avg ? interval - s->avg : s->avg - interval;
+	s->avg = irqt_ewma(s->avg, interval);
+	s->dev = irqt_ewma(s->dev, diff);
+	if (s->samples < IRQT_MIN_SAMPLES)
+		s->samples++;
+}
+
+/**
+ * irq_timings_next_event - predict the next periodic interrupt on this CPU
+ * @now: current local_clock() time
+ *
+ * Returns the time in ns until the earliest interrupt expected from a
+ * source with a stable period, or U64_MAX if there is none. A source that
+ * stayed silent for more than a period past its due time is ignored.
+ *
+ * Must be called with interrupts disabled.
+ */
+u64 irq_timings_next_event(u64 now)
+{
+	struct irqt_cpu *t = this_cpu_ptr(&irq_timings);
+	u64 expected, next = U64_MAX;
+	int i;
+
+	for (i = 0; i < IRQT_SOURCES; i++) {
+		struct irqt_source *s = &t->src[i];
+
+		if (s->samples < IRQT_MIN_SAMPLES)
+			continue;
+
+		/* Jitter above 1/8 of the period is not worth predicting */
+		if (s->dev > (s->avg >> 3))
+			continue;
+
+		expected = s->last_ts + s->avg;
+		if (expected <= now) {
+			if (now - expected > s->avg)
+				continue;
+			return 0;
+		}
+
+		if (expected - now < next)
+			next = expected - now;
+	}
+
+	return next;
+}
+
+/**
+ * irq_timings_last_event - time of the latest interrupt on this CPU
+ *
+ * Returns the local_clock() time at which this CPU last handled a device
+ * interrupt, or 0 if none was recorded. Must be called with interrupts
+ * disabled.
+ */
+u64 irq_timings_last_event(void)
+{
+	return this_cpu_ptr(&irq_timings)->last_ts;
+}
+
+void irq_timings_enable(void)
+{
+	static_key_slow_inc(&irq_timing_enabled);
+}
+
+void irq_timings_disable(void)
+{
+	static_key_slow_dec(&irq_timing_enabled);
+}
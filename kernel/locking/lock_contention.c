@@ -0,0 +1,233 @@
+/*
+ * Sampling lock contention profiler
+ *
+ * A production friendly subset of lock_stat: it does not need lockdep
+ * and only ever runs when a spinlock, mutex or rwsem acquisition is
+ * contended. The hooks are in the lock entry points, so this covers every
+ * spinlock implementation, and the callsite is that of the lock user.
+ * One in sample_rate contended acquisitions per CPU is timed; the
+ * wait time goes into a per-cpu log2 histogram and, together with the
+ * lock address and the contending callsite, out through the
+ * contention_begin/contention_end tracepoints.
+ *
+ *   /sys/kernel/debug/lock_contention/sample_rate	0 (off) or N
+ *   /sys/kernel/debug/lock_contention/histogram	write anything to reset
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/debugfs.h>
+#include <linux/export.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/lock_contention.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/lock_contention.h>
+
+/* bucket i holds waits in [2^(i-1), 2^i) ns, the last one everything above */
+#define LC_NR_BUCKETS	32
+
+struct lock_contention_hist {
+	unsigned long	count[LOCK_CONTENTION_NR_TYPES][LC_NR_BUCKETS];
+};
+
+static const char * const lc_type_names[LOCK_CONTENTION_NR_TYPES] = {
+	[LOCK_CONTENTION_SPIN]		= "spin",
+	[LOCK_CONTENTION_MUTEX]		= "mutex",
+	[LOCK_CONTENTION_RWSEM_READ]	= "rwsem_read",
+	[LOCK_CONTENTION_RWSEM_WRITE]	= "rwsem_write",
+};
+
+struct static_key lock_contention_enabled = STATIC_KEY_INIT_FALSE;
+EXPORT_SYMBOL(lock_contention_enabled);
+
+static DEFINE_MUTEX(lc_mutex);
+static unsigned int lc_sample_rate;
+static DEFINE_PER_CPU(int, lc_countdown);
+static DEFINE_PER_CPU(struct lock_contention_hist, lc_hist);
+
+/*
+ * Can be called with preemption and interrupts in any state, including
+ * from inside the spinlock contention path itself, so no locks may be taken
+ * here and per-cpu state is only touched with this_cpu ops.
+ */
+u64 __lock_contention_begin(void *lock, unsigned long ip, int type)
+{
+	unsigned int rate = READ_ONCE(lc_sample_rate);
+
+	if (!rate)
+		return 0;
+
+	if (this_cpu_dec_return(lc_countdown) > 0)
+		return 0;
+	this_cpu_write(lc_countdown, rate);
+
+	trace_contention_begin(lock, ip, type);
+
+	/* 0 means "not sampled" to lock_contention_end() */
+	return local_clock() ?: 1;
+}
+EXPORT_SYMBOL(__lock_contention_begin);
+
+void __lock_contention_end(void *lock, unsigned long ip, int type,
+			   u64 start, int ret)
+{
+	u64 delta = local_clock() - start;
+	int bucket = min_t(int, fls64(delta), LC_NR_BUCKETS - 1);
+
+	this_cpu_inc(lc_hist.count[type][bucket]);
+	trace_contention_end(lock, ip, type, delta, ret);
+}
+EXPORT_SYMBOL(__lock_contention_end);
+
+static ssize_t lc_sample_rate_read(struct file *file, char __user *ubuf,
+				   size_t count, loff_t *ppos)
+{
+	char buf[16];
+	int len;
+
+	len = scnprintf(buf, sizeof(buf), "%u\n", READ_ONCE(lc_sample_rate));
+	return simple_read_from_buffer(ubuf, count, ppos, buf, len);
+}
+
+/*
+ * Set the sample rate, 0 turns the profiler off. Returns the previous
+ * rate.
+ */
+unsigned int lock_contention_set_sample_rate(unsigned int rate)
+{
+	unsigned int old;
+	int cpu;
+
+	mutex_lock(&lc_mutex);
+	old = lc_sample_rate;
+	if (rate && !lc_sample_rate) {
+		for_each_possible_cpu(cpu)
+			per_cpu(lc_countdown, cpu) = rate;
+		WRITE_ONCE(lc_sample_rate, rate);
+		static_key_slow_inc(&lock_contention_enabled);
+	} else if (!rate && lc_sample_rate) {
+		static_key_slow_dec(&lock_contention_enabled);
+		WRITE_ONCE(lc_sample_rate, 0);
+	} else {
+		WRITE_ONCE(lc_sample_rate, rate);
+	}
+	mutex_unlock(&lc_mutex);
+
+	return old;
+}
+EXPORT_SYMBOL_GPL(lock_contention_set_sample_rate);
+
+static ssize_t lc_sample_rate_write(struct file *file, const char __user *ubuf,
+				    size_t count, loff_t *ppos)
+{
+	unsigned int rate;
+	int ret;
+
+	ret = kstrtouint_from_user(ubuf, count, 0, &rate);
+	if (ret)
+		return ret;
+
+	lock_contention_set_sample_rate(rate);
+
+	return count;
+}
+
+static const struct file_operations lc_sample_rate_fops = {
+	.read		= lc_sample_rate_read,
+	.write		= lc_sample_rate_write,
+	.llseek		= default_llseek,
+};
+
+static unsigned long lc_hist_sum(int type, unsigned long *sum)
+{
+	unsigned long total = 0;
+	int bucket, cpu;
+
+	memset(sum, 0, LC_NR_BUCKETS * sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		struct lock_contention_hist *h = per_cpu_ptr(&lc_hist, cpu);
+
+		for (bucket = 0; bucket < LC_NR_BUCKETS; bucket++)
+			sum[bucket] += READ_ONCE(h->count[type][bucket]);
+	}
+	for (bucket = 0; bucket < LC_NR_BUCKETS; bucket++)
+		total += sum[bucket];
+
+	return total;
+}
+
+static int lc_hist_show(struct seq_file *m, void *v)
+{
+	unsigned long sum[LC_NR_BUCKETS], total;
+	u64 lo, hi;
+	int type, i;
+
+	for (type = 0; type < LOCK_CONTENTION_NR_TYPES; type++) {
+		total = lc_hist_sum(type, sum);
+		seq_printf(m, "%s: %lu samples\n", lc_type_names[type], total);
+
+		for (i = 0; total && i < LC_NR_BUCKETS; i++) {
+			if (!sum[i])
+				continue;
+			lo = i ? 1ULL << (i - 1) : 0;
+			hi = (1ULL << i) - 1;
+			if (i == LC_NR_BUCKETS - 1)
+				seq_printf(m, "  %12llu - %12s ns: %lu\n",
+					   lo, "inf", sum[i]);
+			else
+				seq_printf(m, "  %12llu - %12llu ns: %lu\n",
+					   lo, hi, sum[i]);
+		}
+	}
+
+	return 0;
+}
+
+static int lc_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lc_hist_show, NULL);
+}
+
+static ssize_t lc_hist_write(struct file *file, const char __user *ubuf,
+			     size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&lc_hist, cpu), 0,
+		       sizeof(struct lock_contention_hist));
+
+	return count;
+}
+
+static const struct file_operations lc_hist_fops = {
+	.open		= lc_hist_open,
+	.read		= seq_read,
+	.write		= lc_hist_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init lock_contention_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("lock_contention", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	debugfs_create_file("sample_rate", 0644, dir, NULL,
+			    &lc_sample_rate_fops);
+	debugfs_create_file("histogram", 0644, dir, NULL, &lc_hist_fops);
+
+	return 0;
+}
+late_initcall(lock_contention_debugfs_init);
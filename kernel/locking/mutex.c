@@ -26,6 +26,7 @@
 #include <linux/interrupt.h>
 #include <linux/debug_locks.h>
 #include <linux/osq_lock.h>
+#include <linux/lock_contention.h>
 
 /*
  * In the DEBUG case we are using the "NULL fastpath" for mutexes,
@@ -69,7 +70,8 @@ EXPORT_SYMBOL(__mutex_init);
  * We also put the fastpath first in the kernel image, to make sure the
  * branch is predicted by the CPU as default-untaken.
  */
-__visible void __sched __mutex_lock_slowpath(atomic_t *lock_count);
+static noinline void __sched
+__mutex_lock_slowpath(struct mutex *lock, unsigned long ip);
 
 /**
  * mutex_lock - acquire the mutex
@@ -97,9 +99,11 @@ void __sched mutex_lock(struct mutex *lock)
 	might_sleep();
 	/*
 	 * The locking fastpath is the 1->0 transition from
-	 * 'unlocked' into 'locked' state.
+	 * 'unlocked' into 'locked' state. The slowpath is passed our
+	 * caller, for the contention profiler.
 	 */
-	__mutex_fastpath_lock(&lock->count, __mutex_lock_slowpath);
+	if (unlikely(__mutex_fastpath_lock_retval(&lock->count)))
+		__mutex_lock_slowpath(lock, _RET_IP_);
 	mutex_set_owner(lock);
 }
 
@@ -512,6 +516,7 @@ __mutex_lock_common(struct mutex *lock, long state, unsigned int subclass,
 	struct task_struct *task = current;
 	struct mutex_waiter waiter;
 	unsigned long flags;
+	u64 wait_start;
 	int ret;
 
 	preempt_disable();
@@ -540,6 +545,7 @@ __mutex_lock_common(struct mutex *lock, long state, unsigned int subclass,
 	waiter.task = task;
 
 	lock_contended(&lock->dep_map, ip);
+	wait_start = lock_contention_begin(lock, ip, LOCK_CONTENTION_MUTEX);
 
 	for (;;) {
 		/*
@@ -579,6 +585,7 @@ __mutex_lock_common(struct mutex *lock, long state, unsigned int subclass,
 		spin_lock_mutex(&lock->wait_lock, flags);
 	}
 	__set_task_state(task, TASK_RUNNING);
+	lock_contention_end(lock, ip, LOCK_CONTENTION_MUTEX, wait_start, 0);
 
 	mutex_remove_waiter(lock, &waiter, current_thread_info());
 	/* set it to 0 if there are no waiters left: */
@@ -601,6 +608,7 @@ skip_wait:
 	return 0;
 
 err:
+	lock_contention_end(lock, ip, LOCK_CONTENTION_MUTEX, wait_start, ret);
 	mutex_remove_waiter(lock, &waiter, task_thread_info(task));
 	spin_unlock_mutex(&lock->wait_lock, flags);
 	debug_mutex_free_waiter(&waiter);
@@ -766,10 +774,10 @@ __mutex_unlock_slowpath(atomic_t *lock_count)
  * mutex_lock_interruptible() and mutex_trylock().
  */
 static noinline int __sched
-__mutex_lock_killable_slowpath(struct mutex *lock);
+__mutex_lock_killable_slowpath(struct mutex *lock, unsigned long ip);
 
 static noinline int __sched
-__mutex_lock_interruptible_slowpath(struct mutex *lock);
+__mutex_lock_interruptible_slowpath(struct mutex *lock, unsigned long ip);
 
 /**
  * mutex_lock_interruptible - acquire the mutex, interruptible
@@ -792,7 +800,7 @@ int __sched mutex_lock_interruptible(struct mutex *lock)
 		mutex_set_owner(lock);
 		return 0;
 	} else
-		return __mutex_lock_interruptible_slowpath(lock);
+		return __mutex_lock_interruptible_slowpath(lock, _RET_IP_);
 }
 
 EXPORT_SYMBOL(mutex_lock_interruptible);
@@ -807,46 +815,46 @@ int __sched mutex_lock_killable(struct mutex *lock)
 		mutex_set_owner(lock);
 		return 0;
 	} else
-		return __mutex_lock_killable_slowpath(lock);
+		return __mutex_lock_killable_slowpath(lock, _RET_IP_);
 }
 EXPORT_SYMBOL(mutex_lock_killable);
 
-__visible void __sched
-__mutex_lock_slowpath(atomic_t *lock_count)
+static noinline void __sched
+__mutex_lock_slowpath(struct mutex *lock, unsigned long ip)
 {
-	struct mutex *lock = container_of(lock_count, struct mutex, count);
-
 	__mutex_lock_common(lock, TASK_UNINTERRUPTIBLE, 0,
-			    NULL, _RET_IP_, NULL, 0);
+			    NULL, ip, NULL, 0);
 }
 
 static noinline int __sched
-__mutex_lock_killable_slowpath(struct mutex *lock)
+__mutex_lock_killable_slowpath(struct mutex *lock, unsigned long ip)
 {
 	return __mutex_lock_common(lock, TASK_KILLABLE, 0,
-				   NULL, _RET_IP_, NULL, 0);
+				   NULL, ip, NULL, 0);
 }
 
 static noinline int __sched
-__mutex_lock_interruptible_slowpath(struct mutex *lock)
+__mutex_lock_interruptible_slowpath(struct mutex *lock, unsigned long ip)
 {
 	return __mutex_lock_common(lock, TASK_INTERRUPTIBLE, 0,
-				   NULL, _RET_IP_, NULL, 0);
+				   NULL, ip, NULL, 0);
 }
 
 static noinline int __sched
-__ww_mutex_lock_slowpath(struct ww_mutex *lock, struct ww_acquire_ctx *ctx)
+__ww_mutex_lock_slowpath(struct ww_mutex *lock, struct ww_acquire_ctx *ctx,
+			 unsigned long ip)
 {
 	return __mutex_lock_common(&lock->base, TASK_UNINTERRUPTIBLE, 0,
-				   NULL, _RET_IP_, ctx, 1);
+				   NULL, ip, ctx, 1);
 }
 
 static noinline int __sched
 __ww_mutex_lock_interruptible_slowpath(struct ww_mutex *lock,
-					    struct ww_acquire_ctx *ctx)
+					    struct ww_acquire_ctx *ctx,
+					    unsigned long ip)
 {
 	return __mutex_lock_common(&lock->base, TASK_INTERRUPTIBLE, 0,
-				   NULL, _RET_IP_, ctx, 1);
+				   NULL, ip, ctx, 1);
 }
 
 #endif
@@ -922,7 +930,7 @@ __ww_mutex_lock(struct ww_mutex *lock, struct ww_acquire_ctx *ctx)
 		ww_mutex_set_context_fastpath(lock, ctx);
 		mutex_set_owner(&lock->base);
 	} else
-		ret = __ww_mutex_lock_slowpath(lock, ctx);
+		ret = __ww_mutex_lock_slowpath(lock, ctx, _RET_IP_);
 	return ret;
 }
 EXPORT_SYMBOL(__ww_mutex_lock);
@@ -940,7 +948,8 @@ __ww_mutex_lock_interruptible(struct ww_mutex *lock, struct ww_acquire_ctx *ctx)
 		ww_mutex_set_context_fastpath(lock, ctx);
 		mutex_set_owner(&lock->base);
 	} else
-		ret = __ww_mutex_lock_interruptible_slowpath(lock, ctx);
+		ret = __ww_mutex_lock_interruptible_slowpath(lock, ctx,
+							     _RET_IP_);
 	return ret;
 }
 EXPORT_SYMBOL(__ww_mutex_lock_interruptible);
@@ -160,8 +160,17 @@ void percpu_down_write(struct percpu_rw_semaphore *brw)
 	/* nobody can use fast_read_ctr, move its sum into slow_read_ctr */
 	atomic_add(clear_fast_ctr(brw), &brw->slow_read_ctr);
 
-	/* wait for all readers to complete their percpu_up_read() */
-	wait_event(brw->write_waitq, !atomic_read(&brw->slow_read_ctr));
+	/*
+	 * Wait for all readers to complete their percpu_up_read(). Waiting
+	 * for readers is accounted as contention on ->rw_sem, so that it
+	 * shows up in /proc/lock_stat next to the writer vs writer waits
+	 * that down_write() already accounts.
+	 */
+	if (atomic_read(&brw->slow_read_ctr)) {
+		lock_contended(&brw->rw_sem.dep_map, _RET_IP_);
+		wait_event(brw->write_waitq, !atomic_read(&brw->slow_read_ctr));
+		lock_acquired(&brw->rw_sem.dep_map, _RET_IP_);
+	}
 }
 
 void percpu_up_write(struct percpu_rw_semaphore *brw)
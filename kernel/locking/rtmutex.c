@@ -1080,6 +1080,64 @@ void rt_mutex_adjust_pi(struct task_struct *task)
 				   next_lock, NULL, task);
 }
 
+#ifdef CONFIG_SMP
+/*
+ * Adaptive spinning: an owner running on another CPU is likely to release
+ * the lock soon, so the top waiter spins instead of scheduling out, which
+ * saves two context switches on short critical sections. Stop spinning
+ * once the owner is preempted or sleeps, we are no longer the top waiter,
+ * we need to reschedule, or the timeout or a signal has to be handled.
+ *
+ * Returns true if the lock changed hands and should be retried, false if
+ * the waiter should go to sleep.
+ */
+static bool rt_mutex_spin_on_owner(struct rt_mutex *lock, int state,
+				   struct hrtimer_sleeper *timeout,
+				   struct rt_mutex_waiter *waiter,
+				   struct task_struct *owner)
+{
+	bool ret = true;
+
+	rcu_read_lock();
+	for (;;) {
+		unsigned long cur = (unsigned long)READ_ONCE(lock->owner);
+
+		if ((struct task_struct *)(cur & ~RT_MUTEX_OWNER_MASKALL) != owner)
+			break;
+
+		/*
+		 * Ensure we emit the owner->on_cpu dereference _after_
+		 * checking that lock->owner still matches owner. If that
+		 * fails, owner might point to freed memory. If it still
+		 * matches, the rcu_read_lock() ensures the memory stays
+		 * valid.
+		 */
+		barrier();
+
+		if (!owner->on_cpu || need_resched() ||
+		    READ_ONCE(lock->waiters_leftmost) != &waiter->tree_entry ||
+		    (timeout && !READ_ONCE(timeout->task)) ||
+		    signal_pending_state(state, current)) {
+			ret = false;
+			break;
+		}
+
+		cpu_relax_lowlatency();
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+#else
+static inline bool rt_mutex_spin_on_owner(struct rt_mutex *lock, int state,
+					  struct hrtimer_sleeper *timeout,
+					  struct rt_mutex_waiter *waiter,
+					  struct task_struct *owner)
+{
+	return false;
+}
+#endif
+
 /**
  * __rt_mutex_slowlock() - Perform the wait-wake-try-to-take loop
  * @lock:		 the rt_mutex to take
@@ -1095,6 +1153,7 @@ __rt_mutex_slowlock(struct rt_mutex *lock, int state,
 		    struct hrtimer_sleeper *timeout,
 		    struct rt_mutex_waiter *waiter)
 {
+	struct task_struct *owner;
 	int ret = 0;
 
 	for (;;) {
@@ -1116,11 +1175,14 @@ __rt_mutex_slowlock(struct rt_mutex *lock, int state,
 				break;
 		}
 
+		owner = rt_mutex_owner(lock);
 		raw_spin_unlock(&lock->wait_lock);
 
 		debug_rt_mutex_print_deadlock(waiter);
 
-		schedule();
+		if (!owner || !rt_mutex_spin_on_owner(lock, state, timeout,
+						      waiter, owner))
+			schedule();
 
 		raw_spin_lock(&lock->wait_lock);
 		set_current_state(state);
@@ -10,6 +10,7 @@
 #include <linux/export.h>
 #include <linux/rwsem.h>
 #include <linux/atomic.h>
+#include <linux/lock_contention.h>
 
 #include "rwsem.h"
 
@@ -21,7 +22,9 @@ void __sched down_read(struct rw_semaphore *sem)
 	might_sleep();
 	rwsem_acquire_read(&sem->dep_map, 0, 0, _RET_IP_);
 
-	LOCK_CONTENDED(sem, __down_read_trylock, __down_read);
+	LOCK_CONTENTION_PROFILED(sem, __down_read_trylock,
+		LOCK_CONTENTION_RWSEM_READ,
+		LOCK_CONTENDED(sem, __down_read_trylock, __down_read));
 }
 
 EXPORT_SYMBOL(down_read);
@@ -48,7 +51,9 @@ void __sched down_write(struct rw_semaphore *sem)
 	might_sleep();
 	rwsem_acquire(&sem->dep_map, 0, 0, _RET_IP_);
 
-	LOCK_CONTENDED(sem, __down_write_trylock, __down_write);
+	LOCK_CONTENTION_PROFILED(sem, __down_write_trylock,
+		LOCK_CONTENTION_RWSEM_WRITE,
+		LOCK_CONTENDED(sem, __down_write_trylock, __down_write));
 	rwsem_set_owner(sem);
 }
 
@@ -118,7 +123,9 @@ void down_read_nested(struct rw_semaphore *sem, int subclass)
 	might_sleep();
 	rwsem_acquire_read(&sem->dep_map, subclass, 0, _RET_IP_);
 
-	LOCK_CONTENDED(sem, __down_read_trylock, __down_read);
+	LOCK_CONTENTION_PROFILED(sem, __down_read_trylock,
+		LOCK_CONTENTION_RWSEM_READ,
+		LOCK_CONTENDED(sem, __down_read_trylock, __down_read));
 }
 
 EXPORT_SYMBOL(down_read_nested);
@@ -128,7 +135,9 @@ void _down_write_nest_lock(struct rw_semaphore *sem, struct lockdep_map *nest)
 	might_sleep();
 	rwsem_acquire_nest(&sem->dep_map, 0, 0, nest, _RET_IP_);
 
-	LOCK_CONTENDED(sem, __down_write_trylock, __down_write);
+	LOCK_CONTENTION_PROFILED(sem, __down_write_trylock,
+		LOCK_CONTENTION_RWSEM_WRITE,
+		LOCK_CONTENDED(sem, __down_write_trylock, __down_write));
 	rwsem_set_owner(sem);
 }
 
@@ -148,7 +157,9 @@ void down_write_nested(struct rw_semaphore *sem, int subclass)
 	might_sleep();
 	rwsem_acquire(&sem->dep_map, subclass, 0, _RET_IP_);
 
-	LOCK_CONTENDED(sem, __down_write_trylock, __down_write);
+	LOCK_CONTENTION_PROFILED(sem, __down_write_trylock,
+		LOCK_CONTENTION_RWSEM_WRITE,
+		LOCK_CONTENDED(sem, __down_write_trylock, __down_write));
 	rwsem_set_owner(sem);
 }
 
@@ -35,6 +35,7 @@
 
 
 static int nocompress;
+static int lz4;
 static int noresume;
 static int nohibernate;
 static int resume_wait;
@@ -692,6 +693,9 @@ int hibernate(void)
 			flags |= SF_NOCOMPRESS_MODE;
 		else
 		        flags |= SF_CRC32_MODE;
+		/* the resuming kernel picks the decompressor from the image */
+		if (!nocompress && lz4)
+			flags |= SF_LZ4_MODE;
 
 		pr_debug("PM: writing image.\n");
 		error = swsusp_write(flags);
@@ -1118,6 +1122,8 @@ static int __init hibernate_setup(char *str)
 		noresume = 1;
 	else if (!strncmp(str, "nocompress", 10))
 		nocompress = 1;
+	else if (!strncmp(str, "lz4", 3))
+		lz4 = 1;
 	else if (!strncmp(str, "no", 2)) {
 		noresume = 1;
 		nohibernate = 1;
@@ -25,6 +25,7 @@
 #include <linux/pm.h>
 #include <linux/slab.h>
 #include <linux/lzo.h>
+#include <linux/lz4.h>
 #include <linux/vmalloc.h>
 #include <linux/cpumask.h>
 #include <linux/atomic.h>
@@ -596,7 +597,10 @@ static int crc32_threadfn(void *data)
 	return 0;
 }
 /**
- * Structure used for LZO data compression.
+ * Structure used for LZO or LZ4 data compression.
+ *
+ * LZ4 output never exceeds lzo1x_worst_compress() for the same input, so
+ * both compressors share the buffers and on-disk chunk format.
  */
 struct cmp_data {
 	struct task_struct *thr;                  /* thread */
@@ -605,11 +609,15 @@ struct cmp_data {
 	int ret;                                  /* return code */
 	wait_queue_head_t go;                     /* start compression */
 	wait_queue_head_t done;                   /* compression done */
+	bool lz4;                                 /* use LZ4 instead of LZO */
 	size_t unc_len;                           /* uncompressed length */
 	size_t cmp_len;                           /* compressed length */
 	unsigned char unc[LZO_UNC_SIZE];          /* uncompressed buffer */
 	unsigned char cmp[LZO_CMP_SIZE];          /* compressed buffer */
-	unsigned char wrk[LZO1X_1_MEM_COMPRESS];  /* compression workspace */
+	union {                                   /* compression workspace */
+		unsigned char lzo[LZO1X_1_MEM_COMPRESS];
+		unsigned char lz4[LZ4_MEM_COMPRESS];
+	} wrk;
 };
 
 /**
@@ -631,9 +639,14 @@ static int lzo_compress_threadfn(void *data)
 		}
 		atomic_set(&d->ready, 0);
 
-		d->ret = lzo1x_1_compress(d->unc, d->unc_len,
-		                          d->cmp + LZO_HEADER, &d->cmp_len,
-		                          d->wrk);
+		if (d->lz4)
+			d->ret = lz4_compress(d->unc, d->unc_len,
+			                      d->cmp + LZO_HEADER, &d->cmp_len,
+			                      d->wrk.lz4);
+		else
+			d->ret = lzo1x_1_compress(d->unc, d->unc_len,
+			                          d->cmp + LZO_HEADER,
+			                          &d->cmp_len, d->wrk.lzo);
 		atomic_set(&d->stop, 1);
 		wake_up(&d->done);
 	}
@@ -641,14 +654,15 @@ static int lzo_compress_threadfn(void *data)
 }
 
 /**
- * save_image_lzo - Save the suspend image data compressed with LZO.
+ * save_image_lzo - Save the suspend image data compressed with LZO or LZ4.
  * @handle: Swap map handle to use for saving the image.
  * @snapshot: Image to read data from.
  * @nr_to_write: Number of pages to save.
+ * @lz4: Compress with LZ4 instead of LZO.
  */
 static int save_image_lzo(struct swap_map_handle *handle,
                           struct snapshot_handle *snapshot,
-                          unsigned int nr_to_write)
+                          unsigned int nr_to_write, bool lz4)
 {
 	unsigned int m;
 	int ret = 0;
@@ -685,8 +699,10 @@ static int save_image_lzo(struct swap_map_handle *handle,
 		ret = -ENOMEM;
 		goto out_clean;
 	}
-	for (thr = 0; thr < nr_threads; thr++)
+	for (thr = 0; thr < nr_threads; thr++) {
 		memset(&data[thr], 0, offsetof(struct cmp_data, go));
+		data[thr].lz4 = lz4;
+	}
 
 	crc = kmalloc(sizeof(*crc), GFP_KERNEL);
 	if (!crc) {
@@ -743,9 +759,9 @@ static int save_image_lzo(struct swap_map_handle *handle,
 	handle->reqd_free_pages = reqd_free_pages();
 
 	printk(KERN_INFO
-		"PM: Using %u thread(s) for compression.\n"
+		"PM: Using %u thread(s) for %s compression.\n"
 		"PM: Compressing and saving image data (%u pages)...\n",
-		nr_threads, nr_to_write);
+		nr_threads, lz4 ? "LZ4" : "LZO", nr_to_write);
 	m = nr_to_write / 10;
 	if (!m)
 		m = 1;
@@ -795,7 +811,8 @@ static int save_image_lzo(struct swap_map_handle *handle,
 			ret = data[thr].ret;
 
 			if (ret < 0) {
-				printk(KERN_ERR "PM: LZO compression failed\n");
+				printk(KERN_ERR "PM: %s compression failed\n",
+				       lz4 ? "LZ4" : "LZO");
 				goto out_finish;
 			}
 
@@ -920,7 +937,8 @@ int swsusp_write(unsigned int flags)
 	if (!error) {
 		error = (flags & SF_NOCOMPRESS_MODE) ?
 			save_image(&handle, &snapshot, pages - 1) :
-			save_image_lzo(&handle, &snapshot, pages - 1);
+			save_image_lzo(&handle, &snapshot, pages - 1,
+				       flags & SF_LZ4_MODE);
 	}
 out_finish:
 	error = swap_writer_finish(&handle, flags, error);
@@ -1087,7 +1105,7 @@ static int load_image(struct swap_map_handle *handle,
 }
 
 /**
- * Structure used for LZO data decompression.
+ * Structure used for LZO or LZ4 data decompression.
  */
 struct dec_data {
 	struct task_struct *thr;                  /* thread */
@@ -1096,6 +1114,7 @@ struct dec_data {
 	int ret;                                  /* return code */
 	wait_queue_head_t go;                     /* start decompression */
 	wait_queue_head_t done;                   /* decompression done */
+	bool lz4;                                 /* use LZ4 instead of LZO */
 	size_t unc_len;                           /* uncompressed length */
 	size_t cmp_len;                           /* compressed length */
 	unsigned char unc[LZO_UNC_SIZE];          /* uncompressed buffer */
@@ -1122,8 +1141,14 @@ static int lzo_decompress_threadfn(void *data)
 		atomic_set(&d->ready, 0);
 
 		d->unc_len = LZO_UNC_SIZE;
-		d->ret = lzo1x_decompress_safe(d->cmp + LZO_HEADER, d->cmp_len,
-		                               d->unc, &d->unc_len);
+		if (d->lz4)
+			d->ret = lz4_decompress_unknownoutputsize(
+					d->cmp + LZO_HEADER, d->cmp_len,
+					d->unc, &d->unc_len);
+		else
+			d->ret = lzo1x_decompress_safe(d->cmp + LZO_HEADER,
+			                               d->cmp_len, d->unc,
+			                               &d->unc_len);
 		atomic_set(&d->stop, 1);
 		wake_up(&d->done);
 	}
@@ -1131,32 +1156,60 @@ static int lzo_decompress_threadfn(void *data)
 }
 
 /**
- * load_image_lzo - Load compressed image data and decompress them with LZO.
+ * wait_read_batch - Wait for the oldest batch of read-ahead pages.
+ * @hb: The two batches reads alternate between.
+ * @asked: Number of pages in flight in each batch.
+ * @cur: Index of the batch new reads are submitted to.
+ *
+ * Only the older batch is waited for, so the other one keeps the device busy
+ * while its pages are being decompressed.  The drained batch is then used
+ * for new reads.  Returns the number of pages that became available or a
+ * negative error code.
+ */
+static int wait_read_batch(struct hib_bio_batch *hb, unsigned *asked,
+                           unsigned *cur)
+{
+	unsigned old = asked[*cur ^ 1] ? *cur ^ 1 : *cur;
+	int ret, done;
+
+	ret = hib_wait_io(&hb[old]);
+	if (ret)
+		return ret;
+	done = asked[old];
+	asked[old] = 0;
+	*cur = old;
+	return done;
+}
+
+/**
+ * load_image_lzo - Load compressed image data and decompress them.
  * @handle: Swap map handle to use for loading data.
  * @snapshot: Image to copy uncompressed data into.
  * @nr_to_read: Number of pages to load.
+ * @lz4: The image was compressed with LZ4 instead of LZO.
  */
 static int load_image_lzo(struct swap_map_handle *handle,
                           struct snapshot_handle *snapshot,
-                          unsigned int nr_to_read)
+                          unsigned int nr_to_read, bool lz4)
 {
 	unsigned int m;
 	int ret = 0;
 	int eof = 0;
-	struct hib_bio_batch hb;
+	struct hib_bio_batch hb[2];
 	ktime_t start;
 	ktime_t stop;
 	unsigned nr_pages;
 	size_t off;
 	unsigned i, thr, run_threads, nr_threads;
 	unsigned ring = 0, pg = 0, ring_size = 0,
-	         have = 0, want, need, asked = 0;
+	         have = 0, want, need, asked[2] = { 0, 0 }, cur = 0;
 	unsigned long read_pages = 0;
 	unsigned char **page = NULL;
 	struct dec_data *data = NULL;
 	struct crc_data *crc = NULL;
 
-	hib_init_batch(&hb);
+	hib_init_batch(&hb[0]);
+	hib_init_batch(&hb[1]);
 
 	/*
 	 * We'll limit the number of threads for decompression to limit memory
@@ -1178,8 +1231,10 @@ static int load_image_lzo(struct swap_map_handle *handle,
 		ret = -ENOMEM;
 		goto out_clean;
 	}
-	for (thr = 0; thr < nr_threads; thr++)
+	for (thr = 0; thr < nr_threads; thr++) {
 		memset(&data[thr], 0, offsetof(struct dec_data, go));
+		data[thr].lz4 = lz4;
+	}
 
 	crc = kmalloc(sizeof(*crc), GFP_KERNEL);
 	if (!crc) {
@@ -1261,9 +1316,9 @@ static int load_image_lzo(struct swap_map_handle *handle,
 	want = ring_size = i;
 
 	printk(KERN_INFO
-		"PM: Using %u thread(s) for decompression.\n"
+		"PM: Using %u thread(s) for %s decompression.\n"
 		"PM: Loading and decompressing image data (%u pages)...\n",
-		nr_threads, nr_to_read);
+		nr_threads, lz4 ? "LZ4" : "LZO", nr_to_read);
 	m = nr_to_read / 10;
 	if (!m)
 		m = 1;
@@ -1276,7 +1331,7 @@ static int load_image_lzo(struct swap_map_handle *handle,
 
 	for(;;) {
 		for (i = 0; !eof && i < want; i++) {
-			ret = swap_read_page(handle, page[ring], &hb);
+			ret = swap_read_page(handle, page[ring], &hb[cur]);
 			if (ret) {
 				/*
 				 * On real read error, finish. On end of data,
@@ -1293,22 +1348,22 @@ static int load_image_lzo(struct swap_map_handle *handle,
 			if (++ring >= ring_size)
 				ring = 0;
 		}
-		asked += i;
+		asked[cur] += i;
 		want -= i;
 
 		/*
 		 * We are out of data, wait for some more.
 		 */
 		if (!have) {
-			if (!asked)
+			if (!asked[0] && !asked[1])
 				break;
 
-			ret = hib_wait_io(&hb);
-			if (ret)
+			ret = wait_read_batch(hb, asked, &cur);
+			if (ret < 0)
 				goto out_finish;
-			have += asked;
-			asked = 0;
-			if (eof)
+			have += ret;
+			ret = 0;
+			if (eof && !asked[0] && !asked[1])
 				eof = 2;
 		}
 
@@ -1357,13 +1412,13 @@ static int load_image_lzo(struct swap_map_handle *handle,
 		/*
 		 * Wait for more data while we are decompressing.
 		 */
-		if (have < LZO_CMP_PAGES && asked) {
-			ret = hib_wait_io(&hb);
-			if (ret)
+		if (have < LZO_CMP_PAGES && (asked[0] || asked[1])) {
+			ret = wait_read_batch(hb, asked, &cur);
+			if (ret < 0)
 				goto out_finish;
-			have += asked;
-			asked = 0;
-			if (eof)
+			have += ret;
+			ret = 0;
+			if (eof && !asked[0] && !asked[1])
 				eof = 2;
 		}
 
@@ -1376,7 +1431,8 @@ static int load_image_lzo(struct swap_map_handle *handle,
 
 			if (ret < 0) {
 				printk(KERN_ERR
-				       "PM: LZO decompression failed\n");
+				       "PM: %s decompression failed\n",
+				       lz4 ? "LZ4" : "LZO");
 				goto out_finish;
 			}
 
@@ -1421,6 +1477,9 @@ out_finish:
 		wait_event(crc->done, atomic_read(&crc->stop));
 		atomic_set(&crc->stop, 0);
 	}
+	/* Don't free the ring while reads into it are still in flight. */
+	hib_wait_io(&hb[0]);
+	hib_wait_io(&hb[1]);
 	stop = ktime_get();
 	if (!ret) {
 		printk(KERN_INFO "PM: Image loading done.\n");
@@ -1483,7 +1542,8 @@ int swsusp_read(unsigned int *flags_p)
 	if (!error) {
 		error = (*flags_p & SF_NOCOMPRESS_MODE) ?
 			load_image(&handle, &snapshot, header->pages - 1) :
-			load_image_lzo(&handle, &snapshot, header->pages - 1);
+			load_image_lzo(&handle, &snapshot, header->pages - 1,
+				       *flags_p & SF_LZ4_MODE);
 	}
 	swap_reader_finish(&handle);
 end:
@@ -43,6 +43,7 @@
 #include <linux/rculist.h>
 #include <linux/poll.h>
 #include <linux/irq_work.h>
+#include <linux/kthread.h>
 #include <linux/utsname.h>
 #include <linux/ctype.h>
 #include <linux/uio.h>
@@ -1530,6 +1531,25 @@ static int console_trylock_for_printk(void)
 	return 1;
 }
 
+/*
+ * Console output is normally left to printk_kthread, so that printk()
+ * callers never wait for slow console drivers.  Messages go out to the
+ * consoles synchronously before the thread is started, while an oops or
+ * panic is in progress, once the system is going down, or when booted
+ * with printk.synchronous=1.
+ */
+static bool __read_mostly printk_sync;
+module_param_named(synchronous, printk_sync, bool, S_IRUGO);
+
+static struct task_struct *printk_kthread __read_mostly;
+
+static bool printk_offload(void)
+{
+	if (printk_sync || !printk_kthread || oops_in_progress)
+		return false;
+	return system_state == SYSTEM_BOOTING || system_state == SYSTEM_RUNNING;
+}
+
 int printk_delay_msec __read_mostly;
 
 static inline void printk_delay(void)
@@ -1802,7 +1822,9 @@ asmlinkage int vprintk_emit(int facility, int level,
 	local_irq_restore(flags);
 
 	/* If called from the scheduler, we can not call up(). */
-	if (!in_sched) {
+	if (!in_sched && printk_offload()) {
+		wake_up_process(printk_kthread);
+	} else if (!in_sched) {
 		lockdep_off();
 		/*
 		 * Disable preemption to avoid being preempted while holding
@@ -2682,8 +2704,10 @@ static void wake_up_klogd_work_func(struct irq_work *irq_work)
 	int pending = __this_cpu_xchg(printk_pending, 0);
 
 	if (pending & PRINTK_PENDING_OUTPUT) {
+		if (printk_offload())
+			wake_up_process(printk_kthread);
 		/* If trylock fails, someone else is doing the printing */
-		if (console_trylock())
+		else if (console_trylock())
 			console_unlock();
 	}
 
@@ -2706,6 +2730,50 @@ void wake_up_klogd(void)
 	preempt_enable();
 }
 
+static bool console_output_pending(void)
+{
+	unsigned long flags;
+	bool pending;
+
+	raw_spin_lock_irqsave(&logbuf_lock, flags);
+	pending = console_seq != log_next_seq ||
+		  (cont.len && (cont.cons != cont.len || cont.flushed));
+	raw_spin_unlock_irqrestore(&logbuf_lock, flags);
+
+	return pending;
+}
+
+static int printk_kthread_func(void *data)
+{
+	for (;;) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		/* resume_console() flushes whatever piled up meanwhile */
+		if (console_suspended || !console_output_pending())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		console_lock();
+		console_unlock();
+	}
+
+	return 0;
+}
+
+static int __init printk_kthread_init(void)
+{
+	struct task_struct *thread;
+
+	thread = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(thread)) {
+		pr_err("printk: unable to create printing thread\n");
+		return PTR_ERR(thread);
+	}
+	printk_kthread = thread;
+
+	return 0;
+}
+early_initcall(printk_kthread_init);
+
 int printk_deferred(const char *fmt, ...)
 {
 	va_list args;
@@ -57,6 +57,8 @@
 #include <linux/trace_events.h>
 #include <linux/suspend.h>
 
+#include <asm/irq_regs.h>
+
 #include "tree.h"
 #include "rcu.h"
 
@@ -3467,6 +3469,30 @@ static int synchronize_sched_expedited_cpu_stop(void *data)
 	return 0;
 }
 
+/*
+ * Invoked by IPI on each online non-idle CPU.  The interrupted context is
+ * an expedited quiescent state if it was idle or in user mode, or if it
+ * was preemptible and not in an RCU-preempt read-side critical section,
+ * which can only be told when preemption is counted.  Otherwise, fall
+ * back to the CPU stopper, whose context switch is a quiescent state
+ * and also queues any preempted RCU reader on its ->blkd_tasks list.
+ */
+static void synchronize_sched_expedited_ipi(void *data)
+{
+	struct rcu_data *rdp = data;
+	struct pt_regs *regs = get_irq_regs();
+
+	if (rcu_is_cpu_rrupt_from_idle() || (regs && user_mode(regs)) ||
+	    (IS_ENABLED(CONFIG_PREEMPT_COUNT) &&
+	     preempt_count() == HARDIRQ_OFFSET && !rcu_preempt_depth())) {
+		synchronize_sched_expedited_cpu_stop(rdp);
+		return;
+	}
+
+	stop_one_cpu_nowait(rdp->cpu, synchronize_sched_expedited_cpu_stop,
+			    rdp, &rdp->exp_stop_work);
+}
+
 static void synchronize_sched_expedited_wait(struct rcu_state *rsp)
 {
 	int cpu;
@@ -3555,7 +3581,11 @@ void synchronize_sched_expedited(void)
 
 	rcu_exp_gp_seq_start(rsp);
 
-	/* Stop each CPU that is online, non-idle, and not us. */
+	/*
+	 * Interrupt each CPU that is online, non-idle, and not us.  CPUs
+	 * found in dyntick-idle or nohz_full user mode are already in an
+	 * extended quiescent state and are left alone.
+	 */
 	init_waitqueue_head(&rsp->expedited_wq);
 	atomic_set(&rsp->expedited_need_qs, 1); /* Extra count avoids race. */
 	for_each_online_cpu(cpu) {
@@ -3569,8 +3599,7 @@ void synchronize_sched_expedited(void)
 		    !(atomic_add_return(0, &rdtp->dynticks) & 0x1))
 			continue;
 		atomic_inc(&rsp->expedited_need_qs);
-		stop_one_cpu_nowait(cpu, synchronize_sched_expedited_cpu_stop,
-				    rdp, &rdp->exp_stop_work);
+		smp_call_function_single_async(cpu, &rdp->exp_csd);
 	}
 
 	/* Remove extra count and, if necessary, wait for CPUs to stop. */
@@ -3882,6 +3911,8 @@ rcu_boot_init_percpu_data(int cpu, struct rcu_state *rsp)
 	rdp->cpu = cpu;
 	rdp->rsp = rsp;
 	mutex_init(&rdp->exp_funnel_mutex);
+	rdp->exp_csd.func = synchronize_sched_expedited_ipi;
+	rdp->exp_csd.info = rdp;
 	rcu_boot_init_nocb_percpu_data(rdp);
 	raw_spin_unlock_irqrestore(&rnp->lock, flags);
 	if (rsp == &rcu_sched_state)
@@ -310,6 +310,8 @@ struct rcu_data {
 	struct cpu_stop_work exp_stop_work;
 					/* Expedited grace-period control */
 					/*  for CPU stopping. */
+	struct call_single_data exp_csd;
+					/* Expedited grace-period IPI. */
 
 	/* 2) batch handling */
 	/*
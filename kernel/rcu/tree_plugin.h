@@ -2368,6 +2368,8 @@ static void rcu_spawn_one_nocb_kthread(struct rcu_state *rsp, int cpu)
 	t = kthread_run(rcu_nocb_kthread, rdp_spawn,
 			"rcuo%c/%d", rsp->abbr, cpu);
 	BUG_ON(IS_ERR(t));
+	/* Offloaded callbacks are invoked on the housekeeping CPUs */
+	housekeeping_affine(t);
 	WRITE_ONCE(rdp_spawn->nocb_kthread, t);
 }
 
@@ -627,7 +627,7 @@ int get_nohz_timer_target(void)
 	rcu_read_lock();
 	for_each_domain(cpu, sd) {
 		for_each_cpu(i, sched_domain_span(sd)) {
-			if (!idle_cpu(i) && is_housekeeping_cpu(cpu)) {
+			if (!idle_cpu(i) && is_housekeeping_cpu(i)) {
 				cpu = i;
 				goto unlock;
 			}
@@ -1294,6 +1294,7 @@ void set_task_cpu(struct task_struct *p, unsigned int new_cpu)
 		if (p->sched_class->migrate_task_rq)
 			p->sched_class->migrate_task_rq(p, new_cpu);
 		p->se.nr_migrations++;
+		rq_sched_info_migrated_in(cpu_rq(new_cpu));
 		perf_event_task_migrate(p);
 	}
 
@@ -1876,6 +1877,20 @@ bool cpus_share_cache(int this_cpu, int that_cpu)
 {
 	return per_cpu(sd_llc_id, this_cpu) == per_cpu(sd_llc_id, that_cpu);
 }
+
+/**
+ * sched_cpu_capacity - compute capacity of a CPU
+ * @cpu: the CPU in question, which need not be online
+ *
+ * Return: the capacity the architecture reports for @cpu, relative to
+ * SCHED_CAPACITY_SCALE for the fastest CPU of the system. It is the same
+ * for all CPUs unless they are of different types, such as on big.LITTLE.
+ */
+unsigned long sched_cpu_capacity(int cpu)
+{
+	return arch_scale_cpu_capacity(NULL, cpu);
+}
+EXPORT_SYMBOL_GPL(sched_cpu_capacity);
 #endif /* CONFIG_SMP */
 
 static void ttwu_queue(struct task_struct *p, int cpu)
@@ -2816,6 +2831,7 @@ void scheduler_tick(void)
 	curr->sched_class->task_tick(rq, curr, 0);
 	update_cpu_load_active(rq);
 	calc_global_load_tick(rq);
+	sched_stat_page_update(rq);
 	raw_spin_unlock(&rq->lock);
 
 	perf_event_task_tick();
@@ -6860,6 +6876,20 @@ static void __sdt_free(const struct cpumask *cpu_map)
 	}
 }
 
+static bool sd_asym_capacity(struct sched_domain *sd)
+{
+	const struct cpumask *span = sched_domain_span(sd);
+	unsigned long cap = arch_scale_cpu_capacity(NULL, cpumask_first(span));
+	int i;
+
+	for_each_cpu(i, span) {
+		if (arch_scale_cpu_capacity(NULL, i) != cap)
+			return true;
+	}
+
+	return false;
+}
+
 struct sched_domain *build_sched_domain(struct sched_domain_topology_level *tl,
 		const struct cpumask *cpu_map, struct sched_domain_attr *attr,
 		struct sched_domain *child, int cpu)
@@ -6889,6 +6919,18 @@ struct sched_domain *build_sched_domain(struct sched_domain_topology_level *tl,
 		}
 
 	}
+
+	/*
+	 * On systems with CPUs of different capacity, let wakeups balance
+	 * across this domain and everything below it, so that a task that
+	 * outgrew a small CPU can be placed on a bigger one.
+	 */
+	if (sd_asym_capacity(sd)) {
+		struct sched_domain *t = sd;
+
+		for_each_lower_domain(t)
+			t->flags |= SD_BALANCE_WAKE;
+	}
 	set_domain_attribute(sd, attr);
 
 	return sd;
@@ -29,6 +29,8 @@ pick_next_task_idle(struct rq *rq, struct task_struct *prev)
 	put_prev_task(rq, prev);
 
 	schedstat_inc(rq, sched_goidle);
+	/* the tick may stop, leave an up to date page behind */
+	sched_stat_page_update(rq);
 	return rq->idle;
 }
 
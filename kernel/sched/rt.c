@@ -970,6 +970,10 @@ static void update_curr_rt(struct rq *rq)
 
 	sched_rt_avg_update(rq, delta_exec);
 
+	/* Kick cpufreq to the highest frequency while RT tasks run here */
+	if (cpu_of(rq) == smp_processor_id())
+		cpufreq_update_util(rq_clock(rq), ULONG_MAX, 0);
+
 	if (!rt_bandwidth_enabled())
 		return;
 
@@ -539,6 +539,9 @@ struct root_domain {
 	 */
 	cpumask_var_t rto_mask;
 	struct cpupri cpupri;
+
+	/* Largest cpu_capacity_orig of any CPU in the domain */
+	unsigned long max_cpu_capacity;
 };
 
 extern struct root_domain def_root_domain;
@@ -674,6 +677,12 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int ttwu_count;
 	unsigned int ttwu_local;
+
+	/* set_task_cpu() may run without this rq's lock held */
+	atomic_t nr_migrations_in;
+
+	/* binary export, see /proc/schedstat_map */
+	struct sched_stat_page *stat_page;
 #endif
 
 #ifdef CONFIG_SMP
@@ -1397,6 +1406,8 @@ static inline int hrtick_enabled(struct rq *rq)
 #ifdef CONFIG_SMP
 extern void sched_avg_update(struct rq *rq);
 
+unsigned long arch_scale_cpu_capacity(struct sched_domain *sd, int cpu);
+
 #ifndef arch_scale_freq_capacity
 static __always_inline
 unsigned long arch_scale_freq_capacity(struct sched_domain *sd, int cpu)
@@ -1760,3 +1771,35 @@ static inline u64 irq_time_read(int cpu)
 }
 #endif /* CONFIG_64BIT */
 #endif /* CONFIG_IRQ_TIME_ACCOUNTING */
+
+#ifdef CONFIG_CPU_FREQ
+DECLARE_PER_CPU(struct update_util_data *, cpufreq_update_util_data);
+
+/**
+ * cpufreq_update_util - Take a note about CPU utilization changes.
+ * @time: Current time.
+ * @util: Current utilization.
+ * @max: Utilization ceiling.
+ *
+ * This function is called by the scheduler on the CPU whose utilization is
+ * being updated, with that CPU's rq lock held.
+ *
+ * It can only be called from RCU-sched read-side critical sections, which
+ * the rq lock already provides.
+ *
+ * A @util of ULONG_MAX asks for the highest frequency, which is what the
+ * RT class does whenever it runs.
+ */
+static inline void cpufreq_update_util(u64 time, unsigned long util,
+				       unsigned long max)
+{
+	struct update_util_data *data;
+
+	data = rcu_dereference_sched(*this_cpu_ptr(&cpufreq_update_util_data));
+	if (data)
+		data->func(data, time, util, max);
+}
+#else
+static inline void cpufreq_update_util(u64 time, unsigned long util,
+				       unsigned long max) {}
+#endif /* CONFIG_CPU_FREQ */
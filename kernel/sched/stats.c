@@ -1,8 +1,10 @@
 
 #include <linux/slab.h>
 #include <linux/fs.h>
+#include <linux/mm.h>
 #include <linux/seq_file.h>
 #include <linux/proc_fs.h>
+#include <linux/sched_stat_page.h>
 
 #include "sched.h"
 
@@ -130,9 +132,99 @@ static const struct file_operations proc_schedstat_operations = {
 	.release = seq_release,
 };
 
+/*
+ * /proc/schedstat_map: the same kind of data as above, but binary, one
+ * page per CPU, and mapped by the readers so that sampling it costs them
+ * no system call and the scheduler no formatting.
+ *
+ * Called with rq->lock held.
+ */
+void sched_stat_page_update(struct rq *rq)
+{
+	struct sched_stat_page *sp = rq->stat_page;
+
+	if (!sp)
+		return;
+
+	WRITE_ONCE(sp->seq, sp->seq + 1);
+	smp_wmb();
+
+	sp->timestamp_ns = rq_clock(rq);
+	sp->nr_running = rq->nr_running;
+	sp->nr_switches = rq->nr_switches;
+	sp->run_delay_ns = rq->rq_sched_info.run_delay;
+	sp->pcount = rq->rq_sched_info.pcount;
+	sp->nr_migrations = (u32)atomic_read(&rq->nr_migrations_in);
+#ifdef CONFIG_SMP
+	sp->cfs_load_avg = rq->cfs.avg.load_avg;
+	sp->cfs_util_avg = rq->cfs.avg.util_avg;
+#endif
+
+	smp_wmb();
+	WRITE_ONCE(sp->seq, sp->seq + 1);
+}
+
+static int schedstat_map_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	unsigned long cpu = vma->vm_pgoff;
+	unsigned long addr;
+	int ret;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+
+	for (addr = vma->vm_start; addr < vma->vm_end; addr += PAGE_SIZE) {
+		struct sched_stat_page *sp;
+
+		if (cpu >= nr_cpu_ids || !cpu_possible(cpu))
+			return -EINVAL;
+
+		sp = cpu_rq(cpu)->stat_page;
+		if (!sp)
+			return -ENOMEM;
+
+		ret = vm_insert_page(vma, addr, virt_to_page(sp));
+		if (ret)
+			return ret;
+		cpu++;
+	}
+
+	return 0;
+}
+
+static const struct file_operations proc_schedstat_map_operations = {
+	.mmap	= schedstat_map_mmap,
+	.llseek	= noop_llseek,
+};
+
+static void __init schedstat_map_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct page *page;
+		struct sched_stat_page *sp;
+
+		page = alloc_pages_node(cpu_to_node(cpu),
+					GFP_KERNEL | __GFP_ZERO, 0);
+		if (!page)
+			return;
+
+		sp = page_address(page);
+		sp->version = SCHED_STAT_PAGE_VERSION;
+		cpu_rq(cpu)->stat_page = sp;
+	}
+
+	proc_create("schedstat_map", 0444, NULL,
+		    &proc_schedstat_map_operations);
+}
+
 static int __init proc_schedstat_init(void)
 {
 	proc_create("schedstat", 0, NULL, &proc_schedstat_operations);
+	schedstat_map_init();
 	return 0;
 }
 subsys_initcall(proc_schedstat_init);
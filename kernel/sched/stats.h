@@ -29,6 +29,14 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 	if (rq)
 		rq->rq_sched_info.run_delay += delta;
 }
+
+static inline void rq_sched_info_migrated_in(struct rq *rq)
+{
+	atomic_inc(&rq->nr_migrations_in);
+}
+
+void sched_stat_page_update(struct rq *rq);
+
 # define schedstat_inc(rq, field)	do { (rq)->field++; } while (0)
 # define schedstat_add(rq, field, amt)	do { (rq)->field += (amt); } while (0)
 # define schedstat_set(var, val)	do { var = (val); } while (0)
@@ -42,6 +50,10 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 static inline void
 rq_sched_info_depart(struct rq *rq, unsigned long long delta)
 {}
+static inline void rq_sched_info_migrated_in(struct rq *rq)
+{}
+static inline void sched_stat_page_update(struct rq *rq)
+{}
 # define schedstat_inc(rq, field)	do { } while (0)
 # define schedstat_add(rq, field, amt)	do { } while (0)
 # define schedstat_set(var, val)	do { } while (0)
@@ -33,6 +33,7 @@
 
 #include <linux/cpu.h>
 #include <linux/export.h>
+#include <linux/moduleparam.h>
 #include <linux/percpu.h>
 #include <linux/hrtimer.h>
 #include <linux/notifier.h>
@@ -182,7 +183,9 @@ static inline
 struct hrtimer_cpu_base *get_target_base(struct hrtimer_cpu_base *base,
 					 int pinned)
 {
-	if (pinned || !base->migration_enabled)
+	/* Unpinned timers are always moved off full dynticks CPUs */
+	if (pinned || (!base->migration_enabled &&
+		       is_housekeeping_cpu(smp_processor_id())))
 		return base;
 	return &per_cpu(hrtimer_bases, get_nohz_timer_target());
 }
@@ -954,13 +957,36 @@ remove_hrtimer(struct hrtimer *timer, struct hrtimer_clock_base *base, bool rest
 	return 0;
 }
 
+/*
+ * Upper bound of the slack added to HRTIMER_MODE_SLACK timers, so that
+ * slack tolerant kernel timers expire together with whatever timer
+ * wakes the CPU next.
+ */
+static unsigned int hrtimer_coalesce_ns = NSEC_PER_MSEC;
+core_param(hrtimer_coalesce_ns, hrtimer_coalesce_ns, uint, 0644);
+
+/*
+ * Never stretch a timeout by more than 1/8th of its remaining length,
+ * short timeouts have to stay short.
+ */
+static unsigned long
+hrtimer_coalesce_slack(ktime_t tim, struct hrtimer_clock_base *base)
+{
+	s64 rem = ktime_to_ns(ktime_sub(tim, base->get_time()));
+
+	if (rem <= 0)
+		return 0;
+	return min_t(u64, READ_ONCE(hrtimer_coalesce_ns), rem >> 3);
+}
+
 /**
  * hrtimer_start_range_ns - (re)start an hrtimer on the current CPU
  * @timer:	the timer to be added
  * @tim:	expiry time
  * @delta_ns:	"slack" range for the timer
  * @mode:	expiry mode: absolute (HRTIMER_MODE_ABS) or
- *		relative (HRTIMER_MODE_REL)
+ *		relative (HRTIMER_MODE_REL), optionally | HRTIMER_MODE_SLACK
+ *		to widen the range to allow for coalescing
  */
 void hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim,
 			    unsigned long delta_ns, const enum hrtimer_mode mode)
@@ -988,6 +1014,16 @@ void hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim,
 #endif
 	}
 
+	/*
+	 * The interrupt for the next programmed expiry runs every timer
+	 * whose soft expiry has passed, and the clock event device is
+	 * programmed for the earliest hard expiry. So a wider range lets
+	 * this timer ride along with an already scheduled wakeup instead
+	 * of causing its own.
+	 */
+	if (mode & HRTIMER_MODE_SLACK)
+		delta_ns = max(delta_ns, hrtimer_coalesce_slack(tim, base));
+
 	hrtimer_set_expires_range_ns(timer, tim, delta_ns);
 
 	/* Switch the timer base, if necessary: */
@@ -1121,7 +1157,8 @@ static void __hrtimer_init(struct hrtimer *timer, clockid_t clock_id,
 
 	cpu_base = raw_cpu_ptr(&hrtimer_bases);
 
-	if (clock_id == CLOCK_REALTIME && mode != HRTIMER_MODE_ABS)
+	if (clock_id == CLOCK_REALTIME &&
+	    (mode & ~HRTIMER_MODE_SLACK) != HRTIMER_MODE_ABS)
 		clock_id = CLOCK_MONOTONIC;
 
 	base = hrtimer_clockid_to_base(clock_id);
@@ -1260,6 +1297,7 @@ static void __hrtimer_run_queues(struct hrtimer_cpu_base *cpu_base, ktime_t now)
 {
 	struct hrtimer_clock_base *base = cpu_base->clock_base;
 	unsigned int active = cpu_base->active_bases;
+	unsigned int coalesced = 0;
 
 	for (; active; base++, active >>= 1) {
 		struct timerqueue_node *node;
@@ -1290,9 +1328,16 @@ static void __hrtimer_run_queues(struct hrtimer_cpu_base *cpu_base, ktime_t now)
 			if (basenow.tv64 < hrtimer_get_softexpires_tv64(timer))
 				break;
 
+			/* Would have needed a wakeup of its own later */
+			if (basenow.tv64 < hrtimer_get_expires_tv64(timer))
+				coalesced++;
+
 			__run_hrtimer(cpu_base, base, timer, &basenow);
 		}
 	}
+
+	if (coalesced)
+		trace_hrtimer_coalesced(coalesced);
 }
 
 #ifdef CONFIG_HIGH_RES_TIMERS
@@ -1311,6 +1356,8 @@ void hrtimer_interrupt(struct clock_event_device *dev)
 	cpu_base->nr_events++;
 	dev->next_event.tv64 = KTIME_MAX;
 
+	tick_nohz_full_interrupt("hrtimer", 0);
+
 	raw_spin_lock(&cpu_base->lock);
 	entry_time = now = hrtimer_update_base(cpu_base);
 retry:
@@ -309,6 +309,13 @@ static int tick_nohz_cpu_down_callback(struct notifier_block *nfb,
 	return NOTIFY_OK;
 }
 
+void __tick_nohz_full_interrupt(const char *source, int nr)
+{
+	/* Interrupting the idle task costs no jitter, don't report it */
+	if (!is_idle_task(current))
+		trace_nohz_full_interrupt_rcuidle(source, nr);
+}
+
 static int tick_nohz_init_all(void)
 {
 	int err = -1;
@@ -371,6 +378,8 @@ void __init tick_nohz_init(void)
 	cpu_notifier(tick_nohz_cpu_down_callback, 0);
 	pr_info("NO_HZ: Full dynticks CPUs: %*pbl.\n",
 		cpumask_pr_args(tick_nohz_full_mask));
+	pr_info("NO_HZ: Housekeeping CPUs: %*pbl.\n",
+		cpumask_pr_args(housekeeping_mask));
 
 	/*
 	 * We need at least one CPU to handle housekeeping work such
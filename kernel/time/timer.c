@@ -137,7 +137,9 @@ int timer_migration_handler(struct ctl_table *table, int write,
 static inline struct tvec_base *get_target_base(struct tvec_base *base,
 						int pinned)
 {
-	if (pinned || !base->migration_enabled)
+	/* Unpinned timers are always moved off full dynticks CPUs */
+	if (pinned || (!base->migration_enabled &&
+		       is_housekeeping_cpu(smp_processor_id())))
 		return this_cpu_ptr(&tvec_bases);
 	return per_cpu_ptr(&tvec_bases, get_nohz_timer_target());
 }
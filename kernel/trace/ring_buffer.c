@@ -327,11 +327,18 @@ static void rb_init_page(struct buffer_data_page *bpage)
  * ring_buffer_page_len - the size of data on the page.
  * @page: The page to read
  *
- * Returns the amount of data on the page, including buffer page header.
+ * Returns the amount of data on the page, including buffer page header
+ * and the count of missed events stored after the events, if any.
  */
 size_t ring_buffer_page_len(void *page)
 {
-	return local_read(&((struct buffer_data_page *)page)->commit)
+	unsigned long commit;
+
+	commit = local_read(&((struct buffer_data_page *)page)->commit);
+	if (commit & RB_MISSED_STORED)
+		commit += sizeof(unsigned long);
+
+	return (commit & ~(RB_MISSED_EVENTS | RB_MISSED_STORED))
 		+ BUF_PAGE_HDR_SIZE;
 }
 
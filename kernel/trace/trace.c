@@ -40,6 +40,7 @@
 #include <linux/poll.h>
 #include <linux/nmi.h>
 #include <linux/fs.h>
+#include <linux/lz4.h>
 #include <linux/sched/rt.h>
 
 #include "trace.h"
@@ -5261,6 +5262,7 @@ struct ftrace_buffer_info {
 	struct trace_iterator	iter;
 	void			*spare;
 	unsigned int		read;
+	bool			compress;
 };
 
 #ifdef CONFIG_TRACER_SNAPSHOT
@@ -5703,6 +5705,92 @@ static void buffer_spd_release(struct splice_pipe_desc *spd, unsigned int i)
 	spd->partial[i].private = 0;
 }
 
+#ifdef CONFIG_TRACE_PIPE_RAW_LZ4
+/*
+ * Every sub-buffer spliced from trace_pipe_raw_lz4 is prefixed by this
+ * header. 'len' bytes of LZ4 data follow that decompress into the
+ * 'page_len' bytes of the sub-buffer, or if 'len' equals 'page_len' the
+ * sub-buffer itself follows.
+ */
+struct trace_lz4_header {
+	u32			len;
+	u32			page_len;
+};
+
+struct trace_lz4_ctx {
+	void			*wrkmem;
+	void			*dst;
+};
+
+static struct trace_lz4_ctx __percpu *trace_lz4_ctx;
+
+/* Called with trace_types_lock held, the contexts are never freed */
+static int trace_lz4_alloc_ctx(void)
+{
+	struct trace_lz4_ctx __percpu *ctx;
+	int cpu;
+
+	if (trace_lz4_ctx)
+		return 0;
+
+	ctx = alloc_percpu(struct trace_lz4_ctx);
+	if (!ctx)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct trace_lz4_ctx *c = per_cpu_ptr(ctx, cpu);
+		int node = cpu_to_node(cpu);
+
+		c->wrkmem = kmalloc_node(LZ4_MEM_COMPRESS, GFP_KERNEL, node);
+		c->dst = kmalloc_node(lz4_compressbound(PAGE_SIZE), GFP_KERNEL,
+				      node);
+		if (!c->wrkmem || !c->dst)
+			goto free_ctx;
+	}
+
+	trace_lz4_ctx = ctx;
+	return 0;
+
+ free_ctx:
+	for_each_possible_cpu(cpu) {
+		kfree(per_cpu_ptr(ctx, cpu)->wrkmem);
+		kfree(per_cpu_ptr(ctx, cpu)->dst);
+	}
+	free_percpu(ctx);
+	return -ENOMEM;
+}
+
+/*
+ * Compresses the sub-buffer in @page in place, using the context of the
+ * current cpu, and returns the number of bytes to hand out. The page must
+ * have been read with room for the header, so that a sub-buffer that does
+ * not compress still fits.
+ */
+static int trace_lz4_compress_page(void *page)
+{
+	struct trace_lz4_header *hdr = page;
+	struct trace_lz4_ctx *ctx;
+	size_t page_len, len;
+
+	page_len = ring_buffer_page_len(page);
+
+	ctx = get_cpu_ptr(trace_lz4_ctx);
+	if (lz4_compress(page, page_len, ctx->dst, &len, ctx->wrkmem) ||
+	    len >= page_len) {
+		memmove(page + sizeof(*hdr), page, page_len);
+		len = page_len;
+	} else {
+		memcpy(page + sizeof(*hdr), ctx->dst, len);
+	}
+	put_cpu_ptr(trace_lz4_ctx);
+
+	hdr->len = len;
+	hdr->page_len = page_len;
+
+	return sizeof(*hdr) + len;
+}
+#endif /* CONFIG_TRACE_PIPE_RAW_LZ4 */
+
 static ssize_t
 tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 			    struct pipe_inode_info *pipe, size_t len,
@@ -5746,6 +5834,7 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 	entries = ring_buffer_entries_cpu(iter->trace_buffer->buffer, iter->cpu_file);
 
 	for (i = 0; i < spd.nr_pages_max && len && entries; i++, len -= PAGE_SIZE) {
+		size_t read_len = len;
 		struct page *page;
 		int r;
 
@@ -5764,26 +5853,48 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 			break;
 		}
 
+#ifdef CONFIG_TRACE_PIPE_RAW_LZ4
+		/*
+		 * Leave room for the header in front of the sub-buffer, and
+		 * for the missed events count the ring buffer may store after
+		 * the events. Full pages no longer fit and get copied event by
+		 * event, so partial pages have to be accepted as well.
+		 */
+		if (info->compress)
+			read_len = PAGE_SIZE - sizeof(struct trace_lz4_header) -
+				   sizeof(unsigned long);
+#endif
+
 		r = ring_buffer_read_page(ref->buffer, &ref->page,
-					  len, iter->cpu_file, 1);
+					  read_len, iter->cpu_file,
+					  !info->compress);
 		if (r < 0) {
 			ring_buffer_free_read_page(ref->buffer, ref->page);
 			kfree(ref);
 			break;
 		}
 
-		/*
-		 * zero out any left over data, this is going to
-		 * user land.
-		 */
-		size = ring_buffer_page_len(ref->page);
-		if (size < PAGE_SIZE)
-			memset(ref->page + size, 0, PAGE_SIZE - size);
+#ifdef CONFIG_TRACE_PIPE_RAW_LZ4
+		/* only the compressed bytes are handed out */
+		if (info->compress)
+			size = trace_lz4_compress_page(ref->page);
+		else
+#endif
+		{
+			/*
+			 * zero out any left over data, this is going to
+			 * user land.
+			 */
+			size = ring_buffer_page_len(ref->page);
+			if (size < PAGE_SIZE)
+				memset(ref->page + size, 0, PAGE_SIZE - size);
+			size = PAGE_SIZE;
+		}
 
 		page = virt_to_page(ref->page);
 
 		spd.pages[i] = page;
-		spd.partial[i].len = PAGE_SIZE;
+		spd.partial[i].len = size;
 		spd.partial[i].offset = 0;
 		spd.partial[i].private = (unsigned long)ref;
 		spd.nr_pages++;
@@ -5825,6 +5936,38 @@ static const struct file_operations tracing_buffers_fops = {
 	.llseek		= no_llseek,
 };
 
+#ifdef CONFIG_TRACE_PIPE_RAW_LZ4
+static int tracing_buffers_lz4_open(struct inode *inode, struct file *filp)
+{
+	struct ftrace_buffer_info *info;
+	int ret;
+
+	mutex_lock(&trace_types_lock);
+	ret = trace_lz4_alloc_ctx();
+	mutex_unlock(&trace_types_lock);
+	if (ret)
+		return ret;
+
+	ret = tracing_buffers_open(inode, filp);
+	if (ret < 0)
+		return ret;
+
+	info = filp->private_data;
+	info->compress = true;
+
+	return ret;
+}
+
+/* compressed sub-buffers can only be spliced, reads return -EINVAL */
+static const struct file_operations tracing_buffers_lz4_fops = {
+	.open		= tracing_buffers_lz4_open,
+	.poll		= tracing_buffers_poll,
+	.release	= tracing_buffers_release,
+	.splice_read	= tracing_buffers_splice_read,
+	.llseek		= no_llseek,
+};
+#endif /* CONFIG_TRACE_PIPE_RAW_LZ4 */
+
 static ssize_t
 tracing_stats_read(struct file *filp, char __user *ubuf,
 		   size_t count, loff_t *ppos)
@@ -6112,6 +6255,11 @@ tracing_init_tracefs_percpu(struct trace_array *tr, long cpu)
 	trace_create_cpu_file("trace_pipe_raw", 0444, d_cpu,
 				tr, cpu, &tracing_buffers_fops);
 
+#ifdef CONFIG_TRACE_PIPE_RAW_LZ4
+	trace_create_cpu_file("trace_pipe_raw_lz4", 0444, d_cpu,
+				tr, cpu, &tracing_buffers_lz4_fops);
+#endif
+
 	trace_create_cpu_file("stats", 0444, d_cpu,
 				tr, cpu, &tracing_stats_fops);
 
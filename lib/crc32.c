@@ -32,6 +32,17 @@
 #include <linux/sched.h>
 #include "crc32defs.h"
 
+#ifdef CONFIG_ARCH_HAS_FAST_CRC32
+#include <asm/crc32.h>
+#else
+static inline bool arch_has_fast_crc32(void)
+{
+	return false;
+}
+#define arch_crc32_le(crc, p, len)	(crc)
+#define arch_crc32c_le(crc, p, len)	(crc)
+#endif
+
 #if CRC_LE_BITS > 8
 # define tole(x) ((__force u32) cpu_to_le32(x))
 #else
@@ -182,26 +193,41 @@ static inline u32 __pure crc32_le_generic(u32 crc, unsigned char const *p,
 }
 
 #if CRC_LE_BITS == 1
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+static u32 __pure crc32_le_base(u32 crc, unsigned char const *p, size_t len)
 {
 	return crc32_le_generic(crc, p, len, NULL, CRCPOLY_LE);
 }
-u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+static u32 __pure __crc32c_le_base(u32 crc, unsigned char const *p,
+				   size_t len)
 {
 	return crc32_le_generic(crc, p, len, NULL, CRC32C_POLY_LE);
 }
 #else
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+static u32 __pure crc32_le_base(u32 crc, unsigned char const *p, size_t len)
 {
 	return crc32_le_generic(crc, p, len,
 			(const u32 (*)[256])crc32table_le, CRCPOLY_LE);
 }
-u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+static u32 __pure __crc32c_le_base(u32 crc, unsigned char const *p,
+				   size_t len)
 {
 	return crc32_le_generic(crc, p, len,
 			(const u32 (*)[256])crc32ctable_le, CRC32C_POLY_LE);
 }
 #endif
+
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	if (arch_has_fast_crc32())
+		return arch_crc32_le(crc, p, len);
+	return crc32_le_base(crc, p, len);
+}
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	if (arch_has_fast_crc32())
+		return arch_crc32c_le(crc, p, len);
+	return __crc32c_le_base(crc, p, len);
+}
 EXPORT_SYMBOL(crc32_le);
 EXPORT_SYMBOL(__crc32c_le);
 
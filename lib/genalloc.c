@@ -31,11 +31,28 @@
 #include <linux/slab.h>
 #include <linux/export.h>
 #include <linux/bitmap.h>
+#include <linux/log2.h>
+#include <linux/percpu.h>
 #include <linux/rculist.h>
+#include <linux/smp.h>
 #include <linux/interrupt.h>
 #include <linux/genalloc.h>
 #include <linux/of_device.h>
 
+/*
+ * Per-CPU magazines of free blocks for the smallest power of two sizes,
+ * so that most small allocations don't have to scan the bitmaps.  The
+ * blocks stay allocated in the bitmaps while they are cached.
+ */
+#define GEN_POOL_CACHE_CLASSES	8
+#define GEN_POOL_CACHE_DEPTH	16
+#define GEN_POOL_CACHE_BATCH	(GEN_POOL_CACHE_DEPTH / 2)
+
+struct gen_pool_cache {
+	unsigned int count[GEN_POOL_CACHE_CLASSES];
+	unsigned long addr[GEN_POOL_CACHE_CLASSES][GEN_POOL_CACHE_DEPTH];
+};
+
 static inline size_t chunk_size(const struct gen_pool_chunk *chunk)
 {
 	return chunk->end_addr - chunk->start_addr + 1;
@@ -161,6 +178,8 @@ struct gen_pool *gen_pool_create(int min_alloc_order, int nid)
 		pool->algo = gen_pool_first_fit;
 		pool->data = NULL;
 		pool->name = NULL;
+		pool->cache = NULL;
+		pool->cache_classes = 0;
 	}
 	return pool;
 }
@@ -243,6 +262,11 @@ void gen_pool_destroy(struct gen_pool *pool)
 	int order = pool->min_alloc_order;
 	int bit, end_bit;
 
+	if (pool->cache) {
+		gen_pool_drain_cache(pool);
+		free_percpu(pool->cache);
+	}
+
 	list_for_each_safe(_chunk, _next_chunk, &pool->chunks) {
 		chunk = list_entry(_chunk, struct gen_pool_chunk, next_chunk);
 		list_del(&chunk->next_chunk);
@@ -258,30 +282,13 @@ void gen_pool_destroy(struct gen_pool *pool)
 }
 EXPORT_SYMBOL(gen_pool_destroy);
 
-/**
- * gen_pool_alloc - allocate special memory from the pool
- * @pool: pool to allocate from
- * @size: number of bytes to allocate from the pool
- *
- * Allocate the requested number of bytes from the specified pool.
- * Uses the pool allocation function (with first-fit algorithm by default).
- * Can not be used in NMI handler on architectures without
- * NMI-safe cmpxchg implementation.
- */
-unsigned long gen_pool_alloc(struct gen_pool *pool, size_t size)
+static unsigned long __gen_pool_alloc(struct gen_pool *pool, size_t size)
 {
 	struct gen_pool_chunk *chunk;
 	unsigned long addr = 0;
 	int order = pool->min_alloc_order;
 	int nbits, start_bit = 0, end_bit, remain;
 
-#ifndef CONFIG_ARCH_HAVE_NMI_SAFE_CMPXCHG
-	BUG_ON(in_nmi());
-#endif
-
-	if (size == 0)
-		return 0;
-
 	nbits = (size + (1UL << order) - 1) >> order;
 	rcu_read_lock();
 	list_for_each_entry_rcu(chunk, &pool->chunks, next_chunk) {
@@ -310,6 +317,193 @@ retry:
 	rcu_read_unlock();
 	return addr;
 }
+
+static void __gen_pool_free(struct gen_pool *pool, unsigned long addr,
+			    size_t size)
+{
+	struct gen_pool_chunk *chunk;
+	int order = pool->min_alloc_order;
+	int start_bit, nbits, remain;
+
+	nbits = (size + (1UL << order) - 1) >> order;
+	rcu_read_lock();
+	list_for_each_entry_rcu(chunk, &pool->chunks, next_chunk) {
+		if (addr >= chunk->start_addr && addr <= chunk->end_addr) {
+			BUG_ON(addr + size - 1 > chunk->end_addr);
+			start_bit = (addr - chunk->start_addr) >> order;
+			remain = bitmap_clear_ll(chunk->bits, start_bit, nbits);
+			BUG_ON(remain);
+			size = nbits << order;
+			atomic_add(size, &chunk->avail);
+			rcu_read_unlock();
+			return;
+		}
+	}
+	rcu_read_unlock();
+	BUG();
+}
+
+/* Returns the cached size class of a @size byte block, or -1. */
+static int gen_pool_cache_class(struct gen_pool *pool, size_t size)
+{
+	int class;
+
+	if (!pool->cache)
+		return -1;
+
+	class = order_base_2(size) - pool->min_alloc_order;
+	if (class < 0)
+		class = 0;
+
+	return class < pool->cache_classes ? class : -1;
+}
+
+/*
+ * Blocks of a cached size class are always rounded up to the class size.
+ * NMIs use the bitmaps directly, the caches are only protected against
+ * interrupts.
+ */
+static unsigned long gen_pool_cache_alloc(struct gen_pool *pool, int class)
+{
+	size_t size = 1UL << (pool->min_alloc_order + class);
+	struct gen_pool_cache *pc;
+	unsigned long flags, addr = 0;
+
+	if (in_nmi())
+		return __gen_pool_alloc(pool, size);
+
+	local_irq_save(flags);
+	pc = this_cpu_ptr(pool->cache);
+
+	/* refill half a magazine, so that the next allocations hit */
+	if (!pc->count[class]) {
+		while (pc->count[class] < GEN_POOL_CACHE_BATCH) {
+			addr = __gen_pool_alloc(pool, size);
+			if (!addr)
+				break;
+			pc->addr[class][pc->count[class]++] = addr;
+		}
+	}
+
+	if (pc->count[class])
+		addr = pc->addr[class][--pc->count[class]];
+	local_irq_restore(flags);
+
+	return addr;
+}
+
+static void gen_pool_cache_free(struct gen_pool *pool, int class,
+				unsigned long addr)
+{
+	size_t size = 1UL << (pool->min_alloc_order + class);
+	struct gen_pool_cache *pc;
+	unsigned long flags;
+	int i;
+
+	if (in_nmi()) {
+		__gen_pool_free(pool, addr, size);
+		return;
+	}
+
+	local_irq_save(flags);
+	pc = this_cpu_ptr(pool->cache);
+
+	/* a full magazine gives its older half back to the bitmaps */
+	if (pc->count[class] == GEN_POOL_CACHE_DEPTH) {
+		for (i = 0; i < GEN_POOL_CACHE_BATCH; i++)
+			__gen_pool_free(pool, pc->addr[class][i], size);
+		memmove(pc->addr[class], pc->addr[class] + GEN_POOL_CACHE_BATCH,
+			(GEN_POOL_CACHE_DEPTH - GEN_POOL_CACHE_BATCH) *
+			sizeof(pc->addr[class][0]));
+		pc->count[class] -= GEN_POOL_CACHE_BATCH;
+	}
+	pc->addr[class][pc->count[class]++] = addr;
+	local_irq_restore(flags);
+}
+
+/* Caller must keep @pc from being used concurrently. */
+static void gen_pool_cache_empty(struct gen_pool *pool,
+				 struct gen_pool_cache *pc)
+{
+	int class;
+
+	for (class = 0; class < pool->cache_classes; class++) {
+		size_t size = 1UL << (pool->min_alloc_order + class);
+
+		while (pc->count[class])
+			__gen_pool_free(pool,
+				pc->addr[class][--pc->count[class]], size);
+	}
+}
+
+/* Runs with interrupts disabled, on the CPU whose cache it empties. */
+static void gen_pool_cache_empty_local(void *data)
+{
+	struct gen_pool *pool = data;
+
+	gen_pool_cache_empty(pool, this_cpu_ptr(pool->cache));
+}
+
+/*
+ * Give the cached blocks back to the bitmaps after an allocation failed.
+ * Every CPU empties its own cache, unless we can't wait for the other
+ * CPUs here: then only the local cache is emptied.
+ */
+static void gen_pool_cache_reclaim(struct gen_pool *pool)
+{
+	unsigned long flags;
+
+	if (!in_interrupt() && !irqs_disabled()) {
+		on_each_cpu(gen_pool_cache_empty_local, pool, 1);
+		return;
+	}
+
+	local_irq_save(flags);
+	gen_pool_cache_empty_local(pool);
+	local_irq_restore(flags);
+}
+
+/**
+ * gen_pool_alloc - allocate special memory from the pool
+ * @pool: pool to allocate from
+ * @size: number of bytes to allocate from the pool
+ *
+ * Allocate the requested number of bytes from the specified pool.
+ * Uses the pool allocation function (with first-fit algorithm by default).
+ * Small sizes are served from the per-CPU caches if they are enabled,
+ * and the caches are emptied again before an allocation fails.
+ * Can not be used in NMI handler on architectures without
+ * NMI-safe cmpxchg implementation.
+ */
+unsigned long gen_pool_alloc(struct gen_pool *pool, size_t size)
+{
+	unsigned long addr;
+	int class;
+
+#ifndef CONFIG_ARCH_HAVE_NMI_SAFE_CMPXCHG
+	BUG_ON(in_nmi());
+#endif
+
+	if (size == 0)
+		return 0;
+
+	class = gen_pool_cache_class(pool, size);
+	if (class >= 0)
+		addr = gen_pool_cache_alloc(pool, class);
+	else
+		addr = __gen_pool_alloc(pool, size);
+
+	/* the free space may be sitting in the caches */
+	if (!addr && pool->cache && !in_nmi()) {
+		gen_pool_cache_reclaim(pool);
+		if (class >= 0)
+			addr = gen_pool_cache_alloc(pool, class);
+		else
+			addr = __gen_pool_alloc(pool, size);
+	}
+
+	return addr;
+}
 EXPORT_SYMBOL(gen_pool_alloc);
 
 /**
@@ -353,33 +547,84 @@ EXPORT_SYMBOL(gen_pool_dma_alloc);
  */
 void gen_pool_free(struct gen_pool *pool, unsigned long addr, size_t size)
 {
-	struct gen_pool_chunk *chunk;
-	int order = pool->min_alloc_order;
-	int start_bit, nbits, remain;
+	int class;
 
 #ifndef CONFIG_ARCH_HAVE_NMI_SAFE_CMPXCHG
 	BUG_ON(in_nmi());
 #endif
 
-	nbits = (size + (1UL << order) - 1) >> order;
-	rcu_read_lock();
-	list_for_each_entry_rcu(chunk, &pool->chunks, next_chunk) {
-		if (addr >= chunk->start_addr && addr <= chunk->end_addr) {
-			BUG_ON(addr + size - 1 > chunk->end_addr);
-			start_bit = (addr - chunk->start_addr) >> order;
-			remain = bitmap_clear_ll(chunk->bits, start_bit, nbits);
-			BUG_ON(remain);
-			size = nbits << order;
-			atomic_add(size, &chunk->avail);
-			rcu_read_unlock();
-			return;
-		}
-	}
-	rcu_read_unlock();
-	BUG();
+	class = gen_pool_cache_class(pool, size);
+	if (class >= 0)
+		gen_pool_cache_free(pool, class, addr);
+	else
+		__gen_pool_free(pool, addr, size);
 }
 EXPORT_SYMBOL(gen_pool_free);
 
+/**
+ * gen_pool_enable_cache - cache small blocks per CPU
+ * @pool: pool to enable the caches for
+ * @max_size: largest allocation size to cache
+ *
+ * Sets up per-CPU caches for the power of two sizes from the pool
+ * granularity up to @max_size (at most 8 sizes).  Allocations and frees
+ * of those sizes then mostly take constant time, at the price of each
+ * CPU keeping up to 16 free blocks of each size to itself; the memory
+ * in the caches is not counted by gen_pool_avail().  Blocks are rounded
+ * up to their size class.  Pools too small to give up that much memory,
+ * where full caches could hold more than an eighth of it, are refused.
+ *
+ * Must be called before the first allocation from the pool.  Returns 0
+ * on success or a -ve errno on failure.
+ */
+int gen_pool_enable_cache(struct gen_pool *pool, size_t max_size)
+{
+	unsigned long cached;
+	int classes;
+
+	if (pool->cache || gen_pool_avail(pool) != gen_pool_size(pool))
+		return -EBUSY;
+
+	classes = order_base_2(max_size) - pool->min_alloc_order + 1;
+	if (classes <= 0)
+		return -EINVAL;
+	classes = min(classes, GEN_POOL_CACHE_CLASSES);
+
+	/* all classes full on all CPUs: depth times the sum of the sizes */
+	cached = ((1UL << (pool->min_alloc_order + classes)) -
+		  (1UL << pool->min_alloc_order)) *
+		 GEN_POOL_CACHE_DEPTH * num_possible_cpus();
+	if (cached > gen_pool_size(pool) / 8)
+		return -ENOSPC;
+
+	pool->cache = alloc_percpu(struct gen_pool_cache);
+	if (!pool->cache)
+		return -ENOMEM;
+	pool->cache_classes = classes;
+
+	return 0;
+}
+EXPORT_SYMBOL(gen_pool_enable_cache);
+
+/**
+ * gen_pool_drain_cache - give all cached blocks back to the pool
+ * @pool: pool whose caches to drain
+ *
+ * Must not run concurrently with allocations from or frees to @pool,
+ * e.g. call it before checking that all memory has been given back.
+ */
+void gen_pool_drain_cache(struct gen_pool *pool)
+{
+	int cpu;
+
+	if (!pool->cache)
+		return;
+
+	for_each_possible_cpu(cpu)
+		gen_pool_cache_empty(pool, per_cpu_ptr(pool->cache, cpu));
+}
+EXPORT_SYMBOL(gen_pool_drain_cache);
+
 /**
  * gen_pool_for_each_chunk - call func for every chunk of generic memory pool
  * @pool:	the generic memory pool
@@ -435,7 +680,8 @@ bool addr_in_gen_pool(struct gen_pool *pool, unsigned long start,
  * gen_pool_avail - get available free space of the pool
  * @pool: pool to get available free space
  *
- * Return available free space of the specified pool.
+ * Return available free space of the specified pool, not counting
+ * blocks held in the per-CPU caches.
  */
 size_t gen_pool_avail(struct gen_pool *pool)
 {
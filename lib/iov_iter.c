@@ -135,6 +135,45 @@
 	i->iov_offset = skip;					\
 }
 
+/*
+ * Fault in all the iovecs the next @bytes of a copy will touch, so that
+ * the whole copy can run under a single kmap_atomic().
+ */
+static int fault_in_iovec_writeable(const struct iovec *iov, size_t skip,
+				    size_t bytes)
+{
+	while (bytes) {
+		size_t len = min(bytes, iov->iov_len - skip);
+
+		if (len && fault_in_pages_writeable(iov->iov_base + skip, len))
+			return -EFAULT;
+		bytes -= len;
+		skip = 0;
+		iov++;
+	}
+	return 0;
+}
+
+static int fault_in_iovec_readable(const struct iovec *iov, size_t skip,
+				   size_t bytes)
+{
+	while (bytes) {
+		size_t len = min(bytes, iov->iov_len - skip);
+
+		if (len && fault_in_pages_readable(iov->iov_base + skip, len))
+			return -EFAULT;
+		bytes -= len;
+		skip = 0;
+		iov++;
+	}
+	return 0;
+}
+
+/*
+ * Without highmem kmap() is free and may sleep, so the copy can take
+ * its page faults as they come instead of prefaulting the iovecs and
+ * copying under kmap_atomic().
+ */
 static size_t copy_page_to_iter_iovec(struct page *page, size_t offset, size_t bytes,
 			 struct iov_iter *i)
 {
@@ -155,7 +194,8 @@ static size_t copy_page_to_iter_iovec(struct page *page, size_t offset, size_t b
 	buf = iov->iov_base + skip;
 	copy = min(bytes, iov->iov_len - skip);
 
-	if (!fault_in_pages_writeable(buf, copy)) {
+	if (IS_ENABLED(CONFIG_HIGHMEM) &&
+	    !fault_in_iovec_writeable(iov, skip, bytes)) {
 		kaddr = kmap_atomic(page);
 		from = kaddr + offset;
 
@@ -236,7 +276,8 @@ static size_t copy_page_from_iter_iovec(struct page *page, size_t offset, size_t
 	buf = iov->iov_base + skip;
 	copy = min(bytes, iov->iov_len - skip);
 
-	if (!fault_in_pages_readable(buf, copy)) {
+	if (IS_ENABLED(CONFIG_HIGHMEM) &&
+	    !fault_in_iovec_readable(iov, skip, bytes)) {
 		kaddr = kmap_atomic(page);
 		to = kaddr + offset;
 
@@ -298,20 +339,21 @@ done:
 }
 
 /*
- * Fault in the first iovec of the given iov_iter, to a maximum length
- * of bytes. Returns 0 on success, or non-zero if the memory could not be
- * accessed (ie. because it is an invalid address).
+ * Fault in the iovecs of the given iov_iter, to a maximum length of
+ * bytes.  Faulting in all of them rather than just the first keeps a
+ * writev() of many small iovecs from coming back with a short atomic
+ * copy at every segment boundary.  Only the first and the last page of
+ * each iovec are touched, see iov_iter_fault_in_multipages_readable()
+ * for longer ranges.
  *
- * writev-intensive code may want this to prefault several iovecs -- that
- * would be possible (callers must not rely on the fact that _only_ the
- * first iovec will be faulted with the current implementation).
+ * Returns 0 on success, or non-zero if the memory could not be
+ * accessed (ie. because it is an invalid address).
  */
 int iov_iter_fault_in_readable(struct iov_iter *i, size_t bytes)
 {
 	if (!(i->type & (ITER_BVEC|ITER_KVEC))) {
-		char __user *buf = i->iov->iov_base + i->iov_offset;
-		bytes = min(bytes, i->iov->iov_len - i->iov_offset);
-		return fault_in_pages_readable(buf, bytes);
+		bytes = min(bytes, i->count);
+		return fault_in_iovec_readable(i->iov, i->iov_offset, bytes);
 	}
 	return 0;
 }
@@ -19,6 +19,7 @@
 #include <linux/kobject.h>
 #include <linux/export.h>
 #include <linux/kmod.h>
+#include <linux/initrd.h>
 #include <linux/slab.h>
 #include <linux/socket.h>
 #include <linux/skbuff.h>
@@ -331,6 +332,9 @@ int kobject_uevent_env(struct kobject *kobj, enum kobject_action action,
 	if (uevent_helper[0] && !kobj_usermode_filter(kobj)) {
 		struct subprocess_info *info;
 
+		/* the helper usually lives in the initramfs */
+		wait_for_initramfs();
+
 		retval = add_uevent_var(env, "HOME=/");
 		if (retval)
 			goto exit;
@@ -26,12 +26,21 @@ typedef struct _U16_S { u16 v; } U16_S;
 typedef struct _U32_S { u32 v; } U32_S;
 typedef struct _U64_S { u64 v; } U64_S;
 #if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)		\
-	|| defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6	\
-	&& defined(ARM_EFFICIENT_UNALIGNED_ACCESS)
+	|| defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6
 
-#define A16(x) (((U16_S *)(x))->v)
-#define A32(x) (((U32_S *)(x))->v)
-#define A64(x) (((U64_S *)(x))->v)
+/*
+ * ARMv6 and later do unaligned ldr/ldrh/str/strh in hardware, but fault
+ * on unaligned ldrd/ldm.  Going through packed structures lets the
+ * compiler use the former for the 16 and 32 bit accesses and split the
+ * 64 bit ones, instead of the byte by byte get_unaligned() fallback.
+ */
+typedef struct _U16_P { u16 v; } __packed U16_P;
+typedef struct _U32_P { u32 v; } __packed U32_P;
+typedef struct _U64_P { u64 v; } __packed U64_P;
+
+#define A16(x) (((U16_P *)(x))->v)
+#define A32(x) (((U32_P *)(x))->v)
+#define A64(x) (((U64_P *)(x))->v)
 
 #define PUT4(s, d) (A32(d) = A32(s))
 #define PUT8(s, d) (A64(d) = A64(s))
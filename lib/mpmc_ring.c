@@ -0,0 +1,190 @@
+/*
+ * Bounded lockless multi-producer/multi-consumer pointer ring
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Slot i of lap l has seq == l * size + i while it is free for a producer
+ * and seq == l * size + i + 1 once it holds an entry.  A producer claims
+ * a run of free slots by advancing @prod with cmpxchg, fills them and
+ * then publishes each one by bumping its seq; consumers do the same on
+ * @cons and hand the slot over to the next lap.  The acquire load of seq
+ * pairs with the release store of the other side, so the pointer is
+ * always written before it can be read and read before it is overwritten.
+ */
+
+#include <linux/kernel.h>
+#include <linux/export.h>
+#include <linux/slab.h>
+#include <linux/log2.h>
+#include <linux/atomic.h>
+#include <linux/mpmc_ring.h>
+
+/**
+ * mpmc_ring_init - allocate the slots of a ring
+ * @r:		the ring
+ * @size:	number of slots, rounded up to a power of two
+ * @gfp:	allocation flags
+ *
+ * Returns 0 on success or a negative error code.
+ */
+int mpmc_ring_init(struct mpmc_ring *r, unsigned int size, gfp_t gfp)
+{
+	unsigned int i;
+
+	if (size < 2 || size > (1U << 31))
+		return -EINVAL;
+	size = roundup_pow_of_two(size);
+
+	r->slots = kmalloc_array(size, sizeof(*r->slots), gfp);
+	if (!r->slots)
+		return -ENOMEM;
+
+	for (i = 0; i < size; i++) {
+		r->slots[i].seq = i;
+		r->slots[i].ptr = NULL;
+	}
+	r->mask = size - 1;
+	r->prod = 0;
+	r->cons = 0;
+
+	return 0;
+}
+EXPORT_SYMBOL(mpmc_ring_init);
+
+/**
+ * mpmc_ring_cleanup - free the slots of a ring
+ * @r:		the ring
+ *
+ * Entries still queued are dropped, the caller has to take care of them
+ * before if needed.
+ */
+void mpmc_ring_cleanup(struct mpmc_ring *r)
+{
+	kfree(r->slots);
+	r->slots = NULL;
+}
+EXPORT_SYMBOL(mpmc_ring_cleanup);
+
+/*
+ * Claim up to @n consecutive slots from @head on, i.e. the slots whose
+ * seq is their position plus @ready, and store the first position in
+ * @pos.  Returns the number of slots claimed, 0 if the ring is full
+ * (producer) or empty (consumer).
+ */
+static unsigned int mpmc_ring_claim(struct mpmc_ring *r, unsigned long *head,
+				    unsigned long *pos, unsigned int n,
+				    unsigned long ready)
+{
+	unsigned long p = READ_ONCE(*head);
+
+	for (;;) {
+		unsigned long old;
+		unsigned int i;
+		long diff = 0;
+
+		for (i = 0; i < n; i++) {
+			unsigned long seq;
+
+			seq = smp_load_acquire(&r->slots[(p + i) & r->mask].seq);
+			diff = seq - (p + i + ready);
+			if (diff)
+				break;
+		}
+
+		/*
+		 * A slot that is behind is still owned by the other side, so
+		 * if the first one is, there is nothing to claim.  A slot
+		 * that is ahead means *head moved under us and p is stale.
+		 */
+		if (!i) {
+			if (diff < 0)
+				return 0;
+			p = READ_ONCE(*head);
+			continue;
+		}
+
+		old = cmpxchg(head, p, p + i);
+		if (old == p) {
+			*pos = p;
+			return i;
+		}
+		p = old;
+	}
+}
+
+/**
+ * mpmc_ring_produce_bulk - add entries to the ring
+ * @r:		the ring
+ * @ptrs:	the entries
+ * @n:		number of entries in @ptrs
+ *
+ * Queues as many entries from the start of @ptrs as there is room for,
+ * they are consumed in the same order.  Safe to call from any context
+ * and concurrently with any number of producers and consumers.
+ *
+ * Returns the number of entries queued.
+ */
+unsigned int mpmc_ring_produce_bulk(struct mpmc_ring *r, void **ptrs,
+				    unsigned int n)
+{
+	unsigned int done = 0;
+
+	while (done < n) {
+		struct mpmc_ring_slot *slot;
+		unsigned long pos;
+		unsigned int i, nr;
+
+		nr = mpmc_ring_claim(r, &r->prod, &pos, n - done, 0);
+		if (!nr)
+			break;
+
+		for (i = 0; i < nr; i++) {
+			slot = &r->slots[(pos + i) & r->mask];
+			slot->ptr = ptrs[done + i];
+			smp_store_release(&slot->seq, pos + i + 1);
+		}
+		done += nr;
+	}
+
+	return done;
+}
+EXPORT_SYMBOL(mpmc_ring_produce_bulk);
+
+/**
+ * mpmc_ring_consume_bulk - remove entries from the ring
+ * @r:		the ring
+ * @ptrs:	where to store the entries
+ * @n:		room in @ptrs
+ *
+ * Dequeues up to @n of the oldest entries.  Safe to call from any
+ * context and concurrently with any number of producers and consumers.
+ *
+ * Returns the number of entries stored in @ptrs.
+ */
+unsigned int mpmc_ring_consume_bulk(struct mpmc_ring *r, void **ptrs,
+				    unsigned int n)
+{
+	unsigned int done = 0;
+
+	while (done < n) {
+		struct mpmc_ring_slot *slot;
+		unsigned long pos;
+		unsigned int i, nr;
+
+		nr = mpmc_ring_claim(r, &r->cons, &pos, n - done, 1);
+		if (!nr)
+			break;
+
+		for (i = 0; i < nr; i++) {
+			slot = &r->slots[(pos + i) & r->mask];
+			ptrs[done + i] = slot->ptr;
+			smp_store_release(&slot->seq, pos + i + r->mask + 1);
+		}
+		done += nr;
+	}
+
+	return done;
+}
+EXPORT_SYMBOL(mpmc_ring_consume_bulk);
@@ -80,6 +80,66 @@ static inline void *indirect_to_ptr(void *ptr)
 	return (void *)((unsigned long)ptr & ~RADIX_TREE_INDIRECT_PTR);
 }
 
+/*
+ * A multi-order entry covering several slots of a node is stored in the
+ * first of them, the others hold sibling entries: indirect pointers to
+ * that first slot.  Child nodes are indirect pointers as well but they
+ * can never point into the slots of their own parent.
+ */
+static inline bool is_sibling_entry(struct radix_tree_node *parent, void *node)
+{
+	void **ptr = indirect_to_ptr(node);
+
+	return radix_tree_is_indirect_ptr(node) &&
+		ptr >= parent->slots &&
+		ptr < parent->slots + RADIX_TREE_MAP_SIZE;
+}
+
+static inline unsigned int get_slot_offset(struct radix_tree_node *parent,
+					   void **slot)
+{
+	return slot - parent->slots;
+}
+
+/*
+ * Look up the entry for @offset in @parent, following a sibling entry
+ * back to the slot of its multi-order entry.  Returns the offset of the
+ * slot the entry was read from.
+ */
+static inline unsigned int radix_tree_descend(struct radix_tree_node *parent,
+					      void **entryp, unsigned int offset)
+{
+	void *entry = rcu_dereference_raw(parent->slots[offset]);
+
+	if (is_sibling_entry(parent, entry)) {
+		offset = get_slot_offset(parent, indirect_to_ptr(entry));
+		entry = rcu_dereference_raw(parent->slots[offset]);
+	}
+
+	*entryp = entry;
+	return offset;
+}
+
+/*
+ * Number of sibling entries following the multi-order entry at @offset,
+ * that is the entry covers 1 + that many slots of @node.
+ */
+static inline unsigned int radix_tree_nr_siblings(struct radix_tree_node *node,
+						  unsigned int offset)
+{
+	void **slot = node->slots + offset;
+	unsigned int i;
+
+	for (i = offset + 1; i < RADIX_TREE_MAP_SIZE; i++) {
+		void *entry = rcu_dereference_raw(node->slots[i]);
+
+		if (!is_sibling_entry(node, entry) ||
+		    indirect_to_ptr(entry) != slot)
+			break;
+	}
+	return i - offset - 1;
+}
+
 static inline gfp_t root_gfp_mask(struct radix_tree_root *root)
 {
 	return root->gfp_mask & __GFP_BITS_MASK;
@@ -321,9 +381,11 @@ static inline unsigned long radix_tree_maxindex(unsigned int height)
 }
 
 /*
- *	Extend a radix tree so it can store key @index.
+ *	Extend a radix tree so it can store key @index, and an entry of
+ *	@order below its root node.
  */
-static int radix_tree_extend(struct radix_tree_root *root, unsigned long index)
+static int radix_tree_extend(struct radix_tree_root *root, unsigned long index,
+			     unsigned int order)
 {
 	struct radix_tree_node *node;
 	struct radix_tree_node *slot;
@@ -332,7 +394,8 @@ static int radix_tree_extend(struct radix_tree_root *root, unsigned long index)
 
 	/* Figure out what the height should be.  */
 	height = root->height + 1;
-	while (index > radix_tree_maxindex(height))
+	while (index > radix_tree_maxindex(height) ||
+	       order >= height * RADIX_TREE_MAP_SHIFT)
 		height++;
 
 	if (root->rnode == NULL) {
@@ -361,6 +424,7 @@ static int radix_tree_extend(struct radix_tree_root *root, unsigned long index)
 		if (newheight > 1) {
 			slot = indirect_to_ptr(slot);
 			slot->parent = node;
+			slot = ptr_to_indirect(slot);
 		}
 		node->slots[0] = slot;
 		node = ptr_to_indirect(node);
@@ -375,39 +439,46 @@ out:
  *	__radix_tree_create	-	create a slot in a radix tree
  *	@root:		radix tree root
  *	@index:		index key
+ *	@order:		index occupies 2^order aligned slots
  *	@nodep:		returns node
  *	@slotp:		returns slot
  *
  *	Create, if necessary, and return the node and slot for an item
- *	at position @index in the radix tree @root.
+ *	at position @index in the radix tree @root.  For an @order bigger
+ *	than zero, the slot is the first of those covering the range in
+ *	the lowest node whose slots are not smaller than 2^@order indices.
  *
  *	Until there is more than one item in the tree, no nodes are
  *	allocated and @root->rnode is used as a direct slot instead of
  *	pointing to a node, in which case *@nodep will be NULL.
  *
- *	Returns -ENOMEM, or 0 for success.
+ *	Returns -ENOMEM, -EEXIST if a multi-order entry already covers
+ *	@index, or 0 for success.
  */
 int __radix_tree_create(struct radix_tree_root *root, unsigned long index,
-			struct radix_tree_node **nodep, void ***slotp)
+			unsigned int order, struct radix_tree_node **nodep,
+			void ***slotp)
 {
 	struct radix_tree_node *node = NULL, *slot;
+	unsigned long max = index | ((1UL << order) - 1);
 	unsigned int height, shift, offset;
 	int error;
 
 	/* Make sure the tree is high enough.  */
-	if (index > radix_tree_maxindex(root->height)) {
-		error = radix_tree_extend(root, index);
+	if (max > radix_tree_maxindex(root->height) ||
+	    (order && order >= root->height * RADIX_TREE_MAP_SHIFT)) {
+		error = radix_tree_extend(root, max, order);
 		if (error)
 			return error;
 	}
 
-	slot = indirect_to_ptr(root->rnode);
+	slot = root->rnode;
 
 	height = root->height;
-	shift = (height-1) * RADIX_TREE_MAP_SHIFT;
+	shift = height * RADIX_TREE_MAP_SHIFT;
 
 	offset = 0;			/* uninitialised var warning */
-	while (height > 0) {
+	while (shift > order) {
 		if (slot == NULL) {
 			/* Have to add a child node.  */
 			if (!(slot = radix_tree_node_alloc(root)))
@@ -415,18 +486,25 @@ int __radix_tree_create(struct radix_tree_root *root, unsigned long index,
 			slot->path = height;
 			slot->parent = node;
 			if (node) {
-				rcu_assign_pointer(node->slots[offset], slot);
+				rcu_assign_pointer(node->slots[offset],
+						   ptr_to_indirect(slot));
 				node->count++;
 				slot->path |= offset << RADIX_TREE_HEIGHT_SHIFT;
 			} else
 				rcu_assign_pointer(root->rnode, ptr_to_indirect(slot));
+		} else if (!radix_tree_is_indirect_ptr(slot) ||
+			   (node && is_sibling_entry(node, slot))) {
+			/* A bigger entry covers index */
+			return -EEXIST;
+		} else {
+			slot = indirect_to_ptr(slot);
 		}
 
 		/* Go a level down */
+		shift -= RADIX_TREE_MAP_SHIFT;
 		offset = (index >> shift) & RADIX_TREE_MAP_MASK;
 		node = slot;
 		slot = node->slots[offset];
-		shift -= RADIX_TREE_MAP_SHIFT;
 		height--;
 	}
 
@@ -438,41 +516,64 @@ int __radix_tree_create(struct radix_tree_root *root, unsigned long index,
 }
 
 /**
- *	radix_tree_insert    -    insert into a radix tree
+ *	__radix_tree_insert    -    insert into a radix tree
  *	@root:		radix tree root
  *	@index:		index key
+ *	@order:		item covers 2^order indices from @index on
  *	@item:		item to insert
  *
- *	Insert an item into the radix tree at position @index.
+ *	Insert an item into the radix tree at position @index.  With an
+ *	@order bigger than zero, @index must be aligned to 2^@order and a
+ *	single entry covers all of the indices from @index to
+ *	@index + 2^@order - 1: lookups of any of them return @item, and
+ *	iterators and tags treat it as one item at @index.
+ *
+ *	Returns -EEXIST if any index in the range is already occupied.
  */
-int radix_tree_insert(struct radix_tree_root *root,
-			unsigned long index, void *item)
+int __radix_tree_insert(struct radix_tree_root *root, unsigned long index,
+			unsigned int order, void *item)
 {
 	struct radix_tree_node *node;
 	void **slot;
+	unsigned int height, offset, nr, i;
 	int error;
 
 	BUG_ON(radix_tree_is_indirect_ptr(item));
+	BUG_ON(order >= BITS_PER_LONG || index & ((1UL << order) - 1));
 
-	error = __radix_tree_create(root, index, &node, &slot);
+	error = __radix_tree_create(root, index, order, &node, &slot);
 	if (error)
 		return error;
-	if (*slot != NULL)
-		return -EEXIST;
-	rcu_assign_pointer(*slot, item);
 
-	if (node) {
-		node->count++;
-		BUG_ON(tag_get(node, 0, index & RADIX_TREE_MAP_MASK));
-		BUG_ON(tag_get(node, 1, index & RADIX_TREE_MAP_MASK));
-	} else {
+	if (!node) {
+		if (*slot != NULL)
+			return -EEXIST;
+		rcu_assign_pointer(*slot, item);
 		BUG_ON(root_tag_get(root, 0));
 		BUG_ON(root_tag_get(root, 1));
+		return 0;
 	}
 
+	offset = get_slot_offset(node, slot);
+	height = node->path & RADIX_TREE_HEIGHT_MASK;
+	nr = 1U << (order - (height - 1) * RADIX_TREE_MAP_SHIFT);
+	for (i = 0; i < nr; i++) {
+		if (slot[i] != NULL)
+			return -EEXIST;
+	}
+
+	/* Siblings first, lookups through them see NULL until the entry */
+	for (i = 1; i < nr; i++)
+		rcu_assign_pointer(slot[i], ptr_to_indirect(slot));
+	rcu_assign_pointer(*slot, item);
+
+	node->count += nr;
+	BUG_ON(tag_get(node, 0, offset));
+	BUG_ON(tag_get(node, 1, offset));
+
 	return 0;
 }
-EXPORT_SYMBOL(radix_tree_insert);
+EXPORT_SYMBOL(__radix_tree_insert);
 
 /**
  *	__radix_tree_lookup	-	lookup an item in a radix tree
@@ -482,7 +583,8 @@ EXPORT_SYMBOL(radix_tree_insert);
  *	@slotp:		returns slot
  *
  *	Lookup and return the item at position @index in the radix
- *	tree @root.
+ *	tree @root.  For a multi-order entry, *@slotp is the slot the
+ *	entry itself is stored in, whatever index it covers is asked for.
  *
  *	Until there is more than one item in the tree, no nodes are
  *	allocated and @root->rnode is used as a direct slot instead of
@@ -517,16 +619,23 @@ void *__radix_tree_lookup(struct radix_tree_root *root, unsigned long index,
 
 	shift = (height-1) * RADIX_TREE_MAP_SHIFT;
 
-	do {
+	for (;;) {
+		unsigned int offset;
+
 		parent = node;
-		slot = node->slots + ((index >> shift) & RADIX_TREE_MAP_MASK);
-		node = rcu_dereference_raw(*slot);
+		offset = (index >> shift) & RADIX_TREE_MAP_MASK;
+		offset = radix_tree_descend(parent, (void **)&node, offset);
+		slot = parent->slots + offset;
 		if (node == NULL)
 			return NULL;
+		/* a multi-order entry, or a retry hint in the bottom level */
+		if (!radix_tree_is_indirect_ptr(node) || height == 1)
+			break;
 
+		node = indirect_to_ptr(node);
 		shift -= RADIX_TREE_MAP_SHIFT;
 		height--;
-	} while (height > 0);
+	}
 
 	if (nodep)
 		*nodep = parent;
@@ -602,13 +711,18 @@ void *radix_tree_tag_set(struct radix_tree_root *root,
 	shift = (height - 1) * RADIX_TREE_MAP_SHIFT;
 
 	while (height > 0) {
+		struct radix_tree_node *node = slot;
 		int offset;
 
 		offset = (index >> shift) & RADIX_TREE_MAP_MASK;
-		if (!tag_get(slot, tag, offset))
-			tag_set(slot, tag, offset);
-		slot = slot->slots[offset];
+		offset = radix_tree_descend(node, (void **)&slot, offset);
+		if (!tag_get(node, tag, offset))
+			tag_set(node, tag, offset);
 		BUG_ON(slot == NULL);
+		/* a multi-order entry is tagged in its own slot only */
+		if (!radix_tree_is_indirect_ptr(slot))
+			break;
+		slot = indirect_to_ptr(slot);
 		shift -= RADIX_TREE_MAP_SHIFT;
 		height--;
 	}
@@ -648,16 +762,18 @@ void *radix_tree_tag_clear(struct radix_tree_root *root,
 		goto out;
 
 	shift = height * RADIX_TREE_MAP_SHIFT;
-	slot = indirect_to_ptr(root->rnode);
+	slot = root->rnode;
 
 	while (shift) {
 		if (slot == NULL)
 			goto out;
+		if (node && !radix_tree_is_indirect_ptr(slot))
+			break;
 
 		shift -= RADIX_TREE_MAP_SHIFT;
 		offset = (index >> shift) & RADIX_TREE_MAP_MASK;
-		node = slot;
-		slot = slot->slots[offset];
+		node = indirect_to_ptr(slot);
+		offset = radix_tree_descend(node, (void **)&slot, offset);
 	}
 
 	if (slot == NULL)
@@ -670,8 +786,7 @@ void *radix_tree_tag_clear(struct radix_tree_root *root,
 		if (any_tag_set(node, tag))
 			goto out;
 
-		index >>= RADIX_TREE_MAP_SHIFT;
-		offset = index & RADIX_TREE_MAP_MASK;
+		offset = node->path >> RADIX_TREE_HEIGHT_SHIFT;
 		node = node->parent;
 	}
 
@@ -724,17 +839,19 @@ int radix_tree_tag_get(struct radix_tree_root *root,
 	shift = (height - 1) * RADIX_TREE_MAP_SHIFT;
 
 	for ( ; ; ) {
+		struct radix_tree_node *child;
 		int offset;
 
 		if (node == NULL)
 			return 0;
 
 		offset = (index >> shift) & RADIX_TREE_MAP_MASK;
+		offset = radix_tree_descend(node, (void **)&child, offset);
 		if (!tag_get(node, tag, offset))
 			return 0;
-		if (height == 1)
+		if (height == 1 || (child && !radix_tree_is_indirect_ptr(child)))
 			return 1;
-		node = rcu_dereference_raw(node->slots[offset]);
+		node = indirect_to_ptr(child);
 		shift -= RADIX_TREE_MAP_SHIFT;
 		height--;
 	}
@@ -753,8 +870,9 @@ void **radix_tree_next_chunk(struct radix_tree_root *root,
 			     struct radix_tree_iter *iter, unsigned flags)
 {
 	unsigned shift, tag = flags & RADIX_TREE_ITER_TAG_MASK;
-	struct radix_tree_node *rnode, *node;
+	struct radix_tree_node *rnode, *node, *child;
 	unsigned long index, offset, height;
+	bool resume;
 
 	if ((flags & RADIX_TREE_ITER_TAGGED) && !root_tag_get(root, tag))
 		return NULL;
@@ -772,6 +890,14 @@ void **radix_tree_next_chunk(struct radix_tree_root *root,
 	if (!index && iter->index)
 		return NULL;
 
+	/*
+	 * radix_tree_next_slot() stops a chunk at a sibling entry with
+	 * next_index == index: the multi-order entry it belongs to has been
+	 * returned already.  Any other walk starting inside a multi-order
+	 * entry has to return it.
+	 */
+	resume = index == iter->index;
+
 	rnode = rcu_dereference_raw(root->rnode);
 	if (radix_tree_is_indirect_ptr(rnode)) {
 		rnode = indirect_to_ptr(rnode);
@@ -779,6 +905,7 @@ void **radix_tree_next_chunk(struct radix_tree_root *root,
 		/* Single-slot tree */
 		iter->index = 0;
 		iter->next_index = 1;
+		iter->shift = 0;
 		iter->tags = 1;
 		return (void **)&root->rnode;
 	} else
@@ -795,6 +922,28 @@ restart:
 
 	node = rnode;
 	while (1) {
+		child = rcu_dereference_raw(node->slots[offset]);
+		if (is_sibling_entry(node, child)) {
+			unsigned long first;
+
+			first = get_slot_offset(node, indirect_to_ptr(child));
+			if (resume) {
+				/* Skip the rest of the entry */
+				offset = first + radix_tree_nr_siblings(node,
+								first) + 1;
+				index &= ~((RADIX_TREE_MAP_SIZE << shift) - 1);
+				index += offset << shift;
+				if (!index)
+					return NULL;
+				if (offset == RADIX_TREE_MAP_SIZE)
+					goto restart;
+				continue;
+			}
+			offset = first;
+			index &= ~((RADIX_TREE_MAP_SIZE << shift) - 1);
+			index += offset << shift;
+		}
+
 		if ((flags & RADIX_TREE_ITER_TAGGED) ?
 				!test_bit(offset, node->tags[tag]) :
 				!node->slots[offset]) {
@@ -821,20 +970,37 @@ restart:
 				goto restart;
 		}
 
+		child = rcu_dereference_raw(node->slots[offset]);
+
 		/* This is leaf-node */
 		if (!shift)
 			break;
 
-		node = rcu_dereference_raw(node->slots[offset]);
-		if (node == NULL)
+		if (child == NULL)
 			goto restart;
+		/* A multi-order entry */
+		if (!radix_tree_is_indirect_ptr(child))
+			break;
+
+		node = indirect_to_ptr(child);
 		shift -= RADIX_TREE_MAP_SHIFT;
 		offset = (index >> shift) & RADIX_TREE_MAP_MASK;
 	}
 
+	/* A multi-order entry is a chunk of its own */
+	if (shift || radix_tree_nr_siblings(node, offset)) {
+		iter->shift = shift + ilog2(radix_tree_nr_siblings(node,
+							offset) + 1);
+		iter->index = index & ~((1UL << iter->shift) - 1);
+		iter->next_index = iter->index + (1UL << iter->shift);
+		iter->tags = 1;
+		return node->slots + offset;
+	}
+
 	/* Update the iterator state */
 	iter->index = index;
 	iter->next_index = (index | RADIX_TREE_MAP_MASK) + 1;
+	iter->shift = 0;
 
 	/* Construct iter->tags bit-mask from node->tags[tag] array */
 	if (flags & RADIX_TREE_ITER_TAGGED) {
@@ -917,27 +1083,29 @@ unsigned long radix_tree_range_tag_if_tagged(struct radix_tree_root *root,
 
 	for (;;) {
 		unsigned long upindex;
+		void *child;
 		int offset;
 
 		offset = (index >> shift) & RADIX_TREE_MAP_MASK;
-		if (!slot->slots[offset])
+		child = slot->slots[offset];
+		if (!child)
 			goto next;
 		if (!tag_get(slot, iftag, offset))
 			goto next;
-		if (shift) {
+		if (shift && radix_tree_is_indirect_ptr(child)) {
 			/* Go down one level */
 			shift -= RADIX_TREE_MAP_SHIFT;
 			node = slot;
-			slot = slot->slots[offset];
+			slot = indirect_to_ptr(child);
 			continue;
 		}
 
-		/* tag the leaf */
+		/* tag the leaf, or the multi-order entry */
 		tagged++;
 		tag_set(slot, settag, offset);
 
 		/* walk back up the path tagging interior nodes */
-		upindex = index;
+		upindex = index >> shift;
 		while (node) {
 			upindex >>= RADIX_TREE_MAP_SHIFT;
 			offset = upindex & RADIX_TREE_MAP_MASK;
@@ -1072,6 +1240,81 @@ radix_tree_gang_lookup_slot(struct radix_tree_root *root,
 }
 EXPORT_SYMBOL(radix_tree_gang_lookup_slot);
 
+/**
+ *	radix_tree_gang_lookup_get - perform multiple lookup taking references
+ *	@root:		radix tree root
+ *	@results:	where the results of the lookup are placed
+ *	@indices:	where their indices should be placed (but usually NULL)
+ *	@first_index:	start the lookup from this key
+ *	@max_items:	place up to this many items at *results
+ *	@get:		try to take a reference on an item
+ *	@put:		drop a reference taken by @get
+ *
+ *	Performs an index-ascending scan of the tree for present items,
+ *	takes a reference on each of them and places them at *@results.
+ *	Returns the number of items which were placed at *@results.
+ *
+ *	The scan itself runs under rcu_read_lock, so the caller need not
+ *	exclude modifications of the tree: @get is called on items that may
+ *	be in the process of being freed and has to fail if so, the lookup of
+ *	that index is retried then.  An item that was replaced after @get
+ *	got its reference is handed to @put and looked up again, and the
+ *	walk is restarted if the tree changed shape under it.  Each item
+ *	returned had a reference taken while it was in the tree.
+ *
+ *	A multi-order entry is returned once, at the first index it covers.
+ *	Exceptional entries are returned as they are, @get is not called
+ *	for them.
+ */
+unsigned int
+radix_tree_gang_lookup_get(struct radix_tree_root *root, void **results,
+			   unsigned long *indices, unsigned long first_index,
+			   unsigned int max_items, bool (*get)(void *item),
+			   void (*put)(void *item))
+{
+	struct radix_tree_iter iter;
+	void **slot;
+	unsigned int ret = 0;
+
+	if (unlikely(!max_items))
+		return 0;
+
+	rcu_read_lock();
+restart:
+	radix_tree_for_each_slot(slot, root, &iter, first_index) {
+		void *item;
+repeat:
+		item = radix_tree_deref_slot(slot);
+		if (unlikely(!item))
+			continue;
+
+		if (radix_tree_exception(item)) {
+			if (radix_tree_deref_retry(item)) {
+				first_index = iter.index;
+				goto restart;
+			}
+		} else {
+			if (!get(item))
+				goto repeat;
+			/* Has the item moved? */
+			if (unlikely(item != *slot)) {
+				put(item);
+				goto repeat;
+			}
+		}
+
+		results[ret] = item;
+		if (indices)
+			indices[ret] = iter.index;
+		if (++ret == max_items)
+			break;
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+EXPORT_SYMBOL(radix_tree_gang_lookup_get);
+
 /**
  *	radix_tree_gang_lookup_tag - perform multiple lookup on a radix tree
  *	                             based on a tag
@@ -1160,9 +1403,19 @@ static unsigned long __locate(struct radix_tree_node *slot, void *item,
 	shift = (height-1) * RADIX_TREE_MAP_SHIFT;
 
 	for ( ; height > 1; height--) {
+		void *child;
+
 		i = (index >> shift) & RADIX_TREE_MAP_MASK;
 		for (;;) {
-			if (slot->slots[i] != NULL)
+			child = rcu_dereference_raw(slot->slots[i]);
+			if (child == item) {
+				/* a multi-order entry */
+				*found_index = index & ~((1UL << shift) - 1);
+				index = 0;
+				goto out;
+			}
+			if (radix_tree_is_indirect_ptr(child) &&
+			    !is_sibling_entry(slot, child))
 				break;
 			index &= ~((1UL << shift) - 1);
 			index += 1UL << shift;
@@ -1174,9 +1427,7 @@ static unsigned long __locate(struct radix_tree_node *slot, void *item,
 		}
 
 		shift -= RADIX_TREE_MAP_SHIFT;
-		slot = rcu_dereference_raw(slot->slots[i]);
-		if (slot == NULL)
-			goto out;
+		slot = indirect_to_ptr(child);
 	}
 
 	/* Bottom level: check items */
@@ -1262,6 +1513,10 @@ static inline void radix_tree_shrink(struct radix_tree_root *root)
 			break;
 		if (!to_free->slots[0])
 			break;
+		/* A multi-order entry in slot 0 covers more than index 0 */
+		if (root->height > 1 &&
+		    !radix_tree_is_indirect_ptr(to_free->slots[0]))
+			break;
 
 		/*
 		 * We don't need rcu_assign_pointer(), since we are simply
@@ -1272,6 +1527,7 @@ static inline void radix_tree_shrink(struct radix_tree_root *root)
 		 */
 		slot = to_free->slots[0];
 		if (root->height > 1) {
+			slot = indirect_to_ptr(slot);
 			slot->parent = NULL;
 			slot = ptr_to_indirect(slot);
 		}
@@ -1369,7 +1625,7 @@ void *radix_tree_delete_item(struct radix_tree_root *root,
 			     unsigned long index, void *item)
 {
 	struct radix_tree_node *node;
-	unsigned int offset;
+	unsigned int offset, nr, i;
 	void **slot;
 	void *entry;
 	int tag;
@@ -1387,7 +1643,7 @@ void *radix_tree_delete_item(struct radix_tree_root *root,
 		return entry;
 	}
 
-	offset = index & RADIX_TREE_MAP_MASK;
+	offset = get_slot_offset(node, slot);
 
 	/*
 	 * Clear all tags associated with the item to be deleted.
@@ -1398,8 +1654,11 @@ void *radix_tree_delete_item(struct radix_tree_root *root,
 			radix_tree_tag_clear(root, index, tag);
 	}
 
-	node->slots[offset] = NULL;
-	node->count--;
+	/* A multi-order entry goes away with all of its siblings */
+	nr = radix_tree_nr_siblings(node, offset) + 1;
+	for (i = 0; i < nr; i++)
+		node->slots[offset + i] = NULL;
+	node->count -= nr;
 
 	__radix_tree_delete_node(root, node);
 
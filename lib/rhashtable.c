@@ -27,6 +27,7 @@
 #include <linux/rhashtable.h>
 #include <linux/err.h>
 #include <linux/export.h>
+#include <linux/sort.h>
 
 #define HASH_DEFAULT_SIZE	64UL
 #define HASH_MIN_SIZE		4U
@@ -97,8 +98,13 @@ static int alloc_bucket_locks(struct rhashtable *ht, struct bucket_table *tbl,
 
 static void bucket_table_free(const struct bucket_table *tbl)
 {
-	if (tbl)
+	unsigned int i;
+
+	if (tbl) {
 		kvfree(tbl->locks);
+		for (i = 0; tbl->nest && i < tbl->size >> tbl->nest; i++)
+			free_page((unsigned long)tbl->segs[i]);
+	}
 
 	kvfree(tbl);
 }
@@ -108,6 +114,84 @@ static void bucket_table_free_rcu(struct rcu_head *head)
 	bucket_table_free(container_of(head, struct bucket_table, rcu));
 }
 
+/*
+ * Where the bucket array cannot be allocated in one piece without
+ * sleeping, build it out of single pages, which atomic allocations get
+ * far more easily at sizes of millions of entries.  Only the segment
+ * pointers are allocated here; rht_bucket_nested_insert() allocates each
+ * page when something is first inserted into it.
+ */
+static struct bucket_table *nested_table_alloc(size_t nbuckets, gfp_t gfp)
+{
+	const unsigned int shift = PAGE_SHIFT - ilog2(sizeof(void *));
+	struct bucket_table *tbl;
+	size_t nsegs;
+
+	if (nbuckets <= (1UL << shift))
+		return NULL;
+
+	nsegs = nbuckets >> shift;
+	tbl = kzalloc(sizeof(*tbl) + nsegs * sizeof(tbl->segs[0]),
+		      gfp | __GFP_NOWARN);
+	if (tbl == NULL)
+		return NULL;
+
+	tbl->size = nbuckets;
+	tbl->nest = shift;
+	tbl->segs = (void *)tbl->buckets;
+
+	return tbl;
+}
+
+/* Lookups in a segment that was never inserted into find this. */
+static struct rhash_head __rcu *rht_nested_empty =
+	(struct rhash_head __rcu *)NULLS_MARKER(0);
+
+struct rhash_head __rcu **rht_bucket_nested(const struct bucket_table *tbl,
+					    unsigned int hash)
+{
+	struct rhash_head __rcu **seg;
+
+	seg = lockless_dereference(tbl->segs[hash >> tbl->nest]);
+	if (!seg)
+		return &rht_nested_empty;
+
+	return &seg[hash & ((1U << tbl->nest) - 1)];
+}
+EXPORT_SYMBOL_GPL(rht_bucket_nested);
+
+struct rhash_head __rcu **rht_bucket_nested_insert(struct rhashtable *ht,
+						   struct bucket_table *tbl,
+						   unsigned int hash)
+{
+	const unsigned int nr = 1U << tbl->nest;
+	unsigned int base = hash & ~(nr - 1);
+	struct rhash_head __rcu **seg, **old;
+	unsigned int i;
+
+	seg = lockless_dereference(tbl->segs[hash >> tbl->nest]);
+	if (seg)
+		goto out;
+
+	seg = (void *)__get_free_page(GFP_ATOMIC | __GFP_NOWARN);
+	if (!seg)
+		return NULL;
+
+	for (i = 0; i < nr; i++)
+		INIT_RHT_NULLS_HEAD(seg[i], ht, base + i);
+
+	/* The buckets of a segment are not all covered by the same lock. */
+	old = cmpxchg(&tbl->segs[hash >> tbl->nest], NULL, seg);
+	if (old) {
+		free_page((unsigned long)seg);
+		seg = old;
+	}
+
+out:
+	return &seg[hash & (nr - 1)];
+}
+EXPORT_SYMBOL_GPL(rht_bucket_nested_insert);
+
 static struct bucket_table *bucket_table_alloc(struct rhashtable *ht,
 					       size_t nbuckets,
 					       gfp_t gfp)
@@ -122,6 +206,8 @@ static struct bucket_table *bucket_table_alloc(struct rhashtable *ht,
 		tbl = kzalloc(size, gfp | __GFP_NOWARN | __GFP_NORETRY);
 	if (tbl == NULL && gfp == GFP_KERNEL)
 		tbl = vzalloc(size);
+	if (tbl == NULL && gfp != GFP_KERNEL)
+		tbl = nested_table_alloc(nbuckets, gfp);
 	if (tbl == NULL)
 		return NULL;
 
@@ -136,7 +222,7 @@ static struct bucket_table *bucket_table_alloc(struct rhashtable *ht,
 
 	get_random_bytes(&tbl->hash_rnd, sizeof(tbl->hash_rnd));
 
-	for (i = 0; i < nbuckets; i++)
+	for (i = 0; i < nbuckets && !tbl->nest; i++)
 		INIT_RHT_NULLS_HEAD(tbl->buckets[i], ht, i);
 
 	return tbl;
@@ -160,8 +246,9 @@ static int rhashtable_rehash_one(struct rhashtable *ht, unsigned int old_hash)
 	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	struct bucket_table *new_tbl = rhashtable_last_table(ht,
 		rht_dereference_rcu(old_tbl->future_tbl, ht));
-	struct rhash_head __rcu **pprev = &old_tbl->buckets[old_hash];
+	struct rhash_head __rcu **pprev = rht_bucket(old_tbl, old_hash);
 	int err = -ENOENT;
+	struct rhash_head __rcu **bkt;
 	struct rhash_head *head, *next, *entry;
 	spinlock_t *new_bucket_lock;
 	unsigned int new_hash;
@@ -181,15 +268,20 @@ static int rhashtable_rehash_one(struct rhashtable *ht, unsigned int old_hash)
 
 	new_hash = head_hashfn(ht, new_tbl, entry);
 
+	err = -ENOMEM;
+	bkt = rht_bucket_insert(ht, new_tbl, new_hash);
+	if (!bkt)
+		goto out;
+
+	err = 0;
 	new_bucket_lock = rht_bucket_lock(new_tbl, new_hash);
 
 	spin_lock_nested(new_bucket_lock, SINGLE_DEPTH_NESTING);
-	head = rht_dereference_bucket(new_tbl->buckets[new_hash],
-				      new_tbl, new_hash);
+	head = rht_dereference_bucket(*bkt, new_tbl, new_hash);
 
 	RCU_INIT_POINTER(entry->next, head);
 
-	rcu_assign_pointer(new_tbl->buckets[new_hash], entry);
+	rcu_assign_pointer(*bkt, entry);
 	spin_unlock(new_bucket_lock);
 
 	rcu_assign_pointer(*pprev, next);
@@ -198,19 +290,26 @@ out:
 	return err;
 }
 
-static void rhashtable_rehash_chain(struct rhashtable *ht,
-				    unsigned int old_hash)
+static int rhashtable_rehash_chain(struct rhashtable *ht,
+				   unsigned int old_hash)
 {
 	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	spinlock_t *old_bucket_lock;
+	int err;
 
 	old_bucket_lock = rht_bucket_lock(old_tbl, old_hash);
 
 	spin_lock_bh(old_bucket_lock);
-	while (!rhashtable_rehash_one(ht, old_hash))
+	while (!(err = rhashtable_rehash_one(ht, old_hash)))
 		;
-	old_tbl->rehash++;
+
+	if (err == -ENOENT) {
+		old_tbl->rehash++;
+		err = 0;
+	}
 	spin_unlock_bh(old_bucket_lock);
+
+	return err;
 }
 
 static int rhashtable_rehash_attach(struct rhashtable *ht,
@@ -245,13 +344,18 @@ static int rhashtable_rehash_table(struct rhashtable *ht)
 	struct bucket_table *new_tbl;
 	struct rhashtable_walker *walker;
 	unsigned int old_hash;
+	int err;
 
 	new_tbl = rht_dereference(old_tbl->future_tbl, ht);
 	if (!new_tbl)
 		return 0;
 
-	for (old_hash = 0; old_hash < old_tbl->size; old_hash++)
-		rhashtable_rehash_chain(ht, old_hash);
+	/* Picks up where a failed segment allocation stopped it last time. */
+	for (old_hash = old_tbl->rehash; old_hash < old_tbl->size; old_hash++) {
+		err = rhashtable_rehash_chain(ht, old_hash);
+		if (err)
+			return err;
+	}
 
 	/* Publish the new table pointer. */
 	rcu_assign_pointer(ht->tbl, new_tbl);
@@ -285,16 +389,16 @@ static int rhashtable_rehash_table(struct rhashtable *ht)
  * It is valid to have concurrent insertions and deletions protected by per
  * bucket locks or concurrent RCU protected lookups and traversals.
  */
-static int rhashtable_expand(struct rhashtable *ht)
+static int rhashtable_rehash_alloc(struct rhashtable *ht,
+				   struct bucket_table *old_tbl,
+				   unsigned int size)
 {
-	struct bucket_table *new_tbl, *old_tbl = rht_dereference(ht->tbl, ht);
+	struct bucket_table *new_tbl;
 	int err;
 
 	ASSERT_RHT_MUTEX(ht);
 
-	old_tbl = rhashtable_last_table(ht, old_tbl);
-
-	new_tbl = bucket_table_alloc(ht, old_tbl->size * 2, GFP_KERNEL);
+	new_tbl = bucket_table_alloc(ht, size, GFP_KERNEL);
 	if (new_tbl == NULL)
 		return -ENOMEM;
 
@@ -305,6 +409,15 @@ static int rhashtable_expand(struct rhashtable *ht)
 	return err;
 }
 
+static int rhashtable_expand(struct rhashtable *ht)
+{
+	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
+
+	old_tbl = rhashtable_last_table(ht, old_tbl);
+
+	return rhashtable_rehash_alloc(ht, old_tbl, old_tbl->size * 2);
+}
+
 /**
  * rhashtable_shrink - Shrink hash table while allowing concurrent lookups
  * @ht:		the hash table to shrink
@@ -366,6 +479,8 @@ static void rht_deferred_worker(struct work_struct *work)
 		rhashtable_expand(ht);
 	else if (ht->p.automatic_shrinking && rht_shrink_below_30(ht, tbl))
 		rhashtable_shrink(ht);
+	else if (tbl->nest)
+		rhashtable_rehash_alloc(ht, tbl, tbl->size);
 
 	err = rhashtable_rehash_table(ht);
 
@@ -408,6 +523,7 @@ int rhashtable_insert_rehash(struct rhashtable *ht)
 	else if (old_tbl != tbl)
 		return -EBUSY;
 
+	/* Falls back to a nested table, flattened later by the worker. */
 	new_tbl = bucket_table_alloc(ht, size, GFP_ATOMIC);
 	if (new_tbl == NULL) {
 		/* Schedule async resize/rehash to try allocation
@@ -433,6 +549,7 @@ int rhashtable_insert_slow(struct rhashtable *ht, const void *key,
 			   struct rhash_head *obj,
 			   struct bucket_table *tbl)
 {
+	struct rhash_head __rcu **bkt;
 	struct rhash_head *head;
 	unsigned int hash;
 	int err;
@@ -454,13 +571,18 @@ int rhashtable_insert_slow(struct rhashtable *ht, const void *key,
 	    rht_grow_above_100(ht, tbl))
 		goto exit;
 
+	err = -ENOMEM;
+	bkt = rht_bucket_insert(ht, tbl, hash);
+	if (!bkt)
+		goto exit;
+
 	err = 0;
 
-	head = rht_dereference_bucket(tbl->buckets[hash], tbl, hash);
+	head = rht_dereference_bucket(*bkt, tbl, hash);
 
 	RCU_INIT_POINTER(obj->next, head);
 
-	rcu_assign_pointer(tbl->buckets[hash], obj);
+	rcu_assign_pointer(*bkt, obj);
 
 	atomic_inc(&ht->nelems);
 
@@ -471,6 +593,128 @@ exit:
 }
 EXPORT_SYMBOL_GPL(rhashtable_insert_slow);
 
+#define RHT_BULK_BATCH	32
+
+struct rht_bulk_entry {
+	unsigned int		lock;
+	unsigned int		hash;
+	struct rhash_head	*obj;
+};
+
+static int rht_bulk_cmp(const void *a, const void *b)
+{
+	const struct rht_bulk_entry *x = a, *y = b;
+
+	return x->lock < y->lock ? -1 : x->lock > y->lock;
+}
+
+/* Bucket lock held, no rehash in progress. */
+static bool rht_bulk_insert_one(struct rhashtable *ht,
+				struct bucket_table *tbl,
+				struct rht_bulk_entry *e)
+{
+	unsigned int elasticity = ht->elasticity;
+	struct rhash_head __rcu **bkt;
+	struct rhash_head *head;
+
+	if (rht_grow_above_max(ht, tbl) || rht_grow_above_100(ht, tbl))
+		return false;
+
+	rht_for_each(head, tbl, e->hash)
+		if (!--elasticity)
+			return false;
+
+	bkt = rht_bucket_insert(ht, tbl, e->hash);
+	if (!bkt)
+		return false;
+
+	head = rht_dereference_bucket(*bkt, tbl, e->hash);
+	RCU_INIT_POINTER(e->obj->next, head);
+	rcu_assign_pointer(*bkt, e->obj);
+	atomic_inc(&ht->nelems);
+
+	return true;
+}
+
+/**
+ * rhashtable_insert_bulk - insert a batch of objects into the hash table
+ * @ht:		hash table
+ * @objs:	the hash heads inside the objects
+ * @nr:		number of objects in @objs
+ *
+ * Inserts the objects the way rhashtable_insert_fast() does, without any
+ * duplicate check, but hashes them RHT_BULK_BATCH at a time and takes
+ * each bucket lock only once for all of the objects of a batch that it
+ * covers.  Anything that needs a rehash first goes through the single
+ * object path, so the same errors apply.
+ *
+ * @objs is reordered: on return its first entries are the objects that
+ * were inserted.  Returns how many those are, or the error that stopped
+ * the first insertion.
+ *
+ * It is safe to call this function from atomic context.
+ */
+int rhashtable_insert_bulk(struct rhashtable *ht, struct rhash_head **objs,
+			   unsigned int nr)
+{
+	struct rht_bulk_entry batch[RHT_BULK_BATCH];
+	unsigned int done = 0;
+	int err = 0;
+
+	while (done < nr && !err) {
+		unsigned int n = min_t(unsigned int, nr - done, RHT_BULK_BATCH);
+		struct bucket_table *tbl;
+		spinlock_t *lock = NULL;
+		unsigned int i, j;
+
+		rcu_read_lock();
+		tbl = rht_dereference_rcu(ht->tbl, ht);
+
+		for (i = 0; i < n; i++) {
+			batch[i].obj = objs[done + i];
+			batch[i].hash = head_hashfn(ht, tbl, batch[i].obj);
+			batch[i].lock = batch[i].hash & tbl->locks_mask;
+		}
+		sort(batch, n, sizeof(batch[0]), rht_bulk_cmp, NULL);
+
+		for (i = 0; i < n; i++) {
+			spinlock_t *next = rht_bucket_lock(tbl, batch[i].hash);
+
+			if (next != lock) {
+				if (lock)
+					spin_unlock_bh(lock);
+				lock = next;
+				spin_lock_bh(lock);
+			}
+
+			/* future_tbl is only set with a bucket lock held */
+			if (rcu_access_pointer(tbl->future_tbl) ||
+			    !rht_bulk_insert_one(ht, tbl, &batch[i]))
+				break;
+			objs[done++] = batch[i].obj;
+		}
+		if (lock)
+			spin_unlock_bh(lock);
+
+		if (rht_grow_above_75(ht, tbl))
+			schedule_work(&ht->run_work);
+		rcu_read_unlock();
+
+		for (; i < n; i++) {
+			err = __rhashtable_insert_fast(ht, NULL, batch[i].obj,
+						       ht->p);
+			if (err)
+				break;
+			objs[done++] = batch[i].obj;
+		}
+		for (j = i; j < n; j++)
+			objs[done + j - i] = batch[j].obj;
+	}
+
+	return done ? done : err;
+}
+EXPORT_SYMBOL_GPL(rhashtable_insert_bulk);
+
 /**
  * rhashtable_walk_init - Initialise an iterator
  * @ht:		Table to walk over
@@ -819,7 +1063,7 @@ void rhashtable_free_and_destroy(struct rhashtable *ht,
 		for (i = 0; i < tbl->size; i++) {
 			struct rhash_head *pos, *next;
 
-			for (pos = rht_dereference(tbl->buckets[i], ht),
+			for (pos = rht_dereference(*rht_bucket(tbl, i), ht),
 			     next = !rht_is_a_nulls(pos) ?
 					rht_dereference(pos->next, ht) : NULL;
 			     !rht_is_a_nulls(pos);
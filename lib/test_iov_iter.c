@@ -0,0 +1,153 @@
+/*
+ * Correctness check and benchmark of copying pages to and from
+ * iov_iters made of many small user iovecs, as done by readv()/writev().
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/fs.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/uio.h>
+
+#define MAX_SEGS	256
+
+static int segs = 64;
+module_param(segs, int, 0);
+MODULE_PARM_DESC(segs, "Number of iovecs per page (default: 64)");
+
+static int loops = 100000;
+module_param(loops, int, 0);
+MODULE_PARM_DESC(loops, "Copies per direction (default: 100000)");
+
+static void init_iovecs(struct iovec *iov, char __user *base)
+{
+	size_t len = PAGE_SIZE / segs;
+	int i;
+
+	/* leave a gap after each segment, so that no two are contiguous */
+	for (i = 0; i < segs; i++) {
+		iov[i].iov_base = base + i * 2 * len;
+		iov[i].iov_len = i == segs - 1 ? PAGE_SIZE - i * len : len;
+	}
+}
+
+static int __init test_iov_iter_bench(struct iovec *iov, struct page *src,
+				      struct page *dst)
+{
+	struct iov_iter iter;
+	u64 start, to_ns, from_ns;
+	int i;
+
+	start = ktime_get_ns();
+	for (i = 0; i < loops; i++) {
+		iov_iter_init(&iter, READ, iov, segs, PAGE_SIZE);
+		if (copy_page_to_iter(src, 0, PAGE_SIZE, &iter) != PAGE_SIZE)
+			return -EFAULT;
+	}
+	to_ns = ktime_get_ns() - start;
+
+	start = ktime_get_ns();
+	for (i = 0; i < loops; i++) {
+		iov_iter_init(&iter, WRITE, iov, segs, PAGE_SIZE);
+		if (copy_page_from_iter(dst, 0, PAGE_SIZE, &iter) != PAGE_SIZE)
+			return -EFAULT;
+	}
+	from_ns = ktime_get_ns() - start;
+
+	pr_info("%d iovecs per page: copy_page_to_iter %llu ns, copy_page_from_iter %llu ns\n",
+		segs, div_u64(to_ns, loops), div_u64(from_ns, loops));
+
+	return 0;
+}
+
+static int __init test_iov_iter_init(void)
+{
+	struct iovec *iov;
+	struct iov_iter iter;
+	struct page *src, *dst;
+	unsigned long user_addr;
+	size_t map_len = 3 * PAGE_SIZE;
+	int ret = -ENOMEM;
+
+	segs = clamp(segs, 1, MAX_SEGS);
+	loops = max(loops, 1);
+
+	iov = kcalloc(segs, sizeof(*iov), GFP_KERNEL);
+	src = alloc_page(GFP_KERNEL);
+	dst = alloc_page(GFP_KERNEL);
+	if (!iov || !src || !dst)
+		goto out_free;
+
+	user_addr = vm_mmap(NULL, 0, map_len, PROT_READ | PROT_WRITE,
+			    MAP_ANONYMOUS | MAP_PRIVATE, 0);
+	if (user_addr >= (unsigned long)(TASK_SIZE)) {
+		pr_warn("Failed to allocate user memory\n");
+		goto out_free;
+	}
+	init_iovecs(iov, (char __user *)user_addr);
+
+	/*
+	 * The user pages are not faulted in yet, so the first round trip
+	 * also exercises the fault handling.
+	 */
+	prandom_bytes(page_address(src), PAGE_SIZE);
+	memset(page_address(dst), 0, PAGE_SIZE);
+
+	ret = -EINVAL;
+	iov_iter_init(&iter, READ, iov, segs, PAGE_SIZE);
+	if (copy_page_to_iter(src, 0, PAGE_SIZE, &iter) != PAGE_SIZE ||
+	    iov_iter_count(&iter)) {
+		pr_warn("copy_page_to_iter came up short\n");
+		goto out_unmap;
+	}
+
+	iov_iter_init(&iter, WRITE, iov, segs, PAGE_SIZE);
+	if (iov_iter_fault_in_readable(&iter, PAGE_SIZE) ||
+	    copy_page_from_iter(dst, 0, PAGE_SIZE, &iter) != PAGE_SIZE ||
+	    iov_iter_count(&iter)) {
+		pr_warn("copy_page_from_iter came up short\n");
+		goto out_unmap;
+	}
+
+	if (memcmp(page_address(src), page_address(dst), PAGE_SIZE)) {
+		pr_warn("data corrupted on the round trip\n");
+		goto out_unmap;
+	}
+
+	ret = test_iov_iter_bench(iov, src, dst);
+	if (ret)
+		pr_warn("benchmark copy came up short\n");
+	else
+		pr_info("tests passed.\n");
+
+out_unmap:
+	vm_munmap(user_addr, map_len);
+out_free:
+	if (dst)
+		__free_page(dst);
+	if (src)
+		__free_page(src);
+	kfree(iov);
+	return ret;
+}
+
+module_init(test_iov_iter_init);
+
+static void __exit test_iov_iter_exit(void)
+{
+}
+
+module_exit(test_iov_iter_exit);
+
+MODULE_LICENSE("GPL");
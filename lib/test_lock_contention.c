@@ -0,0 +1,128 @@
+/*
+ * Kernel module for testing the lock contention profiler.
+ *
+ * Turns the profiler on and takes uncontended locks through every hooked
+ * entry point. The trylock the profiler does first then succeeds, and the
+ * lock must end up held exactly once: a second acquisition hangs on a
+ * spinlock and shows up as a leaked read count on an rwsem.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/lock_contention.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/rwsem.h>
+#include <linux/spinlock.h>
+
+static DEFINE_SPINLOCK(test_spinlock);
+static DECLARE_RWSEM(test_rwsem);
+static DEFINE_MUTEX(test_mutex);
+
+static int __init test_spinlocks(void)
+{
+	unsigned long flags;
+
+	spin_lock(&test_spinlock);
+	spin_unlock(&test_spinlock);
+
+	spin_lock_irq(&test_spinlock);
+	spin_unlock_irq(&test_spinlock);
+
+	spin_lock_irqsave(&test_spinlock, flags);
+	spin_unlock_irqrestore(&test_spinlock, flags);
+
+	spin_lock_bh(&test_spinlock);
+	spin_unlock_bh(&test_spinlock);
+
+	if (spin_is_locked(&test_spinlock)) {
+		pr_err("spinlock still held after unlock\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int __init test_rwsems(void)
+{
+	down_read(&test_rwsem);
+	if (down_write_trylock(&test_rwsem)) {
+		pr_err("rwsem write locked while held for read\n");
+		up_write(&test_rwsem);
+		up_read(&test_rwsem);
+		return -EINVAL;
+	}
+	up_read(&test_rwsem);
+
+	/* fails if down_read() took more than one read count */
+	if (!down_write_trylock(&test_rwsem)) {
+		pr_err("rwsem still held for read after up_read()\n");
+		return -EINVAL;
+	}
+	up_write(&test_rwsem);
+
+	down_write(&test_rwsem);
+	if (down_read_trylock(&test_rwsem)) {
+		pr_err("rwsem read locked while held for write\n");
+		up_read(&test_rwsem);
+		up_write(&test_rwsem);
+		return -EINVAL;
+	}
+	up_write(&test_rwsem);
+
+	if (!down_read_trylock(&test_rwsem)) {
+		pr_err("rwsem still held for write after up_write()\n");
+		return -EINVAL;
+	}
+	up_read(&test_rwsem);
+
+	return 0;
+}
+
+static int __init test_mutexes(void)
+{
+	mutex_lock(&test_mutex);
+	mutex_unlock(&test_mutex);
+
+	if (mutex_is_locked(&test_mutex)) {
+		pr_err("mutex still held after unlock\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int __init test_lock_contention_init(void)
+{
+	unsigned int old_rate;
+	int ret;
+
+	/* sample every contended acquisition */
+	old_rate = lock_contention_set_sample_rate(1);
+
+	ret = test_spinlocks();
+	if (!ret)
+		ret = test_rwsems();
+	if (!ret)
+		ret = test_mutexes();
+
+	lock_contention_set_sample_rate(old_rate);
+
+	if (!ret)
+		pr_info("all tests passed\n");
+
+	return ret;
+}
+
+static void __exit test_lock_contention_exit(void)
+{
+}
+
+module_init(test_lock_contention_init);
+module_exit(test_lock_contention_exit);
+
+MODULE_LICENSE("GPL");
@@ -0,0 +1,301 @@
+/*
+ * Self test and benchmark for the lockless MPMC pointer ring
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/mpmc_ring.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/completion.h>
+
+#define MAX_BULK	64
+
+static int size = 1024;
+module_param(size, int, 0);
+MODULE_PARM_DESC(size, "Number of slots in the ring (default: 1024)");
+
+static int entries = 1000000;
+module_param(entries, int, 0);
+MODULE_PARM_DESC(entries, "Entries queued by each producer (default: 1000000)");
+
+static int bulk = 16;
+module_param(bulk, int, 0);
+MODULE_PARM_DESC(bulk, "Entries per produce/consume call (default: 16)");
+
+static int tcount = 2;
+module_param(tcount, int, 0);
+MODULE_PARM_DESC(tcount, "Number of producers and of consumers (default: 2)");
+
+struct thread_data {
+	int id;
+	struct task_struct *task;
+	u64 sum;
+	int err;
+};
+
+static struct mpmc_ring ring;
+static atomic_t producers_left;
+static atomic_long_t consumed;
+static DECLARE_COMPLETION(startup_done);
+static atomic_t threads_ready;
+
+/* entries are never NULL: encode the producer id and a 1 based index */
+static inline void *test_entry(int id, unsigned long i)
+{
+	return (void *)(((unsigned long)id << 24) | (i + 1));
+}
+
+static int __init test_mpmc_single(void)
+{
+	void *buf[MAX_BULK];
+	unsigned int i, n, sz;
+	int err;
+
+	err = mpmc_ring_init(&ring, 8, GFP_KERNEL);
+	if (err)
+		return err;
+	sz = mpmc_ring_size(&ring);
+
+	if (mpmc_ring_consume(&ring)) {
+		pr_err("consume from an empty ring succeeded\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < sz; i++) {
+		if (mpmc_ring_produce(&ring, test_entry(0, i))) {
+			pr_err("produce %u of %u failed\n", i, sz);
+			err = -EINVAL;
+			goto out;
+		}
+	}
+	if (mpmc_ring_produce(&ring, test_entry(0, sz)) != -ENOSPC) {
+		pr_err("produce into a full ring succeeded\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	/* drain half, then wrap around with a partially successful bulk */
+	for (i = 0; i < sz / 2; i++) {
+		if (mpmc_ring_consume(&ring) != test_entry(0, i)) {
+			pr_err("entry %u out of order\n", i);
+			err = -EINVAL;
+			goto out;
+		}
+	}
+	for (i = 0; i < sz; i++)
+		buf[i] = test_entry(1, i);
+	n = mpmc_ring_produce_bulk(&ring, buf, sz);
+	if (n != sz / 2 || mpmc_ring_count(&ring) != sz) {
+		pr_err("bulk produce queued %u, expected %u\n", n, sz / 2);
+		err = -EINVAL;
+		goto out;
+	}
+
+	n = mpmc_ring_consume_bulk(&ring, buf, MAX_BULK);
+	for (i = 0; i < n; i++) {
+		void *expected = i < sz / 2 ? test_entry(0, sz / 2 + i) :
+					      test_entry(1, i - sz / 2);
+
+		if (buf[i] != expected)
+			break;
+	}
+	if (n != sz || i != n || !mpmc_ring_empty(&ring)) {
+		pr_err("bulk consume returned %u entries, %u in order\n", n, i);
+		err = -EINVAL;
+	}
+
+out:
+	mpmc_ring_cleanup(&ring);
+	return err;
+}
+
+static void thread_wait_start(void)
+{
+	atomic_inc(&threads_ready);
+	wait_for_completion(&startup_done);
+}
+
+static int producer(void *data)
+{
+	struct thread_data *tdata = data;
+	void *buf[MAX_BULK];
+	unsigned long i = 0;
+
+	thread_wait_start();
+
+	while (i < entries) {
+		unsigned int j, n = min_t(unsigned long, bulk, entries - i);
+
+		for (j = 0; j < n; j++) {
+			buf[j] = test_entry(tdata->id, i + j);
+			tdata->sum += (unsigned long)buf[j];
+		}
+		for (j = 0; j < n; ) {
+			j += mpmc_ring_produce_bulk(&ring, buf + j, n - j);
+			if (j < n)
+				cond_resched();
+		}
+		i += n;
+	}
+	atomic_dec(&producers_left);
+
+	return 0;
+}
+
+static int consumer(void *data)
+{
+	struct thread_data *tdata = data;
+	void *buf[MAX_BULK];
+
+	thread_wait_start();
+
+	for (;;) {
+		unsigned int j, n;
+
+		n = mpmc_ring_consume_bulk(&ring, buf, bulk);
+		if (!n) {
+			/* the last producer may finish between both checks */
+			if (atomic_read(&producers_left) <= 0 &&
+			    mpmc_ring_empty(&ring))
+				break;
+			cond_resched();
+			continue;
+		}
+
+		for (j = 0; j < n; j++) {
+			if (!buf[j]) {
+				tdata->err = -EINVAL;
+				continue;
+			}
+			tdata->sum += (unsigned long)buf[j];
+		}
+		atomic_long_add(n, &consumed);
+	}
+
+	return 0;
+}
+
+static int __init test_mpmc_threads(void)
+{
+	struct thread_data *tdata;
+	u64 psum = 0, csum = 0, start, end;
+	unsigned long total;
+	int i, err, nr = 0;
+
+	err = mpmc_ring_init(&ring, size, GFP_KERNEL);
+	if (err)
+		return err;
+
+	tdata = kcalloc(2 * tcount, sizeof(*tdata), GFP_KERNEL);
+	if (!tdata) {
+		err = -ENOMEM;
+		goto out_ring;
+	}
+
+	atomic_set(&producers_left, tcount);
+	atomic_set(&threads_ready, 0);
+	atomic_long_set(&consumed, 0);
+	reinit_completion(&startup_done);
+
+	for (i = 0; i < 2 * tcount; i++) {
+		tdata[i].id = i;
+		tdata[i].task = kthread_run(i < tcount ? producer : consumer,
+					    &tdata[i], "mpmc_ring_%s/%d",
+					    i < tcount ? "prod" : "cons", i);
+		if (IS_ERR(tdata[i].task)) {
+			err = PTR_ERR(tdata[i].task);
+			pr_err("kthread_run failed for thread %d\n", i);
+			break;
+		}
+		get_task_struct(tdata[i].task);
+		nr++;
+	}
+
+	/* if not all threads could be started, let the others just exit */
+	while (atomic_read(&threads_ready) < nr)
+		schedule_timeout_uninterruptible(1);
+	if (err) {
+		entries = 0;
+		atomic_set(&producers_left, 0);
+	}
+
+	start = ktime_get_ns();
+	complete_all(&startup_done);
+	for (i = 0; i < nr; i++)
+		kthread_stop(tdata[i].task);
+	end = ktime_get_ns();
+	if (err)
+		goto out_threads;
+
+	for (i = 0; i < nr; i++) {
+		if (i < tcount)
+			psum += tdata[i].sum;
+		else
+			csum += tdata[i].sum;
+		if (tdata[i].err)
+			err = tdata[i].err;
+	}
+
+	total = atomic_long_read(&consumed);
+	pr_info("%d producers, %d consumers, bulk %d: %lu entries in %llu ns (%llu ns per entry)\n",
+		tcount, tcount, bulk, total, end - start,
+		div64_u64(end - start, max(total, 1UL)));
+
+	if (err || total != (unsigned long)tcount * entries || psum != csum) {
+		pr_err("lost or corrupted entries: %lu of %lu consumed\n",
+		       total, (unsigned long)tcount * entries);
+		err = -EINVAL;
+	}
+
+out_threads:
+	for (i = 0; i < nr; i++)
+		put_task_struct(tdata[i].task);
+	kfree(tdata);
+out_ring:
+	mpmc_ring_cleanup(&ring);
+	return err;
+}
+
+static int __init test_mpmc_init(void)
+{
+	int err;
+
+	bulk = clamp(bulk, 1, MAX_BULK);
+	tcount = max(tcount, 1);
+
+	err = test_mpmc_single();
+	if (err) {
+		pr_warn("single threaded test failed: %d\n", err);
+		return err;
+	}
+
+	err = test_mpmc_threads();
+	if (err) {
+		pr_warn("concurrent test failed: %d\n", err);
+		return err;
+	}
+
+	pr_info("all tests passed\n");
+	return 0;
+}
+
+static void __exit test_mpmc_exit(void)
+{
+}
+
+module_init(test_mpmc_init);
+module_exit(test_mpmc_exit);
+
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,496 @@
+/*
+ * Latency and throughput benchmark of the Rockchip platform hot paths:
+ * IOMMU map/unmap, I2C and SPI transactions and CPU clock transitions.
+ *
+ * Everything runs once at load time. Each benchmark prints one line in a
+ * fixed format, which tools/testing/selftests/rockchip parses:
+ *
+ *   result <name> samples=<n> min=<ns> avg=<ns> max=<ns> [bytes/s=<rate>]
+ *
+ * and every single sample is also sent to the test_rockchip_sample
+ * tracepoint, for those who want the whole distribution. Benchmarks that
+ * need hardware the module was not pointed at are reported as skipped.
+ *
+ * The IOMMU benchmark attaches its own domain to the master it is given,
+ * so that the IOTLB zap and flush of every map and unmap are timed too;
+ * while it runs that master's DMA is not translated by its own domain, so
+ * only pick one that is idle, e.g. a VOP with its display off.
+ * The I2C and SPI benchmarks talk to real devices: only point them at a
+ * chip that tolerates reads from register 0, or at an unused chip select.
+ * The DVFS benchmark only ever lowers the CPU clock from where it is, so
+ * it never runs above what the current voltage allows; use the userspace
+ * cpufreq governor so that nothing else changes the rate meanwhile.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/clk.h>
+#include <linux/cpu.h>
+#include <linux/err.h>
+#include <linux/i2c.h>
+#include <linux/iommu.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/scatterlist.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/spi/spi.h>
+
+#define CREATE_TRACE_POINTS
+#include "test_rockchip_trace.h"
+
+#define IOMMU_TEST_IOVA		0x10000000UL
+#define IOMMU_TEST_PAGES	256
+
+static int iterations = 1000;
+module_param(iterations, int, 0);
+MODULE_PARM_DESC(iterations, "Samples per benchmark (default: 1000)");
+
+static char *iommu_master;
+module_param(iommu_master, charp, 0);
+MODULE_PARM_DESC(iommu_master, "Platform device behind the IOMMU to benchmark (default: none)");
+
+static int i2c_bus = -1;
+module_param(i2c_bus, int, 0);
+MODULE_PARM_DESC(i2c_bus, "I2C adapter to benchmark (default: none)");
+
+static unsigned short i2c_addr;
+module_param(i2c_addr, ushort, 0);
+MODULE_PARM_DESC(i2c_addr, "Address of the I2C device to read from");
+
+static int i2c_len = 8;
+module_param(i2c_len, int, 0);
+MODULE_PARM_DESC(i2c_len, "Bytes read per I2C transaction (default: 8)");
+
+static int spi_bus = -1;
+module_param(spi_bus, int, 0);
+MODULE_PARM_DESC(spi_bus, "SPI bus to benchmark (default: none)");
+
+static int spi_cs;
+module_param(spi_cs, int, 0);
+MODULE_PARM_DESC(spi_cs, "SPI chip select to use (default: 0)");
+
+static int spi_len = 4096;
+module_param(spi_len, int, 0);
+MODULE_PARM_DESC(spi_len, "Bytes per large SPI transfer (default: 4096)");
+
+static unsigned int spi_hz = 10000000;
+module_param(spi_hz, uint, 0);
+MODULE_PARM_DESC(spi_hz, "SPI clock rate (default: 10000000)");
+
+static bool dvfs;
+module_param(dvfs, bool, 0);
+MODULE_PARM_DESC(dvfs, "Benchmark CPU clock transitions (default: N)");
+
+static unsigned long dvfs_rate;
+module_param(dvfs_rate, ulong, 0);
+MODULE_PARM_DESC(dvfs_rate, "Lower CPU clock rate in Hz (default: half the current rate)");
+
+struct bench_stat {
+	const char	*name;
+	unsigned int	samples;
+	u64		min;
+	u64		max;
+	u64		total;
+	size_t		bytes;		/* per sample, 0 if not a transfer */
+};
+
+#define BENCH_STAT(_name, _bytes) \
+	{ .name = _name, .min = U64_MAX, .bytes = _bytes }
+
+static void bench_add(struct bench_stat *st, u64 start)
+{
+	u64 ns = ktime_get_ns() - start;
+
+	trace_test_rockchip_sample(st->name, ns);
+
+	st->samples++;
+	st->total += ns;
+	st->min = min(st->min, ns);
+	st->max = max(st->max, ns);
+}
+
+static void bench_report(struct bench_stat *st)
+{
+	u64 avg;
+
+	if (!st->samples) {
+		pr_info("result %s samples=0\n", st->name);
+		return;
+	}
+
+	avg = div_u64(st->total, st->samples);
+	if (!st->bytes) {
+		pr_info("result %s samples=%u min=%llu avg=%llu max=%llu\n",
+			st->name, st->samples, st->min, avg, st->max);
+		return;
+	}
+
+	pr_info("result %s samples=%u min=%llu avg=%llu max=%llu bytes/s=%llu\n",
+		st->name, st->samples, st->min, avg, st->max,
+		div64_u64((u64)st->bytes * st->samples * NSEC_PER_SEC,
+			  max_t(u64, st->total, 1)));
+}
+
+static int __init test_rockchip_iommu(void)
+{
+	struct bench_stat map = BENCH_STAT("iommu_map_4k", 0);
+	struct bench_stat unmap = BENCH_STAT("iommu_unmap_4k", 0);
+	struct bench_stat map_sg = BENCH_STAT("iommu_map_sg_1m", 0);
+	struct bench_stat unmap_sg = BENCH_STAT("iommu_unmap_1m", 0);
+	size_t size = IOMMU_TEST_PAGES * PAGE_SIZE;
+	int prot = IOMMU_READ | IOMMU_WRITE;
+	struct iommu_domain *domain;
+	struct scatterlist *sg;
+	struct sg_table sgt;
+	struct page **pages;
+	struct device *dev;
+	u64 start;
+	int i, ret;
+
+	if (!iommu_master) {
+		pr_info("iommu: skipped, no iommu_master given\n");
+		return 0;
+	}
+
+	dev = bus_find_device_by_name(&platform_bus_type, NULL, iommu_master);
+	if (!dev) {
+		pr_warn("iommu: no platform device %s\n", iommu_master);
+		return -ENODEV;
+	}
+
+	ret = -ENOMEM;
+	domain = iommu_domain_alloc(&platform_bus_type);
+	if (!domain)
+		goto out_dev;
+
+	ret = iommu_attach_device(domain, dev);
+	if (ret) {
+		pr_warn("iommu: cannot attach to %s: %d\n", iommu_master, ret);
+		goto out_domain;
+	}
+
+	/* distinct pages, so that every entry has its own cache footprint */
+	ret = -ENOMEM;
+	pages = kcalloc(IOMMU_TEST_PAGES, sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		goto out_detach;
+	for (i = 0; i < IOMMU_TEST_PAGES; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i])
+			goto out_pages;
+	}
+	if (sg_alloc_table(&sgt, IOMMU_TEST_PAGES, GFP_KERNEL))
+		goto out_pages;
+	for_each_sg(sgt.sgl, sg, sgt.nents, i)
+		sg_set_page(sg, pages[i], PAGE_SIZE, 0);
+
+	for (i = 0; i < iterations; i++) {
+		start = ktime_get_ns();
+		ret = iommu_map(domain, IOMMU_TEST_IOVA,
+				page_to_phys(pages[i % IOMMU_TEST_PAGES]),
+				PAGE_SIZE, prot);
+		if (ret)
+			goto out_table;
+		bench_add(&map, start);
+
+		start = ktime_get_ns();
+		if (iommu_unmap(domain, IOMMU_TEST_IOVA,
+				PAGE_SIZE) != PAGE_SIZE)
+			goto out_einval;
+		bench_add(&unmap, start);
+
+		start = ktime_get_ns();
+		if (iommu_map_sg(domain, IOMMU_TEST_IOVA, sgt.sgl, sgt.nents,
+				 prot) != size)
+			goto out_einval;
+		bench_add(&map_sg, start);
+
+		start = ktime_get_ns();
+		if (iommu_unmap(domain, IOMMU_TEST_IOVA, size) != size)
+			goto out_einval;
+		bench_add(&unmap_sg, start);
+	}
+
+	bench_report(&map);
+	bench_report(&unmap);
+	bench_report(&map_sg);
+	bench_report(&unmap_sg);
+	ret = 0;
+	goto out_table;
+
+out_einval:
+	ret = -EINVAL;
+out_table:
+	sg_free_table(&sgt);
+out_pages:
+	for (i = 0; i < IOMMU_TEST_PAGES && pages[i]; i++)
+		__free_page(pages[i]);
+	kfree(pages);
+out_detach:
+	iommu_detach_device(domain, dev);
+out_domain:
+	iommu_domain_free(domain);
+out_dev:
+	put_device(dev);
+	return ret;
+}
+
+static int __init test_rockchip_i2c(void)
+{
+	struct bench_stat xfer = BENCH_STAT("i2c_read", i2c_len);
+	struct i2c_adapter *adap;
+	struct i2c_msg msgs[2];
+	u8 reg = 0, *buf;
+	u64 start;
+	int i, ret = 0;
+
+	if (i2c_bus < 0) {
+		pr_info("i2c: skipped, no i2c_bus given\n");
+		return 0;
+	}
+
+	adap = i2c_get_adapter(i2c_bus);
+	if (!adap) {
+		pr_warn("i2c: no adapter %d\n", i2c_bus);
+		return -ENODEV;
+	}
+
+	buf = kmalloc(i2c_len, GFP_KERNEL);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto out_adap;
+	}
+
+	/* the usual register read: write the offset, then read back */
+	msgs[0].addr = i2c_addr;
+	msgs[0].flags = 0;
+	msgs[0].len = 1;
+	msgs[0].buf = &reg;
+	msgs[1].addr = i2c_addr;
+	msgs[1].flags = I2C_M_RD;
+	msgs[1].len = i2c_len;
+	msgs[1].buf = buf;
+
+	for (i = 0; i < iterations; i++) {
+		start = ktime_get_ns();
+		ret = i2c_transfer(adap, msgs, ARRAY_SIZE(msgs));
+		if (ret != ARRAY_SIZE(msgs)) {
+			pr_warn("i2c: transfer to 0x%02x failed: %d\n",
+				i2c_addr, ret);
+			ret = ret < 0 ? ret : -EIO;
+			goto out_buf;
+		}
+		bench_add(&xfer, start);
+	}
+
+	bench_report(&xfer);
+	ret = 0;
+
+out_buf:
+	kfree(buf);
+out_adap:
+	i2c_put_adapter(adap);
+	return ret;
+}
+
+static int __init test_rockchip_spi_run(struct spi_device *spi,
+					struct bench_stat *st, void *tx,
+					void *rx, size_t len)
+{
+	struct spi_transfer t = {
+		.tx_buf = tx,
+		.rx_buf = rx,
+		.len = len,
+	};
+	struct spi_message m;
+	u64 start;
+	int i, ret;
+
+	for (i = 0; i < iterations; i++) {
+		spi_message_init_with_transfers(&m, &t, 1);
+
+		start = ktime_get_ns();
+		ret = spi_sync(spi, &m);
+		if (ret) {
+			pr_warn("spi: %zu byte transfer failed: %d\n",
+				len, ret);
+			return ret;
+		}
+		bench_add(st, start);
+	}
+
+	bench_report(st);
+	return 0;
+}
+
+static int __init test_rockchip_spi(void)
+{
+	struct bench_stat small = BENCH_STAT("spi_xfer_4", 4);
+	struct bench_stat large = BENCH_STAT("spi_xfer_large", spi_len);
+	struct spi_master *master;
+	struct spi_device *spi;
+	void *tx, *rx;
+	int ret;
+
+	if (spi_bus < 0) {
+		pr_info("spi: skipped, no spi_bus given\n");
+		return 0;
+	}
+
+	master = spi_busnum_to_master(spi_bus);
+	if (!master) {
+		pr_warn("spi: no bus %d\n", spi_bus);
+		return -ENODEV;
+	}
+
+	/*
+	 * Not registered, so that no driver binds to it and it does not
+	 * clash with a device already declared on that chip select.
+	 */
+	spi = spi_alloc_device(master);
+	put_device(&master->dev);
+	if (!spi)
+		return -ENOMEM;
+
+	spi->chip_select = spi_cs;
+	spi->max_speed_hz = spi_hz;
+	spi->mode = SPI_MODE_0;
+	spi->bits_per_word = 8;
+
+	tx = kzalloc(spi_len, GFP_KERNEL | GFP_DMA);
+	rx = kzalloc(spi_len, GFP_KERNEL | GFP_DMA);
+	if (!tx || !rx) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = spi_setup(spi);
+	if (ret) {
+		pr_warn("spi: setup of chip select %d failed: %d\n",
+			spi_cs, ret);
+		goto out;
+	}
+
+	/* a short register access shows the per-message overhead */
+	ret = test_rockchip_spi_run(spi, &small, tx, rx, 4);
+	if (!ret)
+		ret = test_rockchip_spi_run(spi, &large, tx, rx, spi_len);
+
+out:
+	kfree(rx);
+	kfree(tx);
+	spi_dev_put(spi);
+	return ret;
+}
+
+static int __init test_rockchip_dvfs(void)
+{
+	struct bench_stat down = BENCH_STAT("dvfs_down", 0);
+	struct bench_stat up = BENCH_STAT("dvfs_up", 0);
+	struct device *cpu_dev;
+	unsigned long rate;
+	struct clk *clk;
+	long low;
+	u64 start;
+	int i, ret = 0;
+
+	if (!dvfs) {
+		pr_info("dvfs: skipped, not enabled\n");
+		return 0;
+	}
+
+	cpu_dev = get_cpu_device(0);
+	if (!cpu_dev)
+		return -ENODEV;
+
+	clk = clk_get(cpu_dev, NULL);
+	if (IS_ERR(clk)) {
+		pr_warn("dvfs: no clock for cpu0\n");
+		return PTR_ERR(clk);
+	}
+
+	rate = clk_get_rate(clk);
+	low = clk_round_rate(clk, dvfs_rate ? dvfs_rate : rate / 2);
+	if (low <= 0 || low >= rate) {
+		pr_warn("dvfs: no rate below %lu Hz to switch to\n", rate);
+		ret = -EINVAL;
+		goto out;
+	}
+	pr_info("dvfs: switching cpu0 between %lu and %ld Hz\n", rate, low);
+
+	for (i = 0; i < iterations; i++) {
+		start = ktime_get_ns();
+		ret = clk_set_rate(clk, low);
+		if (ret)
+			goto out_restore;
+		bench_add(&down, start);
+
+		start = ktime_get_ns();
+		ret = clk_set_rate(clk, rate);
+		if (ret)
+			goto out_restore;
+		bench_add(&up, start);
+	}
+
+	bench_report(&down);
+	bench_report(&up);
+	goto out;
+
+out_restore:
+	pr_warn("dvfs: clk_set_rate failed: %d\n", ret);
+	clk_set_rate(clk, rate);
+out:
+	clk_put(clk);
+	return ret;
+}
+
+static int __init test_rockchip_init(void)
+{
+	int ret = 0, err;
+
+	iterations = max(iterations, 1);
+	i2c_len = clamp(i2c_len, 1, 256);
+	spi_len = clamp_t(int, spi_len, 4, SZ_1M);
+
+	err = test_rockchip_iommu();
+	if (err) {
+		pr_warn("iommu: failed: %d\n", err);
+		ret = err;
+	}
+
+	err = test_rockchip_i2c();
+	if (err)
+		ret = err;
+
+	err = test_rockchip_spi();
+	if (err)
+		ret = err;
+
+	err = test_rockchip_dvfs();
+	if (err)
+		ret = err;
+
+	if (!ret)
+		pr_info("tests passed.\n");
+
+	return ret;
+}
+
+module_init(test_rockchip_init);
+
+static void __exit test_rockchip_exit(void)
+{
+}
+
+module_exit(test_rockchip_exit);
+
+MODULE_DESCRIPTION("Rockchip platform latency benchmarks");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,33 @@
+#if !defined(_TEST_ROCKCHIP_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _TEST_ROCKCHIP_TRACE_H_
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM test_rockchip
+#define TRACE_INCLUDE_FILE test_rockchip_trace
+
+TRACE_EVENT(test_rockchip_sample,
+	    TP_PROTO(const char *name, u64 ns),
+	    TP_ARGS(name, ns),
+
+	    TP_STRUCT__entry(
+			     __string(name, name)
+			     __field(u64, ns)
+			     ),
+
+	    TP_fast_assign(
+			   __assign_str(name, name);
+			   __entry->ns = ns;
+			   ),
+
+	    TP_printk("%s ns=%llu", __get_str(name), __entry->ns)
+);
+
+#endif /* _TEST_ROCKCHIP_TRACE_H_ */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#include <trace/define_trace.h>
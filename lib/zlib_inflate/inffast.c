@@ -4,6 +4,7 @@
  */
 
 #include <linux/zutil.h>
+#include <asm/unaligned.h>
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
@@ -59,7 +60,7 @@ get_unaligned16(const unsigned short *p)
    Entry assumptions:
 
         state->mode == LEN
-        strm->avail_in >= 6
+        strm->avail_in >= INFLATE_FAST_MIN_IN
         strm->avail_out >= 258
         start >= strm->avail_out
         state->bits < 8
@@ -78,6 +79,13 @@ get_unaligned16(const unsigned short *p)
       Therefore if strm->avail_in >= 6, then there is enough input to avoid
       checking for available input while decoding.
 
+    - With INFLATE_WIDE_REFILL, the bit buffer is topped up to at least 56
+      bits by a single eight byte load at the start of each code, which
+      covers everything the code may need so that the byte at a time
+      refills below never trigger.  The load may take in bits of bytes it
+      does not consume yet; they are or-ed in again, unchanged, by the
+      next load and masked off on return.  It needs eight bytes of input.
+
     - The maximum bytes that a single length/distance pair can output is 258
       bytes, which is the maximum length that can be coded.  inflate_fast()
       requires strm->avail_out >= 258 for each loop to avoid checking for
@@ -116,7 +124,7 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* copy state to local variables */
     state = (struct inflate_state *)strm->state;
     in = strm->next_in - OFF;
-    last = in + (strm->avail_in - 5);
+    last = in + (strm->avail_in - (INFLATE_FAST_MIN_IN - 1));
     out = strm->next_out - OFF;
     beg = out - (start - strm->avail_out);
     end = out + (strm->avail_out - 257);
@@ -137,12 +145,18 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
+#ifdef INFLATE_WIDE_REFILL
+        hold |= get_unaligned_le64(in + OFF) << bits;
+        in += (63 - bits) >> 3;
+        bits |= 56;
+#else
         if (bits < 15) {
             hold += (unsigned long)(PUP(in)) << bits;
             bits += 8;
             hold += (unsigned long)(PUP(in)) << bits;
             bits += 8;
         }
+#endif
         this = lcode[hold & lmask];
       dolen:
         op = (unsigned)(this.bits);
@@ -262,6 +276,21 @@ void inflate_fast(z_streamp strm, unsigned start)
 		    unsigned long loops;
 
                     from = out - dist;          /* copy direct from output */
+#ifdef INFLATE_WIDE_REFILL
+		    if (dist >= 8) {
+			/* chunks that far back never overlap what they write */
+			while (len >= 8) {
+			    put_unaligned(get_unaligned((u64 *)(from + OFF)),
+					  (u64 *)(out + OFF));
+			    from += 8;
+			    out += 8;
+			    len -= 8;
+			}
+			while (len--)
+			    PUP(out) = PUP(from);
+			continue;
+		    }
+#endif
 		    /* minimum length is three */
 		    /* Align out addr */
 		    if (!((long)(out - 1 + OFF) & 1)) {
@@ -338,7 +367,9 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* update state and return */
     strm->next_in = in + OFF;
     strm->next_out = out + OFF;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
+    strm->avail_in = (unsigned)(in < last ?
+                                (INFLATE_FAST_MIN_IN - 1) + (last - in) :
+                                (INFLATE_FAST_MIN_IN - 1) - (in - last));
     strm->avail_out = (unsigned)(out < end ?
                                  257 + (end - out) : 257 - (out - end));
     state->hold = hold;
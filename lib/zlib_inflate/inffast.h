@@ -8,4 +8,19 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/*
+ * On 64-bit little-endian machines that handle unaligned loads well,
+ * inflate_fast() refills its bit buffer eight bytes at a time and copies
+ * matches in eight byte chunks; the refill needs that much input.
+ */
+#if defined(CONFIG_64BIT) && defined(__LITTLE_ENDIAN) && \
+    defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)
+#  define INFLATE_WIDE_REFILL
+#  define INFLATE_FAST_MIN_IN 8
+#else
+#  define INFLATE_FAST_MIN_IN 6
+#endif
+
+#define INFLATE_FAST_MIN_OUT 258
+
 void inflate_fast (z_streamp strm, unsigned start);
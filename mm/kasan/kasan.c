@@ -23,6 +23,7 @@
 #include <linux/memory.h>
 #include <linux/mm.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
 #include <linux/printk.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
@@ -35,6 +36,38 @@
 #include "kasan.h"
 #include "../slab.h"
 
+/*
+ * With kasan_sample=N only every Nth slab allocation on a CPU gets its
+ * redzone poisoned, and only every Nth free poisons the object. The others
+ * are left with clean shadow, so accesses to them leave
+ * check_memory_region() right after the first shadow load and bugs on them
+ * go unnoticed. Spread over enough machines, this still catches
+ * out-of-bounds and use-after-free on slab objects, at a fraction of the
+ * cost of the slab hooks.
+ */
+static unsigned int kasan_sample_rate __read_mostly = 1;
+/* separate counters, so that alloc and free sampling don't interleave */
+static DEFINE_PER_CPU(unsigned int, kasan_alloc_count);
+static DEFINE_PER_CPU(unsigned int, kasan_free_count);
+
+static int __init kasan_set_sample_rate(char *str)
+{
+	if (kstrtouint(str, 0, &kasan_sample_rate) || !kasan_sample_rate)
+		kasan_sample_rate = 1;
+	if (kasan_sample_rate > 1)
+		pr_info("sampling 1 in %u slab objects\n", kasan_sample_rate);
+	return 0;
+}
+early_param("kasan_sample", kasan_set_sample_rate);
+
+static inline bool kasan_sample(unsigned int __percpu *count)
+{
+	if (likely(kasan_sample_rate == 1))
+		return true;
+
+	return !(this_cpu_inc_return(*count) % kasan_sample_rate);
+}
+
 /*
  * Poisons the shadow memory for 'size' bytes starting from 'addr'.
  * Memory addresses should be aligned to KASAN_SHADOW_SCALE_SIZE.
@@ -332,6 +365,9 @@ void kasan_slab_free(struct kmem_cache *cache, void *object)
 	if (unlikely(cache->flags & SLAB_DESTROY_BY_RCU))
 		return;
 
+	if (!kasan_sample(&kasan_free_count))
+		return;
+
 	kasan_poison_shadow(object, rounded_up_size, KASAN_KMALLOC_FREE);
 }
 
@@ -343,6 +379,11 @@ void kasan_kmalloc(struct kmem_cache *cache, const void *object, size_t size)
 	if (unlikely(object == NULL))
 		return;
 
+	if (!kasan_sample(&kasan_alloc_count)) {
+		kasan_unpoison_shadow(object, cache->object_size);
+		return;
+	}
+
 	redzone_start = round_up((unsigned long)(object + size),
 				KASAN_SHADOW_SCALE_SIZE);
 	redzone_end = round_up((unsigned long)object + cache->object_size,
@@ -119,6 +119,7 @@
 #include <linux/ip.h>
 #include <net/ip.h>
 #include <net/mpls.h>
+#include <net/busy_poll.h>
 #include <linux/ipv6.h>
 #include <linux/in.h>
 #include <linux/jhash.h>
@@ -136,6 +137,7 @@
 #include <linux/errqueue.h>
 #include <linux/hrtimer.h>
 #include <linux/netfilter_ingress.h>
+#include <linux/bpf.h>
 
 #include "net-sysfs.h"
 
@@ -3756,16 +3758,20 @@ static inline int nf_ingress(struct sk_buff *skb, struct packet_type **pt_prev,
 			*pt_prev = NULL;
 		}
 
-		return nf_hook_ingress(skb);
+		/* anything but NF_ACCEPT consumed the packet */
+		if (nf_hook_ingress(skb) != 1)
+			return -1;
 	}
 #endif /* CONFIG_NETFILTER_INGRESS */
 	return 0;
 }
 
-static int __netif_receive_skb_core(struct sk_buff *skb, bool pfmemalloc)
+static int __netif_receive_skb_core(struct sk_buff **pskb, bool pfmemalloc,
+				    struct packet_type **ppt_prev)
 {
 	struct packet_type *ptype, *pt_prev;
 	rx_handler_func_t *rx_handler;
+	struct sk_buff *skb = *pskb;
 	struct net_device *orig_dev;
 	bool deliver_exact = false;
 	int ret = NET_RX_DROP;
@@ -3898,8 +3904,8 @@ ncls:
 	if (pt_prev) {
 		if (unlikely(skb_orphan_frags(skb, GFP_ATOMIC)))
 			goto drop;
-		else
-			ret = pt_prev->func(skb, skb->dev, pt_prev, orig_dev);
+		/* the caller delivers to the last handler, possibly batched */
+		*ppt_prev = pt_prev;
 	} else {
 drop:
 		atomic_long_inc(&skb->dev->rx_dropped);
@@ -3911,6 +3917,20 @@ drop:
 	}
 
 out:
+	/* the skb may have been replaced by VLAN untagging or an rx_handler */
+	*pskb = skb;
+	return ret;
+}
+
+static int __netif_receive_skb_one_core(struct sk_buff *skb, bool pfmemalloc)
+{
+	struct net_device *orig_dev = skb->dev;
+	struct packet_type *pt_prev = NULL;
+	int ret;
+
+	ret = __netif_receive_skb_core(&skb, pfmemalloc, &pt_prev);
+	if (pt_prev)
+		ret = pt_prev->func(skb, skb->dev, pt_prev, orig_dev);
 	return ret;
 }
 
@@ -3931,14 +3951,98 @@ static int __netif_receive_skb(struct sk_buff *skb)
 		 * context down to all allocation sites.
 		 */
 		current->flags |= PF_MEMALLOC;
-		ret = __netif_receive_skb_core(skb, true);
+		ret = __netif_receive_skb_one_core(skb, true);
 		tsk_restore_flags(current, pflags, PF_MEMALLOC);
 	} else
-		ret = __netif_receive_skb_core(skb, false);
+		ret = __netif_receive_skb_one_core(skb, false);
 
 	return ret;
 }
 
+static void __netif_receive_skb_list_ptype(struct sk_buff_head *list,
+					   struct packet_type *pt_prev,
+					   struct net_device *orig_dev)
+{
+	struct sk_buff *skb;
+
+	if (!pt_prev || skb_queue_empty(list))
+		return;
+	if (pt_prev->list_func) {
+		pt_prev->list_func(list, pt_prev, orig_dev);
+		return;
+	}
+	while ((skb = __skb_dequeue(list)) != NULL)
+		pt_prev->func(skb, skb->dev, pt_prev, orig_dev);
+}
+
+static void __netif_receive_skb_list_core(struct sk_buff_head *list,
+					  bool pfmemalloc)
+{
+	/* Consecutive packets of a batch usually come from the same device
+	 * and go to the same protocol handler, so gather runs of them and
+	 * hand each run over in one go.
+	 */
+	struct packet_type *pt_curr = NULL;
+	struct net_device *od_curr = NULL;
+	struct sk_buff_head sublist;
+	struct sk_buff *skb;
+
+	__skb_queue_head_init(&sublist);
+	while ((skb = __skb_dequeue(list)) != NULL) {
+		struct net_device *orig_dev = skb->dev;
+		struct packet_type *pt_prev = NULL;
+
+		__netif_receive_skb_core(&skb, pfmemalloc, &pt_prev);
+		if (!pt_prev)
+			continue;
+		if (pt_curr != pt_prev || od_curr != orig_dev) {
+			__netif_receive_skb_list_ptype(&sublist, pt_curr,
+						       od_curr);
+			pt_curr = pt_prev;
+			od_curr = orig_dev;
+		}
+		__skb_queue_tail(&sublist, skb);
+	}
+	__netif_receive_skb_list_ptype(&sublist, pt_curr, od_curr);
+}
+
+static void __netif_receive_skb_list_run(struct sk_buff_head *list,
+					 bool pfmemalloc)
+{
+	unsigned long pflags;
+
+	if (skb_queue_empty(list))
+		return;
+
+	if (pfmemalloc) {
+		/* see __netif_receive_skb() */
+		pflags = current->flags;
+		current->flags |= PF_MEMALLOC;
+		__netif_receive_skb_list_core(list, true);
+		tsk_restore_flags(current, pflags, PF_MEMALLOC);
+	} else {
+		__netif_receive_skb_list_core(list, false);
+	}
+}
+
+static void __netif_receive_skb_list(struct sk_buff_head *list)
+{
+	struct sk_buff_head sublist;
+	bool pfmemalloc = false;
+	struct sk_buff *skb;
+
+	__skb_queue_head_init(&sublist);
+	while ((skb = __skb_dequeue(list)) != NULL) {
+		if ((sk_memalloc_socks() && skb_pfmemalloc(skb)) != pfmemalloc) {
+			/* handle what was queued so far in the old context */
+			__netif_receive_skb_list_run(&sublist, pfmemalloc);
+			pfmemalloc = !pfmemalloc;
+		}
+		__skb_queue_tail(&sublist, skb);
+	}
+	__netif_receive_skb_list_run(&sublist, pfmemalloc);
+}
+
 static int netif_receive_skb_internal(struct sk_buff *skb)
 {
 	int ret;
@@ -3967,6 +4071,39 @@ static int netif_receive_skb_internal(struct sk_buff *skb)
 	return ret;
 }
 
+static void netif_receive_skb_list_internal(struct sk_buff_head *list)
+{
+	struct sk_buff_head sublist;
+	struct sk_buff *skb;
+
+	__skb_queue_head_init(&sublist);
+	while ((skb = __skb_dequeue(list)) != NULL) {
+		net_timestamp_check(netdev_tstamp_prequeue, skb);
+		if (skb_defer_rx_timestamp(skb))
+			continue;
+		__skb_queue_tail(&sublist, skb);
+	}
+
+	rcu_read_lock();
+#ifdef CONFIG_RPS
+	if (static_key_false(&rps_needed)) {
+		while ((skb = __skb_dequeue(&sublist)) != NULL) {
+			struct rps_dev_flow voidflow, *rflow = &voidflow;
+			int cpu = get_rps_cpu(skb->dev, skb, &rflow);
+
+			if (cpu >= 0)
+				enqueue_to_backlog(skb, cpu,
+						   &rflow->last_qtail);
+			else
+				__skb_queue_tail(list, skb);
+		}
+		skb_queue_splice_init(list, &sublist);
+	}
+#endif
+	__netif_receive_skb_list(&sublist);
+	rcu_read_unlock();
+}
+
 /**
  *	netif_receive_skb - process receive buffer from network
  *	@skb: buffer to process
@@ -3990,6 +4127,59 @@ int netif_receive_skb_sk(struct sock *sk, struct sk_buff *skb)
 }
 EXPORT_SYMBOL(netif_receive_skb_sk);
 
+/**
+ *	netif_receive_skb_list - process many receive buffers from network
+ *	@list: list of skbs to process
+ *
+ *	Like netif_receive_skb(), but hands a whole batch to the stack so
+ *	that consecutive packets for the same protocol handler are passed
+ *	on together.  The list is empty on return.  The return value of
+ *	netif_receive_skb() is usually ignored and wouldn't mean much for
+ *	a list, so there is none.
+ *
+ *	This function may only be called from softirq context and interrupts
+ *	should be enabled.
+ */
+void netif_receive_skb_list(struct sk_buff_head *list)
+{
+	struct sk_buff *skb;
+
+	if (skb_queue_empty(list))
+		return;
+
+	skb_queue_walk(list, skb)
+		trace_netif_receive_skb_entry(skb);
+	netif_receive_skb_list_internal(list);
+}
+EXPORT_SYMBOL(netif_receive_skb_list);
+
+/* Number of GRO_NORMAL packets a NAPI instance queues before passing
+ * them up with netif_receive_skb_list().
+ */
+int gro_normal_batch __read_mostly = 8;
+
+/**
+ *	gro_normal_list - pass the packets batched by GRO up the stack
+ *	@napi: NAPI context
+ *
+ *	Called when a poll round ends.  Drivers only need it when they
+ *	complete NAPI by hand instead of through napi_complete_done().
+ */
+void gro_normal_list(struct napi_struct *napi)
+{
+	if (skb_queue_empty(&napi->rx_list))
+		return;
+	netif_receive_skb_list_internal(&napi->rx_list);
+}
+EXPORT_SYMBOL(gro_normal_list);
+
+static void gro_normal_one(struct napi_struct *napi, struct sk_buff *skb)
+{
+	__skb_queue_tail(&napi->rx_list, skb);
+	if (skb_queue_len(&napi->rx_list) >= gro_normal_batch)
+		gro_normal_list(napi);
+}
+
 /* Network device is going away, flush any packets still pending
  * Called with irqs disabled.
  */
@@ -4018,7 +4208,7 @@ static void flush_backlog(void *arg)
 	}
 }
 
-static int napi_gro_complete(struct sk_buff *skb)
+static int napi_gro_complete(struct napi_struct *napi, struct sk_buff *skb)
 {
 	struct packet_offload *ptype;
 	__be16 type = skb->protocol;
@@ -4049,7 +4239,8 @@ static int napi_gro_complete(struct sk_buff *skb)
 	}
 
 out:
-	return netif_receive_skb_internal(skb);
+	gro_normal_one(napi, skb);
+	return NET_RX_SUCCESS;
 }
 
 /* napi->gro_list contains packets ordered by age.
@@ -4073,7 +4264,7 @@ void napi_gro_flush(struct napi_struct *napi, bool flush_old)
 			return;
 
 		prev = skb->prev;
-		napi_gro_complete(skb);
+		napi_gro_complete(napi, skb);
 		napi->gro_count--;
 	}
 
@@ -4211,7 +4402,7 @@ static enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff
 
 		*pp = nskb->next;
 		nskb->next = NULL;
-		napi_gro_complete(nskb);
+		napi_gro_complete(napi, nskb);
 		napi->gro_count--;
 	}
 
@@ -4231,7 +4422,7 @@ static enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff
 		}
 		*pp = NULL;
 		nskb->next = NULL;
-		napi_gro_complete(nskb);
+		napi_gro_complete(napi, nskb);
 	} else {
 		napi->gro_count++;
 	}
@@ -4283,12 +4474,13 @@ struct packet_offload *gro_find_complete_by_type(__be16 type)
 }
 EXPORT_SYMBOL(gro_find_complete_by_type);
 
-static gro_result_t napi_skb_finish(gro_result_t ret, struct sk_buff *skb)
+static gro_result_t napi_skb_finish(struct napi_struct *napi,
+				    struct sk_buff *skb,
+				    gro_result_t ret)
 {
 	switch (ret) {
 	case GRO_NORMAL:
-		if (netif_receive_skb_internal(skb))
-			ret = GRO_DROP;
+		gro_normal_one(napi, skb);
 		break;
 
 	case GRO_DROP:
@@ -4297,9 +4489,9 @@ static gro_result_t napi_skb_finish(gro_result_t ret, struct sk_buff *skb)
 
 	case GRO_MERGED_FREE:
 		if (NAPI_GRO_CB(skb)->free == NAPI_GRO_FREE_STOLEN_HEAD)
-			kmem_cache_free(skbuff_head_cache, skb);
+			napi_skb_free_stolen_head(skb);
 		else
-			__kfree_skb(skb);
+			__kfree_skb_defer(skb);
 		break;
 
 	case GRO_HELD:
@@ -4316,7 +4508,7 @@ gro_result_t napi_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 
 	skb_gro_reset_offset(skb);
 
-	return napi_skb_finish(dev_gro_receive(napi, skb), skb);
+	return napi_skb_finish(napi, skb, dev_gro_receive(napi, skb));
 }
 EXPORT_SYMBOL(napi_gro_receive);
 
@@ -4360,8 +4552,8 @@ static gro_result_t napi_frags_finish(struct napi_struct *napi,
 	case GRO_HELD:
 		__skb_push(skb, ETH_HLEN);
 		skb->protocol = eth_type_trans(skb, skb->dev);
-		if (ret == GRO_NORMAL && netif_receive_skb_internal(skb))
-			ret = GRO_DROP;
+		if (ret == GRO_NORMAL)
+			gro_normal_one(napi, skb);
 		break;
 
 	case GRO_DROP:
@@ -4575,10 +4767,25 @@ void __napi_schedule_irqoff(struct napi_struct *n)
 }
 EXPORT_SYMBOL(__napi_schedule_irqoff);
 
+/* The stack can't be entered with irqs masked, queue the packets GRO
+ * batched up to the backlog of this CPU instead.
+ */
+static void gro_normal_defer(struct napi_struct *n)
+{
+	struct sk_buff *skb;
+	unsigned int qtail;
+
+	while ((skb = __skb_dequeue(&n->rx_list)) != NULL)
+		enqueue_to_backlog(skb, smp_processor_id(), &qtail);
+}
+
 void __napi_complete(struct napi_struct *n)
 {
 	BUG_ON(!test_bit(NAPI_STATE_SCHED, &n->state));
 
+	if (unlikely(!skb_queue_empty(&n->rx_list)))
+		gro_normal_defer(n);
+
 	list_del_init(&n->poll_list);
 	smp_mb__before_atomic();
 	clear_bit(NAPI_STATE_SCHED, &n->state);
@@ -4608,6 +4815,8 @@ void napi_complete_done(struct napi_struct *n, int work_done)
 		else
 			napi_gro_flush(n, false);
 	}
+	gro_normal_list(n);
+
 	if (likely(list_empty(&n->poll_list))) {
 		WARN_ON_ONCE(!test_and_clear_bit(NAPI_STATE_SCHED, &n->state));
 	} else {
@@ -4633,6 +4842,55 @@ struct napi_struct *napi_by_id(unsigned int napi_id)
 }
 EXPORT_SYMBOL_GPL(napi_by_id);
 
+#if defined(CONFIG_NET_RX_BUSY_POLL)
+/**
+ *	napi_busy_loop - busy poll a NAPI context by id
+ *	@napi_id: id of the NAPI context
+ *	@loop_end: returns true once polling can stop, NULL to poll once
+ *	@loop_end_arg: first argument of @loop_end
+ *
+ *	Busy poll for sockets which aren't polled one at a time, such as the
+ *	ready sockets of an epoll set.  @loop_end is passed the end of the
+ *	sysctl_net_busy_poll budget, in busy_loop_us_clock() units.
+ */
+void napi_busy_loop(unsigned int napi_id,
+		    bool (*loop_end)(void *, unsigned long),
+		    void *loop_end_arg)
+{
+	unsigned long end_time = busy_loop_end_time();
+	const struct net_device_ops *ops;
+	struct napi_struct *napi;
+	int rc;
+
+	/* see sk_busy_loop() */
+	rcu_read_lock_bh();
+
+	napi = napi_by_id(napi_id);
+	if (!napi)
+		goto out;
+
+	ops = napi->dev->netdev_ops;
+	if (!ops->ndo_busy_poll)
+		goto out;
+
+	do {
+		rc = ops->ndo_busy_poll(napi);
+
+		if (rc == LL_FLUSH_FAILED)
+			break; /* permanent failure */
+
+		if (rc > 0)
+			NET_ADD_STATS_BH(dev_net(napi->dev),
+					 LINUX_MIB_BUSYPOLLRXPACKETS, rc);
+		cpu_relax();
+	} while (loop_end && !loop_end(loop_end_arg, end_time) &&
+		 !need_resched());
+out:
+	rcu_read_unlock_bh();
+}
+EXPORT_SYMBOL(napi_busy_loop);
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+
 void napi_hash_add(struct napi_struct *napi)
 {
 	if (!test_and_set_bit(NAPI_STATE_HASHED, &napi->state)) {
@@ -4690,6 +4948,7 @@ void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 	napi->timer.function = napi_watchdog;
 	napi->gro_count = 0;
 	napi->gro_list = NULL;
+	__skb_queue_head_init(&napi->rx_list);
 	napi->skb = NULL;
 	napi->poll = poll;
 	if (weight > NAPI_POLL_WEIGHT)
@@ -4730,6 +4989,7 @@ void netif_napi_del(struct napi_struct *napi)
 	kfree_skb_list(napi->gro_list);
 	napi->gro_list = NULL;
 	napi->gro_count = 0;
+	__skb_queue_purge(&napi->rx_list);
 }
 EXPORT_SYMBOL(netif_napi_del);
 
@@ -4777,6 +5037,7 @@ static int napi_poll(struct napi_struct *n, struct list_head *repoll)
 		 */
 		napi_gro_flush(n, HZ >= 1000);
 	}
+	gro_normal_list(n);
 
 	/* Some drivers may have called napi_schedule
 	 * prior to exhausting their budget.
@@ -6118,6 +6379,44 @@ int dev_change_proto_down(struct net_device *dev, bool proto_down)
 }
 EXPORT_SYMBOL(dev_change_proto_down);
 
+/**
+ *	dev_change_xdp_fd - set or clear a bpf program for a device rx path
+ *	@dev: device
+ *	@fd: new program fd or negative value to clear
+ *
+ *	Set or clear a bpf program for a device
+ */
+int dev_change_xdp_fd(struct net_device *dev, int fd)
+{
+	const struct net_device_ops *ops = dev->netdev_ops;
+	struct bpf_prog *prog = NULL;
+	struct netdev_xdp xdp = {};
+	int err;
+
+	ASSERT_RTNL();
+
+	if (!ops->ndo_xdp)
+		return -EOPNOTSUPP;
+	if (fd >= 0) {
+		prog = bpf_prog_get(fd);
+		if (IS_ERR(prog))
+			return PTR_ERR(prog);
+		if (prog->type != BPF_PROG_TYPE_XDP) {
+			bpf_prog_put(prog);
+			return -EINVAL;
+		}
+	}
+
+	xdp.command = XDP_SETUP_PROG;
+	xdp.prog = prog;
+	err = ops->ndo_xdp(dev, &xdp);
+	if (err < 0 && prog)
+		bpf_prog_put(prog);
+
+	return err;
+}
+EXPORT_SYMBOL(dev_change_xdp_fd);
+
 /**
  *	dev_new_index	-	allocate an ifindex
  *	@net: the applicable net namespace
@@ -7662,6 +7961,7 @@ static int __init net_dev_init(void)
 #endif
 
 		sd->backlog.poll = process_backlog;
+		__skb_queue_head_init(&sd->backlog.rx_list);
 		sd->backlog.weight = weight_p;
 	}
 
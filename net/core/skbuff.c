@@ -298,16 +298,12 @@ EXPORT_SYMBOL(__alloc_skb);
  *  before giving packet to stack.
  *  RX rings only contains data buffers, not full skbs.
  */
-struct sk_buff *__build_skb(void *data, unsigned int frag_size)
+static void __build_skb_around(struct sk_buff *skb, void *data,
+			       unsigned int frag_size)
 {
 	struct skb_shared_info *shinfo;
-	struct sk_buff *skb;
 	unsigned int size = frag_size ? : ksize(data);
 
-	skb = kmem_cache_alloc(skbuff_head_cache, GFP_ATOMIC);
-	if (!skb)
-		return NULL;
-
 	size -= SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
 
 	memset(skb, 0, offsetof(struct sk_buff, tail));
@@ -325,6 +321,17 @@ struct sk_buff *__build_skb(void *data, unsigned int frag_size)
 	memset(shinfo, 0, offsetof(struct skb_shared_info, dataref));
 	atomic_set(&shinfo->dataref, 1);
 	kmemcheck_annotate_variable(shinfo->destructor_arg);
+}
+
+struct sk_buff *__build_skb(void *data, unsigned int frag_size)
+{
+	struct sk_buff *skb;
+
+	skb = kmem_cache_alloc(skbuff_head_cache, GFP_ATOMIC);
+	if (!skb)
+		return NULL;
+
+	__build_skb_around(skb, data, frag_size);
 
 	return skb;
 }
@@ -347,8 +354,78 @@ struct sk_buff *build_skb(void *data, unsigned int frag_size)
 }
 EXPORT_SYMBOL(build_skb);
 
+#define NAPI_SKB_CACHE_SIZE	64
+#define NAPI_SKB_CACHE_BULK	16
+#define NAPI_SKB_CACHE_HALF	(NAPI_SKB_CACHE_SIZE / 2)
+
+/* Everything in here is only ever touched from NAPI (softirq) context on
+ * the local CPU, so it needs neither locking nor disabling interrupts.
+ * skb_cache holds free sk_buff heads: TX completion and GRO put them
+ * back and RX takes them out again, the slab is only hit in bulk.
+ */
+struct napi_alloc_cache {
+	struct page_frag_cache page;
+	unsigned int skb_count;
+	void *skb_cache[NAPI_SKB_CACHE_SIZE];
+};
+
 static DEFINE_PER_CPU(struct page_frag_cache, netdev_alloc_cache);
-static DEFINE_PER_CPU(struct page_frag_cache, napi_alloc_cache);
+static DEFINE_PER_CPU(struct napi_alloc_cache, napi_alloc_cache);
+
+static struct sk_buff *napi_skb_cache_get(void)
+{
+	struct napi_alloc_cache *nc = this_cpu_ptr(&napi_alloc_cache);
+
+	if (unlikely(!nc->skb_count)) {
+		if (!kmem_cache_alloc_bulk(skbuff_head_cache, GFP_ATOMIC,
+					   NAPI_SKB_CACHE_BULK,
+					   nc->skb_cache))
+			return NULL;
+		nc->skb_count = NAPI_SKB_CACHE_BULK;
+	}
+
+	return nc->skb_cache[--nc->skb_count];
+}
+
+static void napi_skb_cache_put(struct sk_buff *skb)
+{
+	struct napi_alloc_cache *nc = this_cpu_ptr(&napi_alloc_cache);
+
+	nc->skb_cache[nc->skb_count++] = skb;
+	if (unlikely(nc->skb_count == NAPI_SKB_CACHE_SIZE)) {
+		/* the most recently freed heads are the cache hot ones */
+		kmem_cache_free_bulk(skbuff_head_cache, NAPI_SKB_CACHE_HALF,
+				     nc->skb_cache);
+		memmove(nc->skb_cache, nc->skb_cache + NAPI_SKB_CACHE_HALF,
+			NAPI_SKB_CACHE_HALF * sizeof(void *));
+		nc->skb_count = NAPI_SKB_CACHE_HALF;
+	}
+}
+
+/**
+ * napi_build_skb - build a network buffer from NAPI context
+ * @data: data buffer provided by caller
+ * @frag_size: size of data, or 0 if head was kmalloced
+ *
+ * Same as build_skb(), except that the sk_buff head comes from a per-CPU
+ * cache refilled in bulk. Must only be called from NAPI poll context.
+ */
+struct sk_buff *napi_build_skb(void *data, unsigned int frag_size)
+{
+	struct sk_buff *skb = napi_skb_cache_get();
+
+	if (unlikely(!skb))
+		return NULL;
+
+	__build_skb_around(skb, data, frag_size);
+	if (frag_size) {
+		skb->head_frag = 1;
+		if (page_is_pfmemalloc(virt_to_head_page(data)))
+			skb->pfmemalloc = 1;
+	}
+	return skb;
+}
+EXPORT_SYMBOL(napi_build_skb);
 
 static void *__netdev_alloc_frag(unsigned int fragsz, gfp_t gfp_mask)
 {
@@ -378,9 +455,9 @@ EXPORT_SYMBOL(netdev_alloc_frag);
 
 static void *__napi_alloc_frag(unsigned int fragsz, gfp_t gfp_mask)
 {
-	struct page_frag_cache *nc = this_cpu_ptr(&napi_alloc_cache);
+	struct napi_alloc_cache *nc = this_cpu_ptr(&napi_alloc_cache);
 
-	return __alloc_page_frag(nc, fragsz, gfp_mask);
+	return __alloc_page_frag(&nc->page, fragsz, gfp_mask);
 }
 
 void *napi_alloc_frag(unsigned int fragsz)
@@ -474,7 +551,7 @@ EXPORT_SYMBOL(__netdev_alloc_skb);
 struct sk_buff *__napi_alloc_skb(struct napi_struct *napi, unsigned int len,
 				 gfp_t gfp_mask)
 {
-	struct page_frag_cache *nc = this_cpu_ptr(&napi_alloc_cache);
+	struct napi_alloc_cache *nc = this_cpu_ptr(&napi_alloc_cache);
 	struct sk_buff *skb;
 	void *data;
 
@@ -494,18 +571,19 @@ struct sk_buff *__napi_alloc_skb(struct napi_struct *napi, unsigned int len,
 	if (sk_memalloc_socks())
 		gfp_mask |= __GFP_MEMALLOC;
 
-	data = __alloc_page_frag(nc, len, gfp_mask);
+	data = __alloc_page_frag(&nc->page, len, gfp_mask);
 	if (unlikely(!data))
 		return NULL;
 
-	skb = __build_skb(data, len);
+	skb = napi_skb_cache_get();
 	if (unlikely(!skb)) {
 		skb_free_frag(data);
 		return NULL;
 	}
+	__build_skb_around(skb, data, len);
 
 	/* use OR instead of assignment to avoid clearing of bits in mask */
-	if (nc->pfmemalloc)
+	if (nc->page.pfmemalloc)
 		skb->pfmemalloc = 1;
 	skb->head_frag = 1;
 
@@ -747,6 +825,61 @@ void consume_skb(struct sk_buff *skb)
 }
 EXPORT_SYMBOL(consume_skb);
 
+/**
+ *	__kfree_skb_defer - free an sk_buff from NAPI context
+ *	@skb: buffer
+ *
+ *	Like __kfree_skb(), but the sk_buff head goes to the per-CPU NAPI
+ *	cache. The buffer must not be a fast clone.
+ */
+void __kfree_skb_defer(struct sk_buff *skb)
+{
+	skb_release_all(skb);
+	napi_skb_cache_put(skb);
+}
+
+/* a GRO merged skb whose head has been stolen has no state left to free */
+void napi_skb_free_stolen_head(struct sk_buff *skb)
+{
+	napi_skb_cache_put(skb);
+}
+
+/**
+ *	napi_consume_skb - consume an skbuff from NAPI context
+ *	@skb: buffer to free
+ *	@budget: NAPI budget of the caller, 0 if not called from NAPI poll
+ *
+ *	Meant for TX completion run from a NAPI poll handler: freed heads are
+ *	recycled through the per-CPU cache that napi_alloc_skb() and
+ *	napi_build_skb() allocate from, and returned to the slab in bulk.
+ */
+void napi_consume_skb(struct sk_buff *skb, int budget)
+{
+	if (unlikely(!skb))
+		return;
+
+	/* netpoll and other non NAPI callers pass a zero budget */
+	if (unlikely(!budget)) {
+		dev_consume_skb_any(skb);
+		return;
+	}
+
+	if (likely(atomic_read(&skb->users) == 1))
+		smp_rmb();
+	else if (likely(!atomic_dec_and_test(&skb->users)))
+		return;
+	trace_consume_skb(skb);
+
+	/* fast clones share their memory with another skb */
+	if (skb->fclone != SKB_FCLONE_UNAVAILABLE) {
+		__kfree_skb(skb);
+		return;
+	}
+
+	__kfree_skb_defer(skb);
+}
+EXPORT_SYMBOL(napi_consume_skb);
+
 /* Make sure a field is enclosed inside headers_start/headers_end section */
 #define CHECK_SKB_FIELD(field) \
 	BUILD_BUG_ON(offsetof(struct sk_buff, field) <		\
@@ -0,0 +1,287 @@
+/*
+ * IPv4 forwarding fast path for offloaded flows
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/netfilter.h>
+#include <linux/netdevice.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <net/ip.h>
+#include <net/neighbour.h>
+#include <net/route.h>
+#include <net/netfilter/nf_tables.h>
+#include <net/netfilter/nf_flow_table.h>
+#include <net/netfilter/nf_conntrack.h>
+
+struct flow_ports {
+	__be16 source, dest;
+};
+
+static unsigned int nf_flow_l4_hdrsize(u8 protocol)
+{
+	switch (protocol) {
+	case IPPROTO_TCP:
+		return sizeof(struct tcphdr);
+	case IPPROTO_UDP:
+		return sizeof(struct udphdr);
+	}
+	return 0;
+}
+
+static int nf_flow_tuple_ip(struct sk_buff *skb,
+			    struct flow_offload_tuple *tuple)
+{
+	struct flow_ports *ports;
+	unsigned int thoff, hdrsize;
+	struct iphdr *iph;
+
+	if (!pskb_may_pull(skb, sizeof(*iph)))
+		return -1;
+
+	/* options, fragments and expiring packets take the slow path */
+	iph = ip_hdr(skb);
+	thoff = iph->ihl * 4;
+	if (iph->version != 4 || thoff != sizeof(*iph) ||
+	    ip_is_fragment(iph) || iph->ttl <= 1)
+		return -1;
+
+	hdrsize = nf_flow_l4_hdrsize(iph->protocol);
+	if (!hdrsize || !pskb_may_pull(skb, thoff + hdrsize))
+		return -1;
+
+	iph = ip_hdr(skb);
+	ports = (struct flow_ports *)(skb_network_header(skb) + thoff);
+
+	memset(tuple, 0, sizeof(*tuple));
+	tuple->src_v4.s_addr	= iph->saddr;
+	tuple->dst_v4.s_addr	= iph->daddr;
+	tuple->src_port		= ports->source;
+	tuple->dst_port		= ports->dest;
+	tuple->l3proto		= NFPROTO_IPV4;
+	tuple->l4proto		= iph->protocol;
+	tuple->iifidx		= skb->dev->ifindex;
+
+	return 0;
+}
+
+static bool nf_flow_exceeds_mtu(const struct sk_buff *skb, unsigned int mtu)
+{
+	if (skb_is_gso(skb))
+		return skb_gso_network_seglen(skb) > mtu;
+
+	return skb->len > mtu;
+}
+
+/* the transport checksum, NULL if there is none to update */
+static __sum16 *nf_flow_l4_check(struct sk_buff *skb, u8 protocol,
+				 unsigned int thoff)
+{
+	void *l4 = skb_network_header(skb) + thoff;
+	struct udphdr *udph;
+
+	switch (protocol) {
+	case IPPROTO_TCP:
+		return &((struct tcphdr *)l4)->check;
+	case IPPROTO_UDP:
+		udph = l4;
+		if (udph->check || skb->ip_summed == CHECKSUM_PARTIAL)
+			return &udph->check;
+		break;
+	}
+	return NULL;
+}
+
+static void nf_flow_nat_addr(struct sk_buff *skb, struct iphdr *iph,
+			     __sum16 *check, __be32 *addr, __be32 new_addr)
+{
+	if (*addr == new_addr)
+		return;
+
+	csum_replace4(&iph->check, *addr, new_addr);
+	if (check)
+		inet_proto_csum_replace4(check, skb, *addr, new_addr, true);
+	*addr = new_addr;
+}
+
+static void nf_flow_nat_port(struct sk_buff *skb, __sum16 *check,
+			     __be16 *port, __be16 new_port)
+{
+	if (*port == new_port)
+		return;
+
+	if (check)
+		inet_proto_csum_replace2(check, skb, *port, new_port, false);
+	*port = new_port;
+}
+
+/*
+ * Whatever NAT applies, a packet leaves with the inverse of the tuple of
+ * the other direction.
+ */
+static void nf_flow_nat_ip(const struct flow_offload *flow,
+			   struct sk_buff *skb, unsigned int thoff,
+			   enum flow_offload_tuple_dir dir)
+{
+	const struct flow_offload_tuple *other = &flow->tuplehash[!dir].tuple;
+	struct iphdr *iph = ip_hdr(skb);
+	struct flow_ports *ports;
+	__sum16 *check;
+
+	ports = (struct flow_ports *)(skb_network_header(skb) + thoff);
+	check = nf_flow_l4_check(skb, iph->protocol, thoff);
+
+	nf_flow_nat_addr(skb, iph, check, &iph->saddr, other->dst_v4.s_addr);
+	nf_flow_nat_addr(skb, iph, check, &iph->daddr, other->src_v4.s_addr);
+	nf_flow_nat_port(skb, check, &ports->source, other->dst_port);
+	nf_flow_nat_port(skb, check, &ports->dest, other->src_port);
+
+	if (check && iph->protocol == IPPROTO_UDP && !*check)
+		*check = CSUM_MANGLED_0;
+}
+
+/**
+ * nf_flow_offload_ip_hook - forward a packet of an offloaded IPv4 flow
+ *
+ * Meant for the netdev ingress hook.  Packets that don't belong to an
+ * offloaded flow, or that need anything the fast path doesn't do, are
+ * accepted and go through the regular stack.
+ */
+unsigned int nf_flow_offload_ip_hook(const struct nf_hook_ops *ops,
+				     struct sk_buff *skb,
+				     const struct nf_hook_state *state)
+{
+	struct flow_offload_tuple_rhash *tuplehash;
+	struct nf_flowtable *flow_table;
+	enum flow_offload_tuple_dir dir;
+	struct flow_offload_tuple tuple;
+	struct flow_offload *flow;
+	struct net_device *outdev;
+	unsigned int thoff;
+	struct rtable *rt;
+	struct iphdr *iph;
+	__be32 nexthop;
+
+	if (skb->protocol != htons(ETH_P_IP))
+		return NF_ACCEPT;
+
+	if (nf_flow_tuple_ip(skb, &tuple) < 0)
+		return NF_ACCEPT;
+
+	flow_table = nf_flow_table_get(dev_net(skb->dev));
+	tuplehash = flow_offload_lookup(flow_table, &tuple);
+	if (!tuplehash)
+		return NF_ACCEPT;
+
+	dir = tuplehash->tuple.dir;
+	flow = container_of(tuplehash, struct flow_offload, tuplehash[dir]);
+	rt = (struct rtable *)tuplehash->tuple.dst_cache;
+
+	if (unlikely(nf_flow_exceeds_mtu(skb, tuplehash->tuple.mtu)))
+		return NF_ACCEPT;
+
+	if (unlikely(nf_ct_is_dying(flow->ct) || !dst_check(&rt->dst, 0))) {
+		flow_offload_teardown(flow);
+		return NF_ACCEPT;
+	}
+
+	thoff = sizeof(struct iphdr);
+	if (tuple.l4proto == IPPROTO_TCP) {
+		struct tcphdr *tcph;
+
+		/* let conntrack see the connection being closed */
+		tcph = (struct tcphdr *)(skb_network_header(skb) + thoff);
+		if (unlikely(tcph->fin || tcph->rst)) {
+			flow_offload_teardown(flow);
+			return NF_ACCEPT;
+		}
+	}
+
+	if (!skb_make_writable(skb, thoff + nf_flow_l4_hdrsize(tuple.l4proto)))
+		return NF_DROP;
+
+	flow_offload_refresh(flow);
+
+	if (flow->flags & (FLOW_OFFLOAD_SNAT | FLOW_OFFLOAD_DNAT))
+		nf_flow_nat_ip(flow, skb, thoff, dir);
+
+	iph = ip_hdr(skb);
+	ip_decrease_ttl(iph);
+	skb_forward_csum(skb);
+
+	outdev = rt->dst.dev;
+	skb->dev = outdev;
+	nexthop = rt_nexthop(rt, flow->tuplehash[!dir].tuple.src_v4.s_addr);
+	skb_dst_set_noref(skb, &rt->dst);
+	neigh_xmit(NEIGH_ARP_TABLE, outdev, &nexthop, skb);
+
+	return NF_STOLEN;
+}
+EXPORT_SYMBOL_GPL(nf_flow_offload_ip_hook);
+
+static unsigned int
+nft_do_chain_flow_offload(const struct nf_hook_ops *ops, struct sk_buff *skb,
+			  const struct nf_hook_state *state)
+{
+	struct nft_pktinfo pkt;
+	unsigned int verdict;
+	struct iphdr *iph;
+
+	verdict = nf_flow_offload_ip_hook(ops, skb, state);
+	if (verdict != NF_ACCEPT)
+		return verdict;
+
+	nft_set_pktinfo(&pkt, ops, skb, state);
+	pkt.tprot = 0;
+	pkt.xt.thoff = 0;
+	pkt.xt.fragoff = 0;
+	if (skb->protocol == htons(ETH_P_IP) &&
+	    pskb_may_pull(skb, sizeof(struct iphdr))) {
+		iph = ip_hdr(skb);
+		if (iph->version == 4 && iph->ihl >= 5) {
+			pkt.tprot = iph->protocol;
+			pkt.xt.thoff = iph->ihl * 4;
+			pkt.xt.fragoff = ntohs(iph->frag_off) & IP_OFFSET;
+		}
+	}
+
+	return nft_do_chain(&pkt, ops);
+}
+
+/*
+ * An "offload" chain attaches the fast path to a device; its rules see
+ * everything that is not forwarded from there.
+ */
+static const struct nf_chain_type nft_chain_flow_offload_netdev = {
+	.name		= "offload",
+	.type		= NFT_CHAIN_T_OFFLOAD,
+	.family		= NFPROTO_NETDEV,
+	.owner		= THIS_MODULE,
+	.hook_mask	= (1 << NF_NETDEV_INGRESS),
+	.hooks		= {
+		[NF_NETDEV_INGRESS]	= nft_do_chain_flow_offload,
+	},
+};
+
+static int __init nf_flow_ipv4_module_init(void)
+{
+	return nft_register_chain_type(&nft_chain_flow_offload_netdev);
+}
+
+static void __exit nf_flow_ipv4_module_exit(void)
+{
+	nft_unregister_chain_type(&nft_chain_flow_offload_netdev);
+}
+
+module_init(nf_flow_ipv4_module_init);
+module_exit(nf_flow_ipv4_module_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_ALIAS_NFT_CHAIN(NFPROTO_NETDEV, "offload");
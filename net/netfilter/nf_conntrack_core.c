@@ -330,7 +330,6 @@ destroy_conntrack(struct nf_conntrack *nfct)
 
 	pr_debug("destroy_conntrack(%p)\n", ct);
 	NF_CT_ASSERT(atomic_read(&nfct->use) == 0);
-	NF_CT_ASSERT(!timer_pending(&ct->timeout));
 
 	if (unlikely(nf_ct_is_template(ct))) {
 		nf_ct_tmpl_free(ct);
@@ -393,33 +392,40 @@ bool nf_ct_delete(struct nf_conn *ct, u32 portid, int report)
 {
 	struct nf_conn_tstamp *tstamp;
 
+	/* whoever sets the bit owns the hash table reference */
+	if (test_and_set_bit(IPS_DYING_BIT, &ct->status))
+		return false;
+
 	tstamp = nf_conn_tstamp_find(ct);
 	if (tstamp && tstamp->stop == 0)
 		tstamp->stop = ktime_get_real_ns();
 
-	if (nf_ct_is_dying(ct))
-		goto delete;
-
 	if (nf_conntrack_event_report(IPCT_DESTROY, ct,
 				    portid, report) < 0) {
-		/* destroy event was not delivered */
+		/* destroy event was not delivered, nf_ct_put() will be
+		 * done by the event cache worker on redelivery.
+		 */
 		nf_ct_delete_from_lists(ct);
 		nf_conntrack_ecache_delayed_work(nf_ct_net(ct));
 		return false;
 	}
 
 	nf_conntrack_ecache_work(nf_ct_net(ct));
-	set_bit(IPS_DYING_BIT, &ct->status);
- delete:
 	nf_ct_delete_from_lists(ct);
 	nf_ct_put(ct);
 	return true;
 }
 EXPORT_SYMBOL_GPL(nf_ct_delete);
 
-static void death_by_timeout(unsigned long ul_conntrack)
+static void nf_ct_gc_expired(struct nf_conn *ct)
 {
-	nf_ct_delete((struct nf_conn *)ul_conntrack, 0, 0);
+	if (!atomic_inc_not_zero(&ct->ct_general.use))
+		return;
+
+	if (nf_ct_should_gc(ct))
+		nf_ct_kill(ct);
+
+	nf_ct_put(ct);
 }
 
 static inline bool
@@ -456,6 +462,13 @@ ____nf_conntrack_find(struct net *net, const struct nf_conntrack_zone *zone,
 	local_bh_disable();
 begin:
 	hlist_nulls_for_each_entry_rcu(h, n, &net->ct.hash[bucket], hnnode) {
+		struct nf_conn *ct = nf_ct_tuplehash_to_ctrack(h);
+
+		if (nf_ct_is_expired(ct)) {
+			nf_ct_gc_expired(ct);
+			continue;
+		}
+
 		if (nf_ct_key_equal(h, tuple, zone)) {
 			NF_CT_STAT_INC(net, found);
 			local_bh_enable();
@@ -561,7 +574,6 @@ nf_conntrack_hash_check_insert(struct nf_conn *ct)
 				     NF_CT_DIRECTION(h)))
 			goto out;
 
-	add_timer(&ct->timeout);
 	smp_wmb();
 	/* The caller holds a reference to this object */
 	atomic_set(&ct->ct_general.use, 2);
@@ -654,11 +666,10 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 				     NF_CT_DIRECTION(h)))
 			goto out;
 
-	/* Timer relative to confirmation time, not original
+	/* Timeout relative to confirmation time, not original
 	   setting time, otherwise we'd get timer wrap in
 	   weird delay cases. */
-	ct->timeout.expires += jiffies;
-	add_timer(&ct->timeout);
+	ct->timeout += nfct_time_stamp;
 	atomic_inc(&ct->ct_general.use);
 	ct->status |= IPS_CONFIRMED;
 
@@ -671,7 +682,7 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 		tstamp->start = ktime_to_ns(skb->tstamp);
 	}
 	/* Since the lookup is lockless, hash insertion must be done after
-	 * starting the timer and setting the CONFIRMED bit. The RCU barriers
+	 * setting the timeout and the CONFIRMED bit. The RCU barriers
 	 * guarantee that no other CPU can find the conntrack before the above
 	 * stores are visible.
 	 */
@@ -763,7 +774,11 @@ restart:
 		hlist_nulls_for_each_entry_rcu(h, n, &net->ct.hash[hash],
 					 hnnode) {
 			tmp = nf_ct_tuplehash_to_ctrack(h);
-			if (!test_bit(IPS_ASSURED_BIT, &tmp->status) &&
+			/* expired entries are fair game even if assured,
+			 * the gc worker just didn't get to them yet
+			 */
+			if ((!test_bit(IPS_ASSURED_BIT, &tmp->status) ||
+			     nf_ct_is_expired(tmp)) &&
 			    !nf_ct_is_dying(tmp) &&
 			    atomic_inc_not_zero(&tmp->ct_general.use)) {
 				ct = tmp;
@@ -784,11 +799,9 @@ restart:
 	if (!ct)
 		return dropped;
 
-	if (del_timer(&ct->timeout)) {
-		if (nf_ct_delete(ct, 0, 0)) {
-			dropped = 1;
-			NF_CT_STAT_INC_ATOMIC(net, early_drop);
-		}
+	if (nf_ct_delete(ct, 0, 0)) {
+		dropped = 1;
+		NF_CT_STAT_INC_ATOMIC(net, early_drop);
 	}
 	nf_ct_put(ct);
 	return dropped;
@@ -851,8 +864,8 @@ __nf_conntrack_alloc(struct net *net,
 	/* save hash for reusing when confirming */
 	*(unsigned long *)(&ct->tuplehash[IP_CT_DIR_REPLY].hnnode.pprev) = hash;
 	ct->status = 0;
-	/* Don't set timer yet: wait for confirmation */
-	setup_timer(&ct->timeout, death_by_timeout, (unsigned long)ct);
+	/* relative until confirmation, see __nf_conntrack_confirm() */
+	ct->timeout = 0;
 	write_pnet(&ct->ct_net, net);
 	memset(&ct->__nfct_init_offset[0], 0,
 	       offsetof(struct nf_conn, proto) -
@@ -1226,24 +1239,23 @@ void __nf_ct_refresh_acct(struct nf_conn *ct,
 			  unsigned long extra_jiffies,
 			  int do_acct)
 {
-	NF_CT_ASSERT(ct->timeout.data == (unsigned long)ct);
 	NF_CT_ASSERT(skb);
 
 	/* Only update if this is not a fixed timeout */
 	if (test_bit(IPS_FIXED_TIMEOUT_BIT, &ct->status))
 		goto acct;
 
-	/* If not in hash table, timer will not be active yet */
+	/* If not in hash table, the timeout is still relative */
 	if (!nf_ct_is_confirmed(ct)) {
-		ct->timeout.expires = extra_jiffies;
+		ct->timeout = extra_jiffies;
 	} else {
-		unsigned long newtime = jiffies + extra_jiffies;
+		u32 newtime = nfct_time_stamp + extra_jiffies;
 
 		/* Only update the timeout if the new timeout is at least
-		   HZ jiffies from the old timeout. Need del_timer for race
-		   avoidance (may already be dying). */
-		if (newtime - ct->timeout.expires >= HZ)
-			mod_timer_pending(&ct->timeout, newtime);
+		   HZ jiffies from the old timeout, this keeps the cache
+		   line clean for most packets of a busy flow. */
+		if (newtime - READ_ONCE(ct->timeout) >= HZ)
+			WRITE_ONCE(ct->timeout, newtime);
 	}
 
 acct:
@@ -1279,11 +1291,7 @@ bool __nf_ct_kill_acct(struct nf_conn *ct,
 		}
 	}
 
-	if (del_timer(&ct->timeout)) {
-		ct->timeout.function((unsigned long)ct);
-		return true;
-	}
-	return false;
+	return nf_ct_delete(ct, 0, 0);
 }
 EXPORT_SYMBOL_GPL(__nf_ct_kill_acct);
 
@@ -1418,16 +1426,84 @@ void nf_ct_iterate_cleanup(struct net *net,
 
 	while ((ct = get_next_corpse(net, iter, data, &bucket)) != NULL) {
 		/* Time to push up daises... */
-		if (del_timer(&ct->timeout))
-			nf_ct_delete(ct, portid, report);
-
-		/* ... else the timer will get him soon. */
-
+		nf_ct_delete(ct, portid, report);
 		nf_ct_put(ct);
 	}
 }
 EXPORT_SYMBOL_GPL(nf_ct_iterate_cleanup);
 
+/* The gc worker visits 1/GC_MAX_BUCKETS_DIV of the table, at most
+ * GC_MAX_BUCKETS buckets, every GC_INTERVAL and runs again right away
+ * while most of the entries it sees are expired.  Lookups reap the
+ * expired entries they walk over, so this mostly catches idle flows.
+ */
+#define GC_MAX_BUCKETS_DIV	64u
+#define GC_MAX_BUCKETS		8192u
+#define GC_INTERVAL		(5 * HZ)
+#define GC_MAX_EVICTS		256u
+
+static void gc_worker(struct work_struct *work)
+{
+	struct net *net = container_of(to_delayed_work(work), struct net,
+				       ct.gc_work);
+	unsigned int i, goal, buckets = 0, expired_count = 0;
+	unsigned long next_run = GC_INTERVAL;
+	unsigned int ratio, scanned = 0;
+
+	goal = min(net->ct.htable_size / GC_MAX_BUCKETS_DIV, GC_MAX_BUCKETS);
+	if (!goal)
+		goal = net->ct.htable_size;
+	i = net->ct.gc_next_bucket;
+
+	do {
+		struct nf_conntrack_tuple_hash *h;
+		struct hlist_nulls_head *ct_hash;
+		struct hlist_nulls_node *n;
+		unsigned int hashsz, sequence;
+		struct nf_conn *tmp;
+
+		rcu_read_lock();
+		do {
+			sequence = read_seqcount_begin(&net->ct.generation);
+			ct_hash = net->ct.hash;
+			hashsz = net->ct.htable_size;
+		} while (read_seqcount_retry(&net->ct.generation, sequence));
+
+		if (++i >= hashsz)
+			i = 0;
+
+		/* an entry may move to another chain under us, that only
+		 * means part of another bucket gets scanned
+		 */
+		hlist_nulls_for_each_entry_rcu(h, n, &ct_hash[i], hnnode) {
+			tmp = nf_ct_tuplehash_to_ctrack(h);
+
+			scanned++;
+			if (test_bit(IPS_OFFLOAD_BIT, &tmp->status)) {
+				nf_ct_offload_timeout(tmp);
+				continue;
+			}
+
+			if (nf_ct_is_expired(tmp)) {
+				local_bh_disable();
+				nf_ct_gc_expired(tmp);
+				local_bh_enable();
+				expired_count++;
+			}
+		}
+		rcu_read_unlock();
+		cond_resched();
+	} while (++buckets < goal && expired_count < GC_MAX_EVICTS);
+
+	net->ct.gc_next_bucket = i;
+
+	ratio = scanned ? expired_count * 100 / scanned : 0;
+	if (ratio >= 90 || expired_count >= GC_MAX_EVICTS)
+		next_run = 0;
+
+	queue_delayed_work(system_long_wq, &net->ct.gc_work, next_run);
+}
+
 static int kill_all(struct nf_conn *i, void *data)
 {
 	return 1;
@@ -1503,6 +1579,9 @@ void nf_conntrack_cleanup_net_list(struct list_head *net_exit_list)
 	 *  delete...
 	 */
 	synchronize_net();
+
+	list_for_each_entry(net, net_exit_list, exit_list)
+		cancel_delayed_work_sync(&net->ct.gc_work);
 i_see_dead_people:
 	busy = 0;
 	list_for_each_entry(net, net_exit_list, exit_list) {
@@ -1809,6 +1888,9 @@ int nf_conntrack_init_net(struct net *net)
 	ret = nf_conntrack_proto_pernet_init(net);
 	if (ret < 0)
 		goto err_proto;
+
+	INIT_DEFERRABLE_WORK(&net->ct.gc_work, gc_worker);
+	queue_delayed_work(system_long_wq, &net->ct.gc_work, GC_INTERVAL);
 	return 0;
 
 err_proto:
@@ -0,0 +1,413 @@
+/*
+ * Software flow offload table for established conntrack entries
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/netdevice.h>
+#include <linux/rhashtable.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <net/ip.h>
+#include <net/net_namespace.h>
+#include <net/netns/generic.h>
+#include <net/netfilter/nf_flow_table.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_core.h>
+#include <net/netfilter/nf_conntrack_l4proto.h>
+#include <net/netfilter/nf_conntrack_tuple.h>
+
+static int nf_flow_table_net_id __read_mostly;
+
+static void
+flow_offload_fill_dir(struct flow_offload *flow, struct nf_conn *ct,
+		      struct nf_flow_route *route,
+		      enum flow_offload_tuple_dir dir)
+{
+	struct flow_offload_tuple *ft = &flow->tuplehash[dir].tuple;
+	struct nf_conntrack_tuple *ctt = &ct->tuplehash[dir].tuple;
+	struct dst_entry *dst = route->tuple[dir].dst;
+
+	ft->dir = dir;
+	ft->src_v4 = ctt->src.u3.in;
+	ft->dst_v4 = ctt->dst.u3.in;
+	ft->l3proto = ctt->src.l3num;
+	ft->l4proto = ctt->dst.protonum;
+	ft->src_port = ctt->src.u.tcp.port;
+	ft->dst_port = ctt->dst.u.tcp.port;
+
+	/* packets of this direction arrive where the other one leaves */
+	ft->iifidx = route->tuple[!dir].dst->dev->ifindex;
+	ft->mtu = ip_dst_mtu_maybe_forward(dst, true);
+	ft->dst_cache = dst;
+}
+
+/**
+ * flow_offload_alloc - set up a flow for an established IPv4 conntrack
+ * @ct:		the conntrack entry, the caller has set IPS_OFFLOAD_BIT
+ * @route:	output route of each direction
+ *
+ * Takes a reference on @ct and on both routes.  Returns NULL if @ct is
+ * going away or on allocation failure.
+ */
+struct flow_offload *
+flow_offload_alloc(struct nf_conn *ct, struct nf_flow_route *route)
+{
+	struct flow_offload *flow;
+
+	if (unlikely(nf_ct_is_dying(ct) ||
+		     !atomic_inc_not_zero(&ct->ct_general.use)))
+		return NULL;
+
+	flow = kzalloc(sizeof(*flow), GFP_ATOMIC);
+	if (!flow) {
+		nf_ct_put(ct);
+		return NULL;
+	}
+
+	flow->ct = ct;
+	dst_hold(route->tuple[FLOW_OFFLOAD_DIR_ORIGINAL].dst);
+	dst_hold(route->tuple[FLOW_OFFLOAD_DIR_REPLY].dst);
+
+	flow_offload_fill_dir(flow, ct, route, FLOW_OFFLOAD_DIR_ORIGINAL);
+	flow_offload_fill_dir(flow, ct, route, FLOW_OFFLOAD_DIR_REPLY);
+
+	if (ct->status & IPS_SRC_NAT)
+		flow->flags |= FLOW_OFFLOAD_SNAT;
+	if (ct->status & IPS_DST_NAT)
+		flow->flags |= FLOW_OFFLOAD_DNAT;
+
+	return flow;
+}
+EXPORT_SYMBOL_GPL(flow_offload_alloc);
+
+/**
+ * flow_offload_free - release a flow that is not in a table
+ * @flow:	the flow
+ *
+ * Drops the references taken by flow_offload_alloc() and hands the
+ * conntrack entry back to the slow path.
+ */
+void flow_offload_free(struct flow_offload *flow)
+{
+	dst_release(flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].tuple.dst_cache);
+	dst_release(flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].tuple.dst_cache);
+	clear_bit(IPS_OFFLOAD_BIT, &flow->ct->status);
+	nf_ct_put(flow->ct);
+	kfree_rcu(flow, rcu_head);
+}
+EXPORT_SYMBOL_GPL(flow_offload_free);
+
+static const struct rhashtable_params nf_flow_offload_rhash_params = {
+	.head_offset	= offsetof(struct flow_offload_tuple_rhash, node),
+	.key_offset	= offsetof(struct flow_offload_tuple_rhash, tuple),
+	.key_len	= offsetof(struct flow_offload_tuple, dir),
+	.automatic_shrinking = true,
+};
+
+/**
+ * flow_offload_add - start forwarding a flow from the fast path
+ * @flow_table:	the table
+ * @flow:	a flow from flow_offload_alloc()
+ *
+ * On error the caller still owns @flow.
+ */
+int flow_offload_add(struct nf_flowtable *flow_table, struct flow_offload *flow)
+{
+	int err;
+
+	flow->timeout = nf_flowtable_time_stamp + NF_FLOW_TIMEOUT;
+
+	err = rhashtable_insert_fast(&flow_table->rhashtable,
+				     &flow->tuplehash[0].node,
+				     nf_flow_offload_rhash_params);
+	if (err < 0)
+		return err;
+
+	err = rhashtable_insert_fast(&flow_table->rhashtable,
+				     &flow->tuplehash[1].node,
+				     nf_flow_offload_rhash_params);
+	if (err < 0)
+		rhashtable_remove_fast(&flow_table->rhashtable,
+				       &flow->tuplehash[0].node,
+				       nf_flow_offload_rhash_params);
+	return err;
+}
+EXPORT_SYMBOL_GPL(flow_offload_add);
+
+/*
+ * The conntrack entry has not seen a packet while it was offloaded: its
+ * TCP window tracking is stale and its timeout was pushed out by a day.
+ * Let the slow path pick the connection up again from the next packet,
+ * with the timeout of an established connection.
+ */
+static void flow_offload_fixup_ct(struct nf_conn *ct)
+{
+	struct nf_conntrack_l4proto *l4proto;
+	unsigned int *timeouts, timeout;
+	u8 l4num = nf_ct_protonum(ct);
+
+	rcu_read_lock();
+	l4proto = __nf_ct_l4proto_find(nf_ct_l3num(ct), l4num);
+	timeouts = l4proto->get_timeouts(nf_ct_net(ct));
+
+	if (l4num == IPPROTO_TCP) {
+		spin_lock_bh(&ct->lock);
+		ct->proto.tcp.state = TCP_CONNTRACK_ESTABLISHED;
+		ct->proto.tcp.seen[0].td_maxwin = 0;
+		ct->proto.tcp.seen[1].td_maxwin = 0;
+		spin_unlock_bh(&ct->lock);
+		timeout = timeouts[TCP_CONNTRACK_ESTABLISHED];
+	} else {
+		timeout = timeouts[UDP_CT_REPLIED];
+	}
+	rcu_read_unlock();
+
+	WRITE_ONCE(ct->timeout, nfct_time_stamp + timeout);
+}
+
+/* only called from the gc worker, which is the single remover */
+static void flow_offload_del(struct nf_flowtable *flow_table,
+			     struct flow_offload *flow)
+{
+	struct nf_conn *ct = flow->ct;
+
+	rhashtable_remove_fast(&flow_table->rhashtable,
+			       &flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].node,
+			       nf_flow_offload_rhash_params);
+	rhashtable_remove_fast(&flow_table->rhashtable,
+			       &flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].node,
+			       nf_flow_offload_rhash_params);
+
+	flow_offload_fixup_ct(ct);
+	flow_offload_free(flow);
+}
+
+/**
+ * flow_offload_teardown - hand a flow back to the slow path
+ * @flow:	the flow
+ *
+ * The fast path stops using it right away, it is released by the next
+ * gc run.
+ */
+void flow_offload_teardown(struct flow_offload *flow)
+{
+	flow->flags |= FLOW_OFFLOAD_TEARDOWN;
+}
+EXPORT_SYMBOL_GPL(flow_offload_teardown);
+
+/**
+ * flow_offload_lookup - find the flow a packet belongs to
+ * @flow_table:	the table
+ * @tuple:	the packet's tuple, up to and excluding @dir
+ *
+ * Must be called under rcu_read_lock().
+ */
+struct flow_offload_tuple_rhash *
+flow_offload_lookup(struct nf_flowtable *flow_table,
+		    struct flow_offload_tuple *tuple)
+{
+	struct flow_offload_tuple_rhash *tuplehash;
+	struct flow_offload *flow;
+	int dir;
+
+	tuplehash = rhashtable_lookup_fast(&flow_table->rhashtable, tuple,
+					   nf_flow_offload_rhash_params);
+	if (!tuplehash)
+		return NULL;
+
+	dir = tuplehash->tuple.dir;
+	flow = container_of(tuplehash, struct flow_offload, tuplehash[dir]);
+	if (flow->flags & FLOW_OFFLOAD_TEARDOWN)
+		return NULL;
+
+	return tuplehash;
+}
+EXPORT_SYMBOL_GPL(flow_offload_lookup);
+
+static void nf_flow_table_iterate(struct nf_flowtable *flow_table,
+				  void (*iter)(struct nf_flowtable *,
+					       struct flow_offload *, void *),
+				  void *data)
+{
+	struct flow_offload_tuple_rhash *tuplehash;
+	struct rhashtable_iter hti;
+	struct flow_offload *flow;
+
+	if (rhashtable_walk_init(&flow_table->rhashtable, &hti))
+		return;
+
+	/* -EAGAIN only means the table is being resized */
+	rhashtable_walk_start(&hti);
+
+	while ((tuplehash = rhashtable_walk_next(&hti))) {
+		if (IS_ERR(tuplehash)) {
+			if (PTR_ERR(tuplehash) != -EAGAIN)
+				break;
+			continue;
+		}
+		/* visit each flow once, through its original direction */
+		if (tuplehash->tuple.dir)
+			continue;
+
+		flow = container_of(tuplehash, struct flow_offload,
+				    tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL]);
+		iter(flow_table, flow, data);
+	}
+
+	rhashtable_walk_stop(&hti);
+	rhashtable_walk_exit(&hti);
+}
+
+static inline bool nf_flow_has_expired(const struct flow_offload *flow)
+{
+	return (__s32)(flow->timeout - nf_flowtable_time_stamp) <= 0;
+}
+
+static void nf_flow_offload_gc_step(struct nf_flowtable *flow_table,
+				    struct flow_offload *flow, void *data)
+{
+	if (nf_flow_has_expired(flow) || nf_ct_is_dying(flow->ct) ||
+	    (flow->flags & FLOW_OFFLOAD_TEARDOWN))
+		flow_offload_del(flow_table, flow);
+	else
+		/* conntrack gc may not get to it before a lookup expires it */
+		nf_ct_offload_timeout(flow->ct);
+}
+
+static void nf_flow_offload_work_gc(struct work_struct *work)
+{
+	struct nf_flowtable *flow_table;
+
+	flow_table = container_of(work, struct nf_flowtable, gc_work.work);
+	nf_flow_table_iterate(flow_table, nf_flow_offload_gc_step, NULL);
+	queue_delayed_work(system_power_efficient_wq, &flow_table->gc_work, HZ);
+}
+
+/**
+ * nf_flow_table_get - the flow table of a network namespace
+ * @net:	the namespace
+ */
+struct nf_flowtable *nf_flow_table_get(const struct net *net)
+{
+	return net_generic(net, nf_flow_table_net_id);
+}
+EXPORT_SYMBOL_GPL(nf_flow_table_get);
+
+static void nf_flow_table_teardown_dev(struct nf_flowtable *flow_table,
+				       struct flow_offload *flow, void *data)
+{
+	struct net_device *dev = data;
+	int i;
+
+	if (!dev) {
+		flow_offload_teardown(flow);
+		return;
+	}
+
+	for (i = 0; i < FLOW_OFFLOAD_DIR_MAX; i++) {
+		struct flow_offload_tuple *tuple = &flow->tuplehash[i].tuple;
+
+		if (tuple->iifidx == dev->ifindex ||
+		    tuple->dst_cache->dev == dev)
+			flow_offload_teardown(flow);
+	}
+}
+
+/**
+ * nf_flow_table_cleanup - release the flows using a device
+ * @net:	the namespace
+ * @dev:	the device, NULL for all flows
+ *
+ * Returns once the flows are gone.  Must be called from process context.
+ */
+void nf_flow_table_cleanup(struct net *net, struct net_device *dev)
+{
+	struct nf_flowtable *flow_table = nf_flow_table_get(net);
+
+	nf_flow_table_iterate(flow_table, nf_flow_table_teardown_dev, dev);
+	flush_delayed_work(&flow_table->gc_work);
+}
+EXPORT_SYMBOL_GPL(nf_flow_table_cleanup);
+
+static int nf_flow_table_netdev_event(struct notifier_block *this,
+				      unsigned long event, void *ptr)
+{
+	struct net_device *dev = netdev_notifier_info_to_dev(ptr);
+
+	if (event != NETDEV_DOWN)
+		return NOTIFY_DONE;
+
+	nf_flow_table_cleanup(dev_net(dev), dev);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block nf_flow_table_netdev_notifier = {
+	.notifier_call	= nf_flow_table_netdev_event,
+};
+
+static int __net_init nf_flow_table_net_init(struct net *net)
+{
+	struct nf_flowtable *flow_table = nf_flow_table_get(net);
+	int err;
+
+	err = rhashtable_init(&flow_table->rhashtable,
+			      &nf_flow_offload_rhash_params);
+	if (err < 0)
+		return err;
+
+	INIT_DEFERRABLE_WORK(&flow_table->gc_work, nf_flow_offload_work_gc);
+	queue_delayed_work(system_power_efficient_wq, &flow_table->gc_work, HZ);
+
+	return 0;
+}
+
+static void __net_exit nf_flow_table_net_exit(struct net *net)
+{
+	struct nf_flowtable *flow_table = nf_flow_table_get(net);
+
+	cancel_delayed_work_sync(&flow_table->gc_work);
+	nf_flow_table_iterate(flow_table, nf_flow_table_teardown_dev, NULL);
+	nf_flow_table_iterate(flow_table, nf_flow_offload_gc_step, NULL);
+	rhashtable_destroy(&flow_table->rhashtable);
+}
+
+static struct pernet_operations nf_flow_table_net_ops = {
+	.init	= nf_flow_table_net_init,
+	.exit	= nf_flow_table_net_exit,
+	.id	= &nf_flow_table_net_id,
+	.size	= sizeof(struct nf_flowtable),
+};
+
+static int __init nf_flow_table_module_init(void)
+{
+	int err;
+
+	err = register_pernet_subsys(&nf_flow_table_net_ops);
+	if (err < 0)
+		return err;
+
+	err = register_netdevice_notifier(&nf_flow_table_netdev_notifier);
+	if (err < 0)
+		unregister_pernet_subsys(&nf_flow_table_net_ops);
+
+	return err;
+}
+
+static void __exit nf_flow_table_module_exit(void)
+{
+	unregister_netdevice_notifier(&nf_flow_table_netdev_notifier);
+	unregister_pernet_subsys(&nf_flow_table_net_ops);
+}
+
+module_init(nf_flow_table_module_init);
+module_exit(nf_flow_table_module_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Netfilter flow offload table");
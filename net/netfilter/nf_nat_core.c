@@ -544,19 +544,16 @@ static int nf_nat_proto_clean(struct nf_conn *ct, void *data)
 	 * Remove it from bysource hash, as the table will be freed soon.
 	 *
 	 * Else, when the conntrack is destoyed, nf_nat_cleanup_conntrack()
-	 * will delete entry from already-freed table.
+	 * will delete entry from already-freed table.  We are called with
+	 * the bucket lock of the conntrack held, so it can't be removed
+	 * from the hash and destroyed under us.
 	 */
-	if (!del_timer(&ct->timeout))
-		return 1;
-
 	spin_lock_bh(&nf_nat_lock);
 	hlist_del_rcu(&nat->bysource);
 	ct->status &= ~IPS_NAT_DONE_MASK;
 	nat->ct = NULL;
 	spin_unlock_bh(&nf_nat_lock);
 
-	add_timer(&ct->timeout);
-
 	/* don't delete conntrack.  Although that would make things a lot
 	 * simpler, we'd end up flushing all conntracks on nat rmmod.
 	 */
@@ -86,6 +86,10 @@ struct listeners {
 #define NETLINK_F_LISTEN_ALL_NSID	0x10
 #define NETLINK_F_CAP_ACK		0x20
 
+/* dump skbs are sized after recvmsg() buffers, up to 16K by default */
+#define NETLINK_DUMP_SIZE_DEFAULT	16384
+#define NETLINK_DUMP_SIZE_MAX		(256 * 1024)
+
 static inline int netlink_is_kernel(struct sock *sk)
 {
 	return nlk_sk(sk)->flags & NETLINK_F_KERNEL_SOCKET;
@@ -2315,6 +2319,12 @@ static int netlink_setsockopt(struct socket *sock, int level, int optname,
 			nlk->flags &= ~NETLINK_F_CAP_ACK;
 		err = 0;
 		break;
+	case NETLINK_DUMP_SIZE:
+		/* allocations this large are attempted but may fail */
+		nlk->dump_size = min_t(unsigned int, val,
+				       NETLINK_DUMP_SIZE_MAX);
+		err = 0;
+		break;
 	default:
 		err = -ENOPROTOOPT;
 	}
@@ -2399,6 +2409,16 @@ static int netlink_getsockopt(struct socket *sock, int level, int optname,
 			return -EFAULT;
 		err = 0;
 		break;
+	case NETLINK_DUMP_SIZE:
+		if (len < sizeof(int))
+			return -EINVAL;
+		len = sizeof(int);
+		val = max_t(u32, nlk->dump_size, NETLINK_DUMP_SIZE_DEFAULT);
+		if (put_user(len, optlen) ||
+		    put_user(val, optval))
+			return -EFAULT;
+		err = 0;
+		break;
 	default:
 		err = -ENOPROTOOPT;
 	}
@@ -2557,7 +2577,8 @@ static int netlink_recvmsg(struct socket *sock, struct msghdr *msg, size_t len,
 	/* Record the max length of recvmsg() calls for future allocations */
 	nlk->max_recvmsg_len = max(nlk->max_recvmsg_len, len);
 	nlk->max_recvmsg_len = min_t(size_t, nlk->max_recvmsg_len,
-				     16384);
+				     max_t(u32, nlk->dump_size,
+					   NETLINK_DUMP_SIZE_DEFAULT));
 
 	copied = data_skb->len;
 	if (len < copied) {
@@ -2803,7 +2824,8 @@ static int netlink_dump(struct sock *sk)
 	/* NLMSG_GOODSIZE is small to avoid high order allocations being
 	 * required, but it makes sense to _attempt_ a 16K bytes allocation
 	 * to reduce number of system calls on dump operations, if user
-	 * ever provided a big enough buffer.
+	 * ever provided a big enough buffer.  NETLINK_DUMP_SIZE raises
+	 * that limit for sockets reading large dumps.
 	 */
 	if (alloc_size < nlk->max_recvmsg_len) {
 		skb = netlink_alloc_skb(sk,
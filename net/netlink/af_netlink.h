@@ -34,6 +34,7 @@ struct netlink_sock {
 	unsigned long		*groups;
 	unsigned long		state;
 	size_t			max_recvmsg_len;
+	u32			dump_size;
 	wait_queue_head_t	wait;
 	bool			bound;
 	bool			cb_running;
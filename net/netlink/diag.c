@@ -99,61 +99,102 @@ out_nlmsg_trim:
 	return -EMSGSIZE;
 }
 
+/* Returns 1 if @skb is full, 0 if @sk was dumped or filtered out. */
+static int netlink_diag_dump_one(struct sock *sk, struct sk_buff *skb,
+				 struct netlink_callback *cb,
+				 struct netlink_diag_req *req)
+{
+	unsigned long ino = sock_i_ino(sk);
+
+	if (req->ndiag_ino && req->ndiag_ino != ino)
+		return 0;
+
+	if (sk_diag_fill(sk, skb, req, NETLINK_CB(cb->skb).portid,
+			 cb->nlh->nlmsg_seq, NLM_F_MULTI, ino) < 0)
+		return 1;
+
+	return 0;
+}
+
+/* cb->args[2] while walking the sockets bound to multicast groups only */
+#define NDIAG_MC_SLOT	INT_MAX
+
+/*
+ * The walk resumes at the hash bucket it stopped in, cb->args[2], and only
+ * skips the cb->args[0] sockets already dumped from it, so that a dump
+ * costs O(n) rather than restarting from the first bucket every time.
+ *
+ * Bucket indexes only hold while the table isn't resized, which the
+ * hash_rnd of the table, saved in cb->args[3], tells.  After a resize the
+ * walk starts over from the first bucket and skips the cb->args[4]
+ * sockets that were passed in total, as it always did before.
+ */
 static int __netlink_diag_dump(struct sk_buff *skb, struct netlink_callback *cb,
-				int protocol, int s_num)
+				int protocol)
 {
 	struct netlink_table *tbl = &nl_table[protocol];
 	struct rhashtable *ht = &tbl->hash;
 	const struct bucket_table *htbl = rht_dereference_rcu(ht->tbl, ht);
 	struct net *net = sock_net(skb->sk);
+	long s_num = cb->args[0], s_slot = cb->args[2];
+	long total = cb->args[4], skip, mc_skip = 0;
 	struct netlink_diag_req *req;
 	struct netlink_sock *nlsk;
 	struct sock *sk;
-	int ret = 0, num = 0, i;
+	int ret = 0, num = 0;
+	long i;
 
 	req = nlmsg_data(cb->nlh);
 
-	for (i = 0; i < htbl->size; i++) {
+	if (s_slot == NDIAG_MC_SLOT) {
+		mc_skip = s_num;
+		s_num = 0;
+	} else if ((s_slot || s_num) && cb->args[3] != htbl->hash_rnd) {
+		s_slot = 0;
+		s_num = total;
+		total = 0;
+	}
+
+	skip = s_num;
+	for (i = s_slot; i < htbl->size; i++) {
 		struct rhash_head *pos;
 
+		num = 0;
 		rht_for_each_entry_rcu(nlsk, pos, htbl, i, node) {
 			sk = (struct sock *)nlsk;
 
 			if (!net_eq(sock_net(sk), net))
 				continue;
-			if (num < s_num) {
+			if (skip) {
+				skip--;
 				num++;
+				total++;
 				continue;
 			}
 
-			if (sk_diag_fill(sk, skb, req,
-					 NETLINK_CB(cb->skb).portid,
-					 cb->nlh->nlmsg_seq,
-					 NLM_F_MULTI,
-					 sock_i_ino(sk)) < 0) {
+			if (netlink_diag_dump_one(sk, skb, cb, req)) {
 				ret = 1;
 				goto done;
 			}
 
 			num++;
+			total++;
 		}
 	}
 
+	i = NDIAG_MC_SLOT;
+	num = 0;
 	sk_for_each_bound(sk, &tbl->mc_list) {
 		if (sk_hashed(sk))
 			continue;
 		if (!net_eq(sock_net(sk), net))
 			continue;
-		if (num < s_num) {
+		if (num < mc_skip) {
 			num++;
 			continue;
 		}
 
-		if (sk_diag_fill(sk, skb, req,
-				 NETLINK_CB(cb->skb).portid,
-				 cb->nlh->nlmsg_seq,
-				 NLM_F_MULTI,
-				 sock_i_ino(sk)) < 0) {
+		if (netlink_diag_dump_one(sk, skb, cb, req)) {
 			ret = 1;
 			goto done;
 		}
@@ -162,6 +203,9 @@ static int __netlink_diag_dump(struct sk_buff *skb, struct netlink_callback *cb,
 done:
 	cb->args[0] = num;
 	cb->args[1] = protocol;
+	cb->args[2] = i;
+	cb->args[3] = htbl->hash_rnd;
+	cb->args[4] = total;
 
 	return ret;
 }
@@ -169,7 +213,6 @@ done:
 static int netlink_diag_dump(struct sk_buff *skb, struct netlink_callback *cb)
 {
 	struct netlink_diag_req *req;
-	int s_num = cb->args[0];
 
 	req = nlmsg_data(cb->nlh);
 
@@ -180,9 +223,11 @@ static int netlink_diag_dump(struct sk_buff *skb, struct netlink_callback *cb)
 		int i;
 
 		for (i = cb->args[1]; i < MAX_LINKS; i++) {
-			if (__netlink_diag_dump(skb, cb, i, s_num))
+			if (__netlink_diag_dump(skb, cb, i))
 				break;
-			s_num = 0;
+			cb->args[0] = 0;
+			cb->args[2] = 0;
+			cb->args[4] = 0;
 		}
 	} else {
 		if (req->sdiag_protocol >= MAX_LINKS) {
@@ -191,7 +236,7 @@ static int netlink_diag_dump(struct sk_buff *skb, struct netlink_callback *cb)
 			return -ENOENT;
 		}
 
-		__netlink_diag_dump(skb, cb, req->sdiag_protocol, s_num);
+		__netlink_diag_dump(skb, cb, req->sdiag_protocol);
 	}
 
 	read_unlock(&nl_table_lock);
@@ -185,12 +185,20 @@ out_nlmsg_trim:
 	return -EMSGSIZE;
 }
 
+/*
+ * A dump that doesn't fit keeps a reference on the socket it stopped at in
+ * cb->args[1] and resumes from there, rather than skipping the cb->args[0]
+ * sockets already dumped.  Skipping is only needed if that socket went
+ * away in the meantime.
+ */
 static int packet_diag_dump(struct sk_buff *skb, struct netlink_callback *cb)
 {
+	struct sock *cursor = (struct sock *)cb->args[1];
 	int num = 0, s_num = cb->args[0];
 	struct packet_diag_req *req;
 	struct net *net;
 	struct sock *sk;
+	unsigned long ino;
 	bool may_report_filterinfo;
 
 	net = sock_net(skb->sk);
@@ -198,19 +206,37 @@ static int packet_diag_dump(struct sk_buff *skb, struct netlink_callback *cb)
 	may_report_filterinfo = netlink_net_capable(cb->skb, CAP_NET_ADMIN);
 
 	mutex_lock(&net->packet.sklist_lock);
-	sk_for_each(sk, &net->packet.sklist) {
+	sk = sk_head(&net->packet.sklist);
+	if (cursor) {
+		/* the list holds its own reference on hashed sockets */
+		if (sk_hashed(cursor)) {
+			sk = cursor;
+			num = s_num;
+		}
+		cb->args[1] = 0;
+		sock_put(cursor);
+	}
+
+	sk_for_each_from(sk) {
 		if (!net_eq(sock_net(sk), net))
 			continue;
 		if (num < s_num)
 			goto next;
 
+		ino = sock_i_ino(sk);
+		if (req->pdiag_ino && req->pdiag_ino != ino)
+			goto next;
+
 		if (sk_diag_fill(sk, skb, req,
 				 may_report_filterinfo,
 				 sk_user_ns(NETLINK_CB(cb->skb).sk),
 				 NETLINK_CB(cb->skb).portid,
 				 cb->nlh->nlmsg_seq, NLM_F_MULTI,
-				 sock_i_ino(sk)) < 0)
+				 ino) < 0) {
+			sock_hold(sk);
+			cb->args[1] = (long)sk;
 			goto done;
+		}
 next:
 		num++;
 	}
@@ -221,6 +247,15 @@ done:
 	return skb->len;
 }
 
+static int packet_diag_dump_done(struct netlink_callback *cb)
+{
+	struct sock *cursor = (struct sock *)cb->args[1];
+
+	if (cursor)
+		sock_put(cursor);
+	return 0;
+}
+
 static int packet_diag_handler_dump(struct sk_buff *skb, struct nlmsghdr *h)
 {
 	int hdrlen = sizeof(struct packet_diag_req);
@@ -238,6 +273,7 @@ static int packet_diag_handler_dump(struct sk_buff *skb, struct nlmsghdr *h)
 	if (h->nlmsg_flags & NLM_F_DUMP) {
 		struct netlink_dump_control c = {
 			.dump = packet_diag_dump,
+			.done = packet_diag_dump_done,
 		};
 		return netlink_dump_start(net->diag_nlsk, skb, h, &c);
 	} else
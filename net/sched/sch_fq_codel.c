@@ -21,6 +21,7 @@
 #include <linux/jhash.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
+#include <linux/rtnetlink.h>
 #include <net/netlink.h>
 #include <net/pkt_sched.h>
 #include <net/codel.h>
@@ -39,8 +40,22 @@
  * head drops only.
  * ECN capability is on by default.
  * Low memory footprint (64 bytes per flow)
+ *
+ * All fq_codel qdiscs of a device, typically the per TX queue children
+ * of mq, charge one memory pool, so that the memory limit holds for the
+ * device as a whole while each TX queue keeps its own lock.
  */
 
+struct fq_codel_pool {
+	struct list_head	list;		/* in fq_codel_pools, RTNL */
+	const struct net_device	*dev;
+	unsigned int		refcnt;		/* RTNL */
+	u32			limit;		/* in bytes */
+	atomic_long_t		usage;		/* skb->truesize of all queues */
+};
+
+static LIST_HEAD(fq_codel_pools);
+
 struct fq_codel_flow {
 	struct sk_buff	  *head;
 	struct sk_buff	  *tail;
@@ -61,6 +76,10 @@ struct fq_codel_sched_data {
 	struct codel_stats cstats;
 	u32		drop_overlimit;
 	u32		new_flow_count;
+	u32		drop_batch_size;
+	u32		memory_usage;	/* our share of pool->usage */
+	u32		drop_overmemory;
+	struct fq_codel_pool *pool;
 
 	struct list_head new_flows;	/* list of new flows */
 	struct list_head old_flows;	/* list of old flows */
@@ -133,17 +152,39 @@ static inline void flow_queue_add(struct fq_codel_flow *flow,
 	skb->next = NULL;
 }
 
-static unsigned int fq_codel_drop(struct Qdisc *sch)
+static void fq_codel_mem_charge(struct fq_codel_sched_data *q,
+				unsigned int truesize)
+{
+	q->memory_usage += truesize;
+	atomic_long_add(truesize, &q->pool->usage);
+}
+
+static void fq_codel_mem_uncharge(struct fq_codel_sched_data *q,
+				  unsigned int truesize)
+{
+	q->memory_usage -= truesize;
+	atomic_long_sub(truesize, &q->pool->usage);
+}
+
+static bool fq_codel_mem_limited(const struct fq_codel_sched_data *q)
+{
+	return atomic_long_read(&q->pool->usage) > READ_ONCE(q->pool->limit);
+}
+
+static unsigned int fq_codel_drop(struct Qdisc *sch, unsigned int max_packets)
 {
 	struct fq_codel_sched_data *q = qdisc_priv(sch);
 	struct sk_buff *skb;
-	unsigned int maxbacklog = 0, idx = 0, i, len;
+	unsigned int maxbacklog = 0, idx = 0, i, len, threshold;
+	unsigned int mem = 0;
 	struct fq_codel_flow *flow;
 
-	/* Queue is full! Find the fat flow and drop packet from it.
+	/* Queue is full! Find the fat flow and drop packets from it.
 	 * This might sound expensive, but with 1024 flows, we scan
 	 * 4KB of memory, and we dont need to handle a complex tree
 	 * in fast path (packet queue/enqueue) with many cache misses.
+	 * To not do this scan for every packet, drop up to half of the
+	 * fat flow, at most max_packets, at once.
 	 */
 	for (i = 0; i < q->flows_cnt; i++) {
 		if (q->backlogs[i] > maxbacklog) {
@@ -151,15 +192,24 @@ static unsigned int fq_codel_drop(struct Qdisc *sch)
 			idx = i;
 		}
 	}
+	threshold = maxbacklog >> 1;
+
 	flow = &q->flows[idx];
-	skb = dequeue_head(flow);
-	len = qdisc_pkt_len(skb);
+	len = 0;
+	i = 0;
+	do {
+		skb = dequeue_head(flow);
+		len += qdisc_pkt_len(skb);
+		mem += skb->truesize;
+		kfree_skb(skb);
+	} while (++i < max_packets && len < threshold && flow->head);
+
+	flow->dropped += i;
 	q->backlogs[idx] -= len;
-	sch->q.qlen--;
-	qdisc_qstats_drop(sch);
-	qdisc_qstats_backlog_dec(sch, skb);
-	kfree_skb(skb);
-	flow->dropped++;
+	fq_codel_mem_uncharge(q, mem);
+	sch->qstats.drops += i;
+	sch->qstats.backlog -= len;
+	sch->q.qlen -= i;
 	return idx;
 }
 
@@ -168,16 +218,17 @@ static unsigned int fq_codel_qdisc_drop(struct Qdisc *sch)
 	unsigned int prev_backlog;
 
 	prev_backlog = sch->qstats.backlog;
-	fq_codel_drop(sch);
+	fq_codel_drop(sch, 1U);
 	return prev_backlog - sch->qstats.backlog;
 }
 
 static int fq_codel_enqueue(struct sk_buff *skb, struct Qdisc *sch)
 {
 	struct fq_codel_sched_data *q = qdisc_priv(sch);
-	unsigned int idx;
+	unsigned int idx, prev_qlen;
 	struct fq_codel_flow *flow;
 	int uninitialized_var(ret);
+	bool memory_limited;
 
 	idx = fq_codel_classify(skb, sch, &ret);
 	if (idx == 0) {
@@ -200,18 +251,29 @@ static int fq_codel_enqueue(struct sk_buff *skb, struct Qdisc *sch)
 		flow->deficit = q->quantum;
 		flow->dropped = 0;
 	}
-	if (++sch->q.qlen <= sch->limit)
+	fq_codel_mem_charge(q, skb->truesize);
+	memory_limited = fq_codel_mem_limited(q);
+	if (++sch->q.qlen <= sch->limit && !memory_limited)
 		return NET_XMIT_SUCCESS;
 
-	q->drop_overlimit++;
+	prev_qlen = sch->q.qlen;
+	ret = fq_codel_drop(sch, q->drop_batch_size);
+	prev_qlen -= sch->q.qlen;
+
+	q->drop_overlimit += prev_qlen;
+	if (memory_limited)
+		q->drop_overmemory += prev_qlen;
+
 	/* Return Congestion Notification only if we dropped a packet
-	 * from this flow.
+	 * from this flow, our parents then don't account for this one.
 	 */
-	if (fq_codel_drop(sch) == idx)
+	if (ret == idx) {
+		qdisc_tree_decrease_qlen(sch, prev_qlen - 1);
 		return NET_XMIT_CN;
+	}
 
-	/* As we dropped a packet, better let upper stack know this */
-	qdisc_tree_decrease_qlen(sch, 1);
+	/* As we dropped packets, better let upper stack know this */
+	qdisc_tree_decrease_qlen(sch, prev_qlen);
 	return NET_XMIT_SUCCESS;
 }
 
@@ -229,6 +291,7 @@ static struct sk_buff *dequeue(struct codel_vars *vars, struct Qdisc *sch)
 	if (flow->head) {
 		skb = dequeue_head(flow);
 		q->backlogs[flow - q->flows] -= qdisc_pkt_len(skb);
+		fq_codel_mem_uncharge(q, skb->truesize);
 		sch->q.qlen--;
 	}
 	return skb;
@@ -308,6 +371,8 @@ static void fq_codel_reset(struct Qdisc *sch)
 	}
 	memset(q->backlogs, 0, q->flows_cnt * sizeof(u32));
 	sch->q.qlen = 0;
+	if (q->pool)
+		fq_codel_mem_uncharge(q, q->memory_usage);
 }
 
 static const struct nla_policy fq_codel_policy[TCA_FQ_CODEL_MAX + 1] = {
@@ -318,8 +383,45 @@ static const struct nla_policy fq_codel_policy[TCA_FQ_CODEL_MAX + 1] = {
 	[TCA_FQ_CODEL_FLOWS]	= { .type = NLA_U32 },
 	[TCA_FQ_CODEL_QUANTUM]	= { .type = NLA_U32 },
 	[TCA_FQ_CODEL_CE_THRESHOLD] = { .type = NLA_U32 },
+	[TCA_FQ_CODEL_DROP_BATCH_SIZE] = { .type = NLA_U32 },
+	[TCA_FQ_CODEL_MEMORY_LIMIT] = { .type = NLA_U32 },
 };
 
+static struct fq_codel_pool *fq_codel_pool_get(const struct net_device *dev)
+{
+	struct fq_codel_pool *pool;
+
+	ASSERT_RTNL();
+	list_for_each_entry(pool, &fq_codel_pools, list) {
+		if (pool->dev == dev) {
+			pool->refcnt++;
+			return pool;
+		}
+	}
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return NULL;
+
+	pool->dev = dev;
+	pool->refcnt = 1;
+	pool->limit = 32 << 20; /* 32 MBytes */
+	atomic_long_set(&pool->usage, 0);
+	list_add(&pool->list, &fq_codel_pools);
+	return pool;
+}
+
+static void fq_codel_pool_put(struct fq_codel_pool *pool)
+{
+	ASSERT_RTNL();
+	if (--pool->refcnt)
+		return;
+
+	WARN_ON_ONCE(atomic_long_read(&pool->usage));
+	list_del(&pool->list);
+	kfree(pool);
+}
+
 static int fq_codel_change(struct Qdisc *sch, struct nlattr *opt)
 {
 	struct fq_codel_sched_data *q = qdisc_priv(sch);
@@ -369,7 +471,21 @@ static int fq_codel_change(struct Qdisc *sch, struct nlattr *opt)
 	if (tb[TCA_FQ_CODEL_QUANTUM])
 		q->quantum = max(256U, nla_get_u32(tb[TCA_FQ_CODEL_QUANTUM]));
 
-	while (sch->q.qlen > sch->limit) {
+	if (tb[TCA_FQ_CODEL_DROP_BATCH_SIZE]) {
+		u32 batch = nla_get_u32(tb[TCA_FQ_CODEL_DROP_BATCH_SIZE]);
+
+		q->drop_batch_size = max(1U, batch);
+	}
+
+	/* the limit is shared with the other fq_codel qdiscs of the device */
+	if (tb[TCA_FQ_CODEL_MEMORY_LIMIT]) {
+		u32 limit = nla_get_u32(tb[TCA_FQ_CODEL_MEMORY_LIMIT]);
+
+		WRITE_ONCE(q->pool->limit, min(1U << 31, limit));
+	}
+
+	while (sch->q.qlen > sch->limit ||
+	       q->memory_usage > READ_ONCE(q->pool->limit)) {
 		struct sk_buff *skb = fq_codel_dequeue(sch);
 
 		kfree_skb(skb);
@@ -403,15 +519,18 @@ static void fq_codel_destroy(struct Qdisc *sch)
 	tcf_destroy_chain(&q->filter_list);
 	fq_codel_free(q->backlogs);
 	fq_codel_free(q->flows);
+	if (q->pool)
+		fq_codel_pool_put(q->pool);
 }
 
 static int fq_codel_init(struct Qdisc *sch, struct nlattr *opt)
 {
 	struct fq_codel_sched_data *q = qdisc_priv(sch);
-	int i;
+	int i, err;
 
 	sch->limit = 10*1024;
 	q->flows_cnt = 1024;
+	q->drop_batch_size = 64;
 	q->quantum = psched_mtu(qdisc_dev(sch));
 	q->perturbation = prandom_u32();
 	INIT_LIST_HEAD(&q->new_flows);
@@ -420,21 +539,27 @@ static int fq_codel_init(struct Qdisc *sch, struct nlattr *opt)
 	codel_stats_init(&q->cstats);
 	q->cparams.ecn = true;
 
+	q->pool = fq_codel_pool_get(qdisc_dev(sch));
+	if (!q->pool)
+		return -ENOMEM;
+
 	if (opt) {
-		int err = fq_codel_change(sch, opt);
+		err = fq_codel_change(sch, opt);
 		if (err)
-			return err;
+			goto err_pool;
 	}
 
 	if (!q->flows) {
+		err = -ENOMEM;
 		q->flows = fq_codel_zalloc(q->flows_cnt *
 					   sizeof(struct fq_codel_flow));
 		if (!q->flows)
-			return -ENOMEM;
+			goto err_pool;
 		q->backlogs = fq_codel_zalloc(q->flows_cnt * sizeof(u32));
 		if (!q->backlogs) {
 			fq_codel_free(q->flows);
-			return -ENOMEM;
+			q->flows = NULL;
+			goto err_pool;
 		}
 		for (i = 0; i < q->flows_cnt; i++) {
 			struct fq_codel_flow *flow = q->flows + i;
@@ -448,6 +573,11 @@ static int fq_codel_init(struct Qdisc *sch, struct nlattr *opt)
 	else
 		sch->flags &= ~TCQ_F_CAN_BYPASS;
 	return 0;
+
+err_pool:
+	fq_codel_pool_put(q->pool);
+	q->pool = NULL;
+	return err;
 }
 
 static int fq_codel_dump(struct Qdisc *sch, struct sk_buff *skb)
@@ -470,7 +600,11 @@ static int fq_codel_dump(struct Qdisc *sch, struct sk_buff *skb)
 	    nla_put_u32(skb, TCA_FQ_CODEL_QUANTUM,
 			q->quantum) ||
 	    nla_put_u32(skb, TCA_FQ_CODEL_FLOWS,
-			q->flows_cnt))
+			q->flows_cnt) ||
+	    nla_put_u32(skb, TCA_FQ_CODEL_DROP_BATCH_SIZE,
+			q->drop_batch_size) ||
+	    nla_put_u32(skb, TCA_FQ_CODEL_MEMORY_LIMIT,
+			READ_ONCE(q->pool->limit)))
 		goto nla_put_failure;
 
 	if (q->cparams.ce_threshold != CODEL_DISABLED_THRESHOLD &&
@@ -497,6 +631,9 @@ static int fq_codel_dump_stats(struct Qdisc *sch, struct gnet_dump *d)
 	st.qdisc_stats.ecn_mark = q->cstats.ecn_mark;
 	st.qdisc_stats.new_flow_count = q->new_flow_count;
 	st.qdisc_stats.ce_mark = q->cstats.ce_mark;
+	st.qdisc_stats.memory_usage = min_t(unsigned long, U32_MAX,
+					    atomic_long_read(&q->pool->usage));
+	st.qdisc_stats.drop_overmemory = q->drop_overmemory;
 
 	list_for_each(pos, &q->new_flows)
 		st.qdisc_stats.new_flows_len++;
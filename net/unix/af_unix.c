@@ -1450,6 +1450,27 @@ static void maybe_add_creds(struct sk_buff *skb, const struct socket *sock,
 	}
 }
 
+/* Would an skb built from @scm by sendmsg() carry the creds of @skb? */
+static bool unix_skb_scm_eq(struct sk_buff *skb, const struct socket *sock,
+			    const struct sock *other, struct scm_cookie *scm)
+{
+	struct pid *pid = scm->pid;
+	kuid_t uid = scm->creds.uid;
+	kgid_t gid = scm->creds.gid;
+
+	if (!pid && (test_bit(SOCK_PASSCRED, &sock->flags) ||
+		     !other->sk_socket ||
+		     test_bit(SOCK_PASSCRED, &other->sk_socket->flags))) {
+		pid = task_tgid(current);
+		current_uid_gid(&uid, &gid);
+	}
+
+	return UNIXCB(skb).pid == pid &&
+	       uid_eq(UNIXCB(skb).uid, uid) &&
+	       gid_eq(UNIXCB(skb).gid, gid) &&
+	       unix_secdata_eq(scm, skb);
+}
+
 /*
  *	Send AF_UNIX data.
  */
@@ -1633,6 +1654,75 @@ out:
  */
 #define UNIX_SKB_FRAGS_SZ (PAGE_SIZE << get_order(32768))
 
+/* writes up to this size may be appended to the peer's last skb */
+#define UNIX_STREAM_COALESCE_MAX	1024
+
+/*
+ * Append a small write to the tail skb of the peer's receive queue if
+ * we queued it, it is linear and it has enough tailroom, which is common
+ * when a peer lags behind a stream of small writes.  Returns the number
+ * of bytes queued, 0 if a new skb is needed or a negative error.  If
+ * @room is set, the tail was ours but full: the next skb should leave
+ * room for more writes.
+ */
+static int unix_stream_coalesce(struct socket *sock, struct sock *other,
+				struct msghdr *msg, int size,
+				struct scm_cookie *scm, bool *room)
+{
+	struct unix_sock *ou = unix_sk(other);
+	struct sock *sk = sock->sk;
+	struct sk_buff *tail;
+	int err = 0;
+
+	/* readers copy out of queued skbs holding only the readlock; don't
+	 * wait for it, a new skb is cheaper than a sleeping sender
+	 */
+	if (!mutex_trylock(&ou->readlock))
+		return 0;
+
+	unix_state_lock(other);
+	tail = skb_peek_tail(&other->sk_receive_queue);
+	if (!tail || tail->sk != sk || skb_is_nonlinear(tail) ||
+	    UNIXCB(tail).fp || !unix_skb_scm_eq(tail, sock, other, scm)) {
+		unix_state_unlock(other);
+		goto out;
+	}
+	*room = true;
+	if (skb_tailroom(tail) < size) {
+		unix_state_unlock(other);
+		goto out;
+	}
+	/* unix_release_sock() purges the queue without the readlock */
+	skb_get(tail);
+	unix_state_unlock(other);
+
+	/* nobody else touches the tailroom while we hold the readlock */
+	if (copy_from_iter(skb_tail_pointer(tail), size,
+			   &msg->msg_iter) != size) {
+		err = -EFAULT;
+		goto out_put;
+	}
+
+	unix_state_lock(other);
+	if (sock_flag(other, SOCK_DEAD) ||
+	    (other->sk_shutdown & RCV_SHUTDOWN)) {
+		unix_state_unlock(other);
+		err = -EPIPE;
+		goto out_put;
+	}
+	skb_put(tail, size);
+	unix_state_unlock(other);
+	err = size;
+
+out_put:
+	kfree_skb(tail);
+out:
+	mutex_unlock(&ou->readlock);
+	if (err > 0)
+		other->sk_data_ready(other);
+	return err;
+}
+
 static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 			       size_t len)
 {
@@ -1643,8 +1733,10 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 	int sent = 0;
 	struct scm_cookie scm;
 	bool fds_sent = false;
+	bool room = false;
 	int max_level;
 	int data_len;
+	int linear;
 
 	wait_for_unix_gc();
 	err = scm_send(sock, msg, &scm, false);
@@ -1671,6 +1763,19 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 	while (sent < len) {
 		size = len - sent;
 
+		if (size <= UNIX_STREAM_COALESCE_MAX && !scm.fp) {
+			err = unix_stream_coalesce(sock, other, msg, size,
+						   &scm, &room);
+			if (err == -EPIPE)
+				goto pipe_err;
+			if (err < 0)
+				goto out_err;
+			if (err > 0) {
+				sent += err;
+				continue;
+			}
+		}
+
 		/* Keep two messages in the pipe so it schedules better */
 		size = min_t(int, size, (sk->sk_sndbuf >> 1) - 64);
 
@@ -1681,7 +1786,14 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 
 		data_len = min_t(size_t, size, PAGE_ALIGN(data_len));
 
-		skb = sock_alloc_send_pskb(sk, size - data_len, data_len,
+		/* the peer lags behind, let the next writes join this skb */
+		linear = size - data_len;
+		if (room && !data_len)
+			linear = max_t(int, linear,
+				       min_t(int, SKB_MAX_HEAD(0),
+					     (sk->sk_sndbuf >> 1) - 64));
+
+		skb = sock_alloc_send_pskb(sk, linear, data_len,
 					   msg->msg_flags & MSG_DONTWAIT, &err,
 					   get_order(UNIX_SKB_FRAGS_SZ));
 		if (!skb)
@@ -2011,6 +2123,35 @@ static unsigned int unix_skb_len(const struct sk_buff *skb)
 	return skb->len - UNIXCB(skb).consumed;
 }
 
+/* fully read skbs left on the queue before they are unlinked at once */
+#define UNIX_STREAM_UNLINK_BATCH	16
+
+/*
+ * Move the first *@nr skbs of the receive queue, which the caller holding
+ * the readlock has fully read, to @list with a single queue lock round
+ * trip.  Must run before the readlock is released.
+ */
+static void unix_stream_unlink_consumed(struct sock *sk,
+					struct sk_buff_head *list, int *nr)
+{
+	struct sk_buff_head *queue = &sk->sk_receive_queue;
+	unsigned long flags;
+
+	spin_lock_irqsave(&queue->lock, flags);
+	while ((*nr)--)
+		__skb_queue_tail(list, __skb_dequeue(queue));
+	spin_unlock_irqrestore(&queue->lock, flags);
+	*nr = 0;
+}
+
+static void unix_stream_free_consumed(struct sk_buff_head *list)
+{
+	struct sk_buff *skb;
+
+	while ((skb = __skb_dequeue(list)) != NULL)
+		consume_skb(skb);
+}
+
 struct unix_stream_read_state {
 	int (*recv_actor)(struct sk_buff *, int, int,
 			  struct unix_stream_read_state *);
@@ -2038,6 +2179,9 @@ static int unix_stream_read_generic(struct unix_stream_read_state *state)
 	int skip;
 	size_t size = state->size;
 	unsigned int last_len;
+	struct sk_buff_head consumed;
+	struct sk_buff *consumed_tail = NULL;
+	int nr_consumed = 0;
 
 	err = -EINVAL;
 	if (sk->sk_state != TCP_ESTABLISHED)
@@ -2051,6 +2195,7 @@ static int unix_stream_read_generic(struct unix_stream_read_state *state)
 	timeo = sock_rcvtimeo(sk, noblock);
 
 	memset(&scm, 0, sizeof(scm));
+	__skb_queue_head_init(&consumed);
 
 	/* Lock the socket to prevent queue disordering
 	 * while sleeps in memcpy_tomsg
@@ -2073,11 +2218,21 @@ static int unix_stream_read_generic(struct unix_stream_read_state *state)
 			err = -ECONNRESET;
 			goto unlock;
 		}
-		last = skb = skb_peek(&sk->sk_receive_queue);
+		if (consumed_tail)
+			skb = skb_peek_next(consumed_tail,
+					    &sk->sk_receive_queue);
+		else
+			skb = skb_peek(&sk->sk_receive_queue);
+		last = skb;
 		last_len = last ? last->len : 0;
 again:
 		if (skb == NULL) {
 			unix_sk(sk)->recursion_level = 0;
+			if (nr_consumed) {
+				unix_stream_unlink_consumed(sk, &consumed,
+							    &nr_consumed);
+				consumed_tail = NULL;
+			}
 			if (copied >= target)
 				goto unlock;
 
@@ -2096,6 +2251,8 @@ again:
 			if (!timeo)
 				break;
 			mutex_unlock(&u->readlock);
+			/* senders may be waiting for this memory */
+			unix_stream_free_consumed(&consumed);
 
 			timeo = unix_stream_data_wait(sk, timeo, last,
 						      last_len);
@@ -2168,8 +2325,13 @@ unlock:
 			if (unix_skb_len(skb))
 				break;
 
-			skb_unlink(skb, &sk->sk_receive_queue);
-			consume_skb(skb);
+			consumed_tail = skb;
+			if (++nr_consumed == UNIX_STREAM_UNLINK_BATCH) {
+				unix_stream_unlink_consumed(sk, &consumed,
+							    &nr_consumed);
+				consumed_tail = NULL;
+				unix_stream_free_consumed(&consumed);
+			}
 
 			if (scm.fp)
 				break;
@@ -2198,7 +2360,10 @@ unlock:
 		}
 	} while (size);
 
+	if (nr_consumed)
+		unix_stream_unlink_consumed(sk, &consumed, &nr_consumed);
 	mutex_unlock(&u->readlock);
+	unix_stream_free_consumed(&consumed);
 	if (state->msg)
 		scm_recv(sock, state->msg, &scm, flags);
 	else
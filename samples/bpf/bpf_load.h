@@ -24,4 +24,7 @@ int load_bpf_file(char *path);
 
 void read_trace_pipe(void);
 
+/* attach the XDP program @fd to the device @ifindex, -1 detaches it */
+int set_link_xdp_fd(int ifindex, int fd);
+
 #endif
@@ -0,0 +1,51 @@
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ */
+#include <uapi/linux/bpf.h>
+#include <uapi/linux/if_ether.h>
+#include <uapi/linux/in.h>
+#include <uapi/linux/ip.h>
+#include "bpf_helpers.h"
+
+struct gre_base_hdr {
+	__be16 flags;
+	__be16 protocol;
+};
+
+/* Picks the PACKET_FANOUT_EBPF member of a packet, the kernel takes the
+ * return value modulo the number of members.  The demux runs before
+ * af_packet pushes the link layer header, so offset 0 is the network
+ * header.  IPIP and plain GRE packets are steered by their inner
+ * addresses so that every tunnelled flow sticks to one worker.
+ */
+SEC("socket")
+int fanout_prog(struct __sk_buff *skb)
+{
+	struct gre_base_hdr greh = {};
+	struct iphdr iph = {};
+	int off;
+
+	if (skb->protocol != __constant_htons(ETH_P_IP))
+		return 0;
+	if (bpf_skb_load_bytes(skb, 0, &iph, sizeof(iph)))
+		return 0;
+
+	off = iph.ihl * 4;
+	if (iph.protocol == IPPROTO_GRE) {
+		if (bpf_skb_load_bytes(skb, off, &greh, sizeof(greh)) ||
+		    greh.flags ||
+		    greh.protocol != __constant_htons(ETH_P_IP))
+			goto outer;
+		off += sizeof(greh);
+	} else if (iph.protocol != IPPROTO_IPIP) {
+		goto outer;
+	}
+
+	/* on failure iph still holds the outer header */
+	bpf_skb_load_bytes(skb, off, &iph, sizeof(iph));
+outer:
+	/* symmetric, both directions of a flow land on the same member */
+	return iph.saddr ^ iph.daddr;
+}
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,78 @@
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/bpf.h>
+#include <linux/if_packet.h>
+#include <sys/socket.h>
+#include "libbpf.h"
+#include "bpf_load.h"
+
+#define NUM_SOCKS	8
+#define FANOUT_ID	0x5eed
+
+/* Spreads the packets of an interface over NUM_SOCKS sockets of a
+ * PACKET_FANOUT_EBPF group and shows how many each one gets.
+ */
+int main(int argc, char **argv)
+{
+	const char *ifname = argc > 1 ? argv[1] : "lo";
+	struct pollfd pfd[NUM_SOCKS];
+	long long cnt[NUM_SOCKS] = {};
+	int i, val, secs = 5;
+	char filename[256];
+	char buf[2048];
+	FILE *f;
+
+	snprintf(filename, sizeof(filename), "%s_kern.o", argv[0]);
+
+	if (load_bpf_file(filename)) {
+		printf("%s", bpf_log_buf);
+		return 1;
+	}
+
+	val = FANOUT_ID | (PACKET_FANOUT_EBPF << 16);
+	for (i = 0; i < NUM_SOCKS; i++) {
+		pfd[i].fd = open_raw_sock(ifname);
+		assert(pfd[i].fd >= 0);
+		pfd[i].events = POLLIN;
+		assert(setsockopt(pfd[i].fd, SOL_PACKET, PACKET_FANOUT,
+				  &val, sizeof(val)) == 0);
+	}
+
+	/* the program belongs to the group, setting it once is enough */
+	assert(setsockopt(pfd[0].fd, SOL_PACKET, PACKET_FANOUT_DATA,
+			  prog_fd, sizeof(prog_fd[0])) == 0);
+
+	f = popen("ping -c5 -i0.2 localhost", "r");
+	assert(f);
+
+	while (secs--) {
+		time_t end = time(NULL) + 1;
+
+		while (time(NULL) < end) {
+			if (poll(pfd, NUM_SOCKS, 100) <= 0)
+				continue;
+			for (i = 0; i < NUM_SOCKS; i++)
+				while (recv(pfd[i].fd, buf, sizeof(buf), 0) > 0)
+					cnt[i]++;
+		}
+
+		for (i = 0; i < NUM_SOCKS; i++)
+			printf("%s%lld", i ? " " : "", cnt[i]);
+		printf(" packets per socket\n");
+	}
+
+	pclose(f);
+	for (i = 0; i < NUM_SOCKS; i++)
+		close(pfd[i].fd);
+
+	return 0;
+}
@@ -19,13 +19,14 @@ static __u64 ptr_to_u64(void *ptr)
 }
 
 int bpf_create_map(enum bpf_map_type map_type, int key_size, int value_size,
-		   int max_entries)
+		   int max_entries, int map_flags)
 {
 	union bpf_attr attr = {
 		.map_type = map_type,
 		.key_size = key_size,
 		.value_size = value_size,
-		.max_entries = max_entries
+		.max_entries = max_entries,
+		.map_flags = map_flags,
 	};
 
 	return syscall(__NR_bpf, BPF_MAP_CREATE, &attr, sizeof(attr));
@@ -75,6 +76,53 @@ int bpf_get_next_key(int fd, void *key, void *next_key)
 	return syscall(__NR_bpf, BPF_MAP_GET_NEXT_KEY, &attr, sizeof(attr));
 }
 
+static int bpf_map_batch(int cmd, int fd, void *in_batch, void *out_batch,
+			 void *keys, void *values, unsigned int *count,
+			 unsigned long long elem_flags)
+{
+	union bpf_attr attr = {
+		.batch.map_fd = fd,
+		.batch.in_batch = ptr_to_u64(in_batch),
+		.batch.out_batch = ptr_to_u64(out_batch),
+		.batch.keys = ptr_to_u64(keys),
+		.batch.values = ptr_to_u64(values),
+		.batch.count = *count,
+		.batch.elem_flags = elem_flags,
+	};
+	int ret;
+
+	ret = syscall(__NR_bpf, cmd, &attr, sizeof(attr));
+	*count = attr.batch.count;
+	return ret;
+}
+
+int bpf_lookup_batch(int fd, void *in_batch, void *out_batch, void *keys,
+		     void *values, unsigned int *count)
+{
+	return bpf_map_batch(BPF_MAP_LOOKUP_BATCH, fd, in_batch, out_batch,
+			     keys, values, count, 0);
+}
+
+int bpf_lookup_and_delete_batch(int fd, void *in_batch, void *out_batch,
+				void *keys, void *values, unsigned int *count)
+{
+	return bpf_map_batch(BPF_MAP_LOOKUP_AND_DELETE_BATCH, fd, in_batch,
+			     out_batch, keys, values, count, 0);
+}
+
+int bpf_update_batch(int fd, void *keys, void *values, unsigned int *count,
+		     unsigned long long flags)
+{
+	return bpf_map_batch(BPF_MAP_UPDATE_BATCH, fd, NULL, NULL, keys,
+			     values, count, flags);
+}
+
+int bpf_delete_batch(int fd, void *keys, unsigned int *count)
+{
+	return bpf_map_batch(BPF_MAP_DELETE_BATCH, fd, NULL, NULL, keys, NULL,
+			     count, 0);
+}
+
 #define ROUND_UP(x, n) (((x) + (n) - 1u) & ~((n) - 1u))
 
 char bpf_log_buf[LOG_BUF_SIZE];
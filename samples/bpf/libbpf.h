@@ -5,11 +5,18 @@
 struct bpf_insn;
 
 int bpf_create_map(enum bpf_map_type map_type, int key_size, int value_size,
-		   int max_entries);
+		   int max_entries, int map_flags);
 int bpf_update_elem(int fd, void *key, void *value, unsigned long long flags);
 int bpf_lookup_elem(int fd, void *key, void *value);
 int bpf_delete_elem(int fd, void *key);
 int bpf_get_next_key(int fd, void *key, void *next_key);
+int bpf_lookup_batch(int fd, void *in_batch, void *out_batch, void *keys,
+		     void *values, unsigned int *count);
+int bpf_lookup_and_delete_batch(int fd, void *in_batch, void *out_batch,
+				void *keys, void *values, unsigned int *count);
+int bpf_update_batch(int fd, void *keys, void *values, unsigned int *count,
+		     unsigned long long flags);
+int bpf_delete_batch(int fd, void *keys, unsigned int *count);
 
 int bpf_prog_load(enum bpf_prog_type prog_type,
 		  const struct bpf_insn *insns, int insn_len,
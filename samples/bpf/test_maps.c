@@ -15,15 +15,20 @@
 #include <assert.h>
 #include <sys/wait.h>
 #include <stdlib.h>
+#include <sys/sysinfo.h>
 #include "libbpf.h"
 
+static int nr_cpus;
+static int map_flags;
+
 /* sanity tests for map API */
 static void test_hashmap_sanity(int i, void *data)
 {
 	long long key, next_key, value;
 	int map_fd;
 
-	map_fd = bpf_create_map(BPF_MAP_TYPE_HASH, sizeof(key), sizeof(value), 2);
+	map_fd = bpf_create_map(BPF_MAP_TYPE_HASH, sizeof(key), sizeof(value),
+				2, map_flags);
 	if (map_fd < 0) {
 		printf("failed to create hashmap '%s'\n", strerror(errno));
 		exit(1);
@@ -64,7 +69,14 @@ static void test_hashmap_sanity(int i, void *data)
 	assert(bpf_update_elem(map_fd, &key, &value, BPF_NOEXIST) == -1 &&
 	       errno == E2BIG);
 
+	/* replacing an existing element still works in a full map */
+	key = 1;
+	value = 1234;
+	assert(bpf_update_elem(map_fd, &key, &value, BPF_EXIST) == 0);
+	assert(bpf_lookup_elem(map_fd, &key, &value) == 0 && value == 1234);
+
 	/* check that key = 0 doesn't exist */
+	key = 0;
 	assert(bpf_delete_elem(map_fd, &key) == -1 && errno == ENOENT);
 
 	/* iterate over two elements */
@@ -94,7 +106,8 @@ static void test_arraymap_sanity(int i, void *data)
 	int key, next_key, map_fd;
 	long long value;
 
-	map_fd = bpf_create_map(BPF_MAP_TYPE_ARRAY, sizeof(key), sizeof(value), 2);
+	map_fd = bpf_create_map(BPF_MAP_TYPE_ARRAY, sizeof(key), sizeof(value),
+				2, 0);
 	if (map_fd < 0) {
 		printf("failed to create arraymap '%s'\n", strerror(errno));
 		exit(1);
@@ -142,6 +155,276 @@ static void test_arraymap_sanity(int i, void *data)
 	close(map_fd);
 }
 
+static void test_percpu_hashmap_sanity(int task, void *data)
+{
+	long long key, next_key;
+	int expected_key_mask = 0;
+	long long value[nr_cpus];
+	int map_fd, i;
+
+	map_fd = bpf_create_map(BPF_MAP_TYPE_PERCPU_HASH, sizeof(key),
+				sizeof(value[0]), 2, map_flags);
+	if (map_fd < 0) {
+		printf("failed to create hashmap '%s'\n", strerror(errno));
+		exit(1);
+	}
+
+	for (i = 0; i < nr_cpus; i++)
+		value[i] = i + 100;
+	key = 1;
+	/* insert key=1 element */
+	assert(!(expected_key_mask & key));
+	assert(bpf_update_elem(map_fd, &key, value, BPF_ANY) == 0);
+	expected_key_mask |= key;
+
+	/* BPF_NOEXIST means: add new element if it doesn't exist */
+	assert(bpf_update_elem(map_fd, &key, value, BPF_NOEXIST) == -1 &&
+	       /* key=1 already exists */
+	       errno == EEXIST);
+
+	/* -1 is an invalid flag */
+	assert(bpf_update_elem(map_fd, &key, value, -1) == -1 &&
+	       errno == EINVAL);
+
+	/* check that key=1 can be found and returns the values of all cpus */
+	value[0] = 1;
+	assert(bpf_lookup_elem(map_fd, &key, value) == 0 && value[0] == 100);
+
+	key = 2;
+	/* check that key=2 is not found */
+	assert(bpf_lookup_elem(map_fd, &key, value) == -1 && errno == ENOENT);
+
+	/* BPF_EXIST means: update existing element */
+	assert(bpf_update_elem(map_fd, &key, value, BPF_EXIST) == -1 &&
+	       /* key=2 is not there */
+	       errno == ENOENT);
+
+	/* insert key=2 element */
+	assert(!(expected_key_mask & key));
+	assert(bpf_update_elem(map_fd, &key, value, BPF_NOEXIST) == 0);
+	expected_key_mask |= key;
+
+	/* key=1 and key=2 were inserted, check that key=0 cannot be inserted
+	 * due to max_entries limit
+	 */
+	key = 0;
+	assert(bpf_update_elem(map_fd, &key, value, BPF_NOEXIST) == -1 &&
+	       errno == E2BIG);
+
+	/* check that key = 0 doesn't exist */
+	assert(bpf_delete_elem(map_fd, &key) == -1 && errno == ENOENT);
+
+	/* iterate over two elements */
+	while (!bpf_get_next_key(map_fd, &key, &next_key)) {
+		assert((expected_key_mask & next_key) == next_key);
+		expected_key_mask &= ~next_key;
+
+		assert(bpf_lookup_elem(map_fd, &next_key, value) == 0);
+		for (i = 0; i < nr_cpus; i++)
+			assert(value[i] == i + 100);
+
+		key = next_key;
+	}
+	assert(errno == ENOENT);
+
+	/* Update with BPF_EXIST */
+	key = 1;
+	assert(bpf_update_elem(map_fd, &key, value, BPF_EXIST) == 0);
+
+	/* delete both elements */
+	key = 1;
+	assert(bpf_delete_elem(map_fd, &key) == 0);
+	key = 2;
+	assert(bpf_delete_elem(map_fd, &key) == 0);
+	assert(bpf_delete_elem(map_fd, &key) == -1 && errno == ENOENT);
+
+	key = 0;
+	/* check that map is empty */
+	assert(bpf_get_next_key(map_fd, &key, &next_key) == -1 &&
+	       errno == ENOENT);
+	close(map_fd);
+}
+
+static void test_arraymap_percpu_sanity(int i, void *data)
+{
+	long long values[nr_cpus];
+	int key, next_key, map_fd;
+
+	map_fd = bpf_create_map(BPF_MAP_TYPE_PERCPU_ARRAY, sizeof(key),
+				sizeof(values[0]), 2, 0);
+	if (map_fd < 0) {
+		printf("failed to create arraymap '%s'\n", strerror(errno));
+		exit(1);
+	}
+
+	for (i = 0; i < nr_cpus; i++)
+		values[i] = i + 100;
+
+	key = 1;
+	/* insert key=1 element */
+	assert(bpf_update_elem(map_fd, &key, values, BPF_ANY) == 0);
+
+	values[0] = 0;
+	assert(bpf_update_elem(map_fd, &key, values, BPF_NOEXIST) == -1 &&
+	       errno == EEXIST);
+
+	/* check that key=1 can be found */
+	assert(bpf_lookup_elem(map_fd, &key, values) == 0 && values[0] == 100);
+
+	key = 0;
+	/* check that key=0 is also found and zero initialized */
+	assert(bpf_lookup_elem(map_fd, &key, values) == 0 &&
+	       values[0] == 0 && values[nr_cpus - 1] == 0);
+
+	/* check that key=2 cannot be inserted due to max_entries limit */
+	key = 2;
+	assert(bpf_update_elem(map_fd, &key, values, BPF_EXIST) == -1 &&
+	       errno == E2BIG);
+
+	/* check that key = 2 doesn't exist */
+	assert(bpf_lookup_elem(map_fd, &key, values) == -1 && errno == ENOENT);
+
+	/* iterate over two elements */
+	assert(bpf_get_next_key(map_fd, &key, &next_key) == 0 &&
+	       next_key == 0);
+	assert(bpf_get_next_key(map_fd, &next_key, &next_key) == 0 &&
+	       next_key == 1);
+	assert(bpf_get_next_key(map_fd, &next_key, &next_key) == -1 &&
+	       errno == ENOENT);
+
+	/* delete shouldn't succeed */
+	key = 1;
+	assert(bpf_delete_elem(map_fd, &key) == -1 && errno == EINVAL);
+
+	close(map_fd);
+}
+
+#define BATCH_MAP_SIZE 1000
+#define BATCH_SIZE 64
+static void test_hashmap_batch(void)
+{
+	long long keys[BATCH_MAP_SIZE], values[BATCH_MAP_SIZE];
+	unsigned int count, total, batch, i;
+	char seen[BATCH_MAP_SIZE] = {};
+	long long key, next_key;
+	int map_fd, err;
+
+	map_fd = bpf_create_map(BPF_MAP_TYPE_HASH, sizeof(key),
+				sizeof(values[0]), BATCH_MAP_SIZE, map_flags);
+	if (map_fd < 0) {
+		printf("failed to create hashmap '%s'\n", strerror(errno));
+		exit(1);
+	}
+
+	for (i = 0; i < BATCH_MAP_SIZE; i++) {
+		keys[i] = i;
+		values[i] = i * 2;
+	}
+	count = BATCH_MAP_SIZE;
+	assert(bpf_update_batch(map_fd, keys, values, &count,
+				BPF_NOEXIST) == 0 && count == BATCH_MAP_SIZE);
+
+	/* all keys exist now, so the first update fails */
+	count = BATCH_MAP_SIZE;
+	assert(bpf_update_batch(map_fd, keys, values, &count,
+				BPF_NOEXIST) == -1 && errno == EEXIST && count == 0);
+
+	/* walk the map in chunks, resuming from the returned position */
+	total = 0;
+	do {
+		count = BATCH_SIZE;
+		err = bpf_lookup_batch(map_fd, total ? &batch : NULL, &batch,
+				       keys + total, values + total, &count);
+		assert(err == 0 || errno == ENOENT);
+		assert(count <= BATCH_SIZE);
+		total += count;
+	} while (!err);
+	assert(total == BATCH_MAP_SIZE);
+
+	for (i = 0; i < BATCH_MAP_SIZE; i++) {
+		assert(keys[i] >= 0 && keys[i] < BATCH_MAP_SIZE);
+		assert(!seen[keys[i]] && values[i] == keys[i] * 2);
+		seen[keys[i]] = 1;
+	}
+
+	/* delete half of the elements by key */
+	for (i = 0; i < BATCH_MAP_SIZE / 2; i++)
+		keys[i] = i;
+	count = BATCH_MAP_SIZE / 2;
+	assert(bpf_delete_batch(map_fd, keys, &count) == 0 &&
+	       count == BATCH_MAP_SIZE / 2);
+	count = 1;
+	assert(bpf_delete_batch(map_fd, keys, &count) == -1 &&
+	       errno == ENOENT && count == 0);
+
+	/* drain the rest */
+	total = 0;
+	do {
+		count = BATCH_SIZE;
+		err = bpf_lookup_and_delete_batch(map_fd, total ? &batch : NULL,
+						  &batch, keys + total,
+						  values + total, &count);
+		assert(err == 0 || errno == ENOENT);
+		total += count;
+	} while (!err);
+	assert(total == BATCH_MAP_SIZE / 2);
+
+	for (i = 0; i < total; i++)
+		assert(keys[i] >= BATCH_MAP_SIZE / 2 &&
+		       values[i] == keys[i] * 2);
+
+	key = -1;
+	/* check that map is empty */
+	assert(bpf_get_next_key(map_fd, &key, &next_key) == -1 &&
+	       errno == ENOENT);
+	close(map_fd);
+}
+
+static void test_arraymap_percpu_batch(void)
+{
+	long long values[BATCH_SIZE * nr_cpus];
+	unsigned int count, total = 0, batch;
+	int keys[BATCH_SIZE], map_fd, i, j, err;
+
+	map_fd = bpf_create_map(BPF_MAP_TYPE_PERCPU_ARRAY, sizeof(keys[0]),
+				sizeof(values[0]), BATCH_SIZE * 3 / 2, 0);
+	if (map_fd < 0) {
+		printf("failed to create arraymap '%s'\n", strerror(errno));
+		exit(1);
+	}
+
+	for (i = 0; i < BATCH_SIZE; i++) {
+		keys[i] = i;
+		for (j = 0; j < nr_cpus; j++)
+			values[i * nr_cpus + j] = i + j;
+	}
+	count = BATCH_SIZE;
+	assert(bpf_update_batch(map_fd, keys, values, &count, BPF_ANY) == 0 &&
+	       count == BATCH_SIZE);
+
+	do {
+		count = BATCH_SIZE;
+		err = bpf_lookup_batch(map_fd, total ? &batch : NULL, &batch,
+				       keys, values, &count);
+		assert(err == 0 || errno == ENOENT);
+
+		for (i = 0; i < count; i++) {
+			assert(keys[i] == total + i);
+			for (j = 0; j < nr_cpus; j++)
+				assert(values[i * nr_cpus + j] ==
+				       (keys[i] < BATCH_SIZE ? keys[i] + j : 0));
+		}
+		total += count;
+	} while (!err);
+	assert(total == BATCH_SIZE * 3 / 2);
+
+	/* array elements cannot be deleted */
+	count = 1;
+	assert(bpf_delete_batch(map_fd, keys, &count) == -1 &&
+	       errno == EOPNOTSUPP);
+	close(map_fd);
+}
+
 #define MAP_SIZE (32 * 1024)
 static void test_map_large(void)
 {
@@ -154,7 +437,7 @@ static void test_map_large(void)
 
 	/* allocate 4Mbyte of memory */
 	map_fd = bpf_create_map(BPF_MAP_TYPE_HASH, sizeof(key), sizeof(value),
-				MAP_SIZE);
+				MAP_SIZE, map_flags);
 	if (map_fd < 0) {
 		printf("failed to create large map '%s'\n", strerror(errno));
 		exit(1);
@@ -209,7 +492,9 @@ static void run_parallel(int tasks, void (*fn)(int i, void *data), void *data)
 static void test_map_stress(void)
 {
 	run_parallel(100, test_hashmap_sanity, NULL);
+	run_parallel(100, test_percpu_hashmap_sanity, NULL);
 	run_parallel(100, test_arraymap_sanity, NULL);
+	run_parallel(100, test_arraymap_percpu_sanity, NULL);
 }
 
 #define TASKS 1024
@@ -237,7 +522,7 @@ static void test_map_parallel(void)
 	int data[2];
 
 	map_fd = bpf_create_map(BPF_MAP_TYPE_HASH, sizeof(key), sizeof(value),
-				MAP_SIZE);
+				MAP_SIZE, map_flags);
 	if (map_fd < 0) {
 		printf("failed to create map for parallel test '%s'\n",
 		       strerror(errno));
@@ -279,13 +564,31 @@ static void test_map_parallel(void)
 	assert(bpf_get_next_key(map_fd, &key, &key) == -1 && errno == ENOENT);
 }
 
-int main(void)
+static void run_all_tests(void)
 {
 	test_hashmap_sanity(0, NULL);
+	test_percpu_hashmap_sanity(0, NULL);
 	test_arraymap_sanity(0, NULL);
+	test_arraymap_percpu_sanity(0, NULL);
+	test_hashmap_batch();
+	test_arraymap_percpu_batch();
 	test_map_large();
 	test_map_parallel();
 	test_map_stress();
+}
+
+int main(void)
+{
+	nr_cpus = get_nprocs_conf();
+
+	/* preallocated hash map elements */
+	map_flags = 0;
+	run_all_tests();
+
+	/* hash map elements allocated on demand */
+	map_flags = BPF_F_NO_PREALLOC;
+	run_all_tests();
+
 	printf("test_maps: OK\n");
 	return 0;
 }
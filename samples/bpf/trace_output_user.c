@@ -0,0 +1,224 @@
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <assert.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <linux/perf_event.h>
+#include <linux/bpf.h>
+#include "libbpf.h"
+#include "bpf_load.h"
+
+#define MAX_CPUS 64
+#define MAX_CNT 100000ll
+
+static int pmu_fd[MAX_CPUS];
+static void *header[MAX_CPUS];
+static int page_size;
+static int page_cnt = 8;
+static pid_t child_pid;
+static long long cnt;
+
+struct perf_event_sample {
+	struct perf_event_header header;
+	__u32 size;
+	char data[];
+};
+
+static int perf_event_mmap(int fd, void **base)
+{
+	int mmap_size = page_size * (page_cnt + 1);
+
+	*base = mmap(NULL, mmap_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		     fd, 0);
+	if (*base == MAP_FAILED) {
+		printf("mmap err\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void print_bpf_output(void *data, int size)
+{
+	struct {
+		__u64 pid;
+		__u64 cookie;
+	} *e = data;
+
+	/* the raw record is padded to keep the ring u64 aligned */
+	assert(size >= sizeof(*e));
+	if (e->cookie != 0x12345678) {
+		printf("BUG pid %llx cookie %llx sized %d\n",
+		       e->pid, e->cookie, size);
+		kill(0, SIGINT);
+		exit(1);
+	}
+
+	if ((__u32) e->pid == child_pid)
+		cnt++;
+}
+
+/* consume all records between data_tail and data_head */
+static void perf_event_read(struct perf_event_mmap_page *header)
+{
+	__u64 buffer_size = page_cnt * page_size;
+	__u64 data_head = header->data_head;
+	__u64 data_tail = header->data_tail;
+	void *base, *begin, *end;
+	static char buf[4096];
+
+	asm volatile("" ::: "memory"); /* in real code it should be smp_rmb() */
+	if (data_head == data_tail)
+		return;
+
+	base = ((char *)header) + page_size;
+
+	begin = base + data_tail % buffer_size;
+	end = base + data_head % buffer_size;
+
+	while (begin != end) {
+		struct perf_event_sample *e = begin;
+
+		if (begin + e->header.size > base + buffer_size) {
+			/* the record wraps around the end of the ring */
+			long len = base + buffer_size - begin;
+
+			assert(e->header.size <= sizeof(buf));
+			memcpy(buf, begin, len);
+			memcpy(buf + len, base, e->header.size - len);
+			e = (void *) buf;
+			begin = base + e->header.size - len;
+		} else if (begin + e->header.size == base + buffer_size) {
+			begin = base;
+		} else {
+			begin += e->header.size;
+		}
+
+		if (e->header.type == PERF_RECORD_SAMPLE) {
+			print_bpf_output(e->data, e->size);
+		} else if (e->header.type == PERF_RECORD_LOST) {
+			struct {
+				struct perf_event_header header;
+				__u64 id;
+				__u64 lost;
+			} *lost = (void *) e;
+			printf("lost %lld events\n", lost->lost);
+		} else {
+			printf("unknown event type=%d size=%d\n",
+			       e->header.type, e->header.size);
+		}
+	}
+
+	__sync_synchronize(); /* smp_mb() */
+	header->data_tail = data_head;
+}
+
+static __u64 time_get_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void test_bpf_perf_event(int nr_cpus)
+{
+	struct perf_event_attr attr = {
+		.sample_type = PERF_SAMPLE_RAW,
+		.type = PERF_TYPE_SOFTWARE,
+		.config = PERF_COUNT_SW_BPF_OUTPUT,
+		.wakeup_events = 1,
+	};
+	int i;
+
+	for (i = 0; i < nr_cpus; i++) {
+		pmu_fd[i] = perf_event_open(&attr, -1/*pid*/, i/*cpu*/,
+					    -1/*group_fd*/, 0);
+		if (pmu_fd[i] < 0) {
+			printf("event syscall failed\n");
+			exit(1);
+		}
+
+		assert(bpf_update_elem(map_fd[0], &i, &pmu_fd[i],
+				       BPF_ANY) == 0);
+		assert(perf_event_mmap(pmu_fd[i], &header[i]) == 0);
+		ioctl(pmu_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	struct pollfd pfd[MAX_CPUS];
+	char filename[256];
+	__u64 start_time;
+	int i, status;
+
+	snprintf(filename, sizeof(filename), "%s_kern.o", argv[0]);
+
+	if (nr_cpus > MAX_CPUS)
+		nr_cpus = MAX_CPUS;
+	page_size = getpagesize();
+
+	if (load_bpf_file(filename)) {
+		printf("%s", bpf_log_buf);
+		return 1;
+	}
+
+	test_bpf_perf_event(nr_cpus);
+
+	for (i = 0; i < nr_cpus; i++) {
+		pfd[i].fd = pmu_fd[i];
+		pfd[i].events = POLLIN;
+	}
+
+	start_time = time_get_ns();
+
+	/* every write() of the child is sent to us through the rings */
+	child_pid = fork();
+	if (child_pid == 0) {
+		int fd = open("/dev/null", O_WRONLY);
+		long long n;
+
+		for (n = 0; n < MAX_CNT; n++)
+			assert(write(fd, "", 1) == 1);
+		close(fd);
+		exit(0);
+	} else if (child_pid == -1) {
+		printf("couldn't spawn process\n");
+		return 1;
+	}
+
+	while (cnt < MAX_CNT) {
+		if (poll(pfd, nr_cpus, 1000) <= 0) {
+			/* the child exited and the rings are drained */
+			if (waitpid(child_pid, &status, WNOHANG) == child_pid)
+				break;
+			continue;
+		}
+
+		for (i = 0; i < nr_cpus; i++)
+			perf_event_read(header[i]);
+	}
+
+	printf("recv %lld events per sec\n",
+	       cnt * 1000000000ll / (time_get_ns() - start_time));
+
+	for (i = 0; i < nr_cpus; i++)
+		close(pmu_fd[i]);
+	waitpid(child_pid, &status, 0);
+
+	return cnt == MAX_CNT ? 0 : 1;
+}
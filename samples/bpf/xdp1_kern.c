@@ -0,0 +1,86 @@
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ */
+#define KBUILD_MODNAME "foo"
+#include <uapi/linux/bpf.h>
+#include <linux/in.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/if_vlan.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include "bpf_helpers.h"
+
+struct bpf_map_def SEC("maps") rxcnt = {
+	.type = BPF_MAP_TYPE_PERCPU_ARRAY,
+	.key_size = sizeof(u32),
+	.value_size = sizeof(long),
+	.max_entries = 256,
+};
+
+/* the helpers only copy out of the frame, the buffers they fill must be
+ * initialized for the verifier
+ */
+static inline int parse_ipv4(struct xdp_md *ctx, u32 nh_off)
+{
+	u8 proto = 0;
+
+	if (bpf_xdp_load_bytes(ctx, nh_off + offsetof(struct iphdr, protocol),
+			       &proto, sizeof(proto)))
+		return 0;
+	return proto;
+}
+
+static inline int parse_ipv6(struct xdp_md *ctx, u32 nh_off)
+{
+	u8 nexthdr = 0;
+
+	if (bpf_xdp_load_bytes(ctx, nh_off + offsetof(struct ipv6hdr, nexthdr),
+			       &nexthdr, sizeof(nexthdr)))
+		return 0;
+	return nexthdr;
+}
+
+SEC("xdp1")
+int xdp_prog1(struct xdp_md *ctx)
+{
+	struct vlan_hdr vhdr = {};
+	struct ethhdr eth = {};
+	u32 nh_off = sizeof(eth);
+	long *value;
+	u16 h_proto;
+	u32 ipproto;
+
+	if (bpf_xdp_load_bytes(ctx, 0, &eth, sizeof(eth)))
+		return XDP_DROP;
+	h_proto = eth.h_proto;
+
+	if (h_proto == htons(ETH_P_8021Q) || h_proto == htons(ETH_P_8021AD)) {
+		if (bpf_xdp_load_bytes(ctx, nh_off, &vhdr, sizeof(vhdr)))
+			return XDP_DROP;
+		nh_off += sizeof(vhdr);
+		h_proto = vhdr.h_vlan_encapsulated_proto;
+	}
+	if (h_proto == htons(ETH_P_8021Q) || h_proto == htons(ETH_P_8021AD)) {
+		if (bpf_xdp_load_bytes(ctx, nh_off, &vhdr, sizeof(vhdr)))
+			return XDP_DROP;
+		nh_off += sizeof(vhdr);
+		h_proto = vhdr.h_vlan_encapsulated_proto;
+	}
+
+	if (h_proto == htons(ETH_P_IP))
+		ipproto = parse_ipv4(ctx, nh_off);
+	else if (h_proto == htons(ETH_P_IPV6))
+		ipproto = parse_ipv6(ctx, nh_off);
+	else
+		ipproto = 0;
+
+	value = bpf_map_lookup_elem(&rxcnt, &ipproto);
+	if (value)
+		*value += 1;
+
+	return XDP_DROP;
+}
+
+char _license[] SEC("license") = "GPL";
@@ -37,6 +37,7 @@
 #define AVC_CACHE_SLOTS			512
 #define AVC_DEF_CACHE_THRESHOLD		512
 #define AVC_CACHE_RECLAIM		16
+#define AVC_PCPU_SLOTS			32
 
 #ifdef CONFIG_SECURITY_SELINUX_AVC_STATS
 #define avc_cache_stats_incr(field)	this_cpu_inc(avc_cache_stats.field)
@@ -74,8 +75,26 @@ struct avc_cache {
 	atomic_t		lru_hint;	/* LRU hint for reclaim scan */
 	atomic_t		active_nodes;
 	u32			latest_notif;	/* latest revocation notification */
+	atomic_t		generation;	/* bumped when decisions change */
 };
 
+/*
+ * Small per-CPU direct-mapped copy of recent decisions, consulted before
+ * the shared hash.  An entry is only valid while its generation matches
+ * avc_cache.generation, so anything that changes or drops a cached
+ * decision just has to bump the counter.  Only process context uses it,
+ * which keeps interrupts from rewriting an entry under a reader.
+ */
+struct avc_pcpu_entry {
+	u32			ssid;
+	u32			tsid;
+	u16			tclass;
+	int			generation;
+	struct av_decision	avd;
+};
+
+static DEFINE_PER_CPU(struct avc_pcpu_entry [AVC_PCPU_SLOTS], avc_pcpu_cache);
+
 struct avc_callback_node {
 	int (*callback) (u32 event);
 	u32 events;
@@ -89,7 +108,9 @@ unsigned int avc_cache_threshold = AVC_DEF_CACHE_THRESHOLD;
 DEFINE_PER_CPU(struct avc_cache_stats, avc_cache_stats) = { 0 };
 #endif
 
-static struct avc_cache avc_cache;
+static struct avc_cache avc_cache = {
+	.generation = ATOMIC_INIT(1),
+};
 static struct avc_callback_node *avc_callbacks;
 static struct kmem_cache *avc_node_cachep;
 static struct kmem_cache *avc_xperms_data_cachep;
@@ -618,6 +639,69 @@ static struct avc_node *avc_lookup(u32 ssid, u32 tsid, u16 tclass)
 	return NULL;
 }
 
+static inline struct avc_pcpu_entry *avc_pcpu_slot(u32 ssid, u32 tsid,
+						   u16 tclass)
+{
+	return this_cpu_ptr(&avc_pcpu_cache[avc_hash(ssid, tsid, tclass) &
+					    (AVC_PCPU_SLOTS - 1)]);
+}
+
+/*
+ * Copy the decision for (@ssid, @tsid, @tclass) from this CPU's cache into
+ * @avd.  Returns false on a miss, or if the caller can't use the cache.
+ */
+static bool avc_pcpu_lookup(u32 ssid, u32 tsid, u16 tclass,
+			    struct av_decision *avd)
+{
+	struct avc_pcpu_entry *e;
+	bool hit = false;
+
+	if (in_interrupt())
+		return false;
+
+	preempt_disable();
+	e = avc_pcpu_slot(ssid, tsid, tclass);
+	if (e->generation == atomic_read(&avc_cache.generation) &&
+	    e->ssid == ssid && e->tsid == tsid && e->tclass == tclass) {
+		memcpy(avd, &e->avd, sizeof(*avd));
+		hit = true;
+	}
+	preempt_enable();
+
+	if (hit)
+		avc_cache_stats_incr(lookups);
+	return hit;
+}
+
+/*
+ * Remember @avd on this CPU.  @generation must have been sampled before
+ * the node was looked up, so that a racing update leaves the entry stale.
+ */
+static void avc_pcpu_fill(u32 ssid, u32 tsid, u16 tclass,
+			  struct av_decision *avd, int generation)
+{
+	struct avc_pcpu_entry *e;
+
+	if (in_interrupt())
+		return;
+
+	preempt_disable();
+	e = avc_pcpu_slot(ssid, tsid, tclass);
+	e->ssid = ssid;
+	e->tsid = tsid;
+	e->tclass = tclass;
+	memcpy(&e->avd, avd, sizeof(*avd));
+	e->generation = generation;
+	preempt_enable();
+}
+
+/* Invalidate every per-CPU entry, after the shared cache has changed. */
+static inline void avc_pcpu_invalidate(void)
+{
+	smp_mb__before_atomic();
+	atomic_inc(&avc_cache.generation);
+}
+
 static int avc_latest_notif_update(int seqno, int is_insert)
 {
 	int ret = 0;
@@ -899,6 +983,7 @@ static int avc_update_node(u32 event, u32 perms, u8 driver, u8 xperm, u32 ssid,
 		break;
 	}
 	avc_node_replace(node, orig);
+	avc_pcpu_invalidate();
 out_unlock:
 	spin_unlock_irqrestore(lock, flag);
 out:
@@ -931,6 +1016,7 @@ static void avc_flush(void)
 		rcu_read_unlock();
 		spin_unlock_irqrestore(lock, flag);
 	}
+	avc_pcpu_invalidate();
 }
 
 /**
@@ -1102,18 +1188,26 @@ inline int avc_has_perm_noaudit(u32 ssid, u32 tsid,
 {
 	struct avc_node *node;
 	struct avc_xperms_node xp_node;
-	int rc = 0;
+	int rc = 0, generation;
 	u32 denied;
 
 	BUG_ON(!requested);
 
 	rcu_read_lock();
 
-	node = avc_lookup(ssid, tsid, tclass);
-	if (unlikely(!node))
-		node = avc_compute_av(ssid, tsid, tclass, avd, &xp_node);
-	else
-		memcpy(avd, &node->ae.avd, sizeof(*avd));
+	if (!avc_pcpu_lookup(ssid, tsid, tclass, avd)) {
+		generation = atomic_read(&avc_cache.generation);
+		smp_rmb();
+
+		node = avc_lookup(ssid, tsid, tclass);
+		if (unlikely(!node)) {
+			node = avc_compute_av(ssid, tsid, tclass, avd,
+					      &xp_node);
+		} else {
+			memcpy(avd, &node->ae.avd, sizeof(*avd));
+			avc_pcpu_fill(ssid, tsid, tclass, avd, generation);
+		}
+	}
 
 	denied = requested & ~(avd->allowed);
 	if (unlikely(denied))
@@ -23,6 +23,13 @@
 
 #define DRV_NAME "rockchip-i2s"
 
+/* fifo words per second above which the dma moves 8 words per request */
+#define I2S_DMA_BURST8_RATE	(8 * 48000)
+#define I2S_DMA_BUFFER_SIZE	(128 * 1024)
+/* bit clocks per frame when no tdm slots are set up */
+#define I2S_DEFAULT_FRAME_BITS	64
+#define I2S_MAX_FRAME_BITS	256
+
 struct rk_i2s_dev {
 	struct device *dev;
 
@@ -41,6 +48,11 @@ struct rk_i2s_dev {
 */
 	bool tx_start;
 	bool rx_start;
+
+	bool is_master_mode;
+	/* frame layout from set_tdm_slot, tdm_slots is 0 for plain stereo */
+	unsigned int tdm_slots;
+	unsigned int tdm_slot_width;
 };
 
 static int i2s_runtime_suspend(struct device *dev)
@@ -174,9 +186,11 @@ static int rockchip_i2s_set_fmt(struct snd_soc_dai *cpu_dai,
 	case SND_SOC_DAIFMT_CBS_CFS:
 		/* Set source clock in Master mode */
 		val = I2S_CKR_MSS_MASTER;
+		i2s->is_master_mode = true;
 		break;
 	case SND_SOC_DAIFMT_CBM_CFM:
 		val = I2S_CKR_MSS_SLAVE;
+		i2s->is_master_mode = false;
 		break;
 	default:
 		return -EINVAL;
@@ -184,7 +198,7 @@ static int rockchip_i2s_set_fmt(struct snd_soc_dai *cpu_dai,
 
 	regmap_update_bits(i2s->regmap, I2S_CKR, mask, val);
 
-	mask = I2S_TXCR_IBM_MASK;
+	mask = I2S_TXCR_IBM_MASK | I2S_TXCR_TFS_PCM | I2S_TXCR_PBM_MASK;
 	switch (fmt & SND_SOC_DAIFMT_FORMAT_MASK) {
 	case SND_SOC_DAIFMT_RIGHT_J:
 		val = I2S_TXCR_IBM_RSJM;
@@ -195,13 +209,19 @@ static int rockchip_i2s_set_fmt(struct snd_soc_dai *cpu_dai,
 	case SND_SOC_DAIFMT_I2S:
 		val = I2S_TXCR_IBM_NORMAL;
 		break;
+	case SND_SOC_DAIFMT_DSP_A: /* PCM delay 1 bit mode */
+		val = I2S_TXCR_TFS_PCM | I2S_TXCR_PBM_MODE(1);
+		break;
+	case SND_SOC_DAIFMT_DSP_B: /* PCM no delay mode */
+		val = I2S_TXCR_TFS_PCM;
+		break;
 	default:
 		return -EINVAL;
 	}
 
 	regmap_update_bits(i2s->regmap, I2S_TXCR, mask, val);
 
-	mask = I2S_RXCR_IBM_MASK;
+	mask = I2S_RXCR_IBM_MASK | I2S_RXCR_TFS_PCM | I2S_RXCR_PBM_MASK;
 	switch (fmt & SND_SOC_DAIFMT_FORMAT_MASK) {
 	case SND_SOC_DAIFMT_RIGHT_J:
 		val = I2S_RXCR_IBM_RSJM;
@@ -212,6 +232,12 @@ static int rockchip_i2s_set_fmt(struct snd_soc_dai *cpu_dai,
 	case SND_SOC_DAIFMT_I2S:
 		val = I2S_RXCR_IBM_NORMAL;
 		break;
+	case SND_SOC_DAIFMT_DSP_A: /* PCM delay 1 bit mode */
+		val = I2S_RXCR_TFS_PCM | I2S_RXCR_PBM_MODE(1);
+		break;
+	case SND_SOC_DAIFMT_DSP_B: /* PCM no delay mode */
+		val = I2S_RXCR_TFS_PCM;
+		break;
 	default:
 		return -EINVAL;
 	}
@@ -221,12 +247,65 @@ static int rockchip_i2s_set_fmt(struct snd_soc_dai *cpu_dai,
 	return 0;
 }
 
+static void rockchip_i2s_set_dma_levels(struct rk_i2s_dev *i2s,
+					struct snd_pcm_substream *substream,
+					struct snd_pcm_hw_params *params)
+{
+	unsigned int rate = params_rate(params) * params_channels(params);
+	unsigned int burst = rate > I2S_DMA_BURST8_RATE ? 8 : 4;
+
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+		/* Refill from half empty, there is always room for a burst */
+		i2s->playback_dma_data.maxburst = burst;
+		regmap_update_bits(i2s->regmap, I2S_DMACR, I2S_DMACR_TDL_MASK,
+				   I2S_DMACR_TDL(I2S_FIFO_DEPTH / 2));
+	} else {
+		/* Drain as soon as one burst is in, keeping capture latency low */
+		i2s->capture_dma_data.maxburst = burst;
+		regmap_update_bits(i2s->regmap, I2S_DMACR, I2S_DMACR_RDL_MASK,
+				   I2S_DMACR_RDL(burst));
+	}
+}
+
 static int rockchip_i2s_hw_params(struct snd_pcm_substream *substream,
 				  struct snd_pcm_hw_params *params,
 				  struct snd_soc_dai *dai)
 {
 	struct rk_i2s_dev *i2s = to_info(dai);
 	unsigned int val = 0;
+	unsigned int frame_bits = I2S_DEFAULT_FRAME_BITS;
+	unsigned long mclk_rate, bclk_rate;
+	unsigned int channels = params_channels(params);
+
+	if (i2s->tdm_slots) {
+		if (channels > i2s->tdm_slots ||
+		    params_width(params) > i2s->tdm_slot_width) {
+			dev_err(i2s->dev, "%u channels of %d bits don't fit %u slots of %u bits\n",
+				channels, params_width(params),
+				i2s->tdm_slots, i2s->tdm_slot_width);
+			return -EINVAL;
+		}
+		frame_bits = i2s->tdm_slots * i2s->tdm_slot_width;
+	}
+
+	if (i2s->is_master_mode) {
+		mclk_rate = clk_get_rate(i2s->mclk);
+		bclk_rate = frame_bits * params_rate(params);
+		/* MDIV is an 8 bit field holding the divider minus one */
+		if (!bclk_rate || mclk_rate % bclk_rate ||
+		    !mclk_rate || mclk_rate / bclk_rate > 256) {
+			dev_err(i2s->dev, "mclk %lu can't make bclk %lu\n",
+				mclk_rate, bclk_rate);
+			return -EINVAL;
+		}
+
+		regmap_update_bits(i2s->regmap, I2S_CKR, I2S_CKR_MDIV_MASK,
+				   I2S_CKR_MDIV(mclk_rate / bclk_rate));
+		regmap_update_bits(i2s->regmap, I2S_CKR,
+				   I2S_CKR_TSD_MASK | I2S_CKR_RSD_MASK,
+				   I2S_CKR_TSD(frame_bits) |
+				   I2S_CKR_RSD(frame_bits));
+	}
 
 	switch (params_format(params)) {
 	case SNDRV_PCM_FORMAT_S8:
@@ -247,10 +326,32 @@ static int rockchip_i2s_hw_params(struct snd_pcm_substream *substream,
 
 	regmap_update_bits(i2s->regmap, I2S_TXCR, I2S_TXCR_VDW_MASK, val);
 	regmap_update_bits(i2s->regmap, I2S_RXCR, I2S_RXCR_VDW_MASK, val);
-	regmap_update_bits(i2s->regmap, I2S_DMACR, I2S_DMACR_TDL_MASK,
-			   I2S_DMACR_TDL(16));
-	regmap_update_bits(i2s->regmap, I2S_DMACR, I2S_DMACR_RDL_MASK,
-			   I2S_DMACR_RDL(16));
+
+	switch (channels) {
+	case 8:
+		val = I2S_CHN_8;
+		break;
+	case 6:
+		val = I2S_CHN_6;
+		break;
+	case 4:
+		val = I2S_CHN_4;
+		break;
+	case 2:
+		val = I2S_CHN_2;
+		break;
+	default:
+		dev_err(i2s->dev, "invalid channel: %u\n", channels);
+		return -EINVAL;
+	}
+
+	if (substream->stream == SNDRV_PCM_STREAM_CAPTURE)
+		regmap_update_bits(i2s->regmap, I2S_RXCR, I2S_CSR_MASK, val);
+	else
+		regmap_update_bits(i2s->regmap, I2S_TXCR, I2S_CSR_MASK, val);
+
+	/* The pcm configures the dma channel with this maxburst afterwards */
+	rockchip_i2s_set_dma_levels(i2s, substream, params);
 
 	return 0;
 }
@@ -299,6 +400,37 @@ static int rockchip_i2s_set_sysclk(struct snd_soc_dai *cpu_dai, int clk_id,
 	return ret;
 }
 
+static int rockchip_i2s_set_tdm_slot(struct snd_soc_dai *cpu_dai,
+				     unsigned int tx_mask,
+				     unsigned int rx_mask,
+				     int slots, int slot_width)
+{
+	struct rk_i2s_dev *i2s = to_info(cpu_dai);
+
+	if (!slots) {
+		i2s->tdm_slots = 0;
+		i2s->tdm_slot_width = 0;
+		return 0;
+	}
+
+	if (slot_width < 8 || slot_width > 32 ||
+	    slots * slot_width > I2S_MAX_FRAME_BITS)
+		return -EINVAL;
+
+	/*
+	 * The controller puts channels into consecutive slots from the start
+	 * of the frame, it can't skip any.
+	 */
+	if ((tx_mask & (tx_mask + 1)) || (rx_mask & (rx_mask + 1)) ||
+	    tx_mask >= BIT(slots) || rx_mask >= BIT(slots))
+		return -EINVAL;
+
+	i2s->tdm_slots = slots;
+	i2s->tdm_slot_width = slot_width;
+
+	return 0;
+}
+
 static int rockchip_i2s_dai_probe(struct snd_soc_dai *dai)
 {
 	struct rk_i2s_dev *i2s = snd_soc_dai_get_drvdata(dai);
@@ -313,6 +445,7 @@ static const struct snd_soc_dai_ops rockchip_i2s_dai_ops = {
 	.hw_params = rockchip_i2s_hw_params,
 	.set_sysclk = rockchip_i2s_set_sysclk,
 	.set_fmt = rockchip_i2s_set_fmt,
+	.set_tdm_slot = rockchip_i2s_set_tdm_slot,
 	.trigger = rockchip_i2s_trigger,
 };
 
@@ -342,6 +475,37 @@ static struct snd_soc_dai_driver rockchip_i2s_dai = {
 	.symmetric_rates = 1,
 };
 
+/*
+ * The dma reports residue at burst granularity, so the pcm pointer stays
+ * exact between period interrupts and applications may run without them.
+ */
+static const struct snd_pcm_hardware rockchip_i2s_pcm_hardware = {
+	.info = SNDRV_PCM_INFO_INTERLEAVED |
+		SNDRV_PCM_INFO_BLOCK_TRANSFER |
+		SNDRV_PCM_INFO_MMAP |
+		SNDRV_PCM_INFO_MMAP_VALID |
+		SNDRV_PCM_INFO_PAUSE |
+		SNDRV_PCM_INFO_RESUME |
+		SNDRV_PCM_INFO_NO_PERIOD_WAKEUP |
+		SNDRV_PCM_INFO_HAS_LINK_ATIME,
+	.formats = (SNDRV_PCM_FMTBIT_S8 |
+		    SNDRV_PCM_FMTBIT_S16_LE |
+		    SNDRV_PCM_FMTBIT_S20_3LE |
+		    SNDRV_PCM_FMTBIT_S24_LE),
+	.buffer_bytes_max = I2S_DMA_BUFFER_SIZE,
+	.period_bytes_min = 64,
+	.period_bytes_max = I2S_DMA_BUFFER_SIZE / 2,
+	.periods_min = 2,
+	.periods_max = 128,
+	.fifo_size = I2S_FIFO_DEPTH * 4,
+};
+
+static const struct snd_dmaengine_pcm_config rockchip_i2s_pcm_config = {
+	.pcm_hardware = &rockchip_i2s_pcm_hardware,
+	.prepare_slave_config = snd_dmaengine_pcm_prepare_slave_config,
+	.prealloc_buffer_size = I2S_DMA_BUFFER_SIZE,
+};
+
 static const struct snd_soc_component_driver rockchip_i2s_component = {
 	.name = DRV_NAME,
 };
@@ -415,10 +579,13 @@ static const struct regmap_config rockchip_i2s_regmap_config = {
 
 static int rockchip_i2s_probe(struct platform_device *pdev)
 {
+	struct device_node *node = pdev->dev.of_node;
 	struct rk_i2s_dev *i2s;
+	struct snd_soc_dai_driver *soc_dai;
 	struct resource *res;
 	void __iomem *regs;
 	int ret;
+	u32 val;
 
 	i2s = devm_kzalloc(&pdev->dev, sizeof(*i2s), GFP_KERNEL);
 	if (!i2s) {
@@ -475,15 +642,29 @@ static int rockchip_i2s_probe(struct platform_device *pdev)
 			goto err_pm_disable;
 	}
 
+	soc_dai = devm_kmemdup(&pdev->dev, &rockchip_i2s_dai,
+			       sizeof(*soc_dai), GFP_KERNEL);
+	if (!soc_dai) {
+		ret = -ENOMEM;
+		goto err_suspend;
+	}
+
+	/* Not every instance has all four sdi lines wired up */
+	if (!of_property_read_u32(node, "rockchip,capture-channels", &val)) {
+		if (val >= 2 && val <= 8)
+			soc_dai->capture.channels_max = val;
+	}
+
 	ret = devm_snd_soc_register_component(&pdev->dev,
 					      &rockchip_i2s_component,
-					      &rockchip_i2s_dai, 1);
+					      soc_dai, 1);
 	if (ret) {
 		dev_err(&pdev->dev, "Could not register DAI\n");
 		goto err_suspend;
 	}
 
-	ret = devm_snd_dmaengine_pcm_register(&pdev->dev, NULL, 0);
+	ret = devm_snd_dmaengine_pcm_register(&pdev->dev,
+					      &rockchip_i2s_pcm_config, 0);
 	if (ret) {
 		dev_err(&pdev->dev, "Could not register PCM\n");
 		return ret;
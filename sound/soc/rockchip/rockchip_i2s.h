@@ -130,6 +130,9 @@
 #define I2S_DMACR_TDL(x)	((x) << I2S_DMACR_TDL_SHIFT)
 #define I2S_DMACR_TDL_MASK	(0x1f << I2S_DMACR_TDL_SHIFT)
 
+/* Depth of each tx/rx fifo, in 32-bit words */
+#define I2S_FIFO_DEPTH		32
+
 /*
  * INTCR
  * interrupt control register
@@ -201,6 +204,14 @@
 */
 #define I2S_RXDR_MASK	(0xff)
 
+/* channel select, same field in TXCR and RXCR */
+#define I2S_CSR_SHIFT	15
+#define I2S_CHN_2	(0 << I2S_CSR_SHIFT)
+#define I2S_CHN_4	(1 << I2S_CSR_SHIFT)
+#define I2S_CHN_6	(2 << I2S_CSR_SHIFT)
+#define I2S_CHN_8	(3 << I2S_CSR_SHIFT)
+#define I2S_CSR_MASK	(3 << I2S_CSR_SHIFT)
+
 /* Clock divider id */
 enum {
 	ROCKCHIP_DIV_MCLK = 0,
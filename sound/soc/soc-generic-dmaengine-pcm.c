@@ -30,6 +30,12 @@
  */
 #define SND_DMAENGINE_PCM_FLAG_NO_RESIDUE BIT(31)
 
+/*
+ * The residue is only updated once per segment, too coarse to derive link
+ * timestamps from it.
+ */
+#define SND_DMAENGINE_PCM_FLAG_COARSE_RESIDUE BIT(30)
+
 struct dmaengine_pcm {
 	struct dma_chan *chan[SNDRV_PCM_STREAM_LAST + 1];
 	const struct snd_dmaengine_pcm_config *config;
@@ -155,6 +161,8 @@ static int dmaengine_pcm_set_runtime_hwparams(struct snd_pcm_substream *substrea
 			hw.info |= SNDRV_PCM_INFO_PAUSE | SNDRV_PCM_INFO_RESUME;
 		if (dma_caps.residue_granularity <= DMA_RESIDUE_GRANULARITY_SEGMENT)
 			hw.info |= SNDRV_PCM_INFO_BATCH;
+		else if (!(pcm->flags & SND_DMAENGINE_PCM_FLAG_COARSE_RESIDUE))
+			hw.info |= SNDRV_PCM_INFO_HAS_LINK_ATIME;
 
 		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
 			addr_widths = dma_caps.dst_addr_widths;
@@ -247,6 +255,16 @@ static bool dmaengine_pcm_can_report_residue(struct device *dev,
 	return true;
 }
 
+static bool dmaengine_pcm_has_burst_residue(struct dma_chan *chan)
+{
+	struct dma_slave_caps dma_caps;
+
+	if (dma_get_slave_caps(chan, &dma_caps))
+		return false;
+
+	return dma_caps.residue_granularity == DMA_RESIDUE_GRANULARITY_BURST;
+}
+
 static int dmaengine_pcm_new(struct snd_soc_pcm_runtime *rtd)
 {
 	struct dmaengine_pcm *pcm = soc_platform_to_pcm(rtd->platform);
@@ -301,6 +319,8 @@ static int dmaengine_pcm_new(struct snd_soc_pcm_runtime *rtd)
 
 		if (!dmaengine_pcm_can_report_residue(dev, pcm->chan[i]))
 			pcm->flags |= SND_DMAENGINE_PCM_FLAG_NO_RESIDUE;
+		else if (!dmaengine_pcm_has_burst_residue(pcm->chan[i]))
+			pcm->flags |= SND_DMAENGINE_PCM_FLAG_COARSE_RESIDUE;
 	}
 
 	return 0;
@@ -318,6 +338,64 @@ static snd_pcm_uframes_t dmaengine_pcm_pointer(
 		return snd_dmaengine_pcm_pointer(substream);
 }
 
+/*
+ * Link timestamps are taken from the DMA position: the residue and the
+ * system time are sampled back to back, so they are accurate to one burst
+ * rather than to the period interrupt that last updated hw_ptr.
+ */
+static int dmaengine_pcm_get_time_info(struct snd_pcm_substream *substream,
+	struct timespec *system_ts, struct timespec *audio_ts,
+	struct snd_pcm_audio_tstamp_config *audio_tstamp_config,
+	struct snd_pcm_audio_tstamp_report *audio_tstamp_report)
+{
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+	struct dmaengine_pcm *pcm = soc_platform_to_pcm(rtd->platform);
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct snd_dmaengine_dai_dma_data *dma_data;
+	snd_pcm_uframes_t pos, hw_ptr, hw_base;
+	u64 frames;
+
+	if ((pcm->flags & (SND_DMAENGINE_PCM_FLAG_NO_RESIDUE |
+			   SND_DMAENGINE_PCM_FLAG_COARSE_RESIDUE)) ||
+	    audio_tstamp_config->type_requested !=
+			SNDRV_PCM_AUDIO_TSTAMP_TYPE_LINK) {
+		audio_tstamp_report->actual_type =
+			SNDRV_PCM_AUDIO_TSTAMP_TYPE_DEFAULT;
+		return 0;
+	}
+
+	pos = snd_dmaengine_pcm_pointer(substream);
+	snd_pcm_gettime(runtime, system_ts);
+
+	hw_ptr = runtime->status->hw_ptr;
+	hw_base = hw_ptr - hw_ptr % runtime->buffer_size;
+	if (pos < hw_ptr - hw_base)
+		hw_base += runtime->buffer_size;
+	frames = runtime->hw_ptr_wrap + hw_base + pos;
+
+	if (audio_tstamp_config->report_delay) {
+		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+			frames -= runtime->delay;
+		else
+			frames += runtime->delay;
+	}
+
+	*audio_ts = ns_to_timespec(div_u64(frames * NSEC_PER_SEC,
+					   runtime->rate));
+
+	audio_tstamp_report->actual_type = SNDRV_PCM_AUDIO_TSTAMP_TYPE_LINK;
+
+	dma_data = snd_soc_dai_get_dma_data(rtd->cpu_dai, substream);
+	if (dma_data->maxburst) {
+		audio_tstamp_report->accuracy_report = 1;
+		audio_tstamp_report->accuracy =
+			div_u64((u64)dma_data->maxburst * NSEC_PER_SEC,
+				runtime->rate * runtime->channels);
+	}
+
+	return 0;
+}
+
 static const struct snd_pcm_ops dmaengine_pcm_ops = {
 	.open		= dmaengine_pcm_open,
 	.close		= snd_dmaengine_pcm_close,
@@ -326,6 +404,7 @@ static const struct snd_pcm_ops dmaengine_pcm_ops = {
 	.hw_free	= snd_pcm_lib_free_pages,
 	.trigger	= snd_dmaengine_pcm_trigger,
 	.pointer	= dmaengine_pcm_pointer,
+	.get_time_info	= dmaengine_pcm_get_time_info,
 };
 
 static const struct snd_soc_platform_driver dmaengine_pcm_platform = {
@@ -0,0 +1,273 @@
+/*
+ * epoll-ctl: Measure the cost of adding, modifying and removing file
+ * descriptors with epoll_ctl(2), from many threads at once.
+ *
+ * Every worker owns a number of eventfds and cycles each of them through
+ * EPOLL_CTL_ADD, EPOLL_CTL_MOD and EPOLL_CTL_DEL. By default all workers
+ * share one epoll instance, so that contention on its internal locks
+ * shows up; with --multiq each worker gets an instance of its own.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/stat.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <err.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 8;
+/* amount of fds per thread */
+static unsigned int nfds     = 64;
+static bool multiq = false, done = false, silent = false;
+
+static struct timeval start, end, runtime;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static pthread_cond_t thread_parent, thread_worker;
+
+enum {
+	OP_EPOLL_ADD,
+	OP_EPOLL_MOD,
+	OP_EPOLL_DEL,
+	EPOLL_NR_OPS,
+};
+
+static struct stats throughput_stats[EPOLL_NR_OPS];
+
+static const char * const op_names[EPOLL_NR_OPS] = {
+	[OP_EPOLL_ADD] = "ADD",
+	[OP_EPOLL_MOD] = "MOD",
+	[OP_EPOLL_DEL] = "DEL",
+};
+
+struct worker {
+	int tid;
+	int epfd;
+	int *fds;
+	pthread_t thread;
+	unsigned long ops[EPOLL_NR_OPS];
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('f', "nfds",    &nfds,     "Specify amount of file descriptors per thread"),
+	OPT_BOOLEAN( 'm', "multiq",  &multiq,   "Use an epoll instance per thread instead of a shared one"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_ctl_usage[] = {
+	"perf bench epoll ctl <options>",
+	NULL
+};
+
+static void do_epoll_op(struct worker *w, int op, int fd)
+{
+	struct epoll_event ev = { .data.fd = fd };
+	int ret;
+
+	switch (op) {
+	case OP_EPOLL_ADD:
+		ev.events = EPOLLIN;
+		ret = epoll_ctl(w->epfd, EPOLL_CTL_ADD, fd, &ev);
+		break;
+	case OP_EPOLL_MOD:
+		ev.events = EPOLLOUT;
+		ret = epoll_ctl(w->epfd, EPOLL_CTL_MOD, fd, &ev);
+		break;
+	case OP_EPOLL_DEL:
+	default:
+		ret = epoll_ctl(w->epfd, EPOLL_CTL_DEL, fd, NULL);
+		break;
+	}
+
+	if (ret)
+		err(EXIT_FAILURE, "epoll_ctl(%s)", op_names[op]);
+	w->ops[op]++;
+}
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	unsigned int i;
+	int op;
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	do {
+		/* add every fd, then modify and remove them all again */
+		for (op = 0; op < EPOLL_NR_OPS; op++)
+			for (i = 0; i < nfds; i++)
+				do_epoll_op(w, op, w->fds[i]);
+	} while (!done);
+
+	return NULL;
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	int op;
+
+	printf("\n");
+	for (op = 0; op < EPOLL_NR_OPS; op++) {
+		unsigned long avg = avg_stats(&throughput_stats[op]);
+		double stddev = stddev_stats(&throughput_stats[op]);
+
+		printf("Averaged %ld %s operations/sec (+- %.2f%%), total secs = %d\n",
+		       avg, op_names[op], rel_stddev_stats(stddev, avg),
+		       (int) runtime.tv_sec);
+	}
+}
+
+int bench_epoll_ctl(int argc, const char **argv,
+		    const char *prefix __maybe_unused)
+{
+	int ret = 0, shared_epfd = -1, op;
+	cpu_set_t cpu;
+	struct sigaction act;
+	unsigned int i, j, ncpus;
+	pthread_attr_t thread_attr;
+	struct worker *worker = NULL;
+
+	argc = parse_options(argc, argv, options, bench_epoll_ctl_usage, 0);
+	if (argc) {
+		usage_with_options(bench_epoll_ctl_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	if (!nthreads) /* default to the number of CPUs */
+		nthreads = ncpus;
+	if (!nfds)
+		nfds = 1;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		err(EXIT_FAILURE, "calloc");
+
+	if (!multiq) {
+		shared_epfd = epoll_create(nthreads * nfds);
+		if (shared_epfd < 0)
+			err(EXIT_FAILURE, "epoll_create");
+	}
+
+	printf("Run summary [PID %d]: %d threads doing epoll_ctl ops on %s epoll instance%s, %d fds each, for %d secs.\n\n",
+	       getpid(), nthreads, multiq ? "their own" : "a shared",
+	       multiq ? "s" : "", nfds, nsecs);
+
+	for (op = 0; op < EPOLL_NR_OPS; op++)
+		init_stats(&throughput_stats[op]);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = nthreads;
+	pthread_attr_init(&thread_attr);
+	for (i = 0; i < nthreads; i++) {
+		struct worker *w = &worker[i];
+
+		w->tid = i;
+		w->epfd = multiq ? epoll_create(nfds) : shared_epfd;
+		if (w->epfd < 0)
+			err(EXIT_FAILURE, "epoll_create");
+
+		w->fds = calloc(nfds, sizeof(*w->fds));
+		if (!w->fds)
+			err(EXIT_FAILURE, "calloc");
+		for (j = 0; j < nfds; j++) {
+			w->fds[j] = eventfd(0, EFD_NONBLOCK);
+			if (w->fds[j] < 0)
+				err(EXIT_FAILURE, "eventfd");
+		}
+
+		CPU_ZERO(&cpu);
+		CPU_SET(i % ncpus, &cpu);
+
+		ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpu);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&w->thread, &thread_attr, workerfn,
+				     (void *)(struct worker *) w);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&thread_attr);
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	gettimeofday(&start, NULL);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t[EPOLL_NR_OPS];
+
+		for (op = 0; op < EPOLL_NR_OPS; op++) {
+			t[op] = worker[i].ops[op] / runtime.tv_sec;
+			update_stats(&throughput_stats[op], t[op]);
+		}
+		if (!silent)
+			printf("[thread %2d] fds: %d ... %d [ add: %ld mod: %ld del: %ld ops/sec ]\n",
+			       worker[i].tid, worker[i].fds[0],
+			       worker[i].fds[nfds - 1], t[OP_EPOLL_ADD],
+			       t[OP_EPOLL_MOD], t[OP_EPOLL_DEL]);
+
+		for (j = 0; j < nfds; j++)
+			close(worker[i].fds[j]);
+		free(worker[i].fds);
+		if (multiq)
+			close(worker[i].epfd);
+	}
+
+	print_summary();
+
+	if (!multiq)
+		close(shared_epfd);
+	free(worker);
+	return ret;
+}
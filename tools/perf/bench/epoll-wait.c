@@ -0,0 +1,289 @@
+/*
+ * epoll-wait: Measure how fast epoll_wait(2) hands out ready file
+ * descriptors to a set of waiting threads.
+ *
+ * Every worker owns a number of eventfds. A writer thread keeps making
+ * them readable, round-robin, and the workers consume whatever epoll
+ * reports. By default all fds are added to one epoll instance that every
+ * worker waits on, which stresses the wakeup path of a shared instance;
+ * with --multiq each worker gets an instance of its own.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/stat.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <err.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 8;
+/* amount of fds per thread */
+static unsigned int nfds     = 64;
+static bool multiq = false, edge = false, done = false, silent = false;
+
+static struct timeval start, end, runtime;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static struct stats throughput_stats;
+static pthread_cond_t thread_parent, thread_worker;
+
+struct worker {
+	int tid;
+	int epfd;
+	int *fds;
+	pthread_t thread;
+	unsigned long ops;
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('f', "nfds",    &nfds,     "Specify amount of file descriptors per thread"),
+	OPT_BOOLEAN( 'm', "multiq",  &multiq,   "Use an epoll instance per thread instead of a shared one"),
+	OPT_BOOLEAN( 'E', "edge",    &edge,     "Use edge-triggered notifications"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_wait_usage[] = {
+	"perf bench epoll wait <options>",
+	NULL
+};
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	struct epoll_event ev;
+	u64 val;
+	int ret;
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	do {
+		/* time out now and then, so that the end of the run is seen */
+		ret = epoll_wait(w->epfd, &ev, 1, 100);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, "epoll_wait");
+		}
+		if (!ret)
+			continue;
+
+		/* another waiter of a shared instance may have been faster */
+		if (read(ev.data.fd, &val, sizeof(val)) == sizeof(val))
+			w->ops++;
+		else if (errno != EAGAIN)
+			err(EXIT_FAILURE, "read");
+	} while (!done);
+
+	return NULL;
+}
+
+static void *writerfn(void *arg)
+{
+	struct worker *worker = (struct worker *) arg;
+	unsigned int i, j;
+	u64 val = 1;
+
+	while (!done) {
+		for (j = 0; j < nfds && !done; j++) {
+			for (i = 0; i < nthreads; i++) {
+				/* EAGAIN: the counter is full, nobody is reading */
+				if (write(worker[i].fds[j], &val, sizeof(val)) < 0 &&
+				    errno != EAGAIN)
+					err(EXIT_FAILURE, "write");
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static void do_setup(struct worker *worker, int shared_epfd)
+{
+	struct epoll_event ev;
+	unsigned int i, j;
+
+	for (i = 0; i < nthreads; i++) {
+		struct worker *w = &worker[i];
+
+		w->tid = i;
+		w->epfd = multiq ? epoll_create(nfds) : shared_epfd;
+		if (w->epfd < 0)
+			err(EXIT_FAILURE, "epoll_create");
+
+		w->fds = calloc(nfds, sizeof(*w->fds));
+		if (!w->fds)
+			err(EXIT_FAILURE, "calloc");
+
+		for (j = 0; j < nfds; j++) {
+			w->fds[j] = eventfd(0, EFD_NONBLOCK);
+			if (w->fds[j] < 0)
+				err(EXIT_FAILURE, "eventfd");
+
+			ev.events = EPOLLIN | (edge ? EPOLLET : 0);
+			ev.data.fd = w->fds[j];
+			if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->fds[j], &ev))
+				err(EXIT_FAILURE, "epoll_ctl");
+		}
+	}
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	unsigned long avg = avg_stats(&throughput_stats);
+	double stddev = stddev_stats(&throughput_stats);
+
+	printf("%sAveraged %ld operations/sec (+- %.2f%%), total secs = %d\n",
+	       !silent ? "\n" : "", avg, rel_stddev_stats(stddev, avg),
+	       (int) runtime.tv_sec);
+}
+
+int bench_epoll_wait(int argc, const char **argv,
+		     const char *prefix __maybe_unused)
+{
+	int ret = 0, shared_epfd = -1;
+	cpu_set_t cpu;
+	struct sigaction act;
+	unsigned int i, j, ncpus;
+	pthread_attr_t thread_attr;
+	struct worker *worker = NULL;
+	pthread_t writer;
+
+	argc = parse_options(argc, argv, options, bench_epoll_wait_usage, 0);
+	if (argc) {
+		usage_with_options(bench_epoll_wait_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	if (!nthreads) /* default to the number of CPUs, minus the writer */
+		nthreads = ncpus > 1 ? ncpus - 1 : 1;
+	if (!nfds)
+		nfds = 1;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		err(EXIT_FAILURE, "calloc");
+
+	if (!multiq) {
+		shared_epfd = epoll_create(nthreads * nfds);
+		if (shared_epfd < 0)
+			err(EXIT_FAILURE, "epoll_create");
+	}
+
+	printf("Run summary [PID %d]: %d threads waiting on %s epoll instance%s, %d %s-triggered fds each, for %d secs.\n\n",
+	       getpid(), nthreads, multiq ? "their own" : "a shared",
+	       multiq ? "s" : "", nfds, edge ? "edge" : "level", nsecs);
+
+	do_setup(worker, shared_epfd);
+
+	init_stats(&throughput_stats);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = nthreads;
+	pthread_attr_init(&thread_attr);
+	for (i = 0; i < nthreads; i++) {
+		CPU_ZERO(&cpu);
+		CPU_SET((i + 1) % ncpus, &cpu);
+
+		ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpu);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&worker[i].thread, &thread_attr, workerfn,
+				     (void *)(struct worker *) &worker[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+
+	/* the writer gets the first CPU to itself */
+	CPU_ZERO(&cpu);
+	CPU_SET(0, &cpu);
+	ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpu);
+	if (ret)
+		err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	gettimeofday(&start, NULL);
+	ret = pthread_create(&writer, &thread_attr, writerfn, worker);
+	if (ret)
+		err(EXIT_FAILURE, "pthread_create");
+	pthread_attr_destroy(&thread_attr);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	ret = pthread_join(writer, NULL);
+	if (ret)
+		err(EXIT_FAILURE, "pthread_join");
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t = worker[i].ops / runtime.tv_sec;
+
+		update_stats(&throughput_stats, t);
+		if (!silent)
+			printf("[thread %2d] fds: %d ... %d [ %ld ops/sec ]\n",
+			       worker[i].tid, worker[i].fds[0],
+			       worker[i].fds[nfds - 1], t);
+
+		for (j = 0; j < nfds; j++)
+			close(worker[i].fds[j]);
+		free(worker[i].fds);
+		if (multiq)
+			close(worker[i].epfd);
+	}
+
+	print_summary();
+
+	if (!multiq)
+		close(shared_epfd);
+	free(worker);
+	return ret;
+}
@@ -0,0 +1,204 @@
+/*
+ * ipc-pingpong: Round trip latency of a pipe or an AF_UNIX socket between
+ * two threads pinned to a pair of CPUs.
+ *
+ * Every pair of the selected CPUs is measured in turn, which shows the
+ * cost of waking up and passing data to a task on the same core, a
+ * sibling, another core of the same cluster or another cluster.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../util/cpumap.h"
+#include "bench.h"
+
+#include <err.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <pthread.h>
+
+static int loops = 10000;
+static const char *type_str = "pipe";
+static const char *cpu_list;
+
+static const struct option options[] = {
+	OPT_INTEGER('l', "loop",  &loops,    "Specify number of round trips per CPU pair"),
+	OPT_STRING( 't', "type",  &type_str, "pipe", "Channel to use: pipe or unix"),
+	OPT_STRING( 'C', "cpu",   &cpu_list, "cpu", "List of CPUs to pair up, default: all online CPUs"),
+	OPT_END()
+};
+
+static const char * const bench_ipc_pingpong_usage[] = {
+	"perf bench ipc pingpong <options>",
+	NULL
+};
+
+struct thread_data {
+	int		nr;
+	int		cpu;
+	int		fd_read;
+	int		fd_write;
+	pthread_t	pthread;
+	struct timeval	runtime;
+};
+
+static void *worker_thread(void *__tdata)
+{
+	struct thread_data *td = __tdata;
+	struct timeval start, stop;
+	int m = 0, i, ret;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < loops; i++) {
+		if (!td->nr) {
+			ret = write(td->fd_write, &m, sizeof(int));
+			BUG_ON(ret != sizeof(int));
+			ret = read(td->fd_read, &m, sizeof(int));
+			BUG_ON(ret != sizeof(int));
+		} else {
+			ret = read(td->fd_read, &m, sizeof(int));
+			BUG_ON(ret != sizeof(int));
+			ret = write(td->fd_write, &m, sizeof(int));
+			BUG_ON(ret != sizeof(int));
+		}
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &td->runtime);
+
+	return NULL;
+}
+
+static void open_channel(bool unix_socket, struct thread_data *td)
+{
+	int fds[2], back[2];
+
+	if (unix_socket) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+			err(EXIT_FAILURE, "socketpair");
+		td[0].fd_read = td[0].fd_write = fds[0];
+		td[1].fd_read = td[1].fd_write = fds[1];
+		return;
+	}
+
+	if (pipe(fds) || pipe(back))
+		err(EXIT_FAILURE, "pipe");
+	td[0].fd_write = fds[1];
+	td[1].fd_read  = fds[0];
+	td[1].fd_write = back[1];
+	td[0].fd_read  = back[0];
+}
+
+static void close_channel(bool unix_socket, struct thread_data *td)
+{
+	close(td[0].fd_write);
+	close(td[1].fd_write);
+	if (!unix_socket) {
+		close(td[0].fd_read);
+		close(td[1].fd_read);
+	}
+}
+
+/* Returns the average round trip time in usecs. */
+static double run_pair(bool unix_socket, int cpu0, int cpu1)
+{
+	struct thread_data threads[2];
+	pthread_attr_t attr;
+	cpu_set_t cpuset;
+	int i, ret;
+
+	memset(threads, 0, sizeof(threads));
+	open_channel(unix_socket, threads);
+
+	pthread_attr_init(&attr);
+	/* start the responder first, so that it is waiting when we begin */
+	for (i = 1; i >= 0; i--) {
+		threads[i].nr = i;
+		threads[i].cpu = i ? cpu1 : cpu0;
+
+		CPU_ZERO(&cpuset);
+		CPU_SET(threads[i].cpu, &cpuset);
+		ret = pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&threads[i].pthread, &attr, worker_thread,
+				     &threads[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&attr);
+
+	for (i = 0; i < 2; i++) {
+		ret = pthread_join(threads[i].pthread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	close_channel(unix_socket, threads);
+
+	return (threads[0].runtime.tv_sec * 1000000.0 +
+		threads[0].runtime.tv_usec) / (double)loops;
+}
+
+int bench_ipc_pingpong(int argc, const char **argv,
+		       const char *prefix __maybe_unused)
+{
+	struct cpu_map *cpus;
+	bool unix_socket;
+	int i, j;
+
+	argc = parse_options(argc, argv, options, bench_ipc_pingpong_usage, 0);
+	if (argc || loops <= 0) {
+		usage_with_options(bench_ipc_pingpong_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!strcmp(type_str, "unix"))
+		unix_socket = true;
+	else if (!strcmp(type_str, "pipe"))
+		unix_socket = false;
+	else {
+		fprintf(stderr, "Unknown channel type: '%s'\n", type_str);
+		usage_with_options(bench_ipc_pingpong_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	cpus = cpu_map__new(cpu_list);
+	if (!cpus || cpus->nr < 2) {
+		fprintf(stderr, "Need at least two CPUs to pair up\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d round trips over a %s between each pair of CPUs\n\n",
+		       loops, unix_socket ? "unix socket" : "pipe");
+
+	for (i = 0; i < cpus->nr; i++) {
+		for (j = i + 1; j < cpus->nr; j++) {
+			int cpu0 = cpus->map[i], cpu1 = cpus->map[j];
+			double usecs = run_pair(unix_socket, cpu0, cpu1);
+
+			switch (bench_format) {
+			case BENCH_FORMAT_DEFAULT:
+				printf(" CPU %3d <-> CPU %3d: %12.3lf usecs/round trip\n",
+				       cpu0, cpu1, usecs);
+				break;
+			case BENCH_FORMAT_SIMPLE:
+				printf("%d %d %lf\n", cpu0, cpu1, usecs);
+				break;
+			default:
+				/* reaching here is something disaster */
+				fprintf(stderr, "Unknown format:%d\n", bench_format);
+				exit(1);
+				break;
+			}
+		}
+	}
+
+	cpu_map__put(cpus);
+	return 0;
+}
@@ -0,0 +1,273 @@
+/*
+ * mem-bandwidth.c
+ *
+ * bandwidth: Aggregate memory bandwidth of each CPU cluster
+ *
+ * One thread is pinned to every CPU of a cluster and they all stream
+ * through a private buffer at the same time, so that the result is what
+ * the cluster can pull from memory, not what a single core can. On ARM
+ * the cluster is what the topology code reports as physical package, so
+ * big.LITTLE systems show one line per cluster. When there is more than
+ * one cluster, all of the selected CPUs are finally run together.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../util/cpumap.h"
+#include "bench.h"
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+static const char	*size_str	= "32MB";
+static const char	*function	= "read";
+static const char	*cpu_list;
+static int		iterations	= 4;
+
+static const struct option options[] = {
+	OPT_STRING('s', "size", &size_str, "32MB",
+		    "Specify size of the buffer of each thread. "
+		    "Available units: B, KB, MB, GB and TB (upper and lower)"),
+	OPT_STRING('f', "function", &function, "read",
+		    "Specify access pattern: read, write or copy"),
+	OPT_INTEGER('i', "iterations", &iterations,
+		    "Repeat the access this number of times"),
+	OPT_STRING('C', "cpu", &cpu_list, "cpu",
+		    "List of CPUs to use, default: all online CPUs"),
+	OPT_END()
+};
+
+static const char * const bench_mem_bandwidth_usage[] = {
+	"perf bench mem bandwidth <options>",
+	NULL
+};
+
+enum {
+	BW_READ,
+	BW_WRITE,
+	BW_COPY,
+};
+
+static int bw_function;
+static size_t len;
+static pthread_barrier_t barrier;
+
+struct worker {
+	int		cpu;
+	pthread_t	thread;
+	double		secs;
+};
+
+static void do_read(u64 *buf)
+{
+	size_t i, nr = len / sizeof(u64);
+	u64 sum = 0;
+
+	for (i = 0; i < nr; i += 4)
+		sum += buf[i] + buf[i + 1] + buf[i + 2] + buf[i + 3];
+
+	/* keep the compiler from dropping the loads */
+	*(volatile u64 *)buf = sum;
+}
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = arg;
+	struct timeval start, end, diff;
+	void *src, *dst = NULL;
+	int i;
+
+	/* allocate and fault in from the pinned thread, so memory is local */
+	src = malloc(len);
+	if (bw_function == BW_COPY)
+		dst = malloc(len);
+	if (!src || (bw_function == BW_COPY && !dst))
+		err(EXIT_FAILURE, "malloc");
+	memset(src, 0, len);
+	if (dst)
+		memset(dst, 0, len);
+
+	pthread_barrier_wait(&barrier);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < iterations; i++) {
+		switch (bw_function) {
+		case BW_READ:
+			do_read(src);
+			break;
+		case BW_WRITE:
+			memset(src, i, len);
+			break;
+		case BW_COPY:
+		default:
+			memcpy(dst, src, len);
+			break;
+		}
+	}
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &diff);
+	w->secs = diff.tv_sec + diff.tv_usec / 1000000.0;
+
+	free(src);
+	free(dst);
+	return NULL;
+}
+
+/* Returns the aggregate bandwidth of @nr CPUs in GB/s. */
+static double run_cpus(int *cpus, int nr)
+{
+	struct worker *worker;
+	pthread_attr_t attr;
+	cpu_set_t cpuset;
+	double secs = 0;
+	int i, ret;
+
+	worker = calloc(nr, sizeof(*worker));
+	if (!worker)
+		err(EXIT_FAILURE, "calloc");
+
+	pthread_barrier_init(&barrier, NULL, nr);
+	pthread_attr_init(&attr);
+	for (i = 0; i < nr; i++) {
+		worker[i].cpu = cpus[i];
+
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpus[i], &cpuset);
+		ret = pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&worker[i].thread, &attr, workerfn,
+				     &worker[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&attr);
+
+	/* the slowest thread bounds the time the whole cluster took */
+	for (i = 0; i < nr; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+		if (worker[i].secs > secs)
+			secs = worker[i].secs;
+	}
+	pthread_barrier_destroy(&barrier);
+	free(worker);
+
+	if (secs <= 0)
+		return 0;
+	return (double)len * iterations * nr / secs / (1024 * 1024 * 1024);
+}
+
+static void print_result(const char *name, int id, int *cpus, int nr,
+			 double gbps)
+{
+	int i;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		if (id >= 0)
+			printf(" %s %3d", name, id);
+		else
+			printf(" %-11s", name);
+		printf(" (%2d CPUs: %d", nr, cpus[0]);
+		for (i = 1; i < nr; i++)
+			printf(",%d", cpus[i]);
+		printf("): %12.3lf GB/sec\n", gbps);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%d %lf\n", id, gbps);
+		break;
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
+
+int bench_mem_bandwidth(int argc, const char **argv,
+			const char *prefix __maybe_unused)
+{
+	struct cpu_map *cpus;
+	int *socket, *group;
+	int i, j, nr, nr_clusters = 0;
+	s64 size;
+
+	argc = parse_options(argc, argv, options, bench_mem_bandwidth_usage, 0);
+	if (argc || iterations <= 0) {
+		usage_with_options(bench_mem_bandwidth_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!strcmp(function, "read"))
+		bw_function = BW_READ;
+	else if (!strcmp(function, "write"))
+		bw_function = BW_WRITE;
+	else if (!strcmp(function, "copy"))
+		bw_function = BW_COPY;
+	else {
+		fprintf(stderr, "Unknown function: '%s'\n", function);
+		usage_with_options(bench_mem_bandwidth_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	size = perf_atoll((char *)size_str);
+	if (size <= 0) {
+		fprintf(stderr, "Invalid size:%s\n", size_str);
+		return 1;
+	}
+	/* do_read() works on four words at a time */
+	len = (size_t)size & ~(4 * sizeof(u64) - 1);
+	if (!len)
+		len = 4 * sizeof(u64);
+
+	cpus = cpu_map__new(cpu_list);
+	if (!cpus)
+		err(EXIT_FAILURE, "cpu_map__new");
+
+	socket = calloc(cpus->nr, sizeof(int));
+	group = calloc(cpus->nr, sizeof(int));
+	if (!socket || !group)
+		err(EXIT_FAILURE, "calloc");
+
+	/* -1 (no topology information) lumps everything into one group */
+	for (i = 0; i < cpus->nr; i++)
+		socket[i] = cpu_map__get_socket(cpus, i);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %s of %s per thread, %d times\n\n",
+		       function, size_str, iterations);
+
+	for (i = 0; i < cpus->nr; i++) {
+		/* skip clusters that were already run */
+		for (j = 0; j < i; j++)
+			if (socket[j] == socket[i])
+				break;
+		if (j < i)
+			continue;
+
+		for (nr = 0, j = i; j < cpus->nr; j++)
+			if (socket[j] == socket[i])
+				group[nr++] = cpus->map[j];
+
+		print_result("cluster", socket[i], group, nr,
+			     run_cpus(group, nr));
+		nr_clusters++;
+	}
+
+	if (nr_clusters > 1)
+		print_result("all", -1, cpus->map, cpus->nr,
+			     run_cpus(cpus->map, cpus->nr));
+
+	free(group);
+	free(socket);
+	cpu_map__put(cpus);
+	return 0;
+}
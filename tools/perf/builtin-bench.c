@@ -13,6 +13,8 @@
  *  mem   ... memory access performance
  *  numa  ... NUMA scheduling and MM performance
  *  futex ... Futex performance
+ *  epoll ... epoll performance
+ *  ipc   ... IPC latency between pairs of CPUs
  */
 #include "perf.h"
 #include "util/util.h"
@@ -51,6 +53,7 @@ static struct bench sched_benchmarks[] = {
 static struct bench mem_benchmarks[] = {
 	{ "memcpy",	"Benchmark for memcpy()",			bench_mem_memcpy	},
 	{ "memset",	"Benchmark for memset() tests",			bench_mem_memset	},
+	{ "bandwidth",	"Benchmark for per-cluster memory bandwidth",	bench_mem_bandwidth	},
 	{ "all",	"Test all memory benchmarks",			NULL			},
 	{ NULL,		NULL,						NULL			}
 };
@@ -66,6 +69,19 @@ static struct bench futex_benchmarks[] = {
 	{ NULL,		NULL,						NULL			}
 };
 
+static struct bench epoll_benchmarks[] = {
+	{ "wait",	"Benchmark for epoll_wait() wakeups",		bench_epoll_wait	},
+	{ "ctl",	"Benchmark for epoll_ctl() operations",		bench_epoll_ctl		},
+	{ "all",	"Test all epoll benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
+static struct bench ipc_benchmarks[] = {
+	{ "pingpong",	"Benchmark for round trips between CPU pairs",	bench_ipc_pingpong	},
+	{ "all",	"Test all IPC benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
 struct collection {
 	const char	*name;
 	const char	*summary;
@@ -79,6 +95,8 @@ static struct collection collections[] = {
 	{ "numa",	"NUMA scheduling and MM benchmarks",		numa_benchmarks		},
 #endif
 	{"futex",       "Futex stressing benchmarks",                   futex_benchmarks        },
+	{ "epoll",	"Epoll stressing benchmarks",			epoll_benchmarks	},
+	{ "ipc",	"IPC latency benchmarks",			ipc_benchmarks		},
 	{ "all",	"All benchmarks",				NULL			},
 	{ NULL,		NULL,						NULL			}
 };
@@ -11,20 +11,25 @@
 
 #define pr(fmt, ...) pr_N(1, pr_fmt(fmt), ##__VA_ARGS__)
 
-static void queue_event(struct ordered_events *oe, struct ordered_event *new)
+/* Beyond this, events share the queue of unknown CPUs. */
+#define MAX_QUEUES	4096
+
+static void queue_event(struct ordered_events *oe,
+			struct ordered_events_queue *q,
+			struct ordered_event *new)
 {
-	struct ordered_event *last = oe->last;
+	struct ordered_event *last = q->last;
 	u64 timestamp = new->timestamp;
 	struct list_head *p;
 
-	++oe->nr_events;
-	oe->last = new;
+	if (!oe->nr_events++ || timestamp > oe->max_timestamp)
+		oe->max_timestamp = timestamp;
+	q->last = new;
 
 	pr_oe_time2(timestamp, "queue_event nr_events %u\n", oe->nr_events);
 
 	if (!last) {
-		list_add(&new->list, &oe->events);
-		oe->max_timestamp = timestamp;
+		list_add(&new->list, &q->events);
 		return;
 	}
 
@@ -36,9 +41,8 @@ static void queue_event(struct ordered_events *oe, struct ordered_event *new)
 	if (last->timestamp <= timestamp) {
 		while (last->timestamp <= timestamp) {
 			p = last->list.next;
-			if (p == &oe->events) {
-				list_add_tail(&new->list, &oe->events);
-				oe->max_timestamp = timestamp;
+			if (p == &q->events) {
+				list_add_tail(&new->list, &q->events);
 				return;
 			}
 			last = list_entry(p, struct ordered_event, list);
@@ -47,8 +51,8 @@ static void queue_event(struct ordered_events *oe, struct ordered_event *new)
 	} else {
 		while (last->timestamp > timestamp) {
 			p = last->list.prev;
-			if (p == &oe->events) {
-				list_add(&new->list, &oe->events);
+			if (p == &q->events) {
+				list_add(&new->list, &q->events);
 				return;
 			}
 			last = list_entry(p, struct ordered_event, list);
@@ -130,16 +134,63 @@ static struct ordered_event *alloc_event(struct ordered_events *oe,
 	return new;
 }
 
+static unsigned int nr_queues(struct ordered_events *oe)
+{
+	return oe->nr_queues ?: 1;
+}
+
+static struct ordered_events_queue *
+queue_nr(struct ordered_events *oe, unsigned int i)
+{
+	return oe->nr_queues ? oe->queues[i] : &oe->queue;
+}
+
+/*
+ * CPU 0 and events without a CPU share the first queue; should allocating
+ * a queue fail, everything else ends up there as well.
+ */
+static struct ordered_events_queue *
+get_queue(struct ordered_events *oe, u32 cpu)
+{
+	struct ordered_events_queue **queues, *q;
+	unsigned int i;
+
+	if (cpu >= MAX_QUEUES)
+		return &oe->queue;
+	if (cpu < oe->nr_queues)
+		return oe->queues[cpu];
+
+	queues = realloc(oe->queues, (cpu + 1) * sizeof(*queues));
+	if (!queues)
+		return &oe->queue;
+	oe->queues = queues;
+
+	for (i = oe->nr_queues; i <= cpu; i++) {
+		if (i) {
+			q = zalloc(sizeof(*q));
+			if (!q)
+				break;
+			INIT_LIST_HEAD(&q->events);
+		} else {
+			q = &oe->queue;
+		}
+		queues[i] = q;
+	}
+	oe->nr_queues = i;
+
+	return cpu < i ? queues[cpu] : &oe->queue;
+}
+
 static struct ordered_event *
 ordered_events__new_event(struct ordered_events *oe, u64 timestamp,
-		    union perf_event *event)
+			  u32 cpu, union perf_event *event)
 {
 	struct ordered_event *new;
 
 	new = alloc_event(oe, event);
 	if (new) {
 		new->timestamp = timestamp;
-		queue_event(oe, new);
+		queue_event(oe, get_queue(oe, cpu), new);
 	}
 
 	return new;
@@ -169,10 +220,11 @@ int ordered_events__queue(struct ordered_events *oe, union perf_event *event,
 		oe->nr_unordered_events++;
 	}
 
-	oevent = ordered_events__new_event(oe, timestamp, event);
+	oevent = ordered_events__new_event(oe, timestamp, sample->cpu, event);
 	if (!oevent) {
 		ordered_events__flush(oe, OE_FLUSH__HALF);
-		oevent = ordered_events__new_event(oe, timestamp, event);
+		oevent = ordered_events__new_event(oe, timestamp, sample->cpu,
+						   event);
 	}
 
 	if (!oevent)
@@ -182,48 +234,112 @@ int ordered_events__queue(struct ordered_events *oe, union perf_event *event,
 	return 0;
 }
 
+static struct ordered_event *queue_first(struct ordered_events_queue *q)
+{
+	return list_first_entry(&q->events, struct ordered_event, list);
+}
+
+/* Equal timestamps are delivered in file order, as they were queued. */
+static bool queue_before(struct ordered_events_queue *a,
+			 struct ordered_events_queue *b)
+{
+	struct ordered_event *ea = queue_first(a), *eb = queue_first(b);
+
+	if (ea->timestamp != eb->timestamp)
+		return ea->timestamp < eb->timestamp;
+	return ea->file_offset < eb->file_offset;
+}
+
+static void heap_sift_down(struct ordered_events_queue **heap,
+			   unsigned int nr, unsigned int i)
+{
+	while (1) {
+		unsigned int min = i, l = 2 * i + 1, r = l + 1;
+		struct ordered_events_queue *tmp;
+
+		if (l < nr && queue_before(heap[l], heap[min]))
+			min = l;
+		if (r < nr && queue_before(heap[r], heap[min]))
+			min = r;
+		if (min == i)
+			break;
+		tmp = heap[i];
+		heap[i] = heap[min];
+		heap[min] = tmp;
+		i = min;
+	}
+}
+
+/*
+ * Deliver everything up to oe->next_flush, merging the per-CPU queues with
+ * a min-heap keyed by their first events.
+ */
 static int __ordered_events__flush(struct ordered_events *oe)
 {
-	struct list_head *head = &oe->events;
-	struct ordered_event *tmp, *iter;
+	struct ordered_events_queue **heap, *q;
+	struct ordered_event *iter;
 	u64 limit = oe->next_flush;
-	u64 last_ts = oe->last ? oe->last->timestamp : 0ULL;
 	bool show_progress = limit == ULLONG_MAX;
 	struct ui_progress prog;
-	int ret;
+	unsigned int i, nr = 0;
+	int ret = 0;
 
 	if (!limit)
 		return 0;
 
+	heap = malloc(nr_queues(oe) * sizeof(*heap));
+	if (!heap)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_queues(oe); i++) {
+		q = queue_nr(oe, i);
+		/* q->last may be delivered, pick the new tail afterwards */
+		if (q->last && q->last->timestamp <= limit)
+			q->last = NULL;
+		if (!list_empty(&q->events))
+			heap[nr++] = q;
+	}
+	for (i = nr / 2; i-- > 0; )
+		heap_sift_down(heap, nr, i);
+
 	if (show_progress)
 		ui_progress__init(&prog, oe->nr_events, "Processing time ordered events...");
 
-	list_for_each_entry_safe(iter, tmp, head, list) {
-		if (session_done())
-			return 0;
+	while (nr) {
+		q = heap[0];
+		iter = queue_first(q);
 
-		if (iter->timestamp > limit)
+		if (session_done() || iter->timestamp > limit)
 			break;
 		ret = oe->deliver(oe, iter);
 		if (ret)
-			return ret;
+			break;
 
 		ordered_events__delete(oe, iter);
 		oe->last_flush = iter->timestamp;
 
 		if (show_progress)
 			ui_progress__update(&prog, 1);
+
+		if (list_empty(&q->events))
+			heap[0] = heap[--nr];
+		heap_sift_down(heap, nr, 0);
 	}
 
-	if (list_empty(head))
-		oe->last = NULL;
-	else if (last_ts <= limit)
-		oe->last = list_entry(head->prev, struct ordered_event, list);
+	for (i = 0; i < nr_queues(oe); i++) {
+		q = queue_nr(oe, i);
+		if (list_empty(&q->events))
+			q->last = NULL;
+		else if (!q->last)
+			q->last = list_entry(q->events.prev,
+					     struct ordered_event, list);
+	}
 
 	if (show_progress)
 		ui_progress__finish();
 
-	return 0;
+	free(heap);
+	return ret;
 }
 
 int ordered_events__flush(struct ordered_events *oe, enum oe_flush how)
@@ -246,18 +362,22 @@ int ordered_events__flush(struct ordered_events *oe, enum oe_flush how)
 
 	case OE_FLUSH__HALF:
 	{
-		struct ordered_event *first, *last;
-		struct list_head *head = &oe->events;
+		u64 first = ULLONG_MAX;
+		unsigned int i;
+
+		for (i = 0; i < nr_queues(oe); i++) {
+			struct ordered_events_queue *q = queue_nr(oe, i);
 
-		first = list_entry(head->next, struct ordered_event, list);
-		last = oe->last;
+			if (!list_empty(&q->events))
+				first = min(first, queue_first(q)->timestamp);
+		}
 
 		/* Warn if we are called before any event got allocated. */
-		if (WARN_ONCE(!last || list_empty(head), "empty queue"))
+		if (WARN_ONCE(first == ULLONG_MAX, "empty queue"))
 			return 0;
 
-		oe->next_flush  = first->timestamp;
-		oe->next_flush += (last->timestamp - first->timestamp) / 2;
+		oe->next_flush  = first;
+		oe->next_flush += (oe->max_timestamp - first) / 2;
 		break;
 	}
 
@@ -289,7 +409,10 @@ int ordered_events__flush(struct ordered_events *oe, enum oe_flush how)
 
 void ordered_events__init(struct ordered_events *oe, ordered_events__deliver_t deliver)
 {
-	INIT_LIST_HEAD(&oe->events);
+	INIT_LIST_HEAD(&oe->queue.events);
+	oe->queue.last = NULL;
+	oe->queues = NULL;
+	oe->nr_queues = 0;
 	INIT_LIST_HEAD(&oe->cache);
 	INIT_LIST_HEAD(&oe->to_free);
 	oe->max_alloc_size = (u64) -1;
@@ -299,6 +422,8 @@ void ordered_events__init(struct ordered_events *oe, ordered_events__deliver_t d
 
 void ordered_events__free(struct ordered_events *oe)
 {
+	unsigned int i;
+
 	while (!list_empty(&oe->to_free)) {
 		struct ordered_event *event;
 
@@ -307,4 +432,9 @@ void ordered_events__free(struct ordered_events *oe)
 		free_dup_event(oe, event->event);
 		free(event);
 	}
+
+	for (i = 1; i < oe->nr_queues; i++)
+		free(oe->queues[i]);
+	zfree(&oe->queues);
+	oe->nr_queues = 0;
 }
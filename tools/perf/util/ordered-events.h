@@ -19,6 +19,15 @@ enum oe_flush {
 	OE_FLUSH__HALF,
 };
 
+/*
+ * Events are queued per CPU: each CPU's events mostly arrive in time order,
+ * so they are appended to their queue, and the queues are merged on flush.
+ */
+struct ordered_events_queue {
+	struct list_head	events;
+	struct ordered_event	*last;
+};
+
 struct ordered_events;
 
 typedef int (*ordered_events__deliver_t)(struct ordered_events *oe,
@@ -30,11 +39,12 @@ struct ordered_events {
 	u64			max_timestamp;
 	u64			max_alloc_size;
 	u64			cur_alloc_size;
-	struct list_head	events;
+	struct ordered_events_queue queue;
+	struct ordered_events_queue **queues;
+	unsigned int		nr_queues;
 	struct list_head	cache;
 	struct list_head	to_free;
 	struct ordered_event	*buffer;
-	struct ordered_event	*last;
 	ordered_events__deliver_t deliver;
 	int			buffer_idx;
 	unsigned int		nr_events;
@@ -0,0 +1,149 @@
+#!/bin/sh
+# Runs the Rockchip platform benchmarks and prints one line per result,
+# in a format meant to be compared across kernel versions:
+#
+#   <name> <samples> <min ns> <avg ns> <max ns> [<bytes/s>]
+#
+# TEST_ROCKCHIP_ARGS is passed to the test_rockchip module, for example
+# "iommu_master=ff940000.vop i2c_bus=0 i2c_addr=0x1b spi_bus=1 spi_cs=1
+# dvfs=1". FLIP_SECS is how
+# long VOP page flips are recorded (default 5, something has to be
+# flipping), and SUSPEND=1 adds a suspend/resume cycle through rtcwake.
+
+FLIP_SECS=${FLIP_SECS:-5}
+ret=0
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "test_rockchip: must be run as root, skipping"
+	exit 0
+fi
+
+TRACING=/sys/kernel/debug/tracing
+[ -d $TRACING ] || TRACING=/sys/kernel/tracing
+
+# module benchmarks: iommu, i2c, spi, dvfs
+run_module()
+{
+	if ! modprobe -q -n test_rockchip; then
+		echo "test_rockchip: module not available, skipping"
+		return
+	fi
+
+	lines=$(dmesg | wc -l)
+	if ! modprobe test_rockchip $TEST_ROCKCHIP_ARGS; then
+		echo "test_rockchip: module reported an error"
+		ret=1
+	fi
+	dmesg | tail -n +$((lines + 1)) | grep "test_rockchip: result " |
+	sed -e 's/.*test_rockchip: result //' -e 's/[a-z/]*=//g'
+	rmmod test_rockchip 2>/dev/null
+}
+
+# collect the events of the given tracepoints while running a command
+trace()
+{
+	events=$1
+	shift
+
+	echo > $TRACING/trace
+	for e in $events; do
+		echo 1 > $TRACING/events/$e/enable
+	done
+	"$@" > /dev/null
+	for e in $events; do
+		echo 0 > $TRACING/events/$e/enable
+	done
+	cat $TRACING/trace
+}
+
+# flip-to-scanout latency, from rockchip_vop_flip_complete
+run_flips()
+{
+	if [ ! -d $TRACING/events/rockchip_drm/rockchip_vop_flip_complete ]; then
+		echo "vop_flip: rockchip_drm tracepoints not available, skipping"
+		return
+	fi
+
+	trace rockchip_drm/rockchip_vop_flip_complete sleep $FLIP_SECS |
+	awk '
+	/rockchip_vop_flip_complete:/ {
+		for (i = 1; i <= NF; i++) {
+			if ($i ~ /^pipe=/) {
+				pipe = substr($i, 6); sub(",", "", pipe)
+			}
+			if ($i ~ /^latency=/) {
+				ns = substr($i, 9); sub("us", "", ns); ns *= 1000
+			}
+		}
+		if (!(pipe in n))
+			pipes++
+		n[pipe]++; total[pipe] += ns
+		if (!(pipe in min) || ns < min[pipe]) min[pipe] = ns
+		if (ns > max[pipe]) max[pipe] = ns
+	}
+	END {
+		for (p in n)
+			printf "vop_flip_pipe%s %d %.0f %.0f %.0f\n", p, n[p],
+			       min[p], total[p] / n[p], max[p]
+		if (!pipes)
+			print "vop_flip: no flips recorded, skipping"
+	}' | sort
+}
+
+# suspend/resume phases and the slowest device callbacks
+run_suspend()
+{
+	if [ "$SUSPEND" != 1 ]; then
+		echo "suspend: SUSPEND=1 not set, skipping"
+		return
+	fi
+	if ! which rtcwake > /dev/null 2>&1; then
+		echo "suspend: rtcwake not found, skipping"
+		return
+	fi
+
+	trace "power/suspend_resume power/device_pm_callback_start power/device_pm_callback_end" \
+		rtcwake -m mem -s 5 |
+	awk '
+	function ts() {
+		for (i = 1; i <= NF; i++)
+			if ($i ~ /^[0-9]+\.[0-9]+:$/)
+				return substr($i, 1, length($i) - 1) * 1000000000
+	}
+	function field(name,	i) {
+		for (i = 1; i < NF; i++)
+			if ($i == name)
+				return i + 1
+	}
+	/suspend_resume:/ {
+		i = field("suspend_resume:")
+		phase = $i; sub(/\[.*/, "", phase)
+		if ($(i + 1) == "begin")
+			begin[phase] = ts()
+		else if (phase in begin) {
+			t = ts() - begin[phase]
+			printf "suspend_%s 1 %.0f %.0f %.0f\n", phase, t, t, t
+		}
+	}
+	/device_pm_callback_start:/ {
+		i = field("device_pm_callback_start:")
+		dev = $i ":" $(i + 1); sub(",", "", dev)
+		start[dev] = ts()
+	}
+	/device_pm_callback_end:/ {
+		i = field("device_pm_callback_end:")
+		dev = $i ":" $(i + 1); sub(",", "", dev)
+		if (dev in start)
+			cb[dev] += ts() - start[dev]
+	}
+	END {
+		for (d in cb)
+			printf "pm_device_%s 1 %.0f %.0f %.0f\n", d, cb[d], cb[d], cb[d]
+	}' | sort -k1,1 -s
+}
+
+run_module
+run_flips
+run_suspend
+
+exit $ret
@@ -27,6 +27,8 @@
 #include <linux/rculist.h>
 #include <linux/uaccess.h>
 
+#include <linux/irqchip/arm-gic.h>
+
 #include <asm/kvm_emulate.h>
 #include <asm/kvm_arm.h>
 #include <asm/kvm_mmu.h>
@@ -2422,6 +2424,16 @@ int vgic_has_attr_regs(const struct vgic_io_range *ranges, phys_addr_t offset)
 
 static void vgic_init_maintenance_interrupt(void *info)
 {
+	int i;
+
+	/*
+	 * The arm64 GICv2 world switch only restores the list registers in
+	 * use and empties the ones it saves, so they must all start empty.
+	 */
+	if (vgic->type == VGIC_V2)
+		for (i = 0; i < vgic->nr_lr; i++)
+			writel_relaxed(0, vgic->vctrl_base + GICH_LR0 + i * 4);
+
 	enable_percpu_irq(vgic->maint_irq, 0);
 }
 